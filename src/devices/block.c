@@ -1,16 +1,78 @@
 #include "devices/block.h"
+#include <hash.h>
 #include <list.h>
+#include <proc-limits.h>
+#include <proc-stats.h>
 #include <string.h>
 #include <stdio.h>
 #include "devices/ide.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/trace.h"
+
+/* I/O scheduling.
+
+   Each block device has a queue of pending requests, served by
+   a worker thread started on the device's first request.  The
+   worker sweeps across the disk in one direction (C-LOOK):
+   it serves the request with the lowest sector at or past the
+   end of the previous transfer, wrapping around to the lowest
+   sector overall.  Runs of queued requests that are adjacent on
+   disk and go in the same direction are merged into a single
+   transfer.
+
+   Each request carries the priority its submitter had, and the
+   sweep only visits requests of the highest priority queued, so
+   that a high-priority thread's reads do not wait behind a
+   low-priority thread's stream of writes.  A request gains a
+   level of priority for every PRI_AGE_TICKS it waits, and one
+   that has waited past its deadline is served first, so that
+   neither priority nor the sweep starves anyone.
+
+   A process with a LIMIT_IO_RATE earns the right to transfer
+   that many sectors a second, and may save up at most
+   IO_BURST_NS worth.  Each of its requests is charged to it on
+   submission, except writes paid for ahead of time with
+   block_charge(), and the process pays by sleeping on its way
+   back to user mode; see process_io_throttle().  The buffer
+   cache charges a sector when a process dirties it, since the
+   write to disk may come much later, from another thread.
+
+   Requests for overlapping sectors may complete in any order. */
+
+/* Ticks a read or a write may wait before it jumps the queue. */
+#define READ_DEADLINE (TIMER_FREQ / 10)
+#define WRITE_DEADLINE (TIMER_FREQ / 2)
+
+/* Ticks a queued request waits to gain one level of priority. */
+#define PRI_AGE_TICKS 1
+
+/* Most unused time a process's I/O rate limit saves up. */
+#define IO_BURST_NS 100000000
+
+/* Most sectors merged into one transfer. */
+#define MAX_MERGE_SECTORS 64
+
+/* Latency histograms have one bucket per power of 2 cycles. */
+#define LATENCY_BUCKETS 40
+
+/* A block device's name, as indexed by blocks_by_name. */
+struct block_name
+  {
+    struct hash_elem hash_elem;         /* Element in blocks_by_name. */
+    struct block *block;                /* Device with this name. */
+    char name[16];                      /* Block device name. */
+  };
 
 /* A block device. */
 struct block
   {
     struct list_elem list_elem;         /* Element in all_blocks. */
 
-    char name[16];                      /* Block device name. */
+    struct block_name name;             /* Block device name. */
     enum block_type type;                /* Type of block device. */
     block_sector_t size;                 /* Size in sectors. */
 
@@ -19,15 +81,48 @@ struct block
 
     unsigned long long read_cnt;        /* Number of sectors read. */
     unsigned long long write_cnt;       /* Number of sectors written. */
+
+    /* Request queue. */
+    struct lock queue_lock;             /* Protects the members below. */
+    struct condition queue_nonempty;    /* Signaled when a request arrives. */
+    struct list queue;                  /* Pending requests, by sector. */
+    struct list fifo;                   /* Pending requests, by age. */
+    block_sector_t head;                /* End of the last transfer. */
+    bool worker_started;                /* Worker thread created? */
+
+    /* Request statistics.  Bucket I of a histogram counts
+       requests that took between 2**(I-1) and 2**I cycles. */
+    unsigned in_flight;                 /* Submitted but not completed. */
+    unsigned max_in_flight;             /* Peak of IN_FLIGHT. */
+    unsigned long long wait_hist[LATENCY_BUCKETS];    /* Time queued. */
+    unsigned long long service_hist[LATENCY_BUCKETS]; /* Time in driver. */
   };
 
 /* List of all block devices. */
 static struct list all_blocks = LIST_INITIALIZER (all_blocks);
 
+/* All block devices, by name.  Initialized by the first
+   block_register() call. */
+static struct hash blocks_by_name;
+static bool blocks_by_name_ready;
+
 /* The block block assigned to each Pintos role. */
 static struct block *block_by_role[BLOCK_ROLE_CNT];
 
 static struct block *list_elem_to_block (struct list_elem *);
+static hash_hash_func block_name_hash;
+static hash_less_func block_name_less;
+static thread_func block_worker NO_RETURN;
+static struct block_request *pick_request (struct block *);
+static int request_priority (const struct block_request *, int64_t now);
+static void dispatch (struct block *, struct list *batch,
+                      block_sector_t sector, block_sector_t cnt, bool write);
+static void transfer (struct block *, block_sector_t, void *,
+                      block_sector_t cnt, bool write);
+static void record_latency (unsigned long long hist[], uint64_t cycles);
+static void charge_io (struct proc_limits *, block_sector_t cnt);
+static void print_latency (const char *name,
+                           const unsigned long long hist[]);
 
 /* Returns a human-readable name for the given block device
    TYPE. */
@@ -86,30 +181,31 @@ block_next (struct block *block)
 struct block *
 block_get_by_name (const char *name)
 {
-  struct list_elem *e;
+  struct block_name key;
+  struct hash_elem *e;
 
-  for (e = list_begin (&all_blocks); e != list_end (&all_blocks);
-       e = list_next (e))
-    {
-      struct block *block = list_entry (e, struct block, list_elem);
-      if (!strcmp (name, block->name))
-        return block;
-    }
-
-  return NULL;
+  if (!blocks_by_name_ready || strlen (name) >= sizeof key.name)
+    return NULL;
+  strlcpy (key.name, name, sizeof key.name);
+  e = hash_find (&blocks_by_name, &key.hash_elem);
+  return (e != NULL
+          ? hash_entry (e, struct block_name, hash_elem)->block
+          : NULL);
 }
 
-/* Verifies that SECTOR is a valid offset within BLOCK.
-   Panics if not. */
-static void
-check_sector (struct block *block, block_sector_t sector)
+/* Verifies that the CNT sectors starting at SECTOR lie within
+   BLOCK.  Panics if not. */
+static inline void
+check_sectors (struct block *block, block_sector_t sector,
+               block_sector_t cnt)
 {
-  if (sector >= block->size)
+  if (sector >= block->size || cnt > block->size - sector)
     {
       /* We do not use ASSERT because we want to panic here
          regardless of whether NDEBUG is defined. */
       PANIC ("Access past end of device %s (sector=%"PRDSNu", "
-             "size=%"PRDSNu")\n", block_name (block), sector, block->size);
+             "cnt=%"PRDSNu", size=%"PRDSNu")\n",
+             block_name (block), sector, cnt, block->size);
     }
 }
 
@@ -120,9 +216,7 @@ check_sector (struct block *block, block_sector_t sector)
 void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
-  check_sector (block, sector);
-  block->ops->read (block->aux, sector, buffer);
-  block->read_cnt++;
+  block_read_multiple (block, sector, buffer, 1);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -133,10 +227,368 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
 void
 block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
-  check_sector (block, sector);
-  ASSERT (block->type != BLOCK_FOREIGN);
-  block->ops->write (block->aux, sector, buffer);
-  block->write_cnt++;
+  block_write_multiple (block, sector, buffer, 1);
+}
+
+/* Reads CNT consecutive sectors starting at SECTOR from BLOCK
+   into BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes.  Drivers that support it do this with a single
+   request.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_read_multiple (struct block *block, block_sector_t sector,
+                     void *buffer, block_sector_t cnt)
+{
+  struct block_request r;
+
+  if (cnt == 0)
+    return;
+  r.sector = sector;
+  r.cnt = cnt;
+  r.buffer = buffer;
+  r.write = false;
+  r.prepaid = false;
+  block_submit (block, &r);
+  block_wait (&r);
+}
+
+/* Writes CNT consecutive sectors starting at SECTOR to BLOCK
+   from BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE
+   bytes.  Drivers that support it do this with a single
+   request.  Returns after the block device has acknowledged
+   receiving the data.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_write_multiple (struct block *block, block_sector_t sector,
+                      const void *buffer, block_sector_t cnt)
+{
+  struct block_request r;
+
+  if (cnt == 0)
+    return;
+  r.sector = sector;
+  r.cnt = cnt;
+  r.buffer = (void *) buffer;
+  r.write = true;
+  r.prepaid = false;
+  block_submit (block, &r);
+  block_wait (&r);
+}
+
+/* Queues request R, whose SECTOR, CNT, BUFFER, WRITE, and
+   PREPAID members must be set, on BLOCK and returns without
+   waiting for it.  R and its buffer must stay valid until
+   block_wait() returns for it. */
+void
+block_submit (struct block *block, struct block_request *r)
+{
+  struct list_elem *e;
+
+  ASSERT (r->cnt > 0);
+  check_sectors (block, r->sector, r->cnt);
+  ASSERT (!r->write || block->type != BLOCK_FOREIGN);
+
+  sema_init (&r->done, 0);
+  r->queued = timer_ticks ();
+  r->deadline = r->queued + (r->write ? WRITE_DEADLINE : READ_DEADLINE);
+  r->priority = thread_get_priority ();
+  r->submitted = timer_cycles ();
+  TRACE_EVENT (BLOCK_SUBMIT, r->sector,
+               r->cnt | (r->write ? TRACE_BLOCK_WRITE : 0));
+  if (thread_current ()->acct != NULL)
+    {
+      struct proc_stats *acct = thread_current ()->acct;
+      if (r->write)
+        acct->write_sectors += r->cnt;
+      else
+        acct->read_sectors += r->cnt;
+    }
+  if (!r->prepaid)
+    block_charge (r->cnt);
+
+  lock_acquire (&block->queue_lock);
+  if (++block->in_flight > block->max_in_flight)
+    block->max_in_flight = block->in_flight;
+  if (!block->worker_started)
+    {
+      block->worker_started = true;
+      thread_create (block->name.name, PRI_MAX, block_worker, block);
+    }
+  for (e = list_begin (&block->queue); e != list_end (&block->queue);
+       e = list_next (e))
+    if (list_entry (e, struct block_request, sort_elem)->sector > r->sector)
+      break;
+  list_insert (e, &r->sort_elem);
+  list_push_back (&block->fifo, &r->fifo_elem);
+  cond_signal (&block->queue_nonempty, &block->queue_lock);
+  lock_release (&block->queue_lock);
+}
+
+/* Charges CNT sectors to the running process's I/O budget, if
+   it has a rate limit, for writes that will be submitted later
+   with PREPAID set, perhaps by some other thread. */
+void
+block_charge (block_sector_t cnt)
+{
+  if (thread_current ()->limits != NULL)
+    charge_io (thread_current ()->limits, cnt);
+}
+
+/* Waits for request R, previously passed to block_submit(), to
+   complete. */
+void
+block_wait (struct block_request *r)
+{
+  sema_down (&r->done);
+}
+
+/* Worker thread for BLOCK_.  Takes the next request off the
+   queue, together with any queued requests that continue it on
+   disk, and carries them out. */
+static void
+block_worker (void *block_)
+{
+  struct block *block = block_;
+
+  for (;;)
+    {
+      struct block_request *r;
+      struct list batch;
+      block_sector_t sector, cnt;
+      bool write;
+
+      lock_acquire (&block->queue_lock);
+      while (list_empty (&block->fifo))
+        cond_wait (&block->queue_nonempty, &block->queue_lock);
+
+      r = pick_request (block);
+      sector = r->sector;
+      cnt = 0;
+      write = r->write;
+      list_init (&batch);
+      for (;;)
+        {
+          struct list_elem *next = list_next (&r->sort_elem);
+
+          list_remove (&r->sort_elem);
+          list_remove (&r->fifo_elem);
+          list_push_back (&batch, &r->sort_elem);
+          cnt += r->cnt;
+
+          if (next == list_end (&block->queue))
+            break;
+          r = list_entry (next, struct block_request, sort_elem);
+          if (r->write != write || r->sector != sector + cnt
+              || cnt + r->cnt > MAX_MERGE_SECTORS)
+            break;
+        }
+      block->head = sector + cnt;
+      lock_release (&block->queue_lock);
+
+      dispatch (block, &batch, sector, cnt, write);
+    }
+}
+
+/* Returns the request that BLOCK's worker should serve next:
+   the oldest if it is past its deadline, otherwise the next one
+   in the sweep among those of the highest priority.  The queue
+   lock must be held and the queue must not be empty. */
+static struct block_request *
+pick_request (struct block *block)
+{
+  struct block_request *oldest, *first = NULL;
+  struct list_elem *e;
+  int64_t now = timer_ticks ();
+  int max_priority = PRI_MIN;
+
+  ASSERT (lock_held_by_current_thread (&block->queue_lock));
+  ASSERT (!list_empty (&block->queue));
+
+  oldest = list_entry (list_front (&block->fifo),
+                       struct block_request, fifo_elem);
+  if (now >= oldest->deadline)
+    return oldest;
+
+  for (e = list_begin (&block->queue); e != list_end (&block->queue);
+       e = list_next (e))
+    {
+      struct block_request *r = list_entry (e, struct block_request,
+                                            sort_elem);
+      int priority = request_priority (r, now);
+      if (priority > max_priority)
+        max_priority = priority;
+    }
+
+  for (e = list_begin (&block->queue); e != list_end (&block->queue);
+       e = list_next (e))
+    {
+      struct block_request *r = list_entry (e, struct block_request,
+                                            sort_elem);
+      if (request_priority (r, now) < max_priority)
+        continue;
+      if (r->sector >= block->head)
+        return r;
+      if (first == NULL)
+        first = r;
+    }
+  return first;
+}
+
+/* Charges CNT sectors to the I/O budget in LIMITS, if it has a
+   rate limit. */
+static void
+charge_io (struct proc_limits *limits, block_sector_t cnt)
+{
+  unsigned rate = limits->max[LIMIT_IO_RATE];
+  uint64_t now;
+  enum intr_level old_level;
+
+  if (rate == 0)
+    return;
+  now = clock_ns ();
+
+  /* The process's threads may submit at once. */
+  old_level = intr_disable ();
+  if (limits->io_ready + IO_BURST_NS < now)
+    limits->io_ready = now - IO_BURST_NS;
+  limits->io_ready += (uint64_t) cnt * 1000000000 / rate;
+  intr_set_level (old_level);
+}
+
+/* Returns R's priority, raised for the time it has been queued
+   as of timer tick NOW. */
+static int
+request_priority (const struct block_request *r, int64_t now)
+{
+  int64_t priority = r->priority + (now - r->queued) / PRI_AGE_TICKS;
+  return priority < PRI_MAX ? priority : PRI_MAX;
+}
+
+/* Carries out the requests in BATCH, which together cover CNT
+   sectors starting at SECTOR in order, and wakes up their
+   submitters.  A batch of more than one request is moved through
+   a bounce buffer in a single transfer if memory allows. */
+static void
+dispatch (struct block *block, struct list *batch,
+          block_sector_t sector, block_sector_t cnt, bool write)
+{
+  struct block_request *r;
+  struct list_elem *e;
+  uint8_t *bounce = NULL;
+  uint64_t start = timer_cycles ();
+  size_t batch_cnt = list_size (batch);
+
+  for (e = list_begin (batch); e != list_end (batch); e = list_next (e))
+    {
+      r = list_entry (e, struct block_request, sort_elem);
+      record_latency (block->wait_hist, start - r->submitted);
+    }
+
+  if (list_size (batch) > 1)
+    bounce = malloc (cnt * BLOCK_SECTOR_SIZE);
+
+  if (bounce != NULL)
+    {
+      uint8_t *p;
+
+      if (write)
+        for (p = bounce, e = list_begin (batch); e != list_end (batch);
+             p += r->cnt * BLOCK_SECTOR_SIZE, e = list_next (e))
+          {
+            r = list_entry (e, struct block_request, sort_elem);
+            memcpy (p, r->buffer, r->cnt * BLOCK_SECTOR_SIZE);
+          }
+      transfer (block, sector, bounce, cnt, write);
+      if (!write)
+        for (p = bounce, e = list_begin (batch); e != list_end (batch);
+             p += r->cnt * BLOCK_SECTOR_SIZE, e = list_next (e))
+          {
+            r = list_entry (e, struct block_request, sort_elem);
+            memcpy (r->buffer, p, r->cnt * BLOCK_SECTOR_SIZE);
+          }
+      free (bounce);
+    }
+  else
+    for (e = list_begin (batch); e != list_end (batch); e = list_next (e))
+      {
+        r = list_entry (e, struct block_request, sort_elem);
+        transfer (block, r->sector, r->buffer, r->cnt, write);
+      }
+
+  record_latency (block->service_hist, timer_cycles () - start);
+
+  lock_acquire (&block->queue_lock);
+  block->in_flight -= batch_cnt;
+  lock_release (&block->queue_lock);
+
+  while (!list_empty (batch))
+    {
+      r = list_entry (list_pop_front (batch), struct block_request, sort_elem);
+      TRACE_EVENT (BLOCK_DONE, r->sector,
+                   r->cnt | (r->write ? TRACE_BLOCK_WRITE : 0));
+      sema_up_io (&r->done);
+    }
+}
+
+/* Adds an interval of CYCLES to latency histogram HIST. */
+static void
+record_latency (unsigned long long hist[], uint64_t cycles)
+{
+  int bucket = 0;
+
+  while (cycles > 0 && bucket < LATENCY_BUCKETS - 1)
+    {
+      cycles >>= 1;
+      bucket++;
+    }
+  hist[bucket]++;
+}
+
+/* Prints the nonempty buckets of latency histogram HIST, labeled
+   with NAME, on one line. */
+static void
+print_latency (const char *name, const unsigned long long hist[])
+{
+  int i;
+
+  printf ("  %s cycles:", name);
+  for (i = 0; i < LATENCY_BUCKETS; i++)
+    if (hist[i] != 0)
+      printf (" <2^%d:%llu", i, hist[i]);
+  printf ("\n");
+}
+
+/* Moves CNT sectors starting at SECTOR between BLOCK and
+   BUFFER, in one driver call if the driver supports it. */
+static void
+transfer (struct block *block, block_sector_t sector, void *buffer_,
+          block_sector_t cnt, bool write)
+{
+  uint8_t *buffer = buffer_;
+  block_sector_t i;
+
+  if (write)
+    {
+      if (cnt > 1 && block->ops->write_multiple != NULL)
+        block->ops->write_multiple (block->aux, sector, buffer, cnt);
+      else
+        for (i = 0; i < cnt; i++)
+          block->ops->write (block->aux, sector + i,
+                             buffer + i * BLOCK_SECTOR_SIZE);
+      block->write_cnt += cnt;
+    }
+  else
+    {
+      if (cnt > 1 && block->ops->read_multiple != NULL)
+        block->ops->read_multiple (block->aux, sector, buffer, cnt);
+      else
+        for (i = 0; i < cnt; i++)
+          block->ops->read (block->aux, sector + i,
+                            buffer + i * BLOCK_SECTOR_SIZE);
+      block->read_cnt += cnt;
+    }
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -150,7 +602,7 @@ block_size (struct block *block)
 const char *
 block_name (struct block *block)
 {
-  return block->name;
+  return block->name.name;
 }
 
 /* Returns BLOCK's type. */
@@ -160,6 +612,15 @@ block_type (struct block *block)
   return block->type;
 }
 
+/* Stores the number of sectors read from and written to BLOCK
+   into *STATS. */
+void
+block_get_stats (struct block *block, struct io_stats *stats)
+{
+  stats->read_cnt = block->read_cnt;
+  stats->write_cnt = block->write_cnt;
+}
+
 /* Prints statistics for each block device used for a Pintos role. */
 void
 block_print_stats (void)
@@ -172,8 +633,17 @@ block_print_stats (void)
       if (block != NULL)
         {
           printf ("%s (%s): %llu reads, %llu writes\n",
-                  block->name, block_type_name (block->type),
+                  block->name.name, block_type_name (block->type),
                   block->read_cnt, block->write_cnt);
+          if (block->read_cnt + block->write_cnt == 0)
+            continue;
+          printf ("  %llu bytes read, %llu bytes written, "
+                  "%u in flight, peak %u\n",
+                  block->read_cnt * BLOCK_SECTOR_SIZE,
+                  block->write_cnt * BLOCK_SECTOR_SIZE,
+                  block->in_flight, block->max_in_flight);
+          print_latency ("queue wait", block->wait_hist);
+          print_latency ("service", block->service_hist);
         }
     }
 }
@@ -192,16 +662,35 @@ block_register (const char *name, enum block_type type,
   if (block == NULL)
     PANIC ("Failed to allocate memory for block device descriptor");
 
+  if (!blocks_by_name_ready)
+    {
+      if (!hash_init (&blocks_by_name, block_name_hash, block_name_less,
+                      NULL))
+        PANIC ("Failed to allocate block device name table");
+      blocks_by_name_ready = true;
+    }
+
   list_push_back (&all_blocks, &block->list_elem);
-  strlcpy (block->name, name, sizeof block->name);
+  block->name.block = block;
+  strlcpy (block->name.name, name, sizeof block->name.name);
+  hash_insert (&blocks_by_name, &block->name.hash_elem);
   block->type = type;
   block->size = size;
   block->ops = ops;
   block->aux = aux;
   block->read_cnt = 0;
   block->write_cnt = 0;
+  lock_init (&block->queue_lock);
+  cond_init (&block->queue_nonempty);
+  list_init (&block->queue);
+  list_init (&block->fifo);
+  block->head = 0;
+  block->worker_started = false;
+  block->in_flight = block->max_in_flight = 0;
+  memset (block->wait_hist, 0, sizeof block->wait_hist);
+  memset (block->service_hist, 0, sizeof block->service_hist);
 
-  printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
+  printf ("%s: %'"PRDSNu" sectors (", block->name.name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
   printf (")");
   if (extra_info != NULL)
@@ -221,3 +710,20 @@ list_elem_to_block (struct list_elem *list_elem)
           : NULL);
 }
 
+
+/* Returns a hash value for the block device name containing E. */
+static unsigned
+block_name_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_string (hash_entry (e, struct block_name, hash_elem)->name);
+}
+
+/* Returns true if the block device name containing A sorts
+   before B's. */
+static bool
+block_name_less (const struct hash_elem *a, const struct hash_elem *b,
+                 void *aux UNUSED)
+{
+  return strcmp (hash_entry (a, struct block_name, hash_elem)->name,
+                 hash_entry (b, struct block_name, hash_elem)->name) < 0;
+}
@@ -1,8 +1,12 @@
 #ifndef DEVICES_BLOCK_H
 #define DEVICES_BLOCK_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <inttypes.h>
+#include <io-stats.h>
+#include <list.h>
+#include "threads/synch.h"
 
 /* Size of a block device sector in bytes.
    All IDE disks use this sector size, as do most USB and SCSI
@@ -53,10 +57,41 @@ struct block *block_next (struct block *);
 block_sector_t block_size (struct block *);
 void block_read (struct block *, block_sector_t, void *);
 void block_write (struct block *, block_sector_t, const void *);
+void block_read_multiple (struct block *, block_sector_t, void *,
+                          block_sector_t cnt);
+void block_write_multiple (struct block *, block_sector_t, const void *,
+                           block_sector_t cnt);
 const char *block_name (struct block *);
 enum block_type block_type (struct block *);
 
+/* Asynchronous I/O. */
+
+/* A request for block_submit(). */
+struct block_request
+  {
+    /* Filled in by the submitter. */
+    block_sector_t sector;              /* First sector. */
+    block_sector_t cnt;                 /* Number of sectors. */
+    void *buffer;                       /* CNT * BLOCK_SECTOR_SIZE bytes. */
+    bool write;                         /* Write BUFFER to disk? */
+    bool prepaid;                       /* Paid for by block_charge()? */
+
+    /* Owned by the block layer. */
+    struct list_elem sort_elem;         /* Queue element, by sector. */
+    struct list_elem fifo_elem;         /* Queue element, by age. */
+    int64_t queued;                     /* timer_ticks() at submission. */
+    int64_t deadline;                   /* Serve by this timer tick. */
+    int priority;                       /* Submitter's priority. */
+    uint64_t submitted;                 /* timer_cycles() at submission. */
+    struct semaphore done;              /* Up'd on completion. */
+  };
+
+void block_submit (struct block *, struct block_request *);
+void block_charge (block_sector_t cnt);
+void block_wait (struct block_request *);
+
 /* Statistics. */
+void block_get_stats (struct block *, struct io_stats *);
 void block_print_stats (void);
 
 /* Lower-level interface to block device drivers. */
@@ -65,6 +100,14 @@ struct block_operations
   {
     void (*read) (void *aux, block_sector_t, void *buffer);
     void (*write) (void *aux, block_sector_t, const void *buffer);
+
+    /* Optional.  Transfer CNT consecutive sectors at once.  If
+       null, the block layer calls read or write once per
+       sector instead. */
+    void (*read_multiple) (void *aux, block_sector_t, void *buffer,
+                           block_sector_t cnt);
+    void (*write_multiple) (void *aux, block_sector_t, const void *buffer,
+                            block_sector_t cnt);
   };
 
 struct block *block_register (const char *name, enum block_type,
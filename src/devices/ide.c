@@ -9,6 +9,7 @@
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -34,6 +35,7 @@
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -49,6 +51,12 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4          /* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5         /* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6      /* SET MULTIPLE MODE. */
+
+/* Most sectors that a single command can transfer. */
+#define MAX_COMMAND_SECTORS 256
 
 /* An ATA device. */
 struct ata_disk
@@ -57,6 +65,10 @@ struct ata_disk
     struct channel *channel;    /* Channel that disk is attached to. */
     int dev_no;                 /* Device 0 or 1 for master or slave. */
     bool is_ata;                /* Is device an ATA disk? */
+    int multiple;               /* Sectors per interrupt for READ/WRITE
+                                   MULTIPLE, or 0 if not supported. */
+    block_sector_t capacity;    /* Size in sectors, from IDENTIFY DEVICE. */
+    char extra_info[128];       /* Model and serial number. */
   };
 
 /* An ATA channel (aka controller).
@@ -79,13 +91,20 @@ struct channel
 #define CHANNEL_CNT 2
 static struct channel channels[CHANNEL_CNT];
 
+/* Up'd by each channel's probe thread when it finishes. */
+static struct semaphore probe_done;
+
 static struct block_operations ide_operations;
 
+static thread_func probe_channel;
 static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
+static void register_ata_device (struct ata_disk *);
 
-static void select_sector (struct ata_disk *, block_sector_t);
+static void set_multiple_mode (struct ata_disk *, int sectors);
+static void select_sector (struct ata_disk *, block_sector_t,
+                           block_sector_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -124,6 +143,7 @@ ide_init (void)
           NOT_REACHED ();
         }
       lock_init (&c->lock);
+      lock_register (&c->lock, c->name);
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
  
@@ -140,20 +160,59 @@ ide_init (void)
 
       /* Register interrupt handler. */
       intr_register_ext (c->irq, interrupt_handler, c->name);
+    }
+
+  /* Resetting a channel takes most of the time spent here, in
+     sleeps and in waits for the devices to come out of reset, so
+     probe the channels concurrently, one thread each. */
+  sema_init (&probe_done, 0);
+  for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
+    {
+      char name[16];
 
-      /* Reset hardware. */
-      reset_channel (c);
+      snprintf (name, sizeof name, "ide%zu probe", chan_no);
+      if (thread_create (name, PRI_DEFAULT, probe_channel,
+                         &channels[chan_no]) == TID_ERROR)
+        probe_channel (&channels[chan_no]);
+    }
+  for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
+    sema_down (&probe_done);
 
-      /* Distinguish ATA hard disks from other devices. */
-      if (check_device_type (&c->devices[0]))
-        check_device_type (&c->devices[1]);
+  /* Register the disks found, in a fixed order, so that "probe
+     order" in locate_block_device() does not depend on which
+     channel answered first. */
+  for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
+    {
+      int dev_no;
 
-      /* Read hard disk identity information. */
       for (dev_no = 0; dev_no < 2; dev_no++)
-        if (c->devices[dev_no].is_ata)
-          identify_ata_device (&c->devices[dev_no]);
+        if (channels[chan_no].devices[dev_no].is_ata)
+          register_ata_device (&channels[chan_no].devices[dev_no]);
     }
 }
+
+/* Resets channel C_ and reads the identity of the hard disks on
+   it, then signals probe_done. */
+static void
+probe_channel (void *c_)
+{
+  struct channel *c = c_;
+  int dev_no;
+
+  /* Reset hardware. */
+  reset_channel (c);
+
+  /* Distinguish ATA hard disks from other devices. */
+  if (check_device_type (&c->devices[0]))
+    check_device_type (&c->devices[1]);
+
+  /* Read hard disk identity information. */
+  for (dev_no = 0; dev_no < 2; dev_no++)
+    if (c->devices[dev_no].is_ata)
+      identify_ata_device (&c->devices[dev_no]);
+
+  sema_up (&probe_done);
+}
 
 /* Disk detection and identification. */
 
@@ -254,17 +313,13 @@ check_device_type (struct ata_disk *d)
 }
 
 /* Sends an IDENTIFY DEVICE command to disk D and reads the
-   response.  Registers the disk with the block device
-   layer. */
+   response into D, for register_ata_device() to use. */
 static void
 identify_ata_device (struct ata_disk *d) 
 {
   struct channel *c = d->channel;
   char id[BLOCK_SECTOR_SIZE];
-  block_sector_t capacity;
   char *model, *serial;
-  char extra_info[128];
-  struct block *block;
 
   ASSERT (d->is_ata);
 
@@ -281,30 +336,45 @@ identify_ata_device (struct ata_disk *d)
     }
   input_sector (c, id);
 
+  /* Enable READ/WRITE MULTIPLE if the disk supports it.  The
+     low byte of word 47 is the largest number of sectors the
+     disk can transfer per interrupt. */
+  set_multiple_mode (d, (uint8_t) id[47 * 2]);
+
   /* Calculate capacity.
      Read model name and serial number. */
-  capacity = *(uint32_t *) &id[60 * 2];
+  d->capacity = *(uint32_t *) &id[60 * 2];
   model = descramble_ata_string (&id[10 * 2], 20);
   serial = descramble_ata_string (&id[27 * 2], 40);
-  snprintf (extra_info, sizeof extra_info,
+  snprintf (d->extra_info, sizeof d->extra_info,
             "model \"%s\", serial \"%s\"", model, serial);
+}
+
+/* Registers disk D, identified by identify_ata_device(), with
+   the block device layer and scans it for partitions. */
+static void
+register_ata_device (struct ata_disk *d)
+{
+  struct block *block;
+
+  ASSERT (d->is_ata);
 
   /* Disable access to IDE disks over 1 GB, which are likely
      physical IDE disks rather than virtual ones.  If we don't
      allow access to those, we're less likely to scribble on
      someone's important data.  You can disable this check by
      hand if you really want to do so. */
-  if (capacity >= 1024 * 1024 * 1024 / BLOCK_SECTOR_SIZE)
+  if (d->capacity >= 1024 * 1024 * 1024 / BLOCK_SECTOR_SIZE)
     {
       printf ("%s: ignoring ", d->name);
-      print_human_readable_size (capacity * 512);
+      print_human_readable_size (d->capacity * 512);
       printf ("disk for safety\n");
       d->is_ata = false;
       return;
     }
 
   /* Register. */
-  block = block_register (d->name, BLOCK_RAW, extra_info, capacity,
+  block = block_register (d->name, BLOCK_RAW, d->extra_info, d->capacity,
                           &ide_operations, d);
   partition_scan (block);
 }
@@ -337,23 +407,107 @@ descramble_ata_string (char *string, int size)
   return string;
 }
 
-/* Reads sector SEC_NO from disk D into BUFFER, which must have
-   room for BLOCK_SECTOR_SIZE bytes.
+/* Reads CNT consecutive sectors starting at SEC_NO from disk D
+   into BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes.  Uses READ MULTIPLE, when D supports it, so that the
+   disk interrupts once per D->multiple sectors instead of once
+   per sector.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 static void
-ide_read (void *d_, block_sector_t sec_no, void *buffer)
+ide_read_multiple (void *d_, block_sector_t sec_no, void *buffer_,
+                   block_sector_t cnt)
 {
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
-  lock_release (&c->lock);
+  uint8_t *buffer = buffer_;
+
+  while (cnt > 0)
+    {
+      block_sector_t run, per_intr, left;
+
+      run = cnt < MAX_COMMAND_SECTORS ? cnt : MAX_COMMAND_SECTORS;
+      per_intr = run > 1 && d->multiple > 0 ? d->multiple : 1;
+
+      lock_acquire (&c->lock);
+      select_sector (d, sec_no, run);
+      issue_pio_command (c, (per_intr > 1
+                             ? CMD_READ_MULTIPLE : CMD_READ_SECTOR_RETRY));
+      for (left = run; left > 0; )
+        {
+          block_sector_t n = left < per_intr ? left : per_intr;
+
+          sema_down (&c->completion_wait);
+          if (!wait_while_busy (d))
+            PANIC ("%s: disk read failed, sector=%"PRDSNu,
+                   d->name, sec_no + (run - left));
+          for (left -= n; n > 0; n--)
+            {
+              input_sector (c, buffer);
+              buffer += BLOCK_SECTOR_SIZE;
+            }
+        }
+      lock_release (&c->lock);
+
+      sec_no += run;
+      cnt -= run;
+    }
+}
+
+/* Writes CNT consecutive sectors starting at SEC_NO to disk D
+   from BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE
+   bytes.  Uses WRITE MULTIPLE when D supports it.  Returns after
+   the disk has acknowledged receiving the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_write_multiple (void *d_, block_sector_t sec_no, const void *buffer_,
+                    block_sector_t cnt)
+{
+  struct ata_disk *d = d_;
+  struct channel *c = d->channel;
+  const uint8_t *buffer = buffer_;
+
+  while (cnt > 0)
+    {
+      block_sector_t run, per_intr, left;
+
+      run = cnt < MAX_COMMAND_SECTORS ? cnt : MAX_COMMAND_SECTORS;
+      per_intr = run > 1 && d->multiple > 0 ? d->multiple : 1;
+
+      lock_acquire (&c->lock);
+      select_sector (d, sec_no, run);
+      issue_pio_command (c, (per_intr > 1
+                             ? CMD_WRITE_MULTIPLE : CMD_WRITE_SECTOR_RETRY));
+      for (left = run; left > 0; )
+        {
+          block_sector_t n = left < per_intr ? left : per_intr;
+
+          if (!wait_while_busy (d))
+            PANIC ("%s: disk write failed, sector=%"PRDSNu,
+                   d->name, sec_no + (run - left));
+          for (left -= n; n > 0; n--)
+            {
+              output_sector (c, buffer);
+              buffer += BLOCK_SECTOR_SIZE;
+            }
+          sema_down (&c->completion_wait);
+        }
+      lock_release (&c->lock);
+
+      sec_no += run;
+      cnt -= run;
+    }
+}
+
+/* Reads sector SEC_NO from disk D into BUFFER, which must have
+   room for BLOCK_SECTOR_SIZE bytes.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_read (void *d, block_sector_t sec_no, void *buffer)
+{
+  ide_read_multiple (d, sec_no, buffer, 1);
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
@@ -362,38 +516,54 @@ ide_read (void *d_, block_sector_t sec_no, void *buffer)
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 static void
-ide_write (void *d_, block_sector_t sec_no, const void *buffer)
+ide_write (void *d, block_sector_t sec_no, const void *buffer)
 {
-  struct ata_disk *d = d_;
-  struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
-  lock_release (&c->lock);
+  ide_write_multiple (d, sec_no, buffer, 1);
 }
 
 static struct block_operations ide_operations =
   {
     ide_read,
-    ide_write
+    ide_write,
+    ide_read_multiple,
+    ide_write_multiple
   };
+
+/* Asks disk D to transfer SECTORS sectors per interrupt in READ
+   MULTIPLE and WRITE MULTIPLE commands, and records the result
+   in D->multiple.  SECTORS of 0 or 1 leaves multiple mode off. */
+static void
+set_multiple_mode (struct ata_disk *d, int sectors)
+{
+  struct channel *c = d->channel;
+
+  d->multiple = 0;
+  if (sectors <= 1)
+    return;
+
+  select_device_wait (d);
+  outb (reg_nsect (c), sectors);
+  issue_pio_command (c, CMD_SET_MULTIPLE_MODE);
+  sema_down (&c->completion_wait);
+  wait_while_busy (d);
+  if ((inb (reg_alt_status (c)) & STA_ERR) == 0)
+    d->multiple = sectors;
+}
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the count CNT, which must be between 1 and
+   MAX_COMMAND_SECTORS, to the disk's sector selection
+   registers.  (We use LBA mode.) */
 static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+select_sector (struct ata_disk *d, block_sector_t sec_no, block_sector_t cnt)
 {
   struct channel *c = d->channel;
 
   ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt >= 1 && cnt <= MAX_COMMAND_SECTORS);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt % MAX_COMMAND_SECTORS);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
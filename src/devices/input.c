@@ -1,52 +1,219 @@
 #include "devices/input.h"
 #include <debug.h>
-#include "devices/intq.h"
+#include <stdio.h>
+#include "devices/ring.h"
 #include "devices/serial.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
 
-/* Stores keys from the keyboard and serial port. */
-static struct intq buffer;
+/* Stores keys from the keyboard and serial port.  The keyboard
+   and serial interrupt handlers are the only producers, and they
+   cannot preempt each other; threads that read keys take
+   READ_LOCK, so that the ring has a single consumer. */
+#define INPUT_BUFSIZE 64
+static uint8_t buffer_buf[INPUT_BUFSIZE];
+static struct ring buffer;
+static struct lock read_lock;
+
+/* Canonical mode.  Keys are collected into LINE as they arrive,
+   with echo, backspace, and Ctrl+U handled right there, and go
+   into the buffer only as whole lines, ending in a new-line.  A
+   reader waiting in input_read() then wakes once per line
+   instead of once per key.  A line that would not fit in the
+   buffer goes in early, without its new-line.  LINE and LINE_LEN
+   belong to the interrupt handlers. */
+static bool canonical;
+static uint8_t line[INPUT_BUFSIZE];
+static size_t line_len;
+
+static void edit_line (uint8_t key);
+static void commit_line (void);
+static void erase_key (void);
 
 /* Initializes the input buffer. */
 void
 input_init (void) 
 {
-  intq_init (&buffer);
+  ring_init (&buffer, buffer_buf, 1, INPUT_BUFSIZE);
+  lock_init (&read_lock);
 }
 
-/* Adds a key to the input buffer.
-   Interrupts must be off and the buffer must not be full. */
+/* Adds a key to the input buffer, or in canonical mode to the
+   line being edited.  Interrupts must be off and input_full()
+   must be false. */
 void
 input_putc (uint8_t key) 
 {
   ASSERT (intr_get_level () == INTR_OFF);
-  ASSERT (!intq_full (&buffer));
+  ASSERT (!input_full ());
 
-  intq_putc (&buffer, key);
+  if (canonical)
+    edit_line (key);
+  else
+    ring_put (&buffer, &key, 1);
   serial_notify ();
 }
 
+/* Turns canonical mode on if ON is true, off otherwise, and
+   returns whether it was on.  A partly edited line is passed on
+   as it is when canonical mode is turned off. */
+bool
+input_set_canonical (bool on)
+{
+  enum intr_level old_level = intr_disable ();
+  bool was_on = canonical;
+
+  if (canonical && !on)
+    commit_line ();
+  canonical = on;
+  serial_notify ();
+  intr_set_level (old_level);
+  return was_on;
+}
+
 /* Retrieves a key from the input buffer.
    If the buffer is empty, waits for a key to be pressed. */
 uint8_t
 input_getc (void) 
 {
-  enum intr_level old_level;
   uint8_t key;
 
+  input_getbuf (&key, 1);
+  return key;
+}
+
+/* Retrieves N keys from the input buffer into BUF, taking as
+   many at a time as are buffered and waiting for more while
+   fewer than N have been read. */
+void
+input_getbuf (uint8_t *buf, size_t n)
+{
+  lock_acquire (&read_lock);
+  while (n > 0)
+    {
+      enum intr_level old_level;
+      size_t got = ring_get_wait (&buffer, buf, n);
+
+      buf += got;
+      n -= got;
+
+      /* There is room again, so receive interrupts may be
+         reenabled. */
+      old_level = intr_disable ();
+      serial_notify ();
+      intr_set_level (old_level);
+    }
+  lock_release (&read_lock);
+}
+
+/* Reads up to N keys into BUF and returns the number read,
+   taking as many as are buffered but waiting only until there is
+   at least one.  In canonical mode, reads at most one line,
+   including its new-line.  Returns 0 instead of waiting once
+   *STOP is true; whoever sets it then calls input_interrupt(). */
+size_t
+input_read (uint8_t *buf, size_t n, const volatile bool *stop)
+{
+  enum intr_level old_level;
+  size_t got;
+
+  if (n == 0)
+    return 0;
+
+  lock_acquire (&read_lock);
+  if (!canonical)
+    got = ring_get_wait_intr (&buffer, buf, n, stop);
+  else
+    {
+      /* The buffer holds whole lines, so the rest of this one is
+         already there. */
+      got = ring_get_wait_intr (&buffer, buf, 1, stop);
+      while (got > 0 && got < n && buf[got - 1] != '\n'
+             && ring_get (&buffer, buf + got, 1) == 1)
+        got++;
+    }
+
   old_level = intr_disable ();
-  key = intq_getc (&buffer);
   serial_notify ();
   intr_set_level (old_level);
-  
-  return key;
+  lock_release (&read_lock);
+  return got;
 }
 
-/* Returns true if the input buffer is full,
-   false otherwise.
+/* Wakes the thread waiting in input_read(), if any, to look at
+   its STOP flag again. */
+void
+input_interrupt (void)
+{
+  ring_interrupt (&buffer);
+}
+
+/* Returns true if the input buffer cannot take another key,
+   false otherwise.  In canonical mode, there must be room for
+   the line being edited, the key, and a new-line.
    Interrupts must be off. */
 bool
 input_full (void) 
 {
   ASSERT (intr_get_level () == INTR_OFF);
-  return intq_full (&buffer);
+  if (canonical)
+    return ring_space (&buffer) < line_len + 2;
+  return ring_full (&buffer);
+}
+
+/* Applies KEY to the line being edited in canonical mode. */
+static void
+edit_line (uint8_t key)
+{
+  switch (key)
+    {
+    case '\r':
+    case '\n':
+      line[line_len++] = '\n';
+      putchar ('\n');
+      commit_line ();
+      break;
+
+    case '\b':
+    case 0x7f:
+      if (line_len > 0)
+        erase_key ();
+      break;
+
+    case ('U' - 'A') + 1:       /* Ctrl+U. */
+      while (line_len > 0)
+        erase_key ();
+      break;
+
+    default:
+      line[line_len++] = key;
+      putchar (key);
+
+      /* Pass the line on early if the next key could not be
+         taken, so that input_full() does not stay true while no
+         reader has anything to read. */
+      if (ring_space (&buffer) < line_len + 2)
+        commit_line ();
+      break;
+    }
+}
+
+/* Moves the line being edited in canonical mode into the
+   buffer. */
+static void
+commit_line (void)
+{
+  ASSERT (line_len <= ring_space (&buffer));
+
+  ring_put (&buffer, line, line_len);
+  line_len = 0;
+}
+
+/* Removes the last key of the line being edited in canonical
+   mode, and from the screen. */
+static void
+erase_key (void)
+{
+  line_len--;
+  putbuf ("\b \b", 3);
 }
@@ -2,11 +2,16 @@
 #define DEVICES_INPUT_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 void input_init (void);
 void input_putc (uint8_t);
 uint8_t input_getc (void);
+void input_getbuf (uint8_t *, size_t);
+size_t input_read (uint8_t *, size_t, const volatile bool *stop);
+void input_interrupt (void);
 bool input_full (void);
+bool input_set_canonical (bool);
 
 #endif /* devices/input.h */
@@ -0,0 +1,85 @@
+#include "devices/pci.h"
+#include <stdbool.h>
+#include "threads/io.h"
+
+/* PCI configuration space, reached through configuration
+   mechanism #1: a 32-bit address written to PCI_CONFIG_ADDR
+   selects a register of some bus, device, and function, which is
+   then read or written through PCI_CONFIG_DATA.  Only bus 0 is
+   scanned, which is where emulators put their devices. */
+
+#define PCI_CONFIG_ADDR 0xcf8
+#define PCI_CONFIG_DATA 0xcfc
+
+/* Number of devices on a bus and functions in a device. */
+#define PCI_DEV_CNT 32
+#define PCI_FUNC_CNT 8
+
+/* Selects register REG of D for PCI_CONFIG_DATA, and returns
+   the port through which to access REG's bytes. */
+static uint16_t
+select_reg (const struct pci_device *d, uint8_t reg)
+{
+  outl (PCI_CONFIG_ADDR, (0x80000000u | (uint32_t) d->bus << 16
+                          | (uint32_t) d->dev << 11
+                          | (uint32_t) d->func << 8 | (reg & 0xfc)));
+  return PCI_CONFIG_DATA + (reg & 3);
+}
+
+/* Calls PROBE for each function on bus 0 whose vendor and
+   device IDs are VENDOR_ID and DEVICE_ID. */
+void
+pci_scan (uint16_t vendor_id, uint16_t device_id, pci_probe_func *probe)
+{
+  struct pci_device d;
+
+  d.bus = 0;
+  for (d.dev = 0; d.dev < PCI_DEV_CNT; d.dev++)
+    {
+      int func_cnt = 1;
+
+      for (d.func = 0; d.func < func_cnt; d.func++)
+        {
+          uint16_t vendor = pci_read16 (&d, PCI_VENDOR_ID);
+
+          if (vendor == 0xffff)
+            continue;
+          if (d.func == 0 && (pci_read8 (&d, PCI_HEADER_TYPE) & 0x80))
+            func_cnt = PCI_FUNC_CNT;
+          if (vendor == vendor_id
+              && pci_read16 (&d, PCI_DEVICE_ID) == device_id)
+            probe (&d);
+        }
+    }
+}
+
+/* Returns the 32-bit configuration register REG of D, which
+   must be 4-byte aligned. */
+uint32_t
+pci_read32 (const struct pci_device *d, uint8_t reg)
+{
+  return inl (select_reg (d, reg));
+}
+
+/* Returns the 16-bit configuration register REG of D, which
+   must be 2-byte aligned. */
+uint16_t
+pci_read16 (const struct pci_device *d, uint8_t reg)
+{
+  return inw (select_reg (d, reg));
+}
+
+/* Returns the 8-bit configuration register REG of D. */
+uint8_t
+pci_read8 (const struct pci_device *d, uint8_t reg)
+{
+  return inb (select_reg (d, reg));
+}
+
+/* Sets the 16-bit configuration register REG of D, which must be
+   2-byte aligned, to VALUE. */
+void
+pci_write16 (const struct pci_device *d, uint8_t reg, uint16_t value)
+{
+  outw (select_reg (d, reg), value);
+}
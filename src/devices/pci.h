@@ -0,0 +1,36 @@
+#ifndef DEVICES_PCI_H
+#define DEVICES_PCI_H
+
+#include <stdint.h>
+
+/* Offsets of registers in a PCI device's configuration space. */
+#define PCI_VENDOR_ID 0x00      /* 16 bits. */
+#define PCI_DEVICE_ID 0x02      /* 16 bits. */
+#define PCI_COMMAND 0x04        /* 16 bits. */
+#define PCI_HEADER_TYPE 0x0e    /* 8 bits. */
+#define PCI_BAR0 0x10           /* 32 bits, then BAR1...BAR5. */
+#define PCI_INTERRUPT_LINE 0x3c /* 8 bits. */
+
+/* PCI_COMMAND bits. */
+#define PCI_COMMAND_IO 0x0001           /* Respond to I/O space. */
+#define PCI_COMMAND_MEMORY 0x0002       /* Respond to memory space. */
+#define PCI_COMMAND_MASTER 0x0004       /* Allow bus mastering (DMA). */
+
+/* A function of a device on the PCI bus. */
+struct pci_device
+  {
+    uint8_t bus;                /* Bus number. */
+    uint8_t dev;                /* Device number on the bus. */
+    uint8_t func;               /* Function number in the device. */
+  };
+
+typedef void pci_probe_func (const struct pci_device *);
+
+void pci_scan (uint16_t vendor_id, uint16_t device_id, pci_probe_func *);
+
+uint32_t pci_read32 (const struct pci_device *, uint8_t reg);
+uint16_t pci_read16 (const struct pci_device *, uint8_t reg);
+uint8_t pci_read8 (const struct pci_device *, uint8_t reg);
+void pci_write16 (const struct pci_device *, uint8_t reg, uint16_t);
+
+#endif /* devices/pci.h */
@@ -0,0 +1,124 @@
+#include "devices/ramdisk.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* RAM disk.
+
+   A block device whose sectors live in pages of the kernel pool,
+   for a file system, swap, or scratch space that costs no device
+   time.  It is registered as "rd0", of type BLOCK_RAW, so it
+   takes a role only when named with -filesys, -scratch, or -swap.
+   It starts out as zeros and its contents are lost at shutdown. */
+
+/* Number of sectors in a page. */
+#define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* The pages that hold the disk's sectors, in order. */
+static uint8_t **pages;
+
+static struct block_operations ramdisk_operations;
+
+/* Creates a RAM disk of SIZE_KB kB, rounded up to whole pages,
+   and registers it.  Does nothing if SIZE_KB is 0.  Panics if
+   the kernel pool cannot hold it. */
+void
+ramdisk_init (size_t size_kb)
+{
+  size_t page_cnt = DIV_ROUND_UP (size_kb * 1024, PGSIZE);
+  size_t i;
+
+  if (page_cnt == 0)
+    return;
+
+  pages = malloc (page_cnt * sizeof *pages);
+  if (pages == NULL)
+    PANIC ("ramdisk: out of memory");
+  for (i = 0; i < page_cnt; i++)
+    {
+      pages[i] = palloc_get_page (PAL_ZERO);
+      if (pages[i] == NULL)
+        PANIC ("ramdisk: kernel pool too small for %zu kB", size_kb);
+    }
+
+  block_register ("rd0", BLOCK_RAW, "RAM disk", page_cnt * SECTORS_PER_PAGE,
+                  &ramdisk_operations, NULL);
+}
+
+/* Returns the address of SECTOR's data, and stores into *CNT the
+   number of sectors, at most *CNT, that follow it in the same
+   page. */
+static uint8_t *
+sector_addr (block_sector_t sector, block_sector_t *cnt)
+{
+  block_sector_t ofs = sector % SECTORS_PER_PAGE;
+
+  if (*cnt > SECTORS_PER_PAGE - ofs)
+    *cnt = SECTORS_PER_PAGE - ofs;
+  return pages[sector / SECTORS_PER_PAGE] + ofs * BLOCK_SECTOR_SIZE;
+}
+
+/* Reads CNT sectors starting at SECTOR into BUFFER. */
+static void
+ramdisk_read_multiple (void *aux UNUSED, block_sector_t sector,
+                       void *buffer, block_sector_t cnt)
+{
+  uint8_t *dst = buffer;
+
+  while (cnt > 0)
+    {
+      block_sector_t chunk = cnt;
+      const uint8_t *src = sector_addr (sector, &chunk);
+
+      memcpy (dst, src, chunk * BLOCK_SECTOR_SIZE);
+      dst += chunk * BLOCK_SECTOR_SIZE;
+      sector += chunk;
+      cnt -= chunk;
+    }
+}
+
+/* Writes CNT sectors starting at SECTOR from BUFFER. */
+static void
+ramdisk_write_multiple (void *aux UNUSED, block_sector_t sector,
+                        const void *buffer, block_sector_t cnt)
+{
+  const uint8_t *src = buffer;
+
+  while (cnt > 0)
+    {
+      block_sector_t chunk = cnt;
+      uint8_t *dst = sector_addr (sector, &chunk);
+
+      memcpy (dst, src, chunk * BLOCK_SECTOR_SIZE);
+      src += chunk * BLOCK_SECTOR_SIZE;
+      sector += chunk;
+      cnt -= chunk;
+    }
+}
+
+/* Reads SECTOR into BUFFER. */
+static void
+ramdisk_read (void *aux, block_sector_t sector, void *buffer)
+{
+  ramdisk_read_multiple (aux, sector, buffer, 1);
+}
+
+/* Writes SECTOR from BUFFER. */
+static void
+ramdisk_write (void *aux, block_sector_t sector, const void *buffer)
+{
+  ramdisk_write_multiple (aux, sector, buffer, 1);
+}
+
+static struct block_operations ramdisk_operations =
+  {
+    ramdisk_read,
+    ramdisk_write,
+    ramdisk_read_multiple,
+    ramdisk_write_multiple
+  };
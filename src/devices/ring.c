@@ -0,0 +1,255 @@
+#include "devices/ring.h"
+#include <debug.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static void copy_in (struct ring *, size_t pos, const uint8_t *, size_t cnt);
+static void copy_out (const struct ring *, size_t pos, uint8_t *,
+                      size_t cnt);
+static void wait (struct ring *, struct thread *volatile *waiter,
+                  const volatile bool *stop);
+static void wake (struct thread *volatile *waiter, bool io);
+
+/* Initializes R to hold up to SIZE elements of ELEM_SIZE bytes
+   each in BUF, which must be SIZE * ELEM_SIZE bytes long and
+   outlive R.  SIZE must be a power of 2. */
+void
+ring_init (struct ring *r, void *buf, size_t elem_size, size_t size)
+{
+  ASSERT (r != NULL && buf != NULL);
+  ASSERT (elem_size > 0);
+  ASSERT (size > 0 && (size & (size - 1)) == 0);
+
+  r->buf = buf;
+  r->elem_size = elem_size;
+  r->size = size;
+  r->head = r->tail = 0;
+  r->not_empty = r->not_full = NULL;
+}
+
+/* Returns the number of elements in R.  Exact when called by
+   either side, since the count can then only move in the
+   direction the other side moves it. */
+size_t
+ring_count (const struct ring *r)
+{
+  return r->head - r->tail;
+}
+
+/* Returns the number of elements that may be added to R. */
+size_t
+ring_space (const struct ring *r)
+{
+  return r->size - ring_count (r);
+}
+
+/* Returns true if R is empty, false otherwise. */
+bool
+ring_empty (const struct ring *r)
+{
+  return r->head == r->tail;
+}
+
+/* Returns true if R is full, false otherwise. */
+bool
+ring_full (const struct ring *r)
+{
+  return ring_count (r) == r->size;
+}
+
+/* Adds up to CNT elements from SRC to the end of R, as many as
+   fit, and returns the number added.  Never sleeps, so it may be
+   called from an interrupt handler.  Wakes a consumer waiting in
+   ring_get_wait(), if any elements were added. */
+size_t
+ring_put (struct ring *r, const void *src, size_t cnt)
+{
+  size_t space = ring_space (r);
+
+  if (cnt > space)
+    cnt = space;
+  if (cnt == 0)
+    return 0;
+
+  copy_in (r, r->head, src, cnt);
+
+  /* The consumer must see the elements before the new HEAD. */
+  barrier ();
+  r->head += cnt;
+  barrier ();
+
+  /* Elements put by an interrupt handler came from a device. */
+  if (r->not_empty != NULL)
+    wake (&r->not_empty, intr_context ());
+  return cnt;
+}
+
+/* Removes up to CNT elements from the front of R into DST, as
+   many as there are, and returns the number removed.  Never
+   sleeps, so it may be called from an interrupt handler.  Wakes a
+   producer waiting in ring_put_wait() once R is half empty. */
+size_t
+ring_get (struct ring *r, void *dst, size_t cnt)
+{
+  size_t avail = ring_count (r);
+
+  if (cnt > avail)
+    cnt = avail;
+  if (cnt == 0)
+    return 0;
+
+  copy_out (r, r->tail, dst, cnt);
+
+  /* The elements must be copied out before the producer may
+     reuse their slots. */
+  barrier ();
+  r->tail += cnt;
+  barrier ();
+
+  if (r->not_full != NULL && ring_space (r) >= r->size / 2)
+    wake (&r->not_full, false);
+  return cnt;
+}
+
+/* Adds all CNT elements from SRC to the end of R, sleeping
+   whenever R is full.  Must be called from a kernel thread. */
+void
+ring_put_wait (struct ring *r, const void *src_, size_t cnt)
+{
+  const uint8_t *src = src_;
+
+  for (;;)
+    {
+      size_t put = ring_put (r, src, cnt);
+      src += put * r->elem_size;
+      cnt -= put;
+      if (cnt == 0)
+        break;
+      wait (r, &r->not_full, NULL);
+    }
+}
+
+/* Removes at least one and up to CNT elements from the front of R
+   into DST, sleeping until R is nonempty, and returns the number
+   removed.  CNT must be nonzero.  Must be called from a kernel
+   thread. */
+size_t
+ring_get_wait (struct ring *r, void *dst, size_t cnt)
+{
+  ASSERT (cnt > 0);
+
+  for (;;)
+    {
+      size_t got = ring_get (r, dst, cnt);
+      if (got > 0)
+        return got;
+      wait (r, &r->not_empty, NULL);
+    }
+}
+
+/* Like ring_get_wait(), but returns 0 instead of sleeping once
+   *STOP is true.  Whoever sets *STOP must then call
+   ring_interrupt() to wake a consumer already asleep. */
+size_t
+ring_get_wait_intr (struct ring *r, void *dst, size_t cnt,
+                    const volatile bool *stop)
+{
+  ASSERT (cnt > 0);
+
+  for (;;)
+    {
+      size_t got = ring_get (r, dst, cnt);
+      if (got > 0 || *stop)
+        return got;
+      wait (r, &r->not_empty, stop);
+    }
+}
+
+/* Wakes R's consumer, if it is asleep, so that one in
+   ring_get_wait_intr() looks at its STOP flag again.  One in
+   ring_get_wait() just goes back to sleep. */
+void
+ring_interrupt (struct ring *r)
+{
+  wake (&r->not_empty, false);
+}
+
+/* Copies CNT elements from SRC into R starting at position POS,
+   wrapping around the end of the buffer. */
+static void
+copy_in (struct ring *r, size_t pos, const uint8_t *src, size_t cnt)
+{
+  size_t ofs = pos & (r->size - 1);
+  size_t first = cnt < r->size - ofs ? cnt : r->size - ofs;
+
+  memcpy (r->buf + ofs * r->elem_size, src, first * r->elem_size);
+  memcpy (r->buf, src + first * r->elem_size,
+          (cnt - first) * r->elem_size);
+}
+
+/* Copies CNT elements of R starting at position POS into DST,
+   wrapping around the end of the buffer. */
+static void
+copy_out (const struct ring *r, size_t pos, uint8_t *dst, size_t cnt)
+{
+  size_t ofs = pos & (r->size - 1);
+  size_t first = cnt < r->size - ofs ? cnt : r->size - ofs;
+
+  memcpy (dst, r->buf + ofs * r->elem_size, first * r->elem_size);
+  memcpy (dst + first * r->elem_size, r->buf,
+          (cnt - first) * r->elem_size);
+}
+
+/* WAITER must be the address of R's not_empty or not_full
+   member.  Sleeps until the other side wakes us, unless the
+   condition waited for has already changed or STOP, if nonnull,
+   points to true.  Interrupts are off
+   only from the final check until we are asleep, so that a wakeup
+   cannot slip in between. */
+static void
+wait (struct ring *r, struct thread *volatile *waiter,
+      const volatile bool *stop)
+{
+  enum intr_level old_level;
+
+  ASSERT (!intr_context ());
+  ASSERT (waiter == &r->not_empty || waiter == &r->not_full);
+
+  old_level = intr_disable ();
+  if ((stop == NULL || !*stop)
+      && (waiter == &r->not_empty ? ring_empty (r) : ring_full (r)))
+    {
+      ASSERT (*waiter == NULL);
+      *waiter = thread_current ();
+      thread_block ();
+    }
+  intr_set_level (old_level);
+}
+
+/* Wakes and resets the thread in WAITER, if there still is one.
+   If IO is true, we are in the handler of the device interrupt
+   that put the elements, so the thread gets thread_unblock_io()'s
+   boost and preempts the running thread if that puts it
+   ahead. */
+static void
+wake (struct thread *volatile *waiter, bool io)
+{
+  enum intr_level old_level = intr_disable ();
+  struct thread *t = *waiter;
+
+  if (t != NULL)
+    {
+      *waiter = NULL;
+      if (!io)
+        thread_unblock (t);
+      else
+        {
+          thread_unblock_io (t);
+          if (thread_preempts (t))
+            intr_yield_on_return ();
+        }
+    }
+  intr_set_level (old_level);
+}
@@ -0,0 +1,53 @@
+#ifndef DEVICES_RING_H
+#define DEVICES_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* A single-producer, single-consumer ring buffer of fixed-size
+   elements.
+
+   Unlike an intq, a ring needs no interrupts disabled to move
+   data: the producer only ever writes HEAD and the consumer only
+   ever writes TAIL, so one side may be an external interrupt
+   handler and the other a kernel thread.  Each side must still
+   be a single context, or be serialized by its callers; for
+   example, several threads consuming from one ring must hold a
+   lock around ring_get().
+
+   Data moves in bulk: ring_put() and ring_get() copy as many
+   elements as fit in one call.  Wakeups are batched as well.  A
+   consumer blocked in ring_get_wait() is woken once per
+   ring_put() that adds anything, and a producer blocked in
+   ring_put_wait() is woken only once the ring is at least half
+   empty, so that it has room for a real batch when it runs. */
+
+/* Ring buffer. */
+struct ring
+  {
+    uint8_t *buf;               /* SIZE elements. */
+    size_t elem_size;           /* Bytes per element. */
+    size_t size;                /* Capacity in elements, a power of 2. */
+    volatile size_t head;       /* Elements ever put, by the producer. */
+    volatile size_t tail;       /* Elements ever taken, by the consumer. */
+    struct thread *volatile not_empty;  /* Consumer waiting for data. */
+    struct thread *volatile not_full;   /* Producer waiting for room. */
+  };
+
+void ring_init (struct ring *, void *buf, size_t elem_size, size_t size);
+
+size_t ring_count (const struct ring *);
+size_t ring_space (const struct ring *);
+bool ring_empty (const struct ring *);
+bool ring_full (const struct ring *);
+
+size_t ring_put (struct ring *, const void *, size_t cnt);
+size_t ring_get (struct ring *, void *, size_t cnt);
+void ring_put_wait (struct ring *, const void *, size_t cnt);
+size_t ring_get_wait (struct ring *, void *, size_t cnt);
+size_t ring_get_wait_intr (struct ring *, void *, size_t cnt,
+                           const volatile bool *stop);
+void ring_interrupt (struct ring *);
+
+#endif /* devices/ring.h */
@@ -1,7 +1,7 @@
 #include "devices/serial.h"
 #include <debug.h>
 #include "devices/input.h"
-#include "devices/intq.h"
+#include "devices/ring.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
@@ -30,7 +30,16 @@
 #define IIR_REG (IO_BASE + 2)   /* Interrupt Identification Reg. (read-only) */
 #define FCR_REG (IO_BASE + 2)   /* FIFO Control Reg. (write-only). */
 #define LCR_REG (IO_BASE + 3)   /* Line Control Register. */
-#define MCR_REG (IO_BASE + 4)   /* MODEM Control Register. */
+#define MCR_REG (IO_BASE + 4)   /* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01         /* Enable receive and transmit FIFOs. */
+#define FCR_CLEAR_RX 0x02       /* Discard receive FIFO contents. */
+#define FCR_CLEAR_TX 0x04       /* Discard transmit FIFO contents. */
+
+/* Bytes the 16550A's transmit FIFO holds.  Whenever LSR_THRE is
+   set, this many may be written to THR_REG without waiting. */
+#define TX_FIFO_SIZE 16
+
+/* MODEM Control Register. */
 #define LSR_REG (IO_BASE + 5)   /* Line Status Register (read-only). */
 
 /* Interrupt Enable Register bits. */
@@ -41,21 +50,35 @@
 #define LCR_N81 0x03            /* No parity, 8 data bits, 1 stop bit. */
 #define LCR_DLAB 0x80           /* Divisor Latch Access Bit (DLAB). */
 
+/* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01         /* Enable receive and transmit FIFOs. */
+#define FCR_CLEAR_RX 0x02       /* Discard receive FIFO contents. */
+#define FCR_CLEAR_TX 0x04       /* Discard transmit FIFO contents. */
+
+/* Bytes the 16550A's transmit FIFO holds.  Whenever LSR_THRE is
+   set, this many may be written to THR_REG without waiting. */
+#define TX_FIFO_SIZE 16
+
 /* MODEM Control Register. */
 #define MCR_OUT2 0x08           /* Output line 2. */
 
 /* Line Status Register. */
 #define LSR_DR 0x01             /* Data Ready: received data byte is in RBR. */
-#define LSR_THRE 0x20           /* THR Empty. */
+#define LSR_THRE 0x20           /* THR Empty (whole FIFO, with FIFO on). */
 
 /* Transmission mode. */
 static enum { UNINIT, POLL, QUEUE } mode;
 
 /* Data to be transmitted. */
-static struct intq txq;
+#define TXQ_SIZE 64
+static uint8_t txq_buf[TXQ_SIZE];
+static struct ring txq;
 
 static void set_serial (int bps);
 static void putc_poll (uint8_t);
+static void putbuf_poll (const uint8_t *, size_t);
+static void poll_burst (void);
+static void fill_fifo (void);
 static void write_ier (void);
 static intr_handler_func serial_interrupt;
 
@@ -68,10 +91,10 @@ init_poll (void)
 {
   ASSERT (mode == UNINIT);
   outb (IER_REG, 0);                    /* Turn off all interrupts. */
-  outb (FCR_REG, 0);                    /* Disable FIFO. */
+  outb (FCR_REG, FCR_ENABLE | FCR_CLEAR_RX | FCR_CLEAR_TX);
   set_serial (9600);                    /* 9.6 kbps, N-8-1. */
   outb (MCR_REG, MCR_OUT2);             /* Required to enable interrupts. */
-  intq_init (&txq);
+  ring_init (&txq, txq_buf, 1, TXQ_SIZE);
   mode = POLL;
 } 
 
@@ -112,31 +135,78 @@ serial_putc (uint8_t byte)
     {
       /* Otherwise, queue a byte and update the interrupt enable
          register. */
-      if (old_level == INTR_OFF && intq_full (&txq)) 
+      if (old_level == INTR_OFF && ring_full (&txq)) 
         {
           /* Interrupts are off and the transmit queue is full.
              If we wanted to wait for the queue to empty,
              we'd have to reenable interrupts.
              That's impolite, so we'll send a character via
              polling instead. */
-          putc_poll (intq_getc (&txq)); 
+          poll_burst ();
         }
 
-      intq_putc (&txq, byte); 
+      ring_put_wait (&txq, &byte, 1);
       write_ier ();
     }
   
   intr_set_level (old_level);
 }
 
+/* Sends the N bytes in BUFFER to the serial port.  Like calling
+   serial_putc() on each byte, but bytes are queued as many at a
+   time as fit, and interrupts are disabled and the interrupt
+   enable register updated only once for the lot, unless the
+   transmit queue fills up on the way.  Before queued mode is set
+   up, the bytes are polled out a FIFO's worth at a time. */
+void
+serial_putbuf (const uint8_t *buffer, size_t n)
+{
+  enum intr_level old_level;
+
+  if (mode != QUEUE)
+    {
+      old_level = intr_disable ();
+      if (mode == UNINIT)
+        init_poll ();
+      putbuf_poll (buffer, n);
+      intr_set_level (old_level);
+      return;
+    }
+
+  old_level = intr_disable ();
+  for (;;)
+    {
+      size_t put = ring_put (&txq, buffer, n);
+      buffer += put;
+      n -= put;
+      if (n == 0)
+        break;
+
+      /* Start the port on what is queued before waiting for
+         room, or poll a byte out if we may not wait, as in
+         serial_putc().  The transmit interrupt wakes us once
+         half the queue is free. */
+      write_ier ();
+      if (old_level == INTR_OFF)
+        poll_burst ();
+      else
+        {
+          ring_put_wait (&txq, buffer, n);
+          break;
+        }
+    }
+  write_ier ();
+  intr_set_level (old_level);
+}
+
 /* Flushes anything in the serial buffer out the port in polling
    mode. */
 void
 serial_flush (void) 
 {
   enum intr_level old_level = intr_disable ();
-  while (!intq_empty (&txq))
-    putc_poll (intq_getc (&txq));
+  while (!ring_empty (&txq))
+    poll_burst ();
   intr_set_level (old_level);
 }
 
@@ -182,7 +252,7 @@ write_ier (void)
 
   /* Enable transmit interrupt if we have any characters to
      transmit. */
-  if (!intq_empty (&txq))
+  if (!ring_empty (&txq))
     ier |= IER_XMIT;
 
   /* Enable receive interrupt if we have room to store any
@@ -205,6 +275,52 @@ putc_poll (uint8_t byte)
   outb (THR_REG, byte);
 }
 
+/* Polls the serial port until its transmit FIFO is empty, then
+   fills it from the N bytes in BUFFER, repeating until all have
+   been sent. */
+static void
+putbuf_poll (const uint8_t *buffer, size_t n)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (n > 0)
+    {
+      size_t chunk = n < TX_FIFO_SIZE ? n : TX_FIFO_SIZE;
+
+      while ((inb (LSR_REG) & LSR_THRE) == 0)
+        continue;
+      n -= chunk;
+      while (chunk-- > 0)
+        outb (THR_REG, *buffer++);
+    }
+}
+
+/* Polls the serial port until its transmit FIFO is empty, then
+   moves up to a FIFO's worth of bytes from the transmit queue,
+   which must not be empty, into it. */
+static void
+poll_burst (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while ((inb (LSR_REG) & LSR_THRE) == 0)
+    continue;
+  fill_fifo ();
+}
+
+/* Moves up to a FIFO's worth of bytes from the transmit queue to
+   the UART, whose transmit FIFO must be empty. */
+static void
+fill_fifo (void)
+{
+  uint8_t buf[TX_FIFO_SIZE];
+  size_t n = ring_get (&txq, buf, sizeof buf);
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    outb (THR_REG, buf[i]);
+}
+
 /* Serial interrupt handler. */
 static void
 serial_interrupt (struct intr_frame *f UNUSED) 
@@ -218,10 +334,10 @@ serial_interrupt (struct intr_frame *f UNUSED)
   while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
     input_putc (inb (RBR_REG));
 
-  /* As long as we have a byte to transmit, and the hardware is
-     ready to accept a byte for transmission, transmit a byte. */
-  while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0) 
-    outb (THR_REG, intq_getc (&txq));
+  /* If we have bytes to transmit and the transmit FIFO has
+     drained, refill it, up to 16 bytes per interrupt. */
+  if (!ring_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0) 
+    fill_fifo ();
 
   /* Update interrupt enable register based on queue status. */
   write_ier ();
@@ -1,16 +1,34 @@
 #include "devices/shutdown.h"
 #include <console.h>
 #include <stdio.h>
+#include <stdbool.h>
 #include "devices/kbd.h"
 #include "devices/serial.h"
 #include "devices/timer.h"
+#include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/kmem.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/profile.h"
+#include "threads/shrinker.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "userprog/syscall.h"
+#endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
 #endif
 #ifdef FILESYS
 #include "devices/block.h"
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #endif
 
@@ -20,6 +38,9 @@
 /* How to shut down when shutdown() is called. */
 static enum shutdown_type how = SHUTDOWN_NONE;
 
+/* Power off without writing back the file system? */
+static bool crash;
+
 static void print_stats (void);
 
 /* Shuts down the machine in the way configured by
@@ -52,6 +73,15 @@ shutdown_configure (enum shutdown_type type)
   how = type;
 }
 
+/* Makes shutdown_power_off() leave the file system as a power
+   failure would, with committed journal transactions not yet
+   written to their homes, so that the next boot must recover. */
+void
+shutdown_configure_crash (void)
+{
+  crash = true;
+}
+
 /* Reboots the machine via the keyboard controller. */
 void
 shutdown_reboot (void)
@@ -91,10 +121,12 @@ shutdown_power_off (void)
   const char *p;
 
 #ifdef FILESYS
-  filesys_done ();
+  if (!crash)
+    filesys_done ();
 #endif
 
   print_stats ();
+  trace_dump ();
 
   printf ("Powering off...\n");
   serial_flush ();
@@ -126,13 +158,29 @@ static void
 print_stats (void)
 {
   timer_print_stats ();
+  intr_print_stats ();
   thread_print_stats ();
+  lock_print_stats ();
+  kmem_print_stats ();
+  shrinker_print_stats ();
+  malloc_print_stats ();
+  palloc_print_stats ();
 #ifdef FILESYS
   block_print_stats ();
+  cache_print_stats ();
+#endif
+#ifdef VM
+  page_print_stats ();
+  frame_print_stats ();
+  swap_print_stats ();
+  pagedir_print_stats ();
 #endif
   console_print_stats ();
   kbd_print_stats ();
+  profile_print_stats ();
 #ifdef USERPROG
   exception_print_stats ();
+  syscall_print_stats ();
+  process_print_stats ();
 #endif
 }
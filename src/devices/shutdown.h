@@ -13,6 +13,7 @@ enum shutdown_type
 
 void shutdown (void);
 void shutdown_configure (enum shutdown_type);
+void shutdown_configure_crash (void);
 void shutdown_reboot (void) NO_RETURN;
 void shutdown_power_off (void) NO_RETURN;
 
@@ -3,10 +3,14 @@
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
+#include <vdata.h>
 #include "devices/pit.h"
+#include "threads/palloc.h"
 #include "threads/interrupt.h"
+#include "threads/profile.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
   
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -20,15 +24,109 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* If true, the idle thread stops the periodic tick and programs
+   a one-shot interrupt for the next tick with work to do.
+   Controlled by kernel command-line option "-tickless". */
+bool timer_tickless;
+
+/* PIT cycles per timer tick, as programmed by timer_init(). */
+#define TIMER_PERIOD ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Most ticks a single one-shot count can cover. */
+#define TIMER_IDLE_MAX (UINT16_MAX / TIMER_PERIOD)
+
+/* floor((2**64 - 1) / TIMER_PERIOD), folded at compile time, for
+   cycles_to_ticks(). */
+#define TIMER_PERIOD_RECIP (UINT64_MAX / TIMER_PERIOD)
+
+/* Returns the high 64 bits of the 128-bit product of A and B. */
+static inline uint64_t
+mul_hi64 (uint64_t a, uint64_t b)
+{
+  uint64_t a0 = (uint32_t) a, a1 = a >> 32;
+  uint64_t b0 = (uint32_t) b, b1 = b >> 32;
+  uint64_t p01 = a0 * b1, p10 = a1 * b0;
+  uint64_t mid = ((a0 * b0) >> 32) + (uint32_t) p01 + (uint32_t) p10;
+
+  return a1 * b1 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+}
+
+/* Returns CYCLES, which must be nonnegative, divided by
+   TIMER_PERIOD, and stores the remainder in *REM.  The timer
+   interrupt does this on every one-shot expiry, and a 64-bit
+   division by a constant is an out-of-line call on x86, so this
+   multiplies by TIMER_PERIOD_RECIP instead.  Because CYCLES is
+   below 2**63, the estimate is short by at most one, which the
+   remainder reveals. */
+static inline int64_t
+cycles_to_ticks (int64_t cycles, int64_t *rem)
+{
+  uint64_t q = mul_hi64 (cycles, TIMER_PERIOD_RECIP);
+  uint64_t r = cycles - q * TIMER_PERIOD;
+
+  ASSERT (cycles >= 0);
+  if (r >= TIMER_PERIOD)
+    {
+      q++;
+      r -= TIMER_PERIOD;
+    }
+  *rem = r;
+  return q;
+}
+
+/* While the PIT counts down once instead of ticking, the time
+   at which it will interrupt, in PIT cycles since boot;
+   otherwise 0. */
+static int64_t oneshot_end;
+
+/* A thread sleeping in timer_hrsleep(). */
+struct hr_sleeper
+  {
+    struct list_elem elem;      /* Element in hr_sleepers. */
+    int64_t deadline;           /* Wake-up time in PIT cycles. */
+    struct thread *thread;      /* Sleeping thread. */
+  };
+
+/* Threads sleeping for less than a tick, soonest first. */
+static struct list hr_sleepers;
+
+/* Wakes the threads whose timer_sleep() has ended.  The timer
+   interrupt defers this, since any number of threads may be due
+   on one tick. */
+static struct intr_work wakeup_work;
+
+/* With -calibrate=LOOPS, busy-wait loops per second, so that
+   timer_calibrate() need not measure them. */
+unsigned timer_loops_per_sec;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* TSC cycles per second, measured against the PIT by
+   timer_calibrate(), and the TSC value at which clock_ns()
+   starts counting. */
+static uint64_t tsc_hz;
+static uint64_t tsc_base;
+
+/* Page that user processes read the tick count and TSC rate
+   from, mapped into each of them at VDATA_ADDR. */
+static struct vdata *vdata;
+
 static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
+static void timer_hrsleep (int64_t cycles);
+static int64_t timer_now (void);
+static int64_t timer_next_event (void);
+static void timer_one_shot (int64_t now, int64_t end);
+static void hr_wakeup (int64_t now);
+static void tsc_sample (uint64_t *tsc, int64_t *pit);
+static void vdata_update (void);
+static void wakeup_sleepers (void *aux);
+static list_less_func hr_sleeper_less;
 
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
@@ -36,36 +134,101 @@ void
 timer_init (void) 
 {
   pit_configure_channel (0, 2, TIMER_FREQ);
+  vdata = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  list_init (&hr_sleepers);
+  intr_work_init (&wakeup_work, wakeup_sleepers, NULL);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Calibrates loops_per_tick, used to implement brief delays,
+   and the TSC rate, used by clock_ns(). */
 void
 timer_calibrate (void) 
 {
   unsigned high_bit, test_bit;
+  uint64_t tsc0, tsc1;
+  int64_t pit0, pit1;
 
   ASSERT (intr_get_level () == INTR_ON);
   printf ("Calibrating timer...  ");
+  tsc_sample (&tsc0, &pit0);
 
-  /* Approximate loops_per_tick as the largest power-of-two
-     still less than one timer tick. */
-  loops_per_tick = 1u << 10;
-  while (!too_many_loops (loops_per_tick << 1)) 
+  if (timer_loops_per_sec / TIMER_FREQ != 0)
+    {
+      /* Use the rate that an earlier boot printed, given with
+         -calibrate.  That leaves only the TSC to time, and a
+         couple of ticks are enough for that to within a few
+         dozen parts per million. */
+      int64_t start = ticks;
+
+      loops_per_tick = timer_loops_per_sec / TIMER_FREQ;
+      while (ticks - start < 2)
+        barrier ();
+    }
+  else
     {
-      loops_per_tick <<= 1;
-      ASSERT (loops_per_tick != 0);
+      /* Approximate loops_per_tick as the largest power-of-two
+         still less than one timer tick. */
+      loops_per_tick = 1u << 10;
+      while (!too_many_loops (loops_per_tick << 1)) 
+        {
+          loops_per_tick <<= 1;
+          ASSERT (loops_per_tick != 0);
+        }
+
+      /* Refine the next 8 bits of loops_per_tick. */
+      high_bit = loops_per_tick;
+      for (test_bit = high_bit >> 1; test_bit != high_bit >> 10;
+           test_bit >>= 1)
+        if (!too_many_loops (high_bit | test_bit))
+          loops_per_tick |= test_bit;
     }
 
-  /* Refine the next 8 bits of loops_per_tick. */
-  high_bit = loops_per_tick;
-  for (test_bit = high_bit >> 1; test_bit != high_bit >> 10; test_bit >>= 1)
-    if (!too_many_loops (high_bit | test_bit))
-      loops_per_tick |= test_bit;
+  /* Calibrating loops_per_tick takes a couple of dozen ticks,
+     long enough to time the TSC against the PIT to within a few
+     parts per million. */
+  tsc_sample (&tsc1, &pit1);
+  tsc_hz = (tsc1 - tsc0) * PIT_HZ / (pit1 - pit0);
+  tsc_base = tsc0;
+  intr_disable ();
+  vdata_update ();
+  intr_enable ();
 
   printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
 }
 
+/* Returns the number of nanoseconds since timer_calibrate(),
+   read from the TSC.  Returns 0 before then. */
+uint64_t
+clock_ns (void)
+{
+  if (tsc_hz == 0)
+    return 0;
+  return timer_cycles_to_ns (timer_cycles () - tsc_base);
+}
+
+/* Converts CYCLES, a difference between two values returned by
+   timer_cycles(), to nanoseconds.  Returns 0 before
+   timer_calibrate(). */
+uint64_t
+timer_cycles_to_ns (uint64_t cycles)
+{
+  if (tsc_hz == 0)
+    return 0;
+
+  /* Split the division so that the product cannot overflow. */
+  return (cycles / tsc_hz * 1000000000
+          + cycles % tsc_hz * 1000000000 / tsc_hz);
+}
+
+/* Returns the page of kernel data that user processes may read,
+   described in <vdata.h>. */
+void *
+timer_vdata (void)
+{
+  return vdata;
+}
+
 /* Returns the number of timer ticks since the OS booted. */
 int64_t
 timer_ticks (void) 
@@ -76,6 +239,17 @@ timer_ticks (void)
   return t;
 }
 
+/* Returns the CPU's time-stamp counter, which counts clock
+   cycles.  Good for timing intervals much shorter than a
+   tick. */
+uint64_t
+timer_cycles (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
 /* Returns the number of timer ticks elapsed since THEN, which
    should be a value once returned by timer_ticks(). */
 int64_t
@@ -170,16 +344,295 @@ void
 timer_print_stats (void) 
 {
   printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  printf ("Timer: %"PRIu64" TSC cycles per second\n", tsc_hz);
 }
 
 /* Timer interrupt handler. */
 static void
-timer_interrupt (struct intr_frame *args UNUSED)
+timer_interrupt (struct intr_frame *args)
 {
+  if (oneshot_end != 0)
+    {
+      int64_t end = oneshot_end;
+      int64_t rem;
+      int passed = cycles_to_ticks (end, &rem) - ticks;
+
+      oneshot_end = 0;
+      if (rem != 0)
+        {
+          /* Between ticks.  Past zero, the counter keeps counting
+             down from 65535, which tells how late we are. */
+          int64_t now = end + (uint16_t) -pit_read_counter (0);
+
+          if (passed > 0)
+            {
+              ticks += passed;
+              vdata_update ();
+              thread_skip_ticks (ticks, passed);
+              intr_defer (&wakeup_work);
+            }
+          hr_wakeup (now);
+          timer_one_shot (now, timer_next_event ());
+          return;
+        }
+
+      /* On a tick boundary: resume ticking.  Boundaries before
+         this one passed in the idle thread. */
+      pit_configure_channel (0, 2, TIMER_FREQ);
+      ticks += passed - 1;
+      thread_skip_ticks (ticks, passed - 1);
+    }
+
   ticks++;
+  vdata_update ();
+  if (profile_enabled)
+    profile_tick (args);
   thread_tick ();
+  intr_defer (&wakeup_work);
+  if (!list_empty (&hr_sleepers))
+    {
+      int64_t now = timer_now ();
+      int64_t event;
+
+      hr_wakeup (now);
+      event = timer_next_event ();
+      if (event < (ticks + 1) * TIMER_PERIOD)
+        timer_one_shot (now, event);
+    }
 }  
 
+/* Called by the idle thread, with interrupts off, just before it
+   halts.  In tickless mode, replaces the periodic tick by a
+   one-shot count that ends on the tick boundary where the next
+   sleeping thread or delayed work item is due, up to
+   TIMER_IDLE_MAX ticks away, or at the next timer_hrsleep()
+   deadline if that is sooner. */
+void
+timer_idle_begin (void)
+{
+  int64_t end;
+  int cnt;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!timer_tickless || oneshot_end != 0 || TIMER_IDLE_MAX < 2
+      || intr_ext_pending (0x20))
+    return;
+  cnt = workqueue_next_due (ticks, thread_next_wakeup (TIMER_IDLE_MAX));
+  if (cnt < 2)
+    return;
+
+  end = (ticks + cnt) * TIMER_PERIOD;
+  if (!list_empty (&hr_sleepers))
+    {
+      struct hr_sleeper *s = list_entry (list_front (&hr_sleepers),
+                                         struct hr_sleeper, elem);
+      if (s->deadline < end)
+        end = s->deadline;
+    }
+  timer_one_shot (timer_now (), end);
+}
+
+/* Called by the scheduler, with interrupts off, whenever the idle
+   thread gives up the CPU.  If an interrupt other than the timer
+   ended the idle period early, accounts for the ticks that have
+   passed and rearms the timer to interrupt no later than the next
+   tick boundary, where timer_interrupt() resumes ticking. */
+void
+timer_idle_end (void)
+{
+  int64_t now, boundary, rem;
+  int passed;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (oneshot_end == 0)
+    return;
+  now = timer_now ();
+  if (intr_ext_pending (0x20))
+    return;     /* timer_interrupt() will take care of it. */
+
+  passed = cycles_to_ticks (now, &rem) - ticks;
+  if (passed > 0)
+    {
+      ticks += passed;
+      vdata_update ();
+      thread_skip_ticks (ticks, passed);
+      thread_wakeup (ticks);
+    }
+
+  boundary = (ticks + 1) * TIMER_PERIOD;
+  if (oneshot_end > boundary)
+    timer_one_shot (now, boundary);
+}
+
+/* Blocks the current thread for CYCLES PIT cycles, about a tick
+   or less, by programming the PIT to interrupt early if the
+   deadline falls before the next tick.  Interrupts must be on. */
+static void
+timer_hrsleep (int64_t cycles)
+{
+  struct hr_sleeper s;
+  enum intr_level old_level;
+  int64_t now, next;
+
+  ASSERT (intr_get_level () == INTR_ON);
+  ASSERT (cycles > 0 && cycles <= UINT16_MAX);
+
+  /* A pending timer interrupt would make the PIT's counter
+     disagree with ticks, so take it first. */
+  old_level = intr_disable ();
+  while (intr_ext_pending (0x20))
+    {
+      intr_enable ();
+      intr_disable ();
+    }
+
+  now = timer_now ();
+  s.deadline = now + cycles;
+  s.thread = thread_current ();
+  list_insert_ordered (&hr_sleepers, &s.elem, hr_sleeper_less, NULL);
+
+  next = oneshot_end != 0 ? oneshot_end : (ticks + 1) * TIMER_PERIOD;
+  if (s.deadline < next)
+    timer_one_shot (now, s.deadline);
+  thread_block ();
+
+  intr_set_level (old_level);
+}
+
+/* Returns the current time in PIT cycles since boot.  Interrupts
+   must be off, and no timer interrupt may be pending unless we
+   are in timer_interrupt(). */
+static int64_t
+timer_now (void)
+{
+  uint16_t counter = pit_read_counter (0);
+
+  if (oneshot_end != 0)
+    return oneshot_end - counter;
+  else
+    return (ticks + 1) * TIMER_PERIOD - counter;
+}
+
+/* Stores the TSC in *TSC and the time, in PIT cycles, in *PIT,
+   read together with interrupts off. */
+static void
+tsc_sample (uint64_t *tsc, int64_t *pit)
+{
+  for (;;)
+    {
+      enum intr_level old_level = intr_disable ();
+      if (!intr_ext_pending (0x20))
+        {
+          *pit = timer_now ();
+          *tsc = timer_cycles ();
+          intr_set_level (old_level);
+          return;
+        }
+
+      /* timer_now() would be a tick behind.  Let the interrupt
+         come in first. */
+      intr_set_level (old_level);
+    }
+}
+
+/* Copies the tick count and TSC rate to the vdata page, with
+   its sequence count odd meanwhile so that user processes reading
+   it know to try again.  Interrupts must be off. */
+static void
+vdata_update (void)
+{
+  volatile struct vdata *v = vdata;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (v == NULL)
+    return;
+  v->seq++;
+  barrier ();
+  v->tick_freq = TIMER_FREQ;
+  v->ticks = ticks;
+  v->tsc_hz = tsc_hz;
+  v->tsc_base = tsc_base;
+  barrier ();
+  v->seq++;
+}
+
+/* Returns the time, in PIT cycles, of the next tick boundary or
+   timer_hrsleep() deadline, whichever comes first. */
+static int64_t
+timer_next_event (void)
+{
+  int64_t boundary = (ticks + 1) * TIMER_PERIOD;
+
+  if (!list_empty (&hr_sleepers))
+    {
+      struct hr_sleeper *s = list_entry (list_front (&hr_sleepers),
+                                         struct hr_sleeper, elem);
+      if (s->deadline < boundary)
+        return s->deadline;
+    }
+  return boundary;
+}
+
+/* Programs the PIT, at time NOW, to interrupt once at time END
+   instead of ticking.  If END has already passed, interrupts as
+   soon as possible. */
+static void
+timer_one_shot (int64_t now, int64_t end)
+{
+  int64_t count = end > now ? end - now : 1;
+
+  ASSERT (count <= UINT16_MAX);
+
+  oneshot_end = end;
+  pit_configure_one_shot (0, count);
+}
+
+/* Wakes every thread in timer_hrsleep() whose deadline is NOW or
+   earlier. */
+static void
+hr_wakeup (int64_t now)
+{
+  bool preempt = false;
+
+  while (!list_empty (&hr_sleepers))
+    {
+      struct hr_sleeper *s = list_entry (list_front (&hr_sleepers),
+                                         struct hr_sleeper, elem);
+      if (s->deadline > now)
+        break;
+      list_pop_front (&hr_sleepers);
+      thread_unblock (s->thread);
+      if (thread_preempts (s->thread))
+        preempt = true;
+    }
+
+  if (preempt && intr_context ())
+    intr_yield_on_return ();
+}
+
+/* Wakes the threads whose timer_sleep() has ended and queues
+   delayed work that has come due.  Deferred from
+   timer_interrupt(). */
+static void
+wakeup_sleepers (void *aux UNUSED)
+{
+  enum intr_level old_level = intr_disable ();
+  thread_wakeup (ticks);
+  workqueue_tick (ticks);
+  intr_set_level (old_level);
+}
+
+/* Orders hr_sleepers by deadline. */
+static bool
+hr_sleeper_less (const struct list_elem *a, const struct list_elem *b,
+                 void *aux UNUSED)
+{
+  return (list_entry (a, struct hr_sleeper, elem)->deadline
+          < list_entry (b, struct hr_sleeper, elem)->deadline);
+}
 
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
@@ -236,9 +689,11 @@ real_time_sleep (int64_t num, int32_t denom)
     }
   else 
     {
-      /* Otherwise, use a busy-wait loop for more accurate
-         sub-tick timing. */
-      real_time_delay (num, denom); 
+      /* Otherwise, block until a one-shot timer interrupt, for
+         more accurate sub-tick timing. */
+      int64_t cycles = DIV_ROUND_UP (num * PIT_HZ, denom);
+      if (cycles > 0)
+        timer_hrsleep (cycles);
     }
 }
 
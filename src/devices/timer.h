@@ -2,16 +2,28 @@
 #define DEVICES_TIMER_H
 
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
+/* With -tickless, stop the periodic tick while idle. */
+extern bool timer_tickless;
+
+/* With -calibrate=LOOPS, skip measuring the busy-wait rate. */
+extern unsigned timer_loops_per_sec;
+
 void timer_init (void);
 void timer_calibrate (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+uint64_t timer_cycles (void);
+
+/* High-resolution clock, from the TSC. */
+uint64_t clock_ns (void);
+uint64_t timer_cycles_to_ns (uint64_t cycles);
 
 /* Sleep and yield the CPU to other threads. */
 void timer_sleep (int64_t ticks);
@@ -24,6 +36,13 @@ void timer_mdelay (int64_t milliseconds);
 void timer_udelay (int64_t microseconds);
 void timer_ndelay (int64_t nanoseconds);
 
+/* Tickless idle. */
+void timer_idle_begin (void);
+void timer_idle_end (void);
+
+/* Kernel data page for user processes. */
+void *timer_vdata (void);
+
 void timer_print_stats (void);
 
 // wait list
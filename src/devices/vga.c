@@ -1,4 +1,5 @@
 #include "devices/vga.h"
+#include <debug.h>
 #include <round.h>
 #include <stdint.h>
 #include <stddef.h>
@@ -6,9 +7,18 @@
 #include "devices/speaker.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
-/* VGA text screen support.  See [FREEVGA] for more information. */
+/* VGA text screen support.  See [FREEVGA] for more information.
+
+   Output is written to a shadow copy of the screen and copied to
+   text memory a flush at a time: after each vga_putbuf(), or, in
+   deferred mode, whenever a low-priority thread gets to run.
+   The shadow is a ring of rows, so scrolling only moves its top
+   index, and however many lines a flush scrolled by, the screen
+   is redrawn by one copy. */
 
 /* Number of columns and rows on the text display. */
 #define COL_CNT 80
@@ -26,9 +36,34 @@ static size_t cx, cy;
    The attribute at (x,y) is fb[y][x][1]. */
 static uint8_t (*fb)[COL_CNT][2];
 
+/* Shadow screen, laid out like FB, except that display row Y is
+   shadow[(top + Y) % ROW_CNT]. */
+static uint8_t shadow[ROW_CNT][COL_CNT][2];
+static size_t top;
+
+/* Bit Y is set if display row Y of FB is out of date. */
+static uint32_t dirty;
+#define ALL_DIRTY ((1u << ROW_CNT) - 1)
+
+/* See vga.h. */
+bool vga_deferred;
+
+/* Deferred mode.  RENDER_SEMA is upped once per batch of output
+   to wake the renderer thread, and RENDER_PENDING records that it
+   has been upped and not yet run.  RENDERING is false until the
+   thread exists and after a panic, when flushes happen
+   immediately again. */
+static struct semaphore render_sema;
+static bool render_pending;
+static bool rendering;
+
+static void put_char (int c);
+static uint8_t (*row (size_t y))[2];
 static void clear_row (size_t y);
 static void cls (void);
 static void newline (void);
+static void flush (void);
+static void renderer (void *aux);
 static void move_cursor (void);
 static void find_cursor (size_t *x, size_t *y);
 
@@ -41,22 +76,90 @@ init (void)
   if (!inited)
     {
       fb = ptov (0xb8000);
+      memcpy (shadow, fb, sizeof shadow);
       find_cursor (&cx, &cy);
       inited = true; 
     }
 }
 
+/* Starts the thread that redraws the screen in deferred mode, if
+   that mode was selected.  Must be called after the scheduler is
+   running. */
+void
+vga_start_renderer (void)
+{
+  if (!vga_deferred)
+    return;
+
+  sema_init (&render_sema, 0);
+  rendering = true;
+  if (thread_create ("vga", PRI_MIN, renderer, NULL) == TID_ERROR)
+    rendering = false;
+}
+
 /* Writes C to the VGA text display, interpreting control
    characters in the conventional ways.  */
 void
 vga_putc (int c)
+{
+  char ch = c;
+  vga_putbuf (&ch, 1);
+}
+
+/* Writes the N characters in BUFFER to the VGA text display, as
+   vga_putc() would, then updates the screen once for all of
+   them, or leaves that to the renderer thread in deferred
+   mode. */
+void
+vga_putbuf (const char *buffer, size_t n)
 {
   /* Disable interrupts to lock out interrupt handlers
      that might write to the console. */
   enum intr_level old_level = intr_disable ();
 
   init ();
-  
+  while (n-- > 0)
+    {
+      if (*buffer == '\a')
+        {
+          intr_set_level (old_level);
+          speaker_beep ();
+          intr_disable ();
+          buffer++;
+        }
+      else
+        put_char (*buffer++);
+    }
+
+  if (!rendering)
+    flush ();
+  else if (!render_pending)
+    {
+      render_pending = true;
+      sema_up (&render_sema);
+    }
+
+  intr_set_level (old_level);
+}
+
+/* Called when the kernel panics: stops deferring, so that the
+   panic message is on screen before the machine stops, and
+   brings the screen up to date. */
+void
+vga_panic (void)
+{
+  enum intr_level old_level = intr_disable ();
+
+  rendering = false;
+  init ();
+  flush ();
+  intr_set_level (old_level);
+}
+
+/* Writes C, which is not '\a', to the shadow screen. */
+static void
+put_char (int c)
+{
   switch (c) 
     {
     case '\n':
@@ -82,26 +185,23 @@ vga_putc (int c)
         newline ();
       break;
 
-    case '\a':
-      intr_set_level (old_level);
-      speaker_beep ();
-      intr_disable ();
-      break;
-      
     default:
-      fb[cy][cx][0] = c;
-      fb[cy][cx][1] = GRAY_ON_BLACK;
+      row (cy)[cx][0] = c;
+      row (cy)[cx][1] = GRAY_ON_BLACK;
+      dirty |= 1u << cy;
       if (++cx >= COL_CNT)
         newline ();
       break;
     }
+}
 
-  /* Update cursor position. */
-  move_cursor ();
-
-  intr_set_level (old_level);
+/* Returns display row Y of the shadow screen. */
+static uint8_t
+(*row (size_t y))[2]
+{
+  return shadow[(top + y) % ROW_CNT];
 }
-
+
 /* Clears the screen and moves the cursor to the upper left. */
 static void
 cls (void)
@@ -112,25 +212,27 @@ cls (void)
     clear_row (y);
 
   cx = cy = 0;
-  move_cursor ();
 }
 
-/* Clears row Y to spaces. */
+/* Clears display row Y to spaces. */
 static void
 clear_row (size_t y) 
 {
+  uint8_t (*r)[2] = row (y);
   size_t x;
 
   for (x = 0; x < COL_CNT; x++)
     {
-      fb[y][x][0] = ' ';
-      fb[y][x][1] = GRAY_ON_BLACK;
+      r[x][0] = ' ';
+      r[x][1] = GRAY_ON_BLACK;
     }
+  dirty |= 1u << y;
 }
 
 /* Advances the cursor to the first column in the next line on
    the screen.  If the cursor is already on the last line on the
-   screen, scrolls the screen upward one line. */
+   screen, scrolls the screen upward one line, which in the
+   shadow just makes the top row the new bottom one. */
 static void
 newline (void)
 {
@@ -139,8 +241,54 @@ newline (void)
   if (cy >= ROW_CNT)
     {
       cy = ROW_CNT - 1;
-      memmove (&fb[0], &fb[1], sizeof fb[0] * (ROW_CNT - 1));
+      top = (top + 1) % ROW_CNT;
       clear_row (ROW_CNT - 1);
+      dirty = ALL_DIRTY;
+    }
+}
+
+/* Copies the out-of-date rows of the shadow screen to text memory
+   and moves the hardware cursor.  A full redraw, as after a
+   scroll, is at most two copies, one on either side of the wrap
+   in the shadow's ring of rows. */
+static void
+flush (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (dirty == ALL_DIRTY)
+    {
+      size_t first = ROW_CNT - top;
+      memcpy (&fb[0], &shadow[top], sizeof fb[0] * first);
+      memcpy (&fb[first], &shadow[0], sizeof fb[0] * top);
+    }
+  else
+    {
+      size_t y;
+      for (y = 0; y < ROW_CNT; y++)
+        if (dirty & (1u << y))
+          memcpy (&fb[y], row (y), sizeof fb[y]);
+    }
+  dirty = 0;
+  move_cursor ();
+}
+
+/* Renderer thread for deferred mode.  Runs at the lowest
+   priority, so that the screen catches up only when nothing
+   else wants the CPU. */
+static void
+renderer (void *aux UNUSED)
+{
+  for (;;)
+    {
+      enum intr_level old_level;
+
+      sema_down (&render_sema);
+      old_level = intr_disable ();
+      render_pending = false;
+      if (rendering)
+        flush ();
+      intr_set_level (old_level);
     }
 }
 
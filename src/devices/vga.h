@@ -1,6 +1,17 @@
 #ifndef DEVICES_VGA_H
 #define DEVICES_VGA_H
 
+#include <stdbool.h>
+#include <stddef.h>
+
+/* If true, the screen is redrawn by a low-priority thread
+   instead of on every write.
+   Controlled by kernel command-line option "-vgadefer". */
+extern bool vga_deferred;
+
+void vga_start_renderer (void);
 void vga_putc (int);
+void vga_putbuf (const char *, size_t);
+void vga_panic (void);
 
 #endif /* devices/vga.h */
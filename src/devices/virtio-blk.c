@@ -0,0 +1,460 @@
+#include "devices/virtio-blk.h"
+#include <debug.h>
+#include <round.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "devices/block.h"
+#include "devices/partition.h"
+#include "devices/pci.h"
+#include "threads/interrupt.h"
+#include "threads/io.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* The code in this file drives virtio block devices, such as
+   those QEMU attaches with "-drive if=virtio", through the
+   legacy PCI interface of [VIRTIO-0.9.5].
+
+   Each disk has a single virtqueue.  A request is a chain of
+   three descriptors, for its header, its data, and the status
+   byte the device writes back, and all the requests that make up
+   one block layer transfer are put in the queue together, with
+   a single notification to the device.  The device reads and
+   writes the data in place, by DMA, and, when it offers the
+   EVENT_IDX feature, interrupts only once, when the last request
+   is done.  Kernel virtual addresses map physical memory
+   linearly, so any buffer is contiguous in physical memory and
+   needs just one data descriptor. */
+
+/* PCI IDs of a legacy virtio block device. */
+#define VIRTIO_VENDOR_ID 0x1af4
+#define VIRTIO_BLK_DEVICE_ID 0x1001
+
+/* Legacy virtio I/O port registers, as offsets from BAR0. */
+#define reg_features(D) ((D)->io_base + 0x00)    /* Device features. */
+#define reg_guest_features(D) ((D)->io_base + 0x04) /* Driver features. */
+#define reg_queue_pfn(D) ((D)->io_base + 0x08)   /* Queue page frame. */
+#define reg_queue_size(D) ((D)->io_base + 0x0c)  /* Queue size (r/o). */
+#define reg_queue_select(D) ((D)->io_base + 0x0e) /* Queue selector. */
+#define reg_queue_notify(D) ((D)->io_base + 0x10) /* Queue notifier. */
+#define reg_status(D) ((D)->io_base + 0x12)      /* Device status. */
+#define reg_isr(D) ((D)->io_base + 0x13)         /* ISR status (r/o). */
+#define reg_capacity(D) ((D)->io_base + 0x14)    /* Capacity, 64 bits. */
+
+/* Device Status Register bits. */
+#define STATUS_ACKNOWLEDGE 0x01 /* Guest has noticed the device. */
+#define STATUS_DRIVER 0x02      /* Guest knows how to drive it. */
+#define STATUS_DRIVER_OK 0x04   /* Driver is ready. */
+#define STATUS_FAILED 0x80      /* Guest has given up on it. */
+
+/* ISR Status Register bits. */
+#define ISR_QUEUE 0x01          /* Queue has used buffers. */
+
+/* Feature bits. */
+#define VIRTIO_RING_F_EVENT_IDX (1u << 29) /* used_event, avail_event. */
+
+/* Virtqueue alignment of the used ring. */
+#define VRING_ALIGN 4096
+
+/* Descriptor flags. */
+#define VRING_DESC_F_NEXT 1     /* Chain continues in NEXT. */
+#define VRING_DESC_F_WRITE 2    /* Device writes, not reads, buffer. */
+
+/* Request types. */
+#define VIRTIO_BLK_T_IN 0       /* Read. */
+#define VIRTIO_BLK_T_OUT 1      /* Write. */
+
+/* Values of a request's status byte. */
+#define VIRTIO_BLK_S_OK 0       /* Success. */
+
+/* Most sectors in one request, most requests put in the queue at
+   once, and descriptors in a request. */
+#define REQ_SECTORS 256
+#define MAX_BATCH 32
+#define REQ_DESCS 3
+
+/* Most disks. */
+#define MAX_DISKS 8
+
+/* A virtqueue descriptor. */
+struct vring_desc
+  {
+    uint64_t addr;              /* Physical address of buffer. */
+    uint32_t len;               /* Length of buffer. */
+    uint16_t flags;             /* VRING_DESC_F_* flags. */
+    uint16_t next;              /* Next descriptor, with F_NEXT. */
+  };
+
+/* The ring of descriptor chains offered to the device.  RING is
+   followed by the used_event field. */
+struct vring_avail
+  {
+    uint16_t flags;
+    uint16_t idx;               /* Where the next chain goes in RING. */
+    uint16_t ring[];            /* Head descriptors. */
+  };
+
+/* An element of the ring of chains the device is done with. */
+struct vring_used_elem
+  {
+    uint32_t id;                /* Head descriptor. */
+    uint32_t len;               /* Bytes written into the chain. */
+  };
+
+/* The ring of chains the device is done with.  RING is followed
+   by the avail_event field. */
+struct vring_used
+  {
+    uint16_t flags;
+    uint16_t idx;               /* Where the device's next goes in RING. */
+    struct vring_used_elem ring[];
+  };
+
+/* Header that starts each request. */
+struct virtio_blk_req
+  {
+    uint32_t type;              /* VIRTIO_BLK_T_*. */
+    uint32_t ioprio;            /* Priority, unused. */
+    uint64_t sector;            /* First sector. */
+  };
+
+/* A virtio block device. */
+struct virtio_disk
+  {
+    char name[8];               /* Name, e.g. "vda". */
+    uint16_t io_base;           /* Base I/O port. */
+    uint8_t irq;                /* Interrupt line. */
+    bool polled;                /* Poll for completion, not interrupts? */
+    bool event_idx;             /* Negotiated VIRTIO_RING_F_EVENT_IDX? */
+    uint16_t queue_size;        /* Entries in the virtqueue. */
+    size_t batch_max;           /* Most requests put in queue at once. */
+    block_sector_t capacity;    /* Size in sectors. */
+
+    /* The virtqueue. */
+    struct vring_desc *desc;    /* Descriptor table. */
+    struct vring_avail *avail;  /* Chains offered to the device. */
+    uint16_t *used_event;       /* Used index to interrupt at. */
+    volatile struct vring_used *used; /* Chains the device is done with. */
+
+    /* Protected by LOCK. */
+    struct lock lock;           /* Serializes transfers. */
+    uint16_t target;            /* Used index at end of current batch. */
+    struct virtio_blk_req reqs[MAX_BATCH]; /* Headers of the batch. */
+    uint8_t status[MAX_BATCH];  /* Status bytes of the batch. */
+
+    /* Shared with the interrupt handler. */
+    bool waiting;               /* Is a thread down on DONE? */
+    struct semaphore done;      /* Up'd by interrupt handler. */
+  };
+
+static struct virtio_disk disks[MAX_DISKS];
+static size_t disk_cnt;
+
+/* Interrupt lines whose handler is ours. */
+static bool irq_hooked[16];
+
+static struct block_operations virtio_blk_operations;
+
+static pci_probe_func probe_device;
+static bool init_queue (struct virtio_disk *);
+static void hook_irq (struct virtio_disk *);
+static void transfer (struct virtio_disk *, block_sector_t, uint8_t *,
+                      block_sector_t cnt, bool write);
+static void set_desc (struct virtio_disk *, uint16_t, void *, uint32_t len,
+                      uint16_t flags);
+static void wait_for_batch (struct virtio_disk *);
+static void interrupt_handler (struct intr_frame *);
+
+/* Initializes the virtio block subsystem and registers each
+   virtio disk found on the PCI bus. */
+void
+virtio_blk_init (void)
+{
+  pci_scan (VIRTIO_VENDOR_ID, VIRTIO_BLK_DEVICE_ID, probe_device);
+}
+
+/* Sets up the virtio block device PD, if there is room for it,
+   and registers it, along with any partitions it has. */
+static void
+probe_device (const struct pci_device *pd)
+{
+  struct virtio_disk *d;
+  struct block *block;
+  uint32_t bar, features;
+  uint64_t capacity;
+
+  if (disk_cnt >= MAX_DISKS)
+    {
+      printf ("virtio-blk: too many disks\n");
+      return;
+    }
+  d = &disks[disk_cnt];
+  snprintf (d->name, sizeof d->name, "vd%c", 'a' + (int) disk_cnt);
+
+  /* Legacy devices put their registers in I/O space. */
+  bar = pci_read32 (pd, PCI_BAR0);
+  if ((bar & 1) == 0)
+    {
+      printf ("%s: BAR0 not in I/O space, ignoring\n", d->name);
+      return;
+    }
+  d->io_base = bar & ~3u;
+  d->irq = pci_read8 (pd, PCI_INTERRUPT_LINE);
+  pci_write16 (pd, PCI_COMMAND, (pci_read16 (pd, PCI_COMMAND)
+                                 | PCI_COMMAND_IO | PCI_COMMAND_MASTER));
+
+  /* Reset the device and negotiate features. */
+  outb (reg_status (d), 0);
+  outb (reg_status (d), STATUS_ACKNOWLEDGE);
+  outb (reg_status (d), STATUS_ACKNOWLEDGE | STATUS_DRIVER);
+  features = inl (reg_features (d)) & VIRTIO_RING_F_EVENT_IDX;
+  outl (reg_guest_features (d), features);
+  d->event_idx = features != 0;
+
+  if (!init_queue (d))
+    {
+      outb (reg_status (d), STATUS_FAILED);
+      return;
+    }
+  lock_init (&d->lock);
+  sema_init (&d->done, 0);
+  hook_irq (d);
+  outb (reg_status (d), (STATUS_ACKNOWLEDGE | STATUS_DRIVER
+                         | STATUS_DRIVER_OK));
+
+  capacity = inl (reg_capacity (d));
+  capacity |= (uint64_t) inl (reg_capacity (d) + 4) << 32;
+  d->capacity = capacity < UINT32_MAX ? capacity : UINT32_MAX;
+  disk_cnt++;
+
+  block = block_register (d->name, BLOCK_RAW,
+                          d->polled ? "virtio disk (polled)" : "virtio disk",
+                          d->capacity, &virtio_blk_operations, d);
+  partition_scan (block);
+}
+
+/* Allocates D's virtqueue and tells the device where it is.
+   Returns true if successful, false on failure. */
+static bool
+init_queue (struct virtio_disk *d)
+{
+  size_t n, used_ofs, page_cnt;
+  uint8_t *ring;
+
+  outw (reg_queue_select (d), 0);
+  n = inw (reg_queue_size (d));
+  if (n < REQ_DESCS)
+    {
+      printf ("%s: no usable virtqueue\n", d->name);
+      return false;
+    }
+
+  used_ofs = ROUND_UP (n * sizeof *d->desc + sizeof *d->avail
+                       + (n + 1) * sizeof *d->avail->ring, VRING_ALIGN);
+  page_cnt = DIV_ROUND_UP (used_ofs + sizeof *d->used
+                           + n * sizeof *d->used->ring + sizeof (uint16_t),
+                           PGSIZE);
+  ring = palloc_get_multiple (PAL_ZERO, page_cnt);
+  if (ring == NULL)
+    {
+      printf ("%s: out of memory for %zu-entry virtqueue\n", d->name, n);
+      return false;
+    }
+
+  d->queue_size = n;
+  d->batch_max = n / REQ_DESCS < MAX_BATCH ? n / REQ_DESCS : MAX_BATCH;
+  d->desc = (struct vring_desc *) ring;
+  d->avail = (struct vring_avail *) (ring + n * sizeof *d->desc);
+  d->used_event = &d->avail->ring[n];
+  d->used = (struct vring_used *) (ring + used_ofs);
+  outl (reg_queue_pfn (d), vtop (ring) >> PGBITS);
+  return true;
+}
+
+/* Arranges for D's interrupts to reach interrupt_handler(), or,
+   if its line is out of range or taken by another device, for
+   transfers on D to poll for completion instead. */
+static void
+hook_irq (struct virtio_disk *d)
+{
+  uint8_t vec_no = d->irq + 0x20;
+
+  if (d->irq >= 16 || (!irq_hooked[d->irq] && intr_is_registered (vec_no)))
+    {
+      d->polled = true;
+      return;
+    }
+  if (!irq_hooked[d->irq])
+    {
+      intr_register_ext (vec_no, interrupt_handler, "virtio-blk");
+      irq_hooked[d->irq] = true;
+    }
+}
+
+/* Reads CNT consecutive sectors starting at SEC_NO from disk D
+   into BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+virtio_blk_read_multiple (void *d, block_sector_t sec_no, void *buffer,
+                          block_sector_t cnt)
+{
+  transfer (d, sec_no, buffer, cnt, false);
+}
+
+/* Writes CNT consecutive sectors starting at SEC_NO to disk D
+   from BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes.
+   Returns after the device has completed the write.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+virtio_blk_write_multiple (void *d, block_sector_t sec_no,
+                           const void *buffer, block_sector_t cnt)
+{
+  transfer (d, sec_no, (uint8_t *) buffer, cnt, true);
+}
+
+/* Reads sector SEC_NO from disk D into BUFFER, which must have
+   room for BLOCK_SECTOR_SIZE bytes. */
+static void
+virtio_blk_read (void *d, block_sector_t sec_no, void *buffer)
+{
+  transfer (d, sec_no, buffer, 1, false);
+}
+
+/* Writes sector SEC_NO to disk D from BUFFER, which must contain
+   BLOCK_SECTOR_SIZE bytes. */
+static void
+virtio_blk_write (void *d, block_sector_t sec_no, const void *buffer)
+{
+  transfer (d, sec_no, (uint8_t *) buffer, 1, true);
+}
+
+static struct block_operations virtio_blk_operations =
+  {
+    virtio_blk_read,
+    virtio_blk_write,
+    virtio_blk_read_multiple,
+    virtio_blk_write_multiple
+  };
+
+/* Transfers CNT sectors starting at SEC_NO between disk D and
+   BUFFER, writing to the disk if WRITE is true, in batches of up
+   to D->batch_max requests of up to REQ_SECTORS sectors each.
+   Panics if the device reports an error. */
+static void
+transfer (struct virtio_disk *d, block_sector_t sec_no, uint8_t *buffer,
+          block_sector_t cnt, bool write)
+{
+  lock_acquire (&d->lock);
+  while (cnt > 0)
+    {
+      size_t batch, i;
+
+      for (batch = 0; cnt > 0 && batch < d->batch_max; batch++)
+        {
+          block_sector_t n = cnt < REQ_SECTORS ? cnt : REQ_SECTORS;
+          struct virtio_blk_req *r = &d->reqs[batch];
+          uint16_t head = batch * REQ_DESCS;
+
+          r->type = write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+          r->ioprio = 0;
+          r->sector = sec_no;
+          d->status[batch] = 0xff;
+
+          set_desc (d, head, r, sizeof *r, VRING_DESC_F_NEXT);
+          set_desc (d, head + 1, buffer, n * BLOCK_SECTOR_SIZE,
+                    VRING_DESC_F_NEXT | (write ? 0 : VRING_DESC_F_WRITE));
+          set_desc (d, head + 2, &d->status[batch], 1, VRING_DESC_F_WRITE);
+          d->avail->ring[(d->avail->idx + batch) % d->queue_size] = head;
+
+          buffer += n * BLOCK_SECTOR_SIZE;
+          sec_no += n;
+          cnt -= n;
+        }
+
+      d->target = d->avail->idx + batch;
+      wait_for_batch (d);
+
+      for (i = 0; i < batch; i++)
+        if (d->status[i] != VIRTIO_BLK_S_OK)
+          PANIC ("%s: disk %s failed, sector=%"PRDSNu, d->name,
+                 write ? "write" : "read", (block_sector_t) d->reqs[i].sector);
+    }
+  lock_release (&d->lock);
+}
+
+/* Sets descriptor IDX of D to LEN bytes at kernel address BUF,
+   with FLAGS, chaining it to descriptor IDX + 1 if FLAGS
+   includes VRING_DESC_F_NEXT. */
+static void
+set_desc (struct virtio_disk *d, uint16_t idx, void *buf, uint32_t len,
+          uint16_t flags)
+{
+  struct vring_desc *desc = &d->desc[idx];
+
+  desc->addr = vtop (buf);
+  desc->len = len;
+  desc->flags = flags;
+  desc->next = flags & VRING_DESC_F_NEXT ? idx + 1 : 0;
+}
+
+/* Offers D's batch of requests, whose descriptor chains are
+   already in its available ring, to the device in a single
+   notification, and waits until the device has finished them
+   all. */
+static void
+wait_for_batch (struct virtio_disk *d)
+{
+  enum intr_level old_level;
+
+  /* Ask for one interrupt, when the last request is done. */
+  if (d->event_idx)
+    *d->used_event = d->target - 1;
+  barrier ();
+  d->avail->idx = d->target;
+  barrier ();
+  outw (reg_queue_notify (d), 0);
+
+  if (d->polled)
+    {
+      while (d->used->idx != d->target)
+        thread_yield ();
+      return;
+    }
+
+  old_level = intr_disable ();
+  while (d->used->idx != d->target)
+    {
+      d->waiting = true;
+      sema_down (&d->done);
+    }
+  intr_set_level (old_level);
+}
+
+/* virtio block interrupt handler.  Reading a disk's ISR Status
+   Register acknowledges its interrupt, so this reads that of each
+   disk on the line, whether or not it turns out to be the one
+   that interrupted. */
+static void
+interrupt_handler (struct intr_frame *f)
+{
+  size_t i;
+
+  for (i = 0; i < disk_cnt; i++)
+    {
+      struct virtio_disk *d = &disks[i];
+
+      if (d->polled || f->vec_no != d->irq + 0x20u)
+        continue;
+      if ((inb (reg_isr (d)) & ISR_QUEUE) && d->waiting)
+        {
+          d->waiting = false;
+          sema_up (&d->done);
+        }
+    }
+}
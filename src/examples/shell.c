@@ -1,104 +1,454 @@
+/* shell.c
+
+   A small shell.  Each line is a command to run as a child
+   process, or a built-in.  Commands joined by "|" form a
+   pipeline, each one's standard output feeding the next one's
+   standard input through a pipe, and a line that ends in "&"
+   runs in the background while the shell reads the next one.
+   The built-ins are:
+
+     cd DIR             Changes the shell's directory.
+     jobs               Lists the background jobs still running.
+     wait               Waits for every background job to end.
+     parallel [-j N] PROGRAM ::: ARG...
+                        Runs "PROGRAM ARG" for each ARG, at most N
+                        (default 4) at a time.
+     parallel [-j N]    The same for the commands on the lines that
+                        follow, up to an empty one.
+     exit               Leaves the shell.
+
+   Children are reaped with wait_any() in whatever order they
+   end, so parallel starts a new command as soon as any running
+   one is done, and a background job that ends while another
+   command runs is reported right then. */
+
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <syscall.h>
 
+/* Longest command line. */
+#define COMMAND_MAX 128
+
+/* Most jobs at once, and most commands in one pipeline. */
+#define MAX_JOBS 16
+#define MAX_STAGES 8
+
+/* Commands parallel runs at once without -j. */
+#define DEFAULT_PARALLEL 4
+
+/* A command line that is running. */
+struct job
+  {
+    bool used;                  /* Is this slot in use? */
+    bool background;            /* Started with "&"? */
+    char command[COMMAND_MAX];  /* The command line. */
+    pid_t pids[MAX_STAGES];     /* Its processes not yet reaped. */
+    int pid_cnt;                /* Number of PIDS. */
+    pid_t last;                 /* The last stage, or PID_ERROR. */
+    int status;                 /* Its exit code, once it is reaped. */
+  };
+
+static struct job jobs[MAX_JOBS];
+
 static void read_line (char line[], size_t);
-static bool backspace (char **pos, char line[]);
+static void run_line (char *line);
+static void parallel (char *args);
+static void parallel_start (const char *command, int max);
+static struct job *start_job (const char *command, bool background);
+static int start_pipeline (char *command, pid_t pids[], pid_t *last);
+static bool reap_one (void);
+static void finish_job (struct job *);
+static struct job *free_job (void);
+static int running_jobs (bool background);
+static char *trim (char *);
 
 int
 main (void)
 {
   printf ("Shell starting...\n");
+  set_canonical (true);
   for (;;) 
     {
-      char command[80];
+      char command[COMMAND_MAX];
 
       /* Read command. */
       printf ("--");
       read_line (command, sizeof command);
       
       /* Execute command. */
-      if (!strcmp (command, "exit"))
+      if (!strcmp (trim (command), "exit"))
         break;
-      else if (!memcmp (command, "cd ", 3)) 
-        {
-          if (!chdir (command + 3))
-            printf ("\"%s\": chdir failed\n", command + 3);
-        }
-      else if (command[0] == '\0') 
-        {
-          /* Empty command. */
-        }
-      else
-        {
-          pid_t pid = exec (command);
-          if (pid != PID_ERROR)
-            printf ("\"%s\": exit code %d\n", command, wait (pid));
-          else
-            printf ("exec failed\n");
-        }
+      run_line (command);
     }
 
+  set_canonical (false);
   printf ("Shell exiting.");
   return EXIT_SUCCESS;
 }
 
-/* Reads a line of input from the user into LINE, which has room
-   for SIZE bytes.  Handles backspace and Ctrl+U in the ways
-   expected by Unix users.  On return, LINE will always be
-   null-terminated and will not end in a new-line character. */
+/* Runs the command or built-in on LINE, which it modifies, and
+   waits for it unless it ends in "&". */
 static void
-read_line (char line[], size_t size) 
+run_line (char *line)
 {
-  char *pos = line;
-  for (;;)
+  char *command = trim (line);
+  size_t len = strlen (command);
+  bool background = len > 0 && command[len - 1] == '&';
+  struct job *job;
+
+  if (background)
     {
-      char c;
-      read (STDIN_FILENO, &c, 1);
+      command[len - 1] = '\0';
+      command = trim (command);
+    }
 
-      switch (c) 
+  if (!memcmp (command, "cd ", 3)) 
+    {
+      if (!chdir (trim (command + 3)))
+        printf ("\"%s\": chdir failed\n", command + 3);
+    }
+  else if (!strcmp (command, "jobs"))
+    {
+      int i;
+
+      for (i = 0; i < MAX_JOBS; i++)
+        if (jobs[i].used && jobs[i].background)
+          printf ("[%d] %s\n", i + 1, jobs[i].command);
+    }
+  else if (!strcmp (command, "wait"))
+    {
+      while (running_jobs (true) > 0 && reap_one ())
+        continue;
+    }
+  else if (!strcmp (command, "parallel")
+           || !memcmp (command, "parallel ", 9))
+    parallel (command + 8);
+  else if (command[0] == '\0') 
+    {
+      /* Empty command. */
+    }
+  else
+    {
+      job = start_job (command, background);
+      if (job == NULL)
+        return;
+      if (background)
+        printf ("[%d] started\n", (int) (job - jobs) + 1);
+      else
+        while (job->used && reap_one ())
+          continue;
+    }
+}
+
+/* Runs the parallel built-in, with ARGS the rest of its line,
+   which it modifies. */
+static void
+parallel (char *args)
+{
+  int max = DEFAULT_PARALLEL;
+  char *sep;
+
+  args = trim (args);
+  if (!memcmp (args, "-j", 2))
+    {
+      args = trim (args + 2);
+      max = atoi (args);
+      while (*args >= '0' && *args <= '9')
+        args++;
+      args = trim (args);
+      if (max <= 0)
         {
-        case '\r':
-          *pos = '\0';
-          putchar ('\n');
+          printf ("parallel: -j needs a positive number\n");
           return;
+        }
+    }
+  if (max > MAX_JOBS)
+    max = MAX_JOBS;
+
+  sep = strstr (args, ":::");
+  if (sep != NULL)
+    {
+      char *program, *arg, *save_ptr;
+
+      *sep = '\0';
+      program = trim (args);
+      for (arg = strtok_r (sep + 3, " ", &save_ptr); arg != NULL;
+           arg = strtok_r (NULL, " ", &save_ptr))
+        {
+          char command[COMMAND_MAX];
 
-        case '\b':
-          backspace (&pos, line);
+          snprintf (command, sizeof command, "%s %s", program, arg);
+          parallel_start (command, max);
+        }
+    }
+  else if (*args == '\0')
+    for (;;)
+      {
+        char command[COMMAND_MAX];
+
+        printf ("> ");
+        read_line (command, sizeof command);
+        if (*trim (command) == '\0')
           break;
+        parallel_start (trim (command), max);
+      }
+  else
+    {
+      printf ("usage: parallel [-j N] [PROGRAM ::: ARG...]\n");
+      return;
+    }
+
+  while (running_jobs (false) > 0 && reap_one ())
+    continue;
+}
+
+/* Starts COMMAND for parallel, once fewer than MAX of the jobs it
+   started are still running. */
+static void
+parallel_start (const char *command, int max)
+{
+  while ((running_jobs (false) >= max || free_job () == NULL)
+         && reap_one ())
+    continue;
+  start_job (command, false);
+}
+
+/* Starts the pipeline COMMAND as a new job, in the background if
+   BACKGROUND is true.  Returns the job, or a null pointer if
+   none of it could be started. */
+static struct job *
+start_job (const char *command, bool background)
+{
+  struct job *job = free_job ();
+  char buf[COMMAND_MAX];
 
-        case ('U' - 'A') + 1:       /* Ctrl+U. */
-          while (backspace (&pos, line))
-            continue;
+  if (job == NULL)
+    {
+      printf ("too many jobs\n");
+      return NULL;
+    }
+  strlcpy (job->command, command, sizeof job->command);
+  strlcpy (buf, command, sizeof buf);
+  job->pid_cnt = start_pipeline (buf, job->pids, &job->last);
+  if (job->pid_cnt == 0)
+    return NULL;
+  job->used = true;
+  job->background = background;
+  job->status = -1;
+  return job;
+}
+
+/* Adds the action OP on FD, and TO, to the CNT in ACTIONS. */
+static void
+add_action (struct spawn_action actions[], int *cnt,
+            int op, int fd, int to)
+{
+  actions[*cnt].op = op;
+  actions[*cnt].fd = fd;
+  actions[*cnt].to = to;
+  ++*cnt;
+}
+
+/* Starts each command in the pipeline COMMAND, which it modifies,
+   with a pipe from each one's standard output to the next one's
+   standard input.  Stores the processes it starts into PIDS,
+   along with the last stage's into *LAST, and returns how many
+   there are.  If a stage cannot be started, prints why and stops
+   there, with *LAST set to PID_ERROR; the stages before it see
+   end of file. */
+static int
+start_pipeline (char *command, pid_t pids[], pid_t *last)
+{
+  char *stages[MAX_STAGES];
+  int stage_cnt = 0;
+  int cnt = 0;
+  int in = -1;                  /* Read end of the pipe into stage I. */
+  char *stage, *save_ptr;
+  int i;
+
+  *last = PID_ERROR;
+  for (stage = strtok_r (command, "|", &save_ptr); stage != NULL;
+       stage = strtok_r (NULL, "|", &save_ptr))
+    {
+      if (stage_cnt == MAX_STAGES)
+        {
+          printf ("more than %d commands in a pipeline\n", MAX_STAGES);
+          return 0;
+        }
+      stages[stage_cnt] = trim (stage);
+      if (*stages[stage_cnt++] == '\0')
+        {
+          printf ("missing command in pipeline\n");
+          return 0;
+        }
+    }
+
+  for (i = 0; i < stage_cnt; i++)
+    {
+      struct spawn_action actions[5];
+      int action_cnt = 0;
+      int fds[2] = {-1, -1};
+      pid_t pid;
+
+      if (i + 1 < stage_cnt && !pipe (fds))
+        {
+          printf ("pipe failed\n");
           break;
+        }
+      if (in >= 0)
+        {
+          add_action (actions, &action_cnt, SPAWN_DUP, in, STDIN_FILENO);
+          add_action (actions, &action_cnt, SPAWN_CLOSE, in, 0);
+        }
+      if (fds[1] >= 0)
+        {
+          add_action (actions, &action_cnt, SPAWN_DUP, fds[1],
+                      STDOUT_FILENO);
+          add_action (actions, &action_cnt, SPAWN_CLOSE, fds[1], 0);
+          add_action (actions, &action_cnt, SPAWN_CLOSE, fds[0], 0);
+        }
+      pid = spawn (stages[i], actions, action_cnt, NULL);
 
-        default:
-          /* Add character to line. */
-          if (pos < line + size - 1) 
-            {
-              putchar (c);
-              *pos++ = c;
-            }
+      /* Only the children need these ends now. */
+      if (in >= 0)
+        close (in);
+      if (fds[1] >= 0)
+        close (fds[1]);
+      in = fds[0];
+
+      if (pid == PID_ERROR)
+        {
+          printf ("\"%s\": exec failed\n", stages[i]);
           break;
         }
+      pids[cnt++] = pid;
     }
+  if (in >= 0)
+    close (in);
+  if (cnt == stage_cnt)
+    *last = pids[cnt - 1];
+  return cnt;
 }
 
-/* If *POS is past the beginning of LINE, backs up one character
-   position.  Returns true if successful, false if nothing was
-   done. */
+/* Waits for any child to exit and takes it off its job, finishing
+   the job once none of its processes are left.  Returns false if
+   there were no children to wait for. */
 static bool
-backspace (char **pos, char line[]) 
+reap_one (void)
 {
-  if (*pos > line)
+  int status;
+  pid_t pid = wait_any (&status);
+  int i, j;
+
+  if (pid == PID_ERROR)
     {
-      /* Back up cursor, overwrite character, back up
-         again. */
-      printf ("\b \b");
-      (*pos)--;
-      return true;
+      /* None left, so every job is over. */
+      for (i = 0; i < MAX_JOBS; i++)
+        if (jobs[i].used)
+          finish_job (&jobs[i]);
+      return false;
     }
+
+  for (i = 0; i < MAX_JOBS; i++)
+    {
+      struct job *job = &jobs[i];
+
+      if (!job->used)
+        continue;
+      for (j = 0; j < job->pid_cnt; j++)
+        if (job->pids[j] == pid)
+          {
+            if (pid == job->last)
+              job->status = status;
+            job->pids[j] = job->pids[--job->pid_cnt];
+            if (job->pid_cnt == 0)
+              finish_job (job);
+            return true;
+          }
+    }
+  return true;
+}
+
+/* Reports that JOB is over and frees its slot. */
+static void
+finish_job (struct job *job)
+{
+  if (job->background)
+    printf ("[%d] \"%s\": exit code %d\n",
+            (int) (job - jobs) + 1, job->command, job->status);
   else
-    return false;
+    printf ("\"%s\": exit code %d\n", job->command, job->status);
+  job->used = false;
+}
+
+/* Returns a free job slot, or a null pointer if there is none. */
+static struct job *
+free_job (void)
+{
+  int i;
+
+  for (i = 0; i < MAX_JOBS; i++)
+    if (!jobs[i].used)
+      return &jobs[i];
+  return NULL;
+}
+
+/* Returns the number of jobs running in the background, if
+   BACKGROUND is true, or else in the foreground. */
+static int
+running_jobs (bool background)
+{
+  int cnt = 0;
+  int i;
+
+  for (i = 0; i < MAX_JOBS; i++)
+    if (jobs[i].used && jobs[i].background == background)
+      cnt++;
+  return cnt;
+}
+
+/* Returns S with its leading spaces skipped and its trailing
+   spaces removed. */
+static char *
+trim (char *s)
+{
+  size_t len;
+
+  while (*s == ' ')
+    s++;
+  len = strlen (s);
+  while (len > 0 && s[len - 1] == ' ')
+    s[--len] = '\0';
+  return s;
+}
+
+/* Reads a line of input from the user into LINE, which has room
+   for SIZE bytes.  The kernel's canonical input mode, turned on
+   by main(), echoes the line and handles backspace and Ctrl+U as
+   it is typed, then hands it over all at once.  On return, LINE
+   will always be null-terminated and will not end in a new-line
+   character.  The rest of a line too long for LINE is
+   discarded. */
+static void
+read_line (char line[], size_t size) 
+{
+  size_t len = 0;
+  bool eol = false;
+
+  while (!eol)
+    {
+      char discard[16];
+      char *dst = len < size - 1 ? line + len : discard;
+      size_t room = len < size - 1 ? size - 1 - len : sizeof discard;
+      int n = read (STDIN_FILENO, dst, room);
+
+      if (n <= 0)
+        break;
+      eol = dst[n - 1] == '\n';
+      if (dst == line + len)
+        len += n - eol;
+    }
+  line[len] = '\0';
 }
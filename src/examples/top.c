@@ -0,0 +1,295 @@
+/* top.c
+
+   Shows what the kernel is doing, refreshed every INTERVAL
+   milliseconds (default 1000), COUNT times (default forever):
+   each thread's share of the CPU since the last refresh, its
+   state, and its priority with and without donation; the page
+   pools' usage; the buffer cache's hit rate; and how many
+   requests each disk has in flight.
+
+   The thread, cache, and disk figures come from the files in
+   /stats, each taken in a single read, and the memory figures
+   from memstats().  Between refreshes it sleeps until the next
+   one is due by clock_ns(), so that the time it takes itself
+   does not make the refreshes drift.  This won't work until
+   project 4. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Most threads shown. */
+#define MAX_THREADS 64
+
+/* One thread, as of the last two refreshes. */
+struct top_thread
+  {
+    int tid;
+    char name[16];
+    char state[8];
+    int priority;               /* With donation. */
+    int own;                    /* Without. */
+    long long run_ticks;        /* Ticks run since boot. */
+    long long prev_ticks;       /* At the last refresh, or -1. */
+  };
+
+static struct top_thread threads[MAX_THREADS], old_threads[MAX_THREADS];
+static int thread_cnt, old_thread_cnt;
+
+/* Snapshot of a /stats file. */
+static char buf[16384];
+
+static bool read_stats (const char *file);
+static void parse_threads (void);
+static void show_io (long long *hits, long long *misses);
+static long long number (const char **);
+
+int
+main (int argc, char *argv[])
+{
+  int interval = argc > 1 ? atoi (argv[1]) : 1000;
+  int count = argc > 2 ? atoi (argv[2]) : 0;
+  long long hits = 0, misses = 0;
+  long long prev_ticks = clock_ticks ();
+  uint64_t next = clock_ns ();
+  int n;
+
+  if (interval <= 0)
+    interval = 1000;
+  for (n = 0; count == 0 || n < count; n++)
+    {
+      long long now_ticks = clock_ticks ();
+      long long elapsed = now_ticks - prev_ticks;
+      struct mem_stats m;
+      uint64_t now;
+      int i;
+
+      if (!read_stats ("/stats/sched"))
+        return EXIT_FAILURE;
+      parse_threads ();
+
+      printf ("\ntop: %d threads, %lld ticks\n", thread_cnt, now_ticks);
+      printf ("%5s %-15s %-8s %4s %4s %5s\n",
+              "TID", "NAME", "STATE", "PRI", "OWN", "CPU%");
+      for (i = 0; i < thread_cnt; i++)
+        {
+          struct top_thread *t = &threads[i];
+
+          printf ("%5d %-15s %-8s %4d %4d ",
+                  t->tid, t->name, t->state, t->priority, t->own);
+          if (t->prev_ticks >= 0 && elapsed > 0)
+            printf ("%5lld\n",
+                    (t->run_ticks - t->prev_ticks) * 100 / elapsed);
+          else
+            printf ("%5s\n", "-");
+        }
+
+      memstats (&m);
+      printf ("Kernel pool: %u used, %u free; user pool: %u used, %u free\n",
+              m.kernel_pool.used_cnt, m.kernel_pool.free_cnt,
+              m.user_pool.used_cnt, m.user_pool.free_cnt);
+
+      if (!read_stats ("/stats/io"))
+        return EXIT_FAILURE;
+      show_io (&hits, &misses);
+
+      prev_ticks = now_ticks;
+      memcpy (old_threads, threads, sizeof threads);
+      old_thread_cnt = thread_cnt;
+
+      /* Sleep until the next refresh is due. */
+      next += interval * 1000000ULL;
+      now = clock_ns ();
+      if (next > now)
+        msleep ((next - now) / 1000000);
+      else
+        next = now;
+    }
+  return EXIT_SUCCESS;
+}
+
+/* Reads all of FILE, as of now, into BUF, null-terminated.
+   Returns false if it cannot be opened. */
+static bool
+read_stats (const char *file)
+{
+  int fd = open (file);
+  int len;
+
+  if (fd < 0)
+    {
+      printf ("%s: open failed\n", file);
+      return false;
+    }
+  len = pread (fd, buf, sizeof buf - 1, 0);
+  buf[len > 0 ? len : 0] = '\0';
+  close (fd);
+  return true;
+}
+
+/* Returns the thread with TID in THREADS, adding it if it is
+   new, or a null pointer if there is no room. */
+static struct top_thread *
+find_thread (int tid, const char *name, size_t name_len)
+{
+  struct top_thread *t;
+  int i;
+
+  for (i = 0; i < thread_cnt; i++)
+    if (threads[i].tid == tid)
+      return &threads[i];
+  if (thread_cnt >= MAX_THREADS)
+    return NULL;
+
+  t = &threads[thread_cnt++];
+  memset (t, 0, sizeof *t);
+  t->tid = tid;
+  if (name_len >= sizeof t->name)
+    name_len = sizeof t->name - 1;
+  memcpy (t->name, name, name_len);
+  t->prev_ticks = -1;
+  for (i = 0; i < old_thread_cnt; i++)
+    if (old_threads[i].tid == tid)
+      t->prev_ticks = old_threads[i].run_ticks;
+  return t;
+}
+
+/* Fills THREADS from the "Thread NAME (tid N)..." lines of the
+   sched file in BUF. */
+static void
+parse_threads (void)
+{
+  char *save_ptr;
+  char *line;
+
+  thread_cnt = 0;
+  for (line = strtok_r (buf, "\n", &save_ptr); line != NULL;
+       line = strtok_r (NULL, "\n", &save_ptr))
+    {
+      const char *name, *p;
+      struct top_thread *t;
+      size_t name_len;
+
+      if (memcmp (line, "Thread ", 7))
+        continue;
+      name = line + 7;
+      p = strstr (name, " (tid ");
+      if (p == NULL)
+        continue;
+      name_len = p - name;
+      p += 6;
+      t = find_thread (number (&p), name, name_len);
+      if (t == NULL)
+        continue;
+
+      if (!memcmp (p, "): ", 3))
+        {
+          p += 3;
+          t->run_ticks = number (&p);
+        }
+      else if (!memcmp (p, ") state: ", 9))
+        {
+          size_t len;
+
+          p += 9;
+          len = strcspn (p, ",");
+          if (len >= sizeof t->state)
+            len = sizeof t->state - 1;
+          memcpy (t->state, p, len);
+          t->state[len] = '\0';
+          p = strstr (p, "priority ");
+          if (p == NULL)
+            continue;
+          p += 9;
+          t->priority = number (&p);
+          p = strstr (p, "own ");
+          if (p != NULL)
+            {
+              p += 4;
+              t->own = number (&p);
+            }
+        }
+    }
+}
+
+/* Prints the cache's hit rate, overall and since the last
+   refresh, from the io file in BUF, and updates *HITS and
+   *MISSES to the totals.  Then prints each disk's requests in
+   flight. */
+static void
+show_io (long long *hits, long long *misses)
+{
+  char *save_ptr;
+  char *line;
+  char disk[16] = "";
+  bool first = true;
+
+  for (line = strtok_r (buf, "\n", &save_ptr); line != NULL;
+       line = strtok_r (NULL, "\n", &save_ptr))
+    {
+      const char *p;
+
+      if (!memcmp (line, "Cache: ", 7))
+        {
+          long long h, m, dh, dm;
+
+          p = line + 7;
+          h = number (&p);
+          p = strstr (p, ", ");
+          if (p == NULL)
+            continue;
+          p += 2;
+          m = number (&p);
+          dh = h - *hits;
+          dm = m - *misses;
+          *hits = h;
+          *misses = m;
+          printf ("Cache: %lld%% hits overall, %lld%% recently\n",
+                  h + m > 0 ? h * 100 / (h + m) : 0,
+                  dh + dm > 0 ? dh * 100 / (dh + dm) : 0);
+        }
+      else if (line[0] != ' ')
+        {
+          /* "NAME (TYPE): ...", which any in-flight line
+             follows. */
+          size_t len = strcspn (line, " ");
+          if (len >= sizeof disk)
+            len = sizeof disk - 1;
+          memcpy (disk, line, len);
+          disk[len] = '\0';
+        }
+      else if ((p = strstr (line, " bytes written, ")) != NULL)
+        {
+          long long in_flight, peak;
+
+          p += 16;
+          in_flight = number (&p);
+          p = strstr (p, "peak ");
+          if (p == NULL)
+            continue;
+          p += 5;
+          peak = number (&p);
+          printf ("%s%s: %lld in flight (peak %lld)",
+                  first ? "Disk queues: " : ", ", disk, in_flight, peak);
+          first = false;
+        }
+    }
+  if (!first)
+    printf ("\n");
+}
+
+/* Parses the decimal number at *P, which may be negative, and
+   advances *P past it. */
+static long long
+number (const char **p)
+{
+  bool negative = **p == '-';
+  long long n = 0;
+
+  if (negative)
+    (*p)++;
+  for (; **p >= '0' && **p <= '9'; (*p)++)
+    n = n * 10 + (**p - '0');
+  return negative ? -n : n;
+}
@@ -0,0 +1,1371 @@
+#include "filesys/cache.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "filesys/journal.h"
+#include "devices/timer.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Buffer cache.  Holds up to CACHE_SIZE sectors of the file
+   system device in memory, between the inode layer and the
+   block device.
+
+   Writes only update the cached copy and mark it dirty.  Dirty
+   sectors reach the disk when they are evicted, when the
+   write-behind thread gets to them, or when the file system is
+   shut down by filesys_done().  Victims are chosen as described
+   below.
+
+   The write-behind thread wakes every WRITEBACK_INTERVAL ticks
+   and writes back, in sector order, the sectors that have been
+   dirty for DIRTY_EXPIRE ticks, or the oldest ones whenever more
+   than DIRTY_BACKGROUND are dirty, no more than
+   cache_writeback_rate a second all told.  A writer that leaves
+   more than DIRTY_LIMIT sectors dirty writes a batch back itself
+   before going on, so that one that writes faster than the disk
+   can take is held to the disk's pace.  Every
+   CACHE_FLUSH_INTERVAL ticks the thread also commits the journal
+   and flushes whatever is left, which by then is little.
+
+   Sectors requested with cache_read_ahead() are read in by a
+   separate thread, so that the requester does not wait for
+   them.
+
+   Sectors passed to cache_zero() are only noted in ZERO_MAP.
+   They read as zeros without any disk access, and the zeros are
+   written out by the next flush in multi-sector batches, unless
+   the sector has been loaded into the cache before then.
+
+   Replacement follows 2Q, so that one long sequential pass, such
+   as reading a big file, cannot flush out everything else.  A
+   sector enters the cache "cold", and hits on it do not make it
+   any warmer, since a reader that goes through a sector in small
+   pieces hits it several times in a row.  The oldest cold entry
+   is evicted whenever more than COLD_TARGET entries are cold,
+   and its sector is remembered in GHOSTS.  A sector loaded again
+   while still remembered there has proven itself, and enters
+   "hot".  Hot entries are evicted only when few entries are
+   cold, by the clock algorithm.  Metadata is hot from the start
+   and is evicted only after a full turn of the clock has found
+   no other hot entry to take: sectors moved whole by cache_read()
+   and cache_write(), which the inode layer uses for inodes and
+   the blocks that index a file's data, and sectors written in a
+   journal handle, such as directories and the free map.
+
+   Sectors written inside a journal handle belong to the running
+   transaction and are never written to their home locations,
+   even on eviction, before cache_commit() has put them in the
+   journal.  Until the next checkpoint, a sector that is in the
+   journal joins the running transaction whoever writes it, so
+   that replaying the journal after a crash cannot bring back an
+   older version of it; see journal.c.
+
+   At shutdown, cache_done() also saves the list of hot sectors in
+   sector WARM_SECTOR, and at the next boot cache_warm() loads
+   them again, in the background and in sector order, so that the
+   inodes and directories in use before are cached hot again
+   without each first use waiting for the disk.  The "-preload"
+   option loads chosen files' data hot the same way, through
+   cache_preload(), up to PRELOAD_MAX sectors so that the rest of
+   the cache stays free for everything else.
+
+   Disk transfers are made with the cache lock released, so that
+   threads using different sectors overlap their disk waits.  An
+   entry being read in or written back is busy, and a thread that
+   needs it waits on the entry's IDLE condition rather than
+   changing or evicting it.  Sectors with a transfer in flight
+   that no entry covers, direct I/O from cache_direct() or zeros
+   owed by ZERO_MAP, are marked in DIRECT_MAP, and are not loaded
+   or written back until it is done.  Only the journal's own
+   writes, in commits and checkpoints, are made with the lock
+   held, since it also protects the log. */
+
+/* Number of sectors in the cache. */
+#define CACHE_SIZE 64
+
+/* Timer ticks between full flushes, and between write-behind
+   passes. */
+#define CACHE_FLUSH_INTERVAL (5 * TIMER_FREQ)
+#define WRITEBACK_INTERVAL (TIMER_FREQ / 10)
+
+/* Timer ticks a sector may stay dirty before the write-behind
+   thread writes it back however few sectors are dirty. */
+#define DIRTY_EXPIRE TIMER_FREQ
+
+/* Dirty entries beyond DIRTY_BACKGROUND are written back before
+   they expire, and a writer that leaves more than DIRTY_LIMIT
+   dirty writes a batch back itself. */
+#define DIRTY_BACKGROUND (CACHE_SIZE / 4)
+#define DIRTY_LIMIT (CACHE_SIZE * 3 / 4)
+
+/* Most sectors written back per second by the write-behind
+   thread, set by the "-wbrate" kernel command-line option. */
+unsigned cache_writeback_rate = 256;
+
+/* Number of entries in the running transaction at which a
+   commit is requested. */
+#define JOURNAL_COMMIT_CNT (CACHE_SIZE / 2)
+
+/* Cold entries beyond this many are evicted before any hot one,
+   and the number of evicted cold sectors remembered. */
+#define COLD_TARGET (CACHE_SIZE / 4)
+#define GHOST_CNT (CACHE_SIZE / 2)
+
+/* A cached sector. */
+struct cache_entry
+  {
+    block_sector_t sector;              /* Sector held by this entry. */
+    bool valid;                         /* Does DATA hold SECTOR? */
+    bool dirty;                         /* Modified since written to disk? */
+    bool accessed;                      /* Used since the clock hand passed? */
+    bool hot;                           /* Proven reuse, or metadata? */
+    bool meta;                          /* Metadata? */
+    uint64_t loaded;                    /* Load order, for cold entries. */
+    int64_t dirtied;                    /* Ticks when it became dirty. */
+    bool journaled;                     /* In the running transaction? */
+    bool busy;                          /* Being read in or written back? */
+    struct condition idle;              /* Signaled when BUSY turns false. */
+    unsigned pin_cnt;                   /* Pins held by cache_copy(). */
+    uint8_t data[BLOCK_SECTOR_SIZE];    /* Sector contents. */
+    struct block_request io;            /* Used by write_batch(). */
+  };
+
+static struct cache_entry cache[CACHE_SIZE];
+
+/* Sectors whose contents must become zeros, one bit per sector
+   of the file system device. */
+static struct bitmap *zero_map;
+
+/* Sectors in the journal since the last checkpoint, one bit per
+   sector of the file system device, and the number of entries in
+   the running transaction. */
+static struct bitmap *logged_map;
+static size_t journaled_cnt;
+
+/* Sectors with a transfer in flight outside the cache entries,
+   one bit per sector of the file system device.  UNBLOCKED is
+   broadcast whenever bits are cleared, and when an entry is
+   unpinned. */
+static struct bitmap *direct_map;
+static struct condition unblocked;
+
+/* Most sectors of zeros written by one request. */
+#define ZERO_RUN_SECTORS 16
+
+/* Source for writing zeros owed by ZERO_MAP. */
+static uint8_t zeros[ZERO_RUN_SECTORS * BLOCK_SECTOR_SIZE];
+
+/* Protects all of CACHE, CLOCK_HAND, ZERO_MAP, LOGGED_MAP,
+   DIRECT_MAP, and JOURNALED_CNT, and the journal's log. */
+static struct lock cache_lock;
+
+/* Next entry to examine when looking for a hot victim. */
+static size_t clock_hand;
+
+/* Number of valid cold entries, and load order of the last entry
+   loaded. */
+static size_t cold_cnt;
+static uint64_t load_cnt;
+
+/* Sectors of the GHOST_CNT cold entries evicted last, in a
+   circular buffer, with BLOCK_SECTOR_NONE in unused slots. */
+#define BLOCK_SECTOR_NONE ((block_sector_t) -1)
+static block_sector_t ghosts[GHOST_CNT];
+static size_t ghost_next;
+
+/* Statistics. */
+static uint64_t hit_cnt;                /* Lookups that found the sector. */
+static uint64_t miss_cnt;               /* Lookups that loaded it. */
+static uint64_t evict_cnt;              /* Valid entries reused. */
+static uint64_t evict_hot_cnt;          /* Of those, hot ones. */
+static uint64_t behind_cnt;             /* Sectors written behind. */
+static uint64_t throttle_cnt;           /* Writers held back. */
+
+/* The sectors hot at shutdown, in WARM_SECTOR.  Must be exactly
+   BLOCK_SECTOR_SIZE bytes long. */
+#define WARM_MAGIC 0x5741524d           /* "WARM". */
+struct warm_list
+  {
+    unsigned magic;                     /* WARM_MAGIC. */
+    uint32_t cnt;                       /* Number of sectors. */
+    block_sector_t sectors[CACHE_SIZE]; /* The sectors, in order. */
+    bool meta[CACHE_SIZE];              /* Which ones are metadata. */
+    uint8_t unused[BLOCK_SECTOR_SIZE - 8 - 5 * CACHE_SIZE];
+  };
+
+/* In-memory copy of the list.  False WARM_ACTIVE means the disk
+   has no list. */
+static struct warm_list warm;
+static bool warm_active;
+
+/* Most sectors cache_preload() loads, and the number it has. */
+#define PRELOAD_MAX (CACHE_SIZE / 2)
+static size_t preload_cnt;
+
+/* Maximum number of pending read-ahead requests.  Requests
+   beyond this are dropped. */
+#define READ_AHEAD_QUEUE_SIZE 64
+
+/* Sectors waiting to be read ahead, in a circular queue. */
+static block_sector_t ra_queue[READ_AHEAD_QUEUE_SIZE];
+static size_t ra_head;                  /* Index of oldest request. */
+static size_t ra_cnt;                   /* Number of requests queued. */
+static struct lock ra_lock;             /* Protects the queue. */
+static struct condition ra_nonempty;    /* Signaled when RA_CNT > 0. */
+
+static thread_func flush_daemon NO_RETURN;
+static thread_func read_ahead_daemon NO_RETURN;
+static struct cache_entry *cache_lookup (block_sector_t);
+static struct cache_entry *cache_evict (void);
+static struct cache_entry *oldest_cold (void);
+static struct cache_entry *clock_hot (void);
+static bool evictable (const struct cache_entry *);
+static void drop (struct cache_entry *);
+static bool ghost_take (block_sector_t);
+static void make_meta (struct cache_entry *);
+static struct cache_entry *cache_load (block_sector_t, bool read, bool meta);
+static struct cache_entry *load_for_write (block_sector_t, bool read,
+                                           bool meta);
+static void write_batch (struct cache_entry **, size_t cnt);
+static void write_zeros (block_sector_t start, size_t cnt);
+static bool direct_begin (struct block_request *, size_t cnt);
+static void read_part (block_sector_t, void *, size_t ofs, size_t size,
+                       bool meta);
+static void write_part (block_sector_t, const void *, size_t ofs,
+                        size_t size, bool meta);
+static void flush_zeros (void);
+static void mark_written (struct cache_entry *);
+static void flush_locked (void);
+static void commit_locked (void);
+static void checkpoint_locked (void);
+static size_t dirty_count (void);
+static size_t write_behind (size_t max, bool force);
+static size_t writeback_batch (void);
+static int older_first (const void *, const void *);
+static int lower_sector_first (const void *, const void *);
+static void warm_daemon (void *aux);
+static bool load_hot (block_sector_t, bool meta);
+static void warm_save (void);
+static int compare_sectors (const void *, const void *);
+
+/* Initializes the buffer cache and starts the write-behind
+   thread. */
+void
+cache_init (void)
+{
+  size_t i;
+
+  lock_init (&cache_lock);
+  lock_register (&cache_lock, "cache");
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      cache[i].valid = false;
+      cache[i].busy = false;
+      cache[i].pin_cnt = 0;
+      cond_init (&cache[i].idle);
+    }
+  for (i = 0; i < GHOST_CNT; i++)
+    ghosts[i] = BLOCK_SECTOR_NONE;
+  clock_hand = 0;
+  zero_map = bitmap_create (block_size (fs_device));
+  logged_map = bitmap_create (block_size (fs_device));
+  direct_map = bitmap_create (block_size (fs_device));
+  if (zero_map == NULL || logged_map == NULL || direct_map == NULL)
+    PANIC ("can't allocate buffer cache zero map");
+  cond_init (&unblocked);
+
+  lock_init (&ra_lock);
+  cond_init (&ra_nonempty);
+  ra_head = ra_cnt = 0;
+
+  thread_create ("cache-flush", PRI_DEFAULT, flush_daemon, NULL);
+  thread_create ("cache-readahead", PRI_DEFAULT, read_ahead_daemon, NULL);
+}
+
+/* Writes back every dirty sector.  Called at shutdown. */
+void
+cache_done (void)
+{
+  cache_flush ();
+  warm_save ();
+}
+
+/* Writes an empty warm-up list to WARM_SECTOR.  Called by
+   do_format(). */
+void
+cache_warm_create (void)
+{
+  ASSERT (sizeof warm == BLOCK_SECTOR_SIZE);
+
+  memset (&warm, 0, sizeof warm);
+  warm.magic = WARM_MAGIC;
+  block_write (fs_device, WARM_SECTOR, &warm);
+}
+
+/* Reads the warm-up list, if the disk has one, and starts a
+   thread that loads the sectors it names.  Must be called after
+   journal_open(), so that replayed sectors are read as
+   replayed. */
+void
+cache_warm (void)
+{
+  block_read (fs_device, WARM_SECTOR, &warm);
+  if (warm.magic != WARM_MAGIC)
+    return;
+  warm_active = true;
+  if (warm.cnt > 0 && warm.cnt <= CACHE_SIZE)
+    thread_create ("cache-warm", PRI_DEFAULT, warm_daemon, NULL);
+}
+
+/* Reads SECTOR, a metadata sector, into BUFFER, which must have
+   room for BLOCK_SECTOR_SIZE bytes, going to disk only if SECTOR
+   is not already cached. */
+void
+cache_read (block_sector_t sector, void *buffer)
+{
+  read_part (sector, buffer, 0, BLOCK_SECTOR_SIZE, true);
+}
+
+/* Writes BLOCK_SECTOR_SIZE bytes from BUFFER into the cached
+   copy of SECTOR, a metadata sector.  The disk is updated
+   later. */
+void
+cache_write (block_sector_t sector, const void *buffer)
+{
+  write_part (sector, buffer, 0, BLOCK_SECTOR_SIZE, true);
+}
+
+/* Copies SIZE bytes starting at byte OFS of SECTOR into BUFFER,
+   going to disk only if SECTOR is not already cached. */
+void
+cache_read_part (block_sector_t sector, void *buffer, size_t ofs, size_t size)
+{
+  read_part (sector, buffer, ofs, size, false);
+}
+
+/* Does the work of cache_read_part(), counting SECTOR as
+   metadata if META is true. */
+static void
+read_part (block_sector_t sector, void *buffer, size_t ofs, size_t size,
+           bool meta)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs + size <= BLOCK_SECTOR_SIZE);
+
+  lock_acquire (&cache_lock);
+  e = cache_load (sector, true, meta);
+  memcpy (buffer, e->data + ofs, size);
+  lock_release (&cache_lock);
+}
+
+/* Copies SIZE bytes from BUFFER into the cached copy of SECTOR,
+   starting at byte OFS, with no intermediate copy.  The rest of
+   the sector is read from disk first only if SECTOR is not cached
+   and the write does not cover all of it.  The disk is updated
+   later. */
+void
+cache_write_part (block_sector_t sector, const void *buffer, size_t ofs,
+                  size_t size)
+{
+  write_part (sector, buffer, ofs, size, false);
+}
+
+/* Does the work of cache_write_part(), counting SECTOR as
+   metadata if META is true. */
+static void
+write_part (block_sector_t sector, const void *buffer, size_t ofs,
+            size_t size, bool meta)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs + size <= BLOCK_SECTOR_SIZE);
+
+  lock_acquire (&cache_lock);
+  e = load_for_write (sector, size < BLOCK_SECTOR_SIZE, meta);
+  mark_written (e);
+  memcpy (e->data + ofs, buffer, size);
+  if (dirty_count () > DIRTY_LIMIT)
+    {
+      throttle_cnt++;
+      write_behind (writeback_batch (), true);
+    }
+  lock_release (&cache_lock);
+}
+
+/* Copies SIZE bytes starting at byte SRC_OFS of sector SRC into
+   the cached copy of sector DST, starting at byte DST_OFS,
+   straight from one cache entry to the other.  The rest of DST
+   is read from disk first only if DST is not cached and the copy
+   does not cover all of it.  The disk is updated later.  SRC's
+   entry is pinned meanwhile, so that loading DST cannot evict
+   it. */
+void
+cache_copy (block_sector_t dst, size_t dst_ofs,
+            block_sector_t src, size_t src_ofs, size_t size)
+{
+  struct cache_entry *s, *d;
+
+  ASSERT (dst_ofs + size <= BLOCK_SECTOR_SIZE);
+  ASSERT (src_ofs + size <= BLOCK_SECTOR_SIZE);
+
+  lock_acquire (&cache_lock);
+  s = cache_load (src, true, false);
+  s->pin_cnt++;
+  d = load_for_write (dst, size < BLOCK_SECTOR_SIZE, false);
+  mark_written (d);
+  memmove (d->data + dst_ofs, s->data + src_ofs, size);
+  if (--s->pin_cnt == 0)
+    cond_broadcast (&unblocked, &cache_lock);
+  lock_release (&cache_lock);
+}
+
+/* Asks for SECTOR to be brought into the cache in the
+   background.  This is only a hint, which may be ignored.  It is
+   always ignored for a sector past the end of the disk, such as
+   the made-up inode of a file under /stats. */
+void
+cache_read_ahead (block_sector_t sector)
+{
+  if (sector >= block_size (fs_device))
+    return;
+  lock_acquire (&ra_lock);
+  if (ra_cnt < READ_AHEAD_QUEUE_SIZE)
+    {
+      ra_queue[(ra_head + ra_cnt) % READ_AHEAD_QUEUE_SIZE] = sector;
+      ra_cnt++;
+      cond_signal (&ra_nonempty, &ra_lock);
+    }
+  lock_release (&ra_lock);
+}
+
+/* Reads SECTOR, file data, into the cache as a hot entry, for
+   the "-preload" option.  Returns false, doing nothing, once
+   PRELOAD_MAX sectors have been preloaded.  Only sectors read
+   from disk count against PRELOAD_MAX, not those the cache
+   already had. */
+bool
+cache_preload (block_sector_t sector)
+{
+  bool ok;
+
+  if (sector >= block_size (fs_device))
+    return true;
+  lock_acquire (&cache_lock);
+  ok = preload_cnt < PRELOAD_MAX;
+  if (ok && load_hot (sector, false))
+    preload_cnt++;
+  lock_release (&cache_lock);
+  return ok;
+}
+
+/* Makes SECTOR read as all zeros from now on, without writing
+   it to disk immediately.  For sectors just allocated to a
+   file. */
+void
+cache_zero (block_sector_t sector)
+{
+  struct cache_entry *e;
+
+  lock_acquire (&cache_lock);
+  if (cache_lookup (sector) != NULL || bitmap_test (logged_map, sector))
+    {
+      e = load_for_write (sector, false, false);
+      mark_written (e);
+      memset (e->data, 0, BLOCK_SECTOR_SIZE);
+    }
+  else
+    bitmap_mark (zero_map, sector);
+  lock_release (&cache_lock);
+}
+
+/* Writes every dirty cached sector to disk, except those in the
+   running transaction, and then checkpoints the journal.  All the
+   writes are queued before waiting for any of them, so that the
+   block layer can sort them and merge neighbors. */
+void
+cache_flush (void)
+{
+  lock_acquire (&cache_lock);
+  checkpoint_locked ();
+  lock_release (&cache_lock);
+}
+
+/* Commits the running transaction to the journal.  For
+   journal_commit(), which has made sure that no operation is
+   halfway done. */
+void
+cache_commit (void)
+{
+  lock_acquire (&cache_lock);
+  commit_locked ();
+  lock_release (&cache_lock);
+}
+
+/* Does the work of cache_flush() minus the checkpoint: writes the
+   zeros owed, then every dirty entry not in the running
+   transaction, waiting for those that other threads are writing
+   back.  Entries dirtied after this starts are left for later,
+   unless they hold committed sectors, which a checkpoint needs at
+   home.  Returns with no such entry left dirty, the lock having
+   been held since the last check.  The cache lock must be held,
+   and is released while writing and waiting. */
+static void
+flush_locked (void)
+{
+  struct cache_entry *batch[CACHE_SIZE];
+  int64_t start = timer_ticks ();
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  flush_zeros ();
+  for (;;)
+    {
+      struct cache_entry *busy = NULL;
+      bool blocked = false;
+      size_t cnt = 0;
+      size_t i;
+
+      for (i = 0; i < CACHE_SIZE; i++)
+        {
+          struct cache_entry *e = &cache[i];
+
+          if (!e->valid || !e->dirty || e->journaled
+              || (e->dirtied > start && !bitmap_test (logged_map, e->sector)))
+            continue;
+          if (e->busy)
+            busy = e;
+          else if (bitmap_test (direct_map, e->sector))
+            blocked = true;
+          else
+            batch[cnt++] = e;
+        }
+      if (cnt > 0)
+        write_batch (batch, cnt);
+      else if (busy != NULL)
+        cond_wait (&busy->idle, &cache_lock);
+      else if (blocked)
+        cond_wait (&unblocked, &cache_lock);
+      else
+        break;
+    }
+}
+
+/* Writes the running transaction to the journal.  Its entries
+   stay dirty, to be written home later.  The cache lock must be
+   held, and is released if the journal must be checkpointed
+   first. */
+static void
+commit_locked (void)
+{
+  /* Static to spare the stack of deeply nested evictions. */
+  static block_sector_t sectors[CACHE_SIZE];
+  static uint8_t *data[CACHE_SIZE];
+  size_t cnt = 0;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  while (journaled_cnt > 0 && !journal_fits (journaled_cnt))
+    checkpoint_locked ();
+  if (journaled_cnt == 0)
+    return;
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].valid && cache[i].journaled)
+      {
+        sectors[cnt] = cache[i].sector;
+        data[cnt] = cache[i].data;
+        cnt++;
+      }
+  ASSERT (cnt == journaled_cnt);
+
+  journal_write (sectors, data, cnt);
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].valid && cache[i].journaled)
+      {
+        cache[i].journaled = false;
+        bitmap_mark (logged_map, cache[i].sector);
+      }
+  journaled_cnt = 0;
+}
+
+/* Writes home every committed sector that is not yet there, so
+   that the journal can be emptied, and empties it.  The cache
+   lock must be held, and is released while writing home. */
+static void
+checkpoint_locked (void)
+{
+  flush_locked ();
+  journal_checkpoint ();
+  bitmap_set_all (logged_map, false);
+}
+
+/* Marks E, which is about to be changed, dirty, and adds it to
+   the running transaction if it is being written inside a
+   journal handle or is in the journal already.  E must come from
+   load_for_write(), which has sent home any unwritten committed
+   version.  The cache lock must be held. */
+static void
+mark_written (struct cache_entry *e)
+{
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+  ASSERT (!e->busy);
+
+  if (!e->journaled
+      && (journal_in_handle () || bitmap_test (logged_map, e->sector)))
+    {
+      ASSERT (!e->dirty || !bitmap_test (logged_map, e->sector));
+      e->journaled = true;
+      if (++journaled_cnt == JOURNAL_COMMIT_CNT)
+        journal_request_commit ();
+    }
+  if (journal_in_handle ())
+    make_meta (e);
+  if (!e->dirty)
+    {
+      /* Whoever dirties it pays for the write to come. */
+      e->dirtied = timer_ticks ();
+      block_charge (1);
+    }
+  e->dirty = true;
+}
+
+/* Prints buffer cache statistics. */
+void
+cache_print_stats (void)
+{
+  printf ("Cache: %"PRIu64" hits, %"PRIu64" misses, "
+          "%"PRIu64" evictions (%"PRIu64" hot), "
+          "%"PRIu64" written behind, %"PRIu64" writers throttled\n",
+          hit_cnt, miss_cnt, evict_cnt, evict_hot_cnt, behind_cnt,
+          throttle_cnt);
+}
+
+/* Writes the CNT SECTORS to disk if their cached copies are
+   dirty or they are still owed zeros, and waits for the writes
+   to complete.  The dirty entries are written together, so the
+   block layer may reorder them among themselves, but all of them
+   are on disk before this function returns.  Sectors that other
+   threads are already writing are waited for, and copies dirtied
+   again after this starts are left for later. */
+void
+cache_flush_sectors (const block_sector_t *sectors, size_t cnt)
+{
+  struct cache_entry *batch[CACHE_SIZE];
+  int64_t start = timer_ticks ();
+
+  lock_acquire (&cache_lock);
+  for (;;)
+    {
+      struct cache_entry *busy = NULL;
+      bool blocked = false, zeros_owed = false;
+      block_sector_t zero_sector = 0;
+      size_t batch_cnt = 0;
+      size_t i;
+
+      for (i = 0; i < cnt; i++)
+        {
+          struct cache_entry *e = cache_lookup (sectors[i]);
+
+          if (bitmap_test (direct_map, sectors[i]))
+            blocked = true;
+          else if (e == NULL)
+            {
+              if (bitmap_test (zero_map, sectors[i]))
+                {
+                  zeros_owed = true;
+                  zero_sector = sectors[i];
+                }
+            }
+          else if (!e->dirty || e->journaled || e->dirtied > start)
+            continue;
+          else if (e->busy)
+            busy = e;
+          else if (batch_cnt < CACHE_SIZE)
+            batch[batch_cnt++] = e;
+        }
+      if (batch_cnt > 0)
+        write_batch (batch, batch_cnt);
+      else if (zeros_owed)
+        write_zeros (zero_sector, 1);
+      else if (busy != NULL)
+        cond_wait (&busy->idle, &cache_lock);
+      else if (blocked)
+        cond_wait (&unblocked, &cache_lock);
+      else
+        break;
+    }
+  lock_release (&cache_lock);
+}
+
+/* Carries out the CNT requests in REQS straight between their
+   buffers and the disk, bypassing the cache but keeping coherent
+   with it.  Cached copies of sectors being written are dropped,
+   along with any zeros they are owed.  Sectors read are patched
+   from their cached copies, which are never older than the disk.
+   The requests are queued together, so that the block layer can
+   merge neighbors into multi-sector transfers.  The cache lock is
+   released while they are in flight, but their sectors are
+   marked in DIRECT_MAP, so that no cached access to them comes in
+   between.  Writing a sector that is in the journal checkpoints
+   it first, so that replaying the journal cannot undo the
+   write. */
+void
+cache_direct (struct block_request *reqs, size_t cnt)
+{
+  size_t i, j;
+
+  lock_acquire (&cache_lock);
+  while (!direct_begin (reqs, cnt))
+    continue;
+  lock_release (&cache_lock);
+
+  for (i = 0; i < cnt; i++)
+    block_submit (fs_device, &reqs[i]);
+  for (i = 0; i < cnt; i++)
+    block_wait (&reqs[i]);
+
+  lock_acquire (&cache_lock);
+  for (i = 0; i < cnt; i++)
+    {
+      if (!reqs[i].write)
+        for (j = 0; j < reqs[i].cnt; j++)
+          {
+            uint8_t *dst = (uint8_t *) reqs[i].buffer + j * BLOCK_SECTOR_SIZE;
+            struct cache_entry *e = cache_lookup (reqs[i].sector + j);
+            if (e != NULL)
+              memcpy (dst, e->data, BLOCK_SECTOR_SIZE);
+            else if (bitmap_test (zero_map, reqs[i].sector + j))
+              memset (dst, 0, BLOCK_SECTOR_SIZE);
+          }
+      bitmap_set_multiple (direct_map, reqs[i].sector, reqs[i].cnt, false);
+    }
+  cond_broadcast (&unblocked, &cache_lock);
+  lock_release (&cache_lock);
+}
+
+/* Prepares for cache_direct() to carry out the CNT requests in
+   REQS: drops the cached copies of the sectors they write and
+   the zeros those are owed, and marks all their sectors in
+   DIRECT_MAP.  Returns false, having done none of that, if it
+   first had to checkpoint the journal, because a request writes
+   a sector in it, or to wait for another transfer on the same
+   sectors.  The lock may have been released meanwhile, so the
+   caller must try again.  The cache lock must be held. */
+static bool
+direct_begin (struct block_request *reqs, size_t cnt)
+{
+  size_t i, j;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  for (i = 0; i < cnt; i++)
+    {
+      if (bitmap_contains (direct_map, reqs[i].sector, reqs[i].cnt, true))
+        {
+          cond_wait (&unblocked, &cache_lock);
+          return false;
+        }
+      if (reqs[i].write
+          && bitmap_contains (logged_map, reqs[i].sector, reqs[i].cnt, true))
+        {
+          checkpoint_locked ();
+          return false;
+        }
+      for (j = 0; j < reqs[i].cnt; j++)
+        {
+          struct cache_entry *e = cache_lookup (reqs[i].sector + j);
+          if (e != NULL && e->busy)
+            {
+              cond_wait (&e->idle, &cache_lock);
+              return false;
+            }
+        }
+    }
+
+  for (i = 0; i < cnt; i++)
+    {
+      if (reqs[i].write)
+        for (j = 0; j < reqs[i].cnt; j++)
+          {
+            struct cache_entry *e = cache_lookup (reqs[i].sector + j);
+            if (e != NULL)
+              drop (e);
+            bitmap_reset (zero_map, reqs[i].sector + j);
+          }
+      bitmap_set_multiple (direct_map, reqs[i].sector, reqs[i].cnt, true);
+    }
+  return true;
+}
+
+/* Returns the number of dirty entries that may be written back,
+   that is, that are not in the running transaction.  The cache
+   lock must be held. */
+static size_t
+dirty_count (void)
+{
+  size_t cnt = 0;
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].valid && cache[i].dirty && !cache[i].journaled)
+      cnt++;
+  return cnt;
+}
+
+/* Writes back up to MAX dirty entries that are not in the
+   running transaction, oldest first, in one batch in sector
+   order, and returns how many.  Unless FORCE is true, only
+   entries that have been dirty for DIRTY_EXPIRE ticks are
+   written, and younger ones only while more than
+   DIRTY_BACKGROUND entries are dirty.  Entries already busy, or
+   whose sectors have a direct transfer in flight, are passed
+   over.  The cache lock must be held, and is released while
+   writing. */
+static size_t
+write_behind (size_t max, bool force)
+{
+  struct cache_entry *batch[CACHE_SIZE];
+  int64_t now = timer_ticks ();
+  size_t dirty = 0;
+  size_t cnt, i;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &cache[i];
+      if (e->valid && e->dirty && !e->journaled && !e->busy
+          && !bitmap_test (direct_map, e->sector))
+        batch[dirty++] = e;
+    }
+  qsort (batch, dirty, sizeof *batch, older_first);
+  for (cnt = 0; cnt < dirty && cnt < max; cnt++)
+    if (!force && dirty - cnt <= DIRTY_BACKGROUND
+        && now - batch[cnt]->dirtied < DIRTY_EXPIRE)
+      break;
+  if (cnt == 0)
+    return 0;
+
+  qsort (batch, cnt, sizeof *batch, lower_sector_first);
+  write_batch (batch, cnt);
+  behind_cnt += cnt;
+  return cnt;
+}
+
+/* Writes the CNT dirty entries in BATCH to disk, queued together
+   in the order given, and marks them clean.  They are busy
+   meanwhile, so that other threads wait for them instead of
+   changing or evicting them.  The cache lock must be held, and
+   is released while writing. */
+static void
+write_batch (struct cache_entry **batch, size_t cnt)
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  for (i = 0; i < cnt; i++)
+    {
+      struct block_request *r = &batch[i]->io;
+
+      ASSERT (batch[i]->valid && batch[i]->dirty && !batch[i]->busy);
+      batch[i]->busy = true;
+      r->sector = batch[i]->sector;
+      r->cnt = 1;
+      r->buffer = batch[i]->data;
+      r->write = true;
+      r->prepaid = true;
+    }
+  lock_release (&cache_lock);
+  for (i = 0; i < cnt; i++)
+    block_submit (fs_device, &batch[i]->io);
+  for (i = 0; i < cnt; i++)
+    block_wait (&batch[i]->io);
+  lock_acquire (&cache_lock);
+  for (i = 0; i < cnt; i++)
+    {
+      batch[i]->dirty = false;
+      batch[i]->busy = false;
+      cond_broadcast (&batch[i]->idle, &cache_lock);
+    }
+}
+
+/* Returns the number of sectors the write-behind thread may
+   write in one pass at cache_writeback_rate, at least one. */
+static size_t
+writeback_batch (void)
+{
+  size_t cnt = cache_writeback_rate * WRITEBACK_INTERVAL / TIMER_FREQ;
+  return cnt > 0 ? cnt : 1;
+}
+
+/* Orders pointers to cache entries by when they became dirty,
+   for qsort(). */
+static int
+older_first (const void *a_, const void *b_)
+{
+  const struct cache_entry *const *a = a_;
+  const struct cache_entry *const *b = b_;
+
+  return (*a)->dirtied < (*b)->dirtied ? -1 : (*a)->dirtied > (*b)->dirtied;
+}
+
+/* Orders pointers to cache entries by sector, for qsort(). */
+static int
+lower_sector_first (const void *a_, const void *b_)
+{
+  const struct cache_entry *const *a = a_;
+  const struct cache_entry *const *b = b_;
+
+  return ((*a)->sector < (*b)->sector ? -1
+          : (*a)->sector > (*b)->sector);
+}
+
+/* Writes zeros to every sector in ZERO_MAP, in runs of up to
+   ZERO_RUN_SECTORS sectors, and takes them out of it, except
+   sectors with a direct transfer in flight, which are left for
+   later.  The cache lock must be held, and is released while
+   writing. */
+static void
+flush_zeros (void)
+{
+  size_t start = 0;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  while ((start = bitmap_scan (zero_map, start, 1, true)) != BITMAP_ERROR)
+    {
+      size_t cnt = 0;
+
+      while (cnt < ZERO_RUN_SECTORS && start + cnt < bitmap_size (zero_map)
+             && bitmap_test (zero_map, start + cnt)
+             && !bitmap_test (direct_map, start + cnt))
+        cnt++;
+      if (cnt > 0)
+        write_zeros (start, cnt);
+      start += cnt > 0 ? cnt : 1;
+    }
+}
+
+/* Writes zeros to the CNT sectors starting at START, which are
+   owed them, and takes them out of ZERO_MAP.  They are marked in
+   DIRECT_MAP until the zeros are on disk, so that nobody reads
+   one from disk before then.  The cache lock must be held, and
+   is released while writing. */
+static void
+write_zeros (block_sector_t start, size_t cnt)
+{
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  bitmap_set_multiple (zero_map, start, cnt, false);
+  bitmap_set_multiple (direct_map, start, cnt, true);
+  lock_release (&cache_lock);
+  block_write_multiple (fs_device, start, zeros, cnt);
+  lock_acquire (&cache_lock);
+  bitmap_set_multiple (direct_map, start, cnt, false);
+  cond_broadcast (&unblocked, &cache_lock);
+}
+
+/* Write-behind thread.  Writes back a batch of old dirty
+   sectors every WRITEBACK_INTERVAL ticks.  Every
+   CACHE_FLUSH_INTERVAL ticks, instead, commits the journal, or
+   just flushes the free map on a disk without one, and then
+   flushes every dirty sector, so that a crash loses at most
+   CACHE_FLUSH_INTERVAL ticks of writes. */
+static void
+flush_daemon (void *aux UNUSED)
+{
+  int64_t next_flush = timer_ticks () + CACHE_FLUSH_INTERVAL;
+
+  for (;;)
+    {
+      timer_sleep (WRITEBACK_INTERVAL);
+      if (timer_elapsed (next_flush) >= 0)
+        {
+          if (!journal_commit ())
+            free_map_flush ();
+          cache_flush ();
+          next_flush = timer_ticks () + CACHE_FLUSH_INTERVAL;
+        }
+      else
+        {
+          lock_acquire (&cache_lock);
+          write_behind (writeback_batch (), false);
+          lock_release (&cache_lock);
+        }
+    }
+}
+
+/* Read-ahead thread.  Loads queued sectors that are not already
+   cached.  They are left unaccessed, so that a prefetched sector
+   nobody reads is the first to be evicted again.  The cache lock
+   is released while each one is read, so that prefetching never
+   holds up other cache users. */
+static void
+read_ahead_daemon (void *aux UNUSED)
+{
+  for (;;)
+    {
+      block_sector_t sector;
+
+      lock_acquire (&ra_lock);
+      while (ra_cnt == 0)
+        cond_wait (&ra_nonempty, &ra_lock);
+      sector = ra_queue[ra_head];
+      ra_head = (ra_head + 1) % READ_AHEAD_QUEUE_SIZE;
+      ra_cnt--;
+      lock_release (&ra_lock);
+
+      lock_acquire (&cache_lock);
+      if (cache_lookup (sector) == NULL)
+        cache_load (sector, true, false)->accessed = false;
+      lock_release (&cache_lock);
+    }
+}
+
+/* Warm-up thread.  Loads the sectors in WARM that are not
+   already cached, as hot as they were at shutdown, then exits.
+   As with read-ahead, the cache lock is not held while each one
+   is read. */
+static void
+warm_daemon (void *aux UNUSED)
+{
+  block_sector_t size = block_size (fs_device);
+  size_t i;
+
+  for (i = 0; i < warm.cnt; i++)
+    {
+      block_sector_t sector = warm.sectors[i];
+
+      if (sector >= size)
+        continue;
+      lock_acquire (&cache_lock);
+      load_hot (sector, warm.meta[i]);
+      lock_release (&cache_lock);
+    }
+}
+
+/* Loads SECTOR, which holds metadata if META is true, into the
+   cache as a hot entry, unless it is cached already.  Returns
+   true if it read SECTOR from disk. */
+static bool
+load_hot (block_sector_t sector, bool meta)
+{
+  struct cache_entry *e;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  if (cache_lookup (sector) != NULL)
+    return false;
+  e = cache_load (sector, true, meta);
+  if (!e->hot)
+    {
+      e->hot = true;
+      cold_cnt--;
+    }
+  e->accessed = false;
+  return true;
+}
+
+/* Writes the hot sectors, sorted, to WARM_SECTOR for
+   cache_warm() to load at the next boot. */
+static void
+warm_save (void)
+{
+  size_t i;
+
+  if (!warm_active)
+    return;
+
+  lock_acquire (&cache_lock);
+  warm.cnt = 0;
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].valid && cache[i].hot && cache[i].sector != WARM_SECTOR)
+      warm.sectors[warm.cnt++] = cache[i].sector;
+  qsort (warm.sectors, warm.cnt, sizeof *warm.sectors, compare_sectors);
+  for (i = 0; i < warm.cnt; i++)
+    {
+      struct cache_entry *e = cache_lookup (warm.sectors[i]);
+      warm.meta[i] = e->meta;
+    }
+  lock_release (&cache_lock);
+
+  block_write (fs_device, WARM_SECTOR, &warm);
+}
+
+/* Compares the block_sector_t values at A and B, for qsort(). */
+static int
+compare_sectors (const void *a_, const void *b_)
+{
+  const block_sector_t *a = a_;
+  const block_sector_t *b = b_;
+
+  return *a < *b ? -1 : *a > *b;
+}
+
+/* Returns the entry caching SECTOR, or a null pointer if SECTOR
+   is not cached.  The cache lock must be held. */
+static struct cache_entry *
+cache_lookup (block_sector_t sector)
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].valid && cache[i].sector == sector)
+      return &cache[i];
+  return NULL;
+}
+
+/* Chooses an entry to reuse and returns it marked invalid.  The
+   oldest cold entry goes if more than COLD_TARGET entries are
+   cold or no hot entry can go, and otherwise a hot one chosen by
+   the clock.  Entries that are busy, pinned, or in the running
+   transaction are passed over.  If the victim is dirty, it is
+   written back instead, and a null pointer returned; the same
+   happens after waiting for a busy entry, or committing the
+   transaction, when nothing else is left.  The cache lock is
+   released in those cases, so the caller must look for its
+   sector again, which another thread may have loaded meanwhile.
+   The cache lock must be held. */
+static struct cache_entry *
+cache_evict (void)
+{
+  struct cache_entry *e;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (!cache[i].valid && cache[i].pin_cnt == 0)
+      return &cache[i];
+
+  e = oldest_cold ();
+  if (e == NULL || cold_cnt <= COLD_TARGET)
+    {
+      struct cache_entry *hot = clock_hot ();
+      if (hot != NULL)
+        e = hot;
+    }
+  if (e == NULL)
+    {
+      for (i = 0; i < CACHE_SIZE; i++)
+        if (cache[i].busy)
+          {
+            cond_wait (&cache[i].idle, &cache_lock);
+            return NULL;
+          }
+      if (journaled_cnt > 0)
+        commit_locked ();
+      else
+        cond_wait (&unblocked, &cache_lock);
+      return NULL;
+    }
+  if (e->dirty)
+    {
+      write_batch (&e, 1);
+      return NULL;
+    }
+
+  if (!e->hot)
+    {
+      ghosts[ghost_next] = e->sector;
+      ghost_next = (ghost_next + 1) % GHOST_CNT;
+    }
+  else
+    evict_hot_cnt++;
+  evict_cnt++;
+  drop (e);
+  return e;
+}
+
+/* Returns true if E may be evicted.  A dirty entry whose sector
+   has a direct transfer in flight may not, since it could not be
+   written back.  The cache lock must be held. */
+static bool
+evictable (const struct cache_entry *e)
+{
+  return (e->valid && !e->busy && e->pin_cnt == 0 && !e->journaled
+          && !(e->dirty && bitmap_test (direct_map, e->sector)));
+}
+
+/* Returns the evictable cold entry loaded longest ago, or a null
+   pointer if there is none.  The cache lock must be held. */
+static struct cache_entry *
+oldest_cold (void)
+{
+  struct cache_entry *oldest = NULL;
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &cache[i];
+      if (evictable (e) && !e->hot
+          && (oldest == NULL || e->loaded < oldest->loaded))
+        oldest = e;
+    }
+  return oldest;
+}
+
+/* Returns a hot entry to evict, chosen by the clock algorithm,
+   or a null pointer if there is none.  Metadata is taken only on
+   the third turn, after the first has cleared every accessed bit
+   and the second has found no other entry.  The cache lock must
+   be held. */
+static struct cache_entry *
+clock_hot (void)
+{
+  size_t i;
+
+  for (i = 0; i < 3 * CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &cache[clock_hand];
+      clock_hand = (clock_hand + 1) % CACHE_SIZE;
+
+      if (!evictable (e) || !e->hot)
+        continue;
+      if (e->accessed)
+        e->accessed = false;
+      else if (!e->meta || i >= 2 * CACHE_SIZE)
+        return e;
+    }
+  return NULL;
+}
+
+/* Marks E invalid, without writing it back, and takes it out of
+   the running transaction.  The cache lock must be held. */
+static void
+drop (struct cache_entry *e)
+{
+  ASSERT (e->valid && !e->busy);
+
+  if (e->journaled)
+    journaled_cnt--;
+  if (!e->hot)
+    cold_cnt--;
+  e->journaled = false;
+  e->valid = false;
+}
+
+/* Returns true, forgetting it, if SECTOR is among the cold
+   sectors evicted last.  The cache lock must be held. */
+static bool
+ghost_take (block_sector_t sector)
+{
+  size_t i;
+
+  for (i = 0; i < GHOST_CNT; i++)
+    if (ghosts[i] == sector)
+      {
+        ghosts[i] = BLOCK_SECTOR_NONE;
+        return true;
+      }
+  return false;
+}
+
+/* Marks E as holding metadata, which makes it hot.  The cache
+   lock must be held. */
+static void
+make_meta (struct cache_entry *e)
+{
+  e->meta = true;
+  if (!e->hot)
+    {
+      e->hot = true;
+      cold_cnt--;
+    }
+}
+
+/* Returns the entry for SECTOR, bringing it into the cache if
+   necessary, and marks it as holding metadata if META is true.
+   If READ is false the caller is about to overwrite the whole
+   sector, so its old contents are not read from disk.  The entry
+   returned is not busy.  The cache lock must be held; it is
+   released while reading from disk and while waiting for other
+   threads' transfers, so entries the caller looked up before may
+   have changed by the time this returns. */
+static struct cache_entry *
+cache_load (block_sector_t sector, bool read, bool meta)
+{
+  struct cache_entry *e;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  for (;;)
+    {
+      e = cache_lookup (sector);
+      if (bitmap_test (direct_map, sector))
+        cond_wait (&unblocked, &cache_lock);
+      else if (e != NULL && e->busy)
+        cond_wait (&e->idle, &cache_lock);
+      else if (e != NULL)
+        {
+          hit_cnt++;
+          break;
+        }
+      else if ((e = cache_evict ()) != NULL)
+        {
+          miss_cnt++;
+          e->sector = sector;
+          e->dirty = false;
+          e->journaled = false;
+          e->meta = false;
+          e->hot = ghost_take (sector);
+          if (!e->hot)
+            cold_cnt++;
+          e->loaded = ++load_cnt;
+          e->valid = true;
+          if (bitmap_test (zero_map, sector))
+            {
+              /* Still owed zeros: they are written with the entry. */
+              bitmap_reset (zero_map, sector);
+              memset (e->data, 0, BLOCK_SECTOR_SIZE);
+              e->dirty = true;
+              e->dirtied = timer_ticks ();
+            }
+          else if (read)
+            {
+              e->busy = true;
+              lock_release (&cache_lock);
+              block_read (fs_device, sector, e->data);
+              lock_acquire (&cache_lock);
+              e->busy = false;
+              cond_broadcast (&e->idle, &cache_lock);
+            }
+          break;
+        }
+    }
+  if (meta)
+    make_meta (e);
+  e->accessed = true;
+  return e;
+}
+
+/* Returns the entry for SECTOR as cache_load() does, ready for
+   mark_written().  If SECTOR is in the journal and the entry
+   holds a committed version not yet written home, that version
+   goes home first, since the checkpoint that empties the journal
+   leaves the running transaction's entries where they are.  The
+   cache lock must be held, and is released while writing and
+   waiting. */
+static struct cache_entry *
+load_for_write (block_sector_t sector, bool read, bool meta)
+{
+  for (;;)
+    {
+      struct cache_entry *e = cache_load (sector, read, meta);
+
+      if (e->journaled || !e->dirty || !bitmap_test (logged_map, sector))
+        return e;
+      write_batch (&e, 1);
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef FILESYS_CACHE_H
+#define FILESYS_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+
+/* Write-behind rate in sectors per second, from "-wbrate". */
+extern unsigned cache_writeback_rate;
+
+void cache_init (void);
+void cache_done (void);
+void cache_warm_create (void);
+void cache_warm (void);
+
+void cache_read (block_sector_t, void *);
+void cache_write (block_sector_t, const void *);
+void cache_read_part (block_sector_t, void *, size_t ofs, size_t size);
+void cache_write_part (block_sector_t, const void *, size_t ofs, size_t size);
+void cache_copy (block_sector_t dst, size_t dst_ofs,
+                 block_sector_t src, size_t src_ofs, size_t size);
+void cache_read_ahead (block_sector_t);
+bool cache_preload (block_sector_t);
+void cache_zero (block_sector_t);
+void cache_flush (void);
+void cache_commit (void);
+void cache_flush_sectors (const block_sector_t *, size_t cnt);
+void cache_direct (struct block_request *, size_t cnt);
+void cache_print_stats (void);
+
+#endif /* filesys/cache.h */
@@ -0,0 +1,226 @@
+#include "filesys/dcache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/kmem.h"
+#include "threads/shrinker.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Directory entry cache.  Remembers the results of recent name
+   lookups, as (directory sector, name) -> inode sector, so that
+   walking a path again does not have to search each directory
+   along it.  Failed lookups are remembered too, as "negative"
+   entries whose inode sector is 0 (the free map's inode, which
+   no directory ever names).
+
+   Entries come from an object cache.  The cache grows as
+   lookups come in, up to DCACHE_MAX entries, and then replaces
+   the least recently used one; when the kernel pool runs short,
+   its shrinker discards the least recently used entries instead.
+   The directory layer keeps the cache
+   coherent by calling dcache_insert() and dcache_remove() as it
+   adds and removes entries, and dcache_remove_dir() when a
+   directory is deleted. */
+
+/* Most entries in the cache. */
+#define DCACHE_MAX 1024
+
+/* A cached name lookup. */
+struct dentry
+  {
+    struct hash_elem hash_elem;         /* Element in dcache. */
+    struct list_elem lru_elem;          /* Element in lru. */
+    block_sector_t dir;                 /* Directory searched. */
+    char name[NAME_MAX + 1];            /* Name looked up. */
+    block_sector_t sector;              /* Inode found, or 0 if none. */
+  };
+
+static struct kmem_cache dentry_cache;  /* Entries. */
+static struct hash dcache;              /* Entries in use. */
+static struct list lru;                 /* Entries in use, most recent first. */
+static struct lock dcache_lock;         /* Protects all of the above. */
+static struct shrinker dcache_shrinker;
+
+static hash_hash_func dentry_hash;
+static hash_less_func dentry_less;
+static struct dentry *dentry_find (block_sector_t dir, const char *name);
+static void dentry_discard (struct dentry *);
+static shrink_func dcache_shrink;
+
+/* Initializes the directory entry cache. */
+void
+dcache_init (void)
+{
+  if (!hash_init (&dcache, dentry_hash, dentry_less, NULL))
+    PANIC ("can't allocate directory entry cache");
+  kmem_cache_init (&dentry_cache, "dentry", sizeof (struct dentry), NULL);
+  list_init (&lru);
+  lock_init (&dcache_lock);
+  lock_set_spin (&dcache_lock, LOCK_SPIN_SHORT);
+  lock_register (&dcache_lock, "dcache");
+  shrinker_register (&dcache_shrinker, "dcache", dcache_shrink);
+}
+
+/* Looks up NAME in the directory whose inode is in sector DIR.
+   If the answer is cached, stores the sector of the inode NAME
+   refers to into *SECTORP, or 0 if DIR is known not to contain
+   NAME, and returns true.  Returns false if the answer is not
+   cached. */
+bool
+dcache_lookup (block_sector_t dir, const char *name,
+               block_sector_t *sectorp)
+{
+  struct dentry *d;
+
+  lock_acquire (&dcache_lock);
+  d = dentry_find (dir, name);
+  if (d != NULL)
+    {
+      *sectorp = d->sector;
+      list_remove (&d->lru_elem);
+      list_push_front (&lru, &d->lru_elem);
+    }
+  lock_release (&dcache_lock);
+
+  return d != NULL;
+}
+
+/* Records that NAME in directory DIR refers to the inode in
+   SECTOR, or that DIR has no entry NAME if SECTOR is 0. */
+void
+dcache_insert (block_sector_t dir, const char *name, block_sector_t sector)
+{
+  struct dentry *d;
+
+  if (strlen (name) > NAME_MAX)
+    return;
+
+  lock_acquire (&dcache_lock);
+  d = dentry_find (dir, name);
+  if (d == NULL)
+    {
+      if (hash_size (&dcache) < DCACHE_MAX)
+        d = kmem_cache_alloc (&dentry_cache);
+      if (d == NULL)
+        {
+          if (list_empty (&lru))
+            {
+              lock_release (&dcache_lock);
+              return;
+            }
+          d = list_entry (list_back (&lru), struct dentry, lru_elem);
+          hash_delete (&dcache, &d->hash_elem);
+          list_remove (&d->lru_elem);
+        }
+      d->dir = dir;
+      strlcpy (d->name, name, sizeof d->name);
+      hash_insert (&dcache, &d->hash_elem);
+    }
+  else
+    list_remove (&d->lru_elem);
+  d->sector = sector;
+  list_push_front (&lru, &d->lru_elem);
+  lock_release (&dcache_lock);
+}
+
+/* Forgets anything cached about NAME in directory DIR. */
+void
+dcache_remove (block_sector_t dir, const char *name)
+{
+  struct dentry *d;
+
+  lock_acquire (&dcache_lock);
+  d = dentry_find (dir, name);
+  if (d != NULL)
+    dentry_discard (d);
+  lock_release (&dcache_lock);
+}
+
+/* Forgets everything cached about names in directory DIR, which
+   is being deleted, so that its sector may be reused. */
+void
+dcache_remove_dir (block_sector_t dir)
+{
+  struct list_elem *e;
+
+  lock_acquire (&dcache_lock);
+  for (e = list_begin (&lru); e != list_end (&lru); )
+    {
+      struct dentry *d = list_entry (e, struct dentry, lru_elem);
+      e = list_next (e);
+      if (d->dir == dir)
+        dentry_discard (d);
+    }
+  lock_release (&dcache_lock);
+}
+
+/* Returns the cache entry for NAME in DIR, or a null pointer if
+   there is none.  The cache lock must be held. */
+static struct dentry *
+dentry_find (block_sector_t dir, const char *name)
+{
+  struct dentry key;
+  struct hash_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&dcache_lock));
+
+  if (strlen (name) > NAME_MAX)
+    return NULL;
+  key.dir = dir;
+  strlcpy (key.name, name, sizeof key.name);
+  e = hash_find (&dcache, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct dentry, hash_elem) : NULL;
+}
+
+/* Removes D from the cache and frees it.  The cache lock must be
+   held. */
+static void
+dentry_discard (struct dentry *d)
+{
+  hash_delete (&dcache, &d->hash_elem);
+  list_remove (&d->lru_elem);
+  kmem_cache_free (&dentry_cache, d);
+}
+
+/* Shrinker for the cache.  Discards the least recently used
+   entries, a page's worth for each of PAGE_CNT pages, unless the
+   cache is locked.  Returns 0, since the pages themselves are
+   freed, along with the object cache's free slabs, by
+   kmem_shrink(). */
+static size_t
+dcache_shrink (size_t page_cnt)
+{
+  size_t cnt = page_cnt * (PGSIZE / sizeof (struct dentry));
+
+  if (lock_held_by_current_thread (&dcache_lock)
+      || !lock_try_acquire (&dcache_lock))
+    return 0;
+  while (cnt-- > 0 && !list_empty (&lru))
+    dentry_discard (list_entry (list_back (&lru), struct dentry, lru_elem));
+  lock_release (&dcache_lock);
+  return 0;
+}
+
+/* Returns a hash value for the entry containing E. */
+static unsigned
+dentry_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct dentry *d = hash_entry (e, struct dentry, hash_elem);
+  return hash_string (d->name) ^ hash_int (d->dir);
+}
+
+/* Returns true if the entry containing A sorts before B's. */
+static bool
+dentry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+             void *aux UNUSED)
+{
+  const struct dentry *a = hash_entry (a_, struct dentry, hash_elem);
+  const struct dentry *b = hash_entry (b_, struct dentry, hash_elem);
+
+  if (a->dir != b->dir)
+    return a->dir < b->dir;
+  return strcmp (a->name, b->name) < 0;
+}
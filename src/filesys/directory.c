@@ -1,11 +1,18 @@
 #include "filesys/directory.h"
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
+#include "filesys/cache.h"
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/statfs.h"
+#include "threads/kmem.h"
 #include "threads/malloc.h"
+#include "threads/scratch.h"
 #include "devices/block.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 
 #define ASCII_SLASH 47
@@ -25,6 +32,57 @@ struct dir_entry
   bool in_use;                        /* In use or free? */
 };
 
+/* In-memory index of a directory's entries, built when the
+   directory is first searched and kept up to date by dir_add()
+   and dir_remove() until its inode is closed.  Lets a lookup
+   find a name, and dir_add() find a free slot, without reading
+   every entry. */
+struct dir_index
+{
+  struct hash names;                  /* Entries in use, by name. */
+  struct list free_slots;             /* Offsets of unused entries. */
+};
+
+/* An entry in use, in a dir_index's NAMES. */
+struct dir_index_name
+{
+  struct hash_elem elem;
+  char name[NAME_MAX + 1];            /* Null terminated file name. */
+  block_sector_t inode_sector;        /* Sector number of header. */
+  off_t ofs;                          /* Byte offset of entry. */
+};
+
+/* An unused entry, in a dir_index's FREE_SLOTS. */
+struct dir_index_slot
+{
+  struct list_elem elem;
+  off_t ofs;                          /* Byte offset of entry. */
+};
+
+/* Serializes lookups in, and changes to, the contents of every
+   directory, including their name indexes and the dentry cache
+   entries that describe them.  File data is never touched under
+   this lock. */
+static struct lock dir_lock;
+
+/* Cache of struct dir objects. */
+static struct kmem_cache dir_cache;
+
+static struct dir_index *dir_index_get (const struct dir *);
+static bool dir_index_add_name (struct dir_index *, const char *name,
+                                block_sector_t, off_t ofs);
+static bool dir_index_add_slot (struct dir_index *, off_t ofs);
+static void dir_index_drop (const struct dir *);
+
+/* Initializes the directory module. */
+void
+dir_init (void)
+{
+  lock_init (&dir_lock);
+  lock_register (&dir_lock, "directory");
+  kmem_cache_init (&dir_cache, "dir", sizeof (struct dir), NULL);
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
    given SECTOR.  Returns true if successful, false on failure. */
 bool
@@ -40,7 +98,7 @@ dir_open (struct inode *inode)
 {
    //printf("dir_ope function\n\n");
 
-  struct dir *dir = calloc (1, sizeof *dir);
+  struct dir *dir = kmem_cache_alloc (&dir_cache);
   if (inode != NULL && dir != NULL)
   {
     dir->inode = inode;
@@ -50,7 +108,7 @@ dir_open (struct inode *inode)
   else
   {
     inode_close (inode);
-    free (dir);
+    kmem_cache_free (&dir_cache, dir);
     return NULL; 
   }
 }
@@ -78,7 +136,7 @@ dir_close (struct dir *dir)
   if (dir != NULL)
   {
     inode_close (dir->inode);
-    free (dir);
+    kmem_cache_free (&dir_cache, dir);
   }
 }
 
@@ -98,12 +156,38 @@ static bool
 lookup (const struct dir *dir, const char *name,
     struct dir_entry *ep, off_t *ofsp) 
 {
+  struct dir_index *index;
   struct dir_entry e;
   size_t ofs;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  index = dir_index_get (dir);
+  if (index != NULL)
+    {
+      struct dir_index_name key, *n;
+      struct hash_elem *he;
+
+      if (strlen (name) > NAME_MAX)
+        return false;
+      strlcpy (key.name, name, sizeof key.name);
+      he = hash_find (&index->names, &key.elem);
+      if (he == NULL)
+        return false;
+
+      n = hash_entry (he, struct dir_index_name, elem);
+      if (ep != NULL)
+        {
+          ep->inode_sector = n->inode_sector;
+          strlcpy (ep->name, n->name, sizeof ep->name);
+          ep->in_use = true;
+        }
+      if (ofsp != NULL)
+        *ofsp = n->ofs;
+      return true;
+    }
+
   for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
       ofs += sizeof e) 
     if (e.in_use && !strcmp (name, e.name)) 
@@ -125,15 +209,25 @@ bool
 dir_lookup (const struct dir *dir, const char *name,
     struct inode **inode) 
 {
+  block_sector_t dir_sector, sector;
   struct dir_entry e;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
-    *inode = inode_open (e.inode_sector);
-  else
-    *inode = NULL;
+  /* The inode is opened before the lock is released, so that it
+     cannot be removed and freed in between. */
+  lock_acquire (&dir_lock);
+  dir_sector = inode_get_inumber (dir->inode);
+  if (!dcache_lookup (dir_sector, name, &sector))
+    {
+      sector = lookup (dir, name, &e, NULL) ? e.inode_sector : 0;
+      dcache_insert (dir_sector, name, sector);
+    }
+  if (sector == 0)
+    sector = statfs_lookup (dir_sector, name);
+  *inode = sector != 0 ? inode_open (sector) : NULL;
+  lock_release (&dir_lock);
 
   return *inode != NULL;
 }
@@ -147,6 +241,7 @@ dir_lookup (const struct dir *dir, const char *name,
 bool
 dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
 {
+  struct dir_index *index;
   struct dir_entry e;
   off_t ofs;
   bool success = false;
@@ -158,6 +253,8 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   if (*name == '\0' || strlen (name) > NAME_MAX)
     return false;
 
+  lock_acquire (&dir_lock);
+
   /* Check that NAME is not in use. */
   if (lookup (dir, name, NULL, NULL))
     goto done;
@@ -170,18 +267,50 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
      inode_read_at() will only return a short read at end of file.
      Otherwise, we'd need to verify that we didn't get a short
      read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-      ofs += sizeof e) 
-    if (!e.in_use)
-      break;
+  index = dir_index_get (dir);
+  if (index != NULL)
+    {
+      if (!list_empty (&index->free_slots))
+        {
+          struct dir_index_slot *slot
+            = list_entry (list_pop_front (&index->free_slots),
+                          struct dir_index_slot, elem);
+          ofs = slot->ofs;
+          free (slot);
+        }
+      else
+        ofs = inode_length (dir->inode);
+    }
+  else
+    for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+        ofs += sizeof e) 
+      if (!e.in_use)
+        break;
 
   /* Write slot. */
   e.in_use = true;
   strlcpy (e.name, name, sizeof e.name);
   e.inode_sector = inode_sector;
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+  if (success)
+    dcache_insert (inode_get_inumber (dir->inode), name, inode_sector);
+
+  /* Keep the index in step, or drop it to be rebuilt later. */
+  if (index != NULL)
+    {
+      bool indexed;
+
+      if (success)
+        indexed = dir_index_add_name (index, name, inode_sector, ofs);
+      else
+        indexed = (ofs >= inode_length (dir->inode)
+                   || dir_index_add_slot (index, ofs));
+      if (!indexed)
+        dir_index_drop (dir);
+    }
 
 done:
+  lock_release (&dir_lock);
   return success;
 }
 
@@ -191,6 +320,7 @@ done:
 bool
 dir_remove (struct dir *dir, const char *name) 
 {
+  struct dir_index *index;
   struct dir_entry e;
   struct inode *inode = NULL;
   bool success = false;
@@ -199,6 +329,8 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  lock_acquire (&dir_lock);
+
   /* Find directory entry. */
   if (!lookup (dir, name, &e, &ofs))
     goto done;
@@ -225,6 +357,24 @@ dir_remove (struct dir *dir, const char *name)
   e.in_use = false;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
     goto done;
+  dcache_remove (inode_get_inumber (dir->inode), name);
+  if (inode_is_dir (inode))
+    dcache_remove_dir (inode_get_inumber (inode));
+
+  /* Move the entry to the index's free slots. */
+  index = inode_get_dir_index (dir->inode);
+  if (index != NULL)
+    {
+      struct dir_index_name key;
+      struct hash_elem *he;
+
+      strlcpy (key.name, name, sizeof key.name);
+      he = hash_delete (&index->names, &key.elem);
+      if (he != NULL)
+        free (hash_entry (he, struct dir_index_name, elem));
+      if (!dir_index_add_slot (index, ofs))
+        dir_index_drop (dir);
+    }
 
   /* Remove inode. */
   inode_remove (inode);
@@ -232,9 +382,125 @@ dir_remove (struct dir *dir, const char *name)
 
 done:
   inode_close (inode);
+  lock_release (&dir_lock);
   return success;
 }
 
+/* Returns a hash value for the dir_index_name containing E. */
+static unsigned
+dir_index_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_string (hash_entry (e, struct dir_index_name, elem)->name);
+}
+
+/* Returns true if the name containing A sorts before B's. */
+static bool
+dir_index_less (const struct hash_elem *a, const struct hash_elem *b,
+                void *aux UNUSED)
+{
+  return strcmp (hash_entry (a, struct dir_index_name, elem)->name,
+                 hash_entry (b, struct dir_index_name, elem)->name) < 0;
+}
+
+/* Frees the dir_index_name containing E. */
+static void
+dir_index_free_name (struct hash_elem *e, void *aux UNUSED)
+{
+  free (hash_entry (e, struct dir_index_name, elem));
+}
+
+/* Returns DIR's name index, reading every entry of DIR to build
+   it if DIR's inode does not have one yet.  Returns a null
+   pointer if memory runs out, in which case callers must fall
+   back to scanning the entries. */
+static struct dir_index *
+dir_index_get (const struct dir *dir)
+{
+  struct dir_index *index = inode_get_dir_index (dir->inode);
+  struct dir_entry e;
+  off_t ofs;
+
+  if (index != NULL)
+    return index;
+
+  index = malloc (sizeof *index);
+  if (index == NULL)
+    return NULL;
+  if (!hash_init (&index->names, dir_index_hash, dir_index_less, NULL))
+    {
+      free (index);
+      return NULL;
+    }
+  list_init (&index->free_slots);
+
+  /* Have the cache bring in the rest of the directory while we
+     go through the first entries. */
+  inode_read_ahead (dir->inode, 0, inode_length (dir->inode));
+  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+       ofs += sizeof e)
+    if (!(e.in_use
+          ? dir_index_add_name (index, e.name, e.inode_sector, ofs)
+          : dir_index_add_slot (index, ofs)))
+      {
+        dir_index_free (index);
+        return NULL;
+      }
+
+  inode_set_dir_index (dir->inode, index);
+  return index;
+}
+
+/* Records in INDEX that the entry at OFS names NAME, with its
+   inode in SECTOR.  Returns false if out of memory. */
+static bool
+dir_index_add_name (struct dir_index *index, const char *name,
+                    block_sector_t sector, off_t ofs)
+{
+  struct dir_index_name *n = malloc (sizeof *n);
+  if (n == NULL)
+    return false;
+  strlcpy (n->name, name, sizeof n->name);
+  n->inode_sector = sector;
+  n->ofs = ofs;
+  hash_insert (&index->names, &n->elem);
+  return true;
+}
+
+/* Records in INDEX that the entry at OFS is unused.  Returns
+   false if out of memory. */
+static bool
+dir_index_add_slot (struct dir_index *index, off_t ofs)
+{
+  struct dir_index_slot *slot = malloc (sizeof *slot);
+  if (slot == NULL)
+    return false;
+  slot->ofs = ofs;
+  list_push_back (&index->free_slots, &slot->elem);
+  return true;
+}
+
+/* Discards DIR's name index, which has fallen out of date.  It
+   will be rebuilt the next time it is needed. */
+static void
+dir_index_drop (const struct dir *dir)
+{
+  dir_index_free (inode_get_dir_index (dir->inode));
+  inode_set_dir_index (dir->inode, NULL);
+}
+
+/* Frees INDEX, which may be a null pointer. */
+void
+dir_index_free (struct dir_index *index)
+{
+  if (index == NULL)
+    return;
+  hash_destroy (&index->names, dir_index_free_name);
+  while (!list_empty (&index->free_slots))
+    free (list_entry (list_pop_front (&index->free_slots),
+                      struct dir_index_slot, elem));
+  free (index);
+}
+
 /* Reads the next directory entry in DIR and stores the name in
    NAME.  Returns true if successful, false if the directory
    contains no more entries. */
@@ -242,17 +508,94 @@ bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
+  bool found = false;
 
+  lock_acquire (&dir_lock);
+  if (dir->pos == 0)
+    inode_read_ahead (dir->inode, 0, inode_length (dir->inode));
   while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
   {
     dir->pos += sizeof e;
     if (e.in_use)
     {
+      // a caller listing names usually looks at the files next
+      cache_read_ahead (e.inode_sector);
       strlcpy (name, e.name, NAME_MAX + 1);
-      return true;
+      found = true;
+      break;
     } 
   }
-  return false;
+  lock_release (&dir_lock);
+  return found;
+}
+
+/* Writes into BUF a directory entry in use that names the inode
+   in SECTOR NAME, for a directory that is made up in memory
+   rather than read from disk, and returns its size in bytes. */
+off_t
+dir_format_entry (void *buf, const char *name, block_sector_t sector)
+{
+  struct dir_entry e;
+
+  memset (&e, 0, sizeof e);
+  e.inode_sector = sector;
+  strlcpy (e.name, name, sizeof e.name);
+  e.in_use = true;
+  memcpy (buf, &e, sizeof e);
+  return sizeof e;
+}
+
+/* Number of entries dir_readdir_batch() reads from disk at once. */
+#define READDIR_BATCH 16
+
+/* Reads up to CNT of the entries in DIR that are in use,
+   starting at its current position, into ENTS, along with each
+   file's inode number, length, and type.  Returns the number
+   read, which is 0 at the end of the directory.  Unlike
+   dir_readdir(), reads READDIR_BATCH entries at a time, and asks
+   for the inodes of each batch, and the entries of the next, to
+   be read in the background before opening the first inode. */
+size_t
+dir_readdir_batch (struct dir *dir, struct dirent *ents, size_t cnt)
+{
+  struct dir_entry buf[READDIR_BATCH];
+  size_t n = 0;
+
+  lock_acquire (&dir_lock);
+  while (n < cnt)
+    {
+      off_t bytes = inode_read_at (dir->inode, buf, sizeof buf, dir->pos);
+      size_t buf_cnt = bytes / sizeof *buf;
+      size_t i;
+
+      if (buf_cnt == 0)
+        break;
+      for (i = 0; i < buf_cnt; i++)
+        if (buf[i].in_use)
+          cache_read_ahead (buf[i].inode_sector);
+      inode_read_ahead (dir->inode, dir->pos + sizeof buf, sizeof buf);
+      for (i = 0; i < buf_cnt && n < cnt; i++)
+        {
+          struct dirent *d = &ents[n];
+          struct inode *inode;
+
+          dir->pos += sizeof *buf;
+          if (!buf[i].in_use)
+            continue;
+
+          /* The entry can't be removed while the lock is held, so
+             its inode is still there to open. */
+          inode = inode_open (buf[i].inode_sector);
+          d->inumber = buf[i].inode_sector;
+          d->length = inode != NULL ? inode_length (inode) : 0;
+          d->is_dir = inode != NULL && inode_is_dir (inode);
+          strlcpy (d->name, buf[i].name, sizeof d->name);
+          inode_close (inode);
+          n++;
+        }
+    }
+  lock_release (&dir_lock);
+  return n;
 }
 
 /* Returns true if dir is root. Otherwise returns false */
@@ -271,7 +614,8 @@ bool dir_get_parent (struct dir *dir, struct inode **inode)
   return *inode != NULL;
 }
 
-/* returns true if dir is empty. returns false otherwise */
+/* returns true if dir is empty. returns false otherwise.
+   Called by dir_remove() with the directory lock held. */
 bool dir_is_empty(struct inode *inode)
 {
   struct dir_entry e;
@@ -289,15 +633,16 @@ bool dir_is_empty(struct inode *inode)
 /* return the directory which contains the file */
 struct dir *get_containing_dir(const char * path) 
 {
-  char path_string[strlen(path) + 1];
+  struct scratch_mark mark = scratch_begin();
+  char *path_string = scratch_strdup(path);
   struct dir *dir;
-  struct thread *cur = thread_current();
+  struct thread *cur = thread_process();
   char *save_ptr;
   char *token;
-  char *next_token;
+  char *next_token = NULL;
   struct inode *inode;
 
-  memcpy(path_string, path, strlen(path) + 1);
+  if(!path_string) return NULL;
 
   if(path_string[0] == ASCII_SLASH || !cur->cwd) // if the pathstarts with slash or cwd is null
     dir = dir_open_root(); // absolute path
@@ -313,11 +658,11 @@ struct dir *get_containing_dir(const char * path)
     {
       if(strcmp(token, "..") == 0) // token indicates parent directory
       {
-	if(!dir_get_parent(dir, &inode)) return NULL; // save parent inode. if fails, return NULL
+	if(!dir_get_parent(dir, &inode)) break; // save parent inode. if fails, return NULL
       }
       else
       {
-	if(!dir_lookup(dir, token, &inode)) return NULL; // save inode corresponding to token. if fails, return NULL
+	if(!dir_lookup(dir, token, &inode)) break; // save inode corresponding to token. if fails, return NULL
       }
 
       if(inode_is_dir(inode))
@@ -331,6 +676,12 @@ struct dir *get_containing_dir(const char * path)
     token = next_token;
     next_token = strtok_r(NULL, "/", &save_ptr);
   }
+  scratch_end(mark);
+  if(next_token) // stopped early on a failed lookup
+  {
+    dir_close(dir);
+    return NULL;
+  }
   return dir;
 }
 
@@ -338,12 +689,12 @@ struct dir *get_containing_dir(const char * path)
 /* extract file name from the whole path argument */
 char *get_file_name(const char *path)
 {
-  char path_string[strlen(path) + 1];
+  char *path_string = scratch_strdup(path);
   char *save_ptr;
   char *token;
   char *next_token;
 
-  memcpy(path_string, path, strlen(path) + 1);
+  if(!path_string) return NULL;
 
   token = strtok_r(path_string, "/", &save_ptr);
   while(token)
@@ -353,7 +704,5 @@ char *get_file_name(const char *path)
     token = next_token;
   }
 
-  char *file_name = malloc(strlen(token) + 1);
-  memcpy(file_name, token, strlen(token) + 1);
-  return file_name;
+  return token ? token : path_string + strlen(path_string);
 }
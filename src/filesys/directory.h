@@ -3,7 +3,9 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <dirent.h>
 #include "devices/block.h"
+#include "filesys/off_t.h"
 
 /* Maximum length of a file name component.
    This is the traditional UNIX maximum length.
@@ -14,6 +16,7 @@
 struct inode;
 
 /* Opening and closing directories. */
+void dir_init (void);
 bool dir_create (block_sector_t sector, size_t entry_cnt);
 struct dir *dir_open (struct inode *);
 struct dir *dir_open_root (void);
@@ -26,6 +29,12 @@ bool dir_lookup (const struct dir *, const char *name, struct inode **);
 bool dir_add (struct dir *, const char *name, block_sector_t);
 bool dir_remove (struct dir *, const char *name);
 bool dir_readdir (struct dir *, char name[NAME_MAX + 1]);
+size_t dir_readdir_batch (struct dir *, struct dirent *, size_t cnt);
+off_t dir_format_entry (void *, const char *name, block_sector_t);
+
+/* Name index. */
+struct dir_index;
+void dir_index_free (struct dir_index *);
 
 
 /* New implemented */
@@ -33,5 +42,5 @@ bool dir_is_empty (struct inode *);
 bool dir_is_root (struct dir *);
 bool dir_get_parent (struct dir *, struct inode **);
 struct dir *get_containing_dir(const char *); // return the directory which contains the file 
-char *get_file_name(const char *); // extract file name from the whole path argument
+char *get_file_name(const char *); // extract file name from the whole path argument, into scratch memory
 #endif /* filesys/directory.h */
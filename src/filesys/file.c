@@ -1,6 +1,9 @@
 #include "filesys/file.h"
 #include <debug.h>
+#include <string.h>
+#include "devices/block.h"
 #include "filesys/inode.h"
+#include "threads/kmem.h"
 #include "threads/malloc.h"
 
 /* An open file. */
@@ -9,15 +12,47 @@ struct file
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+
+    /* Read-ahead state. */
+    off_t ra_pos;               /* Offset a sequential read starts at. */
+    off_t ra_end;               /* End of data already prefetched. */
+    off_t ra_window;            /* Bytes to prefetch, 0 if not sequential. */
+
+    /* Write buffer for small appends; see file_buffer_write(). */
+    uint8_t *wb;                /* WRITE_BUFFER_SIZE bytes, or null. */
+    off_t wb_start;             /* File offset of wb[0]. */
+    off_t wb_len;               /* Bytes buffered. */
+    off_t wb_end;               /* Offset the buffer may fill up to. */
   };
 
+/* Bounds on the read-ahead window. */
+#define READ_AHEAD_MIN (2 * BLOCK_SECTOR_SIZE)
+#define READ_AHEAD_MAX (32 * BLOCK_SECTOR_SIZE)
+
+/* Size of the write buffer.  Appends smaller than this are
+   buffered. */
+#define WRITE_BUFFER_SIZE BLOCK_SECTOR_SIZE
+
+static void file_read_ahead (struct file *, off_t offset, off_t bytes);
+static bool file_buffer_write (struct file *, const void *, off_t size);
+
+/* Cache of struct file objects. */
+static struct kmem_cache file_cache;
+
+/* Initializes the file module. */
+void
+file_init (void)
+{
+  kmem_cache_init (&file_cache, "file", sizeof (struct file), NULL);
+}
+
 /* Opens a file for the given INODE, of which it takes ownership,
    and returns the new file.  Returns a null pointer if an
    allocation fails or if INODE is null. */
 struct file *
 file_open (struct inode *inode) 
 {
-  struct file *file = calloc (1, sizeof *file);
+  struct file *file = kmem_cache_alloc (&file_cache);
 
      //printf("file_open function : deny_wrtie : %s\n\n", file->deny_write ? "true" : "false");
 
@@ -27,12 +62,15 @@ file_open (struct inode *inode)
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      file->ra_pos = file->ra_end = file->ra_window = 0;
+      file->wb = NULL;
+      file->wb_start = file->wb_len = file->wb_end = 0;
       return file;
     }
   else
     {
       inode_close (inode);
-      free (file);
+      kmem_cache_free (&file_cache, file);
       return NULL; 
     }
 }
@@ -42,6 +80,7 @@ file_open (struct inode *inode)
 struct file *
 file_reopen (struct file *file) 
 {
+  file_flush (file);
   return file_open (inode_reopen (file->inode));
 }
 
@@ -54,13 +93,17 @@ file_close (struct file *file)
 
     if (file != NULL)
     {
+      file_flush (file);
+      free (file->wb);
       file_allow_write (file);
       inode_close (file->inode);
-      free (file); 
+      kmem_cache_free (&file_cache, file);
     }
 }
 
-/* Returns the inode encapsulated by FILE. */
+/* Returns the inode encapsulated by FILE.  FILE's buffered
+   appends are not written out; a caller that reads the inode
+   directly must call file_flush() first. */
 struct inode *
 file_get_inode (struct file *file) 
 {
@@ -75,7 +118,11 @@ file_get_inode (struct file *file)
 off_t
 file_read (struct file *file, void *buffer, off_t size) 
 {
-  off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  off_t bytes_read;
+
+  file_flush (file);
+  bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  file_read_ahead (file, file->pos, bytes_read);
   file->pos += bytes_read;
   return bytes_read;
 }
@@ -88,7 +135,66 @@ file_read (struct file *file, void *buffer, off_t size)
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) 
 {
-  return inode_read_at (file->inode, buffer, size, file_ofs);
+  off_t bytes_read;
+
+  file_flush (file);
+  bytes_read = inode_read_at (file->inode, buffer, size, file_ofs);
+  file_read_ahead (file, file_ofs, bytes_read);
+  return bytes_read;
+}
+
+/* Reads from FILE, starting at the file's current position, into
+   the CNT buffers in IOV, filling each in turn.
+   Returns the number of bytes actually read,
+   which may be less than the buffers' total size if end of file
+   is reached.
+   Advances FILE's position by the number of bytes read. */
+off_t
+file_readv (struct file *file, const struct iovec *iov, size_t cnt)
+{
+  off_t bytes_read;
+
+  file_flush (file);
+  bytes_read = inode_readv_at (file->inode, iov, cnt, file->pos);
+  file_read_ahead (file, file->pos, bytes_read);
+  file->pos += bytes_read;
+  return bytes_read;
+}
+
+/* Notes that BYTES bytes were just read from FILE at OFFSET.
+   While FILE is being read sequentially, has the inode layer
+   prefetch the data that should be wanted next, doubling the
+   window on each sequential read up to READ_AHEAD_MAX.  Any
+   other access pattern shuts read-ahead off. */
+static void
+file_read_ahead (struct file *file, off_t offset, off_t bytes)
+{
+  off_t start, end;
+
+  if (bytes <= 0)
+    return;
+
+  if (offset != file->ra_pos)
+    {
+      file->ra_window = 0;
+      file->ra_end = 0;
+      file->ra_pos = offset + bytes;
+      return;
+    }
+
+  if (file->ra_window == 0)
+    file->ra_window = READ_AHEAD_MIN;
+  else if (file->ra_window < READ_AHEAD_MAX)
+    file->ra_window *= 2;
+  file->ra_pos = offset + bytes;
+
+  start = file->ra_end > file->ra_pos ? file->ra_end : file->ra_pos;
+  end = file->ra_pos + file->ra_window;
+  if (start < end)
+    {
+      inode_read_ahead (file->inode, start, end - start);
+      file->ra_end = end;
+    }
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
@@ -97,15 +203,151 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs)
    which may be less than SIZE if end of file is reached.
    (Normally we'd grow the file in that case, but file growth is
    not yet implemented.)
-   Advances FILE's position by the number of bytes read. */
+   Advances FILE's position by the number of bytes read.
+   A small write at the end of the file may only be buffered; see
+   file_buffer_write(). */
 off_t
 file_write (struct file *file, const void *buffer, off_t size) 
 {
-  off_t bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
+  off_t bytes_written;
+
+  if (size < WRITE_BUFFER_SIZE && file_buffer_write (file, buffer, size))
+    return size;
+  if (!file_flush (file))
+    return 0;
+  bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
   file->pos += bytes_written;
   return bytes_written;
 }
 
+/* Appends the SIZE bytes in BUFFER, fewer than WRITE_BUFFER_SIZE,
+   to FILE's write buffer and advances FILE's position past them,
+   if FILE's position is at the end of the file, or just past the
+   bytes already buffered, and the bytes fit in the room the inode
+   already has for them (see inode_write_room()).  Returns false,
+   without writing anything, otherwise.  Because that room needs
+   no new sectors, nor takes the file past MAXIMUM_SIZE, writing
+   the buffer out later cannot run out of space.
+
+   Programs that log with many small writes would otherwise have
+   each one read, modify, and write back the partial last sector
+   and the inode's length.  The buffer goes to the inode in one
+   write when a write no longer fits in it, and before any other
+   operation on FILE, including reading, seeking, and closing it,
+   so that a failure to write it is reported by that operation.
+   Until then, other files open on the same inode do not see the
+   bytes. */
+static bool
+file_buffer_write (struct file *file, const void *buffer, off_t size)
+{
+  if (file->wb_len == 0)
+    {
+      if (file->pos != inode_length (file->inode)
+          || inode_write_denied (file->inode))
+        return false;
+      file->wb_start = file->pos;
+      file->wb_end = file->pos + inode_write_room (file->inode, file->pos);
+      if (file->wb_end - file->wb_start < size)
+        return false;
+      if (file->wb == NULL)
+        {
+          file->wb = malloc (WRITE_BUFFER_SIZE);
+          if (file->wb == NULL)
+            return false;
+        }
+    }
+  else if (file->pos != file->wb_start + file->wb_len
+           || file->wb_end - file->pos < size)
+    return false;
+
+  memcpy (file->wb + file->wb_len, buffer, size);
+  file->wb_len += size;
+  file->pos += size;
+  return true;
+}
+
+/* Writes FILE's buffered appends, if any, to its inode.  Returns
+   false if not all of them could be written, for example because
+   writes to the inode have since been denied, and moves FILE's
+   position back to the end of the bytes that were. */
+bool
+file_flush (struct file *file)
+{
+  off_t len = file->wb_len;
+  off_t bytes_written;
+
+  if (len == 0)
+    return true;
+  file->wb_len = 0;
+  bytes_written = inode_write_at (file->inode, file->wb, len, file->wb_start);
+  if (bytes_written == len)
+    return true;
+  file->pos = file->wb_start + bytes_written;
+  return false;
+}
+
+/* Writes the CNT buffers in IOV, one after another, into FILE,
+   starting at the file's current position.
+   Returns the number of bytes actually written,
+   which may be less than the buffers' total size if an error
+   occurs.
+   Advances FILE's position by the number of bytes written. */
+off_t
+file_writev (struct file *file, const struct iovec *iov, size_t cnt)
+{
+  off_t bytes_written;
+
+  if (!file_flush (file))
+    return 0;
+  bytes_written = inode_writev_at (file->inode, iov, cnt, file->pos);
+  file->pos += bytes_written;
+  return bytes_written;
+}
+
+/* Gives the SIZE bytes of FILE starting at OFFSET disk space of
+   their own, extending FILE if needed, so that later writes there
+   need no allocation.  Returns false if writing FILE is denied or
+   the disk is full. */
+bool
+file_allocate (struct file *file, off_t offset, off_t size)
+{
+  file_flush (file);
+  return inode_allocate (file->inode, offset, size);
+}
+
+/* Moves data between FILE, starting at offset START, and the CNT
+   buffers in IOV, straight to or from the disk: written to FILE
+   if WRITE is true, otherwise read from it.  See inode_direct_at()
+   for the rules the buffers must follow.  Returns the number of
+   bytes moved.  The file's current position is unaffected. */
+off_t
+file_direct_at (struct file *file, const struct iovec *iov, size_t cnt,
+                off_t start, bool write)
+{
+  file_flush (file);
+  return inode_direct_at (file->inode, iov, cnt, start, write);
+}
+
+/* Copies SIZE bytes from SRC, starting at its current position,
+   into DST at its current position, without a buffer in between.
+   Returns the number of bytes actually copied,
+   which may be less than SIZE if end of SRC is reached.
+   Advances both files' positions by the number of bytes copied. */
+off_t
+file_copy (struct file *dst, struct file *src, off_t size)
+{
+  off_t bytes_copied;
+
+  file_flush (dst);
+  file_flush (src);
+  bytes_copied = inode_copy_at (dst->inode, dst->pos,
+                                      src->inode, src->pos, size);
+  file_read_ahead (src, src->pos, bytes_copied);
+  src->pos += bytes_copied;
+  dst->pos += bytes_copied;
+  return bytes_copied;
+}
+
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at offset FILE_OFS in the file.
    Returns the number of bytes actually written,
@@ -117,6 +359,7 @@ off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
                off_t file_ofs) 
 {
+  file_flush (file);
   return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
@@ -128,6 +371,7 @@ file_deny_write (struct file *file)
 	  //printf("file_deny_write function : denyt_write : %s\n\n ", file->deny_write ? "true" : "false");
 	
   ASSERT (file != NULL);
+  file_flush (file);
   if (!file->deny_write) 
     {
       file->deny_write = true;
@@ -156,6 +400,7 @@ off_t
 file_length (struct file *file) 
 {
   ASSERT (file != NULL);
+  file_flush (file);
   return inode_length (file->inode);
 }
 
@@ -166,6 +411,7 @@ file_seek (struct file *file, off_t new_pos)
 {
   ASSERT (file != NULL);
   ASSERT (new_pos >= 0);
+  file_flush (file);
   file->pos = new_pos;
 }
 
@@ -1,9 +1,14 @@
 #ifndef FILESYS_FILE_H
 #define FILESYS_FILE_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include "filesys/off_t.h"
 
 struct inode;
+struct iovec;
+
+void file_init (void);
 
 /* Opening and closing files. */
 struct file *file_open (struct inode *);
@@ -16,6 +21,13 @@ off_t file_read (struct file *, void *, off_t);
 off_t file_read_at (struct file *, void *, off_t size, off_t start);
 off_t file_write (struct file *, const void *, off_t);
 off_t file_write_at (struct file *, const void *, off_t size, off_t start);
+off_t file_readv (struct file *, const struct iovec *, size_t cnt);
+off_t file_writev (struct file *, const struct iovec *, size_t cnt);
+off_t file_copy (struct file *dst, struct file *src, off_t size);
+bool file_allocate (struct file *, off_t offset, off_t size);
+off_t file_direct_at (struct file *, const struct iovec *, size_t cnt,
+                      off_t start, bool write);
+bool file_flush (struct file *);
 
 /* Preventing writes. */
 void file_deny_write (struct file *);
@@ -2,17 +2,31 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/cache.h"
+#include "filesys/dcache.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
 #include "filesys/directory.h"
+#include "filesys/statfs.h"
 #include "threads/thread.h"
 #include "threads/malloc.h"
+#include "threads/scratch.h"
+#ifdef USERPROG
+#include "userprog/process.h"
+#endif
 
 /* Partition that contains the file system. */
 struct block *fs_device;
 
+/* If false (default), do_format() gives files indirect blocks.
+   If true, it lays them out as extents instead.
+   Controlled by kernel command-line option "-extents". */
+bool filesys_extents;
+
 static void do_format (void);
+static thread_func preload_thread;
 
 /* New Implement for Prj 4 */
 //struct dir *get_containing_dir(const char *); // return the directory which contains the file 
@@ -31,13 +45,76 @@ filesys_init (bool format)
   if (fs_device == NULL)
     PANIC ("No file system device found, can't initialize file system.");
 
+  cache_init ();
+  dcache_init ();
+  file_init ();
+  dir_init ();
   inode_init ();
   free_map_init ();
+  journal_init ();
+  statfs_init ();
 
   if (format) 
     do_format ();
 
+  journal_open ();
   free_map_open ();
+  cache_warm ();
+}
+
+/* Starts a thread that brings the files in FILES, a
+   comma-separated list of paths, into memory in the background:
+   each one's data into the buffer cache, as far as it has room
+   for preloaded data, and the headers and text of each
+   executable into the caches that exec uses (see
+   process_preload()).  For the "-preload" kernel command-line
+   option. */
+void
+filesys_preload (const char *files)
+{
+  size_t size = strlen (files) + 1;
+  char *copy = malloc (size);
+
+  if (copy == NULL)
+    return;
+  strlcpy (copy, files, size);
+  if (thread_create ("preload", PRI_DEFAULT, preload_thread, copy)
+      == TID_ERROR)
+    free (copy);
+}
+
+/* Thread function for filesys_preload(). */
+static void
+preload_thread (void *files_)
+{
+  char *files = files_;
+  char *path, *save_ptr;
+
+  for (path = strtok_r (files, ",", &save_ptr); path != NULL;
+       path = strtok_r (NULL, ",", &save_ptr))
+    {
+      struct inode *inode = filesys_lookup (path);
+      struct file *file;
+
+      if (inode != NULL && inode_is_dir (inode))
+        {
+          printf ("preload: %s: is a directory\n", path);
+          inode_close (inode);
+          continue;
+        }
+      file = inode != NULL ? file_open (inode) : NULL;
+      if (file == NULL)
+        {
+          printf ("preload: %s: open failed\n", path);
+          continue;
+        }
+#ifdef USERPROG
+      process_preload (file, path);
+#endif
+      inode_preload (inode);
+      file_close (file);
+    }
+  free (files);
 }
 
 /* Shuts down the file system module, writing any unwritten data
@@ -46,8 +123,32 @@ void
 filesys_done (void) 
 {
   free_map_close ();
+  journal_commit ();
+  cache_done ();
 }
 
+/* Writes every unwritten change to the file system to disk and
+   waits for the writes to complete. */
+void
+filesys_sync (void)
+{
+  if (!journal_commit ())
+    free_map_flush ();
+  cache_flush ();
+}
+
+/* Writes INODE's unwritten data and the sectors that locate it to
+   disk, and waits for them.  The journal is committed first, or
+   without a journal the free map goes first, so that a crash can
+   leak sectors but never leave a written sector marked free. */
+void
+filesys_fsync (struct inode *inode)
+{
+  if (!journal_commit ())
+    free_map_sync ();
+  inode_sync (inode);
+}
+
 /* Creates a file named NAME with the given INITIAL_SIZE.
    Returns true if successful, false otherwise.
    Fails if a file named NAME already exists,
@@ -56,60 +157,70 @@ bool
 filesys_create (const char *name, off_t initial_size, bool is_dir) 
 {
   block_sector_t inode_sector = 0;
+  journal_begin();
+  struct scratch_mark mark = scratch_begin();
   struct dir *dir = get_containing_dir(name);
   char *file_name = get_file_name(name);
   
   //if(strcmp(name, "") == 0) return false;
 
-  if(strcmp(file_name, ".") == 0 || strcmp(file_name, "..") == 0) return false;
+  if(!file_name || strcmp(file_name, ".") == 0 || strcmp(file_name, "..") == 0)
+  {
+    dir_close(dir);
+    scratch_end(mark);
+    journal_end();
+    return false;
+  }
   bool success = (dir != NULL
-      && free_map_allocate (1, &inode_sector)
+      && free_map_allocate_near (1, inode_get_inumber (dir_get_inode (dir)),
+                                 &inode_sector)
       && inode_create (inode_sector, initial_size, is_dir)
       && dir_add (dir, file_name, inode_sector));
   if (!success && inode_sector != 0) 
     free_map_release (inode_sector, 1);
   dir_close (dir);
-  free(file_name);
+  scratch_end(mark);
+  journal_end();
   return success;
 }
 
-/* Opens the file with the given NAME.
-   Returns the new file if successful or a null pointer
-   otherwise.
-   Fails if no file named NAME exists,
-   or if an internal memory allocation fails. */
-struct file *
-filesys_open (const char *name)
+/* Looks up the file with the given NAME and returns its inode,
+   which the caller must close, without opening the file itself.
+   Returns a null pointer if no file named NAME exists or if an
+   internal memory allocation fails. */
+struct inode *
+filesys_lookup (const char *name)
 {
+  struct scratch_mark mark = scratch_begin();
   struct dir *dir = get_containing_dir(name);
   char *file_name = get_file_name(name);
 
   struct inode *inode = NULL;
 
-  if (dir != NULL)
+  if (dir != NULL && file_name != NULL)
   {
     if(strcmp(file_name, "..") == 0)
-    {
-      if(!dir_get_parent(dir, &inode))
-      {
-	free(file_name);
-	return NULL;
-      }
-    }
-    else if(strcmp(file_name, ".") == 0)
-    {
-      free(file_name);
-      return (struct file *) dir;
-    }
-    else if(dir_is_root(dir) && strlen(file_name) == 0)
-    {
-      free(file_name);
-      return (struct file *) dir;
-    }
-    dir_lookup (dir, file_name, &inode);
+      dir_get_parent(dir, &inode);
+    else if(strcmp(file_name, ".") == 0
+            || (dir_is_root(dir) && strlen(file_name) == 0))
+      inode = inode_reopen(dir_get_inode(dir));
+    else
+      dir_lookup (dir, file_name, &inode);
   }
   dir_close (dir);
-  free(file_name);
+  scratch_end(mark);
+  return inode;
+}
+
+/* Opens the file with the given NAME.
+   Returns the new file if successful or a null pointer
+   otherwise.
+   Fails if no file named NAME exists,
+   or if an internal memory allocation fails. */
+struct file *
+filesys_open (const char *name)
+{
+  struct inode *inode = filesys_lookup(name);
 
   if(!inode) return NULL;
   if(inode_is_dir(inode)) return (struct file *) dir_open(inode);
@@ -123,12 +234,15 @@ filesys_open (const char *name)
 bool
 filesys_remove (const char *name) 
 {
+  journal_begin();
+  struct scratch_mark mark = scratch_begin();
   struct dir *dir = get_containing_dir(name);
   char *file_name = get_file_name(name);
 
-  bool success = dir != NULL && dir_remove (dir, file_name);
+  bool success = dir != NULL && file_name != NULL && dir_remove (dir, file_name);
   dir_close (dir); 
-  free(file_name);
+  scratch_end(mark);
+  journal_end();
 
   return success;
 }
@@ -136,31 +250,33 @@ filesys_remove (const char *name)
 /* changes the current working directory to path */
 bool filesys_chdir(const char *path)
 {
+  struct scratch_mark mark = scratch_begin();
   struct dir *dir = get_containing_dir(path);
   char *file_name = get_file_name(path);
   struct inode *inode = NULL;
-  struct thread *cur = thread_current();
+  struct thread *cur = thread_process();
 
-  if (dir != NULL)
+  if (dir != NULL && file_name != NULL)
   {
     if(strcmp(file_name, "..") == 0)
     {
       if(!dir_get_parent(dir, &inode))
       {
-	free(file_name);
+	dir_close(dir);
+	scratch_end(mark);
 	return false;
       }
     }
     else if(strcmp(file_name, ".") == 0)
     {
       cur->cwd = dir;
-      free(file_name);
+      scratch_end(mark);
       return true;
     }
     else if(dir_is_root(dir) && strlen(file_name) == 0)
     {
       cur->cwd = dir;
-      free(file_name);
+      scratch_end(mark);
       return true;
     }
     else
@@ -170,7 +286,7 @@ bool filesys_chdir(const char *path)
   }
 
   dir_close(dir);
-  free(file_name);
+  scratch_end(mark);
 
   dir = dir_open(inode);
   if(dir != NULL) 
@@ -189,9 +305,12 @@ bool filesys_chdir(const char *path)
 do_format (void)
 {
   printf ("Formatting file system...");
+  inode_use_extents (filesys_extents);
   free_map_create ();
   if (!dir_create (ROOT_DIR_SECTOR, 16))
     PANIC ("root directory creation failed");
+  journal_create ();
+  cache_warm_create ();
   free_map_close ();
   printf ("done.\n");
 }
@@ -4,17 +4,31 @@
 #include <stdbool.h>
 #include "filesys/off_t.h"
 
+struct inode;
+
 /* Sectors of system file inodes. */
 #define FREE_MAP_SECTOR 0       /* Free map file inode sector. */
 #define ROOT_DIR_SECTOR 1       /* Root directory file inode sector. */
+#define JOURNAL_SECTOR 2        /* Journal header sector. */
+#define WARM_SECTOR 3           /* Cache warm-up list sector. */
 
 /* Block device that contains the file system. */
 struct block *fs_device;
 
+/* If false (default), do_format() gives files indirect blocks.
+   If true, it lays them out as extents instead.
+   Controlled by kernel command-line option "-extents". */
+extern bool filesys_extents;
+
 void filesys_init (bool format);
+void filesys_preload (const char *files);
 void filesys_done (void);
+void filesys_sync (void);
+void filesys_fsync (struct inode *);
 bool filesys_create (const char *name, off_t initial_size, bool is_dir);
+struct inode *filesys_lookup (const char *name);
 struct file *filesys_open (const char *name);
 bool filesys_remove (const char *name);
+bool filesys_chdir (const char *path);
 
 #endif /* filesys/filesys.h */
@@ -1,13 +1,45 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
 
+/* The free map is changed only in memory.  DIRTY_SECTORS has one
+   bit per sector of the free map file, set when that part of the
+   map has changed since it was last written, and free_map_flush()
+   writes back just those parts. */
+static struct bitmap *dirty_sectors;
+
+/* Number of free map bits held by one sector of its file. */
+#define BITS_PER_SECTOR (BLOCK_SECTOR_SIZE * 8)
+
+/* The disk is divided into allocation groups of GROUP_SECTORS
+   sectors each, and the number of free sectors in each group is
+   kept up to date, so that searches can skip groups too full to
+   help.  Allocations are placed as close after a caller's hint as
+   possible, so that a file's sectors end up near each other and
+   near its directory. */
+#define GROUP_SECTORS 1024
+static size_t group_cnt;             /* Number of groups. */
+static size_t *group_free;           /* Free sectors in each group. */
+
+/* Protects FREE_MAP, DIRTY_SECTORS, and GROUP_FREE. */
+static struct lock free_map_lock;
+
+static void mark_dirty (block_sector_t sector, size_t cnt);
+static block_sector_t allocate_near (size_t cnt, block_sector_t hint);
+static block_sector_t scan_from (block_sector_t start, size_t cnt);
+static void count_groups (void);
+static void update_groups (block_sector_t sector, size_t cnt, bool used);
+
 /* Initializes the free map. */
 void
 free_map_init (void) 
@@ -17,36 +49,229 @@ free_map_init (void)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  bitmap_mark (free_map, JOURNAL_SECTOR);
+  bitmap_mark (free_map, WARM_SECTOR);
+
+  dirty_sectors = bitmap_create (DIV_ROUND_UP (bitmap_file_size (free_map),
+                                               BLOCK_SECTOR_SIZE));
+  if (dirty_sectors == NULL)
+    PANIC ("bitmap creation failed--file system device is too large");
+
+  group_cnt = DIV_ROUND_UP (bitmap_size (free_map), GROUP_SECTORS);
+  group_free = malloc (group_cnt * sizeof *group_free);
+  if (group_free == NULL)
+    PANIC ("allocation group table creation failed");
+  count_groups ();
+
+  lock_init (&free_map_lock);
+  lock_register (&free_map_lock, "free map");
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
    the first into *SECTORP.
    Returns true if successful, false if not enough consecutive
-   sectors were available or if the free_map file could not be
-   written. */
+   sectors were available. */
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
-    {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
-    }
+  return free_map_allocate_near (cnt, 0, sectorp);
+}
+
+/* Allocates CNT consecutive sectors from the free map, as close
+   after sector HINT as possible, and stores the first into
+   *SECTORP.
+   Returns true if successful, false if not enough consecutive
+   sectors were available. */
+bool
+free_map_allocate_near (size_t cnt, block_sector_t hint,
+                        block_sector_t *sectorp)
+{
+  block_sector_t sector;
+
+  lock_acquire (&free_map_lock);
+  sector = allocate_near (cnt, hint);
+  lock_release (&free_map_lock);
+
   if (sector != BITMAP_ERROR)
     *sectorp = sector;
   return sector != BITMAP_ERROR;
 }
 
+/* Allocates a run of at most CNT consecutive sectors, preferring
+   one that starts at HINT, and stores its first sector into
+   *SECTORP.  Falls back to shorter runs when no run of CNT free
+   sectors exists.  Returns the number of sectors allocated, or 0
+   if none could be. */
+size_t
+free_map_allocate_run (size_t cnt, block_sector_t hint,
+                       block_sector_t *sectorp)
+{
+  lock_acquire (&free_map_lock);
+  for (; cnt > 0; cnt /= 2)
+    {
+      block_sector_t sector = allocate_near (cnt, hint);
+      if (sector != BITMAP_ERROR)
+        {
+          *sectorp = sector;
+          break;
+        }
+    }
+  lock_release (&free_map_lock);
+  return cnt;
+}
+
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  update_groups (sector, cnt, false);
+  mark_dirty (sector, cnt);
+  lock_release (&free_map_lock);
+}
+
+/* Finds CNT consecutive free sectors, starting at HINT if they
+   are free, or else the first run after HINT, or else the first
+   run on the disk, and marks them used.  Returns the first
+   sector, or BITMAP_ERROR if there is no such run.  The free map
+   lock must be held. */
+static block_sector_t
+allocate_near (size_t cnt, block_sector_t hint)
+{
+  block_sector_t sector;
+
+  ASSERT (lock_held_by_current_thread (&free_map_lock));
+
+  if (hint >= bitmap_size (free_map))
+    hint = 0;
+  if (hint + cnt <= bitmap_size (free_map)
+      && bitmap_none (free_map, hint, cnt))
+    sector = hint;
+  else
+    {
+      sector = scan_from (hint, cnt);
+      if (sector == BITMAP_ERROR && hint > 0)
+        sector = scan_from (0, cnt);
+      if (sector == BITMAP_ERROR)
+        return BITMAP_ERROR;
+    }
+
+  bitmap_set_multiple (free_map, sector, cnt, true);
+  update_groups (sector, cnt, true);
+  mark_dirty (sector, cnt);
+  return sector;
+}
+
+/* Returns the first sector at or after START that begins CNT
+   consecutive free sectors, or BITMAP_ERROR if there is none.
+   Groups with too few free sectors are skipped without looking
+   at their bits.  The free map lock must be held. */
+static block_sector_t
+scan_from (block_sector_t start, size_t cnt)
+{
+  size_t need = cnt < GROUP_SECTORS ? cnt : GROUP_SECTORS;
+  size_t group = start / GROUP_SECTORS;
+
+  while (group < group_cnt && group_free[group] < need)
+    start = ++group * GROUP_SECTORS;
+  if (group >= group_cnt)
+    return BITMAP_ERROR;
+  return bitmap_scan (free_map, start, cnt, false);
+}
+
+/* Recomputes every group's free sector count from the free
+   map. */
+static void
+count_groups (void)
+{
+  size_t size = bitmap_size (free_map);
+  size_t group;
+
+  for (group = 0; group < group_cnt; group++)
+    {
+      size_t start = group * GROUP_SECTORS;
+      size_t cnt = size - start < GROUP_SECTORS ? size - start : GROUP_SECTORS;
+      group_free[group] = bitmap_count (free_map, start, cnt, false);
+    }
+}
+
+/* Adjusts group free counts for CNT sectors starting at SECTOR
+   having become used, if USED is true, or free, otherwise. */
+static void
+update_groups (block_sector_t sector, size_t cnt, bool used)
+{
+  while (cnt > 0)
+    {
+      size_t group = sector / GROUP_SECTORS;
+      size_t n = (group + 1) * GROUP_SECTORS - sector;
+      if (n > cnt)
+        n = cnt;
+
+      if (used)
+        group_free[group] -= n;
+      else
+        group_free[group] += n;
+      sector += n;
+      cnt -= n;
+    }
+}
+
+/* Writes the parts of the free map changed since the last flush
+   to the free map file, in a journal handle of its own, so that
+   the map reaches the disk only along with the operations that
+   changed it. */
+void
+free_map_flush (void)
+{
+  size_t i;
+
+  if (dirty_sectors == NULL)
+    return;
+
+  journal_begin ();
+  lock_acquire (&free_map_lock);
+  if (free_map_file != NULL)
+    for (i = 0; i < bitmap_size (dirty_sectors); i++)
+      if (bitmap_test (dirty_sectors, i))
+        {
+          if (!bitmap_write_part (free_map, free_map_file,
+                                  i * BLOCK_SECTOR_SIZE, BLOCK_SECTOR_SIZE))
+            PANIC ("can't write free map");
+          bitmap_reset (dirty_sectors, i);
+        }
+  lock_release (&free_map_lock);
+  journal_end ();
+}
+
+/* Writes the changed parts of the free map to disk and waits for
+   them to get there. */
+void
+free_map_sync (void)
+{
+  if (dirty_sectors == NULL)
+    return;
+
+  free_map_flush ();
+  lock_acquire (&free_map_lock);
+  if (free_map_file != NULL)
+    inode_sync (file_get_inode (free_map_file));
+  lock_release (&free_map_lock);
+}
+
+/* Records that the bits for CNT sectors starting at SECTOR have
+   changed.  The free map lock must be held. */
+static void
+mark_dirty (block_sector_t sector, size_t cnt)
+{
+  size_t first = sector / BITS_PER_SECTOR;
+  size_t last = (sector + cnt - 1) / BITS_PER_SECTOR;
+
+  ASSERT (lock_held_by_current_thread (&free_map_lock));
+  ASSERT (cnt > 0);
+
+  bitmap_set_multiple (dirty_sectors, first, last - first + 1, true);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -58,13 +283,20 @@ free_map_open (void)
     PANIC ("can't open free map");
   if (!bitmap_read (free_map, free_map_file))
     PANIC ("can't read free map");
+  bitmap_set_all (dirty_sectors, false);
+  count_groups ();
+
+  /* New files follow the layout the disk was formatted with. */
+  inode_use_extents (inode_has_extents (file_get_inode (free_map_file)));
 }
 
 /* Writes the free map to disk and closes the free map file. */
 void
 free_map_close (void) 
 {
+  free_map_flush ();
   file_close (free_map_file);
+  free_map_file = NULL;
 }
 
 /* Creates a new free map file on disk and writes the free map to
@@ -76,10 +308,13 @@ free_map_create (void)
   if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map), false))
     PANIC ("free map creation failed");
 
-  /* Write bitmap to file. */
+  /* Write bitmap to file.  Writing all of it leaves the file
+     without holes, so free_map_flush() never needs to allocate
+     while holding the free map lock. */
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
   if (!bitmap_write (free_map, free_map_file))
     PANIC ("can't write free map");
+  bitmap_set_all (dirty_sectors, false);
 }
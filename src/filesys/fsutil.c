@@ -1,5 +1,6 @@
 #include "filesys/fsutil.h"
 #include <debug.h>
+#include <round.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -11,6 +12,11 @@
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
 
+/* Number of pages, and of sectors, fsutil_extract() reads from
+   the scratch device at once. */
+#define EXTRACT_PAGES 8
+#define EXTRACT_SECTORS (EXTRACT_PAGES * PGSIZE / BLOCK_SECTOR_SIZE)
+
 /* List files in the root directory. */
 void
 fsutil_ls (char **argv UNUSED) 
@@ -79,7 +85,7 @@ fsutil_extract (char **argv UNUSED)
 
   /* Allocate buffers. */
   header = malloc (BLOCK_SECTOR_SIZE);
-  data = malloc (BLOCK_SECTOR_SIZE);
+  data = palloc_get_multiple (0, EXTRACT_PAGES);
   if (header == NULL || data == NULL)
     PANIC ("couldn't allocate buffers");
 
@@ -117,20 +123,30 @@ fsutil_extract (char **argv UNUSED)
 
       printf ("Putting '%s' into the file system...\n", file_name);
 
-      /* Create destination file. */
+      /* Create destination file, with all of its sectors
+         allocated up front, in long runs, so that the writes
+         below need no allocation. */
       if (!filesys_create (file_name, size, false))
 	PANIC ("%s: create failed", file_name);
       dst = filesys_open (file_name);
       if (dst == NULL)
 	PANIC ("%s: open failed", file_name);
+      if (!file_allocate (dst, 0, size))
+	PANIC ("%s: allocation failed", file_name);
 
-      /* Do copy. */
+      /* Do copy, EXTRACT_SECTORS at a time. */
       while (size > 0)
       {
-	int chunk_size = (size > BLOCK_SECTOR_SIZE
-	    ? BLOCK_SECTOR_SIZE
+	block_sector_t cnt = DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
+	int chunk_size;
+
+	if (cnt > EXTRACT_SECTORS)
+	  cnt = EXTRACT_SECTORS;
+	chunk_size = (size > (int) (cnt * BLOCK_SECTOR_SIZE)
+	    ? (int) (cnt * BLOCK_SECTOR_SIZE)
 	    : size);
-	block_read (src, sector++, data);
+	block_read_multiple (src, sector, data, cnt);
+	sector += cnt;
 	if (file_write (dst, data, chunk_size) != chunk_size)
 	  PANIC ("%s: write failed with %d bytes unwritten",
 	      file_name, size);
@@ -151,7 +167,7 @@ fsutil_extract (char **argv UNUSED)
   block_write (src, 0, header);
   block_write (src, 1, header);
 
-  free (data);
+  palloc_free_multiple (data, EXTRACT_PAGES);
   free (header);
 }
 
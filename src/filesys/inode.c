@@ -1,10 +1,17 @@
 #include "filesys/inode.h"
+#include <hash.h>
+#include <iovec.h>
 #include <list.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include "filesys/cache.h"
+#include "filesys/directory.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
+#include "filesys/statfs.h"
+#include "threads/kmem.h"
 #include "threads/malloc.h"
 #include "threads/synch.h"
 
@@ -13,7 +20,44 @@
 #define INODE_MAGIC 0x494e4f44
 #define INDIRECT_BLOCK_SIZE 128*512    // 128*BLOCK_SECTOR_SIZE //
 #define MAXIMUM_SIZE 8*1024*1024 // We assume that file system partition will not be larger than 8 MB.
-struct inode_disk* single_to_double_indirect (struct inode_disk *disk_inode);
+
+/* Bytes of an inode that one journal handle grows or fills at
+   most: the span of one indirect block, so that a handle dirties
+   only a few metadata sectors however far a write extends. */
+#define GROW_STEP (128 * BLOCK_SECTOR_SIZE)
+
+/* Ways an inode can describe its data sectors.  Zero must stay
+   the indirect layout, which older disks used before the field
+   existed. */
+#define INODE_LAYOUT_INDIRECT 0 /* Indirect and double indirect blocks. */
+#define INODE_LAYOUT_EXTENTS 1  /* Runs of consecutive sectors. */
+#define INODE_LAYOUT_INLINE 2   /* Data kept in the inode itself. */
+
+/* Number of extents stored in the inode itself, and in each
+   overflow extent block. */
+#define INODE_EXTENT_CNT 58
+#define EXTENT_BLOCK_CNT 63
+
+/* Most bytes of data an inode can hold itself, in the space its
+   extents use otherwise. */
+#define INODE_INLINE_SIZE (INODE_EXTENT_CNT * 8)
+
+/* LENGTH consecutive data sectors starting at START. */
+struct extent
+  {
+    block_sector_t start;               /* First sector of the run. */
+    uint32_t length;                    /* Number of sectors. */
+  };
+
+/* Extents that do not fit in the inode, chained from
+   inode_disk's extent_block.  Must be exactly BLOCK_SECTOR_SIZE
+   bytes long. */
+struct extent_block
+  {
+    block_sector_t next;                /* Next extent block, or 0. */
+    struct extent extents[EXTENT_BLOCK_CNT];
+    uint32_t unused;
+  };
 
 /* On-disk inode.
    Must be exactly BLOCK_SECTOR_SIZE bytes long. */
@@ -22,8 +66,15 @@ struct inode_disk
     block_sector_t start;  
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[120];               /* Not used, To make the size of inode same as 512, adjust this value */
-					/* Especially, in the case of inode_create ASSERTION */
+    uint32_t layout;                    /* INODE_LAYOUT_* value. */
+    uint32_t extent_cnt;                /* Extents in use, in total. */
+    block_sector_t extent_block;        /* First overflow extent block. */
+    union
+      {
+        struct extent extents[INODE_EXTENT_CNT]; /* First extents. */
+        uint8_t inline_data[INODE_INLINE_SIZE];  /* Inline layout's data. */
+      };
+    uint32_t unused[1];                 /* Pads the inode to 512 bytes. */
     bool isdir;
     block_sector_t parent;
     block_sector_t sector;
@@ -34,17 +85,59 @@ struct inode_disk
 
 struct inode
   {
-    struct list_elem elem;              /* Element in inode list. */
+    struct hash_elem elem;              /* Element in open_inodes. */
     block_sector_t sector;              /* Sector number of disk location. */
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    unsigned version;                   /* Number of writes completed. */
     bool isdir;
     block_sector_t parent;
-    struct inode_disk data;             /* Inode content. */
-    struct lock lock;
+
+    /* The parts of the on-disk inode needed on every access.  The
+       rest, the in-inode extents or inline data, is only ever
+       read and written in the inode's sector, through the buffer
+       cache, and each change to these is written there too. */
+    off_t length;                       /* File size in bytes. */
+    uint32_t layout;                    /* INODE_LAYOUT_* value. */
+    uint32_t extent_cnt;                /* Extents in use, in total. */
+    block_sector_t extent_block;        /* First overflow extent block. */
+    block_sector_t indirect_blocks_sector;
+    block_sector_t double_indirect_blocks_sector;
+
+    /* Protects the fields above, DENY_WRITE_CNT, VERSION, the
+       inline data and the inode's indirect or extent blocks.  Held
+       for reading while mapping offsets to sectors or reading
+       inline data, and for writing while changing any of them,
+       never across the data transfer itself, so readers of an
+       inode look up sectors at once and overlap their disk
+       waits, which the buffer cache makes without its own lock
+       held. */
+    struct rwlock lock;
+
+    /* Protects BLOCK_MAP, which readers holding LOCK only for
+       reading fill in. */
+    struct lock map_lock;
+
+    /* Decoded indirect blocks, one per 128 data sectors, read
+       lazily by byte_to_sector() and dropped whenever the file
+       grows.  Null until first used. */
+    struct indirect_block **block_map;
+    size_t block_map_cnt;               /* Number of slots in BLOCK_MAP. */
+
+    struct dir_index *dir_index;        /* Directory name index, or null. */
+    void *data;                         /* Data made up by statfs, or null. */
   };
 
+/* Reads, or writes, member MEMBER of the on-disk inode in sector
+   SECTOR from, or into, the object at PTR. */
+#define disk_inode_read(SECTOR, MEMBER, PTR)                            \
+  cache_read_part (SECTOR, PTR, offsetof (struct inode_disk, MEMBER),   \
+                   sizeof ((struct inode_disk *) 0)->MEMBER)
+#define disk_inode_write(SECTOR, MEMBER, PTR)                           \
+  cache_write_part (SECTOR, PTR, offsetof (struct inode_disk, MEMBER),  \
+                    sizeof ((struct inode_disk *) 0)->MEMBER)
+
 struct indirect_block
 {
     block_sector_t block_sectors[128];  // indirect_block.block_sectors[0] : 첫번 째 direct block의 sector. 총 128개의 direct block의 sector값 보유.
@@ -67,88 +160,645 @@ bytes_to_indirect_blocks (off_t size)
 }
 
 
+/* Layout given to inodes created from now on. */
+static uint32_t new_inode_layout = INODE_LAYOUT_INDIRECT;
+
+/* Returns the sector of overflow extent block number IDX of
+   DISK_INODE, which must exist. */
+static block_sector_t
+extent_block_sector (const struct inode_disk *disk_inode, size_t idx)
+{
+  struct extent_block block;
+  block_sector_t sector = disk_inode->extent_block;
+
+  for (; idx > 0; idx--)
+    {
+      cache_read (sector, &block);
+      sector = block.next;
+    }
+  return sector;
+}
+
+/* Returns a pointer to extent IDX of DISK_INODE, which must
+   have room for it.  Extents past the inode itself are read into
+   BLOCK, and the sector BLOCK must be written back to if the
+   extent is changed is stored into *SECTORP; otherwise *SECTORP
+   is set to 0. */
+static struct extent *
+extent_slot (struct inode_disk *disk_inode, size_t idx,
+             struct extent_block *block, block_sector_t *sectorp)
+{
+  if (idx < INODE_EXTENT_CNT)
+    {
+      *sectorp = 0;
+      return &disk_inode->extents[idx];
+    }
+
+  idx -= INODE_EXTENT_CNT;
+  *sectorp = extent_block_sector (disk_inode, idx / EXTENT_BLOCK_CNT);
+  cache_read (*sectorp, block);
+  return &block->extents[idx % EXTENT_BLOCK_CNT];
+}
+
+/* Returns the sector following DISK_INODE's last data sector,
+   where a new run would best be placed.  An empty inode prefers
+   the sector following the inode itself. */
+static block_sector_t
+extent_end (struct inode_disk *disk_inode)
+{
+  struct extent_block block;
+  block_sector_t sector;
+  struct extent *e;
+
+  if (disk_inode->extent_cnt == 0)
+    return disk_inode->sector + 1;
+  e = extent_slot (disk_inode, disk_inode->extent_cnt - 1, &block, &sector);
+  return e->start + e->length;
+}
+
+/* Adds the CNT sectors starting at START to the end of
+   DISK_INODE's data, merging them into the last extent if they
+   directly follow it.  Does not write DISK_INODE itself.
+   Returns false if a new extent block was needed but could not
+   be allocated. */
+static bool
+extent_append (struct inode_disk *disk_inode, block_sector_t start,
+               size_t cnt)
+{
+  size_t idx = disk_inode->extent_cnt;
+  struct extent_block block;
+  block_sector_t sector;
+  struct extent *e;
+
+  ASSERT (sizeof block == BLOCK_SECTOR_SIZE);
+
+  if (idx > 0)
+    {
+      e = extent_slot (disk_inode, idx - 1, &block, &sector);
+      if (e->start + e->length == start)
+        {
+          e->length += cnt;
+          if (sector != 0)
+            cache_write (sector, &block);
+          return true;
+        }
+    }
+
+  if (idx >= INODE_EXTENT_CNT
+      && (idx - INODE_EXTENT_CNT) % EXTENT_BLOCK_CNT == 0)
+    {
+      /* Chain a fresh extent block onto the end of the list. */
+      size_t block_idx = (idx - INODE_EXTENT_CNT) / EXTENT_BLOCK_CNT;
+      block_sector_t new_sector;
+
+      if (!free_map_allocate_near (1, disk_inode->sector + 1, &new_sector))
+        return false;
+      memset (&block, 0, sizeof block);
+      cache_write (new_sector, &block);
+
+      if (block_idx == 0)
+        disk_inode->extent_block = new_sector;
+      else
+        {
+          sector = extent_block_sector (disk_inode, block_idx - 1);
+          cache_read (sector, &block);
+          block.next = new_sector;
+          cache_write (sector, &block);
+        }
+    }
+
+  e = extent_slot (disk_inode, idx, &block, &sector);
+  e->start = start;
+  e->length = cnt;
+  if (sector != 0)
+    cache_write (sector, &block);
+  disk_inode->extent_cnt++;
+  return true;
+}
+
+/* Extends extent-based DISK_INODE to NEW_SIZE bytes, asking the
+   free map for runs as long as possible and zeroing them, and
+   writes DISK_INODE back.  Returns false if the disk filled up,
+   in which case DISK_INODE is left as long as the sectors that
+   could be allocated. */
+static bool
+extent_grow (struct inode_disk *disk_inode, off_t new_size)
+{
+  size_t have = bytes_to_sectors (disk_inode->length);
+  size_t need = bytes_to_sectors (new_size) - have;
+  bool success = true;
+
+  while (need > 0)
+    {
+      block_sector_t start;
+      size_t cnt, i;
+
+      cnt = free_map_allocate_run (need, extent_end (disk_inode), &start);
+      if (cnt == 0)
+        {
+          success = false;
+          break;
+        }
+      if (!extent_append (disk_inode, start, cnt))
+        {
+          free_map_release (start, cnt);
+          success = false;
+          break;
+        }
+      for (i = 0; i < cnt; i++)
+        cache_zero (start + i);
+      have += cnt;
+      need -= cnt;
+    }
+
+  if (success)
+    disk_inode->length = new_size;
+  else if ((off_t) have * BLOCK_SECTOR_SIZE > disk_inode->length)
+    disk_inode->length = have * BLOCK_SECTOR_SIZE;
+  cache_write (disk_inode->sector, disk_inode);
+  return success;
+}
+
+/* Walks an open inode's extents in order, reading them through
+   the buffer cache. */
+struct extent_iter
+  {
+    const struct inode *inode;
+    size_t idx;                         /* Index of the next extent. */
+    block_sector_t next;                /* Next overflow block to read. */
+    block_sector_t block_sector;        /* Sector of BLOCK, or 0. */
+    struct extent_block block;          /* Extents being walked. */
+  };
+
+/* Starts IT at the first extent of INODE, which must use
+   extents.  The extents in the inode itself are read in one go
+   and walked like those of an overflow block. */
+static void
+extent_iter_start (struct extent_iter *it, const struct inode *inode)
+{
+  size_t cnt = inode->extent_cnt;
+
+  ASSERT (inode->layout == INODE_LAYOUT_EXTENTS);
+
+  it->inode = inode;
+  it->idx = 0;
+  it->next = inode->extent_block;
+  it->block_sector = 0;
+  if (cnt > INODE_EXTENT_CNT)
+    cnt = INODE_EXTENT_CNT;
+  cache_read_part (inode->sector, it->block.extents,
+                   offsetof (struct inode_disk, extents),
+                   cnt * sizeof (struct extent));
+}
+
+/* Stores IT's next extent into *E and returns true, or returns
+   false if IT has walked past the last one. */
+static bool
+extent_iter_next (struct extent_iter *it, struct extent *e)
+{
+  size_t slot;
+
+  if (it->idx >= it->inode->extent_cnt)
+    return false;
+  if (it->idx < INODE_EXTENT_CNT)
+    slot = it->idx;
+  else
+    {
+      slot = (it->idx - INODE_EXTENT_CNT) % EXTENT_BLOCK_CNT;
+      if (slot == 0)
+        {
+          it->block_sector = it->next;
+          cache_read (it->block_sector, &it->block);
+          it->next = it->block.next;
+        }
+    }
+  *e = it->block.extents[slot];
+  it->idx++;
+  return true;
+}
+
+/* Returns the sector holding data sector IDX of extent-based
+   INODE, or -1 if there is none. */
+static block_sector_t
+extent_to_sector (const struct inode *inode, size_t idx)
+{
+  struct extent_iter it;
+  struct extent e;
+
+  extent_iter_start (&it, inode);
+  while (extent_iter_next (&it, &e))
+    {
+      if (idx < e.length)
+        return e.start + idx;
+      idx -= e.length;
+    }
+  return -1;
+}
+
+/* Frees every data sector and extent block of extent-based
+   INODE. */
+static void
+extent_release (const struct inode *inode)
+{
+  struct extent_iter it;
+  struct extent e;
+  block_sector_t released = 0;
+
+  extent_iter_start (&it, inode);
+  while (extent_iter_next (&it, &e))
+    {
+      if (it.block_sector != released)
+        {
+          released = it.block_sector;
+          free_map_release (released, 1);
+        }
+      free_map_release (e.start, e.length);
+    }
+}
+
+/* Returns the group of 128 data sectors of INODE, which uses
+   indirect blocks, whose indirect block hangs off the inode
+   itself.  Every earlier group is full and hangs off the double
+   indirect block.  When INODE's sectors fill whole groups, no
+   sector lies in this group and indirect_blocks_sector is 0. */
+static size_t
+inode_last_group (const struct inode *inode)
+{
+  return bytes_to_sectors (inode->length) / 128;
+}
+
+/* Returns the indirect block describing data sectors
+   GROUP * 128 through GROUP * 128 + 127 of INODE, reading it
+   into INODE's block map the first time it is needed.  Returns
+   a null pointer if memory for the map is not available.
+   INODE's lock must be held, for reading at least. */
+static struct indirect_block *
+block_map_lookup (struct inode *inode, size_t group)
+{
+  size_t last_group = inode_last_group (inode);
+  struct indirect_block *indirect = NULL;
+
+  lock_acquire (&inode->map_lock);
+  if (inode->block_map == NULL)
+    {
+      inode->block_map = calloc (last_group + 1, sizeof *inode->block_map);
+      if (inode->block_map == NULL)
+        goto done;
+      inode->block_map_cnt = last_group + 1;
+    }
+  ASSERT (group < inode->block_map_cnt);
+
+  indirect = inode->block_map[group];
+  if (indirect == NULL)
+    {
+      indirect = malloc (sizeof *indirect);
+      if (indirect == NULL)
+        goto done;
+
+      /* The last, partly filled group lives in the indirect block;
+         full groups have been moved into the double indirect one. */
+      if (group == last_group)
+        cache_read (inode->indirect_blocks_sector, indirect);
+      else
+        {
+          cache_read (inode->double_indirect_blocks_sector, indirect);
+          cache_read (indirect->block_sectors[group], indirect);
+        }
+      inode->block_map[group] = indirect;
+    }
+ done:
+  lock_release (&inode->map_lock);
+  return indirect;
+}
+
+/* Discards INODE's cached block map.  Must be called whenever
+   the inode's indirect blocks change, with INODE's lock held for
+   writing. */
+static void
+block_map_clear (struct inode *inode)
+{
+  size_t i;
+
+  if (inode->block_map == NULL)
+    return;
+  for (i = 0; i < inode->block_map_cnt; i++)
+    free (inode->block_map[i]);
+  free (inode->block_map);
+  inode->block_map = NULL;
+  inode->block_map_cnt = 0;
+}
+
 /* Returns the block device sector that contains byte offset POS
    within INODE.
+   Returns 0 if POS lies in a hole that has never been written,
+   or if INODE keeps its data inline and so has no data sectors.
    Returns -1 if INODE does not contain data for a byte at offset
    POS. */
 static block_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) 
+byte_to_sector (struct inode *inode, off_t pos) 
 {
   ASSERT (inode != NULL);
-  int total_id = inode->data.length/BLOCK_SECTOR_SIZE; 
   
-  if (inode->data.length == 0)
-      return -1;
+  if (inode->length == 0 || pos > inode->length)
+    return -1;
+  if (inode->layout == INODE_LAYOUT_EXTENTS)
+    return extent_to_sector (inode, pos / BLOCK_SECTOR_SIZE);
+  if (inode->layout == INODE_LAYOUT_INLINE)
+    return 0;
 
-  if (pos <= inode->data.length)
-  
-  {
-  	int id = pos/BLOCK_SECTOR_SIZE;
-	int indirect_id = id/128;
-	struct indirect_block indirect;
-  	if ((total_id/128)*128 == (id/128)*128)  // check indirect or double_indirect
-	{
-		block_read(fs_device, inode->data.indirect_blocks_sector, &indirect);
-	}
-	else
-	{
-		block_read(fs_device, inode->data.double_indirect_blocks_sector, &indirect);
-		block_read(fs_device, indirect.block_sectors[indirect_id], &indirect);
-	}
-	return indirect.block_sectors[id%128];
-  }
-  else
+  size_t id = pos / BLOCK_SECTOR_SIZE;
+  if (id >= bytes_to_sectors (inode->length))
     return -1;
+  struct indirect_block *indirect = block_map_lookup (inode, id / 128);
+  if (indirect != NULL)
+    return indirect->block_sectors[id % 128];
+  else
+    {
+      /* Out of memory for the map: decode straight from disk. */
+      struct indirect_block tmp;
+      if (id / 128 == inode_last_group (inode))
+        cache_read (inode->indirect_blocks_sector, &tmp);
+      else
+        {
+          cache_read (inode->double_indirect_blocks_sector, &tmp);
+          cache_read (tmp.block_sectors[id / 128], &tmp);
+        }
+      return tmp.block_sectors[id % 128];
+    }
+}
+
+static block_sector_t hole_indirect_sector (struct inode *, off_t pos);
+static block_sector_t hole_hint (struct inode *, off_t pos);
+static void set_hole (struct inode *, off_t pos, block_sector_t);
+
+/* Gives the hole at byte offset POS in INODE, which uses
+   indirect blocks, a data sector of its own that reads as zeros,
+   and records it in the indirect block covering POS.  Returns the
+   new sector, or 0 if the disk is full. */
+static block_sector_t
+fill_hole (struct inode *inode, off_t pos)
+{
+  block_sector_t sector;
+
+  if (!free_map_allocate_near (1, hole_hint (inode, pos), &sector))
+    return 0;
+  set_hole (inode, pos, sector);
+  return sector;
+}
+
+/* Returns the sector of the indirect block that covers byte
+   offset POS in INODE, which uses indirect blocks. */
+static block_sector_t
+hole_indirect_sector (struct inode *inode, off_t pos)
+{
+  size_t group = pos / BLOCK_SECTOR_SIZE / 128;
+  struct indirect_block indirect;
+
+  /* The last, partly filled group's indirect block hangs off the
+     inode; full groups' hang off the double indirect block. */
+  if (group == inode_last_group (inode))
+    return inode->indirect_blocks_sector;
+  cache_read (inode->double_indirect_blocks_sector, &indirect);
+  return indirect.block_sectors[group];
+}
+
+/* Returns where a sector for the hole at byte offset POS in
+   INODE would best go: after the preceding data sector, or after
+   the indirect block if there is none. */
+static block_sector_t
+hole_hint (struct inode *inode, off_t pos)
+{
+  block_sector_t prev = 0;
+
+  if (pos >= BLOCK_SECTOR_SIZE)
+    prev = byte_to_sector (inode, pos - BLOCK_SECTOR_SIZE);
+  return (prev != 0 ? prev : hole_indirect_sector (inode, pos)) + 1;
+}
+
+/* Gives the hole at byte offset POS in INODE, which uses
+   indirect blocks, SECTOR, a newly allocated sector, which is
+   made to read as zeros, and records it in the indirect block
+   covering POS. */
+static void
+set_hole (struct inode *inode, off_t pos, block_sector_t sector)
+{
+  size_t id = pos / BLOCK_SECTOR_SIZE;
+  size_t group = id / 128;
+  block_sector_t indirect_sector = hole_indirect_sector (inode, pos);
+  struct indirect_block indirect;
+
+  cache_zero (sector);
+
+  cache_read (indirect_sector, &indirect);
+  indirect.block_sectors[id % 128] = sector;
+  cache_write (indirect_sector, &indirect);
+  if (inode->block_map != NULL && group < inode->block_map_cnt
+      && inode->block_map[group] != NULL)
+    inode->block_map[group]->block_sectors[id % 128] = sector;
 }
 
+/* Returns the sector holding byte offset POS of INODE, taking
+   INODE's lock for reading for the lookup.  If ALLOCATE is true,
+   a hole is first given a sector of its own, in a journal handle
+   and with the lock held for writing; then 0 means the disk is
+   full.  Otherwise 0 means POS lies in a hole. */
+static block_sector_t
+map_sector (struct inode *inode, off_t pos, bool allocate)
+{
+  block_sector_t sector;
+
+  rwlock_acquire_read (&inode->lock);
+  sector = byte_to_sector (inode, pos);
+  rwlock_release_read (&inode->lock);
+  if (sector != 0 || !allocate)
+    return sector;
+
+  /* Another writer may fill the hole before we get the lock
+     for writing, so look again once we have it. */
+  journal_begin ();
+  rwlock_acquire_write (&inode->lock);
+  sector = byte_to_sector (inode, pos);
+  if (sector == 0)
+    sector = fill_hole (inode, pos);
+  rwlock_release_write (&inode->lock);
+  journal_end ();
+  return sector;
+}
 
-struct inode_disk* single_to_double_indirect (struct inode_disk *disk_inode)
+/* Moves DISK_INODE's indirect block, whose group of 128 sectors
+   has just filled, into the double indirect block, allocating
+   that first if the file has none.  Returns false, changing
+   nothing, if the disk is full. */
+static bool
+single_to_double_indirect (struct inode_disk *disk_inode)
 {
 	static char zero_block[BLOCK_SECTOR_SIZE];
 	struct indirect_block indirect;
 
 	if (disk_inode->double_indirect_blocks_sector == 0)
 	{
-		if (free_map_allocate(1, &disk_inode->double_indirect_blocks_sector))
-		{
-			block_write(fs_device, disk_inode->double_indirect_blocks_sector, zero_block);
-		}
-		block_read(fs_device, disk_inode->double_indirect_blocks_sector, &indirect);
+		if (!free_map_allocate_near (1, disk_inode->indirect_blocks_sector + 1,
+		                             &disk_inode->double_indirect_blocks_sector))
+			return false;
+		cache_write (disk_inode->double_indirect_blocks_sector, zero_block);
+		cache_read (disk_inode->double_indirect_blocks_sector, &indirect);
 		indirect.block_sectors[0] = disk_inode->indirect_blocks_sector;
 		disk_inode-> indirect_blocks_sector = 0;
-		block_write(fs_device, disk_inode->double_indirect_blocks_sector, &indirect);
+		cache_write (disk_inode->double_indirect_blocks_sector, &indirect);
 	}
 	else
 	{
-		block_read(fs_device, disk_inode->double_indirect_blocks_sector, &indirect);
+		cache_read (disk_inode->double_indirect_blocks_sector, &indirect);
 		size_t double_index=0;
-		while(indirect.block_sectors[double_index] == 0){
+		/* Full groups fill the double indirect block in order, so
+		   group N goes in the first free slot, number N. */
+		while(double_index < 128 && indirect.block_sectors[double_index] != 0){
 			double_index++;
 		}
+		if (double_index == 128)
+			return false;
 		indirect.block_sectors[double_index] = disk_inode->indirect_blocks_sector;
 		disk_inode->indirect_blocks_sector = 0;
-		block_write(fs_device, disk_inode->double_indirect_blocks_sector, &indirect);
+		cache_write (disk_inode->double_indirect_blocks_sector, &indirect);
 	}
-	return disk_inode;
+	return true;
 }
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* Open inodes, hashed by sector, so that opening a single inode
+   twice returns the same `struct inode'. */
+static struct hash open_inodes;
+
+/* Protects OPEN_INODES and the open_cnt of every open inode. */
+static struct lock open_inodes_lock;
+
+/* Cache of struct inode objects.  Each one's LOCK is
+   initialized once, by inode_ctor(), and is free whenever the
+   inode is returned to the cache. */
+static struct kmem_cache inode_cache;
+
+static hash_hash_func inode_hash;
+static hash_less_func inode_less;
+static void inode_ctor (void *);
+static void indirect_release (const struct inode *);
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
-	list_init (&open_inodes);
+  hash_init (&open_inodes, inode_hash, inode_less, NULL);
+  lock_init (&open_inodes_lock);
+  lock_set_spin (&open_inodes_lock, LOCK_SPIN_SHORT);
+  lock_register (&open_inodes_lock, "open inodes");
+  kmem_cache_init (&inode_cache, "inode", sizeof (struct inode), inode_ctor);
 }
 
+/* Constructor for objects in inode_cache. */
+static void
+inode_ctor (void *inode_)
+{
+  struct inode *inode = inode_;
+  rwlock_init (&inode->lock);
+  lock_init (&inode->map_lock);
+}
+
+/* Returns a hash value for the inode that contains E. */
+static unsigned
+inode_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct inode *inode = hash_entry (e, struct inode, elem);
+  return hash_int (inode->sector);
+}
+
+/* Returns true if the inode containing A precedes the one
+   containing B. */
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct inode, elem)->sector
+          < hash_entry (b, struct inode, elem)->sector);
+}
+
+/* Moves the data of DISK_INODE, which keeps it inline, out to a
+   data sector of its own and gives DISK_INODE the layout that new
+   inodes get, so that it can grow past INODE_INLINE_SIZE bytes.
+   Does not write DISK_INODE itself.  Returns false, leaving
+   DISK_INODE as it was, if the disk is full. */
+static bool
+inline_migrate (struct inode_disk *disk_inode)
+{
+  struct indirect_block indirect;
+  block_sector_t data = 0;
+  block_sector_t indirect_sector = 0;
+  block_sector_t hint = disk_inode->sector + 1;
+
+  ASSERT (disk_inode->layout == INODE_LAYOUT_INLINE);
+
+  if (disk_inode->length > 0)
+    {
+      if (new_inode_layout == INODE_LAYOUT_INDIRECT)
+        {
+          if (!free_map_allocate_near (1, hint, &indirect_sector))
+            return false;
+          hint = indirect_sector + 1;
+        }
+      if (!free_map_allocate_near (1, hint, &data))
+        {
+          if (indirect_sector != 0)
+            free_map_release (indirect_sector, 1);
+          return false;
+        }
+      cache_zero (data);
+      cache_write_part (data, disk_inode->inline_data, 0,
+                        disk_inode->length);
+    }
+
+  memset (disk_inode->inline_data, 0, sizeof disk_inode->inline_data);
+  disk_inode->layout = new_inode_layout;
+  disk_inode->extent_cnt = 0;
+  disk_inode->extent_block = 0;
+  disk_inode->indirect_blocks_sector = indirect_sector;
+  disk_inode->double_indirect_blocks_sector = 0;
+  if (data == 0)
+    return true;
+
+  if (new_inode_layout == INODE_LAYOUT_EXTENTS)
+    {
+      /* The first extent lives in the inode, so this cannot need
+         an extent block. */
+      if (!extent_append (disk_inode, data, 1))
+        NOT_REACHED ();
+    }
+  else
+    {
+      memset (&indirect, 0, sizeof indirect);
+      indirect.block_sectors[0] = data;
+      cache_write (indirect_sector, &indirect);
+    }
+  return true;
+}
 
 bool add_inode_size (struct inode_disk *disk_inode, off_t new_size)
 {
 	bool result = false; // Set default return value as false
 
 	ASSERT(new_size >= disk_inode->length);
+	if (new_size > MAXIMUM_SIZE)
+		return false;
+
+	if (disk_inode->layout == INODE_LAYOUT_INLINE)
+	  {
+	    if (new_size <= INODE_INLINE_SIZE)
+	      {
+	        disk_inode->length = new_size;
+	        cache_write (disk_inode->sector, disk_inode);
+	        return true;
+	      }
+	    if (!inline_migrate (disk_inode))
+	      return false;
+	  }
+	if (disk_inode->layout == INODE_LAYOUT_EXTENTS)
+		return extent_grow (disk_inode, new_size);
 
 	size_t new_sector = bytes_to_sectors (new_size) - bytes_to_sectors(disk_inode->length); // 새로 추가해줘야하는 sector 수 환산.
 	size_t previous_sector = bytes_to_sectors(disk_inode->length);
@@ -159,46 +809,95 @@ bool add_inode_size (struct inode_disk *disk_inode, off_t new_size)
 	/* The case that it doesn't have to be expanded. */
 	if (new_sector == 0){
 		disk_inode->length = new_size; // The length would be the same with new_size even though they have the same number of sectors.
-		block_write(fs_device, disk_inode->sector, disk_inode);
+		cache_write (disk_inode->sector, disk_inode);
 		return true; // Since this function terminated well, return true.
 	}
 	
 	struct indirect_block indirect;
+
+	/* Place new sectors right after the file's last data sector,
+	   or after the inode itself for an empty file. */
+	block_sector_t hint = disk_inode->sector + 1;
 	
 	/* Initialize an indirect block if it didn't have */
 	if (disk_inode->length == 0){ 
-		free_map_allocate(1, &disk_inode->indirect_blocks_sector);  // indirect_blocks_sector에 1칸만큼 할당된 sector 값을 넣는다.
-		block_write(fs_device, disk_inode->indirect_blocks_sector, zero_block); // indirect_blocks_sector에 해당하는 block에 초기값 write
+		/* On a full disk the sector stays 0, and writing it would
+		   overwrite the free map's inode. */
+		if (!free_map_allocate_near (1, hint, &disk_inode->indirect_blocks_sector))  // indirect_blocks_sector에 1칸만큼 할당된 sector 값을 넣는다.
+			return false;
+		cache_write (disk_inode->indirect_blocks_sector, zero_block); // indirect_blocks_sector에 해당하는 block에 초기값 write
+		hint = disk_inode->indirect_blocks_sector + 1;
 	}
-	block_read(fs_device, disk_inode->indirect_blocks_sector, &indirect);  // indirect_blocks_sector에 있던 값을 block buffer에 저장.
-	int i;
+	if (disk_inode->indirect_blocks_sector != 0)
+	{
+		size_t j;
+
+		cache_read (disk_inode->indirect_blocks_sector, &indirect);  // indirect_blocks_sector에 있던 값을 block buffer에 저장.
+		hint = disk_inode->indirect_blocks_sector + 1;
+		/* Holes are 0, so go after the last sector that is there. */
+		for (j = indirect_index; j > 0; j--)
+			if (indirect.block_sectors[j - 1] != 0)
+			{
+				hint = indirect.block_sectors[j - 1] + 1;
+				break;
+			}
+	}
+	else if (disk_inode->double_indirect_blocks_sector != 0)
+	{
+		size_t j;
+
+		/* The last group has just moved into the double indirect
+		   block; go after its indirect block. */
+		cache_read (disk_inode->double_indirect_blocks_sector, &indirect);
+		for (j = 128; j > 0; j--)
+			if (indirect.block_sectors[j - 1] != 0)
+			{
+				hint = indirect.block_sectors[j - 1] + 1;
+				break;
+			}
+	}
+	/* Data sectors are not allocated here.  Their pointers stay 0,
+	   a hole, until inode_write_at() first writes them, and
+	   inode_read_at() reads holes as zeros. */
+	size_t i;
+	result = true;
 	for (i=0;i<new_sector;i++)
 		{
 			/* Initialize an indirect block if it didn't have */
 			if (disk_inode->indirect_blocks_sector == 0)
 			{
-				free_map_allocate(1, &disk_inode->indirect_blocks_sector);
-				block_write(fs_device, disk_inode->indirect_blocks_sector, zero_block);
-				block_read(fs_device, disk_inode->indirect_blocks_sector, &indirect);
-			}
-
-			/* Add initialized direct blocks */
-			if (free_map_allocate(1, &indirect.block_sectors[(indirect_index+i)%128]))
-			{
-				block_write(fs_device, indirect.block_sectors[(indirect_index+i)%128], zero_block);
+				if (!free_map_allocate_near (1, hint, &disk_inode->indirect_blocks_sector))
+				{
+					result = false;
+					break;
+				}
+				memset (&indirect, 0, sizeof indirect);
+				hint = disk_inode->indirect_blocks_sector + 1;
 			}
 
-			
 			if ((indirect_index+i+1)%128 == 0)
 			{
-				block_write(fs_device, disk_inode->indirect_blocks_sector, &indirect);
-				disk_inode = single_to_double_indirect(disk_inode);
+				/* Without a double indirect block the group cannot be
+				   completed, so the file stops one sector short of it
+				   and the group stays in the inode's indirect block. */
+				cache_write (disk_inode->indirect_blocks_sector, &indirect);
+				if (!single_to_double_indirect(disk_inode))
+				{
+					result = false;
+					break;
+				}
 			}
 		}
-	block_write(fs_device, disk_inode->indirect_blocks_sector, &indirect);
-	disk_inode->length = new_size;
-	block_write(fs_device, disk_inode->sector, disk_inode);
-	result = true;
+	if (disk_inode->indirect_blocks_sector != 0)
+		cache_write (disk_inode->indirect_blocks_sector, &indirect);
+
+	/* If the disk filled up, the file only grows as far as the
+	   sectors that could be allocated. */
+	if (result)
+		disk_inode->length = new_size;
+	else if (i > 0)
+		disk_inode->length = (previous_sector + i) * BLOCK_SECTOR_SIZE;
+	cache_write (disk_inode->sector, disk_inode);
 	return result;
 }
 
@@ -231,6 +930,11 @@ inode_create (block_sector_t sector, off_t length, bool isdir)
       disk_inode->length = 0;
       disk_inode->isdir = isdir;
       disk_inode->parent = ROOT_DIR_SECTOR;
+      /* The free map's layout records the disk's format, which
+         free_map_open() reads back, so it is never inline. */
+      disk_inode->layout = (length <= INODE_INLINE_SIZE
+                            && sector != FREE_MAP_SECTOR
+                            ? INODE_LAYOUT_INLINE : new_inode_layout);
       disk_inode->indirect_blocks_sector = 0;
       disk_inode->double_indirect_blocks_sector = 0;
 	  if (add_inode_size (disk_inode, length))
@@ -249,36 +953,76 @@ inode_create (block_sector_t sector, off_t length, bool isdir)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
+  struct inode key;
+  struct hash_elem *e;
   struct inode *inode;
 
   /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
+  lock_acquire (&open_inodes_lock);
+  key.sector = sector;
+  e = hash_find (&open_inodes, &key.elem);
+  if (e != NULL)
     {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
+      inode = hash_entry (e, struct inode, elem);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+      return inode; 
     }
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = kmem_cache_alloc (&inode_cache);
   if (inode == NULL)
-    return NULL;
+    {
+      lock_release (&open_inodes_lock);
+      return NULL;
+    }
 
-  /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
+  /* Initialize.  The inode is read before the lock is released,
+     so that concurrent openers never see it half-filled. */
   inode->sector = sector;
+  hash_insert (&open_inodes, &inode->elem);
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
+  inode->version = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
-  inode->isdir = inode->data.isdir;
-  inode->parent = inode->data.parent;
-  lock_init(&inode->lock);
+  inode->block_map = NULL;
+  inode->block_map_cnt = 0;
+  inode->dir_index = NULL;
+  inode->data = NULL;
+  if (statfs_owns (sector))
+    {
+      /* Not on disk.  It looks like an inline inode whose writes
+         are denied, so only inline_io() and inode_sync() need to
+         know. */
+      inode->data = statfs_render (sector, &inode->length, &inode->isdir);
+      if (inode->data == NULL)
+        {
+          hash_delete (&open_inodes, &inode->elem);
+          kmem_cache_free (&inode_cache, inode);
+          lock_release (&open_inodes_lock);
+          return NULL;
+        }
+      inode->deny_write_cnt = 1;
+      inode->parent = ROOT_DIR_SECTOR;
+      inode->layout = INODE_LAYOUT_INLINE;
+      inode->extent_cnt = 0;
+      inode->extent_block = 0;
+      inode->indirect_blocks_sector = 0;
+      inode->double_indirect_blocks_sector = 0;
+      lock_release (&open_inodes_lock);
+      return inode;
+    }
+  disk_inode_read (sector, isdir, &inode->isdir);
+  disk_inode_read (sector, parent, &inode->parent);
+  disk_inode_read (sector, length, &inode->length);
+  disk_inode_read (sector, layout, &inode->layout);
+  disk_inode_read (sector, extent_cnt, &inode->extent_cnt);
+  disk_inode_read (sector, extent_block, &inode->extent_block);
+  disk_inode_read (sector, indirect_blocks_sector,
+                   &inode->indirect_blocks_sector);
+  disk_inode_read (sector, double_indirect_blocks_sector,
+                   &inode->double_indirect_blocks_sector);
+  lock_release (&open_inodes_lock);
   return inode;
 }
 
@@ -287,10 +1031,23 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      lock_acquire (&open_inodes_lock);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+    }
   return inode;
 }
 
+/* Returns INODE's version, which changes whenever a write to
+   INODE completes.  Data read from INODE while its version stays
+   the same is still current. */
+unsigned
+inode_get_version (const struct inode *inode)
+{
+  return inode->version;
+}
+
 /* Returns INODE's inode number. */
 block_sector_t
 inode_get_inumber (const struct inode *inode)
@@ -304,55 +1061,117 @@ inode_get_inumber (const struct inode *inode)
 void
 inode_close (struct inode *inode) 
 {
+  bool last;
+
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
 
+  /* Remove from the open inode table if this was the last
+     opener. */
+  lock_acquire (&open_inodes_lock);
+  last = --inode->open_cnt == 0;
+  if (last)
+    hash_delete (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
+
   /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  if (last)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
- 
       /* Deallocate blocks if removed. */
       if (inode->removed) 
         {
+          journal_begin ();
           free_map_release (inode->sector, 1);
 //          free_map_release (inode->data.start, bytes_to_sectors (inode->data.length)); 
 
-          int i, j;
-	  struct indirect_block indirect;
-	  struct indirect_block double_indirect;
-	  if (inode->data.indirect_blocks_sector != 0)
- 	  {
-               block_read (fs_device, inode->data.indirect_blocks_sector, &indirect);
-	       for (i=0;i<128;i++)
-	       {
-	  	  if (indirect.block_sectors[i] != 0)
-		  {
-	            free_map_release(indirect.block_sectors[i], 1);
-		  }
-	       }
-	  }
-	  if (inode->data.double_indirect_blocks_sector != 0)
-	  {
-	      block_read (fs_device, inode->data.double_indirect_blocks_sector, &indirect);
-	      for (i=0;i<128;i++)
-	      {
-	          if (indirect.block_sectors[i] != 0)
-	          {
-		      block_read (fs_device, indirect.block_sectors[i], &double_indirect);
-		      for (j=0;j<128;j++)
-		          if (double_indirect.block_sectors[j] != 0)
-			      free_map_release(double_indirect.block_sectors[j], 1);
-		  }
-	      }
-	  }
+          if (inode->layout == INODE_LAYOUT_EXTENTS)
+            extent_release (inode);
+          else
+            indirect_release (inode);
+          journal_end ();
         }
-        free (inode); 
+        block_map_clear (inode);
+        dir_index_free (inode->dir_index);
+        if (inode->data != NULL)
+          statfs_release (inode->data);
+        kmem_cache_free (&inode_cache, inode);
+    }
+}
+
+/* Sectors being released by indirect_release(), gathered into a
+   run of consecutive sectors. */
+struct release_run
+  {
+    block_sector_t start;               /* First sector. */
+    size_t cnt;                         /* Number of sectors, or 0. */
+  };
+
+/* Releases the sectors in RUN, if any, and empties it. */
+static void
+release_flush (struct release_run *run)
+{
+  if (run->cnt > 0)
+    free_map_release (run->start, run->cnt);
+  run->cnt = 0;
+}
+
+/* Adds SECTOR to RUN, first releasing RUN's sectors if SECTOR
+   does not directly follow them. */
+static void
+release_add (struct release_run *run, block_sector_t sector)
+{
+  if (run->cnt > 0 && run->start + run->cnt == sector)
+    run->cnt++;
+  else
+    {
+      release_flush (run);
+      run->start = sector;
+      run->cnt = 1;
     }
 }
 
+/* Adds indirect block SECTOR and the data sectors it lists to
+   RUN. */
+static void
+release_group (struct release_run *run, block_sector_t sector)
+{
+  struct indirect_block indirect;
+  size_t i;
+
+  cache_read (sector, &indirect);
+  release_add (run, sector);
+  for (i = 0; i < 128; i++)
+    if (indirect.block_sectors[i] != 0)
+      release_add (run, indirect.block_sectors[i]);
+}
+
+/* Releases the data sectors of INODE, which uses indirect
+   blocks, and the indirect blocks themselves.  A file's sectors
+   mostly follow one another on disk, each indirect block just
+   before the data it lists, so they go back to the free map in
+   a few long runs rather than one at a time. */
+static void
+indirect_release (const struct inode *inode)
+{
+  struct release_run run = { 0, 0 };
+
+  if (inode->indirect_blocks_sector != 0)
+    release_group (&run, inode->indirect_blocks_sector);
+  if (inode->double_indirect_blocks_sector != 0)
+    {
+      struct indirect_block dbl;
+      size_t i;
+
+      cache_read (inode->double_indirect_blocks_sector, &dbl);
+      for (i = 0; i < 128; i++)
+        if (dbl.block_sectors[i] != 0)
+          release_group (&run, dbl.block_sectors[i]);
+      release_add (&run, inode->double_indirect_blocks_sector);
+    }
+  release_flush (&run);
+}
+
 /* Marks INODE to be deleted when it is closed by the last caller who
    has it open. */
 void
@@ -362,20 +1181,232 @@ inode_remove (struct inode *inode)
   inode->removed = true;
 }
 
+/* Position in a scatter/gather list. */
+struct iov_iter
+  {
+    const struct iovec *iov;            /* Current buffer. */
+    size_t cnt;                         /* Buffers left, counting IOV. */
+    size_t ofs;                         /* Bytes of IOV already used. */
+  };
+
+/* Moves IT past N bytes, and past any empty buffers after them. */
+static void
+iov_advance (struct iov_iter *it, size_t n)
+{
+  it->ofs += n;
+  while (it->cnt > 0 && it->ofs >= it->iov->iov_len)
+    {
+      ASSERT (it->ofs == it->iov->iov_len);
+      it->ofs = 0;
+      it->iov++;
+      it->cnt--;
+    }
+}
+
+/* Starts IT at the first byte of the CNT buffers in IOV. */
+static void
+iov_start (struct iov_iter *it, const struct iovec *iov, size_t cnt)
+{
+  it->iov = iov;
+  it->cnt = cnt;
+  it->ofs = 0;
+  iov_advance (it, 0);
+}
+
+/* Returns the total size of the CNT buffers in IOV. */
+static off_t
+iov_size (const struct iovec *iov, size_t cnt)
+{
+  off_t size = 0;
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    size += iov[i].iov_len;
+  return size;
+}
+
+/* Sets *P to the next byte at IT and returns how many bytes,
+   up to N, follow it in the same buffer.  Does not advance IT. */
+static size_t
+iov_piece (const struct iov_iter *it, size_t n, uint8_t **p)
+{
+  size_t left = it->iov->iov_len - it->ofs;
+
+  ASSERT (it->cnt > 0);
+
+  *p = (uint8_t *) it->iov->iov_base + it->ofs;
+  return left < n ? left : n;
+}
+
+/* Stores N zeros at IT and advances it. */
+static void
+iov_zero (struct iov_iter *it, size_t n)
+{
+  while (n > 0)
+    {
+      uint8_t *dst;
+      size_t chunk = iov_piece (it, n, &dst);
+
+      memset (dst, 0, chunk);
+      iov_advance (it, chunk);
+      n -= chunk;
+    }
+}
+
+/* Releases INODE's lock, which inline_io() took for writing if
+   WRITE is true, otherwise for reading. */
+static void
+inline_unlock (struct inode *inode, bool write)
+{
+  if (write)
+    rwlock_release_write (&inode->lock);
+  else
+    rwlock_release_read (&inode->lock);
+}
+
+/* Moves up to SIZE bytes between INODE's inline data, starting
+   at OFFSET, and the buffers at IT, advancing IT: into INODE if
+   WRITE is true, otherwise out of it.  Stops at the end of INODE,
+   which a write must already have been extended past.  The data
+   goes through a buffer on the stack, so that the caller's
+   buffers are never touched with INODE's lock held.  Returns the
+   number of bytes moved, or -1, leaving IT alone, if INODE does
+   not keep its data inline. */
+static off_t
+inline_io (struct inode *inode, struct iov_iter *it, off_t size,
+           off_t offset, bool write)
+{
+  uint8_t buf[INODE_INLINE_SIZE];
+  struct iov_iter copy = *it;
+  off_t n;
+
+  /* Data made up in memory never changes, so it can be copied
+     out without the lock, and it is never written. */
+  if (inode->data != NULL)
+    {
+      off_t done;
+
+      ASSERT (!write);
+      n = inode->length - offset;
+      if (n > size)
+        n = size;
+      for (done = 0; done < n; )
+        {
+          uint8_t *dst;
+          size_t chunk = iov_piece (it, n - done, &dst);
+
+          memcpy (dst, (uint8_t *) inode->data + offset + done, chunk);
+          iov_advance (it, chunk);
+          done += chunk;
+        }
+      return n > 0 ? n : 0;
+    }
+
+  if (size > INODE_INLINE_SIZE)
+    size = INODE_INLINE_SIZE;
+  if (write)
+    for (n = 0; n < size; )
+      {
+        uint8_t *src;
+        size_t chunk = iov_piece (&copy, size - n, &src);
+
+        memcpy (buf + n, src, chunk);
+        iov_advance (&copy, chunk);
+        n += chunk;
+      }
+
+  if (write)
+    rwlock_acquire_write (&inode->lock);
+  else
+    rwlock_acquire_read (&inode->lock);
+  if (inode->layout != INODE_LAYOUT_INLINE)
+    {
+      inline_unlock (inode, write);
+      return -1;
+    }
+  n = inode->length - offset;
+  if (n > size)
+    n = size;
+  if (n <= 0)
+    n = 0;
+  else if (write)
+    cache_write_part (inode->sector, buf,
+                      offsetof (struct inode_disk, inline_data) + offset, n);
+  else
+    cache_read_part (inode->sector, buf,
+                     offsetof (struct inode_disk, inline_data) + offset, n);
+  inline_unlock (inode, write);
+
+  if (write)
+    iov_advance (it, n);
+  else
+    {
+      off_t done;
+
+      for (done = 0; done < n; )
+        {
+          uint8_t *dst;
+          size_t chunk = iov_piece (it, n - done, &dst);
+
+          memcpy (dst, buf + done, chunk);
+          iov_advance (it, chunk);
+          done += chunk;
+        }
+    }
+  return n;
+}
+
+/* Returns true if INODE keeps its data inline.  Once false, this
+   stays false. */
+static bool
+is_inline (struct inode *inode)
+{
+  bool ret;
+
+  rwlock_acquire_read (&inode->lock);
+  ret = inode->layout == INODE_LAYOUT_INLINE;
+  rwlock_release_read (&inode->lock);
+  return ret;
+}
+
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
 off_t
-inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
+inode_read_at (struct inode *inode, void *buffer, off_t size, off_t offset) 
 {
-  uint8_t *buffer = buffer_;
+  struct iovec iov;
+
+  iov.iov_base = buffer;
+  iov.iov_len = size;
+  return inode_readv_at (inode, &iov, 1, offset);
+}
+
+/* Reads from INODE, starting at position OFFSET, into the CNT
+   buffers in IOV, filling each in turn.  Returns the number of
+   bytes actually read, which may be less than the buffers' total
+   size if an error occurs or end of file is reached.  Data is
+   copied straight out of the buffer cache into the buffers. */
+off_t
+inode_readv_at (struct inode *inode, const struct iovec *iov, size_t cnt,
+                off_t offset)
+{
+  struct iov_iter it;
+  off_t size = iov_size (iov, cnt);
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
 
+  iov_start (&it, iov, cnt);
+  if (size > 0)
+    {
+      bytes_read = inline_io (inode, &it, size, offset, false);
+      if (bytes_read >= 0)
+        return bytes_read;
+      bytes_read = 0;
+    }
   while (size > 0) 
     {
       /* Disk sector to read, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      block_sector_t sector_idx = map_sector (inode, offset, false);
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -388,23 +1419,25 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
+      if (sector_idx == 0)
         {
-          /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
+          /* Never written: reads as zeros. */
+          iov_zero (&it, chunk_size);
         }
-      else 
+      else
         {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL) 
+          /* Copy into each caller's buffer the chunk overlaps. */
+          int left = chunk_size;
+          while (left > 0)
             {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
+              uint8_t *dst;
+              size_t n = iov_piece (&it, left, &dst);
+
+              cache_read_part (sector_idx, dst, sector_ofs, n);
+              iov_advance (&it, n);
+              sector_ofs += n;
+              left -= n;
             }
-          block_read (fs_device, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
         }
       
       /* Advance. */
@@ -412,40 +1445,186 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
 
   return bytes_read;
 }
 
+/* Starts bringing the sectors that hold SIZE bytes of INODE,
+   starting at OFFSET, into the buffer cache in the background.
+   Bytes past the end of INODE are ignored. */
+void
+inode_read_ahead (struct inode *inode, off_t offset, off_t size)
+{
+  off_t end = offset + size;
+
+  if (end > inode_length (inode))
+    end = inode_length (inode);
+  for (offset = ROUND_DOWN (offset, BLOCK_SECTOR_SIZE); offset < end;
+       offset += BLOCK_SECTOR_SIZE)
+    {
+      block_sector_t sector = map_sector (inode, offset, false);
+      if (sector != 0)
+        cache_read_ahead (sector);
+    }
+}
+
+/* Loads INODE's data into the buffer cache from the start, and
+   keeps it there, as far as cache_preload() will take it.  For
+   the "-preload" option. */
+void
+inode_preload (struct inode *inode)
+{
+  off_t offset;
+
+  for (offset = 0; offset < inode_length (inode);
+       offset += BLOCK_SECTOR_SIZE)
+    {
+      block_sector_t sector = map_sector (inode, offset, false);
+      if (sector != 0 && !cache_preload (sector))
+        break;
+    }
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if an error occurs or the write would take
+   INODE past MAXIMUM_SIZE.  A write past end of file extends
+   INODE. */
 off_t
-inode_write_at (struct inode *inode, const void *buffer_, off_t size,
+inode_write_at (struct inode *inode, const void *buffer, off_t size,
                 off_t offset) 
 {
-  const uint8_t *buffer = buffer_;
+  struct iovec iov;
+
+  iov.iov_base = (void *) buffer;
+  iov.iov_len = size;
+  return inode_writev_at (inode, &iov, 1, offset);
+}
+
+/* Extends INODE to NEW_SIZE bytes, or as far as the disk allows.
+   When no sectors need to be added, only the length is written
+   to the inode's sector; otherwise the whole on-disk inode is
+   read into a temporary copy for add_inode_size() to work on.
+   INODE's lock must be held. */
+static void
+inode_grow (struct inode *inode, off_t new_size)
+{
+  struct inode_disk *disk_inode;
+  bool same_sectors;
+
+  if (inode->layout == INODE_LAYOUT_INLINE)
+    same_sectors = new_size <= INODE_INLINE_SIZE;
+  else
+    same_sectors = (bytes_to_sectors (new_size)
+                    == bytes_to_sectors (inode->length));
+  if (same_sectors)
+    {
+      inode->length = new_size;
+      disk_inode_write (inode->sector, length, &inode->length);
+      return;
+    }
+
+  disk_inode = malloc (sizeof *disk_inode);
+  if (disk_inode == NULL)
+    return;
+  cache_read (inode->sector, disk_inode);
+  add_inode_size (disk_inode, new_size);
+  inode->length = disk_inode->length;
+  inode->layout = disk_inode->layout;
+  inode->extent_cnt = disk_inode->extent_cnt;
+  inode->extent_block = disk_inode->extent_block;
+  inode->indirect_blocks_sector = disk_inode->indirect_blocks_sector;
+  inode->double_indirect_blocks_sector
+    = disk_inode->double_indirect_blocks_sector;
+  free (disk_inode);
+  block_map_clear (inode);
+}
+
+/* Prepares to write SIZE bytes to INODE at OFFSET, extending it
+   if necessary.  INODE never grows past MAXIMUM_SIZE, so a write
+   beyond that is cut short.  Returns false if writes to INODE are
+   denied.
+
+   INODE grows by at most GROW_STEP bytes per journal handle, so
+   that no transaction outgrows the log.  A crash can therefore
+   leave INODE grown only part of the way, which is harmless
+   because nothing has been written past its old end yet.  A
+   caller that already holds a handle, such as a directory
+   adding an entry, keeps the whole growth in that handle. */
+static bool
+write_begin (struct inode *inode, off_t offset, off_t size)
+{
+  off_t end = offset + size;
+  bool ok, more;
+
+  if (end > MAXIMUM_SIZE)
+    end = MAXIMUM_SIZE;
+
+  do
+    {
+      off_t length, step;
+
+      journal_begin ();
+      rwlock_acquire_write (&inode->lock);
+      ok = !inode->deny_write_cnt;
+      length = inode->length;
+      step = ROUND_DOWN (length, GROW_STEP) + GROW_STEP;
+      if (step > end)
+        step = end;
+      if (ok && step > length)
+        inode_grow (inode, step);
+      more = ok && inode->length > length && inode->length < end;
+      rwlock_release_write (&inode->lock);
+      journal_end ();
+    }
+  while (more);
+  return ok;
+}
+
+/* Finishes a write to INODE.  The write is counted only once its
+   data is in place, so that a reader that sees the same version
+   before and after reading has not seen part of this write. */
+static void
+write_end (struct inode *inode)
+{
+  rwlock_acquire_write (&inode->lock);
+  inode->version++;
+  rwlock_release_write (&inode->lock);
+}
+
+/* Writes the CNT buffers in IOV, one after another, into INODE,
+   starting at OFFSET, extending INODE if necessary.  Returns the
+   number of bytes actually written, which may be less than the
+   buffers' total size if an error occurs.  Data is copied
+   straight into the buffer cache, which reads a sector from disk
+   first only if the write leaves part of it unchanged. */
+off_t
+inode_writev_at (struct inode *inode, const struct iovec *iov, size_t cnt,
+                 off_t offset)
+{
+  struct iov_iter it;
+  off_t size = iov_size (iov, cnt);
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
 
-  if (inode->deny_write_cnt)
+  if (!write_begin (inode, offset, size))
     return 0;
 
-  if (offset + size > inode->data.length)
-  {
-    if(!inode->isdir)
-      lock_acquire(&inode->lock);
-    add_inode_size(&inode->data, offset + size);
-    if(!inode->isdir)
-      lock_release(&inode->lock);  
-  }
-
+  iov_start (&it, iov, cnt);
+  if (size > 0)
+    {
+      bytes_written = inline_io (inode, &it, size, offset, true);
+      if (bytes_written >= 0)
+        {
+          write_end (inode);
+          return bytes_written;
+        }
+      bytes_written = 0;
+    }
   while (size > 0) 
     {
-      /* Sector to write, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      /* Sector to write, starting byte offset within sector.
+         The sector is allocated on its first write. */
+      block_sector_t sector_idx = map_sector (inode, offset, true);
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -455,33 +1634,20 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 
       /* Number of bytes to actually write into this sector. */
       int chunk_size = size < min_left ? size : min_left;
-      if (chunk_size <= 0)
+      if (chunk_size <= 0 || sector_idx == 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
+      /* Copy from each caller's buffer the chunk overlaps. */
+      int left = chunk_size;
+      while (left > 0)
         {
-          /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
-        }
-      else 
-        {
-          /* We need a bounce buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
+          uint8_t *src;
+          size_t n = iov_piece (&it, left, &src);
 
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
-          else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
+          cache_write_part (sector_idx, src, sector_ofs, n);
+          iov_advance (&it, n);
+          sector_ofs += n;
+          left -= n;
         }
 
       /* Advance. */
@@ -489,18 +1655,380 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       offset += chunk_size;
       bytes_written += chunk_size;
     }
-  free (bounce);
 
+  write_end (inode);
   return bytes_written;
 }
 
+/* Gives each hole in INODE from START up to END a data sector of
+   its own, taking runs as long as the free map can find.  START
+   must be sector-aligned.  Returns false if the disk fills up
+   first.  INODE's lock must be held for writing. */
+static bool
+fill_holes (struct inode *inode, off_t start, off_t end)
+{
+  off_t pos;
+  size_t need = 0;
+
+  for (pos = start; pos < end; pos += BLOCK_SECTOR_SIZE)
+    if (byte_to_sector (inode, pos) == 0)
+      need++;
+
+  pos = start;
+  while (need > 0)
+    {
+      block_sector_t run_start;
+      size_t cnt, i;
+
+      while (byte_to_sector (inode, pos) != 0)
+        pos += BLOCK_SECTOR_SIZE;
+      cnt = free_map_allocate_run (need, hole_hint (inode, pos),
+                                   &run_start);
+      if (cnt == 0)
+        return false;
+      for (i = 0; i < cnt; pos += BLOCK_SECTOR_SIZE)
+        if (byte_to_sector (inode, pos) == 0)
+          set_hole (inode, pos, run_start + i++);
+      need -= cnt;
+    }
+  return true;
+}
+
+/* Makes sure that every byte of INODE from OFFSET up to OFFSET +
+   SIZE has a data sector of its own, extending INODE to that
+   length if it is shorter, so that writing there later needs no
+   allocation.  Holes are given sectors from runs as long as the
+   free map can find, and the sectors read as zeros without being
+   written until data lands in them.  Returns false if writes to
+   INODE are denied or the disk fills up first, in which case
+   some of the range may have been allocated. */
+bool
+inode_allocate (struct inode *inode, off_t offset, off_t size)
+{
+  off_t end = offset + size;
+  off_t pos = ROUND_DOWN (offset, BLOCK_SECTOR_SIZE);
+  bool success = true;
+
+  if (!write_begin (inode, offset, size))
+    return false;
+
+  /* Extent-based inodes have no holes: growing them has already
+     allocated everything.  Inline data needs no sectors.  Holes
+     are filled GROW_STEP bytes per journal handle, like growth. */
+  while (success && pos < end)
+    {
+      off_t step = ROUND_DOWN (pos, GROW_STEP) + GROW_STEP;
+
+      journal_begin ();
+      rwlock_acquire_write (&inode->lock);
+      if (inode->layout != INODE_LAYOUT_INDIRECT)
+        step = end;
+      else
+        {
+          if (step > end)
+            step = end;
+          if (step > inode->length)
+            step = inode->length;
+          success = fill_holes (inode, pos, step);
+        }
+      rwlock_release_write (&inode->lock);
+      journal_end ();
+      if (step <= pos)
+        break;
+      pos = step;
+    }
+
+  rwlock_acquire_write (&inode->lock);
+  if (inode->length < offset + size)
+    success = false;
+  rwlock_release_write (&inode->lock);
+
+  write_end (inode);
+  return success;
+}
+
+/* Most block requests inode_direct_at() hands the cache at once. */
+#define DIRECT_BATCH 8
+
+/* Moves data between INODE, starting at OFFSET, and the CNT
+   buffers in IOV, straight to or from the disk rather than
+   through the buffer cache: into INODE, extending it if
+   necessary, if WRITE is true, otherwise out of it.  OFFSET and
+   the length of each buffer must be multiples of
+   BLOCK_SECTOR_SIZE, and the buffers must be in kernel memory.
+   Sectors that follow each other both on disk and in a buffer go
+   in one request.  A read's last sector, if only partly inside
+   INODE, is read through the cache.  Returns the number of bytes
+   moved, which may be less than the buffers' total size if end
+   of file is reached on a read or the disk fills up on a
+   write. */
+off_t
+inode_direct_at (struct inode *inode, const struct iovec *iov, size_t cnt,
+                 off_t offset, bool write)
+{
+  struct block_request reqs[DIRECT_BATCH];
+  size_t req_cnt = 0;
+  struct iov_iter it;
+  off_t size = iov_size (iov, cnt);
+  off_t bytes_moved = 0;
+
+  ASSERT (offset % BLOCK_SECTOR_SIZE == 0);
+  ASSERT (size % BLOCK_SECTOR_SIZE == 0);
+
+  /* Inline data has no sectors to go straight to. */
+  if (is_inline (inode))
+    return (write ? inode_writev_at (inode, iov, cnt, offset)
+            : inode_readv_at (inode, iov, cnt, offset));
+
+  if (write && !write_begin (inode, offset, size))
+    return 0;
+
+  iov_start (&it, iov, cnt);
+  while (size > 0)
+    {
+      off_t inode_left = inode_length (inode) - offset;
+      block_sector_t sector;
+      uint8_t *p;
+
+      if (inode_left <= 0)
+        break;
+      sector = map_sector (inode, offset, write);
+      if (write && sector == 0)
+        break;
+      iov_piece (&it, BLOCK_SECTOR_SIZE, &p);
+
+      if (!write && inode_left < BLOCK_SECTOR_SIZE)
+        {
+          /* The rest of the sector, past the end, is not ours to
+             hand out. */
+          if (sector == 0)
+            memset (p, 0, inode_left);
+          else
+            cache_read_part (sector, p, 0, inode_left);
+          bytes_moved += inode_left;
+          break;
+        }
+      else if (sector == 0)
+        {
+          /* Never written: reads as zeros. */
+          memset (p, 0, BLOCK_SECTOR_SIZE);
+        }
+      else
+        {
+          struct block_request *r = req_cnt > 0 ? &reqs[req_cnt - 1] : NULL;
+
+          if (r != NULL && r->sector + r->cnt == sector
+              && (uint8_t *) r->buffer + r->cnt * BLOCK_SECTOR_SIZE == p)
+            r->cnt++;
+          else
+            {
+              if (req_cnt == DIRECT_BATCH)
+                {
+                  cache_direct (reqs, req_cnt);
+                  req_cnt = 0;
+                }
+              r = &reqs[req_cnt++];
+              r->sector = sector;
+              r->cnt = 1;
+              r->buffer = p;
+              r->write = write;
+              r->prepaid = false;
+            }
+        }
+
+      iov_advance (&it, BLOCK_SECTOR_SIZE);
+      size -= BLOCK_SECTOR_SIZE;
+      offset += BLOCK_SECTOR_SIZE;
+      bytes_moved += BLOCK_SECTOR_SIZE;
+    }
+  cache_direct (reqs, req_cnt);
+
+  if (write)
+    write_end (inode);
+  return bytes_moved;
+}
+
+/* Copies SIZE bytes of SRC, starting at SRC_OFS, into DST at
+   DST_OFS, extending DST if necessary.  The data moves from one
+   buffer cache entry to another without passing through any
+   other buffer.  Stops at the end of SRC.  Returns the number of
+   bytes copied.  If SRC and DST are the same inode, the two
+   ranges must not overlap. */
+off_t
+inode_copy_at (struct inode *dst, off_t dst_ofs,
+               struct inode *src, off_t src_ofs, off_t size)
+{
+  static const uint8_t zeros[BLOCK_SECTOR_SIZE];
+  off_t bytes_copied = 0;
+
+  ASSERT (src != dst || src_ofs + size <= dst_ofs
+          || dst_ofs + size <= src_ofs);
+
+  if (src_ofs + size > inode_length (src))
+    size = src_ofs < inode_length (src) ? inode_length (src) - src_ofs : 0;
+  if (size == 0 || !write_begin (dst, dst_ofs, size))
+    return 0;
+
+  /* Inline data has no cache entry of its own to copy, but then
+     there is little of it. */
+  if (is_inline (src) || is_inline (dst))
+    {
+      uint8_t *buf = malloc (size);
+
+      if (buf != NULL)
+        {
+          bytes_copied = inode_read_at (src, buf, size, src_ofs);
+          bytes_copied = inode_write_at (dst, buf, bytes_copied, dst_ofs);
+          free (buf);
+        }
+      write_end (dst);
+      return bytes_copied;
+    }
+
+  while (size > 0)
+    {
+      block_sector_t src_sector = map_sector (src, src_ofs, false);
+      block_sector_t dst_sector = map_sector (dst, dst_ofs, true);
+      int src_sector_ofs = src_ofs % BLOCK_SECTOR_SIZE;
+      int dst_sector_ofs = dst_ofs % BLOCK_SECTOR_SIZE;
+
+      /* Stop at whichever sector ends first. */
+      int src_left = BLOCK_SECTOR_SIZE - src_sector_ofs;
+      int dst_left = BLOCK_SECTOR_SIZE - dst_sector_ofs;
+      int chunk_size = src_left < dst_left ? src_left : dst_left;
+      if (size < chunk_size)
+        chunk_size = size;
+      if (dst_sector == 0)
+        break;
+
+      if (src_sector != 0)
+        cache_copy (dst_sector, dst_sector_ofs,
+                    src_sector, src_sector_ofs, chunk_size);
+      else if (chunk_size == BLOCK_SECTOR_SIZE)
+        cache_zero (dst_sector);
+      else
+        cache_write_part (dst_sector, zeros, dst_sector_ofs, chunk_size);
+
+      size -= chunk_size;
+      src_ofs += chunk_size;
+      dst_ofs += chunk_size;
+      bytes_copied += chunk_size;
+    }
+
+  write_end (dst);
+  return bytes_copied;
+}
+
+/* Sectors queued to be written by inode_sync(). */
+struct sync_batch
+  {
+    block_sector_t sectors[64];
+    size_t cnt;
+  };
+
+/* Writes out the sectors queued in BATCH and empties it. */
+static void
+sync_flush (struct sync_batch *batch)
+{
+  cache_flush_sectors (batch->sectors, batch->cnt);
+  batch->cnt = 0;
+}
+
+/* Queues SECTOR in BATCH, writing out a full batch first. */
+static void
+sync_add (struct sync_batch *batch, block_sector_t sector)
+{
+  if (batch->cnt >= sizeof batch->sectors / sizeof *batch->sectors)
+    sync_flush (batch);
+  batch->sectors[batch->cnt++] = sector;
+}
+
+/* Writes INODE's dirty sectors to disk and waits for them.  The
+   data goes first, then the indirect or extent blocks that point
+   to it, then the inode itself, so that no sector on disk ever
+   points to data that has not been written yet.  The free map is
+   not included; see free_map_sync(). */
+void
+inode_sync (struct inode *inode)
+{
+  struct sync_batch batch;
+  struct indirect_block indirect;
+  size_t i, j;
+
+  if (inode->data != NULL)
+    return;
+  batch.cnt = 0;
+  rwlock_acquire_read (&inode->lock);
+
+  /* Data. */
+  if (inode->layout == INODE_LAYOUT_EXTENTS)
+    {
+      struct extent_iter it;
+      struct extent e;
+
+      extent_iter_start (&it, inode);
+      while (extent_iter_next (&it, &e))
+        for (j = 0; j < e.length; j++)
+          sync_add (&batch, e.start + j);
+    }
+  else
+    {
+      off_t pos;
+
+      for (pos = 0; pos < inode->length; pos += BLOCK_SECTOR_SIZE)
+        {
+          block_sector_t sector = byte_to_sector (inode, pos);
+          if (sector != 0)
+            sync_add (&batch, sector);
+        }
+    }
+  sync_flush (&batch);
+
+  /* Blocks that locate the data. */
+  if (inode->layout == INODE_LAYOUT_EXTENTS)
+    {
+      block_sector_t next = inode->extent_block;
+
+      while (next != 0)
+        {
+          struct extent_block block;
+
+          sync_add (&batch, next);
+          cache_read (next, &block);
+          next = block.next;
+        }
+    }
+  else
+    {
+      if (inode->indirect_blocks_sector != 0)
+        sync_add (&batch, inode->indirect_blocks_sector);
+      if (inode->double_indirect_blocks_sector != 0)
+        {
+          sync_add (&batch, inode->double_indirect_blocks_sector);
+          cache_read (inode->double_indirect_blocks_sector, &indirect);
+          for (i = 0; i < 128; i++)
+            if (indirect.block_sectors[i] != 0)
+              sync_add (&batch, indirect.block_sectors[i]);
+        }
+    }
+  sync_flush (&batch);
+
+  /* The inode. */
+  sync_add (&batch, inode->sector);
+  sync_flush (&batch);
+
+  rwlock_release_read (&inode->lock);
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void
 inode_deny_write (struct inode *inode) 
 {
+  rwlock_acquire_write (&inode->lock);
   inode->deny_write_cnt++;
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  rwlock_release_write (&inode->lock);
 }
 
 /* Re-enables writes to INODE.
@@ -509,17 +2037,50 @@ inode_deny_write (struct inode *inode)
 void
 inode_allow_write (struct inode *inode) 
 {
+  rwlock_acquire_write (&inode->lock);
   ASSERT (inode->deny_write_cnt > 0);
 //	printf("inode->deny_write_cnt = %d\n\n",inode->deny_write_cnt);
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
   inode->deny_write_cnt--;
+  rwlock_release_write (&inode->lock);
+}
+
+/* Returns true if writes to INODE are denied. */
+bool
+inode_write_denied (const struct inode *inode)
+{
+  return inode->deny_write_cnt > 0;
 }
 
 /* Returns the length, in bytes, of INODE's data. */
 off_t
 inode_length (const struct inode *inode)
 {
-  return inode->data.length;
+  return inode->length;
+}
+
+/* Returns how many bytes can be written to INODE at POS, its
+   end, without allocating any disk space: the rest of the inline
+   data area, or the rest of the sector holding POS if that sector
+   is already allocated.  Zero if POS starts a new sector.  Since
+   every allocated sector lies within MAXIMUM_SIZE, so does the
+   room. */
+off_t
+inode_write_room (struct inode *inode, off_t pos)
+{
+  off_t room = 0;
+
+  rwlock_acquire_read (&inode->lock);
+  if (pos == inode->length)
+    {
+      if (inode->layout == INODE_LAYOUT_INLINE)
+        room = pos < INODE_INLINE_SIZE ? INODE_INLINE_SIZE - pos : 0;
+      else if (pos % BLOCK_SECTOR_SIZE != 0
+               && byte_to_sector (inode, pos) != 0)
+        room = BLOCK_SECTOR_SIZE - pos % BLOCK_SECTOR_SIZE;
+    }
+  rwlock_release_read (&inode->lock);
+  return room;
 }
 
 bool inode_is_dir (const struct inode *inode)
@@ -546,17 +2107,49 @@ bool inode_add_parent (block_sector_t parent_sector,
     return false;
   }
   inode->parent = parent_sector;
+  disk_inode_write (child_sector, parent, &inode->parent);
   inode_close(inode);
   return true;
 }
 
 void inode_lock (const struct inode *inode)
 {
-  lock_acquire(&((struct inode *)inode)->lock);
+  rwlock_acquire_write(&((struct inode *)inode)->lock);
 }
 
 void inode_unlock (const struct inode *inode)
 {
-  lock_release(&((struct inode *) inode)->lock);
+  rwlock_release_write(&((struct inode *) inode)->lock);
 }
 
+
+/* Returns the name index that the directory layer attached to
+   INODE, or a null pointer if it has none. */
+struct dir_index *
+inode_get_dir_index (struct inode *inode)
+{
+  return inode->dir_index;
+}
+
+/* Attaches name index INDEX to INODE.  It is freed with
+   dir_index_free() when INODE is last closed. */
+void
+inode_set_dir_index (struct inode *inode, struct dir_index *index)
+{
+  inode->dir_index = index;
+}
+
+/* Makes inodes created from now on use extents if EXTENTS is
+   true, or indirect blocks otherwise. */
+void
+inode_use_extents (bool extents)
+{
+  new_inode_layout = extents ? INODE_LAYOUT_EXTENTS : INODE_LAYOUT_INDIRECT;
+}
+
+/* Returns true if INODE describes its data with extents. */
+bool
+inode_has_extents (const struct inode *inode)
+{
+  return inode->layout == INODE_LAYOUT_EXTENTS;
+}
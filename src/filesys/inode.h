@@ -2,24 +2,46 @@
 #define FILESYS_INODE_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include "filesys/off_t.h"
 #include "devices/block.h"
 
 struct bitmap;
+struct dir_index;
+struct iovec;
 
 void inode_init (void);
 bool inode_create (block_sector_t, off_t, bool);
 struct inode *inode_open (block_sector_t);
 struct inode *inode_reopen (struct inode *);
 block_sector_t inode_get_inumber (const struct inode *);
+unsigned inode_get_version (const struct inode *);
 void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
+off_t inode_readv_at (struct inode *, const struct iovec *, size_t cnt,
+                      off_t offset);
+void inode_read_ahead (struct inode *, off_t offset, off_t size);
+void inode_preload (struct inode *);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+off_t inode_writev_at (struct inode *, const struct iovec *, size_t cnt,
+                       off_t offset);
+bool inode_allocate (struct inode *, off_t offset, off_t size);
+off_t inode_direct_at (struct inode *, const struct iovec *, size_t cnt,
+                       off_t offset, bool write);
+off_t inode_copy_at (struct inode *dst, off_t dst_ofs,
+                     struct inode *src, off_t src_ofs, off_t size);
+void inode_sync (struct inode *);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
+bool inode_write_denied (const struct inode *);
 off_t inode_length (const struct inode *);
+off_t inode_write_room (struct inode *, off_t pos);
 bool inode_is_dir (const struct inode *);
+void inode_use_extents (bool);
+struct dir_index *inode_get_dir_index (struct inode *);
+void inode_set_dir_index (struct inode *, struct dir_index *);
+bool inode_has_extents (const struct inode *);
 
 
 #endif /* filesys/inode.h */
@@ -0,0 +1,396 @@
+#include "filesys/journal.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/cache.h"
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+
+/* Metadata journal.
+
+   Each operation that changes the file system's metadata, such
+   as creating or removing a file, growing one, or writing out
+   the free map, runs between journal_begin() and journal_end(),
+   a "handle".  The buffer cache marks every sector written
+   inside a handle as belonging to the running transaction and
+   keeps it from reaching its home location on disk until the
+   transaction has been committed: written, along with a
+   descriptor sector that lists the sectors' home locations, to
+   the log in one sequential write.
+
+   The log is a circular region of JOURNAL_LOG_SECTORS sectors
+   allocated by do_format(), found through the header in sector
+   JOURNAL_SECTOR.  Transactions committed since the last
+   checkpoint lie in it one after another, starting at the
+   header's TAIL.  Checkpointing is lazy: the periodic cache flush
+   writes every committed sector home anyway, after which the
+   header is moved up to the log's head, and only a commit that
+   finds the log full forces a flush of its own.  At mount,
+   journal_open() writes the sectors of each complete
+   transaction after TAIL to their homes, in order, so that a
+   crash leaves each operation either wholly done or not done at
+   all.
+
+   A commit waits for every handle to end, and holds new ones off
+   while it writes, so that no transaction holds part of an
+   operation.  The exception is a transaction that fills most of
+   the cache before any commit gets its turn: the cache then
+   commits it on its own, in the middle of whatever operations
+   are running.  To keep that rare, operations that could touch
+   any number of sectors, growing a file or filling its holes,
+   take a new handle for each indirect block's worth of data, so
+   that each handle dirties only a few sectors.
+
+   A disk formatted without a journal has no header, and then
+   metadata goes straight to its home locations, as before. */
+
+/* Number of sectors in the log. */
+#define JOURNAL_LOG_SECTORS 128
+
+/* Most sectors in one transaction. */
+#define TXN_MAX_SECTORS 124
+
+#define JOURNAL_MAGIC 0x4a524e4c        /* "JRNL". */
+#define TXN_MAGIC 0x5458444e            /* "TXDN". */
+
+/* Starting value for checksum(). */
+#define CHECKSUM_BASIS 2166136261u
+
+/* The journal header, in sector JOURNAL_SECTOR.  Must be exactly
+   BLOCK_SECTOR_SIZE bytes long. */
+struct journal_header
+  {
+    unsigned magic;                     /* JOURNAL_MAGIC. */
+    block_sector_t log_start;           /* First sector of the log. */
+    uint32_t log_size;                  /* Number of sectors in the log. */
+    uint32_t tail;                      /* Log offset of oldest transaction. */
+    uint32_t seq;                       /* Its sequence number. */
+    uint8_t unused[492];
+  };
+
+/* A transaction's first sector, followed in the log by the CNT
+   sectors it lists.  Must be exactly BLOCK_SECTOR_SIZE bytes
+   long. */
+struct txn_descriptor
+  {
+    unsigned magic;                     /* TXN_MAGIC. */
+    uint32_t seq;                       /* Sequence number. */
+    uint32_t cnt;                       /* Number of sectors. */
+    uint32_t checksum;                  /* Of the sectors' contents. */
+    block_sector_t sectors[TXN_MAX_SECTORS]; /* Their homes. */
+  };
+
+/* In-memory copy of the header.  False ACTIVE means the disk has
+   no journal. */
+static struct journal_header header;
+static bool active;
+
+/* Where the next transaction goes, its sequence number, and
+   whether any transaction lies between TAIL and HEAD.  These and
+   the log itself are protected by the buffer cache's lock. */
+static uint32_t head;
+static uint32_t next_seq;
+static bool live;
+
+/* Descriptor for journal_write() and its block requests. */
+static struct txn_descriptor descriptor;
+static struct block_request log_reqs[TXN_MAX_SECTORS + 1];
+
+/* Number of handles open, counting each thread's nested ones
+   once.  Protected by HANDLE_LOCK, which a commit also holds
+   while it writes. */
+static int handles;
+static struct lock handle_lock;
+static struct condition no_handles;
+
+/* Commits on system_wq on behalf of the cache. */
+static struct work commit_work;
+
+static void commit_work_func (void *aux);
+static void replay (void);
+static bool read_txn (uint32_t pos, uint32_t seq, struct txn_descriptor *);
+static uint32_t checksum (uint32_t, const void *, size_t);
+
+/* Initializes the journal module. */
+void
+journal_init (void)
+{
+  lock_init (&handle_lock);
+  lock_register (&handle_lock, "journal");
+  cond_init (&no_handles);
+  work_init (&commit_work, commit_work_func, NULL);
+}
+
+/* Allocates the log, clears it of whatever the disk held
+   before, and writes the journal header.  Called by
+   do_format(). */
+void
+journal_create (void)
+{
+  static const uint8_t zeros[BLOCK_SECTOR_SIZE];
+  uint32_t i;
+
+  ASSERT (sizeof header == BLOCK_SECTOR_SIZE);
+  ASSERT (sizeof descriptor == BLOCK_SECTOR_SIZE);
+
+  memset (&header, 0, sizeof header);
+  header.magic = JOURNAL_MAGIC;
+  header.log_size = JOURNAL_LOG_SECTORS;
+  header.seq = 1;
+  if (!free_map_allocate (header.log_size, &header.log_start))
+    PANIC ("journal creation failed");
+  for (i = 0; i < header.log_size; i++)
+    block_write (fs_device, header.log_start + i, zeros);
+  block_write (fs_device, JOURNAL_SECTOR, &header);
+}
+
+/* Reads the journal header, if the disk has one, replays the
+   transactions committed since the last checkpoint, and starts
+   journaling.  Must be called before anything else reads the
+   file system. */
+void
+journal_open (void)
+{
+  block_read (fs_device, JOURNAL_SECTOR, &header);
+  if (header.magic != JOURNAL_MAGIC)
+    return;
+  replay ();
+  active = true;
+}
+
+/* Starts a handle.  Handles nest, and only a thread's outermost
+   one counts.  A commit that is waiting for handles to end does
+   not hold new ones back, so this may be called with file system
+   locks held. */
+void
+journal_begin (void)
+{
+  if (thread_current ()->journal_depth++ > 0)
+    return;
+  lock_acquire (&handle_lock);
+  handles++;
+  lock_release (&handle_lock);
+}
+
+/* Ends the handle started by the matching journal_begin(). */
+void
+journal_end (void)
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (t->journal_depth > 0);
+  if (--t->journal_depth > 0)
+    return;
+  lock_acquire (&handle_lock);
+  if (--handles == 0)
+    cond_broadcast (&no_handles, &handle_lock);
+  lock_release (&handle_lock);
+}
+
+/* Waits for every handle to end, then writes the changed parts
+   of the free map and commits the running transaction to the
+   log, so that the operations done so far survive a crash.
+   Returns false, doing nothing, if the disk has no journal.
+   Must not be called inside a handle. */
+bool
+journal_commit (void)
+{
+  struct thread *t = thread_current ();
+
+  if (!active)
+    return false;
+  ASSERT (t->journal_depth == 0);
+
+  lock_acquire (&handle_lock);
+  while (handles > 0)
+    cond_wait (&no_handles, &handle_lock);
+  t->journal_depth++;
+  free_map_flush ();
+  t->journal_depth--;
+  cache_commit ();
+  lock_release (&handle_lock);
+  return true;
+}
+
+/* Returns true if sectors written by the running thread now
+   belong to the running transaction. */
+bool
+journal_in_handle (void)
+{
+  return active && thread_current ()->journal_depth > 0;
+}
+
+/* Asks for the running transaction to be committed soon, from
+   another thread.  May be called with any lock held. */
+void
+journal_request_commit (void)
+{
+  work_queue (&system_wq, &commit_work);
+}
+
+/* Returns true if a transaction of CNT sectors fits in the log
+   without overwriting any transaction committed since the last
+   checkpoint. */
+bool
+journal_fits (size_t cnt)
+{
+  uint32_t need = cnt + 1;
+
+  ASSERT (cnt <= TXN_MAX_SECTORS);
+
+  if (!live)
+    return true;
+  if (header.tail < head)
+    return head + need <= header.log_size || need <= header.tail;
+  return head + need <= header.tail;
+}
+
+/* Commits a transaction of the CNT sectors whose home locations
+   are in SECTORS and whose contents are in DATA, in one write to
+   the log, and waits for it to complete.  The transaction must
+   fit, as reported by journal_fits(). */
+void
+journal_write (const block_sector_t *sectors, uint8_t *const *data,
+               size_t cnt)
+{
+  uint32_t sum = CHECKSUM_BASIS;
+  size_t i;
+
+  ASSERT (active);
+  ASSERT (cnt > 0 && journal_fits (cnt));
+
+  if (head + cnt + 1 > header.log_size)
+    head = 0;
+
+  memset (&descriptor, 0, sizeof descriptor);
+  descriptor.magic = TXN_MAGIC;
+  descriptor.seq = next_seq;
+  descriptor.cnt = cnt;
+  for (i = 0; i < cnt; i++)
+    {
+      descriptor.sectors[i] = sectors[i];
+      sum = checksum (sum, data[i], BLOCK_SECTOR_SIZE);
+    }
+  descriptor.checksum = sum;
+
+  /* The requests cover consecutive sectors, so the block layer
+     merges them into one transfer. */
+  for (i = 0; i <= cnt; i++)
+    {
+      struct block_request *r = &log_reqs[i];
+      r->sector = header.log_start + head + i;
+      r->cnt = 1;
+      r->buffer = i == 0 ? (void *) &descriptor : data[i - 1];
+      r->write = true;
+      r->prepaid = true;      /* charged by the cache, when dirtied */
+      block_submit (fs_device, r);
+    }
+  for (i = 0; i <= cnt; i++)
+    block_wait (&log_reqs[i]);
+
+  head += cnt + 1;
+  next_seq++;
+  live = true;
+}
+
+/* Records that every sector committed so far has reached its
+   home location, emptying the log. */
+void
+journal_checkpoint (void)
+{
+  if (!active || !live)
+    return;
+  header.tail = head;
+  header.seq = next_seq;
+  block_write (fs_device, JOURNAL_SECTOR, &header);
+  live = false;
+}
+
+/* Work function for COMMIT_WORK. */
+static void
+commit_work_func (void *aux UNUSED)
+{
+  journal_commit ();
+}
+
+/* Writes the sectors of each complete transaction after the
+   header's TAIL to their homes, then empties the log. */
+static void
+replay (void)
+{
+  static uint8_t buf[BLOCK_SECTOR_SIZE];
+  struct txn_descriptor d;
+  uint32_t pos = header.tail;
+  uint32_t seq = header.seq;
+  size_t txn_cnt = 0;
+
+  for (;;)
+    {
+      size_t i;
+
+      /* A transaction that did not fit before the end of the log
+         went at its start. */
+      if (!read_txn (pos, seq, &d))
+        {
+          if (pos == 0 || !read_txn (0, seq, &d))
+            break;
+          pos = 0;
+        }
+      for (i = 0; i < d.cnt; i++)
+        {
+          block_read (fs_device, header.log_start + pos + 1 + i, buf);
+          block_write (fs_device, d.sectors[i], buf);
+        }
+      pos += d.cnt + 1;
+      seq++;
+      txn_cnt++;
+    }
+
+  head = header.tail = pos;
+  next_seq = header.seq = seq;
+  live = false;
+  block_write (fs_device, JOURNAL_SECTOR, &header);
+  if (txn_cnt > 0)
+    printf ("journal: replayed %zu transactions\n", txn_cnt);
+}
+
+/* Reads into *D the descriptor of a transaction with sequence
+   number SEQ at log offset POS and returns true if all of it is
+   there, or returns false if there is none or it was only partly
+   written. */
+static bool
+read_txn (uint32_t pos, uint32_t seq, struct txn_descriptor *d)
+{
+  static uint8_t buf[BLOCK_SECTOR_SIZE];
+  uint32_t sum = CHECKSUM_BASIS;
+  size_t i;
+
+  if (pos + 2 > header.log_size)
+    return false;
+  block_read (fs_device, header.log_start + pos, d);
+  if (d->magic != TXN_MAGIC || d->seq != seq
+      || d->cnt == 0 || d->cnt > TXN_MAX_SECTORS
+      || pos + 1 + d->cnt > header.log_size)
+    return false;
+  for (i = 0; i < d->cnt; i++)
+    {
+      block_read (fs_device, header.log_start + pos + 1 + i, buf);
+      sum = checksum (sum, buf, BLOCK_SECTOR_SIZE);
+    }
+  return sum == d->checksum;
+}
+
+/* Returns the FNV-1a hash of the SIZE bytes at DATA, continuing
+   from SUM, which is CHECKSUM_BASIS for the first bytes. */
+static uint32_t
+checksum (uint32_t sum, const void *data, size_t size)
+{
+  const uint8_t *p = data;
+
+  while (size-- > 0)
+    sum = (sum ^ *p++) * 16777619u;
+  return sum;
+}
@@ -0,0 +1,26 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "devices/block.h"
+
+void journal_init (void);
+void journal_create (void);
+void journal_open (void);
+
+void journal_begin (void);
+void journal_end (void);
+bool journal_commit (void);
+
+/* For the buffer cache, which must hold its lock for the last
+   three. */
+bool journal_in_handle (void);
+void journal_request_commit (void);
+bool journal_fits (size_t cnt);
+void journal_write (const block_sector_t *, uint8_t *const *data,
+                    size_t cnt);
+void journal_checkpoint (void);
+
+#endif /* filesys/journal.h */
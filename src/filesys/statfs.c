@@ -0,0 +1,212 @@
+#include "filesys/statfs.h"
+#include <console.h>
+#include <debug.h>
+#include <string.h>
+#include "devices/block.h"
+#include "devices/timer.h"
+#include "filesys/cache.h"
+#include "filesys/directory.h"
+#include "filesys/filesys.h"
+#include "threads/interrupt.h"
+#include "threads/kmem.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/shrinker.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef USERPROG
+#include "userprog/exception.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "userprog/syscall.h"
+#endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#endif
+
+/* Statistics file system.
+
+   The root directory appears to hold a read-only directory,
+   STATFS_NAME, of text files that report what the kernel's
+   statistics are right now: the same lines print_stats() writes
+   out at power-off, one subsystem to a file, so that a running
+   program can read them with cat.
+
+   Nothing of this is on disk.  dir_lookup() asks
+   statfs_lookup() for a name the root directory does not hold,
+   which is how the directory is found without being listed in
+   the root (so that a copy of the whole file system, such as the
+   one tar makes, leaves it out).  Each file, and the directory
+   itself, is an inode with a sector number from
+   STATFS_DIR_SECTOR up, whose data inode_open() gets from
+   statfs_render() instead of from the disk.  The data is a
+   snapshot taken when the inode is first opened, made by running
+   the subsystem's print function with the console captured, and
+   it stays the same until the last opener closes it; opening the
+   file again then takes a new one.  Writes are denied. */
+
+/* Most bytes in one file. */
+#define STATFS_PAGES 4
+
+/* Functions whose output makes up a file. */
+typedef void print_func (void);
+
+static void print_sched (void);
+static void print_memory (void);
+static void print_io (void);
+#ifdef VM
+static void print_paging (void);
+#endif
+#ifdef USERPROG
+static void print_syscalls (void);
+#endif
+
+/* The files, whose sectors follow STATFS_DIR_SECTOR in this
+   order. */
+static const struct statfs_file
+  {
+    const char *name;
+    print_func *print;
+  }
+files[] =
+  {
+    {"sched", print_sched},
+    {"memory", print_memory},
+    {"io", print_io},
+    {"locks", lock_print_stats},
+#ifdef VM
+    {"paging", print_paging},
+#endif
+#ifdef USERPROG
+    {"syscalls", print_syscalls},
+#endif
+  };
+#define FILE_CNT (sizeof files / sizeof *files)
+
+/* Allows one thread at a time to capture the console. */
+static struct lock statfs_lock;
+
+/* Initializes the statistics file system. */
+void
+statfs_init (void)
+{
+  lock_init (&statfs_lock);
+  lock_register (&statfs_lock, "statfs");
+}
+
+/* Returns the sector of the inode that NAME in the directory
+   whose inode is in sector DIR stands for, if it is a statistics
+   directory that DIR does not hold itself, or 0 if none. */
+block_sector_t
+statfs_lookup (block_sector_t dir, const char *name)
+{
+  return (dir == ROOT_DIR_SECTOR && !strcmp (name, STATFS_NAME)
+          ? STATFS_DIR_SECTOR : 0);
+}
+
+/* Returns true if SECTOR is one of the statistics file system's
+   inodes, which must not be read from or written to disk. */
+bool
+statfs_owns (block_sector_t sector)
+{
+  return sector >= STATFS_DIR_SECTOR
+         && sector - STATFS_DIR_SECTOR <= FILE_CNT;
+}
+
+/* Makes the data of the inode in SECTOR, which statfs_owns():
+   for the directory, its entries, and for a file, its text.
+   Stores its size into *LENGTH and whether it is a directory
+   into *ISDIR, and returns it, for statfs_release() to free.
+   Returns a null pointer if memory is short. */
+void *
+statfs_render (block_sector_t sector, off_t *length, bool *isdir)
+{
+  size_t idx = sector - STATFS_DIR_SECTOR;
+  char *buf;
+
+  ASSERT (statfs_owns (sector));
+
+  buf = palloc_get_multiple (0, STATFS_PAGES);
+  if (buf == NULL)
+    return NULL;
+
+  *isdir = idx == 0;
+  if (*isdir)
+    {
+      size_t i;
+
+      *length = 0;
+      for (i = 0; i < FILE_CNT; i++)
+        *length += dir_format_entry (buf + *length, files[i].name,
+                                     STATFS_DIR_SECTOR + 1 + i);
+    }
+  else
+    {
+      lock_acquire (&statfs_lock);
+      console_capture (buf, STATFS_PAGES * PGSIZE);
+      files[idx - 1].print ();
+      *length = console_capture_end ();
+      lock_release (&statfs_lock);
+    }
+  return buf;
+}
+
+/* Frees DATA, returned by statfs_render(). */
+void
+statfs_release (void *data)
+{
+  palloc_free_multiple (data, STATFS_PAGES);
+}
+
+/* "sched": the timer, interrupts, and threads. */
+static void
+print_sched (void)
+{
+  timer_print_stats ();
+  intr_print_stats ();
+  thread_print_stats ();
+}
+
+/* "memory": the kernel's allocators. */
+static void
+print_memory (void)
+{
+  kmem_print_stats ();
+  shrinker_print_stats ();
+  malloc_print_stats ();
+  palloc_print_stats ();
+}
+
+/* "io": the block layer and the buffer cache. */
+static void
+print_io (void)
+{
+  block_print_stats ();
+  cache_print_stats ();
+}
+
+#ifdef VM
+/* "paging": pages, frames, and swap. */
+static void
+print_paging (void)
+{
+  page_print_stats ();
+  frame_print_stats ();
+  swap_print_stats ();
+  pagedir_print_stats ();
+}
+#endif
+
+#ifdef USERPROG
+/* "syscalls": exceptions, system calls, and processes. */
+static void
+print_syscalls (void)
+{
+  exception_print_stats ();
+  syscall_print_stats ();
+  process_print_stats ();
+}
+#endif
@@ -0,0 +1,22 @@
+#ifndef FILESYS_STATFS_H
+#define FILESYS_STATFS_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+#include "filesys/off_t.h"
+
+/* Name of the statistics directory in the root directory. */
+#define STATFS_NAME "stats"
+
+/* Sector numbers of the statistics directory and, following it,
+   its files.  They lie far past the end of any disk Pintos can
+   use, so they never name a real inode. */
+#define STATFS_DIR_SECTOR 0xffff0000
+
+void statfs_init (void);
+block_sector_t statfs_lookup (block_sector_t dir, const char *name);
+bool statfs_owns (block_sector_t);
+void *statfs_render (block_sector_t, off_t *length, bool *isdir);
+void statfs_release (void *);
+
+#endif /* filesys/statfs.h */
@@ -0,0 +1,34 @@
+#ifndef __LIB_AIO_H
+#define __LIB_AIO_H
+
+/* Asynchronous file I/O.
+
+   aio_read() and aio_write() queue a transfer of up to
+   AIO_MAX_LENGTH bytes at a given offset in a file and return at
+   once.  Each finished transfer posts a struct io_cqe, with the
+   tag from its control block and the number of bytes moved or -1,
+   that aio_reap() hands back.  A read's data lands in its buffer
+   only when it is reaped, so the buffer must stay valid until
+   then.  A write's data is copied when it is queued.
+
+   A process may have at most AIO_MAX_REQUESTS transfers queued or
+   waiting to be reaped. */
+
+/* Most bytes one transfer may move. */
+#define AIO_MAX_LENGTH 4096
+
+/* Most transfers a process may have outstanding. */
+#define AIO_MAX_REQUESTS 16
+
+/* An asynchronous transfer, as passed to aio_read() and
+   aio_write(). */
+struct aiocb
+  {
+    int fd;                     /* File to read or write. */
+    void *buffer;               /* Data. */
+    unsigned length;            /* Bytes to move. */
+    unsigned offset;            /* Byte offset in the file. */
+    unsigned tag;               /* Copied into the completion. */
+  };
+
+#endif /* lib/aio.h */
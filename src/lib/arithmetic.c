@@ -1,3 +1,4 @@
+#include <stddef.h>
 #include <stdint.h>
 
 /* On x86, division of one 64-bit integer by another cannot be
@@ -19,63 +20,41 @@
    much less mysterious. */
 
 /* Uses x86 DIVL instruction to divide 64-bit N by 32-bit D to
-   yield a 32-bit quotient.  Returns the quotient.
+   yield a 32-bit quotient.  Returns the quotient and stores the
+   remainder in *R.
    Traps with a divide error (#DE) if the quotient does not fit
    in 32 bits. */
 static inline uint32_t
-divl (uint64_t n, uint32_t d)
+divl (uint64_t n, uint32_t d, uint32_t *r)
 {
   uint32_t n1 = n >> 32;
   uint32_t n0 = n;
-  uint32_t q, r;
+  uint32_t q;
 
   asm ("divl %4"
-       : "=d" (r), "=a" (q)
+       : "=d" (*r), "=a" (q)
        : "0" (n1), "1" (n0), "rm" (d));
 
   return q;
 }
 
 /* Returns the number of leading zero bits in X,
-   which must be nonzero. */
-static int
+   which must be nonzero.  GCC turns this into a BSR. */
+static inline int
 nlz (uint32_t x) 
 {
-  /* This technique is portable, but there are better ways to do
-     it on particular systems.  With sufficiently new enough GCC,
-     you can use __builtin_clz() to take advantage of GCC's
-     knowledge of how to do it.  Or you can use the x86 BSR
-     instruction directly. */
-  int n = 0;
-  if (x <= 0x0000FFFF)
-    {
-      n += 16;
-      x <<= 16; 
-    }
-  if (x <= 0x00FFFFFF)
-    {
-      n += 8;
-      x <<= 8; 
-    }
-  if (x <= 0x0FFFFFFF)
-    {
-      n += 4;
-      x <<= 4;
-    }
-  if (x <= 0x3FFFFFFF)
-    {
-      n += 2;
-      x <<= 2; 
-    }
-  if (x <= 0x7FFFFFFF)
-    n++;
-  return n;
+  return __builtin_clz (x);
 }
 
-/* Divides unsigned 64-bit N by unsigned 64-bit D and returns the
-   quotient. */
+/* Divides unsigned 64-bit N by unsigned 64-bit D.  Returns the
+   quotient and stores the remainder in *R.
+
+   Divisors that fit in 32 bits, which is nearly all of them in
+   Pintos (tick rates, sector and page sizes, fixed-point
+   operands), take one or two DIVLs and get the remainder from
+   the last of them for free. */
 static uint64_t
-udiv64 (uint64_t n, uint64_t d)
+udivmod64 (uint64_t n, uint64_t d, uint64_t *r)
 {
   if ((d >> 32) == 0) 
     {
@@ -102,36 +81,64 @@ udiv64 (uint64_t n, uint64_t d)
              <=> [b - 1/d] < b
          which is a tautology.
 
-         Therefore, this code is correct and will not trap. */
+         Therefore, this code is correct and will not trap.  When
+         n1 < d, [n1/d] is 0 and n1 % d is n1, so the first
+         division can be skipped. */
       uint64_t b = 1ULL << 32;
       uint32_t n1 = n >> 32;
       uint32_t n0 = n; 
       uint32_t d0 = d;
+      uint32_t q1 = 0, q0, r0;
 
-      return divl (b * (n1 % d0) + n0, d0) + b * (n1 / d0); 
+      if (n1 >= d0)
+        {
+          q1 = n1 / d0;
+          n1 %= d0;
+        }
+      q0 = divl (b * n1 + n0, d0, &r0);
+      *r = r0;
+      return b * q1 + q0; 
     }
   else 
     {
       /* Based on the algorithm and proof available from
          http://www.hackersdelight.org/revisions.pdf. */
       if (n < d)
-        return 0;
+        {
+          *r = n;
+          return 0;
+        }
       else 
         {
           uint32_t d1 = d >> 32;
           int s = nlz (d1);
-          uint64_t q = divl (n >> 1, (d << s) >> 32) >> (31 - s);
-          return n - (q - 1) * d < d ? q - 1 : q; 
+          uint32_t unused;
+          uint64_t q = divl (n >> 1, (d << s) >> 32, &unused) >> (31 - s);
+          if (n - (q - 1) * d < d)
+            q--;
+          *r = n - q * d;
+          return q; 
         }
     }
 }
 
+/* Divides unsigned 64-bit N by unsigned 64-bit D and returns the
+   quotient. */
+static uint64_t
+udiv64 (uint64_t n, uint64_t d)
+{
+  uint64_t r;
+  return udivmod64 (n, d, &r);
+}
+
 /* Divides unsigned 64-bit N by unsigned 64-bit D and returns the
    remainder. */
-static uint32_t
+static uint64_t
 umod64 (uint64_t n, uint64_t d)
 {
-  return n - d * udiv64 (n, d);
+  uint64_t r;
+  udivmod64 (n, d, &r);
+  return r;
 }
 
 /* Divides signed 64-bit N by signed 64-bit D and returns the
@@ -146,19 +153,25 @@ sdiv64 (int64_t n, int64_t d)
 }
 
 /* Divides signed 64-bit N by signed 64-bit D and returns the
-   remainder. */
-static int32_t
+   remainder, which takes the sign of N. */
+static int64_t
 smod64 (int64_t n, int64_t d)
 {
-  return n - d * sdiv64 (n, d);
+  uint64_t n_abs = n >= 0 ? (uint64_t) n : -(uint64_t) n;
+  uint64_t d_abs = d >= 0 ? (uint64_t) d : -(uint64_t) d;
+  uint64_t r_abs = umod64 (n_abs, d_abs);
+  return n >= 0 ? (int64_t) r_abs : -(int64_t) r_abs;
 }
-
+
 /* These are the routines that GCC calls. */
 
 long long __divdi3 (long long n, long long d);
 long long __moddi3 (long long n, long long d);
 unsigned long long __udivdi3 (unsigned long long n, unsigned long long d);
 unsigned long long __umoddi3 (unsigned long long n, unsigned long long d);
+long long __divmoddi4 (long long n, long long d, long long *r);
+unsigned long long __udivmoddi4 (unsigned long long n, unsigned long long d,
+                                 unsigned long long *r);
 
 /* Signed 64-bit division. */
 long long
@@ -187,3 +200,26 @@ __umoddi3 (unsigned long long n, unsigned long long d)
 {
   return umod64 (n, d);
 }
+
+/* Signed 64-bit division and remainder together, which GCC calls
+   at higher optimization levels.  Stores the remainder in *R if R
+   is nonnull. */
+long long
+__divmoddi4 (long long n, long long d, long long *r)
+{
+  long long q = sdiv64 (n, d);
+  if (r != NULL)
+    *r = n - q * d;
+  return q;
+}
+
+/* Unsigned 64-bit division and remainder together, likewise. */
+unsigned long long
+__udivmoddi4 (unsigned long long n, unsigned long long d,
+              unsigned long long *r)
+{
+  unsigned long long q = udiv64 (n, d);
+  if (r != NULL)
+    *r = n - q * d;
+  return q;
+}
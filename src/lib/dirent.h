@@ -0,0 +1,20 @@
+#ifndef __LIB_DIRENT_H
+#define __LIB_DIRENT_H
+
+#include <stdbool.h>
+
+/* Maximum characters in a name in a struct dirent, the same as
+   READDIR_MAX_LEN. */
+#define DIRENT_NAME_MAX 14
+
+/* A directory entry with its file's details, as returned by the
+   getdents() system call. */
+struct dirent
+  {
+    int inumber;                /* Inode number. */
+    unsigned length;            /* Size of the file in bytes. */
+    bool is_dir;                /* Is it a directory? */
+    char name[DIRENT_NAME_MAX + 1]; /* Null terminated file name. */
+  };
+
+#endif /* lib/dirent.h */
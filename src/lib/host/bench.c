@@ -0,0 +1,360 @@
+/* Micro-benchmarks of the lib/kernel containers, run on the
+   host.  Each test times N operations of one kind, checks that
+   they gave the right answers, and prints the average time per
+   operation, so that a change to a container can be measured,
+   and its correctness checked, without booting Pintos.  Where the
+   kernel has two structures for the same job, or the C library
+   has another implementation, both are timed.
+
+   Usage: bench [N], where N defaults to 100000. */
+
+#include <debug.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "kernel/bitmap.h"
+#include "kernel/hash.h"
+#include "kernel/heap.h"
+#include "kernel/list.h"
+#include "kernel/rbtree.h"
+
+/* An element that can be in every kind of container at once. */
+struct elem
+  {
+    int key;
+    struct list_elem list_elem;
+    struct hash_elem hash_elem;
+    struct ohash_elem ohash_elem;
+    struct heap_elem heap_elem;
+    struct rb_elem rb_elem;
+  };
+
+static struct elem *elems;
+static int *keys;
+static size_t n;
+
+/* Time at which the running test started. */
+static struct timespec start_time;
+
+/* Starts timing a test. */
+static void
+start (void)
+{
+  clock_gettime (CLOCK_MONOTONIC, &start_time);
+}
+
+/* Stops timing the test started by start(), which did OPS
+   operations, and prints its NAME and time per operation. */
+static void
+stop (const char *name, size_t ops)
+{
+  struct timespec end;
+  double ns;
+
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  ns = ((end.tv_sec - start_time.tv_sec) * 1e9
+        + (end.tv_nsec - start_time.tv_nsec));
+  printf ("%-28s %10.1f ns/op\n", name, ns / ops);
+}
+
+/* Fills KEYS with a random permutation of 0...N-1 and sets each
+   element's key from it. */
+static void
+shuffle (void)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    keys[i] = i;
+  for (i = n - 1; i > 0; i--)
+    {
+      size_t j = rand () % (i + 1);
+      int t = keys[i];
+      keys[i] = keys[j];
+      keys[j] = t;
+    }
+  for (i = 0; i < n; i++)
+    elems[i].key = keys[i];
+}
+
+static bool
+list_less (const struct list_elem *a, const struct list_elem *b,
+           void *aux UNUSED)
+{
+  return (list_entry (a, struct elem, list_elem)->key
+          < list_entry (b, struct elem, list_elem)->key);
+}
+
+static void
+bench_list (void)
+{
+  struct list list;
+  size_t i;
+
+  list_init (&list);
+  start ();
+  for (i = 0; i < n; i++)
+    list_push_back (&list, &elems[i].list_elem);
+  stop ("list_push_back", n);
+
+  start ();
+  list_sort (&list, list_less, NULL);
+  stop ("list_sort (per element)", n);
+
+  start ();
+  for (i = 0; i < n; i++)
+    {
+      struct list_elem *e = list_pop_front (&list);
+      ASSERT (list_entry (e, struct elem, list_elem)->key == (int) i);
+    }
+  stop ("list_pop_front", n);
+}
+
+static unsigned
+elem_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct elem, hash_elem)->key);
+}
+
+static bool
+elem_hash_less (const struct hash_elem *a, const struct hash_elem *b,
+                void *aux UNUSED)
+{
+  return (hash_entry (a, struct elem, hash_elem)->key
+          < hash_entry (b, struct elem, hash_elem)->key);
+}
+
+static void
+bench_hash (void)
+{
+  struct hash hash;
+  struct elem key;
+  size_t i;
+
+  if (!hash_init (&hash, elem_hash, elem_hash_less, NULL))
+    PANIC ("out of memory");
+  start ();
+  for (i = 0; i < n; i++)
+    hash_insert (&hash, &elems[i].hash_elem);
+  stop ("hash_insert", n);
+
+  start ();
+  for (i = 0; i < n; i++)
+    {
+      key.key = i;
+      ASSERT (hash_find (&hash, &key.hash_elem) != NULL);
+    }
+  stop ("hash_find", n);
+
+  start ();
+  for (i = 0; i < n; i++)
+    {
+      key.key = keys[i];
+      ASSERT (hash_delete (&hash, &key.hash_elem) != NULL);
+    }
+  stop ("hash_delete", n);
+  hash_destroy (&hash, NULL);
+}
+
+static unsigned
+elem_ohash (const struct ohash_elem *e, void *aux UNUSED)
+{
+  return hash_int (ohash_entry (e, struct elem, ohash_elem)->key);
+}
+
+static bool
+elem_ohash_equal (const struct ohash_elem *a, const struct ohash_elem *b,
+                  void *aux UNUSED)
+{
+  return (ohash_entry (a, struct elem, ohash_elem)->key
+          == ohash_entry (b, struct elem, ohash_elem)->key);
+}
+
+static void
+bench_ohash (void)
+{
+  struct ohash hash;
+  struct elem key;
+  size_t i;
+
+  ohash_init (&hash, elem_ohash, elem_ohash_equal, NULL);
+  start ();
+  for (i = 0; i < n; i++)
+    ohash_insert (&hash, &elems[i].ohash_elem);
+  stop ("ohash_insert", n);
+
+  start ();
+  for (i = 0; i < n; i++)
+    {
+      key.key = i;
+      ASSERT (ohash_find (&hash, &key.ohash_elem) != NULL);
+    }
+  stop ("ohash_find", n);
+
+  start ();
+  for (i = 0; i < n; i++)
+    {
+      key.key = keys[i];
+      ASSERT (ohash_delete (&hash, &key.ohash_elem) != NULL);
+    }
+  stop ("ohash_delete", n);
+  ohash_destroy (&hash, NULL);
+}
+
+/* The heap's top is its greatest element, so this orders keys
+   backward to make it a min-heap like the tree below. */
+static bool
+heap_less (const struct heap_elem *a, const struct heap_elem *b,
+           void *aux UNUSED)
+{
+  return (heap_entry (a, struct elem, heap_elem)->key
+          > heap_entry (b, struct elem, heap_elem)->key);
+}
+
+static void
+bench_heap (void)
+{
+  struct heap heap;
+  size_t i;
+
+  heap_init (&heap, heap_less, NULL);
+  start ();
+  for (i = 0; i < n; i++)
+    heap_push (&heap, &elems[i].heap_elem);
+  stop ("heap_push", n);
+
+  start ();
+  for (i = 0; i < n; i++)
+    {
+      struct heap_elem *e = heap_pop (&heap);
+      ASSERT (heap_entry (e, struct elem, heap_elem)->key == (int) i);
+    }
+  stop ("heap_pop", n);
+}
+
+static bool
+rb_less (const struct rb_elem *a, const struct rb_elem *b,
+         void *aux UNUSED)
+{
+  return (rb_entry (a, struct elem, rb_elem)->key
+          < rb_entry (b, struct elem, rb_elem)->key);
+}
+
+static void
+bench_rbtree (void)
+{
+  struct rbtree tree;
+  struct elem key;
+  size_t i;
+
+  rb_init (&tree, rb_less, NULL);
+  start ();
+  for (i = 0; i < n; i++)
+    rb_insert (&tree, &elems[i].rb_elem);
+  stop ("rb_insert", n);
+
+  start ();
+  for (i = 0; i < n; i++)
+    {
+      key.key = i;
+      ASSERT (rb_find (&tree, &key.rb_elem) != NULL);
+    }
+  stop ("rb_find", n);
+
+  start ();
+  for (i = 0; i < n; i++)
+    {
+      struct rb_elem *e = rb_first (&tree);
+      ASSERT (rb_entry (e, struct elem, rb_elem)->key == (int) i);
+      rb_remove (&tree, e);
+    }
+  stop ("rb_first + rb_remove", n);
+}
+
+static void
+bench_bitmap (void)
+{
+  struct bitmap *b = bitmap_create (n);
+  size_t i;
+
+  if (b == NULL)
+    PANIC ("out of memory");
+  start ();
+  for (i = 0; i < n; i++)
+    ASSERT (bitmap_scan_and_flip (b, 0, 1, false) == i);
+  stop ("bitmap_scan_and_flip (1)", n);
+
+  bitmap_set_all (b, false);
+  start ();
+  for (i = 0; i + 8 <= n; i += 8)
+    ASSERT (bitmap_scan_and_flip (b, 0, 8, false) == i);
+  stop ("bitmap_scan_and_flip (8)", n / 8);
+
+  start ();
+  for (i = 0; i < n; i++)
+    bitmap_flip (b, keys[i]);
+  stop ("bitmap_flip", n);
+
+  start ();
+  for (i = 0; i < 100; i++)
+    ASSERT (bitmap_count (b, 0, n, true) == n % 8);
+  stop ("bitmap_count (per bit)", 100 * n);
+  bitmap_destroy (b);
+}
+
+static int
+compare_ints (const void *a_, const void *b_)
+{
+  const int *a = a_, *b = b_;
+  return *a < *b ? -1 : *a > *b;
+}
+
+static int
+compare_ints_aux (const void *a, const void *b, void *aux UNUSED)
+{
+  return compare_ints (a, b);
+}
+
+static void
+bench_sort (void)
+{
+  size_t i;
+
+  shuffle ();
+  start ();
+  sort (keys, n, sizeof *keys, compare_ints_aux, NULL);
+  stop ("sort (per element)", n);
+  for (i = 0; i < n; i++)
+    ASSERT (keys[i] == (int) i);
+
+  shuffle ();
+  start ();
+  qsort (keys, n, sizeof *keys, compare_ints);
+  stop ("libc qsort (per element)", n);
+}
+
+int
+main (int argc, char *argv[])
+{
+  n = argc > 1 ? strtoul (argv[1], NULL, 10) : 100000;
+  if (n == 0)
+    {
+      fprintf (stderr, "usage: %s [N]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  elems = malloc (n * sizeof *elems);
+  keys = malloc (n * sizeof *keys);
+  if (elems == NULL || keys == NULL)
+    PANIC ("out of memory");
+
+  srand (1);
+  shuffle ();
+  bench_list ();
+  bench_hash ();
+  bench_ohash ();
+  bench_heap ();
+  bench_rbtree ();
+  bench_bitmap ();
+  bench_sort ();
+  return EXIT_SUCCESS;
+}
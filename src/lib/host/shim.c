@@ -0,0 +1,53 @@
+/* What the kernel provides to lib/kernel and lib/stdlib.c, for
+   running them as part of a host program. */
+
+#include <ctype.h>
+#include <debug.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Prints the message and location of a failed assertion or
+   panic, and aborts, which leaves a core for a debugger. */
+void
+debug_panic (const char *file, int line, const char *function,
+             const char *message, ...)
+{
+  va_list args;
+
+  fprintf (stderr, "PANIC at %s:%d in %s(): ", file, line, function);
+  va_start (args, message);
+  vfprintf (stderr, message, args);
+  va_end (args);
+  fputc ('\n', stderr);
+  abort ();
+}
+
+/* Dumps the SIZE bytes in BUF to stdout, 16 to a line, each line
+   labeled with its offset starting from OFS, and with the bytes
+   as characters too if ASCII is true.  Simpler than the kernel's
+   version, which aligns the first line on a multiple of 16. */
+void
+hex_dump (uintptr_t ofs, const void *buf_, size_t size, bool ascii)
+{
+  const unsigned char *buf = buf_;
+  size_t i, j;
+
+  for (i = 0; i < size; i += 16)
+    {
+      printf ("%08jx ", (uintmax_t) (ofs + i));
+      for (j = i; j < i + 16; j++)
+        if (j < size)
+          printf (" %02x", buf[j]);
+        else
+          printf ("   ");
+      if (ascii)
+        {
+          printf (" |");
+          for (j = i; j < i + 16 && j < size; j++)
+            putchar (isprint (buf[j]) ? buf[j] : '.');
+          putchar ('|');
+        }
+      putchar ('\n');
+    }
+}
@@ -0,0 +1,12 @@
+#ifndef HOST_STDIO_H
+#define HOST_STDIO_H
+
+/* The host's <stdio.h>, plus what lib/stdio.c adds to it. */
+#include_next <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+void hex_dump (uintptr_t ofs, const void *, size_t size, bool ascii);
+
+#endif /* lib/host/shim/stdio.h */
@@ -0,0 +1,15 @@
+#ifndef HOST_STDLIB_H
+#define HOST_STDLIB_H
+
+/* The host's <stdlib.h>, plus what lib/stdlib.c adds to it. */
+#include_next <stdlib.h>
+
+void sort (void *array, size_t cnt, size_t size,
+           int (*compare) (const void *, const void *, void *aux),
+           void *aux);
+void *binary_search (const void *key, const void *array, size_t cnt,
+                     size_t size,
+                     int (*compare) (const void *, const void *, void *aux),
+                     void *aux);
+
+#endif /* lib/host/shim/stdlib.h */
@@ -0,0 +1,8 @@
+#ifndef HOST_THREADS_MALLOC_H
+#define HOST_THREADS_MALLOC_H
+
+/* The kernel's malloc() and free() have the C library's
+   interface. */
+#include <stdlib.h>
+
+#endif /* lib/host/shim/threads/malloc.h */
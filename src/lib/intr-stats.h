@@ -0,0 +1,25 @@
+#ifndef __LIB_INTR_STATS_H
+#define __LIB_INTR_STATS_H
+
+#include <stdint.h>
+
+/* Number of interrupt vectors. */
+#define INTR_STATS_VECS 256
+
+/* Number of call sites at which the kernel, started with the
+   "-intrprof" option, keeps track of time spent with interrupts
+   turned off. */
+#define INTR_STATS_SITES 64
+
+/* Statistics for one interrupt vector, or for one call site that
+   turned interrupts off, as kept by the kernel and returned by
+   the intrstats() system call. */
+struct intr_stats
+  {
+    uintptr_t site;             /* Call site, or 0 for a vector. */
+    uint64_t cnt;               /* Number of handler runs or windows. */
+    uint64_t cycles;            /* CPU cycles spent in them. */
+    uint64_t max_cycles;        /* Longest one, in CPU cycles. */
+  };
+
+#endif /* lib/intr-stats.h */
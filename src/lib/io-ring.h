@@ -0,0 +1,47 @@
+#ifndef __LIB_IO_RING_H
+#define __LIB_IO_RING_H
+
+/* A submission/completion ring shared by a user process and the
+   kernel, for making many system calls with one kernel entry.
+
+   The process fills in SQ[SQ_TAIL % IO_RING_SIZE] and advances
+   SQ_TAIL for each call it queues, then calls ring_enter().  The
+   kernel makes each queued call in order, advancing SQ_HEAD, and
+   posts its result at CQ[CQ_TAIL % IO_RING_SIZE], advancing
+   CQ_TAIL.  The process consumes results by advancing CQ_HEAD.
+   The kernel stops early if the completion queue fills up.
+
+   Only the calls that do not change the process itself may be
+   queued: read, write, seek, tell, filesize, pread, pwrite,
+   copy_file_range and fsync.  Any other call completes with result -1. */
+
+/* Number of entries in each queue. */
+#define IO_RING_SIZE 32
+
+/* A queued system call. */
+struct io_sqe
+  {
+    int nr;                     /* System call number, SYS_*. */
+    int args[4];                /* Its arguments. */
+    unsigned tag;               /* Copied into the completion. */
+  };
+
+/* The result of a queued system call. */
+struct io_cqe
+  {
+    unsigned tag;               /* From the submission. */
+    int result;                 /* The call's return value. */
+  };
+
+/* The ring.  Zero it before registering it with ring_setup(). */
+struct io_ring
+  {
+    unsigned sq_head;           /* Next submission; kernel writes. */
+    unsigned sq_tail;           /* End of submissions; user writes. */
+    unsigned cq_head;           /* Next completion; user writes. */
+    unsigned cq_tail;           /* End of completions; kernel writes. */
+    struct io_sqe sq[IO_RING_SIZE];
+    struct io_cqe cq[IO_RING_SIZE];
+  };
+
+#endif /* lib/io-ring.h */
@@ -0,0 +1,15 @@
+#ifndef __LIB_IO_STATS_H
+#define __LIB_IO_STATS_H
+
+#include <stdint.h>
+
+/* Block device statistics for the file system device, as
+   returned by the iostats() system call.  Counts are since
+   boot. */
+struct io_stats
+  {
+    uint64_t read_cnt;          /* Sectors read. */
+    uint64_t write_cnt;         /* Sectors written. */
+  };
+
+#endif /* lib/io-stats.h */
@@ -69,6 +69,60 @@ last_mask (const struct bitmap *b)
   return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
 
+/* Returns a mask of the bits of an element that stand for
+   bitmap bits START through END, exclusive, which must both lie
+   in the same element, END possibly at its very end. */
+static inline elem_type
+range_mask (size_t start, size_t end)
+{
+  size_t lo = start % ELEM_BITS;
+  size_t hi = end - (start - lo);
+  elem_type mask = (elem_type) -1 << lo;
+
+  ASSERT (lo < hi && hi <= ELEM_BITS);
+  if (hi < ELEM_BITS)
+    mask &= ((elem_type) 1 << hi) - 1;
+  return mask;
+}
+
+/* Returns the number of 1-bits in E. */
+static inline size_t
+pop_count (elem_type e)
+{
+  size_t cnt = 0;
+
+  for (; e != 0; e &= e - 1)
+    cnt++;
+  return cnt;
+}
+
+/* Returns the index of the first bit in B between START and
+   END, exclusive, that is set to VALUE, or END if there is none.
+   Looks at a whole element at a time, with a find-first-set
+   instruction for an element that has such a bit. */
+static size_t
+next_bit (const struct bitmap *b, size_t start, size_t end, bool value)
+{
+  size_t idx;
+
+  ASSERT (start <= end && end <= b->bit_cnt);
+  if (start == end)
+    return end;
+
+  for (idx = elem_idx (start); idx * ELEM_BITS < end; idx++)
+    {
+      elem_type e = value ? b->bits[idx] : ~b->bits[idx];
+      if (idx == elem_idx (start))
+        e &= (elem_type) -1 << (start % ELEM_BITS);
+      if (e != 0)
+        {
+          size_t bit = idx * ELEM_BITS + __builtin_ctzl (e);
+          return bit < end ? bit : end;
+        }
+    }
+  return end;
+}
+
 /* Creation and destruction. */
 
 /* Creates and returns a pointer to a newly allocated bitmap with room for
@@ -162,7 +216,7 @@ bitmap_mark (struct bitmap *b, size_t bit_idx)
   /* This is equivalent to `b->bits[idx] |= mask' except that it
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the OR instruction in [IA32-v2b]. */
-  asm ("orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  asm ("or %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
 }
 
 /* Atomically sets the bit numbered BIT_IDX in B to false. */
@@ -175,7 +229,7 @@ bitmap_reset (struct bitmap *b, size_t bit_idx)
   /* This is equivalent to `b->bits[idx] &= ~mask' except that it
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the AND instruction in [IA32-v2a]. */
-  asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+  asm ("and %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
 }
 
 /* Atomically toggles the bit numbered IDX in B;
@@ -190,7 +244,7 @@ bitmap_flip (struct bitmap *b, size_t bit_idx)
   /* This is equivalent to `b->bits[idx] ^= mask' except that it
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the XOR instruction in [IA32-v2b]. */
-  asm ("xorl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  asm ("xor %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
 }
 
 /* Returns the value of the bit numbered IDX in B. */
@@ -217,14 +271,27 @@ bitmap_set_all (struct bitmap *b, bool value)
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
+  size_t end = start + cnt;
+
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    bitmap_set (b, start + i, value);
+  /* A whole element at a time, each one atomically as in
+     bitmap_mark() and bitmap_reset(). */
+  while (start < end)
+    {
+      size_t idx = elem_idx (start);
+      size_t elem_end = (idx + 1) * ELEM_BITS;
+      size_t stop = end < elem_end ? end : elem_end;
+      elem_type mask = range_mask (start, stop);
+
+      if (value)
+        asm ("or %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+      else
+        asm ("and %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+      start = stop;
+    }
 }
 
 /* Returns the number of bits in B between START and START + CNT,
@@ -232,17 +299,24 @@ bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value)
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i, value_cnt;
+  size_t end = start + cnt;
+  size_t set_cnt = 0;
 
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  value_cnt = 0;
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      value_cnt++;
-  return value_cnt;
+  /* Count the 1s a whole element at a time. */
+  while (start < end)
+    {
+      size_t idx = elem_idx (start);
+      size_t elem_end = (idx + 1) * ELEM_BITS;
+      size_t stop = end < elem_end ? end : elem_end;
+
+      set_cnt += pop_count (b->bits[idx] & range_mask (start, stop));
+      start = stop;
+    }
+  return value ? set_cnt : cnt - set_cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -250,16 +324,11 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
-  return false;
+  return next_bit (b, start, start + cnt, value) < start + cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -301,14 +370,51 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
   if (cnt <= b->bit_cnt) 
     {
       size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
+      size_t i = start;
+
+      if (cnt == 0)
+        return i <= last ? i : BITMAP_ERROR;
+
+      /* Jump to the next bit set to VALUE, then to the first bit
+         after it that is not.  If that is CNT bits on, the group
+         is found; otherwise, no group can start before it. */
+      while (i <= last)
+        {
+          size_t end;
+
+          i = next_bit (b, i, last + 1, value);
+          if (i > last)
+            break;
+          end = next_bit (b, i, i + cnt, !value);
+          if (end == i + cnt)
+            return i;
+          i = end;
+        }
     }
   return BITMAP_ERROR;
 }
 
+/* Like bitmap_scan(), but for next-fit allocation: looks first
+   at or after HINT, typically where the previous group found
+   ended, and only then from the start of B, so that a run of
+   allocations does not rescan the part of B already in use.
+   HINT may be anything; past the end, it is taken as 0. */
+size_t
+bitmap_scan_from_hint (const struct bitmap *b, size_t hint, size_t cnt,
+                       bool value)
+{
+  size_t idx;
+
+  ASSERT (b != NULL);
+
+  if (hint > b->bit_cnt)
+    hint = 0;
+  idx = bitmap_scan (b, hint, cnt, value);
+  if (idx == BITMAP_ERROR && hint != 0)
+    idx = bitmap_scan (b, 0, cnt, value);
+  return idx;
+}
+
 /* Finds the first group of CNT consecutive bits in B at or after
    START that are all set to VALUE, flips them all to !VALUE,
    and returns the index of the first bit in the group.
@@ -358,6 +464,24 @@ bitmap_write (const struct bitmap *b, struct file *file)
   off_t size = byte_cnt (b->bit_cnt);
   return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Writes bytes OFS through OFS + SIZE - 1 of B's on-disk form to
+   the same place in FILE, leaving the rest of FILE alone.  Bytes
+   past the end of B are ignored.  Returns true if successful,
+   false otherwise. */
+bool
+bitmap_write_part (const struct bitmap *b, struct file *file,
+                   off_t ofs, off_t size)
+{
+  off_t total = byte_cnt (b->bit_cnt);
+
+  if (ofs >= total)
+    return true;
+  if (size > total - ofs)
+    size = total - ofs;
+  return file_write_at (file, (const uint8_t *) b->bits + ofs, size,
+                        ofs) == size;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
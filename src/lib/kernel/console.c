@@ -1,13 +1,26 @@
 #include <console.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/serial.h"
 #include "devices/vga.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Auxiliary data for vprintf_helper().  Output is gathered here
+   and handed on a buffer at a time, so that the serial layer sees
+   one call per line or so instead of one per character. */
+struct vprintf_aux
+  {
+    char buf[128];              /* Pending output. */
+    size_t len;                 /* Number of bytes in BUF. */
+    int char_cnt;               /* Total characters output. */
+  };
 
 static void vprintf_helper (char, void *);
+static void putbuf_have_lock (const char *, size_t);
 static void putchar_have_lock (uint8_t c);
 
 /* The console lock.
@@ -59,11 +72,22 @@ static int console_lock_depth;
 /* Number of characters written to console. */
 static int64_t write_cnt;
 
+/* While CAPTURE_THREAD is nonnull, what it prints goes into the
+   CAPTURE_SIZE bytes at CAPTURE_BUF instead of to the console;
+   CAPTURE_LEN bytes are there so far.  See console_capture(). */
+static struct thread *capture_thread;
+static char *capture_buf;
+static size_t capture_size;
+static size_t capture_len;
+
+static bool capture (const char *, size_t);
+
 /* Enable console locking. */
 void
 console_init (void) 
 {
   lock_init (&console_lock);
+  lock_register (&console_lock, "console");
   use_console_lock = true;
 }
 
@@ -74,6 +98,7 @@ void
 console_panic (void) 
 {
   use_console_lock = false;
+  vga_panic ();
 }
 
 /* Prints console statistics. */
@@ -83,6 +108,47 @@ console_print_stats (void)
   printf ("Console: %lld characters output\n", write_cnt);
 }
 
+/* Makes what the running thread prints from now on, up to the
+   matching console_capture_end(), go into the SIZE bytes at BUF
+   instead of to the console.  Output past SIZE bytes is dropped.
+   Output from other threads and from interrupt handlers still
+   goes to the console.  Only one thread may capture at a time. */
+void
+console_capture (char *buf, size_t size)
+{
+  ASSERT (capture_thread == NULL);
+  capture_buf = buf;
+  capture_size = size;
+  capture_len = 0;
+  capture_thread = thread_current ();
+}
+
+/* Ends the running thread's console_capture() and returns the
+   number of bytes captured. */
+size_t
+console_capture_end (void)
+{
+  ASSERT (capture_thread == thread_current ());
+  capture_thread = NULL;
+  return capture_len;
+}
+
+/* If the running thread is capturing its output, appends what
+   fits of the N bytes at BUFFER to the capture buffer and returns
+   true.  Otherwise returns false. */
+static bool
+capture (const char *buffer, size_t n)
+{
+  if (capture_thread == NULL || intr_context ()
+      || capture_thread != thread_current ())
+    return false;
+  if (n > capture_size - capture_len)
+    n = capture_size - capture_len;
+  memcpy (capture_buf + capture_len, buffer, n);
+  capture_len += n;
+  return true;
+}
+
 /* Acquires the console lock. */
 static void
 acquire_console (void) 
@@ -109,6 +175,7 @@ release_console (void)
     }
 }
 
+#ifndef NDEBUG
 /* Returns true if the current thread has the console lock,
    false otherwise. */
 static bool
@@ -118,6 +185,7 @@ console_locked_by_current_thread (void)
           || !use_console_lock
           || lock_held_by_current_thread (&console_lock));
 }
+#endif
 
 /* The standard vprintf() function,
    which is like printf() but uses a va_list.
@@ -125,13 +193,16 @@ console_locked_by_current_thread (void)
 int
 vprintf (const char *format, va_list args) 
 {
-  int char_cnt = 0;
+  struct vprintf_aux aux;
 
+  aux.len = 0;
+  aux.char_cnt = 0;
   acquire_console ();
-  __vprintf (format, args, vprintf_helper, &char_cnt);
+  __vprintf (format, args, vprintf_helper, &aux);
+  putbuf_have_lock (aux.buf, aux.len);
   release_console ();
 
-  return char_cnt;
+  return aux.char_cnt;
 }
 
 /* Writes string S to the console, followed by a new-line
@@ -140,21 +211,20 @@ int
 puts (const char *s) 
 {
   acquire_console ();
-  while (*s != '\0')
-    putchar_have_lock (*s++);
+  putbuf_have_lock (s, strlen (s));
   putchar_have_lock ('\n');
   release_console ();
 
   return 0;
 }
 
-/* Writes the N characters in BUFFER to the console. */
+/* Writes the N characters in BUFFER to the console, handing
+   them to the serial port all at once. */
 void
 putbuf (const char *buffer, size_t n) 
 {
   acquire_console ();
-  while (n-- > 0)
-    putchar_have_lock (*buffer++);
+  putbuf_have_lock (buffer, n);
   release_console ();
 }
 
@@ -171,11 +241,31 @@ putchar (int c)
 
 /* Helper function for vprintf(). */
 static void
-vprintf_helper (char c, void *char_cnt_) 
+vprintf_helper (char c, void *aux_) 
 {
-  int *char_cnt = char_cnt_;
-  (*char_cnt)++;
-  putchar_have_lock (c);
+  struct vprintf_aux *aux = aux_;
+
+  aux->char_cnt++;
+  aux->buf[aux->len++] = c;
+  if (aux->len == sizeof aux->buf)
+    {
+      putbuf_have_lock (aux->buf, aux->len);
+      aux->len = 0;
+    }
+}
+
+/* Writes the N characters in BUFFER to the vga display and
+   serial port.  The caller has already acquired the console lock
+   if appropriate. */
+static void
+putbuf_have_lock (const char *buffer, size_t n) 
+{
+  ASSERT (console_locked_by_current_thread ());
+  if (capture (buffer, n))
+    return;
+  write_cnt += n;
+  serial_putbuf ((const uint8_t *) buffer, n);
+  vga_putbuf (buffer, n);
 }
 
 /* Writes C to the vga display and serial port.
@@ -185,6 +275,8 @@ static void
 putchar_have_lock (uint8_t c) 
 {
   ASSERT (console_locked_by_current_thread ());
+  if (capture ((const char *) &c, 1))
+    return;
   write_cnt++;
   serial_putc (c);
   vga_putc (c);
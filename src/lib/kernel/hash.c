@@ -428,3 +428,308 @@ remove_elem (struct hash *h, struct hash_elem *e)
   list_remove (&e->list_elem);
 }
 
+
+/* Open-addressing hash table.  See the comment in hash.h. */
+
+/* Number of slots in the first array. */
+#define OHASH_MIN_SIZE 16
+
+/* Slots of the old array moved across by each insertion or
+   deletion while the table is growing.  Moving them at least
+   twice as fast as the new array can fill means the old array is
+   empty well before the new one needs to grow in turn. */
+#define OHASH_MOVE_STEP 8
+
+/* Marks a slot in the old array whose element has been moved
+   across or deleted.  Searches of the old array pass over it.
+   The new array never holds one. */
+#define OHASH_MOVED ((struct ohash_elem *) 1)
+
+static void table_insert (struct ohash_table *, struct ohash_elem *);
+static struct ohash_elem **table_find (struct ohash *, struct ohash_table *,
+                                       struct ohash_elem *);
+static void table_remove (struct ohash_table *, struct ohash_elem **);
+static bool ohash_grow (struct ohash *);
+static void ohash_move (struct ohash *, size_t cnt);
+
+/* Initializes open hash table H to compute hash values using HASH
+   and compare keys using EQUAL, given auxiliary data AUX.  No
+   memory is allocated until the first insertion. */
+void
+ohash_init (struct ohash *h, ohash_hash_func *hash, ohash_equal_func *equal,
+            void *aux)
+{
+  h->cur.slots = h->old.slots = NULL;
+  h->cur.size = h->old.size = 0;
+  h->cur.cnt = h->old.cnt = 0;
+  h->move_idx = 0;
+  h->hash = hash;
+  h->equal = equal;
+  h->aux = aux;
+}
+
+/* Destroys open hash table H, first calling DESTRUCTOR, if it is
+   nonnull, on each of its elements. */
+void
+ohash_destroy (struct ohash *h, ohash_action_func *destructor)
+{
+  if (destructor != NULL)
+    {
+      struct ohash_iterator i;
+      struct ohash_elem *e;
+
+      ohash_first (&i, h);
+      while ((e = ohash_next (&i)) != NULL)
+        destructor (e, h->aux);
+    }
+  free (h->old.slots);
+  free (h->cur.slots);
+  ohash_init (h, h->hash, h->equal, h->aux);
+}
+
+/* Inserts NEW into open hash table H and returns a null pointer,
+   if no equal element is already in the table.  If an equal
+   element is already in the table, returns it without inserting
+   NEW.  If the table is full and cannot grow because memory is
+   exhausted, returns NEW itself without inserting it. */
+struct ohash_elem *
+ohash_insert (struct ohash *h, struct ohash_elem *new)
+{
+  struct ohash_elem *old = ohash_find (h, new);
+  if (old != NULL)
+    return old;
+
+  /* Keep the load factor at or below 3/4. */
+  if ((h->cur.cnt + h->old.cnt + 1) * 4 > h->cur.size * 3
+      && !ohash_grow (h) && h->cur.cnt + h->old.cnt >= h->cur.size)
+    return new;
+
+  ohash_move (h, OHASH_MOVE_STEP);
+  table_insert (&h->cur, new);
+  return NULL;
+}
+
+/* Finds and returns an element equal to E in open hash table H,
+   or a null pointer if no equal element exists in the table. */
+struct ohash_elem *
+ohash_find (struct ohash *h, struct ohash_elem *e)
+{
+  struct ohash_elem **slot;
+
+  e->hash = h->hash (e, h->aux);
+  slot = table_find (h, &h->cur, e);
+  if (slot == NULL)
+    slot = table_find (h, &h->old, e);
+  return slot != NULL ? *slot : NULL;
+}
+
+/* Finds, removes, and returns an element equal to E in open hash
+   table H.  Returns a null pointer if no equal element existed
+   in the table. */
+struct ohash_elem *
+ohash_delete (struct ohash *h, struct ohash_elem *e)
+{
+  struct ohash_elem **slot, *found;
+
+  e->hash = h->hash (e, h->aux);
+  if ((slot = table_find (h, &h->cur, e)) != NULL)
+    {
+      found = *slot;
+      table_remove (&h->cur, slot);
+    }
+  else if ((slot = table_find (h, &h->old, e)) != NULL)
+    {
+      found = *slot;
+      *slot = OHASH_MOVED;
+      h->old.cnt--;
+    }
+  else
+    return NULL;
+
+  ohash_move (h, OHASH_MOVE_STEP);
+  return found;
+}
+
+/* Initializes I for iterating open hash table H, starting with
+   the element that ohash_next() returns first. */
+void
+ohash_first (struct ohash_iterator *i, struct ohash *h)
+{
+  i->hash = h;
+  i->table = &h->old;
+  i->idx = 0;
+}
+
+/* Returns the next element of the table I is iterating, or a
+   null pointer when there are no more.  Elements are returned in
+   no particular order. */
+struct ohash_elem *
+ohash_next (struct ohash_iterator *i)
+{
+  for (;;)
+    {
+      while (i->idx < i->table->size)
+        {
+          struct ohash_elem *e = i->table->slots[i->idx++];
+          if (e != NULL && e != OHASH_MOVED)
+            return e;
+        }
+      if (i->table == &i->hash->cur)
+        return NULL;
+      i->table = &i->hash->cur;
+      i->idx = 0;
+    }
+}
+
+/* Returns the number of elements in H. */
+size_t
+ohash_size (const struct ohash *h)
+{
+  return h->cur.cnt + h->old.cnt;
+}
+
+/* Returns true if H contains no elements, false otherwise. */
+bool
+ohash_empty (const struct ohash *h)
+{
+  return ohash_size (h) == 0;
+}
+
+/* Returns how far the element in slot IDX of T is from its home
+   slot. */
+static inline size_t
+probe_dist (const struct ohash_table *t, size_t idx)
+{
+  return (idx - (t->slots[idx]->hash & (t->size - 1))) & (t->size - 1);
+}
+
+/* Inserts E, whose hash value is set, into T, which must have a
+   free slot, in Robin Hood order: each element on E's probe
+   sequence that is closer to its home than E is so far gives up
+   its slot and continues the search in E's place. */
+static void
+table_insert (struct ohash_table *t, struct ohash_elem *e)
+{
+  size_t mask = t->size - 1;
+  size_t idx = e->hash & mask;
+  size_t dist = 0;
+
+  ASSERT (t->cnt < t->size);
+  for (;; idx = (idx + 1) & mask, dist++)
+    {
+      size_t other_dist;
+
+      if (t->slots[idx] == NULL)
+        {
+          t->slots[idx] = e;
+          t->cnt++;
+          return;
+        }
+      other_dist = probe_dist (t, idx);
+      if (other_dist < dist)
+        {
+          struct ohash_elem *other = t->slots[idx];
+          t->slots[idx] = e;
+          e = other;
+          dist = other_dist;
+        }
+    }
+}
+
+/* Returns the slot of T that holds an element equal to E, whose
+   hash value is set, or a null pointer if there is none. */
+static struct ohash_elem **
+table_find (struct ohash *h, struct ohash_table *t, struct ohash_elem *e)
+{
+  size_t mask = t->size - 1;
+  size_t idx, dist;
+
+  if (t->cnt == 0)
+    return NULL;
+  for (idx = e->hash & mask, dist = 0; dist < t->size;
+       idx = (idx + 1) & mask, dist++)
+    {
+      struct ohash_elem *other = t->slots[idx];
+
+      if (other == NULL)
+        break;
+      if (other == OHASH_MOVED)
+        continue;
+      if (probe_dist (t, idx) < dist)
+        break;
+      if (other->hash == e->hash && h->equal (other, e, h->aux))
+        return &t->slots[idx];
+    }
+  return NULL;
+}
+
+/* Removes the element in SLOT of T, shifting the elements after
+   it that are not in their home slot back by one, so that no
+   probe sequence is left with a gap. */
+static void
+table_remove (struct ohash_table *t, struct ohash_elem **slot)
+{
+  size_t mask = t->size - 1;
+  size_t idx = slot - t->slots;
+  size_t next = (idx + 1) & mask;
+
+  while (t->slots[next] != NULL && probe_dist (t, next) > 0)
+    {
+      t->slots[idx] = t->slots[next];
+      idx = next;
+      next = (next + 1) & mask;
+    }
+  t->slots[idx] = NULL;
+  t->cnt--;
+}
+
+/* Starts moving H's elements into a new array twice the size.
+   If the old array is still being emptied, finishes that first.
+   Returns false if memory is exhausted. */
+static bool
+ohash_grow (struct ohash *h)
+{
+  size_t size = h->cur.size ? h->cur.size * 2 : OHASH_MIN_SIZE;
+  struct ohash_elem **slots = calloc (size, sizeof *slots);
+
+  if (slots == NULL)
+    return false;
+
+  ohash_move (h, SIZE_MAX);
+  h->old = h->cur;
+  h->cur.slots = slots;
+  h->cur.size = size;
+  h->cur.cnt = 0;
+  h->move_idx = 0;
+  if (h->old.cnt == 0)
+    ohash_move (h, SIZE_MAX);
+  return true;
+}
+
+/* Moves up to CNT slots' worth of elements from H's old array to
+   its current one, freeing the old array once it is empty. */
+static void
+ohash_move (struct ohash *h, size_t cnt)
+{
+  if (h->old.slots == NULL)
+    return;
+
+  for (; cnt > 0 && h->move_idx < h->old.size && h->old.cnt > 0; cnt--)
+    {
+      struct ohash_elem **slot = &h->old.slots[h->move_idx++];
+      if (*slot != NULL && *slot != OHASH_MOVED)
+        {
+          table_insert (&h->cur, *slot);
+          *slot = OHASH_MOVED;
+          h->old.cnt--;
+        }
+    }
+
+  if (h->old.cnt == 0)
+    {
+      free (h->old.slots);
+      h->old.slots = NULL;
+      h->old.size = 0;
+      h->move_idx = 0;
+    }
+}
@@ -100,4 +100,97 @@ unsigned hash_bytes (const void *, size_t);
 unsigned hash_string (const char *);
 unsigned hash_int (int);
 
+/* Open-addressing hash table.
+
+   An alternative to struct hash for tables that are searched
+   much more often than they change.  Instead of chaining, the
+   table is a power-of-2 array of pointers to elements, probed
+   linearly in Robin Hood order: an element never sits further
+   from its home slot than the element it displaced, so a search
+   can stop as soon as it meets an element closer to home than
+   the search has come.  Removal shifts the following elements
+   back instead of leaving tombstones.
+
+   The table grows by doubling, but incrementally: the old array
+   is kept alongside the new one, and each insertion or deletion
+   moves a few of its slots across, so no single operation
+   rehashes everything.  Searches look in both arrays until the
+   old one is empty.  The table does not shrink.
+
+   Like struct hash, it is intrusive: each structure that can be
+   in an ohash embeds a struct ohash_elem, which caches the
+   element's hash value, and ohash_entry() converts back. */
+
+/* Open hash element. */
+struct ohash_elem
+  {
+    unsigned hash;              /* Hash value, set on insertion. */
+  };
+
+/* Converts pointer to open hash element OHASH_ELEM into a pointer
+   to the structure that it is embedded inside, like
+   hash_entry(). */
+#define ohash_entry(OHASH_ELEM, STRUCT, MEMBER)                 \
+        ((STRUCT *) ((uint8_t *) &(OHASH_ELEM)->hash            \
+                     - offsetof (STRUCT, MEMBER.hash)))
+
+/* Computes and returns the hash value for element E, given
+   auxiliary data AUX. */
+typedef unsigned ohash_hash_func (const struct ohash_elem *e, void *aux);
+
+/* Returns true if elements A and B have the same key, given
+   auxiliary data AUX. */
+typedef bool ohash_equal_func (const struct ohash_elem *a,
+                               const struct ohash_elem *b, void *aux);
+
+/* Performs some operation on element E, given auxiliary data
+   AUX. */
+typedef void ohash_action_func (struct ohash_elem *e, void *aux);
+
+/* One array of slots. */
+struct ohash_table
+  {
+    struct ohash_elem **slots;  /* Array of SIZE slots, or null. */
+    size_t size;                /* Number of slots, a power of 2. */
+    size_t cnt;                 /* Number of elements. */
+  };
+
+/* Open hash table. */
+struct ohash
+  {
+    struct ohash_table cur;     /* Where elements are inserted. */
+    struct ohash_table old;     /* Being moved into CUR, if any. */
+    size_t move_idx;            /* Next slot of OLD to move. */
+    ohash_hash_func *hash;      /* Hash function. */
+    ohash_equal_func *equal;    /* Equality function. */
+    void *aux;                  /* Auxiliary data for HASH and EQUAL. */
+  };
+
+/* An open hash table iterator.  Inserting or deleting any element
+   invalidates it. */
+struct ohash_iterator
+  {
+    struct ohash *hash;         /* The hash table. */
+    struct ohash_table *table;  /* Array being walked. */
+    size_t idx;                 /* Next slot in TABLE. */
+  };
+
+/* Basic life cycle. */
+void ohash_init (struct ohash *, ohash_hash_func *, ohash_equal_func *,
+                 void *aux);
+void ohash_destroy (struct ohash *, ohash_action_func *);
+
+/* Search, insertion, deletion. */
+struct ohash_elem *ohash_insert (struct ohash *, struct ohash_elem *);
+struct ohash_elem *ohash_find (struct ohash *, struct ohash_elem *);
+struct ohash_elem *ohash_delete (struct ohash *, struct ohash_elem *);
+
+/* Iteration. */
+void ohash_first (struct ohash_iterator *, struct ohash *);
+struct ohash_elem *ohash_next (struct ohash_iterator *);
+
+/* Information. */
+size_t ohash_size (const struct ohash *);
+bool ohash_empty (const struct ohash *);
+
 #endif /* lib/kernel/hash.h */
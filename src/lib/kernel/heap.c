@@ -0,0 +1,196 @@
+#include "heap.h"
+#include "../debug.h"
+
+/* A pairing heap is a tree in which every element is at least as
+   great as its children.  Each element points to its first child
+   and to its next sibling; its `prev' link points to its
+   previous sibling or, for a first child, to its parent.  The
+   root has no siblings.
+
+   Two trees are joined ("melded") by making the root of the
+   lesser one the first child of the other.  Pushing an element
+   melds it with the root.  Popping the root leaves a list of
+   subtrees, which are melded in pairs from left to right and
+   then together from right to left; this second step is what
+   gives the logarithmic amortized bound. */
+
+static struct heap_elem *meld (const struct heap *,
+                               struct heap_elem *, struct heap_elem *);
+static struct heap_elem *merge_pairs (const struct heap *,
+                                      struct heap_elem *);
+static void cut (struct heap_elem *);
+
+/* Initializes HEAP as an empty heap ordered by LESS, given
+   auxiliary data AUX. */
+void
+heap_init (struct heap *heap, heap_less_func *less, void *aux)
+{
+  ASSERT (heap != NULL);
+  ASSERT (less != NULL);
+
+  heap->root = NULL;
+  heap->less = less;
+  heap->aux = aux;
+}
+
+/* Returns true if HEAP is empty, false otherwise. */
+bool
+heap_empty (const struct heap *heap)
+{
+  return heap->root == NULL;
+}
+
+/* Inserts ELEM into HEAP. */
+void
+heap_push (struct heap *heap, struct heap_elem *elem)
+{
+  ASSERT (heap != NULL);
+  ASSERT (elem != NULL);
+
+  elem->child = elem->next = elem->prev = NULL;
+  heap->root = meld (heap, heap->root, elem);
+}
+
+/* Returns the greatest element in HEAP.  Undefined behavior if
+   HEAP is empty. */
+struct heap_elem *
+heap_top (const struct heap *heap)
+{
+  ASSERT (!heap_empty (heap));
+  return heap->root;
+}
+
+/* Removes the greatest element from HEAP and returns it.
+   Undefined behavior if HEAP is empty. */
+struct heap_elem *
+heap_pop (struct heap *heap)
+{
+  struct heap_elem *top = heap_top (heap);
+  heap_remove (heap, top);
+  return top;
+}
+
+/* Removes ELEM, which must be in HEAP, from HEAP. */
+void
+heap_remove (struct heap *heap, struct heap_elem *elem)
+{
+  struct heap_elem *rest;
+
+  ASSERT (heap != NULL);
+  ASSERT (elem != NULL);
+
+  rest = merge_pairs (heap, elem->child);
+  if (elem == heap->root)
+    heap->root = rest;
+  else
+    {
+      cut (elem);
+      heap->root = meld (heap, heap->root, rest);
+    }
+  elem->child = elem->next = elem->prev = NULL;
+}
+
+/* Moves ELEM, which must be in HEAP, to its proper place after
+   its key has changed. */
+void
+heap_update (struct heap *heap, struct heap_elem *elem)
+{
+  heap_remove (heap, elem);
+  heap_push (heap, elem);
+}
+
+/* Moves ELEM, which must be in HEAP, to its proper place after
+   its key has increased.  Cheaper than heap_update(): ELEM is
+   still at least as great as its children, so its subtree is
+   simply cut loose and melded with the root, in constant time.
+   Undefined behavior if ELEM's key has decreased. */
+void
+heap_raise (struct heap *heap, struct heap_elem *elem)
+{
+  ASSERT (heap != NULL);
+  ASSERT (elem != NULL);
+
+  if (elem == heap->root)
+    return;
+  cut (elem);
+  elem->next = elem->prev = NULL;
+  heap->root = meld (heap, heap->root, elem);
+}
+
+/* Melds the trees rooted at A and B, either of which may be
+   null, and returns the root of the result.  A and B must not
+   have siblings. */
+static struct heap_elem *
+meld (const struct heap *heap, struct heap_elem *a, struct heap_elem *b)
+{
+  if (a == NULL)
+    return b;
+  if (b == NULL)
+    return a;
+
+  if (heap->less (a, b, heap->aux))
+    {
+      struct heap_elem *t = a;
+      a = b;
+      b = t;
+    }
+
+  /* Make B the first child of A. */
+  b->prev = a;
+  b->next = a->child;
+  if (a->child != NULL)
+    a->child->prev = b;
+  a->child = b;
+  return a;
+}
+
+/* Melds the list of sibling trees starting at FIRST into a
+   single tree and returns its root, or a null pointer if FIRST
+   is null. */
+static struct heap_elem *
+merge_pairs (const struct heap *heap, struct heap_elem *first)
+{
+  struct heap_elem *pairs = NULL;
+  struct heap_elem *root = NULL;
+
+  /* Left to right, meld adjacent pairs, stacking the results on
+     PAIRS through their `next' links. */
+  while (first != NULL)
+    {
+      struct heap_elem *a = first;
+      struct heap_elem *b = a->next;
+
+      first = b != NULL ? b->next : NULL;
+      a->next = a->prev = NULL;
+      if (b != NULL)
+        {
+          b->next = b->prev = NULL;
+          a = meld (heap, a, b);
+        }
+      a->next = pairs;
+      pairs = a;
+    }
+
+  /* Right to left, meld the pairs into one tree. */
+  while (pairs != NULL)
+    {
+      struct heap_elem *next = pairs->next;
+      pairs->next = NULL;
+      root = meld (heap, root, pairs);
+      pairs = next;
+    }
+  return root;
+}
+
+/* Unlinks ELEM, which must not be the root, and its subtree from
+   its siblings and parent. */
+static void
+cut (struct heap_elem *elem)
+{
+  if (elem->prev->child == elem)
+    elem->prev->child = elem->next;
+  else
+    elem->prev->next = elem->next;
+  if (elem->next != NULL)
+    elem->next->prev = elem->prev;
+}
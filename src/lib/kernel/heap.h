@@ -0,0 +1,70 @@
+#ifndef __LIB_KERNEL_HEAP_H
+#define __LIB_KERNEL_HEAP_H
+
+/* Priority queue.
+
+   This is a pairing heap.  Like our lists and hash tables, it
+   does not use dynamic allocation: each structure that can
+   potentially be in a heap must embed a struct heap_elem member,
+   and the heap_entry macro converts from a struct heap_elem back
+   to the structure that contains it.  Refer to lib/kernel/list.h
+   for a detailed explanation of the technique.
+
+   The heap keeps its greatest element, according to the
+   comparison function passed to heap_init(), at the top.
+   heap_push() and heap_top() take constant time.  heap_pop() and
+   heap_remove() take O(log n) amortized time.  An element whose
+   key changes must be repositioned with heap_update() before the
+   heap is used again, or with heap_raise(), in constant time, if
+   the key only increased.
+
+   Elements that compare equal come out in no particular order;
+   callers that want first-in, first-out order among equals must
+   include a sequence number in the comparison. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Heap element. */
+struct heap_elem
+  {
+    struct heap_elem *child;    /* First child. */
+    struct heap_elem *next;     /* Next sibling. */
+    struct heap_elem *prev;     /* Previous sibling, or parent. */
+  };
+
+/* Converts pointer to heap element HEAP_ELEM into a pointer to
+   the structure that HEAP_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the heap element. */
+#define heap_entry(HEAP_ELEM, STRUCT, MEMBER)           \
+        ((STRUCT *) ((uint8_t *) &(HEAP_ELEM)->child    \
+                     - offsetof (STRUCT, MEMBER.child)))
+
+/* Compares the value of two heap elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool heap_less_func (const struct heap_elem *a,
+                             const struct heap_elem *b,
+                             void *aux);
+
+/* Heap. */
+struct heap
+  {
+    struct heap_elem *root;     /* Greatest element, or null. */
+    heap_less_func *less;       /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+void heap_init (struct heap *, heap_less_func *, void *aux);
+bool heap_empty (const struct heap *);
+
+void heap_push (struct heap *, struct heap_elem *);
+struct heap_elem *heap_top (const struct heap *);
+struct heap_elem *heap_pop (struct heap *);
+void heap_remove (struct heap *, struct heap_elem *);
+void heap_update (struct heap *, struct heap_elem *);
+void heap_raise (struct heap *, struct heap_elem *);
+
+#endif /* lib/kernel/heap.h */
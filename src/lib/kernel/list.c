@@ -67,6 +67,7 @@ list_init (struct list *list)
   list->tail.next = NULL;
 }
 
+#ifndef RELEASE
 /* Returns the beginning of LIST.  */
 struct list_elem *
 list_begin (struct list *list)
@@ -161,6 +162,7 @@ list_tail (struct list *list)
   ASSERT (list != NULL);
   return &list->tail;
 }
+#endif /* RELEASE */
 
 /* Inserts ELEM just before BEFORE, which may be either an
    interior element or a tail.  The latter case is equivalent to
@@ -349,96 +351,146 @@ is_sorted (struct list_elem *a, struct list_elem *b,
   return true;
 }
 
-/* Finds a run, starting at A and ending not after B, of list
-   elements that are in nondecreasing order according to LESS
-   given auxiliary data AUX.  Returns the (exclusive) end of the
-   run.
-   A through B (exclusive) must form a non-empty range. */
-static struct list_elem *
-find_end_of_run (struct list_elem *a, struct list_elem *b,
-                 list_less_func *less, void *aux)
-{
-  ASSERT (a != NULL);
-  ASSERT (b != NULL);
-  ASSERT (less != NULL);
-  ASSERT (a != b);
-  
-  do 
-    {
-      a = list_next (a);
-    }
-  while (a != b && !less (a, list_prev (a), aux));
-  return a;
-}
+/* Number of bins used by list_sort().  Bin I holds a sorted chain
+   of 2**I elements, so this many bins can sort any list that fits
+   in memory. */
+#define SORT_BINS 32
 
-/* Merges A0 through A1B0 (exclusive) with A1B0 through B1
-   (exclusive) to form a combined range also ending at B1
-   (exclusive).  Both input ranges must be nonempty and sorted in
-   nondecreasing order according to LESS given auxiliary data
-   AUX.  The output range will be sorted the same way. */
-static void
-inplace_merge (struct list_elem *a0, struct list_elem *a1b0,
-               struct list_elem *b1,
-               list_less_func *less, void *aux)
+/* Merges the null-terminated chains A and B, linked through their
+   `next' members and each sorted according to LESS given
+   auxiliary data AUX, and returns the merged chain.  On ties,
+   elements of A come first. */
+static struct list_elem *
+merge_chains (struct list_elem *a, struct list_elem *b,
+              list_less_func *less, void *aux)
 {
-  ASSERT (a0 != NULL);
-  ASSERT (a1b0 != NULL);
-  ASSERT (b1 != NULL);
-  ASSERT (less != NULL);
-  ASSERT (is_sorted (a0, a1b0, less, aux));
-  ASSERT (is_sorted (a1b0, b1, less, aux));
+  struct list_elem head;
+  struct list_elem *tail = &head;
 
-  while (a0 != a1b0 && a1b0 != b1)
-    if (!less (a1b0, a0, aux)) 
-      a0 = list_next (a0);
-    else 
+  while (a != NULL && b != NULL)
+    if (less (b, a, aux))
       {
-        a1b0 = list_next (a1b0);
-        list_splice (a0, list_prev (a1b0), a1b0);
+        tail->next = b;
+        tail = b;
+        b = b->next;
       }
+    else
+      {
+        tail->next = a;
+        tail = a;
+        a = a->next;
+      }
+  tail->next = a != NULL ? a : b;
+  return head.next;
 }
 
 /* Sorts LIST according to LESS given auxiliary data AUX, using a
-   natural iterative merge sort that runs in O(n lg n) time and
-   O(1) space in the number of elements in LIST. */
+   bottom-up merge sort that runs in O(n lg n) time and O(1)
+   space in the number of elements in LIST.  The sort is stable.
+
+   Elements are taken off the front of the list one at a time and
+   carried up through an array of bins as in binary addition: an
+   element merged with a full bin I empties it and moves on to bin
+   I + 1.  Only the `next' links are maintained while sorting;
+   the `prev' links are rebuilt in a single final pass. */
 void
 list_sort (struct list *list, list_less_func *less, void *aux)
 {
-  size_t output_run_cnt;        /* Number of runs output in current pass. */
+  struct list_elem *bins[SORT_BINS];
+  struct list_elem *e, *chain, *prev;
+  size_t bin_cnt = 0;
+  size_t i;
 
   ASSERT (list != NULL);
   ASSERT (less != NULL);
 
-  /* Pass over the list repeatedly, merging adjacent runs of
-     nondecreasing elements, until only one run is left. */
-  do
+  if (list_empty (list))
+    return;
+
+  list_back (list)->next = NULL;
+  for (e = list_front (list); e != NULL; )
     {
-      struct list_elem *a0;     /* Start of first run. */
-      struct list_elem *a1b0;   /* End of first run, start of second. */
-      struct list_elem *b1;     /* End of second run. */
+      chain = e;
+      e = e->next;
+      chain->next = NULL;
 
-      output_run_cnt = 0;
-      for (a0 = list_begin (list); a0 != list_end (list); a0 = b1)
+      /* Bins hold earlier elements than CHAIN, so they go first
+         to keep the sort stable. */
+      for (i = 0; i < bin_cnt && bins[i] != NULL; i++)
+        {
+          chain = merge_chains (bins[i], chain, less, aux);
+          bins[i] = NULL;
+        }
+      if (i == bin_cnt)
         {
-          /* Each iteration produces one output run. */
-          output_run_cnt++;
-
-          /* Locate two adjacent runs of nondecreasing elements
-             A0...A1B0 and A1B0...B1. */
-          a1b0 = find_end_of_run (a0, list_end (list), less, aux);
-          if (a1b0 == list_end (list))
-            break;
-          b1 = find_end_of_run (a1b0, list_end (list), less, aux);
-
-          /* Merge the runs. */
-          inplace_merge (a0, a1b0, b1, less, aux);
+          ASSERT (bin_cnt < SORT_BINS);
+          bin_cnt++;
         }
+      bins[i] = chain;
+    }
+
+  /* Higher bins hold earlier elements. */
+  chain = NULL;
+  for (i = 0; i < bin_cnt; i++)
+    if (bins[i] != NULL)
+      chain = merge_chains (bins[i], chain, less, aux);
+
+  /* Rebuild the list. */
+  prev = &list->head;
+  for (e = chain; e != NULL; e = e->next)
+    {
+      e->prev = prev;
+      prev->next = e;
+      prev = e;
     }
-  while (output_run_cnt > 1);
+  prev->next = &list->tail;
+  list->tail.prev = prev;
 
   ASSERT (is_sorted (list_begin (list), list_end (list), less, aux));
 }
 
+/* Moves every element of SRC into DST, leaving SRC empty.  Both
+   lists must be sorted according to LESS given auxiliary data
+   AUX, and DST remains so.  Elements of DST come before equal
+   elements of SRC.  Runs in O(n + m) time in the lengths of the
+   two lists. */
+void
+list_merge (struct list *dst, struct list *src,
+            list_less_func *less, void *aux)
+{
+  struct list_elem *e;
+
+  ASSERT (dst != NULL);
+  ASSERT (src != NULL);
+  ASSERT (less != NULL);
+  ASSERT (is_sorted (list_begin (dst), list_end (dst), less, aux));
+  ASSERT (is_sorted (list_begin (src), list_end (src), less, aux));
+
+  e = list_begin (dst);
+  while (!list_empty (src))
+    {
+      struct list_elem *first = list_begin (src);
+      struct list_elem *last;
+
+      /* Skip DST elements that go before FIRST. */
+      while (e != list_end (dst) && !less (first, e, aux))
+        e = list_next (e);
+      if (e == list_end (dst))
+        {
+          list_splice (e, first, list_end (src));
+          break;
+        }
+
+      /* Move the run of SRC elements that go before E. */
+      last = list_next (first);
+      while (last != list_end (src) && less (last, e, aux))
+        last = list_next (last);
+      list_splice (e, first, last);
+    }
+
+  ASSERT (is_sorted (list_begin (dst), list_end (dst), less, aux));
+}
+
 /* Inserts ELEM in the proper position in LIST, which must be
    sorted according to LESS given auxiliary data AUX.
    Runs in O(n) average case in the number of elements in LIST. */
@@ -124,7 +124,10 @@ struct list
 
 void list_init (struct list *);
 
-/* List traversal. */
+/* List traversal.  A release kernel, which has no assertions for
+   them to check, inlines these; see list.c for their
+   descriptions. */
+#ifndef RELEASE
 struct list_elem *list_begin (struct list *);
 struct list_elem *list_next (struct list_elem *);
 struct list_elem *list_end (struct list *);
@@ -135,6 +138,55 @@ struct list_elem *list_rend (struct list *);
 
 struct list_elem *list_head (struct list *);
 struct list_elem *list_tail (struct list *);
+#else
+static inline struct list_elem *
+list_begin (struct list *list)
+{
+  return list->head.next;
+}
+
+static inline struct list_elem *
+list_next (struct list_elem *elem)
+{
+  return elem->next;
+}
+
+static inline struct list_elem *
+list_end (struct list *list)
+{
+  return &list->tail;
+}
+
+static inline struct list_elem *
+list_rbegin (struct list *list)
+{
+  return list->tail.prev;
+}
+
+static inline struct list_elem *
+list_prev (struct list_elem *elem)
+{
+  return elem->prev;
+}
+
+static inline struct list_elem *
+list_rend (struct list *list)
+{
+  return &list->head;
+}
+
+static inline struct list_elem *
+list_head (struct list *list)
+{
+  return &list->head;
+}
+
+static inline struct list_elem *
+list_tail (struct list *list)
+{
+  return &list->tail;
+}
+#endif
 
 /* List insertion. */
 void list_insert (struct list_elem *, struct list_elem *);
@@ -169,6 +221,8 @@ typedef bool list_less_func (const struct list_elem *a,
 /* Operations on lists with ordered elements. */
 void list_sort (struct list *,
                 list_less_func *, void *aux);
+void list_merge (struct list *dst, struct list *src,
+                 list_less_func *, void *aux);
 void list_insert_ordered (struct list *, struct list_elem *,
                           list_less_func *, void *aux);
 void list_unique (struct list *, struct list *duplicates,
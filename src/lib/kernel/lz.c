@@ -0,0 +1,212 @@
+#include "lz.h"
+#include <stdint.h>
+#include <string.h>
+#include "../debug.h"
+
+/* Shortest match worth a sequence. */
+#define MIN_MATCH 4
+
+/* Number of entries in the hash table, a power of 2, each the
+   offset from the start of the input of the last position whose
+   first MIN_MATCH bytes hashed there. */
+#define HASH_BITS 12
+#define HASH_SIZE (1 << HASH_BITS)
+
+/* Nibble value meaning that more length bytes follow. */
+#define RUN_MASK 15
+
+/* Longest offset back to a match's source. */
+#define MAX_OFFSET 65535
+
+static uint32_t read32 (const uint8_t *);
+static unsigned hash (uint32_t);
+static uint8_t *put_sequence (uint8_t *op, uint8_t *op_end,
+                              const uint8_t *lit, size_t lit_len,
+                              size_t offset, size_t match_len);
+static uint8_t *put_length (uint8_t *op, uint8_t *op_end, size_t len);
+static bool get_length (const uint8_t **ip, const uint8_t *ip_end,
+                        size_t *len);
+
+/* Compresses the SRC_LEN bytes at SRC, which may be at most
+   LZ_MAX_INPUT, into DST and returns the number of bytes
+   written.  Returns 0 if the result does not fit in DST_MAX
+   bytes.  WORK must point to LZ_WORK_SIZE bytes of scratch
+   space. */
+size_t
+lz_compress (const void *src_, size_t src_len, void *dst_, size_t dst_max,
+             void *work)
+{
+  const uint8_t *src = src_;
+  const uint8_t *end = src + src_len;
+  const uint8_t *ip = src;
+  const uint8_t *anchor = src;
+  uint8_t *dst = dst_;
+  uint8_t *op = dst;
+  uint16_t *table = work;
+
+  ASSERT (src_len <= LZ_MAX_INPUT);
+  ASSERT (HASH_SIZE * sizeof *table <= LZ_WORK_SIZE);
+
+  memset (table, 0, HASH_SIZE * sizeof *table);
+  while (src_len >= MIN_MATCH && ip <= end - MIN_MATCH)
+    {
+      uint32_t word = read32 (ip);
+      unsigned h = hash (word);
+      const uint8_t *ref = src + table[h];
+      size_t match_len;
+
+      table[h] = ip - src;
+      if (ref >= ip || ip - ref > MAX_OFFSET || read32 (ref) != word)
+        {
+          ip++;
+          continue;
+        }
+
+      for (match_len = MIN_MATCH; ip + match_len < end; match_len++)
+        if (ref[match_len] != ip[match_len])
+          break;
+      op = put_sequence (op, dst + dst_max, anchor, ip - anchor,
+                         ip - ref, match_len);
+      if (op == NULL)
+        return 0;
+      ip += match_len;
+      anchor = ip;
+    }
+
+  op = put_sequence (op, dst + dst_max, anchor, end - anchor, 0, 0);
+  return op != NULL ? (size_t) (op - dst) : 0;
+}
+
+/* Decompresses the SRC_LEN bytes at SRC, produced by
+   lz_compress(), into the DST_LEN bytes at DST.  Returns true if
+   successful, false if SRC is corrupt or does not decompress to
+   exactly DST_LEN bytes. */
+bool
+lz_decompress (const void *src, size_t src_len, void *dst_, size_t dst_len)
+{
+  const uint8_t *ip = src;
+  const uint8_t *ip_end = ip + src_len;
+  uint8_t *dst = dst_;
+  uint8_t *op = dst;
+  uint8_t *op_end = dst + dst_len;
+
+  while (ip < ip_end)
+    {
+      uint8_t token = *ip++;
+      size_t lit_len = token >> 4;
+      size_t match_len = token & RUN_MASK;
+      size_t offset;
+
+      if (!get_length (&ip, ip_end, &lit_len)
+          || lit_len > (size_t) (ip_end - ip)
+          || lit_len > (size_t) (op_end - op))
+        return false;
+      memcpy (op, ip, lit_len);
+      op += lit_len;
+      ip += lit_len;
+      if (ip == ip_end)
+        break;
+
+      if (ip_end - ip < 2)
+        return false;
+      offset = ip[0] | (ip[1] << 8);
+      ip += 2;
+      if (!get_length (&ip, ip_end, &match_len))
+        return false;
+      match_len += MIN_MATCH;
+      if (offset == 0 || offset > (size_t) (op - dst)
+          || match_len > (size_t) (op_end - op))
+        return false;
+
+      /* The source may overlap the destination, which repeats
+         the last OFFSET bytes, so copy forward a byte at a time. */
+      for (; match_len > 0; match_len--, op++)
+        *op = op[-offset];
+    }
+  return op == op_end;
+}
+
+/* Returns the 4 bytes at P, which need not be aligned. */
+static uint32_t
+read32 (const uint8_t *p)
+{
+  uint32_t word;
+  memcpy (&word, p, sizeof word);
+  return word;
+}
+
+/* Returns WORD's slot in the hash table. */
+static unsigned
+hash (uint32_t word)
+{
+  return (word * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/* Writes a sequence of the LIT_LEN literal bytes at LIT followed,
+   if MATCH_LEN is nonzero, by a match of MATCH_LEN bytes OFFSET
+   bytes back, at OP.  Returns the byte after the sequence, or a
+   null pointer if it would not fit before OP_END. */
+static uint8_t *
+put_sequence (uint8_t *op, uint8_t *op_end, const uint8_t *lit,
+              size_t lit_len, size_t offset, size_t match_len)
+{
+  size_t match_code = match_len > 0 ? match_len - MIN_MATCH : 0;
+
+  if (op >= op_end)
+    return NULL;
+  *op++ = ((lit_len < RUN_MASK ? lit_len : RUN_MASK) << 4
+           | (match_code < RUN_MASK ? match_code : RUN_MASK));
+
+  op = put_length (op, op_end, lit_len);
+  if (op == NULL || lit_len > (size_t) (op_end - op))
+    return NULL;
+  memcpy (op, lit, lit_len);
+  op += lit_len;
+  if (match_len == 0)
+    return op;
+
+  if (op_end - op < 2)
+    return NULL;
+  *op++ = offset & 0xff;
+  *op++ = offset >> 8;
+  return put_length (op, op_end, match_code);
+}
+
+/* Writes the bytes that follow a token nibble for LEN, if any,
+   at OP.  Returns the byte after them, or a null pointer if they
+   would not fit before OP_END. */
+static uint8_t *
+put_length (uint8_t *op, uint8_t *op_end, size_t len)
+{
+  if (len < RUN_MASK)
+    return op;
+  for (len -= RUN_MASK; ; len -= 255)
+    {
+      if (op >= op_end)
+        return NULL;
+      *op++ = len < 255 ? len : 255;
+      if (len < 255)
+        return op;
+    }
+}
+
+/* Adds to *LEN, the value of a token nibble, the length bytes
+   that follow it at *IP, if any, and advances *IP past them.
+   Returns false if they run past IP_END. */
+static bool
+get_length (const uint8_t **ip, const uint8_t *ip_end, size_t *len)
+{
+  uint8_t b;
+
+  if (*len < RUN_MASK)
+    return true;
+  do
+    {
+      if (*ip >= ip_end)
+        return false;
+      b = *(*ip)++;
+      *len += b;
+    }
+  while (b == 255);
+  return true;
+}
@@ -0,0 +1,34 @@
+#ifndef __LIB_KERNEL_LZ_H
+#define __LIB_KERNEL_LZ_H
+
+/* Fast LZ77 compression.
+
+   The compressed form is a series of sequences, each a run of
+   literal bytes followed by a copy of earlier output, in the
+   style of LZ4: a token byte holding both lengths in its two
+   nibbles, more length bytes for lengths that do not fit, the
+   literals, and a 2-byte offset back to the copy's source.  The
+   last sequence has literals only.  Compression looks for
+   matches through a hash table of recent positions, so it is a
+   single fast pass that finds fewer matches than a thorough
+   search would.
+
+   Neither direction allocates memory.  lz_compress() needs
+   LZ_WORK_SIZE bytes of scratch space from its caller, which
+   keeps it off the stack. */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Bytes of scratch space for lz_compress(). */
+#define LZ_WORK_SIZE 8192
+
+/* Most bytes that one call can compress. */
+#define LZ_MAX_INPUT 65536
+
+size_t lz_compress (const void *src, size_t src_len,
+                    void *dst, size_t dst_max, void *work);
+bool lz_decompress (const void *src, size_t src_len,
+                    void *dst, size_t dst_len);
+
+#endif /* lib/kernel/lz.h */
@@ -0,0 +1,438 @@
+#include "rbtree.h"
+#include "../debug.h"
+
+/* Every element is red or black, and:
+
+     1. The root is black.
+     2. A red element has no red children.
+     3. Every path from an element down to a null child passes
+        through the same number of black elements.
+
+   Properties 2 and 3 together keep the longest path from the
+   root no more than twice the shortest.  Insertion and removal
+   restore them with recolorings and at most three rotations. */
+
+static void rotate_left (struct rbtree *, struct rb_elem *);
+static void rotate_right (struct rbtree *, struct rb_elem *);
+static void replace_child (struct rbtree *, struct rb_elem *parent,
+                           struct rb_elem *old, struct rb_elem *new);
+static void insert_fixup (struct rbtree *, struct rb_elem *);
+static void remove_fixup (struct rbtree *, struct rb_elem *,
+                          struct rb_elem *parent);
+
+/* Returns true if E is a red element, false if it is black or
+   null. */
+static inline bool
+is_red (const struct rb_elem *e)
+{
+  return e != NULL && e->red;
+}
+
+/* Initializes TREE as an empty tree ordered by LESS, given
+   auxiliary data AUX. */
+void
+rb_init (struct rbtree *tree, rb_less_func *less, void *aux)
+{
+  ASSERT (tree != NULL);
+  ASSERT (less != NULL);
+
+  tree->root = NULL;
+  tree->elem_cnt = 0;
+  tree->less = less;
+  tree->aux = aux;
+}
+
+/* Returns the number of elements in TREE. */
+size_t
+rb_size (const struct rbtree *tree)
+{
+  return tree->elem_cnt;
+}
+
+/* Returns true if TREE contains no elements, false otherwise. */
+bool
+rb_empty (const struct rbtree *tree)
+{
+  return tree->root == NULL;
+}
+
+/* Inserts NEW into TREE and returns a null pointer, if no equal
+   element is already in the tree.  If an equal element is
+   already in the tree, returns it without inserting NEW. */
+struct rb_elem *
+rb_insert (struct rbtree *tree, struct rb_elem *new)
+{
+  struct rb_elem **link = &tree->root;
+  struct rb_elem *parent = NULL;
+
+  ASSERT (new != NULL);
+
+  while (*link != NULL)
+    {
+      parent = *link;
+      if (tree->less (new, parent, tree->aux))
+        link = &parent->left;
+      else if (tree->less (parent, new, tree->aux))
+        link = &parent->right;
+      else
+        return parent;
+    }
+
+  new->parent = parent;
+  new->left = new->right = NULL;
+  new->red = true;
+  *link = new;
+  tree->elem_cnt++;
+  insert_fixup (tree, new);
+  return NULL;
+}
+
+/* Removes ELEM, which must be in TREE, from TREE. */
+void
+rb_remove (struct rbtree *tree, struct rb_elem *elem)
+{
+  struct rb_elem *child, *parent;
+  bool removed_red;
+
+  ASSERT (tree != NULL);
+  ASSERT (elem != NULL);
+
+  if (elem->left != NULL && elem->right != NULL)
+    {
+      /* Move ELEM's successor, which has no left child, into
+         ELEM's place; the successor's old position is the one
+         that loses an element. */
+      struct rb_elem *next = elem->right;
+      while (next->left != NULL)
+        next = next->left;
+
+      child = next->right;
+      parent = next->parent;
+      removed_red = next->red;
+      if (parent == elem)
+        parent = next;
+      else
+        {
+          if (child != NULL)
+            child->parent = parent;
+          parent->left = child;
+          next->right = elem->right;
+          elem->right->parent = next;
+        }
+
+      next->left = elem->left;
+      elem->left->parent = next;
+      next->parent = elem->parent;
+      next->red = elem->red;
+      replace_child (tree, elem->parent, elem, next);
+    }
+  else
+    {
+      child = elem->left != NULL ? elem->left : elem->right;
+      parent = elem->parent;
+      removed_red = elem->red;
+      if (child != NULL)
+        child->parent = parent;
+      replace_child (tree, parent, elem, child);
+    }
+
+  tree->elem_cnt--;
+  if (!removed_red)
+    remove_fixup (tree, child, parent);
+  elem->parent = elem->left = elem->right = NULL;
+}
+
+/* Finds and returns an element in TREE equal to KEY, or a null
+   pointer if there is none. */
+struct rb_elem *
+rb_find (const struct rbtree *tree, const struct rb_elem *key)
+{
+  struct rb_elem *e = tree->root;
+
+  while (e != NULL)
+    if (tree->less (key, e, tree->aux))
+      e = e->left;
+    else if (tree->less (e, key, tree->aux))
+      e = e->right;
+    else
+      return e;
+  return NULL;
+}
+
+/* Returns the greatest element in TREE that is less than or equal
+   to KEY, or a null pointer if every element is greater. */
+struct rb_elem *
+rb_floor (const struct rbtree *tree, const struct rb_elem *key)
+{
+  struct rb_elem *e = tree->root;
+  struct rb_elem *best = NULL;
+
+  while (e != NULL)
+    if (tree->less (key, e, tree->aux))
+      e = e->left;
+    else
+      {
+        best = e;
+        e = e->right;
+      }
+  return best;
+}
+
+/* Returns the least element in TREE that is greater than or
+   equal to KEY, or a null pointer if every element is less. */
+struct rb_elem *
+rb_ceiling (const struct rbtree *tree, const struct rb_elem *key)
+{
+  struct rb_elem *e = tree->root;
+  struct rb_elem *best = NULL;
+
+  while (e != NULL)
+    if (tree->less (e, key, tree->aux))
+      e = e->right;
+    else
+      {
+        best = e;
+        e = e->left;
+      }
+  return best;
+}
+
+/* Returns the least element in TREE, or a null pointer if TREE is
+   empty. */
+struct rb_elem *
+rb_first (const struct rbtree *tree)
+{
+  struct rb_elem *e = tree->root;
+
+  if (e != NULL)
+    while (e->left != NULL)
+      e = e->left;
+  return e;
+}
+
+/* Returns the greatest element in TREE, or a null pointer if TREE
+   is empty. */
+struct rb_elem *
+rb_last (const struct rbtree *tree)
+{
+  struct rb_elem *e = tree->root;
+
+  if (e != NULL)
+    while (e->right != NULL)
+      e = e->right;
+  return e;
+}
+
+/* Returns the element after E in its tree, or a null pointer if E
+   is the greatest. */
+struct rb_elem *
+rb_next (struct rb_elem *e)
+{
+  ASSERT (e != NULL);
+
+  if (e->right != NULL)
+    {
+      e = e->right;
+      while (e->left != NULL)
+        e = e->left;
+      return e;
+    }
+  while (e->parent != NULL && e == e->parent->right)
+    e = e->parent;
+  return e->parent;
+}
+
+/* Returns the element before E in its tree, or a null pointer if
+   E is the least. */
+struct rb_elem *
+rb_prev (struct rb_elem *e)
+{
+  ASSERT (e != NULL);
+
+  if (e->left != NULL)
+    {
+      e = e->left;
+      while (e->right != NULL)
+        e = e->right;
+      return e;
+    }
+  while (e->parent != NULL && e == e->parent->left)
+    e = e->parent;
+  return e->parent;
+}
+
+/* Makes NEW take OLD's place as a child of PARENT, or as the root
+   of TREE if PARENT is null.  Does not touch NEW's own links. */
+static void
+replace_child (struct rbtree *tree, struct rb_elem *parent,
+               struct rb_elem *old, struct rb_elem *new)
+{
+  if (parent == NULL)
+    tree->root = new;
+  else if (parent->left == old)
+    parent->left = new;
+  else
+    parent->right = new;
+}
+
+/* Rotates the subtree at E to the left, making E's right child
+   its parent. */
+static void
+rotate_left (struct rbtree *tree, struct rb_elem *e)
+{
+  struct rb_elem *r = e->right;
+
+  e->right = r->left;
+  if (r->left != NULL)
+    r->left->parent = e;
+  r->parent = e->parent;
+  replace_child (tree, e->parent, e, r);
+  r->left = e;
+  e->parent = r;
+}
+
+/* Rotates the subtree at E to the right, making E's left child
+   its parent. */
+static void
+rotate_right (struct rbtree *tree, struct rb_elem *e)
+{
+  struct rb_elem *l = e->left;
+
+  e->left = l->right;
+  if (l->right != NULL)
+    l->right->parent = e;
+  l->parent = e->parent;
+  replace_child (tree, e->parent, e, l);
+  l->right = e;
+  e->parent = l;
+}
+
+/* Restores the red-black properties after E, a newly inserted
+   red element, may have been given a red parent. */
+static void
+insert_fixup (struct rbtree *tree, struct rb_elem *e)
+{
+  struct rb_elem *parent;
+
+  while ((parent = e->parent) != NULL && parent->red)
+    {
+      /* PARENT is red, so it is not the root. */
+      struct rb_elem *grandparent = parent->parent;
+
+      if (parent == grandparent->left)
+        {
+          struct rb_elem *uncle = grandparent->right;
+          if (is_red (uncle))
+            {
+              parent->red = uncle->red = false;
+              grandparent->red = true;
+              e = grandparent;
+              continue;
+            }
+          if (e == parent->right)
+            {
+              rotate_left (tree, parent);
+              e = parent;
+              parent = e->parent;
+            }
+          parent->red = false;
+          grandparent->red = true;
+          rotate_right (tree, grandparent);
+        }
+      else
+        {
+          struct rb_elem *uncle = grandparent->left;
+          if (is_red (uncle))
+            {
+              parent->red = uncle->red = false;
+              grandparent->red = true;
+              e = grandparent;
+              continue;
+            }
+          if (e == parent->left)
+            {
+              rotate_right (tree, parent);
+              e = parent;
+              parent = e->parent;
+            }
+          parent->red = false;
+          grandparent->red = true;
+          rotate_left (tree, grandparent);
+        }
+    }
+  tree->root->red = false;
+}
+
+/* Restores the red-black properties after a black element was
+   removed from above E, which may be null, a child of PARENT.
+   Every path through E is now one black element short. */
+static void
+remove_fixup (struct rbtree *tree, struct rb_elem *e,
+              struct rb_elem *parent)
+{
+  while (e != tree->root && !is_red (e))
+    {
+      /* E's sibling cannot be null: it has the extra black. */
+      if (e == parent->left)
+        {
+          struct rb_elem *sibling = parent->right;
+          if (sibling->red)
+            {
+              sibling->red = false;
+              parent->red = true;
+              rotate_left (tree, parent);
+              sibling = parent->right;
+            }
+          if (!is_red (sibling->left) && !is_red (sibling->right))
+            {
+              sibling->red = true;
+              e = parent;
+              parent = e->parent;
+              continue;
+            }
+          if (!is_red (sibling->right))
+            {
+              sibling->left->red = false;
+              sibling->red = true;
+              rotate_right (tree, sibling);
+              sibling = parent->right;
+            }
+          sibling->red = parent->red;
+          parent->red = false;
+          sibling->right->red = false;
+          rotate_left (tree, parent);
+        }
+      else
+        {
+          struct rb_elem *sibling = parent->left;
+          if (sibling->red)
+            {
+              sibling->red = false;
+              parent->red = true;
+              rotate_right (tree, parent);
+              sibling = parent->left;
+            }
+          if (!is_red (sibling->left) && !is_red (sibling->right))
+            {
+              sibling->red = true;
+              e = parent;
+              parent = e->parent;
+              continue;
+            }
+          if (!is_red (sibling->left))
+            {
+              sibling->right->red = false;
+              sibling->red = true;
+              rotate_left (tree, sibling);
+              sibling = parent->left;
+            }
+          sibling->red = parent->red;
+          parent->red = false;
+          sibling->left->red = false;
+          rotate_right (tree, parent);
+        }
+      e = tree->root;
+    }
+  if (e != NULL)
+    e->red = false;
+}
@@ -0,0 +1,80 @@
+#ifndef __LIB_KERNEL_RBTREE_H
+#define __LIB_KERNEL_RBTREE_H
+
+/* Ordered map.
+
+   This is a red-black tree: a binary search tree kept balanced
+   well enough that its height never exceeds 2 lg(n + 1), so that
+   insertion, removal, and every kind of search take O(log n)
+   time.  Besides exact lookups, it answers the range questions
+   that lists and hash tables cannot: rb_floor() finds the
+   greatest element not greater than a key, such as the region
+   that starts at or before an address, and rb_ceiling() the
+   least element not less than a key.
+
+   Like our lists and hash tables, it does not use dynamic
+   allocation: each structure that can potentially be in a tree
+   must embed a struct rb_elem member, and the rb_entry macro
+   converts from a struct rb_elem back to the structure that
+   contains it.  Refer to lib/kernel/list.h for a detailed
+   explanation of the technique.  Searches take a key in the
+   form of an element, usually a local structure with just its
+   key members set, as with hash_find(). */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Tree element. */
+struct rb_elem
+  {
+    struct rb_elem *parent;     /* Parent, or null for the root. */
+    struct rb_elem *left;       /* Lesser children. */
+    struct rb_elem *right;      /* Greater children. */
+    bool red;                   /* Red or black? */
+  };
+
+/* Converts pointer to tree element RB_ELEM into a pointer to the
+   structure that RB_ELEM is embedded inside.  Supply the name of
+   the outer structure STRUCT and the member name MEMBER of the
+   tree element. */
+#define rb_entry(RB_ELEM, STRUCT, MEMBER)               \
+        ((STRUCT *) ((uint8_t *) &(RB_ELEM)->parent     \
+                     - offsetof (STRUCT, MEMBER.parent)))
+
+/* Compares the value of two tree elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool rb_less_func (const struct rb_elem *a,
+                           const struct rb_elem *b,
+                           void *aux);
+
+/* Red-black tree. */
+struct rbtree
+  {
+    struct rb_elem *root;       /* Root, or null if empty. */
+    size_t elem_cnt;            /* Number of elements. */
+    rb_less_func *less;         /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+void rb_init (struct rbtree *, rb_less_func *, void *aux);
+size_t rb_size (const struct rbtree *);
+bool rb_empty (const struct rbtree *);
+
+/* Insertion and removal. */
+struct rb_elem *rb_insert (struct rbtree *, struct rb_elem *);
+void rb_remove (struct rbtree *, struct rb_elem *);
+
+/* Search. */
+struct rb_elem *rb_find (const struct rbtree *, const struct rb_elem *);
+struct rb_elem *rb_floor (const struct rbtree *, const struct rb_elem *);
+struct rb_elem *rb_ceiling (const struct rbtree *, const struct rb_elem *);
+
+/* In-order traversal. */
+struct rb_elem *rb_first (const struct rbtree *);
+struct rb_elem *rb_last (const struct rbtree *);
+struct rb_elem *rb_next (struct rb_elem *);
+struct rb_elem *rb_prev (struct rb_elem *);
+
+#endif /* lib/kernel/rbtree.h */
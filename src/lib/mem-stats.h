@@ -0,0 +1,43 @@
+#ifndef __LIB_MEM_STATS_H
+#define __LIB_MEM_STATS_H
+
+#include <stdint.h>
+
+/* Number of kernel malloc() size classes: 16, 32, ..., 1024
+   bytes. */
+#define MEM_CLASS_CNT 7
+
+/* Usage of one malloc() size class. */
+struct mem_class_stats
+  {
+    unsigned block_size;        /* Size of each block in bytes. */
+    unsigned live_cnt;          /* Blocks currently allocated. */
+    unsigned max_live_cnt;      /* Highest value of LIVE_CNT. */
+    unsigned arena_cnt;         /* Pages currently holding blocks. */
+    uint64_t alloc_cnt;         /* Number of blocks allocated. */
+    uint64_t free_cnt;          /* Number of blocks freed. */
+  };
+
+/* Usage of one page pool. */
+struct mem_pool_stats
+  {
+    unsigned free_cnt;          /* Free pages. */
+    unsigned used_cnt;          /* Allocated pages. */
+    unsigned largest_free_run;  /* Longest run of contiguous pages
+                                   available to a multi-page
+                                   allocation. */
+    unsigned lent_cnt;          /* Used pages lent to the other pool. */
+    unsigned borrowed_cnt;      /* Pages borrowed from the other pool. */
+  };
+
+/* Kernel memory allocator statistics, as returned by the
+   memstats() system call. */
+struct mem_stats
+  {
+    struct mem_class_stats classes[MEM_CLASS_CNT];
+    unsigned big_block_pages;   /* Pages in blocks too big for a class. */
+    struct mem_pool_stats kernel_pool;
+    struct mem_pool_stats user_pool;
+  };
+
+#endif /* lib/mem-stats.h */
@@ -0,0 +1,26 @@
+#ifndef __LIB_PROC_LIMITS_H
+#define __LIB_PROC_LIMITS_H
+
+#include <stdint.h>
+
+/* Resources whose use by a process set_limit() can cap.  A
+   process starts out with the limits of the process that
+   started it, and may only tighten them. */
+enum proc_limit
+  {
+    LIMIT_FRAMES,               /* Its pages in frames at once. */
+    LIMIT_FILES,                /* File descriptors open at once. */
+    LIMIT_IO_RATE,              /* Disk sectors per second. */
+    LIMIT_CNT
+  };
+
+/* A process's limits, as kept by the kernel.  0 means no
+   limit. */
+struct proc_limits
+  {
+    unsigned max[LIMIT_CNT];    /* Indexed by enum proc_limit. */
+    uint64_t io_ready;          /* clock_ns() by which the sectors it has
+                                   used are paid for; see block.c. */
+  };
+
+#endif /* lib/proc-limits.h */
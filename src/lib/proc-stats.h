@@ -0,0 +1,21 @@
+#ifndef __LIB_PROC_STATS_H
+#define __LIB_PROC_STATS_H
+
+#include <stdint.h>
+
+/* Resources used by a process and all of its threads, as kept by
+   the kernel, reported at exit with the "-sctrace" kernel option,
+   and returned to the parent by wait_stats(). */
+struct proc_stats
+  {
+    uint64_t read_bytes;        /* Bytes read() and the like returned. */
+    uint64_t write_bytes;       /* Bytes write() and the like took. */
+    uint64_t read_sectors;      /* Sectors it asked the disks to read. */
+    uint64_t write_sectors;     /* Sectors it asked the disks to write. */
+    uint64_t syscall_cnt;       /* System calls made. */
+    uint64_t fault_cnt;         /* Page faults taken. */
+    uint32_t max_resident;      /* Most of its pages in frames at once. */
+    int64_t run_ticks;          /* Timer ticks its threads ran. */
+  };
+
+#endif /* lib/proc-stats.h */
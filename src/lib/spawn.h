@@ -0,0 +1,33 @@
+#ifndef __LIB_SPAWN_H
+#define __LIB_SPAWN_H
+
+/* File actions for spawn().
+
+   The child starts with a copy of each of its parent's file
+   descriptors, at the same numbers, as a forked child would.
+   Then the actions are applied to the child's descriptors, in
+   order, before its program is loaded.  Descriptors 0 and 1 are
+   the console until an action makes them something else, so
+   standard input and output can be redirected by moving another
+   file onto them. */
+
+/* Most actions one spawn() takes. */
+#define SPAWN_ACTIONS_MAX 16
+
+/* Descriptors an action may create lie below this. */
+#define SPAWN_FD_MAX 64
+
+enum spawn_op
+  {
+    SPAWN_DUP,                  /* Make TO a copy of FD, closing TO. */
+    SPAWN_CLOSE                 /* Close FD. */
+  };
+
+struct spawn_action
+  {
+    int op;                     /* enum spawn_op. */
+    int fd;                     /* Descriptor acted on. */
+    int to;                     /* SPAWN_DUP: new descriptor. */
+  };
+
+#endif /* lib/spawn.h */
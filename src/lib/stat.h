@@ -0,0 +1,14 @@
+#ifndef __LIB_STAT_H
+#define __LIB_STAT_H
+
+#include <stdbool.h>
+
+/* A file's details, as returned by the stat() system call. */
+struct stat
+  {
+    int inumber;                /* Inode number. */
+    unsigned length;            /* Size of the file in bytes. */
+    bool is_dir;                /* Is it a directory? */
+  };
+
+#endif /* lib/stat.h */
@@ -152,6 +152,8 @@ static void output_dup (char ch, size_t cnt,
 static void format_string (const char *string, int length,
                            struct printf_conversion *,
                            void (*output) (char, void *), void *aux);
+static bool format_plain (char conversion, va_list *,
+                          void (*output) (char, void *), void *aux);
 
 void
 __vprintf (const char *format, va_list args,
@@ -176,6 +178,12 @@ __vprintf (const char *format, va_list args,
           continue;
         }
 
+      /* Bare %d, %u, %x, and %s, which make up nearly all of
+         the conversions in kernel logs, need none of the flag,
+         width, and precision handling below. */
+      if (format_plain (*format, &args, output, aux))
+        continue;
+
       /* Parse conversion specifiers. */
       format = parse_conversion (format, &c, &args);
 
@@ -332,6 +340,66 @@ __vprintf (const char *format, va_list args,
     }
 }
 
+/* If CONVERSION, the character just after a `%', is one of `d',
+   `u', `x', or `s', formats the next argument from *ARGS for that
+   conversion with no flags, width, precision, or length modifier,
+   writes it to OUTPUT, and returns true.  Otherwise returns false
+   without consuming an argument.  The result is the same as
+   going through parse_conversion() and format_integer() or
+   format_string(), only without the bookkeeping. */
+static bool
+format_plain (char conversion, va_list *args,
+              void (*output) (char, void *), void *aux)
+{
+  char buf[16], *cp = buf + sizeof buf;
+  unsigned value;
+  bool negative = false;
+
+  switch (conversion)
+    {
+    case 'd':
+      {
+        int v = va_arg (*args, int);
+        negative = v < 0;
+        value = negative ? -(unsigned) v : (unsigned) v;
+      }
+      break;
+
+    case 'u':
+    case 'x':
+      value = va_arg (*args, unsigned);
+      break;
+
+    case 's':
+      {
+        const char *s = va_arg (*args, char *);
+        if (s == NULL)
+          s = "(null)";
+        while (*s != '\0')
+          output (*s++, aux);
+      }
+      return true;
+
+    default:
+      return false;
+    }
+
+  if (conversion == 'x')
+    do
+      *--cp = "0123456789abcdef"[value & 0xf];
+    while ((value >>= 4) != 0);
+  else
+    do
+      *--cp = '0' + value % 10;
+    while ((value /= 10) != 0);
+
+  if (negative)
+    output ('-', aux);
+  while (cp < buf + sizeof buf)
+    output (*cp++, aux);
+  return true;
+}
+
 /* Parses conversion option characters starting at FORMAT and
    initializes C appropriately.  Returns the character in FORMAT
    that indicates the conversion (e.g. the `d' in `%d').  Uses
@@ -3,6 +3,7 @@
 #include <random.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* Converts a string representation of a signed decimal integer
    in S into an `int', which is returned. */
@@ -52,7 +53,7 @@ compare_thunk (const void *a, const void *b, void *aux)
    using COMPARE.  When COMPARE is passed a pair of elements A
    and B, respectively, it must return a strcmp()-type result,
    i.e. less than zero if A < B, zero if A == B, greater than
-   zero if A > B.  Runs in O(n lg n) time and O(1) space in
+   zero if A > B.  Runs in O(n lg n) time and O(lg n) space in
    CNT. */
 void
 qsort (void *array, size_t cnt, size_t size,
@@ -61,36 +62,43 @@ qsort (void *array, size_t cnt, size_t size,
   sort (array, cnt, size, compare_thunk, &compare);
 }
 
-/* Swaps elements with 1-based indexes A_IDX and B_IDX in ARRAY
-   with elements of SIZE bytes each. */
-static void
-do_swap (unsigned char *array, size_t a_idx, size_t b_idx, size_t size)
-{
-  unsigned char *a = array + (a_idx - 1) * size;
-  unsigned char *b = array + (b_idx - 1) * size;
-  size_t i;
+/* Partitions of no more than this many elements are finished by
+   insertion sort. */
+#define INSERTION_SORT_MAX 16
 
-  for (i = 0; i < size; i++)
+/* Swaps the SIZE-byte elements at A and B, a word at a time if
+   SIZE and both addresses allow. */
+static inline void
+do_swap (unsigned char *a, unsigned char *b, size_t size)
+{
+  if (size % sizeof (unsigned long) == 0
+      && ((uintptr_t) a | (uintptr_t) b) % sizeof (unsigned long) == 0)
     {
-      unsigned char t = a[i];
-      a[i] = b[i];
-      b[i] = t;
+      unsigned long *x = (unsigned long *) a;
+      unsigned long *y = (unsigned long *) b;
+      size_t i;
+
+      for (i = 0; i < size / sizeof (unsigned long); i++)
+        {
+          unsigned long t = x[i];
+          x[i] = y[i];
+          y[i] = t;
+        }
     }
-}
+  else
+    {
+      size_t i;
 
-/* Compares elements with 1-based indexes A_IDX and B_IDX in
-   ARRAY with elements of SIZE bytes each, using COMPARE to
-   compare elements, passing AUX as auxiliary data, and returns a
-   strcmp()-type result. */
-static int
-do_compare (unsigned char *array, size_t a_idx, size_t b_idx, size_t size,
-            int (*compare) (const void *, const void *, void *aux),
-            void *aux) 
-{
-  return compare (array + (a_idx - 1) * size, array + (b_idx - 1) * size, aux);
+      for (i = 0; i < size; i++)
+        {
+          unsigned char t = a[i];
+          a[i] = b[i];
+          b[i] = t;
+        }
+    }
 }
 
-/* "Float down" the element with 1-based index I in ARRAY of CNT
+/* "Float down" the element with 0-based index I in ARRAY of CNT
    elements of SIZE bytes each, using COMPARE to compare
    elements, passing AUX as auxiliary data. */
 static void
@@ -102,13 +110,14 @@ heapify (unsigned char *array, size_t i, size_t cnt, size_t size,
     {
       /* Set `max' to the index of the largest element among I
          and its children (if any). */
-      size_t left = 2 * i;
-      size_t right = 2 * i + 1;
+      size_t left = 2 * i + 1;
+      size_t right = 2 * i + 2;
       size_t max = i;
-      if (left <= cnt && do_compare (array, left, max, size, compare, aux) > 0)
+      if (left < cnt
+          && compare (array + left * size, array + max * size, aux) > 0)
         max = left;
-      if (right <= cnt
-          && do_compare (array, right, max, size, compare, aux) > 0) 
+      if (right < cnt
+          && compare (array + right * size, array + max * size, aux) > 0)
         max = right;
 
       /* If the maximum value is already in element I, we're
@@ -117,38 +126,145 @@ heapify (unsigned char *array, size_t i, size_t cnt, size_t size,
         break;
 
       /* Swap and continue down the heap. */
-      do_swap (array, i, max, size);
+      do_swap (array + i * size, array + max * size, size);
       i = max;
     }
 }
 
+/* Heapsorts ARRAY, which contains CNT elements of SIZE bytes
+   each, as sort() does. */
+static void
+heap_sort (unsigned char *array, size_t cnt, size_t size,
+           int (*compare) (const void *, const void *, void *aux),
+           void *aux)
+{
+  size_t i;
+
+  /* Build a heap. */
+  for (i = cnt / 2; i > 0; i--)
+    heapify (array, i - 1, cnt, size, compare, aux);
+
+  /* Sort the heap. */
+  for (i = cnt - 1; i > 0; i--) 
+    {
+      do_swap (array, array + i * size, size);
+      heapify (array, 0, i, size, compare, aux); 
+    }
+}
+
+/* Insertion-sorts ARRAY, which contains CNT elements of SIZE
+   bytes each, as sort() does. */
+static void
+insertion_sort (unsigned char *array, size_t cnt, size_t size,
+                int (*compare) (const void *, const void *, void *aux),
+                void *aux)
+{
+  unsigned char *end = array + cnt * size;
+  unsigned char *p, *q;
+
+  for (p = array + size; p < end; p += size)
+    for (q = p; q > array && compare (q - size, q, aux) > 0; q -= size)
+      do_swap (q - size, q, size);
+}
+
+/* Sorts ARRAY, which contains CNT elements of SIZE bytes each,
+   as sort() does, switching to heapsort once DEPTH more levels
+   of partitioning have not made the partitions small. */
+static void
+intro_sort (unsigned char *array, size_t cnt, size_t size,
+            int (*compare) (const void *, const void *, void *aux),
+            void *aux, int depth)
+{
+  while (cnt > INSERTION_SORT_MAX)
+    {
+      unsigned char *lo = array;
+      unsigned char *mid = array + cnt / 2 * size;
+      unsigned char *hi = array + (cnt - 1) * size;
+      size_t i, j;
+
+      if (depth-- == 0)
+        {
+          heap_sort (array, cnt, size, compare, aux);
+          return;
+        }
+
+      /* Order the first, middle, and last elements, then move
+         the median to the front as the pivot. */
+      if (compare (mid, lo, aux) < 0)
+        do_swap (mid, lo, size);
+      if (compare (hi, mid, aux) < 0)
+        {
+          do_swap (hi, mid, size);
+          if (compare (mid, lo, aux) < 0)
+            do_swap (mid, lo, size);
+        }
+      do_swap (lo, mid, size);
+
+      /* Partition around the pivot.  Stopping on elements equal
+         to it keeps runs of equal elements balanced. */
+      i = 0;
+      j = cnt;
+      for (;;)
+        {
+          do
+            i++;
+          while (i < cnt && compare (array + i * size, lo, aux) < 0);
+          do
+            j--;
+          while (compare (array + j * size, lo, aux) > 0);
+          if (i >= j)
+            break;
+          do_swap (array + i * size, array + j * size, size);
+        }
+      do_swap (lo, array + j * size, size);
+
+      /* Elements 0...J-1 sort before the pivot, now at J, and
+         those after it sort after.  Recurse on the smaller part,
+         so that the stack stays O(lg n) deep, and loop on the
+         larger. */
+      if (j < cnt - j - 1)
+        {
+          intro_sort (array, j, size, compare, aux, depth);
+          array += (j + 1) * size;
+          cnt -= j + 1;
+        }
+      else
+        {
+          intro_sort (array + (j + 1) * size, cnt - j - 1, size,
+                      compare, aux, depth);
+          cnt = j;
+        }
+    }
+  insertion_sort (array, cnt, size, compare, aux);
+}
+
 /* Sorts ARRAY, which contains CNT elements of SIZE bytes each,
    using COMPARE to compare elements, passing AUX as auxiliary
    data.  When COMPARE is passed a pair of elements A and B,
    respectively, it must return a strcmp()-type result, i.e. less
    than zero if A < B, zero if A == B, greater than zero if A >
-   B.  Runs in O(n lg n) time and O(1) space in CNT. */
+   B.  Runs in O(n lg n) time and O(lg n) space in CNT.
+
+   This is an introsort: quicksort, with the median of the first,
+   middle, and last elements as pivot, that switches to heapsort
+   for a partition once the partitioning has gone 2 lg n levels
+   deep, which bounds the worst case, and leaves small partitions
+   to insertion sort. */
 void
 sort (void *array, size_t cnt, size_t size,
       int (*compare) (const void *, const void *, void *aux),
       void *aux) 
 {
-  size_t i;
+  int depth = 0;
+  size_t n;
 
   ASSERT (array != NULL || cnt == 0);
   ASSERT (compare != NULL);
   ASSERT (size > 0);
 
-  /* Build a heap. */
-  for (i = cnt / 2; i > 0; i--)
-    heapify (array, i, cnt, size, compare, aux);
-
-  /* Sort the heap. */
-  for (i = cnt; i > 1; i--) 
-    {
-      do_swap (array, 1, i, size);
-      heapify (array, 1, i - 1, size, compare, aux); 
-    }
+  for (n = cnt; n > 1; n /= 2)
+    depth += 2;
+  intro_sort (array, cnt, size, compare, aux, depth);
 }
 
 /* Searches ARRAY, which contains CNT elements of SIZE bytes
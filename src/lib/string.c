@@ -1,8 +1,34 @@
 #include <string.h>
 #include <debug.h>
+#include <stdint.h>
+
+/* Copies shorter than this are done a byte at a time, because
+   aligning and setting up a string instruction costs more than
+   it saves. */
+#define WORD_COPY_MIN 16
+
+/* A word that may alias any object, for the word-at-a-time
+   comparisons and scans below.  x86 allows loads of it to be
+   unaligned. */
+typedef uint32_t alias_word __attribute__ ((may_alias));
+
+/* A word with each byte set to 1. */
+#define ONES ((uint32_t) 0x01010101)
+
+/* Returns nonzero if any byte of W is zero.  Subtracting 1 from
+   each byte borrows into the byte's top bit only if the byte
+   was zero (or already had its top bit set, which ~W rules
+   out). */
+static inline uint32_t
+has_zero (uint32_t w)
+{
+  return (w - ONES) & ~w & (ONES << 7);
+}
 
 /* Copies SIZE bytes from SRC to DST, which must not overlap.
-   Returns DST. */
+   Returns DST.  Bytes are copied one at a time until DST is
+   word-aligned, then a word at a time with "rep movsl", then the
+   remaining tail a byte at a time. */
 void *
 memcpy (void *dst_, const void *src_, size_t size) 
 {
@@ -12,6 +38,20 @@ memcpy (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
+  if (size >= WORD_COPY_MIN)
+    {
+      size_t words;
+
+      while ((uintptr_t) dst % sizeof (uint32_t) != 0)
+        {
+          *dst++ = *src++;
+          size--;
+        }
+      words = size / sizeof (uint32_t);
+      size %= sizeof (uint32_t);
+      asm volatile ("rep movsl"
+                    : "+D" (dst), "+S" (src), "+c" (words) : : "memory");
+    }
   while (size-- > 0)
     *dst++ = *src++;
 
@@ -19,7 +59,9 @@ memcpy (void *dst_, const void *src_, size_t size)
 }
 
 /* Copies SIZE bytes from SRC to DST, which are allowed to
-   overlap.  Returns DST. */
+   overlap.  Returns DST.  Unless DST overlaps the end of SRC,
+   this is just memcpy(); otherwise the copy runs backward, in
+   words where it can, as in memcpy(). */
 void *
 memmove (void *dst_, const void *src_, size_t size) 
 {
@@ -29,26 +71,41 @@ memmove (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
-  if (dst < src) 
-    {
-      while (size-- > 0)
-        *dst++ = *src++;
-    }
-  else 
+  if (dst <= src || dst >= src + size)
+    return memcpy (dst_, src_, size);
+
+  dst += size;
+  src += size;
+  if (size >= WORD_COPY_MIN)
     {
-      dst += size;
-      src += size;
-      while (size-- > 0)
-        *--dst = *--src;
+      size_t words;
+
+      while ((uintptr_t) dst % sizeof (uint32_t) != 0)
+        {
+          *--dst = *--src;
+          size--;
+        }
+      words = size / sizeof (uint32_t);
+      size %= sizeof (uint32_t);
+      dst -= sizeof (uint32_t);
+      src -= sizeof (uint32_t);
+      asm volatile ("std; rep movsl; cld"
+                    : "+D" (dst), "+S" (src), "+c" (words) : : "memory");
+      dst += sizeof (uint32_t);
+      src += sizeof (uint32_t);
     }
+  while (size-- > 0)
+    *--dst = *--src;
 
-  return dst;
+  return dst_;
 }
 
 /* Find the first differing byte in the two blocks of SIZE bytes
    at A and B.  Returns a positive value if the byte in A is
    greater, a negative value if the byte in B is greater, or zero
-   if blocks A and B are equal. */
+   if blocks A and B are equal.  Equal words are skipped a word
+   at a time; the first differing word is then compared byte by
+   byte. */
 int
 memcmp (const void *a_, const void *b_, size_t size) 
 {
@@ -58,6 +115,13 @@ memcmp (const void *a_, const void *b_, size_t size)
   ASSERT (a != NULL || size == 0);
   ASSERT (b != NULL || size == 0);
 
+  while (size >= sizeof (uint32_t)
+         && *(const alias_word *) a == *(const alias_word *) b)
+    {
+      a += sizeof (uint32_t);
+      b += sizeof (uint32_t);
+      size -= sizeof (uint32_t);
+    }
   for (; size-- > 0; a++, b++)
     if (*a != *b)
       return *a > *b ? +1 : -1;
@@ -95,9 +159,17 @@ memchr (const void *block_, int ch_, size_t size)
 {
   const unsigned char *block = block_;
   unsigned char ch = ch_;
+  uint32_t pattern = ch * ONES;
 
   ASSERT (block != NULL || size == 0);
 
+  /* Skip words without CH in them. */
+  while (size >= sizeof (uint32_t)
+         && !has_zero (*(const alias_word *) block ^ pattern))
+    {
+      block += sizeof (uint32_t);
+      size -= sizeof (uint32_t);
+    }
   for (; size-- > 0; block++)
     if (*block == ch)
       return (void *) block;
@@ -274,7 +346,8 @@ strtok_r (char *s, const char *delimiters, char **save_ptr)
   return token;
 }
 
-/* Sets the SIZE bytes in DST to VALUE. */
+/* Sets the SIZE bytes in DST to VALUE.  Like memcpy(), stores
+   whole words with "rep stosl" once DST is aligned. */
 void *
 memset (void *dst_, int value, size_t size) 
 {
@@ -282,6 +355,21 @@ memset (void *dst_, int value, size_t size)
 
   ASSERT (dst != NULL || size == 0);
   
+  if (size >= WORD_COPY_MIN)
+    {
+      uint32_t word = (unsigned char) value * 0x01010101u;
+      size_t words;
+
+      while ((uintptr_t) dst % sizeof (uint32_t) != 0)
+        {
+          *dst++ = value;
+          size--;
+        }
+      words = size / sizeof (uint32_t);
+      size %= sizeof (uint32_t);
+      asm volatile ("rep stosl"
+                    : "+D" (dst), "+c" (words) : "a" (word) : "memory");
+    }
   while (size-- > 0)
     *dst++ = value;
 
@@ -296,8 +384,16 @@ strlen (const char *string)
 
   ASSERT (string != NULL);
 
-  for (p = string; *p != '\0'; p++)
-    continue;
+  /* Check bytes up to a word boundary, then whole aligned words,
+     which cannot cross into an unmapped page, until one contains
+     the null terminator. */
+  for (p = string; (uintptr_t) p % sizeof (uint32_t) != 0; p++)
+    if (*p == '\0')
+      return p - string;
+  while (!has_zero (*(const alias_word *) p))
+    p += sizeof (uint32_t);
+  while (*p != '\0')
+    p++;
   return p - string;
 }
 
@@ -306,10 +402,22 @@ strlen (const char *string)
 size_t
 strnlen (const char *string, size_t maxlen) 
 {
-  size_t length;
+  size_t length = 0;
 
-  for (length = 0; string[length] != '\0' && length < maxlen; length++)
-    continue;
+  /* As in strlen(), but never looking at a word that lies wholly
+     past MAXLEN. */
+  while (length < maxlen
+         && (uintptr_t) (string + length) % sizeof (uint32_t) != 0)
+    {
+      if (string[length] == '\0')
+        return length;
+      length++;
+    }
+  while (length + sizeof (uint32_t) <= maxlen
+         && !has_zero (*(const alias_word *) (string + length)))
+    length += sizeof (uint32_t);
+  while (length < maxlen && string[length] != '\0')
+    length++;
   return length;
 }
 
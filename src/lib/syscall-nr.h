@@ -28,7 +28,54 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_PREAD,                  /* Read from a file at a given offset. */
+    SYS_PWRITE,                 /* Write to a file at a given offset. */
+    SYS_READV,                  /* Read from a file into several buffers. */
+    SYS_WRITEV,                 /* Write to a file from several buffers. */
+    SYS_FSYNC,                  /* Write a file's changes to disk. */
+    SYS_SYNC,                   /* Write all file system changes to disk. */
+    SYS_THREADSTATS,            /* Get scheduling statistics. */
+    SYS_MEMSTATS,               /* Get kernel memory statistics. */
+    SYS_FORK,                   /* Duplicate the calling process. */
+    SYS_VMSTATS,                /* Get virtual memory statistics. */
+    SYS_SCSTATS,                /* Get system call statistics. */
+    SYS_RING_SETUP,             /* Register a system call ring. */
+    SYS_RING_ENTER,             /* Make the calls queued on the ring. */
+    SYS_COPY_FILE_RANGE,        /* Copy bytes from one file to another. */
+    SYS_INTRSTATS,              /* Get interrupt statistics. */
+    SYS_CLOCK_NS,               /* Read the high-resolution clock. */
+    SYS_SET_CANONICAL,          /* Turn line-at-a-time input on or off. */
+    SYS_IOSTATS,                /* Get file system device statistics. */
+    SYS_SET_AFFINITY,           /* Choose the CPUs a process may run on. */
+    SYS_GET_AFFINITY,           /* Get the CPUs a process may run on. */
+    SYS_FUTEX_WAIT,             /* Sleep if a word holds a value. */
+    SYS_FUTEX_WAKE,             /* Wake threads sleeping on a word. */
+    SYS_UTHREAD_CREATE,         /* Start a thread in this process. */
+    SYS_UTHREAD_JOIN,           /* Wait for a thread to exit. */
+    SYS_UTHREAD_EXIT,           /* End the calling thread. */
+    SYS_PIPE,                   /* Make a pipe. */
+    SYS_SHM_MAP,                /* Map a shared memory segment. */
+    SYS_SBRK,                   /* Grow or shrink the heap. */
+    SYS_GETDENTS,               /* Read many directory entries. */
+    SYS_STAT,                   /* Get a file's details by name. */
+    SYS_AIO_READ,               /* Queue an asynchronous read. */
+    SYS_AIO_WRITE,              /* Queue an asynchronous write. */
+    SYS_AIO_REAP,               /* Collect finished transfers. */
+    SYS_SET_DIRECT,             /* Bypass the buffer cache for a file. */
+    SYS_FALLOCATE,              /* Reserve disk space for a file. */
+    SYS_SET_EDF,                /* Reserve CPU time by deadline. */
+    SYS_WAIT_STATS,             /* Wait, getting the child's usage. */
+    SYS_MSLEEP,                 /* Sleep for some milliseconds. */
+    SYS_SET_LIMIT,              /* Cap a process's use of a resource. */
+    SYS_GET_LIMIT,              /* Get a process's cap on a resource. */
+    SYS_SNAPSHOT,               /* Save the process to start copies. */
+    SYS_EXEC_SNAPSHOT,          /* Start a process from a snapshot. */
+    SYS_SNAPSHOT_DROP,          /* Free a snapshot. */
+    SYS_SPAWN,                  /* Start a process with file actions. */
+    SYS_WAIT_ANY                /* Wait for whichever child exits. */
   };
 
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,21 @@
+#ifndef __LIB_SYSCALL_STATS_H
+#define __LIB_SYSCALL_STATS_H
+
+#include <stdint.h>
+
+/* Number of latency histogram buckets.  Bucket 0 counts calls
+   that took under 2**10 CPU cycles, bucket I under 2**(I + 10)
+   cycles, and the last bucket everything longer. */
+#define SYSCALL_LATENCY_BUCKETS 16
+
+/* Statistics for one system call, as kept by the kernel for the
+   whole system and, with the "-sctrace" kernel option, for each
+   process, and as returned by the scstats() system call. */
+struct syscall_stats
+  {
+    uint64_t cnt;               /* Number of calls. */
+    uint64_t cycles;            /* CPU cycles spent in them. */
+    unsigned latency[SYSCALL_LATENCY_BUCKETS]; /* Latency histogram. */
+  };
+
+#endif /* lib/syscall-stats.h */
@@ -0,0 +1,23 @@
+#ifndef __LIB_THREAD_STATS_H
+#define __LIB_THREAD_STATS_H
+
+#include <stdint.h>
+
+/* Number of ready-to-running latency histogram buckets.  Bucket
+   0 counts latencies under 2**10 CPU cycles, bucket I under
+   2**(I + 10) cycles, and the last bucket everything longer. */
+#define THREAD_LATENCY_BUCKETS 16
+
+/* Per-thread scheduling statistics, as kept by the kernel and
+   returned by the threadstats() system call. */
+struct thread_stats
+  {
+    int64_t run_ticks;          /* Timer ticks spent running. */
+    unsigned vol_switches;      /* Switches away while blocking. */
+    unsigned invol_switches;    /* Switches away while still ready. */
+    uint64_t ready_cycles;      /* CPU cycles spent ready, not running. */
+    unsigned latency[THREAD_LATENCY_BUCKETS]; /* Ready-to-running
+                                                 latency histogram. */
+  };
+
+#endif /* lib/thread-stats.h */
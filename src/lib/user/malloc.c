@@ -0,0 +1,307 @@
+#include <malloc.h>
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+
+/* A simple implementation of malloc() for user programs.
+
+   Each block starts with a header giving its size.  Blocks of up
+   to SMALL_MAX bytes, header included, come in power-of-2 size
+   classes, each with a free list.  An empty list is refilled
+   with a batch of blocks at once, carved from the heap.  Bigger
+   blocks are a multiple of ALIGN bytes and go on a list of their
+   own when freed, to be reused by a request they fit without
+   wasting more than half of them.  Blocks are never coalesced or
+   given back to the kernel.
+
+   The heap grows with sbrk() by at least CHUNK_SIZE bytes at a
+   time, so that most calls to malloc() make no system call.
+
+   Threads this process starts with uthread_create() share the
+   heap, so one lock guards all of it.  The lock takes a single
+   atomic exchange when it is free and sleeps on a futex when it
+   is not.  There is no thread-local storage for per-thread
+   caches to live in, and with one CPU running the lock is
+   seldom contended anyway. */
+
+/* Alignment of the blocks returned. */
+#define ALIGN 16
+
+/* Smallest and largest size classes, in bytes. */
+#define SMALL_MIN 16
+#define SMALL_MAX 2048
+#define CLASS_CNT 8             /* log2 (SMALL_MAX / SMALL_MIN) + 1. */
+
+/* Bytes of blocks carved at once to refill a size class. */
+#define BATCH_SIZE 4096
+
+/* Least the heap grows by at once. */
+#define CHUNK_SIZE (16 * 4096)
+
+/* Checks that a header belongs to a block from malloc(). */
+#define BLOCK_MAGIC 0x9a548eed
+
+/* Header of a block.  A free block's first bytes after it hold
+   the next free block of its list. */
+struct block
+  {
+    size_t size;                /* Bytes in the block, with header. */
+    unsigned magic;             /* BLOCK_MAGIC. */
+    uint8_t pad[ALIGN - sizeof (size_t) - sizeof (unsigned)];
+  };
+
+/* A free block. */
+struct free_block
+  {
+    struct block hdr;
+    struct free_block *next;    /* Next in its free list. */
+  };
+
+static struct free_block *small_free[CLASS_CNT]; /* By size class. */
+static struct free_block *large_free;            /* Bigger blocks. */
+static uint8_t *heap_next, *heap_end;            /* Not yet carved. */
+
+/* 0 if free, 1 if held, 2 if held and someone may be waiting. */
+static int heap_lock;
+
+static void lock_heap (void);
+static void unlock_heap (void);
+static int size_class (size_t size);
+static struct block *carve (size_t size);
+static struct block *alloc_small (int class);
+static struct block *alloc_large (size_t size);
+
+/* Obtains and returns a new block of at least SIZE bytes, or a
+   null pointer if memory is not available. */
+void *
+malloc (size_t size)
+{
+  struct block *b;
+  int class;
+
+  if (size == 0 || size > SIZE_MAX - 2 * ALIGN - sizeof *b)
+    return NULL;
+  size += sizeof *b;
+  class = size_class (size);
+
+  lock_heap ();
+  b = class >= 0 ? alloc_small (class) : alloc_large (ROUND_UP (size, ALIGN));
+  unlock_heap ();
+  if (b == NULL)
+    return NULL;
+  b->magic = BLOCK_MAGIC;
+  return b + 1;
+}
+
+/* Allocates and returns A times B bytes initialized to zeros.
+   Returns a null pointer if memory is not available. */
+void *
+calloc (size_t a, size_t b)
+{
+  void *p;
+  size_t size;
+
+  size = a * b;
+  if (b != 0 && size / b != a)
+    return NULL;
+
+  p = malloc (size);
+  if (p != NULL)
+    memset (p, 0, size);
+  return p;
+}
+
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
+   moving it in the process.  If successful, returns the new
+   block; on failure, returns a null pointer.  A call with null
+   OLD_BLOCK is equivalent to malloc(NEW_SIZE).  A call with zero
+   NEW_SIZE is equivalent to free(OLD_BLOCK). */
+void *
+realloc (void *old_block, size_t new_size)
+{
+  struct block *b;
+  size_t old_size;
+  void *new_block;
+
+  if (new_size == 0)
+    {
+      free (old_block);
+      return NULL;
+    }
+  if (old_block == NULL)
+    return malloc (new_size);
+
+  b = (struct block *) old_block - 1;
+  ASSERT (b->magic == BLOCK_MAGIC);
+  old_size = b->size - sizeof *b;
+  if (new_size <= old_size)
+    return old_block;
+
+  new_block = malloc (new_size);
+  if (new_block != NULL)
+    {
+      memcpy (new_block, old_block, old_size);
+      free (old_block);
+    }
+  return new_block;
+}
+
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void
+free (void *p)
+{
+  struct free_block *f;
+  int class;
+
+  if (p == NULL)
+    return;
+  f = (struct free_block *) ((struct block *) p - 1);
+  ASSERT (f->hdr.magic == BLOCK_MAGIC);
+  f->hdr.magic = 0;
+  class = size_class (f->hdr.size);
+
+  lock_heap ();
+  if (class >= 0)
+    {
+      f->next = small_free[class];
+      small_free[class] = f;
+    }
+  else
+    {
+      f->next = large_free;
+      large_free = f;
+    }
+  unlock_heap ();
+}
+
+/* Atomically stores NEW in *P and returns its old value. */
+static inline int
+exchange (int *p, int new)
+{
+  asm volatile ("xchgl %0, %1" : "+r" (new), "+m" (*p) : : "memory");
+  return new;
+}
+
+/* Acquires heap_lock, sleeping until it is free. */
+static void
+lock_heap (void)
+{
+  if (exchange (&heap_lock, 1) != 0)
+    while (exchange (&heap_lock, 2) != 0)
+      futex_wait (&heap_lock, 2);
+}
+
+/* Releases heap_lock, waking a waiter if there may be one. */
+static void
+unlock_heap (void)
+{
+  if (exchange (&heap_lock, 0) == 2)
+    futex_wake (&heap_lock, 1);
+}
+
+/* Returns the size class for a block of SIZE bytes, header
+   included, or -1 if it is too big for one. */
+static int
+size_class (size_t size)
+{
+  size_t class_size = SMALL_MIN;
+  int class = 0;
+
+  if (size > SMALL_MAX)
+    return -1;
+  while (class_size < size)
+    {
+      class_size *= 2;
+      class++;
+    }
+  return class;
+}
+
+/* Takes SIZE bytes, a multiple of ALIGN, from the heap, growing
+   it if needed, and returns them as a block, or a null pointer
+   if sbrk() fails.  heap_lock must be held. */
+static struct block *
+carve (size_t size)
+{
+  struct block *b;
+
+  if ((size_t) (heap_end - heap_next) < size)
+    {
+      size_t grow = ROUND_UP (size > CHUNK_SIZE ? size : CHUNK_SIZE, 4096);
+      uint8_t *p = sbrk (grow);
+
+      if (p == (void *) -1)
+        return NULL;
+      if (p != heap_end)
+        {
+          /* Someone else moved the break.  Start over at the new
+             memory, leaving what was left of the old. */
+          heap_next = (uint8_t *) ROUND_UP ((uintptr_t) p, ALIGN);
+          if ((size_t) (p + grow - heap_next) < size)
+            {
+              heap_end = p + grow;
+              return carve (size);
+            }
+        }
+      heap_end = p + grow;
+    }
+
+  b = (struct block *) heap_next;
+  heap_next += size;
+  b->size = size;
+  return b;
+}
+
+/* Returns a block of size class CLASS, or a null pointer if
+   memory is not available.  heap_lock must be held. */
+static struct block *
+alloc_small (int class)
+{
+  size_t size = (size_t) SMALL_MIN << class;
+  struct free_block *f;
+
+  if (small_free[class] == NULL)
+    {
+      /* Refill with a batch, stopping early if the heap can't
+         grow. */
+      size_t i;
+
+      for (i = 0; i < BATCH_SIZE / size || i == 0; i++)
+        {
+          struct free_block *g = (struct free_block *) carve (size);
+          if (g == NULL)
+            break;
+          g->next = small_free[class];
+          small_free[class] = g;
+        }
+      if (small_free[class] == NULL)
+        return NULL;
+    }
+
+  f = small_free[class];
+  small_free[class] = f->next;
+  return &f->hdr;
+}
+
+/* Returns a block of at least SIZE bytes, a multiple of ALIGN
+   bigger than SMALL_MAX, or a null pointer if memory is not
+   available.  heap_lock must be held. */
+static struct block *
+alloc_large (size_t size)
+{
+  struct free_block **fp;
+
+  for (fp = &large_free; *fp != NULL; fp = &(*fp)->next)
+    {
+      struct free_block *f = *fp;
+      if (f->hdr.size >= size && f->hdr.size / 2 <= size)
+        {
+          *fp = f->next;
+          return &f->hdr;
+        }
+    }
+  return carve (size);
+}
@@ -1,16 +1,54 @@
 #include <syscall.h>
+#include <vdata.h>
 #include "../syscall-nr.h"
 
+#define STRINGIFY(X) #X
+#define XSTRINGIFY(X) STRINGIFY (X)
+
+/* Enters the kernel for a system call whose number and arguments
+   are on the stack just above the return address, leaving the
+   return value in EAX and clobbering ECX and EDX.
+
+   SYSCALL_ENTRY starts out pointing to syscall_probe, which
+   points it to syscall_sysenter if the kernel has turned on
+   SYSENTER, as it says in the vdata page, or to syscall_int if
+   not, and then jumps there.  syscall_sysenter
+   passes the kernel the address to return to in EDX and the
+   stack pointer to return with in ECX, which it sets so that the
+   kernel sees the same stack that "int $0x30" would show it.
+   See userprog/sysenter.S. */
+asm (".data\n"
+     ".align 4\n"
+     "syscall_entry:\n"
+     "    .long syscall_probe\n"
+     ".text\n"
+     "syscall_probe:\n"
+     "    movl $syscall_int, %eax\n"
+     "    cmpl $0, " XSTRINGIFY (VDATA_SYSENTER_ADDR) "\n"
+     "    je 1f\n"
+     "    movl $syscall_sysenter, %eax\n"
+     "1:  movl %eax, syscall_entry\n"
+     "    jmp *%eax\n"
+     "syscall_sysenter:\n"
+     "    movl (%esp), %edx\n"
+     "    leal 4(%esp), %ecx\n"
+     "    sysenter\n"
+     "syscall_int:\n"
+     "    popl %edx\n"
+     "    int $0x30\n"
+     "    jmp *%edx\n");
+
 /* Invokes syscall NUMBER, passing no arguments, and returns the
    return value as an `int'. */
 #define syscall0(NUMBER)                                        \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
-            ("pushl %[number]; int $0x30; addl $4, %%esp"       \
+            ("pushl %[number]; call *syscall_entry; "           \
+             "addl $4, %%esp"                                   \
                : "=a" (retval)                                  \
                : [number] "i" (NUMBER)                          \
-               : "memory");                                     \
+               : "ecx", "edx", "memory");                       \
           retval;                                               \
         })
 
@@ -20,11 +58,12 @@
         ({                                                               \
           int retval;                                                    \
           asm volatile                                                   \
-            ("pushl %[arg0]; pushl %[number]; int $0x30; addl $8, %%esp" \
+            ("pushl %[arg0]; pushl %[number]; "                          \
+             "call *syscall_entry; addl $8, %%esp"                       \
                : "=a" (retval)                                           \
                : [number] "i" (NUMBER),                                  \
                  [arg0] "g" (ARG0)                                       \
-               : "memory");                                              \
+               : "ecx", "edx", "memory");                                \
           retval;                                                        \
         })
 
@@ -35,12 +74,13 @@
           int retval;                                           \
           asm volatile                                          \
             ("pushl %[arg1]; pushl %[arg0]; "                   \
-             "pushl %[number]; int $0x30; addl $12, %%esp"      \
+             "pushl %[number]; call *syscall_entry; "           \
+             "addl $12, %%esp"                                  \
                : "=a" (retval)                                  \
                : [number] "i" (NUMBER),                         \
                  [arg0] "r" (ARG0),                             \
                  [arg1] "r" (ARG1)                              \
-               : "memory");                                     \
+               : "ecx", "edx", "memory");                       \
           retval;                                               \
         })
 
@@ -51,13 +91,34 @@
           int retval;                                           \
           asm volatile                                          \
             ("pushl %[arg2]; pushl %[arg1]; pushl %[arg0]; "    \
-             "pushl %[number]; int $0x30; addl $16, %%esp"      \
+             "pushl %[number]; call *syscall_entry; "           \
+             "addl $16, %%esp"                                  \
                : "=a" (retval)                                  \
                : [number] "i" (NUMBER),                         \
                  [arg0] "r" (ARG0),                             \
                  [arg1] "r" (ARG1),                             \
                  [arg2] "r" (ARG2)                              \
-               : "memory");                                     \
+               : "ecx", "edx", "memory");                       \
+          retval;                                               \
+        })
+
+/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, ARG2,
+   and ARG3, and returns the return value as an `int'. */
+#define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg3]; pushl %[arg2]; pushl %[arg1]; "    \
+             "pushl %[arg0]; "                                  \
+             "pushl %[number]; call *syscall_entry; "           \
+             "addl $20, %%esp"                                  \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "r" (ARG0),                             \
+                 [arg1] "r" (ARG1),                             \
+                 [arg2] "r" (ARG2),                             \
+                 [arg3] "r" (ARG3)                              \
+               : "ecx", "edx", "memory");                       \
           retval;                                               \
         })
 
@@ -153,6 +214,12 @@ munmap (mapid_t mapid)
   syscall1 (SYS_MUNMAP, mapid);
 }
 
+pid_t
+fork (void)
+{
+  return syscall0 (SYS_FORK);
+}
+
 bool
 chdir (const char *dir)
 {
@@ -182,3 +249,324 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+int
+pread (int fd, void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PREAD, fd, buffer, size, offset);
+}
+
+int
+pwrite (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PWRITE, fd, buffer, size, offset);
+}
+
+int
+readv (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_READV, fd, iov, iovcnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_WRITEV, fd, iov, iovcnt);
+}
+
+bool
+fsync (int fd)
+{
+  return syscall1 (SYS_FSYNC, fd);
+}
+
+void
+sync (void)
+{
+  syscall0 (SYS_SYNC);
+}
+
+void
+threadstats (struct thread_stats *stats)
+{
+  syscall1 (SYS_THREADSTATS, stats);
+}
+
+void
+memstats (struct mem_stats *stats)
+{
+  syscall1 (SYS_MEMSTATS, stats);
+}
+
+void
+vmstats (struct vm_stats *stats)
+{
+  syscall1 (SYS_VMSTATS, stats);
+}
+
+bool
+scstats (int nr, bool global, struct syscall_stats *stats)
+{
+  return syscall3 (SYS_SCSTATS, nr, (int) global, stats);
+}
+
+bool
+ring_setup (struct io_ring *ring)
+{
+  return syscall1 (SYS_RING_SETUP, ring);
+}
+
+int
+ring_enter (void)
+{
+  return syscall0 (SYS_RING_ENTER);
+}
+
+int
+copy_file_range (int fd_in, int fd_out, unsigned length)
+{
+  return syscall3 (SYS_COPY_FILE_RANGE, fd_in, fd_out, length);
+}
+
+bool
+intrstats (int idx, bool off, struct intr_stats *stats)
+{
+  return syscall3 (SYS_INTRSTATS, idx, (int) off, stats);
+}
+
+/* Copies the kernel's vdata page into *V, trying again if the
+   kernel updates it meanwhile. */
+static void
+read_vdata (struct vdata *v)
+{
+  const volatile struct vdata *page = (const volatile struct vdata *)
+                                      VDATA_ADDR;
+  uint32_t seq;
+
+  do
+    {
+      seq = page->seq;
+      asm volatile ("" : : : "memory");
+      v->tick_freq = page->tick_freq;
+      v->ticks = page->ticks;
+      v->tsc_hz = page->tsc_hz;
+      v->tsc_base = page->tsc_base;
+      asm volatile ("" : : : "memory");
+    }
+  while ((seq & 1) != 0 || page->seq != seq);
+}
+
+/* Reads the high-resolution clock from the TSC, using the rate
+   the kernel measured, without entering the kernel. */
+uint64_t
+clock_ns (void)
+{
+  struct vdata v;
+  uint64_t cycles, ns;
+
+  read_vdata (&v);
+  if (v.tsc_hz == 0)
+    {
+      syscall1 (SYS_CLOCK_NS, &ns);
+      return ns;
+    }
+  asm volatile ("rdtsc" : "=A" (cycles));
+  cycles -= v.tsc_base;
+  return (cycles / v.tsc_hz * 1000000000
+          + cycles % v.tsc_hz * 1000000000 / v.tsc_hz);
+}
+
+/* Returns the number of timer ticks since the kernel booted,
+   without entering the kernel. */
+int64_t
+clock_ticks (void)
+{
+  struct vdata v;
+
+  read_vdata (&v);
+  return v.ticks;
+}
+
+bool
+set_canonical (bool on)
+{
+  return syscall1 (SYS_SET_CANONICAL, (int) on);
+}
+
+void
+iostats (struct io_stats *stats)
+{
+  syscall1 (SYS_IOSTATS, stats);
+}
+
+bool
+set_affinity (unsigned cpu_mask)
+{
+  return syscall1 (SYS_SET_AFFINITY, cpu_mask);
+}
+
+unsigned
+get_affinity (void)
+{
+  return syscall0 (SYS_GET_AFFINITY);
+}
+
+int
+futex_wait (const int *addr, int val)
+{
+  return syscall2 (SYS_FUTEX_WAIT, addr, val);
+}
+
+int
+futex_wake (const int *addr, int cnt)
+{
+  return syscall2 (SYS_FUTEX_WAKE, addr, cnt);
+}
+
+/* Where a thread made by uthread_create() starts. */
+static void
+uthread_start (void (*func) (void *), void *aux)
+{
+  func (aux);
+  uthread_exit (0);
+}
+
+tid_t
+uthread_create (void (*func) (void *), void *aux)
+{
+  return syscall3 (SYS_UTHREAD_CREATE, uthread_start, func, aux);
+}
+
+int
+uthread_join (tid_t tid)
+{
+  return syscall1 (SYS_UTHREAD_JOIN, tid);
+}
+
+void
+uthread_exit (int status)
+{
+  syscall1 (SYS_UTHREAD_EXIT, status);
+  NOT_REACHED ();
+}
+
+bool
+pipe (int fds[2])
+{
+  return syscall1 (SYS_PIPE, fds);
+}
+
+mapid_t
+shm_map (const char *name, unsigned size, void *addr)
+{
+  return syscall3 (SYS_SHM_MAP, name, size, addr);
+}
+
+void *
+sbrk (intptr_t increment)
+{
+  return (void *) syscall1 (SYS_SBRK, increment);
+}
+
+int
+getdents (int fd, struct dirent *ents, int cnt)
+{
+  return syscall3 (SYS_GETDENTS, fd, ents, cnt);
+}
+
+bool
+stat (const char *file, struct stat *st)
+{
+  return syscall2 (SYS_STAT, file, st);
+}
+
+bool
+aio_read (const struct aiocb *cb)
+{
+  return syscall1 (SYS_AIO_READ, cb);
+}
+
+bool
+aio_write (const struct aiocb *cb)
+{
+  return syscall1 (SYS_AIO_WRITE, cb);
+}
+
+int
+aio_reap (struct io_cqe *cqes, int cnt, bool wait)
+{
+  return syscall3 (SYS_AIO_REAP, cqes, cnt, (int) wait);
+}
+
+bool
+set_direct (int fd, bool on)
+{
+  return syscall2 (SYS_SET_DIRECT, fd, (int) on);
+}
+
+bool
+fallocate (int fd, unsigned offset, unsigned length)
+{
+  return syscall3 (SYS_FALLOCATE, fd, offset, length);
+}
+
+bool
+set_edf (unsigned runtime, unsigned period, unsigned deadline)
+{
+  return syscall3 (SYS_SET_EDF, runtime, period, deadline);
+}
+
+int
+wait_stats (pid_t pid, struct proc_stats *stats)
+{
+  return syscall2 (SYS_WAIT_STATS, pid, stats);
+}
+
+void
+msleep (unsigned ms)
+{
+  syscall1 (SYS_MSLEEP, ms);
+}
+
+bool
+set_limit (int resource, unsigned limit)
+{
+  return syscall2 (SYS_SET_LIMIT, resource, limit);
+}
+
+unsigned
+get_limit (int resource)
+{
+  return syscall1 (SYS_GET_LIMIT, resource);
+}
+
+pid_t
+spawn (const char *cmd_line, const struct spawn_action *actions,
+       int action_cnt, const char *cwd)
+{
+  return syscall4 (SYS_SPAWN, cmd_line, actions, action_cnt, cwd);
+}
+
+int
+snapshot (const char *name)
+{
+  return syscall1 (SYS_SNAPSHOT, name);
+}
+
+pid_t
+exec_snapshot (const char *name)
+{
+  return syscall1 (SYS_EXEC_SNAPSHOT, name);
+}
+
+bool
+snapshot_drop (const char *name)
+{
+  return syscall1 (SYS_SNAPSHOT_DROP, name);
+}
+
+pid_t
+wait_any (int *status)
+{
+  return syscall1 (SYS_WAIT_ANY, status);
+}
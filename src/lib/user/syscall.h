@@ -2,12 +2,31 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <aio.h>
 #include <debug.h>
+#include <dirent.h>
+#include <intr-stats.h>
+#include <io-stats.h>
+#include <iovec.h>
+#include <mem-stats.h>
+#include <proc-limits.h>
+#include <proc-stats.h>
+#include <spawn.h>
+#include <stat.h>
+#include <thread-stats.h>
+#include <io-ring.h>
+#include <syscall-stats.h>
+#include <vm-stats.h>
 
 /* Process identifier. */
 typedef int pid_t;
 #define PID_ERROR ((pid_t) -1)
 
+/* Thread identifier. */
+typedef int tid_t;
+#define TID_ERROR ((tid_t) -1)
+
 /* Map region identifier. */
 typedef int mapid_t;
 #define MAP_FAILED ((mapid_t) -1)
@@ -37,6 +56,11 @@ void close (int fd);
 /* Project 3 and optionally project 4. */
 mapid_t mmap (int fd, void *addr);
 void munmap (mapid_t);
+pid_t fork (void);
+mapid_t shm_map (const char *name, unsigned size, void *addr);
+int snapshot (const char *name);
+pid_t exec_snapshot (const char *name);
+bool snapshot_drop (const char *name);
 
 /* Project 4 only. */
 bool chdir (const char *dir);
@@ -45,4 +69,48 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+int pread (int fd, void *buffer, unsigned length, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+bool fsync (int fd);
+void sync (void);
+void threadstats (struct thread_stats *);
+void memstats (struct mem_stats *);
+void vmstats (struct vm_stats *);
+bool scstats (int nr, bool global, struct syscall_stats *);
+bool ring_setup (struct io_ring *);
+int ring_enter (void);
+int copy_file_range (int fd_in, int fd_out, unsigned length);
+bool intrstats (int idx, bool off, struct intr_stats *);
+uint64_t clock_ns (void);
+int64_t clock_ticks (void);
+bool set_canonical (bool on);
+void iostats (struct io_stats *);
+bool set_affinity (unsigned cpu_mask);
+unsigned get_affinity (void);
+int futex_wait (const int *addr, int val);
+int futex_wake (const int *addr, int cnt);
+tid_t uthread_create (void (*func) (void *), void *aux);
+int uthread_join (tid_t);
+void uthread_exit (int status) NO_RETURN;
+bool pipe (int fds[2]);
+void *sbrk (intptr_t increment);
+int getdents (int fd, struct dirent *, int cnt);
+bool stat (const char *file, struct stat *);
+bool aio_read (const struct aiocb *);
+bool aio_write (const struct aiocb *);
+int aio_reap (struct io_cqe *, int cnt, bool wait);
+bool set_direct (int fd, bool on);
+bool fallocate (int fd, unsigned offset, unsigned length);
+bool set_edf (unsigned runtime, unsigned period, unsigned deadline);
+int wait_stats (pid_t, struct proc_stats *);
+pid_t wait_any (int *status);
+void msleep (unsigned ms);
+bool set_limit (int resource, unsigned limit);
+unsigned get_limit (int resource);
+pid_t spawn (const char *cmd_line, const struct spawn_action *,
+             int action_cnt, const char *cwd);
+
 #endif /* lib/user/syscall.h */
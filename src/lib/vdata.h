@@ -0,0 +1,35 @@
+#ifndef __LIB_VDATA_H
+#define __LIB_VDATA_H
+
+#include <stdint.h>
+
+/* A page of kernel data that every process can read, without a
+   system call, at VDATA_ADDR.  The kernel maps the same page,
+   read-only, into each address space.
+
+   The kernel updates it from the timer interrupt, bumping SEQ
+   before and after each update, so SEQ is odd while an update
+   is under way.  A reader copies out what it needs between two
+   reads of SEQ and tries again unless both reads found the same
+   even value. */
+
+/* User virtual address of the page, just below where user
+   programs are linked. */
+#define VDATA_ADDR 0x08047000
+
+/* User virtual address of the vdata's `sysenter' member, for the
+   system call stubs in lib/user/syscall.c, which are written in
+   assembly. */
+#define VDATA_SYSENTER_ADDR 0x08047004
+
+struct vdata
+  {
+    uint32_t seq;               /* Update count, odd while updating. */
+    uint32_t sysenter;          /* Nonzero if SYSENTER may be used. */
+    uint32_t tick_freq;         /* Timer ticks per second. */
+    int64_t ticks;              /* Timer ticks since boot. */
+    uint64_t tsc_hz;            /* TSC cycles per second, or 0. */
+    uint64_t tsc_base;          /* TSC value at clock_ns() 0. */
+  };
+
+#endif /* lib/vdata.h */
@@ -0,0 +1,36 @@
+#ifndef __LIB_VM_STATS_H
+#define __LIB_VM_STATS_H
+
+#include <stdint.h>
+
+/* Virtual memory statistics, as returned by the vmstats() system
+   call.  Counts are since boot, except for the last two, which
+   describe the calling process. */
+struct vm_stats
+  {
+    /* Page faults. */
+    uint64_t fault_cnt;         /* Page faults taken. */
+    uint64_t invalid_cnt;       /* Faults that could not be resolved. */
+
+    /* Pages brought in on demand, by where they came from. */
+    uint64_t file_cnt;          /* Read from a file. */
+    uint64_t zero_cnt;          /* Zero-filled. */
+    uint64_t swap_cnt;          /* Read from swap. */
+    uint64_t stack_cnt;         /* Added by stack growth. */
+    uint64_t cow_cnt;           /* Copy-on-write pages written. */
+    uint64_t around_cnt;        /* Mapped around a fault. */
+
+    /* Frames and swap. */
+    uint64_t evict_cnt;         /* Frames evicted. */
+    uint64_t swap_write_cnt;    /* Pages written to swap. */
+    uint64_t swap_read_cnt;     /* Pages read from swap. */
+    unsigned frame_cnt;         /* Frames holding user pages. */
+    unsigned swap_slot_cnt;     /* Swap slots. */
+    unsigned swap_used_cnt;     /* Swap slots in use. */
+
+    /* Calling process. */
+    unsigned page_cnt;          /* Pages in its address space. */
+    unsigned resident_cnt;      /* Of those, pages in frames. */
+  };
+
+#endif /* lib/vm-stats.h */
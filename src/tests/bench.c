@@ -0,0 +1,151 @@
+#include "tests/bench.h"
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/arc4.h"
+#include "tests/cksum.h"
+#include "tests/lib.h"
+
+/* Prints result KEY, formatting its value with VALUE_FORMAT as
+   in printf(). */
+void
+bench_result (const char *key, const char *value_format, ...) 
+{
+  char value[32];
+  va_list args;
+
+  ASSERT (strchr (key, ' ') == NULL);
+  va_start (args, value_format);
+  vsnprintf (value, sizeof value, value_format, args);
+  va_end (args);
+  msg ("result %s %s", key, value);
+}
+
+/* Starts timer T. */
+void
+bench_timer_start (struct bench_timer *t) 
+{
+  t->start_ns = clock_ns ();
+}
+
+/* Returns the nanoseconds elapsed since T was started, but at
+   least 1, so that callers may divide by it. */
+uint64_t
+bench_timer_stop (const struct bench_timer *t) 
+{
+  uint64_t ns = clock_ns () - t->start_ns;
+  return ns != 0 ? ns : 1;
+}
+
+/* Returns the nanoseconds that ITERS iterations of F take. */
+static uint64_t
+time_iters (bench_func *f, void *aux, unsigned iters) 
+{
+  struct bench_timer t;
+
+  bench_timer_start (&t);
+  f (aux, iters);
+  return bench_timer_stop (&t);
+}
+
+/* Measures the operation that F performs.  After one iteration
+   to warm up caches and fault in pages, it doubles the number of
+   iterations until a run of them takes at least BENCH_SAMPLE_NS,
+   then takes BENCH_SAMPLES samples with that many iterations.
+   Reports the median, 90th percentile, and fastest time per
+   iteration as KEY_ns_p50, KEY_ns_p90, and KEY_ns_min, and the
+   iterations per sample as KEY_iters. */
+void
+bench_measure (const char *key, bench_func *f, void *aux) 
+{
+  uint64_t ns[BENCH_SAMPLES];
+  unsigned iters;
+  char name[64];
+  size_t i;
+
+  f (aux, 1);
+  for (iters = 1; iters < (1u << 20); iters *= 2)
+    if (time_iters (f, aux, iters) >= BENCH_SAMPLE_NS)
+      break;
+
+  for (i = 0; i < BENCH_SAMPLES; i++)
+    ns[i] = time_iters (f, aux, iters) / iters;
+
+  snprintf (name, sizeof name, "%s_iters", key);
+  bench_result (name, "%u", iters);
+  snprintf (name, sizeof name, "%s_ns_min", key);
+  bench_result (name, "%"PRIu64, bench_percentile (ns, BENCH_SAMPLES, 0));
+  snprintf (name, sizeof name, "%s_ns_p50", key);
+  bench_result (name, "%"PRIu64, bench_percentile (ns, BENCH_SAMPLES, 50));
+  snprintf (name, sizeof name, "%s_ns_p90", key);
+  bench_result (name, "%"PRIu64, bench_percentile (ns, BENCH_SAMPLES, 90));
+}
+
+static int
+compare_u64 (const void *a_, const void *b_) 
+{
+  const uint64_t *a = a_;
+  const uint64_t *b = b_;
+  return *a < *b ? -1 : *a > *b;
+}
+
+/* Sorts the CNT VALUES in place and returns their PCT'th
+   percentile, the smallest value that is at least as large as
+   PCT percent of them. */
+uint64_t
+bench_percentile (uint64_t *values, size_t cnt, unsigned pct) 
+{
+  size_t idx;
+
+  ASSERT (cnt > 0 && pct <= 100);
+  qsort (values, cnt, sizeof *values, compare_u64);
+  idx = (cnt * pct + 99) / 100;
+  return values[idx > 0 ? idx - 1 : 0];
+}
+
+/* Reports the 50th, 90th, and 99th percentile and the largest of
+   the CNT latencies in NS, in nanoseconds, as KEY_p50, KEY_p90,
+   KEY_p99, and KEY_max.  Sorts NS. */
+void
+bench_report_latencies (const char *key, uint64_t *ns, size_t cnt) 
+{
+  static const unsigned pcts[] = {50, 90, 99};
+  char name[64];
+  size_t i;
+
+  for (i = 0; i < sizeof pcts / sizeof *pcts; i++)
+    {
+      snprintf (name, sizeof name, "%s_p%u", key, pcts[i]);
+      bench_result (name, "%"PRIu64, bench_percentile (ns, cnt, pcts[i]));
+    }
+  snprintf (name, sizeof name, "%s_max", key);
+  bench_result (name, "%"PRIu64, bench_percentile (ns, cnt, 100));
+}
+
+/* Fills the SIZE bytes in BUF with pseudo-random data that
+   depends only on SEED and returns their checksum, for
+   bench_verify(). */
+unsigned long
+bench_data (void *buf, size_t size, unsigned seed) 
+{
+  struct arc4 arc4;
+
+  memset (buf, 0, size);
+  arc4_init (&arc4, &seed, sizeof seed);
+  arc4_crypt (&arc4, buf, size);
+  return cksum (buf, size);
+}
+
+/* Fails the benchmark, naming WHAT, unless the SIZE bytes in BUF
+   have checksum CKSUM. */
+void
+bench_verify (const void *buf, size_t size, unsigned long cksum_,
+              const char *what) 
+{
+  unsigned long actual = cksum (buf, size);
+  if (actual != cksum_)
+    fail ("%s has checksum %lu, expected %lu", what, actual, cksum_);
+}
@@ -0,0 +1,49 @@
+#ifndef TESTS_BENCH_H
+#define TESTS_BENCH_H
+
+#include <debug.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Benchmark harness for user programs.
+
+   Every result is printed as one line in the form
+
+     (TEST-NAME) result KEY VALUE
+
+   where KEY has no white space and VALUE is a decimal number,
+   which is what "make bench" and tests/bench-track parse.
+   Latencies are in nanoseconds unless KEY says otherwise. */
+
+void bench_result (const char *key, const char *value_format, ...)
+  PRINTF_FORMAT (2, 3);
+
+/* Times an interval on clock_ns(). */
+struct bench_timer
+  {
+    uint64_t start_ns;          /* clock_ns() at bench_timer_start(). */
+  };
+
+void bench_timer_start (struct bench_timer *);
+uint64_t bench_timer_stop (const struct bench_timer *);
+
+/* Performs ITERS iterations of the operation being measured,
+   with AUX as passed to bench_measure(). */
+typedef void bench_func (void *aux, unsigned iters);
+
+/* Minimum length of one timed sample taken by bench_measure(),
+   and the number of samples it takes. */
+#define BENCH_SAMPLE_NS 10000000
+#define BENCH_SAMPLES 11
+
+void bench_measure (const char *key, bench_func *, void *aux);
+
+uint64_t bench_percentile (uint64_t *values, size_t cnt, unsigned pct);
+void bench_report_latencies (const char *key, uint64_t *ns, size_t cnt);
+
+/* Reproducible test data. */
+unsigned long bench_data (void *, size_t, unsigned seed);
+void bench_verify (const void *, size_t, unsigned long cksum,
+                   const char *what);
+
+#endif /* tests/bench.h */
@@ -0,0 +1,112 @@
+/* Runs N child processes at once, where N is the first argument
+   (1 to 32), each of which does file system work in one of these
+   patterns:
+
+     - "disjoint": each child writes and reads back a file of its
+       own.
+
+     - "shared": each child writes and reads back its own part of
+       a single file that they all share.
+
+     - "dir": each child creates, opens, and removes files in a
+       directory that they all share.
+
+   Runs each pattern in turn, or just the one named by the
+   optional second argument.  Reports each pattern's aggregate
+   throughput and the distribution of the children's run times. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/filesys/bench/bench.h"
+#include "tests/filesys/bench/bench-contend.h"
+#include "tests/lib.h"
+
+const char *test_name = "bench-contend";
+
+static void
+run_pattern (const char *pattern, int child_cnt) 
+{
+  pid_t children[MAX_CHILDREN];
+  uint64_t child_ns[MAX_CHILDREN];
+  char name[32];
+  struct bench b;
+  int i;
+
+  /* Set up. */
+  if (!strcmp (pattern, "disjoint"))
+    for (i = 0; i < child_cnt; i++)
+      {
+        snprintf (name, sizeof name, "%s-%d", shared_file, i);
+        CHECK (create (name, 0), "create \"%s\"", name);
+      }
+  else if (!strcmp (pattern, "shared"))
+    CHECK (create (shared_file, 0), "create \"%s\"", shared_file);
+  else
+    CHECK (mkdir (shared_dir), "mkdir \"%s\"", shared_dir);
+
+  /* Run the children and collect the microseconds that each one
+     took, which it returns as its exit status. */
+  bench_start (&b, pattern);
+  for (i = 0; i < child_cnt; i++)
+    {
+      char cmd_line[64];
+      snprintf (cmd_line, sizeof cmd_line, "child-bench-contend %s %d",
+                pattern, i);
+      if ((children[i] = exec (cmd_line)) == PID_ERROR)
+        fail ("exec \"%s\" failed", cmd_line);
+    }
+  for (i = 0; i < child_cnt; i++)
+    {
+      int status = wait (children[i]);
+      if (status < 0)
+        fail ("child %d of %s failed", i, pattern);
+      child_ns[i] = (uint64_t) status * 1000;
+    }
+  if (!strcmp (pattern, "dir"))
+    bench_end (&b, 0, (uint64_t) child_cnt * DIR_FILES);
+  else
+    bench_end (&b, (uint64_t) child_cnt * CHILD_SIZE * 2, 0);
+  snprintf (name, sizeof name, "%s_child_ns", pattern);
+  bench_report_latencies (name, child_ns, child_cnt);
+
+  /* Clean up, to leave room for the next pattern. */
+  if (!strcmp (pattern, "disjoint"))
+    for (i = 0; i < child_cnt; i++)
+      {
+        snprintf (name, sizeof name, "%s-%d", shared_file, i);
+        CHECK (remove (name), "remove \"%s\"", name);
+      }
+  else if (!strcmp (pattern, "shared"))
+    CHECK (remove (shared_file), "remove \"%s\"", shared_file);
+  else
+    CHECK (remove (shared_dir), "remove \"%s\"", shared_dir);
+}
+
+int
+main (int argc, char *argv[]) 
+{
+  static const char *patterns[] = {"disjoint", "shared", "dir"};
+  int child_cnt;
+  size_t i;
+  bool found = false;
+
+  msg ("begin");
+  CHECK (argc == 2 || argc == 3, "argc must be 2 or 3, actually %d", argc);
+  child_cnt = atoi (argv[1]);
+  if (child_cnt < 1 || child_cnt > MAX_CHILDREN)
+    fail ("child count %s out of range 1...%d", argv[1], MAX_CHILDREN);
+  bench_result ("children", "%d", child_cnt);
+
+  for (i = 0; i < sizeof patterns / sizeof *patterns; i++)
+    if (argc == 2 || !strcmp (argv[2], patterns[i]))
+      {
+        run_pattern (patterns[i], child_cnt);
+        found = true;
+      }
+  if (!found)
+    fail ("unknown pattern \"%s\"", argv[2]);
+  msg ("end");
+  return 0;
+}
@@ -0,0 +1,20 @@
+#ifndef TESTS_FILESYS_BENCH_BENCH_CONTEND_H
+#define TESTS_FILESYS_BENCH_BENCH_CONTEND_H
+
+/* Most children that bench-contend may run at once. */
+#define MAX_CHILDREN 32
+
+/* Bytes each child writes and reads back in the "disjoint" and
+   "shared" patterns. */
+#define CHILD_SIZE (32 * 1024)
+
+/* Files each child creates, opens, and removes in the "dir"
+   pattern. */
+#define DIR_FILES 16
+
+/* Name of the file shared by all the children in the "shared"
+   pattern and of the directory shared in the "dir" pattern. */
+static const char shared_file[] = "contend";
+static const char shared_dir[] = "contend-dir";
+
+#endif /* tests/filesys/bench/bench-contend.h */
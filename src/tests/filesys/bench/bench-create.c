@@ -0,0 +1,48 @@
+/* Creates, writes, and removes many small files, in batches of
+   FILE_CNT at a time.  Reports the rate of creates and removes
+   combined. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/filesys/bench/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 20
+#define ROUND_CNT 10
+
+static char buf[512];
+
+void
+test_main (void) 
+{
+  struct bench b;
+  int round, i;
+
+  bench_start (&b, "create_unlink");
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      char name[16];
+
+      for (i = 0; i < FILE_CNT; i++)
+        {
+          int fd;
+
+          snprintf (name, sizeof name, "file%d", i);
+          if (!create (name, 0))
+            fail ("create \"%s\" failed", name);
+          if ((fd = open (name)) < 2)
+            fail ("open \"%s\" failed", name);
+          if (write (fd, buf, sizeof buf) != (int) sizeof buf)
+            fail ("write \"%s\" failed", name);
+          close (fd);
+        }
+      for (i = 0; i < FILE_CNT; i++)
+        {
+          snprintf (name, sizeof name, "file%d", i);
+          if (!remove (name))
+            fail ("remove \"%s\" failed", name);
+        }
+    }
+  bench_end (&b, 0, 2 * FILE_CNT * ROUND_CNT);
+}
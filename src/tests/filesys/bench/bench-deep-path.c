@@ -0,0 +1,40 @@
+/* Opens a file at the bottom of a chain of DEPTH nested
+   directories by its full path, over and over.  Reports the
+   rate of path lookups. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/filesys/bench/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define DEPTH 16
+#define OPEN_CNT 500
+
+void
+test_main (void) 
+{
+  char path[DEPTH * 2 + 8];
+  struct bench b;
+  int i;
+
+  path[0] = '\0';
+  for (i = 0; i < DEPTH; i++)
+    {
+      strlcat (path, "/d", sizeof path);
+      if (!mkdir (path))
+        fail ("mkdir \"%s\" failed", path);
+    }
+  strlcat (path, "/file", sizeof path);
+  CHECK (create (path, 0), "create \"%s\"", path);
+
+  bench_start (&b, "deep_open");
+  for (i = 0; i < OPEN_CNT; i++)
+    {
+      int fd = open (path);
+      if (fd < 2)
+        fail ("open \"%s\" failed", path);
+      close (fd);
+    }
+  bench_end (&b, 0, OPEN_CNT);
+}
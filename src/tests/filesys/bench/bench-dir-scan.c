@@ -0,0 +1,41 @@
+/* Fills a directory with FILE_CNT files, then lists it with
+   readdir() over and over.  Reports the rate of entries read. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/filesys/bench/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 100
+#define SCAN_CNT 20
+
+void
+test_main (void) 
+{
+  char name[READDIR_MAX_LEN + 1];
+  struct bench b;
+  int fd, i, cnt = 0;
+
+  CHECK (mkdir ("dir"), "mkdir \"dir\"");
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "dir/f%d", i);
+      if (!create (name, 0))
+        fail ("create \"%s\" failed", name);
+    }
+
+  bench_start (&b, "dir_scan");
+  for (i = 0; i < SCAN_CNT; i++)
+    {
+      if ((fd = open ("dir")) < 2)
+        fail ("open \"dir\" failed");
+      while (readdir (fd, name))
+        cnt++;
+      close (fd);
+    }
+  bench_end (&b, 0, cnt);
+
+  if (cnt != FILE_CNT * SCAN_CNT)
+    fail ("read %d entries, expected %d", cnt, FILE_CNT * SCAN_CNT);
+}
@@ -0,0 +1,117 @@
+/* Measures how much kernel memory each of several kinds of
+   object costs, from the kernel's memory allocator statistics:
+
+     - "open": an open file, FILE_CNT times over the same file.
+
+     - "proc": a running process, PROC_CNT of them, each the
+       parent of the next, measured by the innermost one.
+
+     - "tree": an entry in a directory tree made by make_tree(),
+       all closed again, so that what remains is what the file
+       system caches about them.
+
+   For each kind, reports the kernel pool pages and malloc()
+   bytes used per object, and the pages added to malloc() arenas,
+   which include the waste from rounding blocks up to a size
+   class. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/filesys/bench/bench-footprint.h"
+#include "tests/filesys/extended/mk-tree.h"
+#include "tests/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 100
+
+/* Dimensions of the tree, as passed to make_tree(). */
+#define TREE_A 3
+#define TREE_B 3
+#define TREE_C 3
+#define TREE_D 4
+
+/* Prints results NAME_KEY, VALUE. */
+static void
+report (const char *name, const char *key, int64_t value) 
+{
+  char full[64];
+
+  snprintf (full, sizeof full, "%s_%s", name, key);
+  bench_result (full, "%"PRId64, value);
+}
+
+/* Reports the memory used by each of the CNT objects of kind
+   NAME created between snapshots BEFORE and AFTER. */
+static void
+report_footprint (const char *name, const struct footprint *before,
+                  const struct footprint *after, int cnt) 
+{
+  int64_t pages = (int64_t) after->kernel_pages - before->kernel_pages;
+  int64_t bytes = (int64_t) after->malloc_bytes - before->malloc_bytes;
+  int64_t arenas = (int64_t) after->arena_pages - before->arena_pages;
+
+  report (name, "objects", cnt);
+  report (name, "kernel_bytes_per_obj", pages * 4096 / cnt);
+  report (name, "malloc_bytes_per_obj", bytes / cnt);
+  report (name, "arena_pages", arenas);
+}
+
+static void
+measure_open (void) 
+{
+  struct footprint before, after;
+  int fds[FILE_CNT];
+  int i;
+
+  CHECK (create ("footprint", 0), "create \"footprint\"");
+  footprint_get (&before);
+  for (i = 0; i < FILE_CNT; i++)
+    if ((fds[i] = open ("footprint")) < 2)
+      fail ("open #%d of \"footprint\" failed", i);
+  footprint_get (&after);
+  report_footprint ("open", &before, &after, FILE_CNT);
+  for (i = 0; i < FILE_CNT; i++)
+    close (fds[i]);
+}
+
+static void
+measure_proc (void) 
+{
+  struct footprint before, after;
+  char cmd_line[64];
+  int pages;
+
+  footprint_get (&before);
+  snprintf (cmd_line, sizeof cmd_line, "child-bench-footprint %d",
+            PROC_CNT);
+  pages = wait (exec (cmd_line));
+  if (pages < 0)
+    fail ("child-bench-footprint failed");
+
+  /* The children report only kernel pages, not malloc() use. */
+  after = before;
+  after.kernel_pages = pages;
+  report_footprint ("proc", &before, &after, PROC_CNT);
+}
+
+static void
+measure_tree (void) 
+{
+  struct footprint before, after;
+
+  footprint_get (&before);
+  make_tree (TREE_A, TREE_B, TREE_C, TREE_D);
+  footprint_get (&after);
+  report_footprint ("tree", &before, &after,
+                    TREE_A * (1 + TREE_B * (1 + TREE_C * (1 + TREE_D))));
+}
+
+void
+test_main (void) 
+{
+  measure_open ();
+  measure_proc ();
+  measure_tree ();
+}
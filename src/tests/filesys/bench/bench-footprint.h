@@ -0,0 +1,39 @@
+#ifndef TESTS_FILESYS_BENCH_BENCH_FOOTPRINT_H
+#define TESTS_FILESYS_BENCH_BENCH_FOOTPRINT_H
+
+#include <stdint.h>
+#include <syscall.h>
+
+/* Number of processes alive at once in the "proc" measurement
+   of bench-footprint, counting the innermost child but not
+   bench-footprint itself. */
+#define PROC_CNT 10
+
+/* Snapshot of kernel memory use. */
+struct footprint
+  {
+    unsigned kernel_pages;      /* Pages used in the kernel pool. */
+    uint64_t malloc_bytes;      /* Bytes in live malloc() blocks. */
+    unsigned arena_pages;       /* Pages holding malloc() blocks. */
+  };
+
+/* Takes a snapshot of kernel memory use in F. */
+static inline void
+footprint_get (struct footprint *f) 
+{
+  struct mem_stats s;
+  int i;
+
+  memstats (&s);
+  f->kernel_pages = s.kernel_pool.used_cnt;
+  f->malloc_bytes = 0;
+  f->arena_pages = s.big_block_pages;
+  for (i = 0; i < MEM_CLASS_CNT; i++)
+    {
+      f->malloc_bytes += (uint64_t) s.classes[i].live_cnt
+                         * s.classes[i].block_size;
+      f->arena_pages += s.classes[i].arena_cnt;
+    }
+}
+
+#endif /* tests/filesys/bench/bench-footprint.h */
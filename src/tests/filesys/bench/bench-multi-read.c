@@ -0,0 +1,35 @@
+/* Starts CHILD_CNT processes that all read the same 256 kB file
+   at once.  Reports the combined throughput. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/filesys/bench/bench.h"
+#include "tests/filesys/bench/bench-multi-read.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 4
+
+static char buf[4096];
+
+void
+test_main (void) 
+{
+  pid_t children[CHILD_CNT];
+  struct bench b;
+  size_t ofs;
+  int fd;
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  for (ofs = 0; ofs < FILE_SIZE; ofs += sizeof buf)
+    if (write (fd, buf, sizeof buf) != (int) sizeof buf)
+      fail ("write at offset %zu failed", ofs);
+  close (fd);
+
+  bench_start (&b, "multi_read");
+  exec_children ("child-bench-read", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+  bench_end (&b, (uint64_t) CHILD_CNT * FILE_SIZE, 0);
+}
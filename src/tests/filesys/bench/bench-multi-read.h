@@ -0,0 +1,7 @@
+#ifndef TESTS_FILESYS_BENCH_BENCH_MULTI_READ_H
+#define TESTS_FILESYS_BENCH_BENCH_MULTI_READ_H
+
+#define FILE_SIZE (256 * 1024)
+static const char file_name[] = "data";
+
+#endif /* tests/filesys/bench/bench-multi-read.h */
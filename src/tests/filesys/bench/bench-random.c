@@ -0,0 +1,58 @@
+/* Reads and writes a 256 kB file at random block-aligned
+   offsets, first in 512-byte blocks, then in 4 kB blocks.
+   Reports the rate of each kind of operation. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/filesys/bench/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (256 * 1024)
+#define OP_CNT 500
+
+static char buf[4096];
+
+static void random_io (int fd, const char *name, size_t block_size,
+                       bool write);
+
+void
+test_main (void) 
+{
+  const char *file_name = "random";
+  int fd;
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create (file_name, FILE_SIZE), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+
+  random_io (fd, "rand_512_write", 512, true);
+  random_io (fd, "rand_512_read", 512, false);
+  random_io (fd, "rand_4k_write", 4096, true);
+  random_io (fd, "rand_4k_read", 4096, false);
+
+  close (fd);
+}
+
+/* Does OP_CNT reads or writes of BLOCK_SIZE bytes each at random
+   offsets in FD, timed as phase NAME. */
+static void
+random_io (int fd, const char *name, size_t block_size, bool write_)
+{
+  size_t block_cnt = FILE_SIZE / block_size;
+  struct bench b;
+  int i;
+
+  bench_start (&b, name);
+  for (i = 0; i < OP_CNT; i++)
+    {
+      unsigned ofs = random_ulong () % block_cnt * block_size;
+      int n = (write_
+               ? pwrite (fd, buf, block_size, ofs)
+               : pread (fd, buf, block_size, ofs));
+      if (n != (int) block_size)
+        fail ("%s of %zu bytes at offset %u failed",
+              write_ ? "write" : "read", block_size, ofs);
+    }
+  bench_end (&b, (uint64_t) OP_CNT * block_size, OP_CNT);
+}
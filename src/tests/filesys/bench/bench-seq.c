@@ -0,0 +1,43 @@
+/* Writes a 512 kB file from start to end one 4 kB block at a
+   time, then reads it back the same way.  Reports the
+   throughput of each pass and checks the data read back. */
+
+#include <syscall.h>
+#include "tests/filesys/bench/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (512 * 1024)
+#define BLOCK_SIZE 4096
+
+static char buf[BLOCK_SIZE];
+
+void
+test_main (void) 
+{
+  const char *file_name = "seq";
+  unsigned long sum;
+  struct bench b;
+  size_t ofs;
+  int fd;
+
+  sum = bench_data (buf, sizeof buf, 0);
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+
+  bench_start (&b, "seq_write");
+  for (ofs = 0; ofs < FILE_SIZE; ofs += BLOCK_SIZE)
+    if (write (fd, buf, BLOCK_SIZE) != BLOCK_SIZE)
+      fail ("write %d bytes at offset %zu failed", BLOCK_SIZE, ofs);
+  bench_end (&b, FILE_SIZE, 0);
+
+  seek (fd, 0);
+  bench_start (&b, "seq_read");
+  for (ofs = 0; ofs < FILE_SIZE; ofs += BLOCK_SIZE)
+    if (read (fd, buf, BLOCK_SIZE) != BLOCK_SIZE)
+      fail ("read %d bytes at offset %zu failed", BLOCK_SIZE, ofs);
+  bench_end (&b, FILE_SIZE, 0);
+  bench_verify (buf, sizeof buf, sum, "last block read");
+
+  close (fd);
+}
@@ -0,0 +1,50 @@
+#include "tests/filesys/bench/bench.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/bench.h"
+
+/* Starts timing phase NAME of a benchmark in B.  Writes out any
+   dirty data first, so that the phase is not charged for I/O
+   left over from the one before. */
+void
+bench_start (struct bench *b, const char *name) 
+{
+  sync ();
+  b->name = name;
+  iostats (&b->start_io);
+  bench_timer_start (&b->timer);
+}
+
+/* Ends the phase started in B, which moved BYTES bytes of file
+   data and did OPS operations, either of which may be 0 if it
+   does not apply.  Writes out the phase's dirty data, so that
+   its cost is counted, and then reports its throughput and the
+   sectors it read and wrote on the file system device. */
+void
+bench_end (struct bench *b, uint64_t bytes, uint64_t ops) 
+{
+  struct io_stats io;
+  char key[64];
+  uint64_t ns;
+
+  sync ();
+  ns = bench_timer_stop (&b->timer);
+  iostats (&io);
+
+  if (bytes != 0)
+    {
+      /* Hundredths of a megabyte per second. */
+      uint64_t rate = bytes * 1000000000 / ns * 100 / (1024 * 1024);
+      snprintf (key, sizeof key, "%s_mb_s", b->name);
+      bench_result (key, "%"PRIu64".%02"PRIu64, rate / 100, rate % 100);
+    }
+  if (ops != 0)
+    {
+      snprintf (key, sizeof key, "%s_ops_s", b->name);
+      bench_result (key, "%"PRIu64, ops * 1000000000 / ns);
+    }
+  snprintf (key, sizeof key, "%s_sectors_read", b->name);
+  bench_result (key, "%"PRIu64, io.read_cnt - b->start_io.read_cnt);
+  snprintf (key, sizeof key, "%s_sectors_written", b->name);
+  bench_result (key, "%"PRIu64, io.write_cnt - b->start_io.write_cnt);
+}
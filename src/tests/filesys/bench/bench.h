@@ -0,0 +1,19 @@
+#ifndef TESTS_FILESYS_BENCH_BENCH_H
+#define TESTS_FILESYS_BENCH_BENCH_H
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/bench.h"
+
+/* One timed phase of a file system benchmark. */
+struct bench
+  {
+    const char *name;           /* Prefix of the result keys. */
+    struct bench_timer timer;   /* Times the phase. */
+    struct io_stats start_io;   /* Disk sector counts at the start. */
+  };
+
+void bench_start (struct bench *, const char *name);
+void bench_end (struct bench *, uint64_t bytes, uint64_t ops);
+
+#endif /* tests/filesys/bench/bench.h */
@@ -0,0 +1,93 @@
+/* Child process for the bench-contend benchmark.  Does the work
+   of one child in the pattern given as the first argument and
+   exits with the number of microseconds that it took. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/bench.h"
+#include "tests/filesys/bench/bench-contend.h"
+#include "tests/lib.h"
+
+const char *test_name = "child-bench-contend";
+
+#define BLOCK_SIZE 4096
+
+static char buf[BLOCK_SIZE];
+
+/* Writes CHILD_SIZE bytes to FD starting at offset START, then
+   reads them back and checks them.  Data for child ID. */
+static void
+write_and_read (int fd, unsigned start, int id) 
+{
+  unsigned long sum = bench_data (buf, sizeof buf, id);
+  unsigned ofs;
+
+  for (ofs = 0; ofs < CHILD_SIZE; ofs += BLOCK_SIZE)
+    if (pwrite (fd, buf, BLOCK_SIZE, start + ofs) != BLOCK_SIZE)
+      fail ("write at offset %u failed", start + ofs);
+  for (ofs = 0; ofs < CHILD_SIZE; ofs += BLOCK_SIZE)
+    {
+      if (pread (fd, buf, BLOCK_SIZE, start + ofs) != BLOCK_SIZE)
+        fail ("read at offset %u failed", start + ofs);
+      bench_verify (buf, sizeof buf, sum, "block read back");
+    }
+}
+
+/* Creates, opens, closes, and then removes DIR_FILES files in the
+   shared directory. */
+static void
+churn_dir (int id) 
+{
+  char name[64];
+  int i;
+
+  for (i = 0; i < DIR_FILES; i++)
+    {
+      int fd;
+
+      snprintf (name, sizeof name, "%s/%d-%d", shared_dir, id, i);
+      if (!create (name, 0))
+        fail ("create \"%s\" failed", name);
+      if ((fd = open (name)) < 2)
+        fail ("open \"%s\" failed", name);
+      close (fd);
+    }
+  for (i = 0; i < DIR_FILES; i++)
+    {
+      snprintf (name, sizeof name, "%s/%d-%d", shared_dir, id, i);
+      if (!remove (name))
+        fail ("remove \"%s\" failed", name);
+    }
+}
+
+int
+main (int argc, char *argv[]) 
+{
+  struct bench_timer t;
+  char name[32];
+  int id, fd;
+
+  quiet = true;
+  CHECK (argc == 3, "argc must be 3, actually %d", argc);
+  id = atoi (argv[2]);
+
+  bench_timer_start (&t);
+  if (!strcmp (argv[1], "disjoint"))
+    {
+      snprintf (name, sizeof name, "%s-%d", shared_file, id);
+      CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+      write_and_read (fd, 0, id);
+      close (fd);
+    }
+  else if (!strcmp (argv[1], "shared"))
+    {
+      CHECK ((fd = open (shared_file)) > 1, "open \"%s\"", shared_file);
+      write_and_read (fd, (unsigned) id * CHILD_SIZE, id);
+      close (fd);
+    }
+  else
+    churn_dir (id);
+  return bench_timer_stop (&t) / 1000;
+}
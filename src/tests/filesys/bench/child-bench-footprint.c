@@ -0,0 +1,32 @@
+/* Child process for the bench-footprint benchmark.  Given N,
+   starts a child with N - 1 and waits for it, until N is 1,
+   when it exits with the number of kernel pool pages in use
+   with all of them alive.  Every other child passes that
+   number on as its own exit status. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/filesys/bench/bench-footprint.h"
+#include "tests/lib.h"
+
+const char *test_name = "child-bench-footprint";
+
+int
+main (int argc, char *argv[]) 
+{
+  struct footprint f;
+  char cmd_line[64];
+  int n;
+
+  quiet = true;
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  n = atoi (argv[1]);
+  if (n <= 1)
+    {
+      footprint_get (&f);
+      return f.kernel_pages;
+    }
+  snprintf (cmd_line, sizeof cmd_line, "child-bench-footprint %d", n - 1);
+  return wait (exec (cmd_line));
+}
@@ -0,0 +1,29 @@
+/* Child process for the bench-multi-read benchmark.
+   Reads the whole test file once, 4 kB at a time. */
+
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/filesys/bench/bench-multi-read.h"
+#include "tests/lib.h"
+
+const char *test_name = "child-bench-read";
+
+static char buf[4096];
+
+int
+main (int argc, const char *argv[]) 
+{
+  size_t ofs;
+  int fd;
+
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  for (ofs = 0; ofs < FILE_SIZE; ofs += sizeof buf)
+    if (read (fd, buf, sizeof buf) != (int) sizeof buf)
+      fail ("read at offset %zu failed", ofs);
+  close (fd);
+
+  return atoi (argv[1]);
+}
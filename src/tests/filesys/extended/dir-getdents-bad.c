@@ -0,0 +1,19 @@
+/* Passes getdents() a buffer in kernel memory for a directory
+   that has an entry to return.  The process must be terminated
+   with -1 exit code. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fd;
+
+  CHECK (mkdir ("a"), "mkdir \"a\"");
+  CHECK (create ("a/b", 0), "create \"a/b\"");
+  CHECK ((fd = open ("a")) > 1, "open \"a\"");
+  getdents (fd, (struct dirent *) 0xc0100000, 8);
+  fail ("should not have survived getdents()");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(dir-getdents-bad) begin
+(dir-getdents-bad) mkdir "a"
+(dir-getdents-bad) create "a/b"
+(dir-getdents-bad) open "a"
+dir-getdents-bad: exit(-1)
+EOF
+pass;
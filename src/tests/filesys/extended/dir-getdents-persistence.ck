@@ -0,0 +1,6 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_archive ({'a' => {'f1' => ["\0" x 100], 'f2' => [''], 'd' => {}}});
+pass;
@@ -0,0 +1,63 @@
+/* Reads a directory's entries with getdents() and checks the
+   details each one carries against the files themselves. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static const struct dirent *
+find (const struct dirent *ents, int cnt, const char *name) 
+{
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    if (!strcmp (ents[i].name, name))
+      return &ents[i];
+  fail ("getdents() did not return \"%s\"", name);
+}
+
+static void
+check (const struct dirent *ents, int cnt, const char *name,
+       unsigned length, bool is_dir) 
+{
+  char path[16] = "a/";
+  const struct dirent *d = find (ents, cnt, name);
+  int fd;
+
+  strlcpy (path + 2, name, sizeof path - 2);
+  CHECK ((fd = open (path)) > 1, "open \"%s\"", path);
+  if (d->inumber != inumber (fd))
+    fail ("\"%s\" has inumber %d, not %d", name, d->inumber, inumber (fd));
+  if (d->is_dir != is_dir)
+    fail ("\"%s\" is_dir is %d, not %d", name, d->is_dir, is_dir);
+  if (!is_dir && d->length != length)
+    fail ("\"%s\" has length %u, not %u", name, d->length, length);
+  msg ("entry \"%s\" is right", name);
+  close (fd);
+}
+
+void
+test_main (void) 
+{
+  struct dirent ents[8];
+  int fd, cnt;
+
+  CHECK (mkdir ("a"), "mkdir \"a\"");
+  CHECK (create ("a/f1", 100), "create \"a/f1\"");
+  CHECK (create ("a/f2", 0), "create \"a/f2\"");
+  CHECK (mkdir ("a/d"), "mkdir \"a/d\"");
+
+  CHECK ((fd = open ("a")) > 1, "open \"a\"");
+  CHECK ((cnt = getdents (fd, ents, 8)) == 3, "getdents \"a\"");
+  check (ents, cnt, "f1", 100, false);
+  check (ents, cnt, "f2", 0, false);
+  check (ents, cnt, "d", 0, true);
+  CHECK (getdents (fd, ents, 8) == 0, "getdents at end of directory");
+  CHECK (getdents (fd, ents, -1) == -1, "getdents with negative count");
+  close (fd);
+
+  CHECK ((fd = open ("a/f1")) > 1, "open \"a/f1\"");
+  CHECK (getdents (fd, ents, 8) == -1, "getdents on a file fails");
+  close (fd);
+}
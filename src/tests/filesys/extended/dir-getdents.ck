@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-getdents) begin
+(dir-getdents) mkdir "a"
+(dir-getdents) create "a/f1"
+(dir-getdents) create "a/f2"
+(dir-getdents) mkdir "a/d"
+(dir-getdents) open "a"
+(dir-getdents) getdents "a"
+(dir-getdents) open "a/f1"
+(dir-getdents) entry "f1" is right
+(dir-getdents) open "a/f2"
+(dir-getdents) entry "f2" is right
+(dir-getdents) open "a/d"
+(dir-getdents) entry "d" is right
+(dir-getdents) getdents at end of directory
+(dir-getdents) getdents with negative count
+(dir-getdents) open "a/f1"
+(dir-getdents) getdents on a file fails
+(dir-getdents) end
+EOF
+pass;
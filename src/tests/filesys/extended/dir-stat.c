@@ -0,0 +1,44 @@
+/* Checks what stat() reports for a file, a directory and the
+   root, by absolute and relative paths, and that it fails for
+   names that do not exist. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static void
+check (const char *path, unsigned length, bool is_dir) 
+{
+  struct stat st;
+  int fd;
+
+  CHECK (stat (path, &st), "stat \"%s\"", path);
+  CHECK ((fd = open (path)) > 1, "open \"%s\"", path);
+  if (st.inumber != inumber (fd))
+    fail ("\"%s\" has inumber %d, not %d", path, st.inumber, inumber (fd));
+  if (st.is_dir != is_dir)
+    fail ("\"%s\" is_dir is %d, not %d", path, st.is_dir, is_dir);
+  if (!is_dir && st.length != length)
+    fail ("\"%s\" has length %u, not %u", path, st.length, length);
+  close (fd);
+}
+
+void
+test_main (void) 
+{
+  struct stat st;
+
+  CHECK (mkdir ("a"), "mkdir \"a\"");
+  CHECK (create ("a/b", 1234), "create \"a/b\"");
+  check ("a", 0, true);
+  check ("a/b", 1234, false);
+  check ("/a/b", 1234, false);
+  check ("/", 0, true);
+
+  CHECK (chdir ("a"), "chdir \"a\"");
+  check ("b", 1234, false);
+
+  CHECK (!stat ("c", &st), "stat \"c\" (must return false)");
+  CHECK (!stat ("b/c", &st), "stat \"b/c\" (must return false)");
+  CHECK (!stat ("", &st), "stat \"\" (must return false)");
+}
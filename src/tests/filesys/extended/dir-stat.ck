@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-stat) begin
+(dir-stat) mkdir "a"
+(dir-stat) create "a/b"
+(dir-stat) stat "a"
+(dir-stat) open "a"
+(dir-stat) stat "a/b"
+(dir-stat) open "a/b"
+(dir-stat) stat "/a/b"
+(dir-stat) open "/a/b"
+(dir-stat) stat "/"
+(dir-stat) open "/"
+(dir-stat) chdir "a"
+(dir-stat) stat "b"
+(dir-stat) open "b"
+(dir-stat) stat "c" (must return false)
+(dir-stat) stat "b/c" (must return false)
+(dir-stat) stat "" (must return false)
+(dir-stat) end
+EOF
+pass;
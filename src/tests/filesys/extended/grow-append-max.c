@@ -0,0 +1,33 @@
+/* Appends small writes to a file that ends just short of the
+   largest size a file can have, 8 MB.  Only the bytes below the
+   limit may be written, and none may be reported as written past
+   it. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define MAX_SIZE (8 * 1024 * 1024)
+
+void
+test_main (void) 
+{
+  const char *file_name = "testfile";
+  int fd;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+
+  msg ("seek \"%s\" to %d", file_name, MAX_SIZE - 3);
+  seek (fd, MAX_SIZE - 3);
+  CHECK (write (fd, "a", 1) == 1, "write \"%s\" below the limit", file_name);
+  CHECK (write (fd, "bcde", 4) == 2, "append to \"%s\" across the limit",
+         file_name);
+  CHECK (write (fd, "f", 1) == 0, "append to \"%s\" at the limit", file_name);
+  CHECK (fsync (fd), "fsync \"%s\"", file_name);
+  CHECK (filesize (fd) == MAX_SIZE, "filesize \"%s\"", file_name);
+
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  CHECK (remove (file_name), "remove \"%s\"", file_name);
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-append-max) begin
+(grow-append-max) create "testfile"
+(grow-append-max) open "testfile"
+(grow-append-max) seek "testfile" to 8388605
+(grow-append-max) write "testfile" below the limit
+(grow-append-max) append to "testfile" across the limit
+(grow-append-max) append to "testfile" at the limit
+(grow-append-max) fsync "testfile"
+(grow-append-max) filesize "testfile"
+(grow-append-max) close "testfile"
+(grow-append-max) remove "testfile"
+(grow-append-max) end
+EOF
+pass;
@@ -0,0 +1,56 @@
+/* Grows a file with many small appends through one file
+   descriptor and reads it back through another, opened before
+   the appends, once the first is synced and again once it is
+   closed. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 1500
+static char buf[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  const char *file_name = "testme";
+  size_t ofs, half;
+  int fd_w, fd_r;
+
+  random_init (0);
+  random_bytes (buf, sizeof buf);
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd_w = open (file_name)) > 1, "open \"%s\" for writing", file_name);
+  CHECK ((fd_r = open (file_name)) > 1, "open \"%s\" for reading", file_name);
+
+  msg ("append to \"%s\" in small writes", file_name);
+  half = FILE_SIZE / 2;
+  for (ofs = 0; ofs < FILE_SIZE; )
+    {
+      size_t size = ofs % 13 + 1;
+      if (size > FILE_SIZE - ofs)
+        size = FILE_SIZE - ofs;
+      if (ofs < half && ofs + size > half)
+        size = half - ofs;
+      if ((size_t) write (fd_w, buf + ofs, size) != size)
+        fail ("write %zu bytes at offset %zu in \"%s\" failed",
+              size, ofs, file_name);
+      ofs += size;
+
+      if (ofs == half)
+        {
+          CHECK (fsync (fd_w), "fsync \"%s\"", file_name);
+          seek (fd_r, 0);
+          check_file_handle (fd_r, file_name, buf, half);
+        }
+    }
+
+  msg ("close \"%s\" for writing", file_name);
+  close (fd_w);
+  seek (fd_r, 0);
+  check_file_handle (fd_r, file_name, buf, FILE_SIZE);
+  msg ("close \"%s\" for reading", file_name);
+  close (fd_r);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-append-small) begin
+(grow-append-small) create "testme"
+(grow-append-small) open "testme" for writing
+(grow-append-small) open "testme" for reading
+(grow-append-small) append to "testme" in small writes
+(grow-append-small) fsync "testme"
+(grow-append-small) verified contents of "testme"
+(grow-append-small) close "testme" for writing
+(grow-append-small) verified contents of "testme"
+(grow-append-small) close "testme" for reading
+(grow-append-small) end
+EOF
+pass;
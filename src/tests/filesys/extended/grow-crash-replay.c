@@ -0,0 +1,37 @@
+/* Grows a file sparsely to the largest size, which touches more
+   indirect blocks than one journal transaction can hold, then
+   removes it and creates a small file, committing each step with
+   fsync().  The kernel then powers off without writing back the
+   file system, so the last steps are committed to the journal
+   but not written to their homes, and the next boot must replay
+   them for the small file to be found. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  static const char data[] = "replayed after a crash";
+  char zero = 0;
+  int fd;
+
+  CHECK (create ("big", 0), "create \"big\"");
+  CHECK ((fd = open ("big")) > 1, "open \"big\"");
+  msg ("seek \"big\" to 8388607");
+  seek (fd, 8388607);
+  CHECK (write (fd, &zero, 1) == 1, "write \"big\"");
+  CHECK (fsync (fd), "fsync \"big\"");
+  msg ("close \"big\"");
+  close (fd);
+  CHECK (remove ("big"), "remove \"big\"");
+
+  CHECK (create ("small", 0), "create \"small\"");
+  CHECK ((fd = open ("small")) > 1, "open \"small\"");
+  CHECK (write (fd, data, sizeof data - 1) == sizeof data - 1,
+         "write \"small\"");
+  CHECK (fsync (fd), "fsync \"small\"");
+  msg ("close \"small\"");
+  close (fd);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(grow-crash-replay) begin
+(grow-crash-replay) create "big"
+(grow-crash-replay) open "big"
+(grow-crash-replay) seek "big" to 8388607
+(grow-crash-replay) write "big"
+(grow-crash-replay) fsync "big"
+(grow-crash-replay) close "big"
+(grow-crash-replay) remove "big"
+(grow-crash-replay) create "small"
+(grow-crash-replay) open "small"
+(grow-crash-replay) write "small"
+(grow-crash-replay) fsync "small"
+(grow-crash-replay) close "small"
+(grow-crash-replay) end
+grow-crash-replay: exit(0)
+EOF
+pass;
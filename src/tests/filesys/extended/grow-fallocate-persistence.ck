@@ -0,0 +1,7 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my $contents = ("\0" x 20000) . "abc" . ("\0" x 9997);
+check_archive ({"testfile" => [$contents]});
+pass;
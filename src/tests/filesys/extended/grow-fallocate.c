@@ -0,0 +1,41 @@
+/* Reserves space for a file with fallocate(), checks that it
+   reads as zeros and takes writes, and that fallocate() within
+   the file leaves its size alone.  Ranges past the largest file
+   offset, and directories, must be refused. */
+
+#include <limits.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE 30000
+
+static char buf[SIZE];
+
+void
+test_main (void) 
+{
+  const char *file_name = "testfile";
+  int fd, dir_fd;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (fallocate (fd, 0, SIZE), "fallocate %d bytes", SIZE);
+  CHECK (filesize (fd) == SIZE, "file size is %d", SIZE);
+
+  memcpy (buf + 20000, "abc", 3);
+  CHECK (pwrite (fd, "abc", 3, 20000) == 3, "pwrite at 20000");
+  CHECK (fallocate (fd, 1000, 100), "fallocate inside the file");
+  CHECK (filesize (fd) == SIZE, "file size is still %d", SIZE);
+
+  CHECK (!fallocate (fd, 0x80000000, 1), "fallocate at 0x80000000 fails");
+  CHECK (!fallocate (fd, INT_MAX, 10), "fallocate across INT_MAX fails");
+  CHECK ((dir_fd = open ("/")) > 1, "open \"/\"");
+  CHECK (!fallocate (dir_fd, 0, 512), "fallocate on a directory fails");
+  close (dir_fd);
+
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, sizeof buf);
+}
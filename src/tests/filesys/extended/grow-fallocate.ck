@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-fallocate) begin
+(grow-fallocate) create "testfile"
+(grow-fallocate) open "testfile"
+(grow-fallocate) fallocate 30000 bytes
+(grow-fallocate) file size is 30000
+(grow-fallocate) pwrite at 20000
+(grow-fallocate) fallocate inside the file
+(grow-fallocate) file size is still 30000
+(grow-fallocate) fallocate at 0x80000000 fails
+(grow-fallocate) fallocate across INT_MAX fails
+(grow-fallocate) open "/"
+(grow-fallocate) fallocate on a directory fails
+(grow-fallocate) close "testfile"
+(grow-fallocate) open "testfile" for verification
+(grow-fallocate) verified contents of "testfile"
+(grow-fallocate) close "testfile"
+(grow-fallocate) end
+EOF
+pass;
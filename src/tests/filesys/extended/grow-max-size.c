@@ -0,0 +1,32 @@
+/* Writes across the largest size a file can have, 8 MB, and then
+   past it.  Only the bytes below the limit may be written, and
+   the file must grow no further. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define MAX_SIZE (8 * 1024 * 1024)
+
+void
+test_main (void) 
+{
+  const char *file_name = "testfile";
+  int fd;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+
+  msg ("seek \"%s\" to %d", file_name, MAX_SIZE - 1);
+  seek (fd, MAX_SIZE - 1);
+  CHECK (write (fd, "ab", 2) == 1, "write \"%s\" across the limit", file_name);
+  CHECK (write (fd, "c", 1) == 0, "write \"%s\" past the limit", file_name);
+  msg ("seek \"%s\" to %d", file_name, MAX_SIZE + 4096);
+  seek (fd, MAX_SIZE + 4096);
+  CHECK (write (fd, "d", 1) == 0, "write \"%s\" past the limit", file_name);
+  CHECK (filesize (fd) == MAX_SIZE, "filesize \"%s\"", file_name);
+
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  CHECK (remove (file_name), "remove \"%s\"", file_name);
+}
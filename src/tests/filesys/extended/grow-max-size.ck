@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-max-size) begin
+(grow-max-size) create "testfile"
+(grow-max-size) open "testfile"
+(grow-max-size) seek "testfile" to 8388607
+(grow-max-size) write "testfile" across the limit
+(grow-max-size) write "testfile" past the limit
+(grow-max-size) seek "testfile" to 8392704
+(grow-max-size) write "testfile" past the limit
+(grow-max-size) filesize "testfile"
+(grow-max-size) close "testfile"
+(grow-max-size) remove "testfile"
+(grow-max-size) end
+EOF
+pass;
@@ -0,0 +1,6 @@
+/* Grows a file from 0 bytes to 200,000 bytes, 1,234 bytes at a
+   time, so that three full groups of 128 sectors move into the
+   double indirect block. */
+
+#define TEST_SIZE 200000
+#include "tests/filesys/extended/grow-seq.inc"
@@ -0,0 +1,7 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my $contents = "a" . ("\0" x 29999) . "b" . ("\0" x 35533) . "c";
+check_archive ({"testfile" => [$contents]});
+pass;
@@ -0,0 +1,32 @@
+/* Creates a sparse file whose last sector completes a group of
+   128 data sectors, writes into its holes, and checks that the
+   writes land in the file and nowhere else. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[65535];
+
+void
+test_main (void) 
+{
+  const char *file_name = "testfile";
+  size_t ofs[] = {0, 30000, sizeof buf - 1};
+  size_t i;
+  int fd;
+
+  CHECK (create (file_name, sizeof buf), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  for (i = 0; i < sizeof ofs / sizeof *ofs; i++)
+    {
+      buf[ofs[i]] = 'a' + i;
+      msg ("seek \"%s\" to %zu", file_name, ofs[i]);
+      seek (fd, ofs[i]);
+      CHECK (write (fd, &buf[ofs[i]], 1) == 1,
+             "write \"%s\"", file_name);
+    }
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, sizeof buf);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-sparse-group) begin
+(grow-sparse-group) create "testfile"
+(grow-sparse-group) open "testfile"
+(grow-sparse-group) seek "testfile" to 0
+(grow-sparse-group) write "testfile"
+(grow-sparse-group) seek "testfile" to 30000
+(grow-sparse-group) write "testfile"
+(grow-sparse-group) seek "testfile" to 65534
+(grow-sparse-group) write "testfile"
+(grow-sparse-group) close "testfile"
+(grow-sparse-group) open "testfile" for verification
+(grow-sparse-group) verified contents of "testfile"
+(grow-sparse-group) close "testfile"
+(grow-sparse-group) end
+EOF
+pass;
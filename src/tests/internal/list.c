@@ -46,7 +46,7 @@ test (void)
       for (repeat = 0; repeat < 10; repeat++) 
         {
           static struct value values[MAX_SIZE * 4];
-          struct list list;
+          struct list list, odd;
           struct list_elem *e;
           int i, ofs;
 
@@ -72,6 +72,23 @@ test (void)
           list_sort (&list, value_less, NULL);
           verify_list_fwd (&list, size);
 
+          /* Split odd values off into a second sorted list, merge
+             them back, and verify. */
+          list_init (&odd);
+          for (e = list_begin (&list); e != list_end (&list); )
+            {
+              struct list_elem *next = list_next (e);
+              if (list_entry (e, struct value, elem)->value % 2 != 0)
+                {
+                  list_remove (e);
+                  list_push_back (&odd, e);
+                }
+              e = next;
+            }
+          list_merge (&list, &odd, value_less, NULL);
+          ASSERT (list_empty (&odd));
+          verify_list_fwd (&list, size);
+
           /* Reverse and verify list. */
           list_reverse (&list);
           verify_list_bkwd (&list, size);
@@ -0,0 +1,181 @@
+/* Test program for lib/kernel/rbtree.c.
+
+   Inserts and removes elements in random order, checking the
+   red-black properties, in-order traversal, and floor and
+   ceiling searches after every change.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <rbtree.h>
+#include <random.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Maximum number of elements in a tree that we will test. */
+#define MAX_SIZE 64
+
+/* A tree element.  Values are even, so that odd keys fall
+   between them. */
+struct value
+  {
+    struct rb_elem elem;        /* Tree element. */
+    int value;                  /* Item value. */
+    bool in_tree;               /* Currently in the tree? */
+  };
+
+static bool value_less (const struct rb_elem *, const struct rb_elem *,
+                        void *);
+static int verify_subtree (const struct rb_elem *);
+static void verify_tree (struct rbtree *, struct value[], int size);
+
+/* Test the red-black tree implementation. */
+void
+test (void)
+{
+  int size;
+
+  printf ("testing various size trees:");
+  for (size = 0; size < MAX_SIZE; size++)
+    {
+      int repeat;
+
+      printf (" %d", size);
+      for (repeat = 0; repeat < 10; repeat++)
+        {
+          static struct value values[MAX_SIZE];
+          struct rbtree tree;
+          int i, step;
+
+          rb_init (&tree, value_less, NULL);
+          for (i = 0; i < size; i++)
+            {
+              values[i].value = i * 2;
+              values[i].in_tree = false;
+            }
+
+          /* Toggle random elements in and out of the tree. */
+          for (step = 0; step < size * 4; step++)
+            {
+              struct value *v = &values[random_ulong () % size];
+
+              if (v->in_tree)
+                rb_remove (&tree, &v->elem);
+              else
+                ASSERT (rb_insert (&tree, &v->elem) == NULL);
+              v->in_tree = !v->in_tree;
+              verify_tree (&tree, values, size);
+            }
+
+          /* Inserting an equal value returns the one present. */
+          for (i = 0; i < size; i++)
+            if (values[i].in_tree)
+              {
+                struct value dup;
+                dup.value = values[i].value;
+                ASSERT (rb_insert (&tree, &dup.elem) == &values[i].elem);
+              }
+        }
+    }
+
+  printf (" done\n");
+  printf ("rbtree: PASS\n");
+}
+
+/* Returns true if value A is less than value B, false
+   otherwise. */
+static bool
+value_less (const struct rb_elem *a_, const struct rb_elem *b_,
+            void *aux UNUSED)
+{
+  const struct value *a = rb_entry (a_, struct value, elem);
+  const struct value *b = rb_entry (b_, struct value, elem);
+
+  return a->value < b->value;
+}
+
+/* Checks the parent links and red-black properties of the
+   subtree rooted at E and returns its black height. */
+static int
+verify_subtree (const struct rb_elem *e)
+{
+  int left, right;
+
+  if (e == NULL)
+    return 1;
+  if (e->left != NULL)
+    ASSERT (e->left->parent == e);
+  if (e->right != NULL)
+    ASSERT (e->right->parent == e);
+  if (e->red)
+    ASSERT ((e->left == NULL || !e->left->red)
+            && (e->right == NULL || !e->right->red));
+
+  left = verify_subtree (e->left);
+  right = verify_subtree (e->right);
+  ASSERT (left == right);
+  return left + !e->red;
+}
+
+/* Verifies that TREE is a valid red-black tree holding exactly
+   the elements of the SIZE-element array VALUES that are marked
+   in_tree, in order, and that every search finds the right
+   one. */
+static void
+verify_tree (struct rbtree *tree, struct value values[], int size)
+{
+  struct rb_elem *e;
+  int i, cnt = 0;
+
+  ASSERT (tree->root == NULL || !tree->root->red);
+  verify_subtree (tree->root);
+
+  /* Forward traversal visits the marked values in order. */
+  e = rb_first (tree);
+  for (i = 0; i < size; i++)
+    if (values[i].in_tree)
+      {
+        ASSERT (e == &values[i].elem);
+        e = rb_next (e);
+        cnt++;
+      }
+  ASSERT (e == NULL);
+  ASSERT (rb_size (tree) == (size_t) cnt);
+  ASSERT (rb_empty (tree) == (cnt == 0));
+
+  /* So does backward traversal, in reverse. */
+  e = rb_last (tree);
+  for (i = size - 1; i >= 0; i--)
+    if (values[i].in_tree)
+      {
+        ASSERT (e == &values[i].elem);
+        e = rb_prev (e);
+      }
+  ASSERT (e == NULL);
+
+  /* Search for every key, present, absent, and in between. */
+  for (i = -1; i <= size * 2; i++)
+    {
+      struct value key;
+      struct rb_elem *floor = NULL, *ceiling = NULL;
+      int j;
+
+      for (j = 0; j < size; j++)
+        if (values[j].in_tree)
+          {
+            if (values[j].value <= i)
+              floor = &values[j].elem;
+            if (values[j].value >= i && ceiling == NULL)
+              ceiling = &values[j].elem;
+          }
+
+      key.value = i;
+      ASSERT (rb_floor (tree, &key.elem) == floor);
+      ASSERT (rb_ceiling (tree, &key.elem) == ceiling);
+      ASSERT (rb_find (tree, &key.elem)
+              == (floor != NULL && floor == ceiling ? floor : NULL));
+    }
+}
@@ -0,0 +1,94 @@
+/* Measures lock handoff under priority donation.  A low-priority
+   thread keeps taking a lock and holding it for a while, and
+   higher-priority threads wake up periodically and wait for it,
+   donating their priority to the holder.  Prints the number of
+   handoffs, their rate, and the average wait in CPU cycles. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define WAITER_CNT 3
+#define ROUND_CNT 50
+#define HOLD_LOOPS 10000
+
+static thread_func holder_thread;
+static thread_func waiter_thread;
+
+static struct lock lock;
+static struct semaphore done;
+static volatile bool stop;
+static int handoff_cnt;
+static uint64_t wait_cycles;
+
+void
+test_bench_lock_donate (void) 
+{
+  int64_t start;
+  int i;
+
+  /* This benchmark does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  lock_init (&lock);
+  sema_init (&done, 0);
+  thread_create ("holder", PRI_DEFAULT - 1, holder_thread, NULL);
+
+  start = timer_ticks ();
+  for (i = 0; i < WAITER_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "waiter %d", i);
+      thread_create (name, PRI_DEFAULT + 1 + i, waiter_thread, NULL);
+    }
+  for (i = 0; i < WAITER_CNT; i++)
+    sema_down (&done);
+  start = timer_elapsed (start);
+
+  stop = true;
+  sema_down (&done);
+
+  msg ("result handoffs %d", handoff_cnt);
+  msg ("result handoffs_per_sec %"PRId64,
+       start > 0 ? handoff_cnt * TIMER_FREQ / start : 0);
+  msg ("result handoff_wait_cycles %"PRIu64,
+       handoff_cnt > 0 ? wait_cycles / handoff_cnt : 0);
+}
+
+static void
+holder_thread (void *aux UNUSED) 
+{
+  while (!stop) 
+    {
+      volatile int i;
+
+      lock_acquire (&lock);
+      for (i = 0; i < HOLD_LOOPS; i++)
+        continue;
+      lock_release (&lock);
+    }
+  sema_up (&done);
+}
+
+static void
+waiter_thread (void *aux UNUSED) 
+{
+  int round;
+
+  for (round = 0; round < ROUND_CNT; round++) 
+    {
+      uint64_t start;
+
+      timer_sleep (1);
+      start = timer_cycles ();
+      lock_acquire (&lock);
+      wait_cycles += timer_cycles () - start;
+      handoff_cnt++;
+      lock_release (&lock);
+    }
+  sema_up (&done);
+}
@@ -0,0 +1,62 @@
+/* Measures semaphore handoff cost: a token passes around a ring
+   of threads, each of which waits on its own semaphore and then
+   ups the next one's.  Prints the average number of CPU cycles
+   per handoff. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define RING_SIZE 8
+#define LAP_CNT 1000
+
+static thread_func ring_thread;
+static struct semaphore ring[RING_SIZE];
+static struct semaphore done;
+
+void
+test_bench_sema_pingpong (void) 
+{
+  uint64_t start, cycles;
+  int i;
+
+  /* This benchmark does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done, 0);
+  for (i = 0; i < RING_SIZE; i++)
+    sema_init (&ring[i], 0);
+  for (i = 0; i < RING_SIZE; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "ring %d", i);
+      thread_create (name, PRI_DEFAULT, ring_thread, (void *) i);
+    }
+
+  start = timer_cycles ();
+  sema_up (&ring[0]);
+  for (i = 0; i < RING_SIZE; i++)
+    sema_down (&done);
+  cycles = timer_cycles () - start;
+
+  msg ("result ring_threads %d", RING_SIZE);
+  msg ("result handoff_cycles %"PRIu64, cycles / (RING_SIZE * LAP_CNT));
+}
+
+static void
+ring_thread (void *i_) 
+{
+  int i = (int) i_;
+  int lap;
+
+  for (lap = 0; lap < LAP_CNT; lap++) 
+    {
+      sema_down (&ring[i]);
+      sema_up (&ring[(i + 1) % RING_SIZE]);
+    }
+  sema_up (&done);
+}
@@ -0,0 +1,41 @@
+/* Measures the cost of a context switch: two threads of equal
+   priority yield to each other back and forth.  Prints the
+   average number of CPU cycles per switch. */
+
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SWITCH_CNT 10000
+
+static thread_func yield_thread;
+
+void
+test_bench_switch (void) 
+{
+  uint64_t start, cycles;
+  int i;
+
+  /* This benchmark does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  thread_create ("yielder", thread_get_priority (), yield_thread, NULL);
+
+  start = timer_cycles ();
+  for (i = 0; i < SWITCH_CNT; i++)
+    thread_yield ();
+  cycles = timer_cycles () - start;
+
+  msg ("result switch_cycles %"PRIu64, cycles / (2 * SWITCH_CNT));
+}
+
+static void
+yield_thread (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < SWITCH_CNT; i++)
+    thread_yield ();
+}
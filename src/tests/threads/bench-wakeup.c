@@ -0,0 +1,99 @@
+/* Measures wakeup latency: 100 threads sleep until one of ten
+   consecutive timer ticks, and each records how long after its
+   tick it actually ran.  Prints latency percentiles in CPU
+   cycles. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SLEEPER_CNT 100
+#define TICK_SPREAD 10
+
+static thread_func sleeper;
+static int compare_latency (const void *, const void *);
+static void wait_for_tick (void);
+
+static int64_t start_tick;
+static uint64_t start_cycles;
+static uint64_t cycles_per_tick;
+static int64_t latency[SLEEPER_CNT];
+static struct semaphore done;
+
+void
+test_bench_wakeup (void) 
+{
+  int i;
+
+  /* This benchmark does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Calibrate the TSC against the timer. */
+  wait_for_tick ();
+  start_cycles = timer_cycles ();
+  start_tick = timer_ticks ();
+  while (timer_ticks () < start_tick + TICK_SPREAD)
+    continue;
+  cycles_per_tick = (timer_cycles () - start_cycles) / TICK_SPREAD;
+
+  /* Start the sleepers just after a tick.  They run at once,
+     since their priority is higher than ours. */
+  sema_init (&done, 0);
+  wait_for_tick ();
+  start_cycles = timer_cycles ();
+  start_tick = timer_ticks ();
+  for (i = 0; i < SLEEPER_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "sleeper %d", i);
+      thread_create (name, PRI_DEFAULT + 1, sleeper, (void *) i);
+    }
+  for (i = 0; i < SLEEPER_CNT; i++)
+    sema_down (&done);
+
+  qsort (latency, SLEEPER_CNT, sizeof *latency, compare_latency);
+  msg ("result cycles_per_tick %"PRIu64, cycles_per_tick);
+  msg ("result wakeup_p50_cycles %"PRId64, latency[SLEEPER_CNT / 2]);
+  msg ("result wakeup_p90_cycles %"PRId64, latency[SLEEPER_CNT * 9 / 10]);
+  msg ("result wakeup_p99_cycles %"PRId64, latency[SLEEPER_CNT * 99 / 100]);
+  msg ("result wakeup_max_cycles %"PRId64, latency[SLEEPER_CNT - 1]);
+}
+
+/* Sleeps until a tick two or more ticks after the start, leaving
+   time for every sleeper to be created first, and records the
+   latency. */
+static void
+sleeper (void *i_) 
+{
+  int i = (int) i_;
+  int64_t offset = 2 + i % TICK_SPREAD;
+  int64_t wake_cycles = start_cycles + offset * cycles_per_tick;
+
+  timer_sleep (start_tick + offset - timer_ticks ());
+  latency[i] = timer_cycles () - wake_cycles;
+  sema_up (&done);
+}
+
+/* Busy-waits until the start of the next timer tick. */
+static void
+wait_for_tick (void) 
+{
+  int64_t start = timer_ticks ();
+  while (timer_ticks () == start)
+    continue;
+}
+
+/* Orders latencies in ascending order, for qsort(). */
+static int
+compare_latency (const void *a_, const void *b_) 
+{
+  const int64_t *a = a_;
+  const int64_t *b = b_;
+
+  return *a < *b ? -1 : *a > *b;
+}
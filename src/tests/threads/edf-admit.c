@@ -0,0 +1,51 @@
+/* Checks admission control for the earliest-deadline-first
+   class.  Parameters out of order are refused.  With one thread
+   holding 60% of the CPU, another may reserve 30% more but not
+   40%, may change its own reservation without being counted
+   twice, and may have 90% once the first thread exits. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func holder_thread_func;
+
+void
+test_edf_admit (void) 
+{
+  struct semaphore release;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  msg ("runtime past deadline: %s",
+       thread_set_edf (5, 10, 4) ? "admitted" : "refused");
+  msg ("deadline past period: %s",
+       thread_set_edf (5, 10, 20) ? "admitted" : "refused");
+  msg ("negative runtime: %s",
+       thread_set_edf (-1, 10, 0) ? "admitted" : "refused");
+
+  sema_init (&release, 0);
+  thread_create ("holder", PRI_DEFAULT + 1, holder_thread_func, &release);
+
+  msg ("40%% more: %s", thread_set_edf (4, 10, 0) ? "admitted" : "refused");
+  msg ("30%% more: %s", thread_set_edf (3, 10, 0) ? "admitted" : "refused");
+  msg ("30%% again: %s", thread_set_edf (3, 10, 0) ? "admitted" : "refused");
+  thread_set_edf (0, 0, 0);
+
+  sema_up (&release);
+  msg ("90%% alone: %s", thread_set_edf (9, 10, 0) ? "admitted" : "refused");
+  thread_set_edf (0, 0, 0);
+}
+
+static void
+holder_thread_func (void *release_) 
+{
+  struct semaphore *release = release_;
+
+  msg ("holder 60%%: %s", thread_set_edf (6, 10, 0) ? "admitted" : "refused");
+  sema_down (release);
+  msg ("holder exits");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(edf-admit) begin
+(edf-admit) runtime past deadline: refused
+(edf-admit) deadline past period: refused
+(edf-admit) negative runtime: refused
+(edf-admit) holder 60%: admitted
+(edf-admit) 40% more: refused
+(edf-admit) 30% more: admitted
+(edf-admit) 30% again: admitted
+(edf-admit) holder exits
+(edf-admit) 90% alone: admitted
+(edf-admit) end
+EOF
+pass;
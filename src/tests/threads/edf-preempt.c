@@ -0,0 +1,58 @@
+/* Checks that threads in the earliest-deadline-first class run
+   ahead of any priority, earliest deadline first.  A thread of
+   the highest priority wakes an EDF thread, which must run
+   before it finishes; that thread wakes another with an earlier
+   deadline, which must run before it finishes in turn. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func late_thread_func;
+static thread_func early_thread_func;
+static thread_func high_thread_func;
+static struct semaphore late_go, early_go;
+
+void
+test_edf_preempt (void) 
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&late_go, 0);
+  sema_init (&early_go, 0);
+  thread_create ("late", PRI_DEFAULT + 1, late_thread_func, NULL);
+  thread_create ("early", PRI_DEFAULT + 1, early_thread_func, NULL);
+  thread_create ("high", PRI_MAX, high_thread_func, NULL);
+  msg ("All three threads should have already completed.");
+}
+
+static void
+late_thread_func (void *aux UNUSED) 
+{
+  if (!thread_set_edf (5, 100, 0))
+    fail ("late not admitted");
+  sema_down (&late_go);
+  msg ("late wakes early");
+  sema_up (&early_go);
+  msg ("late done");
+}
+
+static void
+early_thread_func (void *aux UNUSED) 
+{
+  if (!thread_set_edf (5, 100, 20))
+    fail ("early not admitted");
+  sema_down (&early_go);
+  msg ("early done");
+}
+
+static void
+high_thread_func (void *aux UNUSED) 
+{
+  msg ("high wakes late");
+  sema_up (&late_go);
+  msg ("high done");
+}
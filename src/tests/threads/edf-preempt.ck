@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(edf-preempt) begin
+(edf-preempt) high wakes late
+(edf-preempt) late wakes early
+(edf-preempt) early done
+(edf-preempt) late done
+(edf-preempt) high done
+(edf-preempt) All three threads should have already completed.
+(edf-preempt) end
+EOF
+pass;
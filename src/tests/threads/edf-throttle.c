@@ -0,0 +1,48 @@
+/* Checks that a thread in the earliest-deadline-first class that
+   uses up its runtime stops running until its next period.  A
+   thread allowed 2 ticks out of every 20 spins, and the main
+   thread, of lower priority, must get to run before the spinning
+   thread's time is up. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static thread_func spinner_thread_func;
+static struct semaphore done;
+static volatile bool main_ran;
+
+void
+test_edf_throttle (void) 
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done, 0);
+  main_ran = false;
+  thread_create ("spinner", PRI_DEFAULT + 1, spinner_thread_func, NULL);
+  msg ("main thread runs");
+  main_ran = true;
+  sema_down (&done);
+  msg ("spinner done");
+}
+
+static void
+spinner_thread_func (void *aux UNUSED) 
+{
+  int64_t start;
+
+  if (!thread_set_edf (2, 20, 0))
+    fail ("spinner not admitted");
+  msg ("spinner admitted");
+
+  /* Without throttling, nothing else could run for 100 ticks. */
+  start = timer_ticks ();
+  while (!main_ran && timer_elapsed (start) < 100)
+    barrier ();
+  msg ("spinner %s", main_ran ? "was throttled" : "was never throttled");
+  sema_up (&done);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(edf-throttle) begin
+(edf-throttle) spinner admitted
+(edf-throttle) main thread runs
+(edf-throttle) spinner was throttled
+(edf-throttle) spinner done
+(edf-throttle) end
+EOF
+pass;
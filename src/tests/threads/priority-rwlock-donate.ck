@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-rwlock-donate) begin
+(priority-rwlock-donate) Main thread should have priority 41.  Actual priority: 41.
+(priority-rwlock-donate) Medium thread should not have run yet.
+(priority-rwlock-donate) writer: got the lock
+(priority-rwlock-donate) writer: done
+(priority-rwlock-donate) medium: ran
+(priority-rwlock-donate) Main thread should have priority 31.  Actual priority: 31.
+(priority-rwlock-donate) end
+EOF
+pass;
@@ -0,0 +1,76 @@
+/* Checks the timed and non-blocking forms of reader-writer lock
+   acquisition.  A writer that waits for a reader with
+   rwlock_acquire_write_timeout() gives up when the time runs out
+   and lets the lock be taken afterward, and so does a reader
+   waiting for a writer with rwlock_acquire_read_timeout().  A
+   timed acquisition of a free lock succeeds at once. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static thread_func writer_thread_func;
+static thread_func reader_thread_func;
+
+void
+test_priority_rwlock_timeout (void) 
+{
+  struct rwlock rw;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  rwlock_init (&rw);
+
+  /* A writer times out waiting for a reader. */
+  rwlock_acquire_read (&rw);
+  msg ("try write while read: %s",
+       rwlock_try_acquire_write (&rw) ? "acquired" : "busy");
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread_func, &rw);
+  timer_sleep (20);
+  rwlock_release_read (&rw);
+  if (rwlock_try_acquire_write (&rw))
+    {
+      msg ("try write when free: acquired");
+      rwlock_release_write (&rw);
+    }
+
+  /* A reader times out waiting for a writer. */
+  rwlock_acquire_write (&rw);
+  thread_create ("reader", PRI_DEFAULT + 1, reader_thread_func, &rw);
+  timer_sleep (20);
+  rwlock_release_write (&rw);
+  thread_create ("reader", PRI_DEFAULT + 1, reader_thread_func, &rw);
+  msg ("This should be the last line before finishing this test.");
+}
+
+static void
+writer_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  if (rwlock_acquire_write_timeout (rw, 5))
+    {
+      msg ("writer: got the lock");
+      rwlock_release_write (rw);
+    }
+  else
+    msg ("writer: timed out");
+}
+
+static void
+reader_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  if (rwlock_acquire_read_timeout (rw, 5))
+    {
+      msg ("reader: got the lock");
+      rwlock_release_read (rw);
+    }
+  else
+    msg ("reader: timed out");
+}
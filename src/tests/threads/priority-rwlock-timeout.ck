@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-rwlock-timeout) begin
+(priority-rwlock-timeout) try write while read: busy
+(priority-rwlock-timeout) writer: timed out
+(priority-rwlock-timeout) try write when free: acquired
+(priority-rwlock-timeout) reader: timed out
+(priority-rwlock-timeout) reader: got the lock
+(priority-rwlock-timeout) This should be the last line before finishing this test.
+(priority-rwlock-timeout) end
+EOF
+pass;
@@ -25,10 +25,16 @@ static const struct test tests[] =
     {"priority-donate-sema", test_priority_donate_sema},
     {"priority-donate-lower", test_priority_donate_lower},
     {"priority-donate-chain", test_priority_donate_chain},
+    {"priority-rwlock-writer", test_priority_rwlock_writer},
+    {"priority-rwlock-donate", test_priority_rwlock_donate},
+    {"priority-rwlock-timeout", test_priority_rwlock_timeout},
     {"priority-fifo", test_priority_fifo},
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"edf-admit", test_edf_admit},
+    {"edf-throttle", test_edf_throttle},
+    {"edf-preempt", test_edf_preempt},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
@@ -38,6 +44,10 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"bench-switch", test_bench_switch},
+    {"bench-sema-pingpong", test_bench_sema_pingpong},
+    {"bench-wakeup", test_bench_wakeup},
+    {"bench-lock-donate", test_bench_lock_donate},
   };
 
 static const char *test_name;
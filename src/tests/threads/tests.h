@@ -19,10 +19,16 @@ extern test_func test_priority_donate_sema;
 extern test_func test_priority_donate_nest;
 extern test_func test_priority_donate_lower;
 extern test_func test_priority_donate_chain;
+extern test_func test_priority_rwlock_writer;
+extern test_func test_priority_rwlock_donate;
+extern test_func test_priority_rwlock_timeout;
 extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_edf_admit;
+extern test_func test_edf_throttle;
+extern test_func test_edf_preempt;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
@@ -32,6 +38,10 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_bench_switch;
+extern test_func test_bench_sema_pingpong;
+extern test_func test_bench_wakeup;
+extern test_func test_bench_lock_donate;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
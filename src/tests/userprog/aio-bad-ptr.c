@@ -0,0 +1,23 @@
+/* Passes aio_read() a buffer in kernel memory, which it must
+   refuse, and then a control block in kernel memory.  The process
+   must be terminated with -1 exit code. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  struct aiocb cb;
+
+  CHECK ((cb.fd = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  cb.buffer = (void *) 0xc0100000;
+  cb.length = 100;
+  cb.offset = 0;
+  cb.tag = 0;
+  CHECK (!aio_read (&cb), "aio_read into kernel memory fails");
+
+  aio_read ((struct aiocb *) 0xc0100000);
+  fail ("should not have survived aio_read()");
+}
@@ -0,0 +1,88 @@
+/* Writes two blocks of a file with aio_write() and reads them
+   back with aio_read(), collecting each batch of results with
+   aio_reap().  Also checks the requests aio_read() must refuse. */
+
+#include <aio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BLOCK 512
+
+static char out[2][BLOCK], in[2][BLOCK];
+
+/* Reaps CNT results, which must have tags FIRST_TAG and the one
+   after it, in either order, each having moved BLOCK bytes. */
+static void
+reap (int cnt, unsigned first_tag) 
+{
+  bool seen[2] = {false, false};
+  int got = 0;
+
+  while (got < cnt)
+    {
+      struct io_cqe cqe;
+      unsigned i;
+
+      if (aio_reap (&cqe, 1, true) != 1)
+        fail ("aio_reap() returned no result");
+      i = cqe.tag - first_tag;
+      if (i > 1 || seen[i])
+        fail ("unexpected tag %u", cqe.tag);
+      if (cqe.result != BLOCK)
+        fail ("request %u moved %d bytes", cqe.tag, cqe.result);
+      seen[i] = true;
+      got++;
+    }
+}
+
+void
+test_main (void) 
+{
+  struct aiocb cb;
+  struct io_cqe cqe;
+  int handle, i;
+
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+  memset (out[0], 'a', BLOCK);
+  memset (out[1], 'b', BLOCK);
+
+  for (i = 0; i < 2; i++)
+    {
+      cb.fd = handle;
+      cb.buffer = out[i];
+      cb.length = BLOCK;
+      cb.offset = i * BLOCK;
+      cb.tag = 10 + i;
+      if (!aio_write (&cb))
+        fail ("aio_write %d failed", i);
+    }
+  msg ("aio_write 2 blocks");
+  reap (2, 10);
+  msg ("reaped 2 writes");
+
+  for (i = 0; i < 2; i++)
+    {
+      cb.fd = handle;
+      cb.buffer = in[i];
+      cb.length = BLOCK;
+      cb.offset = i * BLOCK;
+      cb.tag = 20 + i;
+      if (!aio_read (&cb))
+        fail ("aio_read %d failed", i);
+    }
+  msg ("aio_read 2 blocks");
+  reap (2, 20);
+  msg ("reaped 2 reads");
+  compare_bytes (in[0], out[0], BLOCK, 0, "test.txt");
+  compare_bytes (in[1], out[1], BLOCK, BLOCK, "test.txt");
+
+  CHECK (aio_reap (&cqe, 1, true) == 0, "aio_reap with none in flight");
+  cb.length = AIO_MAX_LENGTH + 1;
+  CHECK (!aio_read (&cb), "aio_read over AIO_MAX_LENGTH fails");
+  cb.length = BLOCK;
+  cb.fd = 5678;
+  CHECK (!aio_read (&cb), "aio_read of bad fd fails");
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(aio-simple) begin
+(aio-simple) create "test.txt"
+(aio-simple) open "test.txt"
+(aio-simple) aio_write 2 blocks
+(aio-simple) reaped 2 writes
+(aio-simple) aio_read 2 blocks
+(aio-simple) reaped 2 reads
+(aio-simple) aio_reap with none in flight
+(aio-simple) aio_read over AIO_MAX_LENGTH fails
+(aio-simple) aio_read of bad fd fails
+(aio-simple) end
+aio-simple: exit(0)
+EOF
+pass;
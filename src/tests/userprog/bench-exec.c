@@ -0,0 +1,28 @@
+/* Measures how long exec() of child-simple and wait() for it
+   take together. */
+
+#include <syscall.h>
+#include "tests/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static void
+exec_and_wait (void *aux UNUSED, unsigned iters) 
+{
+  unsigned i;
+
+  for (i = 0; i < iters; i++)
+    {
+      pid_t pid = exec ("child-simple");
+      if (pid == PID_ERROR)
+        fail ("exec failed");
+      if (wait (pid) != 81)
+        fail ("child did not exit with 81");
+    }
+}
+
+void
+test_main (void) 
+{
+  bench_measure ("exec", exec_and_wait, NULL);
+}
@@ -0,0 +1,108 @@
+/* Measures the round-trip cost of cheap system calls, of small
+   reads and writes, of opening and closing a file several
+   directories deep, and of validating a large user buffer.  See
+   bench-exec for exec() and wait(). */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Big enough that validating it covers many pages. */
+#define BIG_SIZE (64 * 1024)
+
+static char big[BIG_SIZE];
+
+static const char *deep_file = "/a/b/c/d/e/f/g/h/file";
+
+static void
+do_tell (void *fd, unsigned iters) 
+{
+  unsigned i;
+
+  for (i = 0; i < iters; i++)
+    tell (*(int *) fd);
+}
+
+static void
+do_filesize (void *fd, unsigned iters) 
+{
+  unsigned i;
+
+  for (i = 0; i < iters; i++)
+    if (filesize (*(int *) fd) != 1)
+      fail ("filesize failed");
+}
+
+static void
+do_pread_1 (void *fd, unsigned iters) 
+{
+  unsigned i;
+
+  for (i = 0; i < iters; i++)
+    if (pread (*(int *) fd, big, 1, 0) != 1)
+      fail ("pread failed");
+}
+
+static void
+do_pwrite_1 (void *fd, unsigned iters) 
+{
+  unsigned i;
+
+  for (i = 0; i < iters; i++)
+    if (pwrite (*(int *) fd, big, 1, 0) != 1)
+      fail ("pwrite failed");
+}
+
+/* Reads BIG_SIZE bytes at end of file, which reads nothing, so
+   that the cost is that of checking the buffer. */
+static void
+do_read_eof_big (void *fd, unsigned iters) 
+{
+  unsigned i;
+
+  for (i = 0; i < iters; i++)
+    if (pread (*(int *) fd, big, BIG_SIZE, 1) != 0)
+      fail ("pread at end of file failed");
+}
+
+static void
+do_open_close_deep (void *aux UNUSED, unsigned iters) 
+{
+  unsigned i;
+
+  for (i = 0; i < iters; i++)
+    {
+      int fd = open (deep_file);
+      if (fd < 2)
+        fail ("open \"%s\" failed", deep_file);
+      close (fd);
+    }
+}
+
+void
+test_main (void) 
+{
+  char dir[sizeof "/a/b/c/d/e/f/g/h"];
+  size_t i;
+  int fd;
+
+  CHECK (create ("small", 1), "create \"small\"");
+  CHECK ((fd = open ("small")) > 1, "open \"small\"");
+  for (i = 0; i < 8; i++)
+    {
+      strlcpy (dir, deep_file, i * 2 + 3);
+      if (!mkdir (dir))
+        fail ("mkdir \"%s\"", dir);
+    }
+  CHECK (create (deep_file, 0), "create \"%s\"", deep_file);
+
+  bench_measure ("tell", do_tell, &fd);
+  bench_measure ("filesize", do_filesize, &fd);
+  bench_measure ("pread_1", do_pread_1, &fd);
+  bench_measure ("pwrite_1", do_pwrite_1, &fd);
+  bench_measure ("read_eof_64k", do_read_eof_big, &fd);
+  bench_measure ("open_close_deep", do_open_close_deep, NULL);
+  close (fd);
+}
@@ -0,0 +1,23 @@
+/* Child process run by the spawn tests.
+   Writes each of its arguments on a line of its own to standard
+   output, whatever that has been made, and exits with code 0. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-spawn";
+
+int
+main (int argc, char *argv[]) 
+{
+  int i;
+
+  for (i = 1; i < argc; i++)
+    {
+      write (STDOUT_FILENO, argv[i], strlen (argv[i]));
+      write (STDOUT_FILENO, "\n", 1);
+    }
+  return 0;
+}
@@ -0,0 +1,35 @@
+/* Passes copy_file_range() overlapping ranges of one file, and
+   fds that are not open files.  Each call must fail with -1 and
+   leave the positions alone.  Ranges of one file that do not
+   overlap are copied. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int a, b;
+
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((a = open ("test.txt")) > 1, "open \"test.txt\"");
+  CHECK ((b = open ("test.txt")) > 1, "open \"test.txt\" again");
+  CHECK (write (a, sample, sizeof sample - 1) == (int) sizeof sample - 1,
+         "write \"test.txt\"");
+  seek (a, 0);
+  seek (b, 10);
+
+  CHECK (copy_file_range (a, b, 20) == -1, "copy onto overlapping range");
+  CHECK (copy_file_range (b, a, 11) == -1, "copy from overlapping range");
+  CHECK (copy_file_range (a, a, 1) == -1, "copy onto the same fd");
+  CHECK (tell (a) == 0 && tell (b) == 10, "positions unchanged");
+
+  CHECK (copy_file_range (a, 1, 10) == -1, "copy to stdout");
+  CHECK (copy_file_range (a, 5280, 10) == -1, "copy to bad fd");
+  CHECK (copy_file_range (5280, b, 10) == -1, "copy from bad fd");
+
+  CHECK (copy_file_range (a, b, 10) == 10, "copy onto adjacent range");
+  CHECK (tell (a) == 10 && tell (b) == 20, "positions advanced");
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(copy-range-overlap) begin
+(copy-range-overlap) create "test.txt"
+(copy-range-overlap) open "test.txt"
+(copy-range-overlap) open "test.txt" again
+(copy-range-overlap) write "test.txt"
+(copy-range-overlap) copy onto overlapping range
+(copy-range-overlap) copy from overlapping range
+(copy-range-overlap) copy onto the same fd
+(copy-range-overlap) positions unchanged
+(copy-range-overlap) copy to stdout
+(copy-range-overlap) copy to bad fd
+(copy-range-overlap) copy from bad fd
+(copy-range-overlap) copy onto adjacent range
+(copy-range-overlap) positions advanced
+(copy-range-overlap) end
+copy-range-overlap: exit(0)
+EOF
+pass;
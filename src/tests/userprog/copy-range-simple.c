@@ -0,0 +1,37 @@
+/* Copies a file with copy_file_range() in two calls, the second
+   of which asks for more than is left, and checks that both
+   positions advance by what was copied and that a copy at the
+   end of the source copies nothing. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int size = sizeof sample - 1;
+  int in, out;
+
+  CHECK (create ("in.txt", 0), "create \"in.txt\"");
+  CHECK ((in = open ("in.txt")) > 1, "open \"in.txt\"");
+  CHECK (write (in, sample, size) == size, "write \"in.txt\"");
+  seek (in, 0);
+  CHECK (create ("out.txt", 0), "create \"out.txt\"");
+  CHECK ((out = open ("out.txt")) > 1, "open \"out.txt\"");
+
+  CHECK (copy_file_range (in, out, size / 2) == size / 2, "copy first half");
+  CHECK (tell (in) == (unsigned) size / 2 && tell (out) == (unsigned) size / 2,
+         "positions advanced");
+  CHECK (copy_file_range (in, out, size) == size - size / 2,
+         "copy stops at end of \"in.txt\"");
+  CHECK (tell (in) == (unsigned) size && tell (out) == (unsigned) size,
+         "positions advanced");
+  CHECK (copy_file_range (in, out, 10) == 0, "copy at end of \"in.txt\"");
+  CHECK (tell (out) == (unsigned) size, "position unchanged");
+
+  msg ("close \"out.txt\"");
+  close (out);
+  check_file ("out.txt", sample, size);
+}
@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(copy-range-simple) begin
+(copy-range-simple) create "in.txt"
+(copy-range-simple) open "in.txt"
+(copy-range-simple) write "in.txt"
+(copy-range-simple) create "out.txt"
+(copy-range-simple) open "out.txt"
+(copy-range-simple) copy first half
+(copy-range-simple) positions advanced
+(copy-range-simple) copy stops at end of "in.txt"
+(copy-range-simple) positions advanced
+(copy-range-simple) copy at end of "in.txt"
+(copy-range-simple) position unchanged
+(copy-range-simple) close "out.txt"
+(copy-range-simple) open "out.txt" for verification
+(copy-range-simple) verified contents of "out.txt"
+(copy-range-simple) close "out.txt"
+(copy-range-simple) end
+copy-range-simple: exit(0)
+EOF
+pass;
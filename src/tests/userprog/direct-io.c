@@ -0,0 +1,55 @@
+/* Mixes cached and direct I/O on one file and checks that each
+   sees what the other wrote: a direct read after a cached write,
+   a cached read after a direct write, and a transfer that is not
+   sector-aligned, which goes through the cache even in direct
+   mode. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE 1024
+
+static char buf[SIZE] __attribute__ ((aligned (512)));
+static char expect[SIZE];
+
+static void
+check_buf (const char *what) 
+{
+  compare_bytes (buf, expect, SIZE, 0, "test.txt");
+  msg ("%s", what);
+}
+
+void
+test_main (void) 
+{
+  int handle;
+
+  CHECK (create ("test.txt", SIZE), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+
+  memset (expect, 'a', SIZE);
+  CHECK (pwrite (handle, expect, SIZE, 0) == SIZE, "cached write");
+  CHECK (set_direct (handle, true), "set_direct on");
+  memset (buf, 0, SIZE);
+  CHECK (pread (handle, buf, SIZE, 0) == SIZE, "direct read");
+  check_buf ("direct read sees cached write");
+
+  memset (expect, 'b', SIZE);
+  memcpy (buf, expect, SIZE);
+  CHECK (pwrite (handle, buf, SIZE, 0) == SIZE, "direct write");
+  CHECK (set_direct (handle, false), "set_direct off");
+  memset (buf, 0, SIZE);
+  CHECK (pread (handle, buf, SIZE, 0) == SIZE, "cached read");
+  check_buf ("cached read sees direct write");
+
+  CHECK (set_direct (handle, true), "set_direct on");
+  memset (expect + 100, 'c', 10);
+  CHECK (pwrite (handle, expect + 100, 10, 100) == 10, "unaligned write");
+  memset (buf, 0, SIZE);
+  CHECK (pread (handle, buf, SIZE, 0) == SIZE, "direct read");
+  check_buf ("direct read sees unaligned write");
+
+  CHECK (!set_direct (5678, true), "set_direct on bad fd fails");
+}
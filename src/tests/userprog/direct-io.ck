@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(direct-io) begin
+(direct-io) create "test.txt"
+(direct-io) open "test.txt"
+(direct-io) cached write
+(direct-io) set_direct on
+(direct-io) direct read
+(direct-io) direct read sees cached write
+(direct-io) direct write
+(direct-io) set_direct off
+(direct-io) cached read
+(direct-io) cached read sees direct write
+(direct-io) set_direct on
+(direct-io) unaligned write
+(direct-io) direct read
+(direct-io) direct read sees unaligned write
+(direct-io) set_direct on bad fd fails
+(direct-io) end
+direct-io: exit(0)
+EOF
+pass;
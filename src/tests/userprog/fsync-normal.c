@@ -0,0 +1,27 @@
+/* Writes a file and flushes it with fsync() and sync(), then
+   checks fsync() on descriptors that are not open files. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int handle;
+
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+  CHECK (write (handle, sample, sizeof sample - 1)
+         == (int) (sizeof sample - 1), "write \"test.txt\"");
+  CHECK (fsync (handle), "fsync \"test.txt\"");
+  msg ("sync");
+  sync ();
+  close (handle);
+
+  CHECK (!fsync (handle), "fsync closed handle fails");
+  CHECK (!fsync (1), "fsync stdout fails");
+  CHECK (!fsync (5678), "fsync bad fd fails");
+  check_file ("test.txt", sample, sizeof sample - 1);
+}
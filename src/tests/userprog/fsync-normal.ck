@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fsync-normal) begin
+(fsync-normal) create "test.txt"
+(fsync-normal) open "test.txt"
+(fsync-normal) write "test.txt"
+(fsync-normal) fsync "test.txt"
+(fsync-normal) sync
+(fsync-normal) fsync closed handle fails
+(fsync-normal) fsync stdout fails
+(fsync-normal) fsync bad fd fails
+(fsync-normal) open "test.txt" for verification
+(fsync-normal) verified contents of "test.txt"
+(fsync-normal) close "test.txt"
+(fsync-normal) end
+fsync-normal: exit(0)
+EOF
+pass;
@@ -0,0 +1,13 @@
+/* Passes futex_wait() a word in kernel memory.
+   The process must be terminated with -1 exit code. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  futex_wait ((int *) 0xc0100000, 0);
+  fail ("should not have survived futex_wait()");
+}
@@ -0,0 +1,20 @@
+/* Calls futex_wait() when it must not sleep: the word does not
+   hold the value, or the address is misaligned.  Each call must
+   return -1 at once.  futex_wake() with nobody waiting must
+   return 0. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int words[2];
+
+void
+test_main (void) 
+{
+  words[0] = 5;
+  CHECK (futex_wait (&words[0], 4) == -1, "futex_wait on changed word");
+  CHECK (futex_wait ((int *) ((char *) words + 1), 0) == -1,
+         "futex_wait on misaligned word");
+  CHECK (futex_wake (&words[0], 1) == 0, "futex_wake with no waiters");
+}
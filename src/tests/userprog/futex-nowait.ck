@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex-nowait) begin
+(futex-nowait) futex_wait on changed word
+(futex-nowait) futex_wait on misaligned word
+(futex-nowait) futex_wake with no waiters
+(futex-nowait) end
+futex-nowait: exit(0)
+EOF
+pass;
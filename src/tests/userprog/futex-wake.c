@@ -0,0 +1,35 @@
+/* Starts a thread that sleeps in futex_wait() until the word it
+   waits on changes, then changes the word and wakes it. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int word;
+static int woken;
+
+static void
+waiter (void *aux UNUSED) 
+{
+  while (word == 0)
+    futex_wait (&word, 0);
+  woken = 1;
+  uthread_exit (7);
+}
+
+void
+test_main (void) 
+{
+  tid_t tid;
+
+  CHECK ((tid = uthread_create (waiter, NULL)) != TID_ERROR,
+         "uthread_create");
+  msleep (100);
+  CHECK (!woken, "waiter still asleep");
+
+  word = 1;
+  msg ("futex_wake");
+  futex_wake (&word, 1);
+  CHECK (uthread_join (tid) == 7, "uthread_join");
+  CHECK (woken, "waiter woke up");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex-wake) begin
+(futex-wake) uthread_create
+(futex-wake) waiter still asleep
+(futex-wake) futex_wake
+(futex-wake) uthread_join
+(futex-wake) waiter woke up
+(futex-wake) end
+futex-wake: exit(0)
+EOF
+pass;
@@ -0,0 +1,20 @@
+/* Sets a limit of 3 open files and checks that a 4th open()
+   fails until one of the 3 is closed. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fds[3];
+  int i;
+
+  CHECK (set_limit (LIMIT_FILES, 3), "set_limit (LIMIT_FILES, 3)");
+  for (i = 0; i < 3; i++)
+    CHECK ((fds[i] = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (open ("sample.txt") == -1, "4th open fails");
+  close (fds[1]);
+  CHECK (open ("sample.txt") > 1, "open after close");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(limit-files) begin
+(limit-files) set_limit (LIMIT_FILES, 3)
+(limit-files) open "sample.txt"
+(limit-files) open "sample.txt"
+(limit-files) open "sample.txt"
+(limit-files) 4th open fails
+(limit-files) open after close
+(limit-files) end
+limit-files: exit(0)
+EOF
+pass;
@@ -0,0 +1,22 @@
+/* Checks that get_limit() reports what set_limit() sets, and
+   that a process may tighten its limits but never loosen or
+   remove them. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  CHECK (get_limit (LIMIT_FILES) == 0, "no file limit at first");
+  CHECK (set_limit (LIMIT_FILES, 8), "set_limit (LIMIT_FILES, 8)");
+  CHECK (get_limit (LIMIT_FILES) == 8, "get_limit (LIMIT_FILES) is 8");
+  CHECK (set_limit (LIMIT_FILES, 4), "set_limit (LIMIT_FILES, 4)");
+  CHECK (!set_limit (LIMIT_FILES, 6), "loosening it fails");
+  CHECK (!set_limit (LIMIT_FILES, 0), "removing it fails");
+  CHECK (get_limit (LIMIT_FILES) == 4, "get_limit (LIMIT_FILES) is 4");
+  CHECK (get_limit (LIMIT_IO_RATE) == 0, "other limits are untouched");
+  CHECK (!set_limit (LIMIT_CNT, 1), "unknown resource fails");
+  CHECK (get_limit (-1) == 0, "unknown resource has no limit");
+}
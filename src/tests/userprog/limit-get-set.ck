@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(limit-get-set) begin
+(limit-get-set) no file limit at first
+(limit-get-set) set_limit (LIMIT_FILES, 8)
+(limit-get-set) get_limit (LIMIT_FILES) is 8
+(limit-get-set) set_limit (LIMIT_FILES, 4)
+(limit-get-set) loosening it fails
+(limit-get-set) removing it fails
+(limit-get-set) get_limit (LIMIT_FILES) is 4
+(limit-get-set) other limits are untouched
+(limit-get-set) unknown resource fails
+(limit-get-set) unknown resource has no limit
+(limit-get-set) end
+limit-get-set: exit(0)
+EOF
+pass;
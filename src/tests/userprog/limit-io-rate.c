@@ -0,0 +1,38 @@
+/* Limits the process to RATE disk sectors a second and writes
+   SECTORS sectors to a new file.  The writes are charged as they
+   dirty the buffer cache, even though the disk sees them only
+   later, so the process must be held back for about
+   (SECTORS / RATE) s, less the 100 ms of credit it may save up. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define RATE 200
+#define SECTORS 100
+#define MIN_MS 300
+
+static char buf[512];
+
+void
+test_main (void) 
+{
+  uint64_t start, elapsed;
+  int fd, i;
+
+  CHECK (create ("limited", 0), "create \"limited\"");
+  CHECK ((fd = open ("limited")) > 1, "open \"limited\"");
+  CHECK (set_limit (LIMIT_IO_RATE, RATE), "set_limit (LIMIT_IO_RATE, %d)",
+         RATE);
+
+  start = clock_ns ();
+  for (i = 0; i < SECTORS; i++)
+    if (write (fd, buf, sizeof buf) != sizeof buf)
+      fail ("write of sector %d failed", i);
+  elapsed = clock_ns () - start;
+  msg ("write %d sectors", SECTORS);
+  if (elapsed < MIN_MS * 1000000ULL)
+    fail ("took only %u ms", (unsigned) (elapsed / 1000000));
+  msg ("took at least %d ms", MIN_MS);
+  close (fd);
+}
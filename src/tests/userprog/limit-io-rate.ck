@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(limit-io-rate) begin
+(limit-io-rate) create "limited"
+(limit-io-rate) open "limited"
+(limit-io-rate) set_limit (LIMIT_IO_RATE, 200)
+(limit-io-rate) write 100 sectors
+(limit-io-rate) took at least 300 ms
+(limit-io-rate) end
+limit-io-rate: exit(0)
+EOF
+pass;
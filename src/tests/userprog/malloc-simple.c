@@ -0,0 +1,84 @@
+/* Allocates blocks of many sizes with malloc(), calloc() and
+   realloc(), fills each with its own pattern, frees every other
+   one and allocates again, and checks that no block overwrote
+   another. */
+
+#include <malloc.h>
+#include <stdint.h>
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BLOCK_CNT 64
+
+static char *blocks[BLOCK_CNT];
+static size_t sizes[BLOCK_CNT];
+
+static void
+check_block (int i) 
+{
+  size_t j;
+
+  if ((uintptr_t) blocks[i] % 16 != 0)
+    fail ("block %d at %p is misaligned", i, blocks[i]);
+  for (j = 0; j < sizes[i]; j++)
+    if (blocks[i][j] != (char) i)
+      fail ("byte %zu of block %d is %d", j, i, blocks[i][j]);
+}
+
+static void
+alloc_block (int i, size_t size) 
+{
+  blocks[i] = malloc (size);
+  if (blocks[i] == NULL)
+    fail ("malloc (%zu) failed", size);
+  sizes[i] = size;
+  memset (blocks[i], i, size);
+}
+
+void
+test_main (void) 
+{
+  char *z;
+  size_t j;
+  int i;
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    alloc_block (i, 1 + i * 97 % 5000);
+  for (i = 0; i < BLOCK_CNT; i++)
+    check_block (i);
+  msg ("malloc");
+
+  for (i = 0; i < BLOCK_CNT; i += 2)
+    free (blocks[i]);
+  for (i = 0; i < BLOCK_CNT; i += 2)
+    alloc_block (i, 1 + i * 31 % 3000);
+  for (i = 0; i < BLOCK_CNT; i++)
+    check_block (i);
+  msg ("free and malloc again");
+
+  for (i = 1; i < BLOCK_CNT; i += 2)
+    {
+      size_t old = sizes[i];
+      blocks[i] = realloc (blocks[i], old * 2);
+      if (blocks[i] == NULL)
+        fail ("realloc failed");
+      memset (blocks[i] + old, i, old);
+      sizes[i] = old * 2;
+    }
+  for (i = 0; i < BLOCK_CNT; i++)
+    check_block (i);
+  msg ("realloc");
+
+  z = calloc (100, 33);
+  if (z == NULL)
+    fail ("calloc failed");
+  for (j = 0; j < 100 * 33; j++)
+    if (z[j] != 0)
+      fail ("byte %zu from calloc is %d", j, z[j]);
+  msg ("calloc");
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    free (blocks[i]);
+  free (z);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(malloc-simple) begin
+(malloc-simple) malloc
+(malloc-simple) free and malloc again
+(malloc-simple) realloc
+(malloc-simple) calloc
+(malloc-simple) end
+malloc-simple: exit(0)
+EOF
+pass;
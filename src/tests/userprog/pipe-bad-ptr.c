@@ -0,0 +1,13 @@
+/* Passes pipe() a descriptor array in kernel memory.
+   The process must be terminated with -1 exit code. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  pipe ((int *) 0xc0100000);
+  fail ("should not have survived pipe()");
+}
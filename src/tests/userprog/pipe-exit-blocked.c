@@ -0,0 +1,28 @@
+/* Starts a thread that blocks reading a pipe no one will write
+   to, then exits the process from the main thread.  The reader
+   must be woken to exit along with it, or the process hangs. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int fds[2];
+
+static void
+reader (void *aux UNUSED) 
+{
+  char c;
+
+  read (fds[0], &c, 1);
+  fail ("read returned");
+}
+
+void
+test_main (void) 
+{
+  CHECK (pipe (fds), "pipe");
+  CHECK (uthread_create (reader, NULL) != TID_ERROR, "uthread_create");
+  msleep (100);
+  msg ("exit with the reader blocked");
+  exit (57);
+}
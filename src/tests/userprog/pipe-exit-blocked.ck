@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-exit-blocked) begin
+(pipe-exit-blocked) pipe
+(pipe-exit-blocked) uthread_create
+(pipe-exit-blocked) exit with the reader blocked
+pipe-exit-blocked: exit(57)
+EOF
+pass;
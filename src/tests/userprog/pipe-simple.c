@@ -0,0 +1,31 @@
+/* Writes to a pipe and reads the bytes back from its other end,
+   then closes the write end and checks that the read end sees the
+   end of the stream. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  size_t size = sizeof sample - 1;
+  char buf[sizeof sample];
+  int fds[2];
+
+  CHECK (pipe (fds), "pipe");
+  CHECK (fds[0] > 1 && fds[1] > 1 && fds[0] != fds[1],
+         "pipe descriptors are distinct");
+
+  CHECK (write (fds[1], sample, size) == (int) size, "write to pipe");
+  CHECK (read (fds[0], buf, sizeof buf) == (int) size, "read from pipe");
+  compare_bytes (buf, sample, size, 0, "pipe");
+
+  CHECK (write (fds[0], sample, size) == -1, "write to read end fails");
+  CHECK (read (fds[1], buf, sizeof buf) == -1, "read from write end fails");
+
+  close (fds[1]);
+  CHECK (read (fds[0], buf, sizeof buf) == 0, "read at end of stream");
+  close (fds[0]);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-simple) begin
+(pipe-simple) pipe
+(pipe-simple) pipe descriptors are distinct
+(pipe-simple) write to pipe
+(pipe-simple) read from pipe
+(pipe-simple) write to read end fails
+(pipe-simple) read from write end fails
+(pipe-simple) read at end of stream
+(pipe-simple) end
+pipe-simple: exit(0)
+EOF
+pass;
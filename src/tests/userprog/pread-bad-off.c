@@ -0,0 +1,30 @@
+/* Passes pread() and pwrite() offsets past the largest file
+   offset, and ranges that would run past it.  Each call must
+   fail with -1 and leave the file alone. */
+
+#include <limits.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[16];
+  int handle;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+
+  CHECK (pread (handle, buf, sizeof buf, -1) == -1, "pread at -1");
+  CHECK (pread (handle, buf, sizeof buf, 0x80000000) == -1,
+         "pread at 0x80000000");
+  CHECK (pread (handle, buf, sizeof buf, INT_MAX - 4) == -1,
+         "pread across INT_MAX");
+  CHECK (pwrite (handle, buf, sizeof buf, -1) == -1, "pwrite at -1");
+  CHECK (pwrite (handle, buf, sizeof buf, 0x80000000) == -1,
+         "pwrite at 0x80000000");
+  CHECK (pwrite (handle, buf, sizeof buf, INT_MAX - 4) == -1,
+         "pwrite across INT_MAX");
+  check_file_handle (handle, "sample.txt", sample, sizeof sample - 1);
+}
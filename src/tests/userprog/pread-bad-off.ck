@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pread-bad-off) begin
+(pread-bad-off) open "sample.txt"
+(pread-bad-off) pread at -1
+(pread-bad-off) pread at 0x80000000
+(pread-bad-off) pread across INT_MAX
+(pread-bad-off) pwrite at -1
+(pread-bad-off) pwrite at 0x80000000
+(pread-bad-off) pwrite across INT_MAX
+(pread-bad-off) verified contents of "sample.txt"
+(pread-bad-off) end
+pread-bad-off: exit(0)
+EOF
+pass;
@@ -0,0 +1,16 @@
+/* Passes pread() a buffer in kernel memory.  The call must fail
+   with -1 or the process must be terminated with exit code -1. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int handle;
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+
+  if (pread (handle, (char *) 0xc0100000, 123, 0) != -1)
+    fail ("pread() into kernel memory succeeded");
+}
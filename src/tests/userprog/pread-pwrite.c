@@ -0,0 +1,33 @@
+/* Writes and reads a file at explicit offsets with pwrite() and
+   pread(), and checks that neither moves the file position. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  size_t size = sizeof sample - 1;
+  char buf[sizeof sample];
+  int handle;
+
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+
+  /* Second half first, then the first. */
+  CHECK (pwrite (handle, sample + size / 2, size - size / 2, size / 2)
+         == (int) (size - size / 2), "pwrite second half");
+  CHECK (pwrite (handle, sample, size / 2, 0) == (int) (size / 2),
+         "pwrite first half");
+  CHECK (tell (handle) == 0, "position still 0");
+
+  memset (buf, 0, sizeof buf);
+  CHECK (pread (handle, buf, size, 0) == (int) size, "pread whole file");
+  compare_bytes (buf, sample, size, 0, "test.txt");
+  CHECK (pread (handle, buf, 10, size) == 0, "pread at end of file");
+  CHECK (tell (handle) == 0, "position still 0");
+  check_file_handle (handle, "test.txt", sample, size);
+}
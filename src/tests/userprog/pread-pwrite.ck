@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pread-pwrite) begin
+(pread-pwrite) create "test.txt"
+(pread-pwrite) open "test.txt"
+(pread-pwrite) pwrite second half
+(pread-pwrite) pwrite first half
+(pread-pwrite) position still 0
+(pread-pwrite) pread whole file
+(pread-pwrite) pread at end of file
+(pread-pwrite) position still 0
+(pread-pwrite) verified contents of "test.txt"
+(pread-pwrite) end
+pread-pwrite: exit(0)
+EOF
+pass;
@@ -0,0 +1,17 @@
+/* Reads a file into the program's own code, which is mapped
+   read-only.  The process must be terminated with -1 exit code,
+   not crash the kernel. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int handle;
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+
+  read (handle, (void *) test_main, 123);
+  fail ("should not have survived read()");
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(read-rdonly) begin
+(read-rdonly) open "sample.txt"
+read-rdonly: exit(-1)
+EOF
+pass;
@@ -0,0 +1,34 @@
+/* Passes readv() and writev() bad buffer lists: too many or a
+   negative number of buffers, a buffer in kernel memory, and
+   the list itself in kernel memory.  Each call must fail with -1
+   or the process must be terminated with exit code -1. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  static char buf[16];
+  struct iovec iov[IOV_MAX + 1];
+  int handle;
+  int i;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  for (i = 0; i <= IOV_MAX; i++)
+    {
+      iov[i].iov_base = buf;
+      iov[i].iov_len = 1;
+    }
+
+  CHECK (readv (handle, iov, IOV_MAX + 1) == -1, "readv IOV_MAX + 1");
+  CHECK (writev (handle, iov, -1) == -1, "writev -1 buffers");
+
+  iov[0].iov_base = (char *) 0xc0100000;
+  CHECK (readv (handle, iov, 1) == -1, "readv into kernel memory");
+  CHECK (writev (handle, iov, 1) == -1, "writev from kernel memory");
+
+  if (readv (handle, (struct iovec *) 0xc0100000, 1) != -1)
+    fail ("readv() of a list in kernel memory succeeded");
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF', <<'EOF']);
+(readv-bad-iov) begin
+(readv-bad-iov) open "sample.txt"
+(readv-bad-iov) readv IOV_MAX + 1
+(readv-bad-iov) writev -1 buffers
+(readv-bad-iov) readv into kernel memory
+(readv-bad-iov) writev from kernel memory
+(readv-bad-iov) end
+readv-bad-iov: exit(0)
+EOF
+(readv-bad-iov) begin
+(readv-bad-iov) open "sample.txt"
+(readv-bad-iov) readv IOV_MAX + 1
+(readv-bad-iov) writev -1 buffers
+(readv-bad-iov) readv into kernel memory
+(readv-bad-iov) writev from kernel memory
+readv-bad-iov: exit(-1)
+EOF
+pass;
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(readv-rdonly) begin
+(readv-rdonly) open "sample.txt"
+readv-rdonly: exit(-1)
+EOF
+pass;
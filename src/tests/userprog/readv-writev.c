@@ -0,0 +1,41 @@
+/* Writes a file from three buffers with writev() and reads it
+   back into two, split in different places, with readv(). */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  size_t size = sizeof sample - 1;
+  char a[sizeof sample], b[sizeof sample];
+  struct iovec iov[3];
+  int handle;
+
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+
+  iov[0].iov_base = sample;
+  iov[0].iov_len = 10;
+  iov[1].iov_base = sample + 10;
+  iov[1].iov_len = 0;
+  iov[2].iov_base = sample + 10;
+  iov[2].iov_len = size - 10;
+  CHECK (writev (handle, iov, 3) == (int) size, "writev 3 buffers");
+  CHECK (tell (handle) == size, "position at end of file");
+
+  seek (handle, 0);
+  memset (a, 0, sizeof a);
+  memset (b, 0, sizeof b);
+  iov[0].iov_base = a;
+  iov[0].iov_len = size / 3;
+  iov[1].iov_base = b;
+  iov[1].iov_len = sizeof b;
+  CHECK (readv (handle, iov, 2) == (int) size, "readv 2 buffers");
+  compare_bytes (a, sample, size / 3, 0, "test.txt");
+  compare_bytes (b, sample + size / 3, size - size / 3, size / 3,
+                 "test.txt");
+}
@@ -0,0 +1,56 @@
+/* Queues system calls that may not be made from a ring, and a
+   number that is no system call at all, between two that may.
+   Each bad one must complete with -1, and the others must still
+   be made. */
+
+#include <io-ring.h>
+#include <syscall.h>
+#include <syscall-nr.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static struct io_ring ring;
+
+/* Queues system call NR with argument A, tagged with its
+   position in the queue. */
+static void
+queue (int nr, int a) 
+{
+  struct io_sqe *sqe = &ring.sq[ring.sq_tail % IO_RING_SIZE];
+
+  sqe->nr = nr;
+  sqe->args[0] = a;
+  sqe->tag = ring.sq_tail;
+  ring.sq_tail++;
+}
+
+void
+test_main (void) 
+{
+  static const char *name = "test.txt";
+  int expected[] = {0, -1, -1, -1, -1, -1, 0};
+  int handle;
+  int i;
+
+  CHECK (create (name, 0), "create \"%s\"", name);
+  CHECK ((handle = open (name)) > 1, "open \"%s\"", name);
+  CHECK (ring_setup (&ring), "ring_setup");
+
+  queue (SYS_TELL, handle);
+  queue (SYS_OPEN, (int) name);
+  queue (SYS_CLOSE, handle);
+  queue (SYS_EXIT, 57);
+  queue (-1, 0);
+  queue (1000, 0);
+  queue (SYS_FILESIZE, handle);
+  CHECK (ring_enter () == 7, "ring_enter makes 7 calls");
+
+  for (i = 0; i < 7; i++)
+    {
+      struct io_cqe *cqe = &ring.cq[i];
+      if (cqe->tag != (unsigned) i || cqe->result != expected[i])
+        fail ("call %d has tag %u and result %d", i, cqe->tag, cqe->result);
+    }
+  msg ("bad calls returned -1");
+  CHECK (tell (handle) == 0, "\"%s\" still open", name);
+}
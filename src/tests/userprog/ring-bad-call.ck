@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(ring-bad-call) begin
+(ring-bad-call) create "test.txt"
+(ring-bad-call) open "test.txt"
+(ring-bad-call) ring_setup
+(ring-bad-call) ring_enter makes 7 calls
+(ring-bad-call) bad calls returned -1
+(ring-bad-call) "test.txt" still open
+(ring-bad-call) end
+ring-bad-call: exit(0)
+EOF
+pass;
@@ -0,0 +1,23 @@
+/* Calls ring_enter() with no ring, registers rings in kernel
+   memory, which must fail, and then one at an unmapped user
+   address.  The process must be terminated with -1 exit code
+   at the latest then. */
+
+#include <io-ring.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  CHECK (ring_enter () == -1, "ring_enter with no ring");
+  CHECK (!ring_setup ((struct io_ring *) 0xc0100000),
+         "ring_setup in kernel memory");
+  CHECK (!ring_setup ((struct io_ring *) (0xc0000000 - 16)),
+         "ring_setup across kernel memory");
+  CHECK (ring_enter () == -1, "ring_enter with no ring");
+
+  ring_setup ((struct io_ring *) 0x20101234);
+  fail ("should have exited with -1");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(ring-bad-ptr) begin
+(ring-bad-ptr) ring_enter with no ring
+(ring-bad-ptr) ring_setup in kernel memory
+(ring-bad-ptr) ring_setup across kernel memory
+(ring-bad-ptr) ring_enter with no ring
+ring-bad-ptr: exit(-1)
+EOF
+pass;
@@ -0,0 +1,64 @@
+/* Fills a system call ring's completion queue and checks that
+   ring_enter() stops making calls until completions are
+   consumed, then makes the rest in order. */
+
+#include <io-ring.h>
+#include <syscall.h>
+#include <syscall-nr.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static struct io_ring ring;
+
+/* Queues CNT tell() calls of HANDLE, tagged in order from the
+   number of calls queued so far. */
+static void
+queue_tells (int handle, int cnt) 
+{
+  for (; cnt > 0; cnt--)
+    {
+      struct io_sqe *sqe = &ring.sq[ring.sq_tail % IO_RING_SIZE];
+      sqe->nr = SYS_TELL;
+      sqe->args[0] = handle;
+      sqe->tag = ring.sq_tail;
+      ring.sq_tail++;
+    }
+}
+
+/* Consumes CNT completions, which must be in tag order. */
+static void
+consume (int cnt) 
+{
+  for (; cnt > 0; cnt--)
+    {
+      struct io_cqe *cqe = &ring.cq[ring.cq_head % IO_RING_SIZE];
+      if (cqe->tag != ring.cq_head || cqe->result != 0)
+        fail ("completion %u has tag %u and result %d",
+              ring.cq_head, cqe->tag, cqe->result);
+      ring.cq_head++;
+    }
+}
+
+void
+test_main (void) 
+{
+  int handle;
+
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+  CHECK (ring_setup (&ring), "ring_setup");
+
+  queue_tells (handle, IO_RING_SIZE);
+  CHECK (ring_enter () == IO_RING_SIZE, "ring_enter fills completions");
+  queue_tells (handle, 5);
+  CHECK (ring_enter () == 0, "ring_enter with completions full");
+  CHECK (ring.sq_head == IO_RING_SIZE, "submissions left queued");
+
+  consume (3);
+  CHECK (ring_enter () == 3, "ring_enter after consuming 3");
+  consume (IO_RING_SIZE);
+  CHECK (ring_enter () == 2, "ring_enter makes the last 2");
+  consume (2);
+  CHECK (ring.sq_head == ring.sq_tail && ring.cq_tail == ring.cq_head,
+         "queues empty");
+}
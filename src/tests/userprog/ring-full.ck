@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(ring-full) begin
+(ring-full) create "test.txt"
+(ring-full) open "test.txt"
+(ring-full) ring_setup
+(ring-full) ring_enter fills completions
+(ring-full) ring_enter with completions full
+(ring-full) submissions left queued
+(ring-full) ring_enter after consuming 3
+(ring-full) ring_enter makes the last 2
+(ring-full) queues empty
+(ring-full) end
+ring-full: exit(0)
+EOF
+pass;
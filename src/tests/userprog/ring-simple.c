@@ -0,0 +1,63 @@
+/* Queues a write, a seek, a read and a tell of one file on a
+   system call ring and makes them with one ring_enter(), then
+   checks each completion and the data read back. */
+
+#include <io-ring.h>
+#include <string.h>
+#include <syscall.h>
+#include <syscall-nr.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static struct io_ring ring;
+static char buf[sizeof sample];
+
+/* Queues system call NR with arguments A, B and C, tagged TAG. */
+static void
+queue (int nr, int a, int b, int c, unsigned tag) 
+{
+  struct io_sqe *sqe = &ring.sq[ring.sq_tail % IO_RING_SIZE];
+
+  sqe->nr = nr;
+  sqe->args[0] = a;
+  sqe->args[1] = b;
+  sqe->args[2] = c;
+  sqe->tag = tag;
+  ring.sq_tail++;
+}
+
+void
+test_main (void) 
+{
+  int size = sizeof sample - 1;
+  int expected[] = {size, 0, size, size};
+  int handle;
+  int i;
+
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+  CHECK (ring_setup (&ring), "ring_setup");
+
+  queue (SYS_WRITE, handle, (int) sample, size, 100);
+  queue (SYS_SEEK, handle, 0, 0, 101);
+  queue (SYS_READ, handle, (int) buf, size, 102);
+  queue (SYS_TELL, handle, 0, 0, 103);
+  CHECK (ring_enter () == 4, "ring_enter makes 4 calls");
+  CHECK (ring.sq_head == 4 && ring.cq_tail == 4, "queues advanced");
+
+  for (i = 0; i < 4; i++)
+    {
+      struct io_cqe *cqe = &ring.cq[ring.cq_head++ % IO_RING_SIZE];
+      if (cqe->tag != 100u + i)
+        fail ("completion %d has tag %u", i, cqe->tag);
+      if (cqe->result != expected[i])
+        fail ("call %u returned %d", cqe->tag, cqe->result);
+    }
+  msg ("completions in order");
+  compare_bytes (buf, sample, size, 0, "test.txt");
+
+  CHECK (ring_enter () == 0, "ring_enter with nothing queued");
+  seek (handle, 0);
+  check_file_handle (handle, "test.txt", sample, size);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(ring-simple) begin
+(ring-simple) create "test.txt"
+(ring-simple) open "test.txt"
+(ring-simple) ring_setup
+(ring-simple) ring_enter makes 4 calls
+(ring-simple) queues advanced
+(ring-simple) completions in order
+(ring-simple) ring_enter with nothing queued
+(ring-simple) verified contents of "test.txt"
+(ring-simple) end
+ring-simple: exit(0)
+EOF
+pass;
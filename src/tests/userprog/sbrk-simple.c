@@ -0,0 +1,35 @@
+/* Grows the heap with sbrk(), checks that the new memory is
+   zeroed and usable, and shrinks it again.  Moving the end of
+   the heap below its start or far past the top of user memory
+   must fail. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (2 * 4096 + 100)
+
+void
+test_main (void) 
+{
+  char *base, *p;
+  size_t i;
+
+  base = sbrk (0);
+  CHECK (base != (void *) -1, "sbrk (0)");
+  CHECK (sbrk (SIZE) == base, "sbrk (SIZE)");
+  CHECK (sbrk (0) == base + SIZE, "end of heap moved up");
+
+  for (i = 0; i < SIZE; i++)
+    if (base[i] != 0)
+      fail ("byte %zu of new heap is %d, not 0", i, base[i]);
+  for (p = base; p < base + SIZE; p++)
+    *p = 'x';
+  msg ("new heap is zeroed and writable");
+
+  CHECK (sbrk (-SIZE) == base + SIZE, "sbrk (-SIZE)");
+  CHECK (sbrk (0) == base, "end of heap moved down");
+  CHECK (sbrk (-1) == (void *) -1, "sbrk below start of heap fails");
+  CHECK (sbrk (0x7fffffff) == (void *) -1, "sbrk too far fails");
+}
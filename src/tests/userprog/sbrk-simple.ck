@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sbrk-simple) begin
+(sbrk-simple) sbrk (0)
+(sbrk-simple) sbrk (SIZE)
+(sbrk-simple) end of heap moved up
+(sbrk-simple) new heap is zeroed and writable
+(sbrk-simple) sbrk (-SIZE)
+(sbrk-simple) end of heap moved down
+(sbrk-simple) sbrk below start of heap fails
+(sbrk-simple) sbrk too far fails
+(sbrk-simple) end
+sbrk-simple: exit(0)
+EOF
+pass;
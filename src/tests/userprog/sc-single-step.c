@@ -0,0 +1,41 @@
+/* Sets the trap flag so that the instruction that enters the
+   kernel for a system call is single-stepped: SYSENTER if the
+   kernel lets user programs use it, "int $0x30" otherwise.  The
+   call must be made, and the single-step trap must then arrive
+   in user mode, terminating the process with -1 exit code
+   rather than crashing the kernel. */
+
+#include <syscall-nr.h>
+#include <vdata.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static const char line[] = "(sc-single-step) written while single-stepping\n";
+
+void
+test_main (void) 
+{
+  if (*(volatile uint32_t *) VDATA_SYSENTER_ADDR)
+    asm volatile ("pushl %[len]; pushl %[buf]; pushl $1; pushl %[nr]\n\t"
+                  "movl $1f, %%edx\n\t"
+                  "movl %%esp, %%ecx\n\t"
+                  "pushfl\n\t"
+                  "orl $0x100, (%%esp)\n\t"
+                  "popfl\n\t"
+                  "sysenter\n"
+                  "1:\taddl $16, %%esp"
+                  : : [len] "i" (sizeof line - 1), [buf] "r" (line),
+                      [nr] "i" (SYS_WRITE)
+                  : "eax", "ecx", "edx", "memory", "cc");
+  else
+    asm volatile ("pushl %[len]; pushl %[buf]; pushl $1; pushl %[nr]\n\t"
+                  "pushfl\n\t"
+                  "orl $0x100, (%%esp)\n\t"
+                  "popfl\n\t"
+                  "int $0x30\n\t"
+                  "addl $16, %%esp"
+                  : : [len] "i" (sizeof line - 1), [buf] "r" (line),
+                      [nr] "i" (SYS_WRITE)
+                  : "eax", "memory", "cc");
+  fail ("should have exited with -1");
+}
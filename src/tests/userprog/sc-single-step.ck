@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_USER_FAULTS => 1, [<<'EOF']);
+(sc-single-step) begin
+(sc-single-step) written while single-stepping
+sc-single-step: exit(-1)
+EOF
+pass;
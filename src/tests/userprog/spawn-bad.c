@@ -0,0 +1,38 @@
+/* Passes spawn() bad file actions: one on a descriptor that is
+   not open, an unknown operation, a target descriptor out of
+   range, and too many actions.  Each must make spawn() fail
+   without starting the child.  Then passes actions in kernel
+   memory, for which the process must be terminated with -1 exit
+   code. */
+
+#include <spawn.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  struct spawn_action a;
+  int handle;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+
+  a.op = SPAWN_CLOSE;
+  a.fd = 5678;
+  CHECK (spawn ("child-spawn x", &a, 1, NULL) == PID_ERROR,
+         "spawn closing a bad fd fails");
+  a.op = 99;
+  a.fd = handle;
+  CHECK (spawn ("child-spawn x", &a, 1, NULL) == PID_ERROR,
+         "spawn with unknown action fails");
+  a.op = SPAWN_DUP;
+  a.to = SPAWN_FD_MAX;
+  CHECK (spawn ("child-spawn x", &a, 1, NULL) == PID_ERROR,
+         "spawn dup to SPAWN_FD_MAX fails");
+  CHECK (spawn ("child-spawn x", &a, SPAWN_ACTIONS_MAX + 1, NULL)
+         == PID_ERROR, "spawn with too many actions fails");
+
+  spawn ("child-spawn x", (struct spawn_action *) 0xc0100000, 1, NULL);
+  fail ("should not have survived spawn()");
+}
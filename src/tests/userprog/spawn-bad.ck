@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(spawn-bad) begin
+(spawn-bad) open "sample.txt"
+(spawn-bad) spawn closing a bad fd fails
+(spawn-bad) spawn with unknown action fails
+(spawn-bad) spawn dup to SPAWN_FD_MAX fails
+(spawn-bad) spawn with too many actions fails
+spawn-bad: exit(-1)
+EOF
+pass;
@@ -0,0 +1,43 @@
+/* Spawns child-spawn with its standard output moved onto the
+   write end of a pipe and reads what it writes from the other
+   end, until the end of the stream once the child exits. */
+
+#include <spawn.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  static const char expected[] = "one\ntwo\nthree\n";
+  struct spawn_action actions[3];
+  char buf[64];
+  int fds[2];
+  pid_t pid;
+  int n, ofs;
+
+  CHECK (pipe (fds), "pipe");
+  actions[0].op = SPAWN_DUP;
+  actions[0].fd = fds[1];
+  actions[0].to = STDOUT_FILENO;
+  actions[1].op = SPAWN_CLOSE;
+  actions[1].fd = fds[0];
+  actions[2].op = SPAWN_CLOSE;
+  actions[2].fd = fds[1];
+  pid = spawn ("child-spawn one two three", actions, 3, NULL);
+  if (pid == PID_ERROR)
+    fail ("spawn() failed");
+  close (fds[1]);
+
+  for (ofs = 0; (n = read (fds[0], buf + ofs, sizeof buf - ofs)) > 0; )
+    ofs += n;
+  if (n < 0)
+    fail ("read from pipe failed");
+  if (ofs != sizeof expected - 1)
+    fail ("read %d bytes from pipe, not %zu", ofs, sizeof expected - 1);
+  compare_bytes (buf, expected, ofs, 0, "pipe");
+  msg ("read child's output from pipe");
+  msg ("wait(spawn()) = %d", wait (pid));
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(spawn-pipe) begin
+(spawn-pipe) pipe
+child-spawn: exit(0)
+(spawn-pipe) read child's output from pipe
+(spawn-pipe) wait(spawn()) = 0
+(spawn-pipe) end
+spawn-pipe: exit(0)
+EOF
+pass;
@@ -0,0 +1,33 @@
+/* Spawns child-spawn with its standard output moved onto a file,
+   and checks that what it wrote went into the file and not to the
+   console. */
+
+#include <spawn.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  static const char expected[] = "hello\nworld\n";
+  struct spawn_action actions[2];
+  int handle;
+
+  CHECK (create ("out.txt", 0), "create \"out.txt\"");
+  CHECK ((handle = open ("out.txt")) > 1, "open \"out.txt\"");
+
+  actions[0].op = SPAWN_DUP;
+  actions[0].fd = handle;
+  actions[0].to = STDOUT_FILENO;
+  actions[1].op = SPAWN_CLOSE;
+  actions[1].fd = handle;
+  msg ("wait(spawn()) = %d",
+       wait (spawn ("child-spawn hello world", actions, 2, NULL)));
+
+  CHECK (filesize (handle) == sizeof expected - 1, "file size is %zu",
+         sizeof expected - 1);
+  close (handle);
+  check_file ("out.txt", expected, sizeof expected - 1);
+}
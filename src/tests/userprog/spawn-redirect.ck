@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(spawn-redirect) begin
+(spawn-redirect) create "out.txt"
+(spawn-redirect) open "out.txt"
+child-spawn: exit(0)
+(spawn-redirect) wait(spawn()) = 0
+(spawn-redirect) file size is 12
+(spawn-redirect) open "out.txt" for verification
+(spawn-redirect) verified contents of "out.txt"
+(spawn-redirect) close "out.txt"
+(spawn-redirect) end
+spawn-redirect: exit(0)
+EOF
+pass;
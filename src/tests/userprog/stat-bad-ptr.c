@@ -0,0 +1,15 @@
+/* Passes stat() a path in kernel memory.
+   The process must be terminated with -1 exit code. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  struct stat st;
+
+  stat ((char *) 0xc0100000, &st);
+  fail ("should not have survived stat()");
+}
@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(stat-bad-ptr) begin
+stat-bad-ptr: exit(-1)
+EOF
+pass;
@@ -0,0 +1,14 @@
+/* Asks stat() to store its result in the program's own code,
+   which is mapped read-only.  The kernel's write faults, and the
+   process must be terminated with -1 exit code. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  stat ("sample.txt", (struct stat *) test_main);
+  fail ("should not have survived stat()");
+}
@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(stat-rdonly) begin
+stat-rdonly: exit(-1)
+EOF
+pass;
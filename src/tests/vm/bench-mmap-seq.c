@@ -0,0 +1,39 @@
+/* Maps a file of the size given as the argument, in kB, writes
+   it through the mapping, reads it back, and unmaps it, which
+   writes the dirty pages back to the file. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/vm/vm-bench.h"
+
+const char *test_name = "bench-mmap-seq";
+
+#define ACTUAL ((void *) 0x10000000)
+
+int
+main (int argc, char *argv[]) 
+{
+  size_t size = vm_bench_size (argc, argv);
+  char *actual = ACTUAL;
+  struct vm_bench b;
+  mapid_t map;
+  size_t i;
+  int fd;
+
+  CHECK (create ("mapped", size), "create \"mapped\"");
+  CHECK ((fd = open ("mapped")) > 1, "open \"mapped\"");
+
+  vm_bench_start (&b);
+  if ((map = mmap (fd, ACTUAL)) == MAP_FAILED)
+    fail ("mmap \"mapped\" failed");
+  for (i = 0; i < size; i++)
+    actual[i] = i;
+  for (i = 0; i < size; i++)
+    if (actual[i] != (char) i)
+      fail ("byte %zu is wrong", i);
+  munmap (map);
+  vm_bench_end (&b);
+
+  close (fd);
+  return 0;
+}
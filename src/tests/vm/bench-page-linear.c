@@ -0,0 +1,37 @@
+/* Writes every byte of a working set of the size given as the
+   argument, in kB, then reads and rewrites it PASS_CNT more
+   times from start to end.  Once the working set is larger than
+   physical memory, each pass evicts the pages it is about to
+   need. */
+
+#include <stdlib.h>
+#include "tests/lib.h"
+#include "tests/vm/vm-bench.h"
+
+const char *test_name = "bench-page-linear";
+
+#define PASS_CNT 3
+
+static char buf[VM_BENCH_MAX];
+
+int
+main (int argc, char *argv[]) 
+{
+  size_t size = vm_bench_size (argc, argv);
+  struct vm_bench b;
+  size_t i;
+  int pass;
+
+  vm_bench_start (&b);
+  for (i = 0; i < size; i++)
+    buf[i] = i;
+  for (pass = 0; pass < PASS_CNT; pass++)
+    for (i = 0; i < size; i++)
+      {
+        if (buf[i] != (char) (i + pass))
+          fail ("byte %zu is wrong in pass %d", i, pass);
+        buf[i]++;
+      }
+  vm_bench_end (&b);
+  return 0;
+}
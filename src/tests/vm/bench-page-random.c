@@ -0,0 +1,32 @@
+/* Dirties the pages of a working set of the size given as the
+   argument, in kB, in random order, TOUCH_CNT times over.
+   Random access defeats any prefetch and makes the eviction
+   policy's choices count. */
+
+#include <random.h>
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/vm/vm-bench.h"
+
+const char *test_name = "bench-page-random";
+
+#define PAGE_SIZE 4096
+#define TOUCH_CNT 4
+
+static uint32_t buf[VM_BENCH_MAX / sizeof (uint32_t)];
+
+int
+main (int argc, char *argv[]) 
+{
+  size_t page_cnt = vm_bench_size (argc, argv) / PAGE_SIZE;
+  size_t per_page = PAGE_SIZE / sizeof *buf;
+  struct vm_bench b;
+  size_t i;
+
+  random_init (0);
+  vm_bench_start (&b);
+  for (i = 0; i < page_cnt * TOUCH_CNT; i++)
+    buf[random_ulong () % page_cnt * per_page]++;
+  vm_bench_end (&b);
+  return 0;
+}
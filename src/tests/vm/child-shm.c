@@ -0,0 +1,24 @@
+/* Child process for shm-exec test.
+   Maps the segment its parent filled with 'p', at a different
+   address, checks it and fills it with 'c'. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/shm.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char *seg = (char *) 0x20000000;
+  size_t i;
+
+  CHECK (shm_map ("segment", SHM_SIZE, seg) != MAP_FAILED,
+         "shm_map \"segment\"");
+  for (i = 0; i < SHM_SIZE; i++)
+    if (seg[i] != 'p')
+      fail ("byte %zu is %d, not 'p'", i, seg[i]);
+  msg ("child sees parent's writes");
+  memset (seg, 'c', SHM_SIZE);
+}
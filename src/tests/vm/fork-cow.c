@@ -0,0 +1,43 @@
+/* Forks a child that overwrites a buffer it shares with its
+   parent copy-on-write.  The child must see its own writes and
+   the parent must still see the old contents. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (3 * 4096 + 100)
+
+static char buf[SIZE];
+
+static void
+check_buf (char c, const char *who)
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != c)
+      fail ("%s: byte %zu is %d, not %d", who, i, buf[i], c);
+  msg ("%s sees '%c'", who, c);
+}
+
+void
+test_main (void)
+{
+  pid_t pid;
+
+  memset (buf, 'p', SIZE);
+  pid = fork ();
+  if (pid == 0)
+    {
+      check_buf ('p', "child");
+      memset (buf, 'c', SIZE);
+      check_buf ('c', "child");
+      exit (0);
+    }
+  if (pid == PID_ERROR)
+    fail ("fork() failed");
+  msg ("wait(fork()) = %d", wait (pid));
+  check_buf ('p', "parent");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fork-cow) begin
+(fork-cow) child sees 'p'
+(fork-cow) child sees 'c'
+fork-cow: exit(0)
+(fork-cow) wait(fork()) = 0
+(fork-cow) parent sees 'p'
+(fork-cow) end
+fork-cow: exit(0)
+EOF
+pass;
@@ -0,0 +1,34 @@
+/* Forks a child that reads a file its parent opened before the
+   fork, then closes it.  The parent's descriptor must still
+   work. */
+
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  int handle;
+  pid_t pid;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  pid = fork ();
+  if (pid == 0)
+    {
+      char buf[sizeof sample];
+
+      if (pread (handle, buf, sizeof sample - 1, 0)
+          != (int) sizeof sample - 1)
+        fail ("child: pread failed");
+      compare_bytes (buf, sample, sizeof sample - 1, 0, "sample.txt");
+      msg ("child read \"sample.txt\"");
+      close (handle);
+      exit (0);
+    }
+  if (pid == PID_ERROR)
+    fail ("fork() failed");
+  msg ("wait(fork()) = %d", wait (pid));
+  check_file_handle (handle, "sample.txt", sample, sizeof sample - 1);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fork-fd) begin
+(fork-fd) open "sample.txt"
+(fork-fd) child read "sample.txt"
+fork-fd: exit(0)
+(fork-fd) wait(fork()) = 0
+(fork-fd) verified contents of "sample.txt"
+(fork-fd) end
+fork-fd: exit(0)
+EOF
+pass;
@@ -0,0 +1,34 @@
+/* Forks a child that exits with code 42 and one that is killed
+   for writing to a bad address.  wait() must return each child's
+   exit code, and only once. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  pid_t pid;
+
+  pid = fork ();
+  if (pid == 0)
+    {
+      msg ("child run");
+      exit (42);
+    }
+  if (pid == PID_ERROR)
+    fail ("fork() failed");
+  msg ("wait(fork()) = %d", wait (pid));
+
+  pid = fork ();
+  if (pid == 0)
+    {
+      *(volatile int *) NULL = 42;
+      fail ("child should have died");
+    }
+  if (pid == PID_ERROR)
+    fail ("fork() failed");
+  msg ("wait(fork()) = %d", wait (pid));
+  msg ("wait() again = %d", wait (pid));
+}
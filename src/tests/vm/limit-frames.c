@@ -0,0 +1,24 @@
+/* Runs child-linear, which works through 1 MB of memory, under
+   a limit of FRAME_LIMIT frames.  It must still succeed, by
+   evicting its own pages, and must never have had more than
+   FRAME_LIMIT pages in frames at once. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FRAME_LIMIT 64
+
+void
+test_main (void)
+{
+  struct proc_stats stats;
+  pid_t pid;
+
+  CHECK (set_limit (LIMIT_FRAMES, FRAME_LIMIT),
+         "set_limit (LIMIT_FRAMES, %d)", FRAME_LIMIT);
+  CHECK ((pid = exec ("child-linear")) != -1, "exec \"child-linear\"");
+  CHECK (wait_stats (pid, &stats) == 0x42, "wait for child");
+  CHECK (stats.max_resident <= FRAME_LIMIT,
+         "child stayed within %d frames", FRAME_LIMIT);
+}
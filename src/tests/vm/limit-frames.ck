@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(limit-frames) begin
+(limit-frames) set_limit (LIMIT_FRAMES, 64)
+(limit-frames) exec "child-linear"
+(limit-frames) wait for child
+(limit-frames) child stayed within 64 frames
+(limit-frames) end
+EOF
+pass;
@@ -0,0 +1,29 @@
+/* Passes shm_map() bad arguments: a null or misaligned address,
+   an address that is already mapped, a size of 0, an empty name,
+   and a size larger than the existing segment.  Each must fail
+   with MAP_FAILED. */
+
+#include <stdint.h>
+#include <round.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  uintptr_t test_main_page = ROUND_DOWN ((uintptr_t) test_main, 4096);
+  char *seg = (char *) 0x10000000;
+
+  CHECK (shm_map ("seg", 4096, NULL) == MAP_FAILED, "null address");
+  CHECK (shm_map ("seg", 4096, seg + 1) == MAP_FAILED,
+         "misaligned address");
+  CHECK (shm_map ("seg", 0, seg) == MAP_FAILED, "size 0");
+  CHECK (shm_map ("", 4096, seg) == MAP_FAILED, "empty name");
+  CHECK (shm_map ("seg", 4096, (void *) test_main_page) == MAP_FAILED,
+         "over code");
+
+  CHECK (shm_map ("seg", 4096, seg) != MAP_FAILED, "shm_map \"seg\"");
+  CHECK (shm_map ("seg", 2 * 4096, seg + 4096) == MAP_FAILED,
+         "larger than the segment");
+}
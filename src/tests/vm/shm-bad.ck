@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(shm-bad) begin
+(shm-bad) null address
+(shm-bad) misaligned address
+(shm-bad) size 0
+(shm-bad) empty name
+(shm-bad) over code
+(shm-bad) shm_map "seg"
+(shm-bad) larger than the segment
+(shm-bad) end
+shm-bad: exit(0)
+EOF
+pass;
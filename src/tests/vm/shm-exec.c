@@ -0,0 +1,30 @@
+/* Maps a named shared memory segment, fills it, and runs
+   child-shm, which maps the same segment at another address,
+   checks the contents and overwrites them.  The parent must see
+   the child's writes. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/shm.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char *seg = (char *) 0x10000000;
+  pid_t child;
+  size_t i;
+
+  CHECK (shm_map ("segment", SHM_SIZE, seg) != MAP_FAILED,
+         "shm_map \"segment\"");
+  memset (seg, 'p', SHM_SIZE);
+
+  CHECK ((child = exec ("child-shm")) != -1, "exec \"child-shm\"");
+  CHECK (wait (child) == 0, "wait for child");
+
+  for (i = 0; i < SHM_SIZE; i++)
+    if (seg[i] != 'c')
+      fail ("byte %zu is %d, not 'c'", i, seg[i]);
+  msg ("parent sees child's writes");
+}
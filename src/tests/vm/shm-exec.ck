@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(shm-exec) begin
+(shm-exec) shm_map "segment"
+(shm-exec) exec "child-shm"
+(child-shm) begin
+(child-shm) shm_map "segment"
+(child-shm) child sees parent's writes
+(child-shm) end
+child-shm: exit(0)
+(shm-exec) wait for child
+(shm-exec) parent sees child's writes
+(shm-exec) end
+shm-exec: exit(0)
+EOF
+pass;
@@ -0,0 +1,31 @@
+/* Maps an anonymous shared memory segment and forks.  The child
+   writes to the segment, and the parent must see its writes
+   after waiting for it. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char *seg = (char *) 0x10000000;
+  pid_t pid;
+
+  CHECK (shm_map (NULL, 4096, seg) != MAP_FAILED, "shm_map anonymous");
+  seg[0] = 'p';
+
+  pid = fork ();
+  if (pid == 0)
+    {
+      if (seg[0] != 'p')
+        fail ("child sees %d, not 'p'", seg[0]);
+      seg[0] = 'c';
+      exit (0);
+    }
+  if (pid == PID_ERROR)
+    fail ("fork() failed");
+  CHECK (wait (pid) == 0, "wait for child");
+  CHECK (seg[0] == 'c', "parent sees child's write");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(shm-fork) begin
+(shm-fork) shm_map anonymous
+shm-fork: exit(0)
+(shm-fork) wait for child
+(shm-fork) parent sees child's write
+(shm-fork) end
+shm-fork: exit(0)
+EOF
+pass;
@@ -0,0 +1,8 @@
+#ifndef TESTS_VM_SHM_H
+#define TESTS_VM_SHM_H
+
+/* Size of the segment shared by shm-exec and child-shm, which
+   ends partway into its third page. */
+#define SHM_SIZE (2 * 4096 + 123)
+
+#endif /* tests/vm/shm.h */
@@ -0,0 +1,13 @@
+/* Passes snapshot() a name in kernel memory.
+   The process must be terminated with -1 exit code. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  snapshot ((char *) 0xc0100000);
+  fail ("should not have survived snapshot()");
+}
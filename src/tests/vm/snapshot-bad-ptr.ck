@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(snapshot-bad-ptr) begin
+snapshot-bad-ptr: exit(-1)
+EOF
+pass;
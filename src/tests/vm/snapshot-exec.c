@@ -0,0 +1,38 @@
+/* Saves the process as a snapshot and starts two processes from
+   it.  Each must resume from snapshot() with the memory the
+   process had then, not what it changed afterward, and wait()
+   must return each one's exit code.  Once the snapshot is
+   dropped, no more can be started from it. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int counter;
+
+void
+test_main (void)
+{
+  int r;
+
+  counter = 5;
+  r = snapshot ("warm");
+  if (r == 1)
+    {
+      msg ("started from snapshot, counter = %d", counter);
+      exit (++counter);
+    }
+  CHECK (r == 0, "snapshot \"warm\"");
+
+  counter = 100;
+  msg ("wait(exec_snapshot()) = %d", wait (exec_snapshot ("warm")));
+  msg ("wait(exec_snapshot()) = %d", wait (exec_snapshot ("warm")));
+
+  CHECK (snapshot_drop ("warm"), "snapshot_drop \"warm\"");
+  CHECK (exec_snapshot ("warm") == PID_ERROR,
+         "exec_snapshot after drop fails");
+  CHECK (!snapshot_drop ("warm"), "snapshot_drop again fails");
+  CHECK (snapshot ("") == -1, "snapshot with empty name fails");
+  CHECK (exec_snapshot ("cold") == PID_ERROR,
+         "exec_snapshot of unknown name fails");
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(snapshot-exec) begin
+(snapshot-exec) snapshot "warm"
+(snapshot-exec) started from snapshot, counter = 5
+snapshot-exec: exit(6)
+(snapshot-exec) wait(exec_snapshot()) = 6
+(snapshot-exec) started from snapshot, counter = 5
+snapshot-exec: exit(6)
+(snapshot-exec) wait(exec_snapshot()) = 6
+(snapshot-exec) snapshot_drop "warm"
+(snapshot-exec) exec_snapshot after drop fails
+(snapshot-exec) snapshot_drop again fails
+(snapshot-exec) snapshot with empty name fails
+(snapshot-exec) exec_snapshot of unknown name fails
+(snapshot-exec) end
+snapshot-exec: exit(0)
+EOF
+pass;
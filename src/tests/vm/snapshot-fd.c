@@ -0,0 +1,28 @@
+/* Opens a file and saves the process as a snapshot, then closes
+   the file.  A process started from the snapshot must still have
+   the file open, at the same descriptor. */
+
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  int handle;
+  int r;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  r = snapshot ("with-file");
+  if (r == 1)
+    {
+      check_file_handle (handle, "sample.txt", sample, sizeof sample - 1);
+      exit (0);
+    }
+  CHECK (r == 0, "snapshot \"with-file\"");
+  close (handle);
+
+  msg ("wait(exec_snapshot()) = %d", wait (exec_snapshot ("with-file")));
+  CHECK (snapshot_drop ("with-file"), "snapshot_drop \"with-file\"");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(snapshot-fd) begin
+(snapshot-fd) open "sample.txt"
+(snapshot-fd) snapshot "with-file"
+(snapshot-fd) verified contents of "sample.txt"
+snapshot-fd: exit(0)
+(snapshot-fd) wait(exec_snapshot()) = 0
+(snapshot-fd) snapshot_drop "with-file"
+(snapshot-fd) end
+snapshot-fd: exit(0)
+EOF
+pass;
@@ -0,0 +1,53 @@
+#include "tests/vm/vm-bench.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include "tests/lib.h"
+
+/* Returns the working set size given as the benchmark's first
+   argument, in kB, converted to bytes. */
+size_t
+vm_bench_size (int argc, char *argv[]) 
+{
+  size_t size;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  size = (size_t) atoi (argv[1]) * 1024;
+  if (size == 0 || size > VM_BENCH_MAX)
+    fail ("working set of %s kB out of range", argv[1]);
+  bench_result ("working_set_kb", "%zu", size / 1024);
+  return size;
+}
+
+/* Starts timing the benchmark in B. */
+void
+vm_bench_start (struct vm_bench *b) 
+{
+  vmstats (&b->start);
+  bench_timer_start (&b->timer);
+}
+
+/* Ends the run started in B and reports how long it took and
+   what paging it did, in total and per second. */
+void
+vm_bench_end (struct vm_bench *b) 
+{
+  struct vm_stats s;
+  uint64_t ns, faults, evicts;
+
+  ns = bench_timer_stop (&b->timer);
+  vmstats (&s);
+
+  faults = s.fault_cnt - b->start.fault_cnt;
+  evicts = s.evict_cnt - b->start.evict_cnt;
+  bench_result ("time_ms", "%"PRIu64, ns / 1000000);
+  bench_result ("faults", "%"PRIu64, faults);
+  bench_result ("faults_s", "%"PRIu64, faults * 1000000000 / ns);
+  bench_result ("evictions", "%"PRIu64, evicts);
+  bench_result ("evictions_s", "%"PRIu64, evicts * 1000000000 / ns);
+  bench_result ("swap_reads", "%"PRIu64,
+                s.swap_read_cnt - b->start.swap_read_cnt);
+  bench_result ("swap_writes", "%"PRIu64,
+                s.swap_write_cnt - b->start.swap_write_cnt);
+  bench_result ("fault_around", "%"PRIu64,
+                s.around_cnt - b->start.around_cnt);
+}
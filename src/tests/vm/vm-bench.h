@@ -0,0 +1,23 @@
+#ifndef TESTS_VM_VM_BENCH_H
+#define TESTS_VM_VM_BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/bench.h"
+
+/* Largest working set the VM benchmarks support, in bytes. */
+#define VM_BENCH_MAX (3 * 1024 * 1024)
+
+/* One timed run of a VM benchmark. */
+struct vm_bench
+  {
+    struct bench_timer timer;   /* Times the run. */
+    struct vm_stats start;      /* Paging statistics at the start. */
+  };
+
+size_t vm_bench_size (int argc, char *argv[]);
+void vm_bench_start (struct vm_bench *);
+void vm_bench_end (struct vm_bench *);
+
+#endif /* tests/vm/vm-bench.h */
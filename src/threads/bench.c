@@ -0,0 +1,267 @@
+#include "threads/bench.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <hash.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#ifdef FILESYS
+#include "devices/block.h"
+#include "filesys/cache.h"
+#include "filesys/filesys.h"
+#endif
+
+/* A microbenchmark.  RUN performs CNT operations, which
+   bench_run() times as a whole. */
+struct bench
+  {
+    const char *name;           /* Name, for "bench NAME". */
+    int cnt;                    /* Number of operations to time. */
+    void (*run) (int cnt);      /* Performs CNT operations. */
+  };
+
+/* malloc() followed by free() of a small block. */
+static void
+bench_malloc (int cnt)
+{
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    free (malloc (64));
+}
+
+/* palloc_get_page() followed by palloc_free_page(). */
+static void
+bench_palloc (int cnt)
+{
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    palloc_free_page (palloc_get_page (PAL_ASSERT));
+}
+
+/* lock_acquire() followed by lock_release() of a lock that no
+   other thread wants. */
+static void
+bench_lock (int cnt)
+{
+  struct lock lock;
+  int i;
+
+  lock_init (&lock);
+  for (i = 0; i < cnt; i++)
+    {
+      lock_acquire (&lock);
+      lock_release (&lock);
+    }
+}
+
+/* State shared by the two threads of bench_lock_contended(). */
+struct contended
+  {
+    struct lock lock;           /* The lock they fight over. */
+    int cnt;                    /* Acquisitions per thread. */
+    struct semaphore done;      /* Upped when the helper is done. */
+  };
+
+/* Acquires C->lock C->cnt times, yielding the CPU while holding
+   it, so that the other thread finds it held. */
+static void
+contend (struct contended *c)
+{
+  int i;
+
+  for (i = 0; i < c->cnt; i++)
+    {
+      lock_acquire (&c->lock);
+      thread_yield ();
+      lock_release (&c->lock);
+    }
+}
+
+static void
+contend_thread (void *c_)
+{
+  struct contended *c = c_;
+
+  contend (c);
+  sema_up (&c->done);
+}
+
+/* Acquisition and release of a lock that another thread of the
+   same priority holds half of the time.  Each operation includes
+   the thread switches needed to hand the lock over. */
+static void
+bench_lock_contended (int cnt)
+{
+  struct contended c;
+
+  lock_init (&c.lock);
+  c.cnt = cnt / 2;
+  sema_init (&c.done, 0);
+  thread_create ("bench lock", thread_get_priority (), contend_thread, &c);
+  contend (&c);
+  sema_down (&c.done);
+}
+
+static void
+exit_thread (void *done)
+{
+  sema_up (done);
+}
+
+/* thread_create() of a thread that exits at once, and waiting for
+   it to do so. */
+static void
+bench_thread (int cnt)
+{
+  struct semaphore done;
+  int i;
+
+  sema_init (&done, 0);
+  for (i = 0; i < cnt; i++)
+    {
+      thread_create ("bench child", thread_get_priority (), exit_thread,
+                     &done);
+      sema_down (&done);
+    }
+}
+
+/* bitmap_scan() for a bit near the end of a bitmap of 4096 bits,
+   the size of the page allocator's bitmap for 16 MB. */
+static void
+bench_bitmap_scan (int cnt)
+{
+  struct bitmap *b = bitmap_create (4096);
+  int i;
+
+  ASSERT (b != NULL);
+  bitmap_set_all (b, true);
+  bitmap_reset (b, 4000);
+  for (i = 0; i < cnt; i++)
+    if (bitmap_scan (b, 0, 1, false) != 4000)
+      PANIC ("bitmap_scan found the wrong bit");
+  bitmap_destroy (b);
+}
+
+/* An element of the hash table searched by bench_hash_find(). */
+struct bench_elem
+  {
+    struct hash_elem elem;
+    int key;
+  };
+
+static unsigned
+bench_elem_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct bench_elem, elem)->key);
+}
+
+static bool
+bench_elem_less (const struct hash_elem *a, const struct hash_elem *b,
+                 void *aux UNUSED)
+{
+  return (hash_entry (a, struct bench_elem, elem)->key
+          < hash_entry (b, struct bench_elem, elem)->key);
+}
+
+/* hash_find() of keys present in a table of 1024 elements. */
+static void
+bench_hash_find (int cnt)
+{
+  enum { ELEM_CNT = 1024 };
+  struct bench_elem *elems = malloc (ELEM_CNT * sizeof *elems);
+  struct bench_elem key;
+  struct hash h;
+  int i;
+
+  ASSERT (elems != NULL);
+  hash_init (&h, bench_elem_hash, bench_elem_less, NULL);
+  for (i = 0; i < ELEM_CNT; i++)
+    {
+      elems[i].key = i;
+      hash_insert (&h, &elems[i].elem);
+    }
+  for (i = 0; i < cnt; i++)
+    {
+      key.key = i % ELEM_CNT;
+      if (hash_find (&h, &key.elem) == NULL)
+        PANIC ("hash_find missed key %d", key.key);
+    }
+  hash_destroy (&h, NULL);
+  free (elems);
+}
+
+#ifdef FILESYS
+/* cache_read() of a sector that is already in the buffer
+   cache. */
+static void
+bench_cache_read (int cnt)
+{
+  static uint8_t buf[BLOCK_SECTOR_SIZE];
+  int i;
+
+  cache_read (0, buf);
+  for (i = 0; i < cnt; i++)
+    cache_read (0, buf);
+}
+#endif
+
+/* The microbenchmarks, in the order that "bench all" runs them. */
+static const struct bench benches[] =
+  {
+    {"malloc", 10000, bench_malloc},
+    {"palloc", 10000, bench_palloc},
+    {"lock", 100000, bench_lock},
+    {"lock-contended", 2000, bench_lock_contended},
+    {"thread", 500, bench_thread},
+    {"bitmap_scan", 2000, bench_bitmap_scan},
+    {"hash_find", 100000, bench_hash_find},
+#ifdef FILESYS
+    {"cache_read", 10000, bench_cache_read},
+#endif
+  };
+#define BENCH_CNT (sizeof benches / sizeof *benches)
+
+/* Runs B and prints its cost per operation. */
+static void
+run_one (const struct bench *b)
+{
+  uint64_t start, cycles;
+
+  start = timer_cycles ();
+  b->run (b->cnt);
+  cycles = timer_cycles () - start;
+  printf ("Bench %s: %d ops, %"PRIu64" cycles/op\n",
+          b->name, b->cnt, cycles / b->cnt);
+}
+
+/* Runs the microbenchmark called NAME, or all of them if NAME is
+   "all".  Panics if there is no such benchmark. */
+void
+bench_run (const char *name)
+{
+  size_t i;
+  bool found = false;
+
+  for (i = 0; i < BENCH_CNT; i++)
+    if (!strcmp (name, "all") || !strcmp (name, benches[i].name))
+      {
+        run_one (&benches[i]);
+        found = true;
+      }
+  if (!found)
+    {
+      printf ("Available benchmarks:");
+      for (i = 0; i < BENCH_CNT; i++)
+        printf (" %s", benches[i].name);
+      printf ("\n");
+      PANIC ("no benchmark named \"%s\"", name);
+    }
+}
@@ -0,0 +1,14 @@
+#ifndef THREADS_BENCH_H
+#define THREADS_BENCH_H
+
+/* In-kernel microbenchmarks.
+
+   The "bench NAME" kernel action runs the microbenchmark named
+   NAME, or all of them if NAME is "all", and prints one line per
+   benchmark with the average cost of one operation in CPU cycles,
+   as counted by the time stamp counter.  This way kernel
+   primitives can be measured without writing a user program. */
+
+void bench_run (const char *name);
+
+#endif /* threads/bench.h */
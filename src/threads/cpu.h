@@ -0,0 +1,102 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* CPU feature detection and control registers.  See [IA32-v2a]
+   "CPUID--CPU Identification" and [IA32-v3a] 2.5 "Control
+   Registers". */
+
+/* CR0 bits. */
+#define CR0_MP 0x00000002       /* Monitor coprocessor. */
+#define CR0_EM 0x00000004       /* Emulate coprocessor. */
+#define CR0_TS 0x00000008       /* Task switched. */
+#define CR0_NE 0x00000020       /* Numeric error reporting. */
+
+/* CR4 bits. */
+#define CR4_PSE 0x00000010      /* 4 MB pages. */
+#define CR4_PGE 0x00000080      /* Global pages. */
+#define CR4_OSFXSR 0x00000200   /* FXSAVE, FXRSTOR, and SSE. */
+#define CR4_OSXMMEXCPT 0x00000400 /* #XF for SSE exceptions. */
+
+/* Feature bits in EDX returned by CPUID function 1. */
+#define CPUID_FPU 0x00000001    /* x87 FPU on chip. */
+#define CPUID_PSE 0x00000008    /* 4 MB pages. */
+#define CPUID_SEP 0x00000800    /* SYSENTER and SYSEXIT. */
+#define CPUID_PGE 0x00002000    /* Global pages. */
+#define CPUID_FXSR 0x01000000   /* FXSAVE and FXRSTOR. */
+#define CPUID_SSE 0x02000000    /* SSE. */
+
+/* Model-specific registers for SYSENTER.  See [IA32-v3b]
+   B.1 "Architectural MSRs". */
+#define MSR_SYSENTER_CS 0x174   /* Kernel code selector. */
+#define MSR_SYSENTER_ESP 0x175  /* Kernel stack pointer. */
+#define MSR_SYSENTER_EIP 0x176  /* Kernel entry point. */
+
+/* Runs CPUID function LEAF and stores EAX, EBX, ECX, and EDX
+   in REGS[0] through REGS[3]. */
+static inline void
+cpuid (uint32_t leaf, uint32_t regs[4]) 
+{
+  asm ("cpuid"
+       : "=a" (regs[0]), "=b" (regs[1]), "=c" (regs[2]), "=d" (regs[3])
+       : "a" (leaf), "c" (0));
+}
+
+/* Returns true if the CPU has FEATURE, one of the CPUID_*
+   feature bits. */
+static inline bool
+cpu_has (uint32_t feature) 
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  return (edx & feature) != 0;
+}
+
+static inline uint32_t
+cr0_read (void) 
+{
+  uint32_t cr0;
+  asm volatile ("movl %%cr0, %0" : "=r" (cr0));
+  return cr0;
+}
+
+static inline void
+cr0_write (uint32_t cr0) 
+{
+  asm volatile ("movl %0, %%cr0" : : "r" (cr0) : "memory");
+}
+
+static inline uint32_t
+cr4_read (void) 
+{
+  uint32_t cr4;
+  asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+  return cr4;
+}
+
+static inline void
+cr4_write (uint32_t cr4) 
+{
+  asm volatile ("movl %0, %%cr4" : : "r" (cr4) : "memory");
+}
+
+/* Returns the value of model-specific register MSR. */
+static inline uint64_t
+msr_read (uint32_t msr) 
+{
+  uint64_t value;
+  asm volatile ("rdmsr" : "=A" (value) : "c" (msr));
+  return value;
+}
+
+/* Writes VALUE to model-specific register MSR. */
+static inline void
+msr_write (uint32_t msr, uint64_t value) 
+{
+  asm volatile ("wrmsr" : : "c" (msr), "A" (value));
+}
+
+#endif /* threads/cpu.h */
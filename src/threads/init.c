@@ -15,25 +15,43 @@
 #include "devices/timer.h"
 #include "devices/vga.h"
 #include "devices/rtc.h"
+#include "threads/bench.h"
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/profile.h"
 #include "threads/pte.h"
+#include "threads/shrinker.h"
+#include "threads/smp.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/process.h"
+#include "userprog/aio.h"
 #include "userprog/exception.h"
+#include "userprog/fpu.h"
+#include "userprog/futex.h"
 #include "userprog/gdt.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
 #else
 #include "tests/threads/tests.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#endif
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "devices/ramdisk.h"
+#include "devices/virtio-blk.h"
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
@@ -52,6 +70,12 @@ static const char *scratch_bdev_name;
 #ifdef VM
 static const char *swap_bdev_name;
 #endif
+
+/* -ramdisk: Size of the RAM disk in kB, or 0 for none. */
+static size_t ramdisk_kb;
+
+/* -preload: Files to bring into memory at boot, or null. */
+static const char *preload_files;
 #endif /* FILESYS */
 
 /* -ul: Maximum number of pages to put into palloc's user pool */
@@ -64,6 +88,8 @@ static char **read_command_line (void);
 static char **parse_options (char **argv);
 static void run_actions (char **argv);
 static void usage (void);
+static void set_time_slices (char *value);
+static void set_calibration (const char *value);
 
 #ifdef FILESYS
 static void locate_block_devices (void);
@@ -98,6 +124,11 @@ main (void)
   palloc_init (user_page_limit);
   malloc_init ();
   paging_init ();
+  smp_init ();
+  trace_init ();
+#ifdef VM
+  page_init ();
+#endif
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -108,23 +139,40 @@ main (void)
   /* Initialize interrupt handlers. */
   intr_init ();
   timer_init ();
+  profile_init ();
   kbd_init ();
   input_init ();
 #ifdef USERPROG
   exception_init ();
+  fpu_init ();
   syscall_init ();
+  process_init ();
+  futex_init ();
 #endif
 
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
   serial_init_queue ();
+  vga_start_renderer ();
   timer_calibrate ();
+  workqueue_start ();
+  shrinker_start ();
+#ifdef USERPROG
+  aio_init ();
+#endif
 
 #ifdef FILESYS
   /* Initialize file system. */
   ide_init ();
+  virtio_blk_init ();
+  ramdisk_init (ramdisk_kb);
   locate_block_devices ();
   filesys_init (format_filesys);
+  if (preload_files != NULL)
+    filesys_preload (preload_files);
+#endif
+#ifdef VM
+  swap_init ();
 #endif
 
   printf ("Boot complete.\n");
@@ -153,12 +201,19 @@ bss_init (void)
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
-   directory it creates. */
+   directory it creates.
+
+   If the CPU supports it, each 4 MB of RAM is mapped by a single
+   large-page PDE, which takes one TLB entry instead of 1,024
+   and needs no page table.  The 4 MB that hold the kernel's
+   code, which is mapped read-only, and a partial 4 MB at the
+   end of RAM are mapped with page tables as usual. */
 static void
 paging_init (void)
 {
   uint32_t *pd, *pt;
   size_t page;
+  bool pse = cpu_has (CPUID_PSE);
   extern char _start, _end_kernel_text;
 
   pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
@@ -173,19 +228,42 @@ paging_init (void)
 
       if (pd[pde_idx] == 0)
         {
+          char *span_end = vaddr + PTSPAN;
+
+          if (pse && pte_idx == 0
+              && page + PTSPAN / PGSIZE <= init_ram_pages
+              && (span_end <= &_start || vaddr >= &_end_kernel_text))
+            {
+              pd[pde_idx] = pde_create_large (vaddr);
+              page += PTSPAN / PGSIZE - 1;
+              continue;
+            }
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
           pd[pde_idx] = pde_create (pt);
         }
 
-      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
+      /* The kernel mapping is the same in every page directory,
+         so mark it global, to keep it in the TLB across
+         CR3 loads. */
+      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text) | PTE_G;
     }
 
+  /* Large pages must be enabled before a page directory that
+     uses them is loaded. */
+  if (pse)
+    cr4_write (cr4_read () | CR4_PSE);
+
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
      new page tables immediately.  See [IA32-v2a] "MOV--Move
      to/from Control Registers" and [IA32-v3a] 3.7.5 "Base Address
      of the Page Directory". */
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)));
+
+  /* Let PTE_G take effect, if the CPU supports global pages.  See
+     [IA32-v3a] 3.12 "Translation Lookaside Buffers (TLBs)". */
+  if (cpu_has (CPUID_PGE))
+    cr4_write (cr4_read () | CR4_PGE);
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -243,10 +321,20 @@ parse_options (char **argv)
 #ifdef FILESYS
       else if (!strcmp (name, "-f"))
         format_filesys = true;
+      else if (!strcmp (name, "-extents"))
+        filesys_extents = true;
       else if (!strcmp (name, "-filesys"))
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-ramdisk"))
+        ramdisk_kb = atoi (value);
+      else if (!strcmp (name, "-wbrate"))
+        cache_writeback_rate = atoi (value);
+      else if (!strcmp (name, "-preload"))
+        preload_files = value;
+      else if (!strcmp (name, "-crash"))
+        shutdown_configure_crash ();
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
@@ -256,9 +344,48 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-ts"))
+        set_time_slices (value);
+      else if (!strcmp (name, "-age"))
+        thread_age_ticks = atoi (value);
+      else if (!strcmp (name, "-ioboost"))
+        thread_io_boost = atoi (value);
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
+      else if (!strcmp (name, "-calibrate"))
+        set_calibration (value);
+      else if (!strcmp (name, "-vgadefer"))
+        vga_deferred = true;
+      else if (!strcmp (name, "-intrprof"))
+        intr_profile = true;
+      else if (!strcmp (name, "-prof"))
+        {
+          profile_enabled = true;
+          profile_event = value;
+        }
+#ifdef TRACE
+      else if (!strcmp (name, "-tracedev"))
+        trace_dev_name = value;
+#endif
+      else if (!strcmp (name, "-mleak"))
+        malloc_leak_check = true;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+      else if (!strcmp (name, "-sctrace"))
+        syscall_trace = true;
+      else if (!strcmp (name, "-nosysenter"))
+        syscall_sysenter = false;
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-stack"))
+        page_stack_limit = (size_t) atoi (value) * 1024;
+      else if (!strcmp (name, "-evict"))
+        frame_evict_policy = value;
+      else if (!strcmp (name, "-merge"))
+        frame_merge = true;
+      else if (!strcmp (name, "-zswap"))
+        swap_ram_limit = (size_t) atoi (value) * 1024;
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -277,6 +404,54 @@ parse_options (char **argv)
   return argv;
 }
 
+/* Sets the time slices of the priority bands from VALUE, a
+   comma-separated list of tick counts for the bands from lowest
+   to highest.  The last count given also applies to any bands
+   after it. */
+static void
+set_time_slices (char *value)
+{
+  char *count, *save_ptr;
+  int ticks = 0;
+  int band = 0;
+
+  if (value == NULL)
+    PANIC ("-ts requires a value (use -h for help)");
+  for (count = strtok_r (value, ",", &save_ptr); count != NULL;
+       count = strtok_r (NULL, ",", &save_ptr))
+    {
+      ticks = atoi (count);
+      if (ticks <= 0 || band >= THREAD_BAND_CNT)
+        PANIC ("bad -ts value `%s' (use -h for help)", count);
+      thread_time_slice[band++] = ticks;
+    }
+  if (band == 0)
+    PANIC ("-ts requires a value (use -h for help)");
+  for (; band < THREAD_BAND_CNT; band++)
+    thread_time_slice[band] = ticks;
+}
+
+/* Sets the busy-wait rate used instead of calibrating the timer
+   from VALUE, a number of loops per second that may contain
+   commas, as timer_calibrate() prints it. */
+static void
+set_calibration (const char *value)
+{
+  unsigned loops = 0;
+  const char *p;
+
+  if (value == NULL)
+    PANIC ("-calibrate requires a value (use -h for help)");
+  for (p = value; *p != '\0'; p++)
+    if (*p >= '0' && *p <= '9')
+      loops = loops * 10 + (*p - '0');
+    else if (*p != ',')
+      PANIC ("bad -calibrate value `%s' (use -h for help)", value);
+  if (loops / TIMER_FREQ == 0)
+    PANIC ("bad -calibrate value `%s' (use -h for help)", value);
+  timer_loops_per_sec = loops;
+}
+
 /* Runs the task specified in ARGV[1]. */
 static void
 run_task (char **argv)
@@ -292,6 +467,22 @@ run_task (char **argv)
   printf ("Execution of '%s' complete.\n", task);
 }
 
+/* Runs the microbenchmark named in ARGV[1]. */
+static void
+run_bench (char **argv)
+{
+  bench_run (argv[1]);
+}
+
+#ifdef FILESYS
+/* Prints block device statistics. */
+static void
+run_iostat (char **argv UNUSED)
+{
+  block_print_stats ();
+}
+#endif
+
 /* Executes all of the actions specified in ARGV[]
    up to the null pointer sentinel. */
 static void
@@ -309,7 +500,9 @@ run_actions (char **argv)
   static const struct action actions[] = 
     {
       {"run", 2, run_task},
+      {"bench", 2, run_bench},
 #ifdef FILESYS
+      {"iostat", 1, run_iostat},
       {"ls", 1, fsutil_ls},
       {"cat", 2, fsutil_cat},
       {"rm", 2, fsutil_rm},
@@ -357,7 +550,9 @@ usage (void)
 #else
           "  run TEST           Run TEST.\n"
 #endif
+          "  bench NAME         Run kernel microbenchmark NAME, or `all'.\n"
 #ifdef FILESYS
+          "  iostat             Print block device I/O statistics.\n"
           "  ls                 List files in the root directory.\n"
           "  cat FILE           Print FILE to the console.\n"
           "  rm FILE            Delete FILE.\n"
@@ -371,16 +566,50 @@ usage (void)
           "  -r                 Reboot after actions.\n"
 #ifdef FILESYS
           "  -f                 Format file system device during startup.\n"
+          "  -extents           With -f, lay out files as extents.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+          "  -ramdisk=KB        Add RAM disk rd0 of KB kB, for use as a BDEV.\n"
+          "  -wbrate=N          Write back at most N dirty sectors per second\n"
+          "                     in the background (default 256).\n"
+          "  -preload=FILE,...  Read FILEs into memory in the background\n"
+          "                     at boot, executables ready to run.\n"
+          "  -crash             Power off without writing back the file\n"
+          "                     system, to test recovery at next boot.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -ts=TICKS[,...]    Set time slices of priority bands, lowest first.\n"
+          "  -age=TICKS         Raise waiting threads' priority every TICKS.\n"
+          "  -ioboost=N         Boost threads woken by I/O N levels.\n"
+          "  -tickless          Stop the timer tick while idle.\n"
+          "  -calibrate=LOOPS   Skip timer calibration, using LOOPS loops/s\n"
+          "                     as printed by an earlier boot.\n"
+          "  -vgadefer          Redraw the screen from a low-priority thread.\n"
+          "  -intrprof          Report where interrupts are kept off longest.\n"
+          "  -prof              Sample the CPU on each tick, for utils/profile.\n"
+          "  -prof=EVENT[:N]    Sample on every N of a CPU counter's EVENTs\n"
+          "                     (cycles, instructions, llc-misses, ...).\n"
+#ifdef TRACE
+          "  -tracedev=BDEV     Dump the event trace to BDEV at shutdown.\n"
+#endif
+          "  -mleak             Report callers of unfreed allocations.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+          "  -sctrace           Report each process's system calls and\n"
+          "                     resource use at exit.\n"
+          "  -nosysenter        Make user programs enter the kernel for\n"
+          "                     system calls with int $0x30 only.\n"
+#endif
+#ifdef VM
+          "  -stack=KB          Limit user stacks to KB kB (default 8192).\n"
+          "  -evict=POLICY      Evict frames by POLICY: clock (default) or aging.\n"
+          "  -merge             Merge identical user pages, copy-on-write.\n"
+          "  -zswap=KB          Keep up to KB kB of compressed swapped pages\n"
+          "                     in memory instead of on the swap device.\n"
 #endif
           );
   shutdown_power_off ();
@@ -1,5 +1,6 @@
 #include "threads/interrupt.h"
 #include <debug.h>
+#include <intr-stats.h>
 #include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -9,6 +10,9 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "devices/timer.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#endif
 
 /* Programmable Interrupt Controller (PIC) registers.
    A PC has two PICs, called the master and slave PICs, with the
@@ -37,6 +41,25 @@ static const char *intr_names[INTR_CNT];
    unexpected interrupt is one that has no registered handler. */
 static unsigned int unexpected_cnt[INTR_CNT];
 
+/* Statistics for each vector's handler: how often it ran and
+   for how long. */
+static struct intr_stats vec_stats[INTR_CNT];
+
+/* Interrupt-off profiling, turned on by the "-intrprof" kernel
+   option.  Each time intr_disable() or intr_set_level() turns
+   interrupts off, we note the time and the caller, and when
+   intr_enable() turns them back on we charge the elapsed time to
+   that caller in OFF_STATS, an open-addressed table of call
+   sites.  A window that is closed some other way, by "iret" or
+   by the idle thread's "sti", is dropped: it is still open when
+   an interrupt arrives with interrupts on, or when interrupts
+   are turned off or on again, and these discard it. */
+bool intr_profile;
+static struct intr_stats off_stats[INTR_STATS_SITES];
+static uint64_t off_dropped;    /* Windows lost to a full table. */
+static void *off_site;          /* Caller that opened the window. */
+static uint64_t off_start;      /* When it was opened. */
+
 /* External interrupts are those generated by devices outside the
    CPU, such as the timer.  External interrupts run with
    interrupts turned off, so they never nest, nor are they ever
@@ -47,6 +70,19 @@ static unsigned int unexpected_cnt[INTR_CNT];
 static bool in_external_intr;   /* Are we processing an external interrupt? */
 static bool yield_on_return;    /* Should we yield on interrupt return? */
 
+/* Deferred work.  An external interrupt handler that has more
+   to do than it must do with interrupts off queues the rest with
+   intr_defer().  On the way out of the interrupt, after the PIC
+   is acknowledged, the queued work runs with interrupts on, so
+   that other devices are not kept waiting for it.  Deferred work
+   counts as interrupt context: it may not sleep, and it may not
+   be pre-empted, so an interrupt that arrives in the middle of
+   it leaves any work of its own, and any request to yield, to
+   the loop that is already running. */
+static struct list deferred_work = LIST_INITIALIZER (deferred_work);
+static bool in_deferred_work;   /* Are we running deferred work? */
+static bool yield_after_work;   /* Should we yield once it is done? */
+
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
 static void pic_end_of_interrupt (int irq);
@@ -59,6 +95,12 @@ static inline uint64_t make_idtr_operand (uint16_t limit, void *base);
 /* Interrupt handlers. */
 void intr_handler (struct intr_frame *args);
 static void unexpected_interrupt (const struct intr_frame *);
+static bool run_deferred_work (void);
+
+/* Profiling helpers. */
+static enum intr_level disable_at (void *site);
+static void add_sample (struct intr_stats *, uint64_t cycles);
+static void record_off_window (void);
 
 
 /* Returns the current interrupt status. */
@@ -81,7 +123,9 @@ intr_get_level (void)
 enum intr_level
 intr_set_level (enum intr_level level) 
 {
-  return level == INTR_ON ? intr_enable () : intr_disable ();
+  return (level == INTR_ON
+          ? intr_enable ()
+          : disable_at (__builtin_return_address (0)));
 }
 
 /* Enables interrupts and returns the previous interrupt status. */
@@ -89,7 +133,14 @@ enum intr_level
 intr_enable (void) 
 {
   enum intr_level old_level = intr_get_level ();
-  ASSERT (!intr_context ());
+  ASSERT (!in_external_intr);
+
+  if (off_site != NULL)
+    {
+      if (old_level == INTR_OFF)
+        record_off_window ();
+      off_site = NULL;
+    }
 
   /* Enable interrupts by setting the interrupt flag.
 
@@ -103,6 +154,14 @@ intr_enable (void)
 /* Disables interrupts and returns the previous interrupt status. */
 enum intr_level
 intr_disable (void) 
+{
+  return disable_at (__builtin_return_address (0));
+}
+
+/* Disables interrupts on behalf of the caller at SITE and
+   returns the previous interrupt status. */
+static enum intr_level
+disable_at (void *site)
 {
   enum intr_level old_level = intr_get_level ();
 
@@ -111,6 +170,11 @@ intr_disable (void)
      Hardware Interrupts". */
   asm volatile ("cli" : : : "memory");
 
+  if (old_level == INTR_ON && intr_profile)
+    {
+      off_site = site;
+      off_start = timer_cycles ();
+    }
   return old_level;
 }
 
@@ -186,6 +250,14 @@ intr_register_ext (uint8_t vec_no, intr_handler_func *handler,
   register_handler (vec_no, 0, INTR_OFF, handler, name);
 }
 
+/* Returns true if a handler has been registered for interrupt
+   VEC_NO, so that, for an external interrupt, its line is taken. */
+bool
+intr_is_registered (uint8_t vec_no)
+{
+  return intr_handlers[vec_no] != NULL;
+}
+
 /* Registers internal interrupt VEC_NO to invoke HANDLER, which
    is named NAME for debugging purposes.  The interrupt handler
    will be invoked with interrupt status LEVEL.
@@ -207,12 +279,12 @@ intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
   register_handler (vec_no, dpl, level, handler, name);
 }
 
-/* Returns true during processing of an external interrupt
-   and false at all other times. */
+/* Returns true during processing of an external interrupt,
+   including its deferred work, and false at all other times. */
 bool
 intr_context (void) 
 {
-  return in_external_intr;
+  return in_external_intr || in_deferred_work;
 }
 
 /* During processing of an external interrupt, directs the
@@ -223,9 +295,62 @@ void
 intr_yield_on_return (void) 
 {
   ASSERT (intr_context ());
-  yield_on_return = true;
+  if (in_external_intr)
+    yield_on_return = true;
+  else
+    yield_after_work = true;
+}
+
+/* Initializes W to call FUNC, passing AUX, when deferred. */
+void
+intr_work_init (struct intr_work *w, void (*func) (void *aux), void *aux)
+{
+  ASSERT (func != NULL);
+
+  w->func = func;
+  w->aux = aux;
+  w->pending = false;
+}
+
+/* During processing of an external interrupt, queues W to run
+   just before the interrupt returns, with interrupts on.  Does
+   nothing if W is already queued.  May not be called at any
+   other time. */
+void
+intr_defer (struct intr_work *w)
+{
+  ASSERT (in_external_intr);
+
+  if (!w->pending)
+    {
+      w->pending = true;
+      list_push_back (&deferred_work, &w->elem);
+    }
 }
 
+/* Returns true if external interrupt VEC_NO has been raised but
+   not yet delivered, e.g. because interrupts are off. */
+bool
+intr_ext_pending (uint8_t vec_no)
+{
+  int irq;
+
+  ASSERT (vec_no >= 0x20 && vec_no <= 0x2f);
+
+  /* OCW3: read the Interrupt Request Register. */
+  irq = vec_no - 0x20;
+  if (irq < 8)
+    {
+      outb (PIC0_CTRL, 0x0a);
+      return (inb (PIC0_CTRL) & (1 << irq)) != 0;
+    }
+  else
+    {
+      outb (PIC1_CTRL, 0x0a);
+      return (inb (PIC1_CTRL) & (1 << (irq - 8))) != 0;
+    }
+}
+
 /* 8259A Programmable Interrupt Controller. */
 
 /* Initializes the PICs.  Refer to [8259A] for details.
@@ -356,16 +481,34 @@ intr_handler (struct intr_frame *frame)
   if (external) 
     {
       ASSERT (intr_get_level () == INTR_OFF);
-      ASSERT (!intr_context ());
+      ASSERT (!in_external_intr);
 
       in_external_intr = true;
       yield_on_return = false;
     }
 
+  /* An interrupt-off window cannot be open in code that was
+     running with interrupts on. */
+  if (frame->eflags & FLAG_IF)
+    off_site = NULL;
+
   /* Invoke the interrupt's handler. */
   handler = intr_handlers[frame->vec_no];
   if (handler != NULL)
-    handler (frame);
+    {
+      uint64_t start = timer_cycles ();
+      uint64_t cycles;
+      uint32_t flags;
+
+      handler (frame);
+      cycles = timer_cycles () - start;
+
+      /* Handlers registered with interrupts on may be preempted,
+         so update the statistics with them off. */
+      asm volatile ("pushfl; popl %0; cli" : "=g" (flags) : : "memory");
+      add_sample (&vec_stats[frame->vec_no], cycles);
+      asm volatile ("pushl %0; popfl" : : "g" (flags) : "memory", "cc");
+    }
   else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f)
     {
       /* There is no handler, but this interrupt can trigger
@@ -378,15 +521,60 @@ intr_handler (struct intr_frame *frame)
   /* Complete the processing of an external interrupt. */
   if (external) 
     {
+      bool yield;
+
       ASSERT (intr_get_level () == INTR_OFF);
-      ASSERT (intr_context ());
+      ASSERT (in_external_intr);
 
       in_external_intr = false;
       pic_end_of_interrupt (frame->vec_no); 
 
-      if (yield_on_return) 
-        thread_yield (); 
+      yield = yield_on_return;
+      if (in_deferred_work)
+        yield_after_work |= yield;
+      else
+        {
+          if (!list_empty (&deferred_work) && run_deferred_work ())
+            yield = true;
+          if (yield)
+            thread_yield ();
+        }
+    }
+
+#ifdef USERPROG
+  /* A thread whose process is exiting must not go back to user
+     mode.  Its process may have been told to exit by another of
+     its threads while it was in the kernel or preempted. */
+  if (frame->cs == SEL_UCSEG && thread_current ()->process->exiting)
+    {
+      intr_enable ();
+      thread_exit ();
+    }
+#endif
+}
+
+/* Runs the deferred work queue until it is empty, with
+   interrupts on while each piece runs.  Returns true if the work
+   asked to yield on return from the interrupt. */
+static bool
+run_deferred_work (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (!in_deferred_work);
+
+  in_deferred_work = true;
+  yield_after_work = false;
+  while (!list_empty (&deferred_work))
+    {
+      struct intr_work *w = list_entry (list_pop_front (&deferred_work),
+                                        struct intr_work, elem);
+      w->pending = false;
+      asm volatile ("sti" : : : "memory");
+      w->func (w->aux);
+      asm volatile ("cli" : : : "memory");
     }
+  in_deferred_work = false;
+  return yield_after_work;
 }
 
 /* Handles an unexpected interrupt with interrupt frame F.  An
@@ -437,3 +625,110 @@ intr_name (uint8_t vec)
 {
   return intr_names[vec];
 }
+
+/* Profiling. */
+
+/* Adds one run of CYCLES cycles to S. */
+static void
+add_sample (struct intr_stats *s, uint64_t cycles)
+{
+  s->cnt++;
+  s->cycles += cycles;
+  if (cycles > s->max_cycles)
+    s->max_cycles = cycles;
+}
+
+/* Charges the interrupt-off window that is ending to the call
+   site that opened it.  Interrupts must be off. */
+static void
+record_off_window (void)
+{
+  uint64_t cycles = timer_cycles () - off_start;
+  uintptr_t site = (uintptr_t) off_site;
+  size_t i = (site >> 2) % INTR_STATS_SITES;
+  size_t probes;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (probes = 0; probes < INTR_STATS_SITES; probes++)
+    {
+      struct intr_stats *s = &off_stats[i];
+      if (s->site == site || s->site == 0)
+        {
+          s->site = site;
+          add_sample (s, cycles);
+          return;
+        }
+      i = (i + 1) % INTR_STATS_SITES;
+    }
+  off_dropped++;
+}
+
+/* Copies into STATS the statistics for interrupt vector IDX or,
+   if OFF, those in slot IDX of the table of call sites that
+   turned interrupts off, whose SITE member is 0 if the slot is
+   unused.  Returns false if IDX is out of range. */
+bool
+intr_get_stats (int idx, bool off, struct intr_stats *stats)
+{
+  enum intr_level old_level;
+
+  if (idx < 0 || idx >= (off ? INTR_STATS_SITES : INTR_CNT))
+    return false;
+
+  old_level = intr_disable ();
+  *stats = off ? off_stats[idx] : vec_stats[idx];
+  intr_set_level (old_level);
+  if (!off)
+    stats->site = 0;
+  return true;
+}
+
+/* Number of call sites that intr_print_stats() reports. */
+#define PRINT_SITES 10
+
+/* Prints statistics for each interrupt handler that has run
+   and, with "-intrprof", for the call sites that kept interrupts
+   off the longest in total. */
+void
+intr_print_stats (void)
+{
+  bool shown[INTR_STATS_SITES];
+  int i, j;
+
+  for (i = 0; i < INTR_CNT; i++)
+    {
+      const struct intr_stats *s = &vec_stats[i];
+      if (s->cnt > 0)
+        printf ("Interrupt %#04x (%s): %"PRIu64" calls, "
+                "%"PRIu64" cycles each, %"PRIu64" max\n",
+                i, intr_names[i], s->cnt, s->cycles / s->cnt,
+                s->max_cycles);
+    }
+
+  if (!intr_profile)
+    return;
+  for (i = 0; i < INTR_STATS_SITES; i++)
+    shown[i] = false;
+  for (j = 0; j < PRINT_SITES; j++)
+    {
+      const struct intr_stats *s;
+      int max = -1;
+
+      for (i = 0; i < INTR_STATS_SITES; i++)
+        if (off_stats[i].cnt > 0 && !shown[i]
+            && (max < 0 || off_stats[i].cycles > off_stats[max].cycles))
+          max = i;
+      if (max < 0)
+        break;
+      shown[max] = true;
+
+      s = &off_stats[max];
+      printf ("Interrupts off at %p: %"PRIu64" times, "
+              "%"PRIu64" cycles each, %"PRIu64" max\n",
+              (void *) s->site, s->cnt, s->cycles / s->cnt, s->max_cycles);
+    }
+  if (off_dropped > 0)
+    printf ("Interrupts off: %"PRIu64" windows at untracked sites\n",
+            off_dropped);
+}
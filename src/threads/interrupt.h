@@ -1,6 +1,7 @@
 #ifndef THREADS_INTERRUPT_H
 #define THREADS_INTERRUPT_H
 
+#include <list.h>
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -59,12 +60,35 @@ typedef void intr_handler_func (struct intr_frame *);
 
 void intr_init (void);
 void intr_register_ext (uint8_t vec, intr_handler_func *, const char *name);
+bool intr_is_registered (uint8_t vec);
 void intr_register_int (uint8_t vec, int dpl, enum intr_level,
                         intr_handler_func *, const char *name);
 bool intr_context (void);
 void intr_yield_on_return (void);
+bool intr_ext_pending (uint8_t vec);
+
+/* Work that an external interrupt handler defers until just
+   before the interrupt returns, when it runs with interrupts
+   on. */
+struct intr_work
+  {
+    struct list_elem elem;      /* Element in the deferred work list. */
+    void (*func) (void *aux);   /* Function to call. */
+    void *aux;                  /* Its argument. */
+    bool pending;               /* In the list? */
+  };
+
+void intr_work_init (struct intr_work *, void (*func) (void *aux),
+                     void *aux);
+void intr_defer (struct intr_work *);
 
 void intr_dump_frame (const struct intr_frame *);
 const char *intr_name (uint8_t vec);
 
+/* Profiling. */
+struct intr_stats;
+extern bool intr_profile;
+bool intr_get_stats (int idx, bool off, struct intr_stats *);
+void intr_print_stats (void);
+
 #endif /* threads/interrupt.h */
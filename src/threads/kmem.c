@@ -0,0 +1,261 @@
+#include "threads/kmem.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* An object cache allocator in the style of Bonwick's slab
+   allocator.
+
+   Each cache manages objects of one exact size.  A slab is a
+   single page obtained from the page allocator.  It begins with
+   a header, followed by a stack of the indexes of its free
+   objects, followed by the objects themselves.  Keeping the free
+   stack outside the objects means that an object keeps whatever
+   state its constructor gave it while it sits free in the cache:
+   the constructor runs once, when the slab is created, and
+   callers must return objects to the cache in that same state.
+
+   Slabs that have at least one free object are kept in the
+   cache's SLABS list, and allocation takes from the front.
+   Entirely free slabs stay in the cache, so that a cache whose
+   objects come and go does not go back to the page allocator
+   every time, and a cache that was once busy is ready to be busy
+   again.  When the kernel pool runs short, shrinker_reclaim()
+   calls kmem_shrink() to give free slabs back. */
+
+/* Magic number for detecting stray pointers. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Slab header. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in cache's SLABS list. */
+    size_t free_cnt;            /* Number of free objects. */
+    uint8_t *objs;              /* First object. */
+    uint16_t free[];            /* Indexes of free objects. */
+  };
+
+/* Alignment of objects within a slab. */
+#define OBJ_ALIGN 8
+
+/* All caches, for kmem_print_stats(). */
+static struct list caches = LIST_INITIALIZER (caches);
+
+static struct slab *slab_create (struct kmem_cache *);
+static struct slab *obj_to_slab (void *);
+static void slab_destroy (struct kmem_cache *, struct slab *);
+
+/* Initializes CACHE to hand out objects of OBJ_SIZE bytes.  If
+   CTOR is nonnull, it is called on each object once, when the
+   slab that holds the object is created.  NAME is used in
+   statistics and must remain valid for the life of the cache. */
+void
+kmem_cache_init (struct kmem_cache *cache, const char *name,
+                 size_t obj_size, void (*ctor) (void *))
+{
+  ASSERT (cache != NULL);
+  ASSERT (obj_size > 0);
+
+  cache->name = name;
+  cache->obj_size = ROUND_UP (obj_size, OBJ_ALIGN);
+  cache->objs_per_slab = ((PGSIZE - sizeof (struct slab) - OBJ_ALIGN)
+                          / (cache->obj_size + sizeof (uint16_t)));
+  ASSERT (cache->objs_per_slab > 0);
+  cache->ctor = ctor;
+  list_init (&cache->slabs);
+  cache->empty_cnt = 0;
+  lock_init (&cache->lock);
+  lock_set_spin (&cache->lock, LOCK_SPIN_SHORT);
+  lock_register (&cache->lock, name);
+  cache->slab_cnt = 0;
+  cache->live_cnt = cache->max_live_cnt = 0;
+  cache->alloc_cnt = cache->free_cnt = 0;
+  list_push_back (&caches, &cache->elem);
+}
+
+/* Obtains and returns an object from CACHE.  Returns a null
+   pointer if memory is not available.  The object's contents
+   are whatever the constructor left there or its previous user
+   returned it with; if CACHE has no constructor, they are
+   arbitrary. */
+void *
+kmem_cache_alloc (struct kmem_cache *cache)
+{
+  struct slab *s;
+  void *obj;
+
+  lock_acquire (&cache->lock);
+  if (list_empty (&cache->slabs))
+    {
+      s = slab_create (cache);
+      if (s == NULL)
+        {
+          lock_release (&cache->lock);
+          return NULL;
+        }
+      list_push_front (&cache->slabs, &s->elem);
+    }
+  else
+    {
+      s = list_entry (list_front (&cache->slabs), struct slab, elem);
+      if (s->free_cnt == cache->objs_per_slab)
+        cache->empty_cnt--;
+    }
+
+  obj = s->objs + s->free[--s->free_cnt] * cache->obj_size;
+  if (s->free_cnt == 0)
+    list_remove (&s->elem);
+
+  cache->alloc_cnt++;
+  if (++cache->live_cnt > cache->max_live_cnt)
+    cache->max_live_cnt = cache->live_cnt;
+  lock_release (&cache->lock);
+  return obj;
+}
+
+/* Returns OBJ, which must have been obtained from CACHE with
+   kmem_cache_alloc(), to CACHE.  Does nothing if OBJ is null. */
+void
+kmem_cache_free (struct kmem_cache *cache, void *obj)
+{
+  struct slab *s;
+
+  if (obj == NULL)
+    return;
+
+  s = obj_to_slab (obj);
+  ASSERT (s->cache == cache);
+
+  lock_acquire (&cache->lock);
+  ASSERT (s->free_cnt < cache->objs_per_slab);
+  if (s->free_cnt == 0)
+    list_push_front (&cache->slabs, &s->elem);
+  s->free[s->free_cnt++] = ((uint8_t *) obj - s->objs) / cache->obj_size;
+  cache->free_cnt++;
+  cache->live_cnt--;
+  if (s->free_cnt == cache->objs_per_slab)
+    cache->empty_cnt++;
+  lock_release (&cache->lock);
+}
+
+/* Gives up to PAGE_CNT entirely free slabs back to the page
+   allocator, from every cache whose lock is free, and returns
+   the number given back.  For shrinker_reclaim(), so it does not
+   wait for any lock. */
+size_t
+kmem_shrink (size_t page_cnt)
+{
+  struct list_elem *ce;
+  size_t freed = 0;
+
+  for (ce = list_begin (&caches); ce != list_end (&caches)
+         && freed < page_cnt; ce = list_next (ce))
+    {
+      struct kmem_cache *c = list_entry (ce, struct kmem_cache, elem);
+      struct list_elem *e;
+
+      if (c->empty_cnt == 0 || lock_held_by_current_thread (&c->lock)
+          || !lock_try_acquire (&c->lock))
+        continue;
+      for (e = list_begin (&c->slabs); e != list_end (&c->slabs)
+             && freed < page_cnt && c->empty_cnt > 0; )
+        {
+          struct slab *s = list_entry (e, struct slab, elem);
+
+          e = list_next (e);
+          if (s->free_cnt == c->objs_per_slab)
+            {
+              slab_destroy (c, s);
+              freed++;
+            }
+        }
+      lock_release (&c->lock);
+    }
+  return freed;
+}
+
+/* Prints statistics for every object cache. */
+void
+kmem_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&caches); e != list_end (&caches); e = list_next (e))
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+      printf ("Cache %s: %zu-byte objects, %zu per slab, %zu slabs "
+              "(%zu free), %zu live (peak %zu), %"PRIu64" allocs, "
+              "%"PRIu64" frees\n",
+              c->name, c->obj_size, c->objs_per_slab, c->slab_cnt,
+              c->empty_cnt, c->live_cnt, c->max_live_cnt, c->alloc_cnt,
+              c->free_cnt);
+    }
+}
+
+/* Allocates a new slab for CACHE and runs the constructor on
+   each of its objects.  Returns the slab, with every object
+   free, or a null pointer if no page is available. */
+static struct slab *
+slab_create (struct kmem_cache *cache)
+{
+  struct slab *s;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&cache->lock));
+
+  s = palloc_get_page (0);
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = cache;
+  s->free_cnt = cache->objs_per_slab;
+  s->objs = (uint8_t *) s + ROUND_UP (sizeof *s + cache->objs_per_slab
+                                      * sizeof *s->free, OBJ_ALIGN);
+  ASSERT (s->objs + cache->objs_per_slab * cache->obj_size
+          <= (uint8_t *) s + PGSIZE);
+
+  /* Push the indexes so that the lowest-addressed object is
+     handed out first. */
+  for (i = 0; i < cache->objs_per_slab; i++)
+    {
+      s->free[i] = cache->objs_per_slab - 1 - i;
+      if (cache->ctor != NULL)
+        cache->ctor (s->objs + i * cache->obj_size);
+    }
+  cache->slab_cnt++;
+  return s;
+}
+
+/* Removes S, which must be entirely free, from CACHE and gives
+   its page back. */
+static void
+slab_destroy (struct kmem_cache *cache, struct slab *s)
+{
+  ASSERT (lock_held_by_current_thread (&cache->lock));
+  ASSERT (s->free_cnt == cache->objs_per_slab);
+
+  list_remove (&s->elem);
+  cache->empty_cnt--;
+  cache->slab_cnt--;
+  s->magic = 0;
+  palloc_free_page (s);
+}
+
+/* Returns the slab that OBJ is inside. */
+static struct slab *
+obj_to_slab (void *obj)
+{
+  struct slab *s = pg_round_down (obj);
+
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT ((uint8_t *) obj >= s->objs);
+  ASSERT (((uint8_t *) obj - s->objs) % s->cache->obj_size == 0);
+  return s;
+}
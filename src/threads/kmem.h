@@ -0,0 +1,41 @@
+#ifndef THREADS_KMEM_H
+#define THREADS_KMEM_H
+
+#include <list.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "threads/synch.h"
+
+/* Object cache.
+
+   Hands out objects of a single fixed size, carved out of
+   whole pages ("slabs") obtained from the page allocator, so
+   that an object whose size is not a power of 2 doesn't waste
+   the rest of a malloc() block. */
+struct kmem_cache
+  {
+    const char *name;           /* Name, for statistics. */
+    size_t obj_size;            /* Size of each object in bytes. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    void (*ctor) (void *);      /* Constructor, or null. */
+    struct list slabs;          /* Slabs with at least one free object. */
+    size_t empty_cnt;           /* Number of entirely free slabs. */
+    struct lock lock;           /* Protects everything above and below. */
+    struct list_elem elem;      /* Element in list of all caches. */
+
+    /* Statistics. */
+    size_t slab_cnt;            /* Slabs currently allocated. */
+    size_t live_cnt;            /* Objects currently in use. */
+    size_t max_live_cnt;        /* Highest value of LIVE_CNT. */
+    uint64_t alloc_cnt;         /* Number of kmem_cache_alloc() calls. */
+    uint64_t free_cnt;          /* Number of kmem_cache_free() calls. */
+  };
+
+void kmem_cache_init (struct kmem_cache *, const char *name,
+                      size_t obj_size, void (*ctor) (void *));
+void *kmem_cache_alloc (struct kmem_cache *);
+void kmem_cache_free (struct kmem_cache *, void *);
+size_t kmem_shrink (size_t page_cnt);
+void kmem_print_stats (void);
+
+#endif /* threads/kmem.h */
@@ -1,12 +1,15 @@
 #include "threads/malloc.h"
 #include <debug.h>
+#include <inttypes.h>
 #include <list.h>
 #include <round.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* A simple implementation of malloc()
@@ -17,11 +20,18 @@
    the free list is nonempty, one of its blocks is used to
    satisfy the request
 
-   Otherwise, a new page of memory, called an "arena", is
-   obtained from the page allocator (if none is available,
-   malloc() returns a null pointer).  The new arena is divided
-   into blocks, all of which are added to the descriptor's free
-   list.  Then we return one of the new blocks
+   Otherwise, blocks are carved off the descriptor's newest
+   page of memory, called an "arena", one at a time.  When it is
+   used up, a new arena is obtained from the page allocator (if
+   none is available, malloc() returns a null pointer)
+
+   In front of each descriptor, every thread keeps a short stack
+   of free blocks, called a "magazine", in its struct thread.
+   malloc() and free() use the running thread's magazine without
+   taking any lock.  Only when the magazine is empty (or full)
+   does the thread take the descriptor's lock and move several
+   blocks into (or out of) its magazine at once.  Blocks in a
+   magazine count as in use as far as their arena is concerned
 
    When we free a block, we add it to its descriptor's free list.
    But if the arena that the block was in now has no in-use
@@ -40,7 +50,12 @@ struct desc
     size_t block_size;          /* Size of each element in bytes. */
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
+    struct arena *bump;         /* Arena with uncarved blocks, or null. */
     struct lock lock;           /* Lock. */
+    char name[16];              /* Lock name for statistics. */
+    struct mem_class_stats stats; /* Statistics.  ARENA_CNT is
+                                     protected by LOCK, the rest by
+                                     disabling interrupts. */
   };
 
 /* Magic number for detecting arena corruption. */
@@ -52,6 +67,7 @@ struct arena
     unsigned magic;             /* Always set to ARENA_MAGIC. */
     struct desc *desc;          /* Owning descriptor, null for big block. */
     size_t free_cnt;            /* Free blocks; pages in big block. */
+    size_t carved;              /* Blocks carved so far. */
   };
 
 /* Free block. */
@@ -60,12 +76,55 @@ struct block
     struct list_elem free_elem; /* Free list element. */
   };
 
+/* Free block in a thread's magazine. */
+struct mag_block
+  {
+    struct mag_block *next;     /* Next block in the magazine. */
+  };
+
+/* Number of blocks a magazine holds for each size class, and
+   the number moved between a magazine and its descriptor at a
+   time. */
+#define MAG_SIZE 8
+#define MAG_BATCH (MAG_SIZE / 2)
+
 /* Our set of descriptors. */
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Pages currently in big blocks. */
+static unsigned big_block_pages;
+
+/* Leak checking.
+
+   If malloc_leak_check is true, TAGS records the caller of each
+   live malloc() block and palloc_get_*() page, in an open
+   addressing hash table keyed on the block's address.  Removed
+   entries are marked TAG_DELETED, and the table is never
+   rehashed, so it is only a tool for hunting leaks in short
+   runs. */
+bool malloc_leak_check;
+
+/* A live allocation and its caller. */
+struct tag
+  {
+    const void *block;          /* Block or page, null if unused. */
+    const void *caller;         /* Return address of allocator call. */
+  };
+
+#define TAG_CNT 1024            /* Number of slots in TAGS. */
+#define TAG_DELETED ((const void *) 1) /* Slot that was in use. */
+static struct tag tags[TAG_CNT];
+static unsigned tag_dropped;    /* Allocations that didn't fit. */
+
+static void *malloc_from (size_t, const void *caller);
+static void count_alloc (struct desc *);
+static void count_free (struct desc *);
+
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static struct block *desc_get_block (struct desc *);
+static void desc_put_block (struct desc *, struct block *);
 
 /* Initializes the malloc() descriptors. */
 void
@@ -80,8 +139,40 @@ malloc_init (void)
       d->block_size = block_size;
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
       list_init (&d->free_list);
+      d->bump = NULL;
       lock_init (&d->lock);
+      lock_set_spin (&d->lock, LOCK_SPIN_SHORT);
+      snprintf (d->name, sizeof d->name, "malloc %zu", block_size);
+      lock_register (&d->lock, d->name);
+      memset (&d->stats, 0, sizeof d->stats);
+      d->stats.block_size = block_size;
     }
+  ASSERT (desc_cnt == MALLOC_CLASS_CNT);
+}
+
+/* Returns every block in the running thread's magazines to its
+   descriptor.  Called by thread_exit(). */
+void
+malloc_thread_exit (void)
+{
+  struct malloc_mag *m = &thread_current ()->mag;
+  size_t i;
+
+  for (i = 0; i < desc_cnt; i++)
+    if (m->cnt[i] > 0)
+      {
+        struct desc *d = &descs[i];
+
+        lock_acquire (&d->lock);
+        while (m->top[i] != NULL)
+          {
+            struct mag_block *mb = m->top[i];
+            m->top[i] = mb->next;
+            desc_put_block (d, (struct block *) mb);
+          }
+        m->cnt[i] = 0;
+        lock_release (&d->lock);
+      }
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
@@ -89,9 +180,20 @@ malloc_init (void)
 void *
 malloc (size_t size) 
 {
+  return malloc_from (size, __builtin_return_address (0));
+}
+
+/* Does the work of malloc() on behalf of CALLER. */
+static void *
+malloc_from (size_t size, const void *caller)
+{
+  enum intr_level old_level;
+  struct malloc_mag *m;
+  struct mag_block *mb;
   struct desc *d;
   struct block *b;
   struct arena *a;
+  size_t i;
 
   /* A null pointer satisfies a request for 0 bytes. */
   if (size == 0)
@@ -116,40 +218,49 @@ malloc (size_t size)
       a->magic = ARENA_MAGIC;
       a->desc = NULL;
       a->free_cnt = page_cnt;
+      malloc_untag (a);
+      malloc_tag (a + 1, caller);
+
+      old_level = intr_disable ();
+      big_block_pages += page_cnt;
+      intr_set_level (old_level);
       return a + 1;
     }
 
-  lock_acquire (&d->lock);
-
-  /* If the free list is empty, create a new arena. */
-  if (list_empty (&d->free_list))
+  /* Take a block from the running thread's magazine. */
+  i = d - descs;
+  m = &thread_current ()->mag;
+  mb = m->top[i];
+  if (mb != NULL)
     {
-      size_t i;
-
-      /* Allocate a page. */
-      a = palloc_get_page (0);
-      if (a == NULL) 
-        {
-          lock_release (&d->lock);
-          return NULL; 
-        }
-
-      /* Initialize arena and add its blocks to the free list. */
-      a->magic = ARENA_MAGIC;
-      a->desc = d;
-      a->free_cnt = d->blocks_per_arena;
-      for (i = 0; i < d->blocks_per_arena; i++) 
-        {
-          struct block *b = arena_to_block (a, i);
-          list_push_back (&d->free_list, &b->free_elem);
-        }
+      m->top[i] = mb->next;
+      m->cnt[i]--;
+      count_alloc (d);
+      malloc_tag (mb, caller);
+      return mb;
     }
 
-  /* Get a block from free list and return it. */
-  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-  a = block_to_arena (b);
-  a->free_cnt--;
+  /* The magazine is empty.  Get a block for the caller, and
+     refill the magazine while we hold the lock. */
+  lock_acquire (&d->lock);
+  b = desc_get_block (d);
+  while (b != NULL && m->cnt[i] < MAG_BATCH)
+    {
+      struct block *extra = desc_get_block (d);
+      if (extra == NULL)
+        break;
+      mb = (struct mag_block *) extra;
+      mb->next = m->top[i];
+      m->top[i] = mb;
+      m->cnt[i]++;
+    }
   lock_release (&d->lock);
+
+  if (b != NULL)
+    {
+      count_alloc (d);
+      malloc_tag (b, caller);
+    }
   return b;
 }
 
@@ -167,7 +278,7 @@ calloc (size_t a, size_t b)
     return NULL;
 
   /* Allocate and zero memory. */
-  p = malloc (size);
+  p = malloc_from (size, __builtin_return_address (0));
   if (p != NULL)
     memset (p, 0, size);
 
@@ -201,7 +312,8 @@ realloc (void *old_block, size_t new_size)
     }
   else 
     {
-      void *new_block = malloc (new_size);
+      void *new_block = malloc_from (new_size,
+                                     __builtin_return_address (0));
       if (old_block != NULL && new_block != NULL)
         {
           size_t old_size = block_size (old_block);
@@ -223,46 +335,274 @@ free (void *p)
       struct block *b = p;
       struct arena *a = block_to_arena (b);
       struct desc *d = a->desc;
-      
+
+      malloc_untag (p);
       if (d != NULL) 
         {
           /* It's a normal block.  We handle it here. */
+          struct malloc_mag *m = &thread_current ()->mag;
+          struct mag_block *mb;
+          size_t i = d - descs;
 
 #ifndef NDEBUG
           /* Clear the block to help detect use-after-free bugs. */
           memset (b, 0xcc, d->block_size);
 #endif
-  
-          lock_acquire (&d->lock);
-
-          /* Add block to free list. */
-          list_push_front (&d->free_list, &b->free_elem);
 
-          /* If the arena is now entirely unused, free it. */
-          if (++a->free_cnt >= d->blocks_per_arena) 
+          /* If the running thread's magazine is full, give half
+             of it back to the descriptor. */
+          if (m->cnt[i] >= MAG_SIZE)
             {
-              size_t i;
-
-              ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++) 
+              lock_acquire (&d->lock);
+              while (m->cnt[i] > MAG_SIZE - MAG_BATCH)
                 {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
+                  mb = m->top[i];
+                  m->top[i] = mb->next;
+                  m->cnt[i]--;
+                  desc_put_block (d, (struct block *) mb);
                 }
-              palloc_free_page (a);
+              lock_release (&d->lock);
             }
 
-          lock_release (&d->lock);
+          /* Add block to the magazine. */
+          mb = (struct mag_block *) b;
+          mb->next = m->top[i];
+          m->top[i] = mb;
+          m->cnt[i]++;
+          count_free (d);
         }
       else
         {
           /* It's a big block.  Free its pages. */
+          enum intr_level old_level = intr_disable ();
+          big_block_pages -= a->free_cnt;
+          intr_set_level (old_level);
           palloc_free_multiple (a, a->free_cnt);
           return;
         }
     }
 }
 
+/* Counts a block of descriptor D as allocated. */
+static void
+count_alloc (struct desc *d)
+{
+  enum intr_level old_level = intr_disable ();
+  d->stats.alloc_cnt++;
+  if (++d->stats.live_cnt > d->stats.max_live_cnt)
+    d->stats.max_live_cnt = d->stats.live_cnt;
+  intr_set_level (old_level);
+}
+
+/* Counts a block of descriptor D as freed. */
+static void
+count_free (struct desc *d)
+{
+  enum intr_level old_level = intr_disable ();
+  d->stats.free_cnt++;
+  d->stats.live_cnt--;
+  intr_set_level (old_level);
+}
+
+/* Copies the statistics of every size class, and the number of
+   pages in big blocks, into STATS.  Leaves the pool statistics
+   alone. */
+void
+malloc_get_stats (struct mem_stats *stats)
+{
+  enum intr_level old_level;
+  size_t i;
+
+  old_level = intr_disable ();
+  for (i = 0; i < desc_cnt; i++)
+    stats->classes[i] = descs[i].stats;
+  stats->big_block_pages = big_block_pages;
+  intr_set_level (old_level);
+}
+
+/* Returns the slot in TAGS for BLOCK, or, if BLOCK has none and
+   INSERT is true, the slot where it should go.  Returns a null
+   pointer if there is no such slot.  Interrupts must be off. */
+static struct tag *
+find_tag (const void *block, bool insert)
+{
+  size_t i = ((uintptr_t) block >> 4) * 2654435761u % TAG_CNT;
+  struct tag *deleted = NULL;
+  size_t n;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (n = 0; n < TAG_CNT; n++, i = (i + 1) % TAG_CNT)
+    {
+      struct tag *t = &tags[i];
+      if (t->block == block)
+        return t;
+      else if (t->block == TAG_DELETED && deleted == NULL)
+        deleted = t;
+      else if (t->block == NULL)
+        return !insert ? NULL : deleted != NULL ? deleted : t;
+    }
+  return insert ? deleted : NULL;
+}
+
+/* If leak checking is on, records that BLOCK was allocated by
+   CALLER. */
+void
+malloc_tag (const void *block, const void *caller)
+{
+  enum intr_level old_level;
+  struct tag *t;
+
+  if (!malloc_leak_check || block == NULL)
+    return;
+
+  old_level = intr_disable ();
+  t = find_tag (block, true);
+  if (t != NULL)
+    {
+      t->block = block;
+      t->caller = caller;
+    }
+  else
+    tag_dropped++;
+  intr_set_level (old_level);
+}
+
+/* If leak checking is on, forgets BLOCK's caller. */
+void
+malloc_untag (const void *block)
+{
+  enum intr_level old_level;
+  struct tag *t;
+
+  if (!malloc_leak_check || block == NULL)
+    return;
+
+  old_level = intr_disable ();
+  t = find_tag (block, false);
+  if (t != NULL)
+    t->block = TAG_DELETED;
+  intr_set_level (old_level);
+}
+
+/* Prints statistics for each size class and, if leak checking
+   is on, the callers of allocations that are still live. */
+void
+malloc_print_stats (void)
+{
+  struct mem_stats stats;
+  size_t i;
+
+  malloc_get_stats (&stats);
+  for (i = 0; i < desc_cnt; i++)
+    {
+      struct mem_class_stats *c = &stats.classes[i];
+      printf ("Malloc %u: %u live (peak %u) in %u arenas, "
+              "%"PRIu64" allocs, %"PRIu64" frees\n",
+              c->block_size, c->live_cnt, c->max_live_cnt, c->arena_cnt,
+              c->alloc_cnt, c->free_cnt);
+    }
+  printf ("Malloc big blocks: %u pages\n", stats.big_block_pages);
+
+  if (malloc_leak_check)
+    {
+      /* Count live allocations by caller.  The first slot seen
+         for each caller gathers the count; the rest are skipped. */
+      static unsigned counts[TAG_CNT];
+      unsigned live = 0;
+
+      for (i = 0; i < TAG_CNT; i++)
+        {
+          size_t j;
+
+          counts[i] = 0;
+          if (tags[i].block == NULL || tags[i].block == TAG_DELETED)
+            continue;
+          live++;
+          for (j = 0; j < i; j++)
+            if (counts[j] > 0 && tags[j].caller == tags[i].caller)
+              break;
+          counts[j < i ? j : i]++;
+        }
+
+      printf ("Leak check: %u allocations live, %u untracked\n",
+              live, tag_dropped);
+      for (i = 0; i < TAG_CNT; i++)
+        if (counts[i] > 0)
+          printf ("  %u from %p\n", counts[i], tags[i].caller);
+    }
+}
+
+/* Takes a free block from descriptor D, carving one off D's
+   newest arena or creating a new arena if D's free list is
+   empty.  Returns a null pointer if memory is not available. */
+static struct block *
+desc_get_block (struct desc *d)
+{
+  struct block *b;
+  struct arena *a;
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
+
+  if (!list_empty (&d->free_list))
+    b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
+  else
+    {
+      a = d->bump;
+      if (a == NULL)
+        {
+          /* Allocate a page. */
+          a = palloc_get_page (0);
+          if (a == NULL)
+            return NULL;
+          malloc_untag (a);
+          d->stats.arena_cnt++;
+
+          /* Initialize arena.  Its blocks are carved lazily. */
+          a->magic = ARENA_MAGIC;
+          a->desc = d;
+          a->free_cnt = d->blocks_per_arena;
+          a->carved = 0;
+          d->bump = a;
+        }
+      b = arena_to_block (a, a->carved++);
+      if (a->carved == d->blocks_per_arena)
+        d->bump = NULL;
+    }
+
+  block_to_arena (b)->free_cnt--;
+  return b;
+}
+
+/* Returns block B to descriptor D's free list, and gives its
+   arena back to the page allocator if it is now entirely
+   unused. */
+static void
+desc_put_block (struct desc *d, struct block *b)
+{
+  struct arena *a = block_to_arena (b);
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
+  ASSERT (a->desc == d);
+
+  list_push_front (&d->free_list, &b->free_elem);
+  if (++a->free_cnt >= d->blocks_per_arena)
+    {
+      size_t i;
+
+      ASSERT (a->free_cnt == d->blocks_per_arena);
+      for (i = 0; i < a->carved; i++)
+        {
+          struct block *b = arena_to_block (a, i);
+          list_remove (&b->free_elem);
+        }
+      if (d->bump == a)
+        d->bump = NULL;
+      d->stats.arena_cnt--;
+      palloc_free_page (a);
+    }
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b)
@@ -2,12 +2,38 @@
 #define THREADS_MALLOC_H
 
 #include <debug.h>
+#include <mem-stats.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+
+/* Number of malloc() size classes: 16, 32, ..., 1024 bytes. */
+#define MALLOC_CLASS_CNT MEM_CLASS_CNT
+
+/* A thread's magazine: for each size class, a short stack of
+   free blocks that only that thread allocates from and frees
+   into, so that most malloc() and free() calls skip the size
+   class's lock. */
+struct malloc_mag
+  {
+    void *top[MALLOC_CLASS_CNT];        /* Top block of each stack. */
+    uint8_t cnt[MALLOC_CLASS_CNT];      /* Blocks on each stack. */
+  };
+
+/* If true, record the caller of every allocation that is still
+   live, and report them at shutdown. */
+extern bool malloc_leak_check;
 
 void malloc_init (void);
+void malloc_thread_exit (void);
 void *malloc (size_t) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
 void free (void *);
 
+void malloc_get_stats (struct mem_stats *);
+void malloc_print_stats (void);
+void malloc_tag (const void *, const void *caller);
+void malloc_untag (const void *);
+
 #endif /* threads/malloc.h */
@@ -7,7 +7,10 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
+#include "threads/malloc.h"
+#include "threads/shrinker.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
@@ -23,7 +26,63 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes */
+   kernel pool, but that's just fine for demonstration purposes
+
+   Within a pool, single pages freed by palloc_free_page() go on
+   a stack of free pages, linked through their first word, and
+   single-page allocations pop from it in constant time.  Pages
+   on the stack stay marked in use in the pool's bitmap.  Other
+   allocations scan the bitmap starting from where the last scan
+   left off, and if that fails the stack is given back to the
+   bitmap and the whole pool is scanned.  The stack is protected
+   by disabling interrupts rather than by the pool's lock, since
+   pages are freed from the scheduler with interrupts off.
+
+   While the machine is otherwise idle, the idle thread moves
+   pages from that stack to a second stack of pages it has
+   already filled with zeros (see palloc_prezero()), so that a
+   PAL_ZERO allocation of a single page usually needn't clear
+   it.
+
+   When a pool has no page left for a single-page allocation, it
+   borrows up to BORROW_PAGES free pages at once from the other
+   pool, as long as the lender keeps a reserve of LEND_RESERVE of
+   its own pages free.  Borrowed pages go on the borrower's stack
+   of free pages.  Once freed, a lent page goes back to the pool
+   that owns it, so lending undoes itself when pressure drops.
+
+   The kernel pool also keeps the caches that registered a
+   shrinker (see threads/shrinker.c) from taking too much of it.
+   A kernel allocation that finds no pages asks them for some
+   back before failing, and one that leaves fewer than
+   LOW_WATERMARK pages free wakes the reclaim worker, which
+   shrinks them until HIGH_WATERMARK pages are free. */
+
+/* A free page on one of a pool's stacks. */
+struct free_page
+  {
+    struct free_page *next;             /* Next free page. */
+  };
+
+/* A stack of free pages. */
+struct page_stack
+  {
+    struct free_page *top;              /* Top page, or null. */
+    size_t cnt;                         /* Number of pages. */
+  };
+
+/* Maximum number of pre-zeroed pages kept in each pool. */
+#define PREZERO_MAX 64
+
+/* Number of pages borrowed from the other pool at a time, and
+   the fraction of its pages a lender keeps for itself. */
+#define BORROW_PAGES 32
+#define LEND_RESERVE(POOL) (bitmap_size ((POOL)->used_map) / 8)
+
+/* Free pages below which the kernel pool has its caches shrunk,
+   and up to which they are shrunk. */
+#define LOW_WATERMARK(POOL) (bitmap_size ((POOL)->used_map) / 16)
+#define HIGH_WATERMARK(POOL) (bitmap_size ((POOL)->used_map) / 8)
 
 /* A memory pool. */
 struct pool
@@ -31,17 +90,54 @@ struct pool
     struct lock lock;                   /* Mutual exclusion. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
     uint8_t *base;                      /* Base of pool. */
+    size_t next_idx;                    /* Where to start scanning. */
+    struct page_stack free_pages;       /* Free single pages. */
+    struct page_stack zero_pages;       /* Free pages known to be zero. */
+
+    /* Lending and borrowing, protected by disabling interrupts.
+       LENT_MAP is set for each page lent to the other pool and
+       not yet freed; FOREIGN_CNT counts borrowed pages on our
+       stacks. */
+    struct bitmap *lent_map;            /* Bitmap of lent pages. */
+    size_t lent_cnt;                    /* Number of bits set in LENT_MAP. */
+    size_t foreign_cnt;                 /* Borrowed pages on our stacks. */
+
+    /* Number of bits clear in USED_MAP, for the watermarks,
+       protected by disabling interrupts. */
+    size_t map_free_cnt;
   };
 
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+/* False if the user pool was given an explicit size limit,
+   which it must then not exceed by borrowing. */
+static bool user_may_borrow;
+
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
+static void *get_pages (enum palloc_flags, size_t page_cnt,
+                        const void *caller);
+static void *take_pages (struct pool *, size_t page_cnt, bool *zero);
+static size_t pool_free_cnt (struct pool *);
+static void map_free_add (struct pool *, size_t page_cnt);
 static bool page_from_pool (const struct pool *, void *page);
+static struct pool *other_pool (struct pool *);
+static struct pool *page_owner (void *page);
+static void *pool_pop (struct pool *, bool *zero);
+static bool pool_borrow (struct pool *);
+static void pool_get_stats (struct pool *, struct mem_pool_stats *);
+static void print_pool_stats (const char *, const struct mem_pool_stats *);
+static size_t pool_scan (struct pool *, size_t page_cnt);
+static bool pool_drain (struct pool *);
+static bool pool_prezero (struct pool *);
+static void stack_push (struct page_stack *, void *page);
+static void *stack_pop (struct page_stack *);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
-   pages are put into the user pool. */
+   pages are put into the user pool, and if USER_PAGE_LIMIT is
+   not SIZE_MAX, the user pool never borrows from the kernel
+   pool. */
 void
 palloc_init (size_t user_page_limit)
 {
@@ -53,6 +149,7 @@ palloc_init (size_t user_page_limit)
   size_t kernel_pages;
   if (user_pages > user_page_limit)
     user_pages = user_page_limit;
+  user_may_borrow = user_page_limit == SIZE_MAX;
   kernel_pages = free_pages - user_pages;
 
   /* Give half of memory to kernel, half to user. */
@@ -69,27 +166,39 @@ palloc_init (size_t user_page_limit)
    FLAGS, in which case the kernel panics. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
+{
+  return get_pages (flags, page_cnt, __builtin_return_address (0));
+}
+
+/* Does the work of palloc_get_multiple() on behalf of
+   CALLER. */
+static void *
+get_pages (enum palloc_flags flags, size_t page_cnt, const void *caller)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  bool zero = (flags & PAL_ZERO) != 0;
   void *pages;
-  size_t page_idx;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
-
-  if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
-  else
-    pages = NULL;
+  pages = take_pages (pool, page_cnt, &zero);
+  if (pages == NULL && pool == &kernel_pool
+      && shrinker_reclaim (page_cnt) > 0)
+    pages = take_pages (pool, page_cnt, &zero);
 
   if (pages != NULL) 
     {
-      if (flags & PAL_ZERO)
-        memset (pages, 0, PGSIZE * page_cnt);
+      if (zero)
+        {
+          size_t i;
+          for (i = 0; i < page_cnt; i++)
+            pg_zero ((uint8_t *) pages + PGSIZE * i);
+        }
+      malloc_tag (pages, caller);
+      if (pool == &kernel_pool
+          && pool_free_cnt (pool) < LOW_WATERMARK (pool))
+        shrinker_wake ();
     }
   else 
     {
@@ -100,6 +209,33 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   return pages;
 }
 
+/* Takes PAGE_CNT contiguous free pages from POOL, borrowing a
+   single page from the other pool if need be, and returns them,
+   or a null pointer if there are none.  If *ZERO is true, sets
+   it to false if the pages are known to be zero already. */
+static void *
+take_pages (struct pool *pool, size_t page_cnt, bool *zero)
+{
+  void *pages = page_cnt == 1 ? pool_pop (pool, zero) : NULL;
+  size_t page_idx;
+
+  if (pages != NULL)
+    return pages;
+
+  lock_acquire (&pool->lock);
+  page_idx = pool_scan (pool, page_cnt);
+  if (page_idx == BITMAP_ERROR && pool_drain (pool))
+    page_idx = pool_scan (pool, page_cnt);
+  lock_release (&pool->lock);
+
+  if (page_idx != BITMAP_ERROR)
+    return pool->base + PGSIZE * page_idx;
+  else if (page_cnt == 1 && pool_borrow (pool))
+    return pool_pop (pool, zero);
+  else
+    return NULL;
+}
+
 /* Obtains a single free page and returns its kernel virtual
    address.
    If PAL_USER is set, the page is obtained from the user pool,
@@ -110,7 +246,80 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 void *
 palloc_get_page (enum palloc_flags flags) 
 {
-  return palloc_get_multiple (flags, 1);
+  return get_pages (flags, 1, __builtin_return_address (0));
+}
+
+/* Obtains the single page PAGE, from the user pool if PAL_USER
+   is set in FLAGS and otherwise from the kernel pool, if it is
+   free, and returns it.  Returns a null pointer if PAGE is in
+   use, or on one of the pool's stacks of free pages, which keep
+   their pages marked in use.  If PAL_ZERO is set in FLAGS, the
+   page is filled with zeros.  PAL_ASSERT is ignored. */
+void *
+palloc_get_page_at (enum palloc_flags flags, void *page)
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  size_t page_idx;
+  bool taken = false;
+
+  ASSERT (pg_ofs (page) == 0);
+  if (!page_from_pool (pool, page))
+    return NULL;
+
+  page_idx = pg_no (page) - pg_no (pool->base);
+  lock_acquire (&pool->lock);
+  if (!bitmap_test (pool->used_map, page_idx))
+    {
+      bitmap_mark (pool->used_map, page_idx);
+      map_free_add (pool, -1);
+      taken = true;
+    }
+  lock_release (&pool->lock);
+  if (!taken)
+    return NULL;
+
+  if (flags & PAL_ZERO)
+    pg_zero (page);
+  malloc_tag (page, __builtin_return_address (0));
+  return page;
+}
+
+/* Returns the first of PAGE_CNT free pages, from the user pool
+   if PAL_USER is set in FLAGS and otherwise from the kernel
+   pool, whose physical address is a multiple of PAGE_CNT pages,
+   without allocating them, or a null pointer if there are none.
+   If no run is free, the pool's stacks of free pages are given
+   back to its bitmap and it is searched again.  For a caller
+   that then asks palloc_get_page_at() for the pages one at a
+   time, as it needs them, and can do without those that others
+   take in the meantime. */
+void *
+palloc_find_aligned (enum palloc_flags flags, size_t page_cnt)
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  size_t pool_cnt = bitmap_size (pool->used_map);
+  size_t first = (page_cnt - vtop (pool->base) / PGSIZE % page_cnt) % page_cnt;
+  void *pages = NULL;
+  int pass;
+
+  ASSERT (page_cnt > 0);
+
+  lock_acquire (&pool->lock);
+  for (pass = 0; pass < 2 && pages == NULL; pass++)
+    {
+      size_t idx;
+
+      if (pass == 1 && !pool_drain (pool))
+        break;
+      for (idx = first; idx + page_cnt <= pool_cnt; idx += page_cnt)
+        if (bitmap_none (pool->used_map, idx, page_cnt))
+          {
+            pages = pool->base + idx * PGSIZE;
+            break;
+          }
+    }
+  lock_release (&pool->lock);
+  return pages;
 }
 
 /* Frees the PAGE_CNT pages starting at PAGES. */
@@ -124,21 +333,32 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   if (pages == NULL || page_cnt == 0)
     return;
 
-  if (page_from_pool (&kernel_pool, pages))
-    pool = &kernel_pool;
-  else if (page_from_pool (&user_pool, pages))
-    pool = &user_pool;
-  else
-    NOT_REACHED ();
-
+  pool = page_owner (pages);
   page_idx = pg_no (pages) - pg_no (pool->base);
+  malloc_untag (pages);
 
 #ifndef NDEBUG
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  if (page_cnt == 1)
+    {
+      /* A lent page comes home. */
+      enum intr_level old_level = intr_disable ();
+      if (bitmap_test (pool->lent_map, page_idx))
+        {
+          bitmap_reset (pool->lent_map, page_idx);
+          pool->lent_cnt--;
+        }
+      intr_set_level (old_level);
+      stack_push (&pool->free_pages, pages);
+    }
+  else
+    {
+      bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+      map_free_add (pool, page_cnt);
+    }
 }
 
 /* Frees the page at PAGE. */
@@ -148,15 +368,68 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Zeros one free page ahead of time, for a later PAL_ZERO
+   allocation.  Returns false if there is nothing to do.  Called
+   by the idle thread with interrupts on; never sleeps. */
+bool
+palloc_prezero (void)
+{
+  return pool_prezero (&kernel_pool) || pool_prezero (&user_pool);
+}
+
+/* Returns the number of pages that the kernel pool is short of
+   its high watermark, or 0 if it has at least that many free. */
+size_t
+palloc_kernel_shortfall (void)
+{
+  size_t free_cnt = pool_free_cnt (&kernel_pool);
+  size_t high = HIGH_WATERMARK (&kernel_pool);
+
+  return free_cnt < high ? high - free_cnt : 0;
+}
+
+/* Stores the usage of the kernel and user pools into STATS.
+   Leaves the malloc() statistics alone.  Pages one pool has
+   borrowed from the other still belong to the lender, and are
+   counted as its used pages. */
+void
+palloc_get_stats (struct mem_stats *stats)
+{
+  pool_get_stats (&kernel_pool, &stats->kernel_pool);
+  pool_get_stats (&user_pool, &stats->user_pool);
+}
+
+/* Prints the usage of the kernel and user pools. */
+void
+palloc_print_stats (void)
+{
+  struct mem_stats stats;
+
+  palloc_get_stats (&stats);
+  print_pool_stats ("Kernel", &stats.kernel_pool);
+  print_pool_stats ("User", &stats.user_pool);
+}
+
+/* Prints STATS for the pool called NAME. */
+static void
+print_pool_stats (const char *name, const struct mem_pool_stats *stats)
+{
+  printf ("%s pool: %u pages free, %u used, largest free run %u, "
+          "%u lent, %u borrowed\n",
+          name, stats->free_cnt, stats->used_cnt, stats->largest_free_run,
+          stats->lent_cnt, stats->borrowed_cnt);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
+  /* We'll put the pool's used_map and lent_map at its base.
+     Calculate the space needed for the bitmaps
      and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  size_t bm_size = bitmap_buf_size (page_cnt);
+  size_t bm_pages = DIV_ROUND_UP (2 * bm_size, PGSIZE);
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
@@ -165,8 +438,60 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
 
   /* Initialize the pool. */
   lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  lock_set_spin (&p->lock, LOCK_SPIN_SHORT);
+  lock_register (&p->lock, name);
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
+  p->lent_map = bitmap_create_in_buf (page_cnt, (uint8_t *) base + bm_size,
+                                      bm_size);
   p->base = base + bm_pages * PGSIZE;
+  p->lent_cnt = p->foreign_cnt = 0;
+  p->map_free_cnt = page_cnt;
+  p->next_idx = 0;
+  p->free_pages.top = p->zero_pages.top = NULL;
+  p->free_pages.cnt = p->zero_pages.cnt = 0;
+}
+
+/* Finds PAGE_CNT consecutive free pages in POOL's bitmap, marks
+   them used, and returns the index of the first one, or
+   BITMAP_ERROR if there is no such run.  Scans from where the
+   previous scan ended, then from the start of the pool. */
+static size_t
+pool_scan (struct pool *pool, size_t page_cnt)
+{
+  size_t idx;
+
+  ASSERT (lock_held_by_current_thread (&pool->lock));
+
+  idx = bitmap_scan_from_hint (pool->used_map, pool->next_idx, page_cnt,
+                               false);
+  if (idx != BITMAP_ERROR)
+    {
+      bitmap_set_multiple (pool->used_map, idx, page_cnt, true);
+      map_free_add (pool, -page_cnt);
+      pool->next_idx = idx + page_cnt;
+      if (pool->next_idx >= bitmap_size (pool->used_map))
+        pool->next_idx = 0;
+    }
+  return idx;
+}
+
+/* Returns the pool other than POOL. */
+static struct pool *
+other_pool (struct pool *pool)
+{
+  return pool == &kernel_pool ? &user_pool : &kernel_pool;
+}
+
+/* Returns the pool that PAGE belongs to. */
+static struct pool *
+page_owner (void *page)
+{
+  if (page_from_pool (&kernel_pool, page))
+    return &kernel_pool;
+  else if (page_from_pool (&user_pool, page))
+    return &user_pool;
+  else
+    NOT_REACHED ();
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -180,3 +505,214 @@ page_from_pool (const struct pool *pool, void *page)
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Stores the usage of POOL into STATS.  Pages on POOL's stacks
+   count as free, but not toward the largest free run, since a
+   multi-page allocation only finds them after draining. */
+static void
+pool_get_stats (struct pool *pool, struct mem_pool_stats *stats)
+{
+  size_t page_cnt = bitmap_size (pool->used_map);
+  size_t run = 0, max_run = 0;
+  size_t free_cnt = 0;
+  enum intr_level old_level;
+  size_t i;
+
+  lock_acquire (&pool->lock);
+  for (i = 0; i < page_cnt; i++)
+    if (!bitmap_test (pool->used_map, i))
+      {
+        free_cnt++;
+        if (++run > max_run)
+          max_run = run;
+      }
+    else
+      run = 0;
+  old_level = intr_disable ();
+  free_cnt += (pool->free_pages.cnt + pool->zero_pages.cnt
+               - pool->foreign_cnt);
+  stats->lent_cnt = pool->lent_cnt;
+  stats->borrowed_cnt = other_pool (pool)->lent_cnt;
+  intr_set_level (old_level);
+  lock_release (&pool->lock);
+
+  stats->free_cnt = free_cnt;
+  stats->used_cnt = page_cnt - free_cnt;
+  stats->largest_free_run = max_run;
+}
+
+/* Returns the number of free pages in POOL, counting those on
+   its stacks but not those it has borrowed.  Unlike
+   pool_get_stats(), takes no lock, so that it is cheap enough to
+   call on every allocation. */
+static size_t
+pool_free_cnt (struct pool *pool)
+{
+  enum intr_level old_level = intr_disable ();
+  size_t free_cnt = (pool->map_free_cnt + pool->free_pages.cnt
+                     + pool->zero_pages.cnt - pool->foreign_cnt);
+  intr_set_level (old_level);
+  return free_cnt;
+}
+
+/* Adds PAGE_CNT, which may be "negative", to POOL's count of
+   clear bits in its bitmap. */
+static void
+map_free_add (struct pool *pool, size_t page_cnt)
+{
+  enum intr_level old_level = intr_disable ();
+  pool->map_free_cnt += page_cnt;
+  intr_set_level (old_level);
+}
+
+/* Returns every page on POOL's stacks of free pages to its
+   owner's bitmap.  Returns true if there were any. */
+static bool
+pool_drain (struct pool *pool)
+{
+  struct free_page *fp;
+  bool drained = false;
+
+  while ((fp = stack_pop (&pool->free_pages)) != NULL
+         || (fp = stack_pop (&pool->zero_pages)) != NULL)
+    {
+      struct pool *owner = page_owner (fp);
+      size_t idx = pg_no (fp) - pg_no (owner->base);
+
+      if (owner != pool)
+        {
+          enum intr_level old_level = intr_disable ();
+          pool->foreign_cnt--;
+          bitmap_reset (owner->lent_map, idx);
+          owner->lent_cnt--;
+          intr_set_level (old_level);
+        }
+      bitmap_reset (owner->used_map, idx);
+      map_free_add (owner, 1);
+      drained = true;
+    }
+  return drained;
+}
+
+/* Pops a page off one of POOL's stacks of free pages and
+   returns it, or a null pointer if both are empty.  If *ZERO is
+   true, a pre-zeroed page is preferred, and *ZERO is set to
+   false if one was found. */
+static void *
+pool_pop (struct pool *pool, bool *zero)
+{
+  void *page;
+
+  if (*zero)
+    {
+      page = stack_pop (&pool->zero_pages);
+      if (page != NULL)
+        *zero = false;
+      else
+        page = stack_pop (&pool->free_pages);
+    }
+  else
+    {
+      page = stack_pop (&pool->free_pages);
+      if (page == NULL)
+        page = stack_pop (&pool->zero_pages);
+    }
+
+  if (page != NULL && !page_from_pool (pool, page))
+    {
+      enum intr_level old_level = intr_disable ();
+      pool->foreign_cnt--;
+      intr_set_level (old_level);
+    }
+  return page;
+}
+
+/* Borrows up to BORROW_PAGES free pages from the other pool
+   onto POOL's stack of free pages.  Returns true if any were
+   borrowed. */
+static bool
+pool_borrow (struct pool *pool)
+{
+  struct pool *lender = other_pool (pool);
+  size_t page_cnt = bitmap_size (lender->used_map);
+  size_t free_cnt, borrowed = 0;
+
+  if (pool == &user_pool && !user_may_borrow)
+    return false;
+
+  lock_acquire (&lender->lock);
+  free_cnt = bitmap_count (lender->used_map, 0, page_cnt, false);
+  while (borrowed < BORROW_PAGES && free_cnt > LEND_RESERVE (lender))
+    {
+      size_t idx = pool_scan (lender, 1);
+      enum intr_level old_level;
+
+      if (idx == BITMAP_ERROR)
+        break;
+      free_cnt--;
+      borrowed++;
+
+      old_level = intr_disable ();
+      bitmap_mark (lender->lent_map, idx);
+      lender->lent_cnt++;
+      pool->foreign_cnt++;
+      intr_set_level (old_level);
+      stack_push (&pool->free_pages, lender->base + idx * PGSIZE);
+    }
+  lock_release (&lender->lock);
+  return borrowed > 0;
+}
+
+/* Zeros a page from POOL's stack of free pages and moves it to
+   the stack of pre-zeroed pages.  Returns false if there was
+   nothing to do. */
+static bool
+pool_prezero (struct pool *pool)
+{
+  struct free_page *fp;
+
+  if (pool->zero_pages.cnt >= PREZERO_MAX)
+    return false;
+  fp = stack_pop (&pool->free_pages);
+  if (fp == NULL)
+    return false;
+
+  pg_zero (fp);
+  stack_push (&pool->zero_pages, fp);
+  return true;
+}
+
+/* Pushes PAGE onto STACK. */
+static void
+stack_push (struct page_stack *stack, void *page)
+{
+  struct free_page *fp = page;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  fp->next = stack->top;
+  stack->top = fp;
+  stack->cnt++;
+  intr_set_level (old_level);
+}
+
+/* Pops a page off STACK and returns it, or returns a null
+   pointer if STACK is empty.  The page's link is cleared, so
+   that a page popped off a pool's ZERO_PAGES is all zeros. */
+static void *
+stack_pop (struct page_stack *stack)
+{
+  struct free_page *fp;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  fp = stack->top;
+  if (fp != NULL)
+    {
+      stack->top = fp->next;
+      stack->cnt--;
+      fp->next = NULL;
+    }
+  intr_set_level (old_level);
+  return fp;
+}
@@ -0,0 +1,282 @@
+#include "threads/pmc.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/profile.h"
+#include "threads/pte.h"
+#include "threads/vaddr.h"
+
+/* CPUID function 1 EDX bit for an on-chip local APIC. */
+#define CPUID_APIC 0x00000200
+
+/* Model-specific registers.  See [IA32-v3b] 18.2 and B.1. */
+#define MSR_APIC_BASE 0x1b              /* Local APIC base address. */
+#define MSR_PMC0 0xc1                   /* First counter. */
+#define MSR_PERFEVTSEL0 0x186           /* What it counts. */
+#define MSR_PERF_GLOBAL_CTRL 0x38f      /* Counter enables (v2+). */
+#define MSR_PERF_GLOBAL_OVF_CTRL 0x390  /* Clears overflows (v2+). */
+
+#define APIC_BASE_ENABLE 0x800          /* MSR_APIC_BASE: enabled. */
+
+/* PERFEVTSEL bits, besides the event in bits 0...7 and its unit
+   mask in bits 8...15. */
+#define EVTSEL_USR 0x00010000           /* Count in ring 3. */
+#define EVTSEL_OS 0x00020000            /* Count in ring 0. */
+#define EVTSEL_INT 0x00100000           /* Interrupt on overflow. */
+#define EVTSEL_EN 0x00400000            /* Enable. */
+
+/* Local APIC registers, as byte offsets.  See [IA32-v3a] 10.4.1
+   "The Local APIC Block Diagram". */
+#define LAPIC_EOI 0xb0                  /* End of interrupt. */
+#define LAPIC_SVR 0xf0                  /* Spurious interrupt vector. */
+#define LAPIC_LVT_PC 0x340              /* Performance counter LVT. */
+#define LAPIC_LVT_LINT0 0x350           /* LINT0 pin LVT. */
+#define LAPIC_LVT_LINT1 0x360           /* LINT1 pin LVT. */
+
+#define SVR_ENABLE 0x100                /* APIC software enable. */
+#define LVT_EXTINT 0x700                /* Pass on the 8259's INTR. */
+#define LVT_NMI 0x400                   /* Deliver as an NMI. */
+
+/* Interrupt vectors, above those of the PIC and system calls. */
+#define PMC_VEC 0xf0                    /* Counter overflow. */
+#define SPURIOUS_VEC 0xff               /* APIC spurious interrupt. */
+
+/* Kernel virtual address where the local APIC's registers are
+   mapped, uncached.  It is above the mapping of RAM. */
+#define LAPIC_VADDR ((volatile uint8_t *) 0xfffff000)
+
+/* An event that can be counted. */
+struct pmc_event
+  {
+    const char *name;           /* Name in -prof=EVENT. */
+    uint8_t event;              /* Event select. */
+    uint8_t umask;              /* Unit mask. */
+    int arch_bit;               /* CPUID 0xa EBX bit, set if missing. */
+  };
+
+/* The architectural events.  Others, such as TLB misses, differ
+   from one processor model to the next, so they may be given
+   directly as rUUEE, in hex, with the unit mask UU and event EE
+   that the processor's documentation lists. */
+static const struct pmc_event events[] =
+  {
+    {"cycles", 0x3c, 0x00, 0},
+    {"instructions", 0xc0, 0x00, 1},
+    {"ref-cycles", 0x3c, 0x01, 2},
+    {"llc-refs", 0x2e, 0x4f, 3},
+    {"llc-misses", 0x2e, 0x41, 4},
+    {"branches", 0xc4, 0x00, 5},
+    {"branch-misses", 0xc5, 0x00, 6},
+  };
+#define EVENT_CNT (sizeof events / sizeof *events)
+
+/* The event being sampled, its period, and the architectural
+   performance monitoring version. */
+static struct pmc_event sampled;
+static char sampled_name[16];
+static uint32_t period;
+static int version;
+static bool active;
+
+static intr_handler_func overflow_interrupt, spurious_interrupt;
+static bool parse_spec (const char *spec, struct pmc_event *);
+static bool lapic_init (void);
+
+static inline uint32_t
+lapic_read (int reg)
+{
+  return *(volatile uint32_t *) (LAPIC_VADDR + reg);
+}
+
+static inline void
+lapic_write (int reg, uint32_t value)
+{
+  *(volatile uint32_t *) (LAPIC_VADDR + reg) = value;
+}
+
+/* Starts sampling on the event described by SPEC, which has the
+   form EVENT[:PERIOD], where EVENT is the name of an event in
+   events[] or rUUEE.  Returns true if successful.  If the event is
+   unknown or the CPU cannot count it, prints why and returns
+   false.  Must be called with interrupts off, before any user
+   process starts. */
+bool
+pmc_sample_start (const char *spec)
+{
+  uint32_t regs[4];
+  int counter_cnt;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!parse_spec (spec, &sampled))
+    {
+      printf ("pmc: unknown event \"%s\"\n", spec);
+      return false;
+    }
+
+  cpuid (0, regs);
+  if (regs[0] < 0xa)
+    {
+      printf ("pmc: no architectural performance monitoring\n");
+      return false;
+    }
+  cpuid (0xa, regs);
+  version = regs[0] & 0xff;
+  counter_cnt = (regs[0] >> 8) & 0xff;
+  if (version == 0 || counter_cnt == 0)
+    {
+      printf ("pmc: no performance counters\n");
+      return false;
+    }
+  if (sampled.arch_bit >= 0
+      && (sampled.arch_bit >= (int) (regs[0] >> 24)
+          || (regs[1] & (1u << sampled.arch_bit)) != 0))
+    {
+      printf ("pmc: %s cannot be counted on this CPU\n", sampled.name);
+      return false;
+    }
+  if (!lapic_init ())
+    return false;
+
+  intr_register_int (PMC_VEC, 0, INTR_OFF, overflow_interrupt,
+                     "PMC overflow");
+  lapic_write (LAPIC_LVT_PC, PMC_VEC);
+  msr_write (MSR_PERFEVTSEL0, 0);
+  msr_write (MSR_PMC0, (uint32_t) -period);
+  if (version >= 2)
+    msr_write (MSR_PERF_GLOBAL_CTRL, 1);
+  msr_write (MSR_PERFEVTSEL0, (sampled.event | sampled.umask << 8
+                               | EVTSEL_USR | EVTSEL_OS | EVTSEL_INT
+                               | EVTSEL_EN));
+  active = true;
+  return true;
+}
+
+/* Prints the event being sampled, for utils/profile. */
+void
+pmc_print_stats (void)
+{
+  if (active)
+    printf ("Profile: one sample per %"PRIu32" %s\n", period, sampled.name);
+}
+
+/* Parses SPEC, as described in pmc_sample_start(), into *E and
+   PERIOD.  Returns false if SPEC is invalid. */
+static bool
+parse_spec (const char *spec, struct pmc_event *e)
+{
+  const char *colon = strchr (spec, ':');
+  size_t len = colon != NULL ? (size_t) (colon - spec) : strlen (spec);
+  size_t i;
+
+  if (len == 0 || len >= sizeof sampled_name)
+    return false;
+  memcpy (sampled_name, spec, len);
+  sampled_name[len] = '\0';
+
+  period = PMC_DEFAULT_PERIOD;
+  if (colon != NULL)
+    {
+      int p = atoi (colon + 1);
+      if (p <= 0)
+        return false;
+      period = p;
+    }
+
+  for (i = 0; i < EVENT_CNT; i++)
+    if (!strcmp (sampled_name, events[i].name))
+      {
+        *e = events[i];
+        return true;
+      }
+
+  /* rUUEE. */
+  if (sampled_name[0] == 'r' && len == 5)
+    {
+      uint32_t code = 0;
+      for (i = 1; i < len; i++)
+        {
+          int c = sampled_name[i];
+          int digit = (c >= '0' && c <= '9' ? c - '0'
+                       : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                       : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                       : -1);
+          if (digit < 0)
+            return false;
+          code = code * 16 + digit;
+        }
+      e->name = sampled_name;
+      e->event = code & 0xff;
+      e->umask = code >> 8;
+      e->arch_bit = -1;
+      return true;
+    }
+  return false;
+}
+
+/* Maps the local APIC's registers at LAPIC_VADDR, in every page
+   directory, and enables the APIC, keeping the 8259 PIC's
+   interrupts coming through it as before.  Returns false if the
+   CPU has no enabled local APIC. */
+static bool
+lapic_init (void)
+{
+  uint32_t *pde = init_page_dir + pd_no ((void *) LAPIC_VADDR);
+  uint32_t *pt;
+  uint64_t base;
+
+  if (!cpu_has (CPUID_APIC)
+      || !((base = msr_read (MSR_APIC_BASE)) & APIC_BASE_ENABLE))
+    {
+      printf ("pmc: no local APIC\n");
+      return false;
+    }
+
+  /* Page directories made from now on copy this PDE.  There are
+     none yet but init_page_dir. */
+  ASSERT (*pde == 0);
+  ASSERT (init_ram_pages * PGSIZE
+          <= (uintptr_t) LAPIC_VADDR - (uintptr_t) PHYS_BASE);
+  pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  pt[pt_no ((void *) LAPIC_VADDR)] = ((base & PTE_ADDR) | PTE_P | PTE_W
+                                      | PTE_PWT | PTE_PCD | PTE_G);
+  *pde = pde_create (pt);
+
+  intr_register_int (SPURIOUS_VEC, 0, INTR_OFF, spurious_interrupt,
+                     "APIC spurious");
+  if (!(lapic_read (LAPIC_SVR) & SVR_ENABLE))
+    {
+      /* Virtual wire mode, as the BIOS leaves it.  See [MPS] 3.6.2.2. */
+      lapic_write (LAPIC_LVT_LINT0, LVT_EXTINT);
+      lapic_write (LAPIC_LVT_LINT1, LVT_NMI);
+      lapic_write (LAPIC_SVR, SVR_ENABLE | SPURIOUS_VEC);
+    }
+  return true;
+}
+
+/* Counter overflow interrupt handler.  Takes a sample, then
+   rearms the counter and the APIC, which masks the interrupt on
+   delivery. */
+static void
+overflow_interrupt (struct intr_frame *f)
+{
+  profile_sample (f);
+  msr_write (MSR_PMC0, (uint32_t) -period);
+  if (version >= 2)
+    msr_write (MSR_PERF_GLOBAL_OVF_CTRL, 1);
+  lapic_write (LAPIC_LVT_PC, PMC_VEC);
+  lapic_write (LAPIC_EOI, 0);
+}
+
+/* Spurious APIC interrupts need no handling, not even an EOI. */
+static void
+spurious_interrupt (struct intr_frame *f UNUSED)
+{
+}
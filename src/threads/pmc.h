@@ -0,0 +1,23 @@
+#ifndef THREADS_PMC_H
+#define THREADS_PMC_H
+
+#include <stdbool.h>
+
+/* Hardware performance counters, for the profiler.
+
+   pmc_sample_start() programs the CPU's first general-purpose
+   performance counter to count an event and to interrupt, through
+   the local APIC, every PERIOD events, and each interrupt records
+   a profile sample.  Only Intel's architectural performance
+   monitoring is supported, as described in [IA32-v3b] 18.2
+   "Architectural Performance Monitoring", which most emulators
+   other than KVM do not provide. */
+
+/* Events are sampled every PMC_DEFAULT_PERIOD occurrences unless
+   the option gives a period. */
+#define PMC_DEFAULT_PERIOD 1000000
+
+bool pmc_sample_start (const char *spec);
+void pmc_print_stats (void);
+
+#endif /* threads/pmc.h */
@@ -0,0 +1,109 @@
+#include "threads/profile.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/pmc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* One sample: the interrupted EIP, then the return addresses of
+   its callers, innermost first, ending at the first null
+   pointer if there are fewer than PROFILE_DEPTH. */
+struct sample
+  {
+    void *pcs[PROFILE_DEPTH];
+  };
+
+/* Set by the "-prof" kernel option, and EVENT[:PERIOD] by
+   "-prof=EVENT[:PERIOD]". */
+bool profile_enabled;
+const char *profile_event;
+
+/* True if a performance counter takes the samples. */
+static bool counter_driven;
+
+/* Ring of the most recent samples.  The next sample goes into
+   SAMPLES[SAMPLE_CNT % PROFILE_SAMPLES]. */
+static struct sample samples[PROFILE_SAMPLES];
+static uint64_t sample_cnt;
+
+/* Starts sampling on PROFILE_EVENT, if one was given.  Called
+   with interrupts off, before any user process starts. */
+void
+profile_init (void)
+{
+  if (profile_enabled && profile_event != NULL)
+    {
+      counter_driven = pmc_sample_start (profile_event);
+      if (!counter_driven)
+        printf ("Profiling on timer ticks instead.\n");
+    }
+}
+
+/* Records a sample of interrupted frame F, unless a performance
+   counter is taking the samples.  Called by the timer interrupt
+   on each tick if profiling is enabled. */
+void
+profile_tick (const struct intr_frame *f)
+{
+  if (!counter_driven)
+    profile_sample (f);
+}
+
+/* Records a sample of interrupted frame F. */
+void
+profile_sample (const struct intr_frame *f)
+{
+  struct sample *s = &samples[sample_cnt++ % PROFILE_SAMPLES];
+  int depth = 0;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  s->pcs[depth++] = (void *) f->eip;
+  if (is_kernel_vaddr (s->pcs[0]))
+    {
+      /* Interrupts are taken on the running thread's kernel
+         stack, so the frames of the code that was interrupted are
+         on the same page as F.  Stop at the first one that is
+         not. */
+      void *stack = pg_round_down (f);
+      void **frame = (void **) f->ebp;
+
+      while (depth < PROFILE_DEPTH
+             && pg_round_down (frame) == stack
+             && frame[0] != NULL)
+        {
+          s->pcs[depth++] = frame[1];
+          frame = frame[0];
+        }
+    }
+  if (depth < PROFILE_DEPTH)
+    s->pcs[depth] = NULL;
+}
+
+/* Prints the samples kept, oldest first, if profiling is
+   enabled. */
+void
+profile_print_stats (void)
+{
+  uint64_t i, first;
+
+  if (!profile_enabled)
+    return;
+
+  first = sample_cnt > PROFILE_SAMPLES ? sample_cnt - PROFILE_SAMPLES : 0;
+  printf ("Profile: %"PRIu64" samples, %"PRIu64" kept\n",
+          sample_cnt, sample_cnt - first);
+  pmc_print_stats ();
+  for (i = first; i < sample_cnt; i++)
+    {
+      const struct sample *s = &samples[i % PROFILE_SAMPLES];
+      int j;
+
+      printf ("Profile sample:");
+      for (j = 0; j < PROFILE_DEPTH && s->pcs[j] != NULL; j++)
+        printf (" %p", s->pcs[j]);
+      printf ("\n");
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef THREADS_PROFILE_H
+#define THREADS_PROFILE_H
+
+#include <stdbool.h>
+#include "threads/interrupt.h"
+
+/* Sampling profiler.
+
+   With the "-prof" kernel option, every timer tick records where
+   the CPU was: the interrupted EIP and, if it was in the kernel,
+   the return addresses of up to PROFILE_DEPTH - 1 of its callers,
+   found by following the chain of saved frame pointers.  The most
+   recent PROFILE_SAMPLES samples are kept and printed at
+   shutdown, one "Profile sample:" line each, for the
+   "utils/profile" program to turn into a flat profile and call
+   graph.
+
+   With "-prof=EVENT[:PERIOD]", a hardware performance counter
+   takes the samples instead, one every PERIOD occurrences of
+   EVENT, if the CPU can count it (see pmc.c).  Otherwise the
+   timer still does. */
+
+/* Number of samples kept. */
+#define PROFILE_SAMPLES 1024
+
+/* Maximum number of addresses in one sample. */
+#define PROFILE_DEPTH 8
+
+extern bool profile_enabled;
+extern const char *profile_event;
+
+void profile_init (void);
+void profile_tick (const struct intr_frame *);
+void profile_sample (const struct intr_frame *);
+void profile_print_stats (void);
+
+#endif /* threads/profile.h */
@@ -0,0 +1,119 @@
+#include "threads/scratch.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Scratch memory is a chain of pages from the kernel pool, each
+   beginning with a header that points to the page before it.
+   Allocations are carved from the newest page; one that doesn't
+   fit starts a new page. */
+
+/* Header at the start of each scratch page. */
+struct scratch_page
+  {
+    struct scratch_page *prev;  /* Previous page, or null. */
+  };
+
+/* Alignment of scratch allocations, and the offset of the first
+   one in each page. */
+#define SCRATCH_ALIGN 8
+#define SCRATCH_START ROUND_UP (sizeof (struct scratch_page), SCRATCH_ALIGN)
+
+/* Returns the current position in the running thread's scratch
+   memory, to be passed to scratch_end() to free everything
+   allocated after it. */
+struct scratch_mark
+scratch_begin (void)
+{
+  ASSERT (!intr_context ());
+  return thread_current ()->scratch;
+}
+
+/* Allocates SIZE bytes of scratch memory and returns it, or a
+   null pointer if SIZE is more than a page minus the header or
+   no page is available.  The memory lasts until the enclosing
+   scratch_end(). */
+void *
+scratch_alloc (size_t size)
+{
+  struct scratch_mark *m = &thread_current ()->scratch;
+  void *block;
+
+  ASSERT (!intr_context ());
+
+  size = ROUND_UP (size, SCRATCH_ALIGN);
+  if (size > PGSIZE - SCRATCH_START)
+    return NULL;
+
+  if (m->page == NULL || m->used + size > PGSIZE)
+    {
+      struct scratch_page *p = palloc_get_page (0);
+      if (p == NULL)
+        return NULL;
+      p->prev = m->page;
+      m->page = p;
+      m->used = SCRATCH_START;
+    }
+
+  block = (uint8_t *) m->page + m->used;
+  m->used += size;
+  return block;
+}
+
+/* Copies string S into scratch memory and returns the copy, or
+   a null pointer if it doesn't fit. */
+char *
+scratch_strdup (const char *s)
+{
+  size_t size = strlen (s) + 1;
+  char *copy = scratch_alloc (size);
+  if (copy != NULL)
+    memcpy (copy, s, size);
+  return copy;
+}
+
+/* Frees all the scratch memory allocated since MARK was returned
+   by scratch_begin().  The thread's first page is kept for
+   reuse. */
+void
+scratch_end (struct scratch_mark mark)
+{
+  struct scratch_mark *m = &thread_current ()->scratch;
+
+  while (m->page != mark.page)
+    {
+      struct scratch_page *p = m->page;
+
+      ASSERT (p != NULL);
+      if (p->prev == NULL && mark.page == NULL)
+        {
+          m->used = SCRATCH_START;
+          return;
+        }
+      m->page = p->prev;
+      palloc_free_page (p);
+    }
+  ASSERT (mark.used <= m->used);
+  m->used = mark.used;
+}
+
+/* Frees the running thread's scratch pages.  Called by
+   thread_exit(). */
+void
+scratch_thread_exit (void)
+{
+  struct scratch_mark *m = &thread_current ()->scratch;
+
+  while (m->page != NULL)
+    {
+      struct scratch_page *p = m->page;
+      m->page = p->prev;
+      palloc_free_page (p);
+    }
+  m->used = 0;
+}
@@ -0,0 +1,35 @@
+#ifndef THREADS_SCRATCH_H
+#define THREADS_SCRATCH_H
+
+#include <stddef.h>
+
+/* Scratch memory.
+
+   Each thread has a stack of scratch memory for short-lived
+   allocations that are all freed together.  scratch_begin()
+   returns a mark, scratch_alloc() bumps a pointer, and
+   scratch_end() frees everything allocated since the mark:
+
+        struct scratch_mark mark = scratch_begin ();
+        char *copy = scratch_strdup (path);
+        ...
+        scratch_end (mark);
+
+   Scopes nest, but must end in the reverse order they began.
+   A thread's first scratch page is kept from one scope to the
+   next and freed when the thread exits. */
+
+/* A position in a thread's scratch memory. */
+struct scratch_mark
+  {
+    void *page;                 /* Current page, or null. */
+    size_t used;                /* Bytes used in PAGE. */
+  };
+
+struct scratch_mark scratch_begin (void);
+void *scratch_alloc (size_t);
+char *scratch_strdup (const char *);
+void scratch_end (struct scratch_mark);
+void scratch_thread_exit (void);
+
+#endif /* threads/scratch.h */
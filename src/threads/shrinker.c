@@ -0,0 +1,145 @@
+#include "threads/shrinker.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/kmem.h"
+#include "threads/palloc.h"
+#include "threads/workqueue.h"
+
+/* Memory-pressure callbacks.
+
+   Kernel caches that hold memory only to go faster register a
+   shrinker, which the page allocator calls on to get memory back
+   when the kernel pool runs short, in two ways.  An allocation
+   that would fail calls shrinker_reclaim() itself and tries
+   again.  And whenever a kernel allocation leaves the pool below
+   its low watermark, palloc calls shrinker_wake(), which queues
+   work on system_wq that shrinks the caches until the pool is
+   back above its high watermark, so that allocations seldom have
+   to reclaim memory of their own.
+
+   Shrinkers run most recently registered first, and the object
+   caches' free slabs are given back last of all, since objects
+   that other caches free only become free pages once the slabs
+   holding them are empty.
+
+   A shrinker may be called from any allocation, with any lock
+   held, so it must not wait for a lock: whatever it can't lock
+   with lock_try_acquire() it leaves alone.  Shrinkers are
+   registered during initialization, before any can be
+   running. */
+
+/* Most pages the reclaim worker asks for in one pass. */
+#define RECLAIM_BATCH 16
+
+/* Registered shrinkers, most recent first. */
+static struct list shrinkers = LIST_INITIALIZER (shrinkers);
+
+/* Reclaims memory on system_wq, once shrinker_start() has been
+   called. */
+static struct work reclaim_work;
+static bool started;
+
+/* Statistics.  Like those in vm/page.c, these are updated
+   without locking, so they may miss a few events. */
+static uint64_t reclaim_cnt;    /* Calls to shrinker_reclaim(). */
+static uint64_t wake_cnt;       /* Runs of the reclaim worker. */
+static uint64_t slab_cnt;       /* Free slabs given back. */
+
+static void reclaim_work_func (void *aux);
+
+/* Registers S, named NAME, to call SHRINK when the kernel pool
+   runs short. */
+void
+shrinker_register (struct shrinker *s, const char *name, shrink_func *shrink)
+{
+  ASSERT (shrink != NULL);
+
+  s->name = name;
+  s->shrink = shrink;
+  s->call_cnt = s->freed_cnt = 0;
+  list_push_front (&shrinkers, &s->elem);
+}
+
+/* Lets the page allocator start the reclaim worker.  Must be
+   called after workqueue_start(). */
+void
+shrinker_start (void)
+{
+  work_init (&reclaim_work, reclaim_work_func, NULL);
+  started = true;
+}
+
+/* Asks the registered caches to free PAGE_CNT pages, and returns
+   the number of pages they gave back.  Does nothing in an
+   interrupt handler, which can't take locks at all. */
+size_t
+shrinker_reclaim (size_t page_cnt)
+{
+  struct list_elem *e;
+  size_t freed = 0;
+  size_t slabs;
+
+  if (intr_context ())
+    return 0;
+
+  reclaim_cnt++;
+  for (e = list_begin (&shrinkers); e != list_end (&shrinkers)
+         && freed < page_cnt; e = list_next (e))
+    {
+      struct shrinker *s = list_entry (e, struct shrinker, elem);
+      size_t n = s->shrink (page_cnt - freed);
+
+      s->call_cnt++;
+      s->freed_cnt += n;
+      freed += n;
+    }
+  if (freed < page_cnt)
+    {
+      slabs = kmem_shrink (page_cnt - freed);
+      slab_cnt += slabs;
+      freed += slabs;
+    }
+  return freed;
+}
+
+/* Has the reclaim worker shrink the caches until the kernel pool
+   is back above its high watermark.  May be called from an
+   interrupt handler. */
+void
+shrinker_wake (void)
+{
+  if (started)
+    work_queue (&system_wq, &reclaim_work);
+}
+
+/* Prints statistics for reclaim and for each shrinker. */
+void
+shrinker_print_stats (void)
+{
+  struct list_elem *e;
+
+  printf ("Reclaim: %"PRIu64" calls, %"PRIu64" in background, "
+          "%"PRIu64" free slabs given back\n",
+          reclaim_cnt, wake_cnt, slab_cnt);
+  for (e = list_begin (&shrinkers); e != list_end (&shrinkers);
+       e = list_next (e))
+    {
+      struct shrinker *s = list_entry (e, struct shrinker, elem);
+      printf ("Shrinker %s: %"PRIu64" calls, %"PRIu64" pages freed\n",
+              s->name, s->call_cnt, s->freed_cnt);
+    }
+}
+
+/* Work function for RECLAIM_WORK. */
+static void
+reclaim_work_func (void *aux UNUSED)
+{
+  size_t need;
+
+  wake_cnt++;
+  while ((need = palloc_kernel_shortfall ()) > 0)
+    if (shrinker_reclaim (need < RECLAIM_BATCH ? need : RECLAIM_BATCH) == 0)
+      break;
+}
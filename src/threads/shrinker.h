@@ -0,0 +1,32 @@
+#ifndef THREADS_SHRINKER_H
+#define THREADS_SHRINKER_H
+
+#include <list.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Frees about PAGE_CNT pages' worth of cached objects and
+   returns the number of pages that gave back to the page
+   allocator, as far as it can tell. */
+typedef size_t shrink_func (size_t page_cnt);
+
+/* A kernel cache that can give memory back when the kernel pool
+   runs short.  The owner embeds it in its own data. */
+struct shrinker
+  {
+    struct list_elem elem;      /* Element in list of shrinkers. */
+    const char *name;           /* Name, for statistics. */
+    shrink_func *shrink;        /* Callback. */
+    uint64_t call_cnt;          /* Number of calls to SHRINK. */
+    uint64_t freed_cnt;         /* Pages SHRINK reported freeing. */
+  };
+
+void shrinker_register (struct shrinker *, const char *name, shrink_func *);
+void shrinker_start (void);
+void shrinker_print_stats (void);
+
+/* For the page allocator. */
+size_t shrinker_reclaim (size_t page_cnt);
+void shrinker_wake (void);
+
+#endif /* threads/shrinker.h */
@@ -0,0 +1,226 @@
+#include "threads/smp.h"
+#include <debug.h>
+#include <packed.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/loader.h"
+#include "threads/vaddr.h"
+
+/* Multiprocessor detection, from the tables described in the
+   Intel MultiProcessor Specification, version 1.4 [MPS].
+
+   smp_init() finds the processors that the BIOS reports and
+   fills in cpus[], but the application processors are left
+   halted: the kernel still runs on the bootstrap processor
+   alone, so that interrupts off remains enough for mutual
+   exclusion.  What is here is the part of SMP bring-up that does
+   not change that: knowing which CPUs exist, struct cpu for
+   per-CPU data, one run queue per CPU in thread.c, and spin
+   locks in spinlock.h.
+
+   None of it starts an AP, sends an IPI, or programs a local
+   APIC, so it is scaffolding rather than SMP support, and
+   reading the MP tables is built in only with SMP_SCAFFOLD (see
+   Make.config).  Without it smp_init() records the bootstrap
+   processor alone. */
+
+struct cpu cpus[CPU_MAX];
+int cpu_cnt = 1;
+
+/* Bit I is set if cpus[I] is running the kernel. */
+uint32_t cpu_online_mask = 1;
+
+#ifdef SMP_SCAFFOLD
+
+/* MP floating pointer structure. */
+struct mp_float
+  {
+    char signature[4];          /* "_MP_". */
+    uint32_t config;            /* Physical address of config table. */
+    uint8_t length;             /* Length in 16-byte units, i.e. 1. */
+    uint8_t spec_rev;           /* Version of [MPS]. */
+    uint8_t checksum;           /* Makes all bytes sum to 0. */
+    uint8_t features[5];        /* Nonzero FEATURES[0]: default config. */
+  } PACKED;
+
+/* MP configuration table header. */
+struct mp_config
+  {
+    char signature[4];          /* "PCMP". */
+    uint16_t length;            /* Length of header and entries. */
+    uint8_t spec_rev;           /* Version of [MPS]. */
+    uint8_t checksum;           /* Makes all bytes sum to 0. */
+    char oem_id[8];
+    char product_id[12];
+    uint32_t oem_table;
+    uint16_t oem_table_size;
+    uint16_t entry_cnt;         /* Number of entries that follow. */
+    uint32_t lapic_addr;        /* Local APIC address. */
+    uint16_t ext_length;
+    uint8_t ext_checksum;
+    uint8_t reserved;
+  } PACKED;
+
+/* MP configuration table processor entry.  Every other kind of
+   entry is 8 bytes long. */
+#define MP_PROCESSOR 0
+struct mp_processor
+  {
+    uint8_t type;               /* MP_PROCESSOR. */
+    uint8_t apic_id;            /* Local APIC ID. */
+    uint8_t apic_version;
+    uint8_t flags;              /* MP_CPU_*. */
+    uint32_t signature;
+    uint32_t features;
+    uint32_t reserved[2];
+  } PACKED;
+
+#define MP_CPU_ENABLED 0x01     /* Usable. */
+#define MP_CPU_BSP 0x02         /* Bootstrap processor. */
+
+static void read_mp_tables (struct mp_float *);
+static struct mp_float *find_mp_float (void);
+static struct mp_float *scan_mp_float (uint32_t paddr, size_t size);
+static bool checksum_ok (const void *, size_t);
+static void add_cpu (uint8_t apic_id, bool bsp);
+#endif /* SMP_SCAFFOLD */
+
+/* Finds the processors described by the BIOS's MP tables, with
+   SMP_SCAFFOLD.  If there are none, or without SMP_SCAFFOLD,
+   assumes that the bootstrap processor is the only one. */
+void
+smp_init (void)
+{
+  cpus[0].bsp = cpus[0].online = true;
+#ifdef SMP_SCAFFOLD
+  {
+    struct mp_float *mpf = find_mp_float ();
+
+    if (mpf != NULL)
+      read_mp_tables (mpf);
+    printf ("%d CPU%s found, running on 1.\n",
+            cpu_cnt, cpu_cnt != 1 ? "s" : "");
+  }
+#endif
+}
+
+#ifdef SMP_SCAFFOLD
+
+/* Fills in cpus[] and cpu_cnt from the MP tables, starting at
+   MPF. */
+static void
+read_mp_tables (struct mp_float *mpf)
+{
+  struct mp_config *mpc;
+  uint8_t *p, *end;
+  int i;
+
+  if (mpf->features[0] != 0 || mpf->config == 0)
+    {
+      /* One of the default configurations, all of which have two
+         processors with APIC IDs 0 and 1. */
+      add_cpu (1, false);
+      return;
+    }
+  if (mpf->config >= init_ram_pages * PGSIZE)
+    return;
+  mpc = ptov (mpf->config);
+  if (memcmp (mpc->signature, "PCMP", 4)
+      || mpf->config + mpc->length > init_ram_pages * PGSIZE
+      || !checksum_ok (mpc, mpc->length))
+    return;
+
+  cpu_cnt = 0;
+  p = (uint8_t *) (mpc + 1);
+  end = (uint8_t *) mpc + mpc->length;
+  for (i = 0; i < mpc->entry_cnt && p < end; i++)
+    if (*p == MP_PROCESSOR)
+      {
+        struct mp_processor *proc = (struct mp_processor *) p;
+        if (proc->flags & MP_CPU_ENABLED)
+          add_cpu (proc->apic_id, (proc->flags & MP_CPU_BSP) != 0);
+        p += sizeof *proc;
+      }
+    else
+      p += 8;
+  if (cpu_cnt == 0)
+    cpu_cnt = 1;
+  cpus[0].bsp = cpus[0].online = true;
+}
+
+/* Adds a CPU with the given local APIC ID to cpus[], putting the
+   bootstrap processor first. */
+static void
+add_cpu (uint8_t apic_id, bool bsp)
+{
+  struct cpu *c;
+
+  if (bsp)
+    {
+      /* Move whichever CPU came first out of the BSP's slot. */
+      if (cpu_cnt > 0 && cpu_cnt < CPU_MAX)
+        {
+          cpus[cpu_cnt] = cpus[0];
+          cpus[cpu_cnt].id = cpu_cnt;
+        }
+      if (cpu_cnt < CPU_MAX)
+        cpu_cnt++;
+      c = &cpus[0];
+    }
+  else if (cpu_cnt < CPU_MAX)
+    c = &cpus[cpu_cnt++];
+  else
+    return;
+  c->id = c - cpus;
+  c->apic_id = apic_id;
+  c->bsp = bsp;
+  c->online = false;
+}
+
+/* Returns the MP floating pointer structure, or a null pointer
+   if there is none.  [MPS] 4.1 lists where it may be: in the
+   first kB of the extended BIOS data area, in the last kB of
+   base memory, or in the BIOS ROM. */
+static struct mp_float *
+find_mp_float (void)
+{
+  uint16_t ebda_seg = *(uint16_t *) ptov (0x40e);
+  uint16_t base_kb = *(uint16_t *) ptov (0x413);
+  struct mp_float *mpf;
+
+  if (ebda_seg != 0
+      && (mpf = scan_mp_float ((uint32_t) ebda_seg << 4, 1024)) != NULL)
+    return mpf;
+  if (base_kb != 0
+      && (mpf = scan_mp_float ((uint32_t) base_kb * 1024 - 1024, 1024))
+         != NULL)
+    return mpf;
+  return scan_mp_float (0xf0000, 0x10000);
+}
+
+/* Looks for the MP floating pointer structure in the SIZE bytes
+   of physical memory starting at PADDR. */
+static struct mp_float *
+scan_mp_float (uint32_t paddr, size_t size)
+{
+  uint8_t *p = ptov (paddr);
+  uint8_t *end = p + size;
+
+  for (; p + sizeof (struct mp_float) <= end; p += 16)
+    if (!memcmp (p, "_MP_", 4) && checksum_ok (p, sizeof (struct mp_float)))
+      return (struct mp_float *) p;
+  return NULL;
+}
+
+/* Returns true if the SIZE bytes at P sum to 0, modulo 256. */
+static bool
+checksum_ok (const void *p_, size_t size)
+{
+  const uint8_t *p = p_;
+  uint8_t sum = 0;
+
+  while (size-- > 0)
+    sum += *p++;
+  return sum == 0;
+}
+#endif /* SMP_SCAFFOLD */
@@ -0,0 +1,37 @@
+#ifndef THREADS_SMP_H
+#define THREADS_SMP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Most CPUs the kernel keeps track of. */
+#define CPU_MAX 8
+
+/* Per-CPU data. */
+struct cpu
+  {
+    int id;                     /* Index in cpus[]. */
+    uint8_t apic_id;            /* Local APIC ID. */
+    bool bsp;                   /* Bootstrap processor? */
+    bool online;                /* Running the kernel? */
+  };
+
+/* Mask with a bit for every CPU. */
+#define CPU_MASK_ALL ((1u << CPU_MAX) - 1)
+
+extern struct cpu cpus[CPU_MAX];
+extern int cpu_cnt;
+extern uint32_t cpu_online_mask;
+
+void smp_init (void);
+
+/* Returns the CPU that is running the caller.  Only the
+   bootstrap processor runs the kernel so far, so this is always
+   the first CPU. */
+static inline struct cpu *
+cpu_current (void)
+{
+  return &cpus[0];
+}
+
+#endif /* threads/smp.h */
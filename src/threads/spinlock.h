@@ -0,0 +1,72 @@
+#ifndef THREADS_SPINLOCK_H
+#define THREADS_SPINLOCK_H
+
+#include <debug.h>
+#include <stdbool.h>
+#include "threads/interrupt.h"
+
+/* Spin lock.
+
+   Unlike a struct lock, a spin lock never sleeps, so it may be
+   taken in an interrupt handler, and it keeps interrupts off
+   while held, so that an interrupt on the same CPU cannot try
+   to take it again.  It is meant for data shared between CPUs
+   that is held for only a few instructions.  With one CPU
+   running, the atomic exchange always succeeds at once. */
+struct spinlock
+  {
+    volatile int locked;        /* 1 if held, 0 if free. */
+    enum intr_level old_level;  /* Interrupt level to restore. */
+  };
+
+/* Initializer for a static spin lock. */
+#define SPINLOCK_INITIALIZER { 0, INTR_OFF }
+
+static inline void
+spinlock_init (struct spinlock *s)
+{
+  s->locked = 0;
+}
+
+/* Turns interrupts off and acquires S, spinning until it is
+   free. */
+static inline void
+spinlock_acquire (struct spinlock *s)
+{
+  enum intr_level old_level = intr_disable ();
+  int held = 1;
+
+  for (;;)
+    {
+      asm volatile ("xchgl %0, %1"
+                    : "+r" (held), "+m" (s->locked) : : "memory");
+      if (!held)
+        break;
+      while (s->locked)
+        asm volatile ("pause");
+      held = 1;
+    }
+  s->old_level = old_level;
+}
+
+/* Releases S, which must be held by this CPU, and restores the
+   interrupt level from before spinlock_acquire(). */
+static inline void
+spinlock_release (struct spinlock *s)
+{
+  enum intr_level old_level = s->old_level;
+
+  ASSERT (s->locked);
+
+  asm volatile ("movl $0, %0" : "=m" (s->locked) : : "memory");
+  intr_set_level (old_level);
+}
+
+/* Returns true if S is held by some CPU. */
+static inline bool
+spinlock_held (const struct spinlock *s)
+{
+  return s->locked != 0;
+}
+
+#endif /* threads/spinlock.h */
@@ -27,10 +27,29 @@
 */
 
 #include "threads/synch.h"
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
+#include "devices/timer.h"
+
+static void up (struct semaphore *, bool io);
+static bool acquire (struct lock *, bool timed, int64_t ticks);
+static void donate_priority (struct thread *, struct lock *);
+static void lock_spin (struct lock *);
+static heap_less_func sema_waiter_less;
+static heap_less_func cond_waiter_less;
+struct semaphore_elem;
+static void wait_morph (struct semaphore_elem *, struct lock *);
+
+/* Locks registered with lock_register(). */
+static struct list named_locks = LIST_INITIALIZER (named_locks);
+
+/* Counts arrivals in waiter queues, so that threads of equal
+   priority are woken first-come, first-served. */
+static uint64_t wait_seq;
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -47,7 +66,8 @@ sema_init (struct semaphore *sema, unsigned value)
   ASSERT (sema != NULL);
 
   sema->value = value;
-  list_init (&sema->waiters);
+  heap_init (&sema->waiters, sema_waiter_less, NULL);
+  sema->owner = NULL;
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -68,13 +88,180 @@ sema_down (struct semaphore *sema)
   old_level = intr_disable ();
   while (sema->value == 0) 
     {
-      list_insert_ordered (&sema->waiters, &thread_current ()->elem, priority_compare, NULL);
+      struct thread *t = thread_current ();
+      struct lock *owner = sema->owner;
+
+      t->wait_seq = wait_seq++;
+      heap_push (&sema->waiters, &t->wait_elem);
+      if (t->wait_queue == NULL)
+        {
+          t->wait_queue = &sema->waiters;
+          t->wait_queue_elem = &t->wait_elem;
+        }
+      if (owner != NULL)
+        {
+          t->lock_waiting = owner;
+          donate_priority (t, owner);
+        }
       thread_block ();
+      if (owner != NULL)
+        t->lock_waiting = NULL;
     }
   sema->value--;
   intr_set_level (old_level);
 }
 
+/* Down or "P" operation on a semaphore, waiting no more than
+   TICKS timer ticks for SEMA's value to become positive.  Returns
+   true if SEMA was decremented, false if the time ran out first.
+   A thread waiting here is also on the timer's sleep wheel, and
+   whichever of sema_up() and the timer comes first takes it off
+   the other, so it wakes up exactly once.
+
+   Like sema_down(), this function may sleep, so it must not be
+   called within an interrupt handler. */
+bool
+sema_down_timeout (struct semaphore *sema, int64_t ticks)
+{
+  struct thread *t = thread_current ();
+  enum intr_level old_level;
+  int64_t deadline;
+  bool success = true;
+
+  ASSERT (sema != NULL);
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  deadline = timer_ticks () + ticks;
+  while (sema->value == 0)
+    {
+      struct lock *owner = sema->owner;
+
+      if (timer_ticks () >= deadline)
+        {
+          success = false;
+          break;
+        }
+      t->wait_seq = wait_seq++;
+      heap_push (&sema->waiters, &t->wait_elem);
+      if (t->wait_queue == NULL)
+        {
+          t->wait_queue = &sema->waiters;
+          t->wait_queue_elem = &t->wait_elem;
+        }
+      if (owner != NULL)
+        {
+          t->lock_waiting = owner;
+          donate_priority (t, owner);
+        }
+      t->timed_sema = sema;
+      t->timed_out = false;
+      thread_sleep (deadline);
+      if (owner != NULL)
+        t->lock_waiting = NULL;
+      if (t->timed_out)
+        {
+          success = false;
+          break;
+        }
+    }
+  if (success)
+    sema->value--;
+  intr_set_level (old_level);
+  return success;
+}
+
+/* Down or "P" operation on a semaphore, like sema_down(), but
+   gives up once *STOP is true and returns false without
+   decrementing SEMA.  Returns true if SEMA was decremented.
+   Whoever sets *STOP must then call sema_interrupt() for each
+   thread that may be waiting here, since nothing else wakes it.
+
+   Like sema_down(), this function may sleep, so it must not be
+   called within an interrupt handler. */
+bool
+sema_down_intr (struct semaphore *sema, const volatile bool *stop)
+{
+  struct thread *t = thread_current ();
+  enum intr_level old_level;
+  bool success = true;
+
+  ASSERT (sema != NULL);
+  ASSERT (stop != NULL);
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  while (sema->value == 0)
+    {
+      struct lock *owner = sema->owner;
+
+      if (*stop)
+        {
+          success = false;
+          break;
+        }
+      t->wait_seq = wait_seq++;
+      heap_push (&sema->waiters, &t->wait_elem);
+      if (t->wait_queue == NULL)
+        {
+          t->wait_queue = &sema->waiters;
+          t->wait_queue_elem = &t->wait_elem;
+        }
+      if (owner != NULL)
+        {
+          t->lock_waiting = owner;
+          donate_priority (t, owner);
+        }
+      t->intr_sema = sema;
+      thread_block ();
+      if (owner != NULL)
+        t->lock_waiting = NULL;
+    }
+  if (success)
+    sema->value--;
+  intr_set_level (old_level);
+  return success;
+}
+
+/* Wakes T if it is blocked in sema_down_intr(), taking it out of
+   its semaphore's waiters, so that it looks at its STOP flag
+   again.  Does nothing if T is not waiting there, including if
+   sema_up() has already woken it. */
+void
+sema_interrupt (struct thread *t)
+{
+  enum intr_level old_level = intr_disable ();
+  struct semaphore *sema = t->intr_sema;
+
+  if (sema != NULL)
+    {
+      heap_remove (&sema->waiters, &t->wait_elem);
+      if (t->wait_queue == &sema->waiters)
+        t->wait_queue = NULL;
+      t->intr_sema = NULL;
+      thread_unblock (t);
+    }
+  intr_set_level (old_level);
+}
+
+/* Takes T, whose sema_down_timeout() has run out of time, out of
+   its semaphore's waiters.  Called by thread_wakeup() just before
+   it unblocks T.  Interrupts must be off. */
+void
+sema_timed_out (struct thread *t)
+{
+  struct semaphore *sema = t->timed_sema;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (sema != NULL);
+
+  heap_remove (&sema->waiters, &t->wait_elem);
+  if (t->wait_queue == &sema->waiters)
+    t->wait_queue = NULL;
+  t->timed_sema = NULL;
+  t->timed_out = true;
+}
+
 /* Down or "P" operation on a semaphore, but only if the
    semaphore is not already 0.  Returns true if the semaphore is
    decremented, false otherwise.
@@ -107,6 +294,22 @@ sema_try_down (struct semaphore *sema)
    This function may be called from an interrupt handler. */
 void
 sema_up (struct semaphore *sema) 
+{
+  up (sema, false);
+}
+
+/* Ups SEMA like sema_up(), for a semaphore that signals that I/O
+   has completed, so that the thread woken gets a priority boost
+   from thread_unblock_io(). */
+void
+sema_up_io (struct semaphore *sema)
+{
+  up (sema, true);
+}
+
+/* Ups SEMA for sema_up() or, if IO, sema_up_io(). */
+static void
+up (struct semaphore *sema, bool io)
 {
   enum intr_level old_level;
   bool yield_condition = false;
@@ -114,12 +317,24 @@ sema_up (struct semaphore *sema)
   ASSERT (sema != NULL);
 
   old_level = intr_disable ();
-  if (!list_empty (&sema->waiters)) 
+  if (!heap_empty (&sema->waiters)) 
   {
-    list_sort (&sema->waiters, priority_compare, NULL);
-    unblocked = list_entry (list_pop_front (&sema->waiters), struct thread, elem);
-    thread_unblock (unblocked);
-  if( unblocked->priority > thread_current() ->priority )
+    unblocked = heap_entry (heap_pop (&sema->waiters), struct thread,
+                            wait_elem);
+    if (unblocked->wait_queue == &sema->waiters)
+      unblocked->wait_queue = NULL;
+    if (unblocked->timed_sema != NULL)
+      {
+        /* Take it off the sleep wheel. */
+        list_remove (&unblocked->elem);
+        unblocked->timed_sema = NULL;
+      }
+    unblocked->intr_sema = NULL;
+    if (io)
+      thread_unblock_io (unblocked);
+    else
+      thread_unblock (unblocked);
+  if( thread_preempts(unblocked) )
         yield_condition = true;
   }
 
@@ -132,6 +347,59 @@ sema_up (struct semaphore *sema)
           intr_yield_on_return();
 }
 
+/* Names the running thread as the one that will up SEMA, which
+   some other thread waits on for an event, such as a child
+   process loading or exiting, so that threads waiting for SEMA
+   donate their priority to it just as they would to the holder
+   of a lock.  Donations are carried by HINT, a lock that is never
+   acquired, which must stay in place until sema_disown().
+   Threads already waiting donate right away.
+
+   Donations stay with the running thread until it calls
+   sema_disown(), which it must do before it ups SEMA for the
+   event, and before it exits. */
+void
+sema_own (struct semaphore *sema, struct lock *hint)
+{
+  struct thread *t = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (sema != NULL);
+  ASSERT (hint != NULL);
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  ASSERT (sema->owner == NULL);
+  lock_init (hint);
+  hint->holder = t;
+  hint->max_priority = PRI_MIN;
+  thread_add_lock (hint);
+  sema->owner = hint;
+  if (!heap_empty (&sema->waiters))
+    donate_priority (heap_entry (heap_top (&sema->waiters), struct thread,
+                                 wait_elem), hint);
+  intr_set_level (old_level);
+}
+
+/* Gives up the running thread's ownership of SEMA, set by
+   sema_own(), along with the priority donated through it. */
+void
+sema_disown (struct semaphore *sema)
+{
+  struct lock *hint;
+  enum intr_level old_level;
+
+  ASSERT (sema != NULL);
+
+  old_level = intr_disable ();
+  hint = sema->owner;
+  ASSERT (hint != NULL && hint->holder == thread_current ());
+  sema->owner = NULL;
+  hint->holder = NULL;
+  thread_remove_lock (hint);
+  intr_set_level (old_level);
+}
+
 static void sema_test_helper (void *sema_);
 
 /* Self-test for semaphores that makes control "ping-pong"
@@ -191,6 +459,60 @@ lock_init (struct lock *lock)
 
   lock->holder = NULL;
   sema_init (&lock->semaphore, 1);
+  lock->spin_cnt = 0;
+  lock->name = NULL;
+}
+
+/* Makes lock_acquire() yield to LOCK's holder up to SPIN_CNT
+   times, as long as the holder is ready to run ahead of the
+   caller, before blocking on LOCK.  Worthwhile for locks held
+   only briefly, where the holder usually releases the lock as
+   soon as it runs again; blocking would add a trip through the
+   lock's waiters and priority donation.  Spinning proper would
+   never help here, because on one CPU a holder that is not
+   running cannot release the lock.  The default is 0. */
+void
+lock_set_spin (struct lock *lock, unsigned spin_cnt)
+{
+  ASSERT (lock != NULL);
+
+  lock->spin_cnt = spin_cnt;
+}
+
+/* Names LOCK, which must be initialized and never be destroyed,
+   and starts keeping contention statistics for it, to be
+   reported by lock_print_stats(). */
+void
+lock_register (struct lock *lock, const char *name)
+{
+  enum intr_level old_level;
+
+  ASSERT (lock != NULL);
+  ASSERT (name != NULL);
+  ASSERT (lock->name == NULL);
+
+  memset (&lock->stats, 0, sizeof lock->stats);
+  old_level = intr_disable ();
+  lock->name = name;
+  list_push_back (&named_locks, &lock->stats_elem);
+  intr_set_level (old_level);
+}
+
+/* Prints contention statistics for each registered lock. */
+void
+lock_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&named_locks); e != list_end (&named_locks);
+       e = list_next (e))
+    {
+      struct lock *l = list_entry (e, struct lock, stats_elem);
+      printf ("Lock %s: %u acquisitions, %u contended, "
+              "%"PRId64" wait ticks, %"PRId64" max hold ticks\n",
+              l->name, l->stats.acquire_cnt, l->stats.contend_cnt,
+              l->stats.wait_ticks, l->stats.max_hold_ticks);
+    }
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -204,32 +526,56 @@ lock_init (struct lock *lock)
 
 void
 lock_acquire (struct lock *lock)
+{
+  acquire (lock, false, 0);
+}
+
+/* Acquires LOCK like lock_acquire(), but waits no more than
+   TICKS timer ticks for it.  Returns true if successful, false if
+   the time ran out.  Priority donated to the holder while waiting
+   stays with it until it releases LOCK. */
+bool
+lock_acquire_timeout (struct lock *lock, int64_t ticks)
+{
+  return acquire (lock, true, ticks);
+}
+
+/* Acquires LOCK for lock_acquire() or, if TIMED, for
+   lock_acquire_timeout() with a limit of TICKS. */
+static bool
+acquire (struct lock *lock, bool timed, int64_t ticks)
 {
   struct thread *t = thread_current ();
-  struct lock *l;
-  int depth = 0;
   enum intr_level old_level;
+  bool contended = false;
+  int64_t start = 0;
 
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
+  TRACE_EVENT (LOCK_ACQUIRE, lock,
+               lock->holder != NULL ? lock->holder->tid : 0);
+  if (lock->holder != NULL)
+  {
+      contended = true;
+      if (lock->name != NULL)
+        start = timer_ticks ();
+      lock_spin (lock);
+  }
   if (lock->holder != NULL)
   {
       t->lock_waiting = lock;
-      l = lock;
-      
-	  /* For nested priority donation. */
-      while (l && t->priority > l->max_priority
-             && depth++ < PRIDON_MAX_DEPTH)
-      {
-          l->max_priority = t->priority;
-          priority_donate (l->holder);
-          l = l->holder->lock_waiting;
-      }
+      donate_priority (t, lock);
   }
 
-  sema_down (&lock->semaphore);
+  if (!timed)
+    sema_down (&lock->semaphore);
+  else if (!sema_down_timeout (&lock->semaphore, ticks))
+    {
+      t->lock_waiting = NULL;
+      return false;
+    }
 
   old_level = intr_disable ();
   
@@ -238,8 +584,20 @@ lock_acquire (struct lock *lock)
   lock->max_priority = t->priority;
   thread_add_lock (lock);
   lock->holder = t;
+  if (lock->name != NULL)
+    {
+      lock->stats.acquire_time = timer_ticks ();
+      lock->stats.acquire_cnt++;
+      if (contended)
+        {
+          lock->stats.contend_cnt++;
+          lock->stats.wait_ticks += lock->stats.acquire_time - start;
+        }
+    }
+  TRACE_EVENT (LOCK_ACQUIRED, lock, 0);
   
   intr_set_level (old_level);
+  return true;
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -258,7 +616,21 @@ lock_try_acquire (struct lock *lock)
 
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    {
+      /* Held locks must be on the holder's list, which
+         lock_release() removes them from. */
+      enum intr_level old_level = intr_disable ();
+      lock->max_priority = thread_current ()->priority;
+      thread_add_lock (lock);
+      lock->holder = thread_current ();
+      if (lock->name != NULL)
+        {
+          lock->stats.acquire_time = timer_ticks ();
+          lock->stats.acquire_cnt++;
+        }
+      TRACE_EVENT (LOCK_ACQUIRED, lock, 0);
+      intr_set_level (old_level);
+    }
   return success;
 }
 
@@ -279,6 +651,13 @@ lock_release (struct lock *lock)
 
   old_level = intr_disable ();
 
+  TRACE_EVENT (LOCK_RELEASE, lock, 0);
+  if (lock->name != NULL)
+    {
+      int64_t held = timer_ticks () - lock->stats.acquire_time;
+      if (held > lock->stats.max_hold_ticks)
+        lock->stats.max_hold_ticks = held;
+    }
   thread_remove_lock (lock);
 
   lock->holder = NULL;
@@ -298,23 +677,111 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
-bool
-lock_priority_compare (const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
+/* Yields to the holder of LOCK, up to LOCK's spin count times,
+   while that holder is ready to run before the current thread
+   gets the CPU back. */
+static void
+lock_spin (struct lock *lock)
 {
-  struct lock *la = list_entry (a, struct lock, elem);
-  struct lock *lb = list_entry (b, struct lock, elem);
-  
-  return la->max_priority > lb->max_priority;
+  struct thread *t = thread_current ();
+  unsigned i;
+
+  for (i = 0; i < lock->spin_cnt; i++)
+    {
+      enum intr_level old_level = intr_disable ();
+      struct thread *holder = lock->holder;
+      bool runnable = (holder != NULL && holder->status == THREAD_READY
+                       && holder->priority >= t->priority);
+      intr_set_level (old_level);
+
+      if (!runnable)
+        break;
+      thread_yield ();
+    }
+}
+
+/* Donates T's priority to the holder of L, which T is about to
+   wait for, and on down the chain of locks that holder is
+   itself waiting for, up to PRIDON_MAX_DEPTH levels. */
+static void
+donate_priority (struct thread *t, struct lock *l)
+{
+  enum intr_level old_level;
+  int depth = 0;
+
+  if (thread_mlfqs)
+    return;
+
+  old_level = intr_disable ();
+  while (l != NULL && l->holder != NULL && t->priority > l->max_priority
+         && depth++ < PRIDON_MAX_DEPTH)
+    {
+      struct thread *holder = l->holder;
+      int old_priority = holder->priority;
+
+      l->max_priority = t->priority;
+      priority_donate (holder, l);
+
+      /* If the holder already ran at least this high, so does
+         everyone further down the chain. */
+      if (holder->priority == old_priority)
+        break;
+      l = holder->lock_waiting;
+    }
+  intr_set_level (old_level);
 }
 
 
-/* One semaphore in a list. */
+/* Repositions T, whose priority has just changed, in the
+   semaphore or condition variable waiters it is queued in, if
+   any.  Interrupts must be off. */
+void
+waiter_requeue (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->wait_queue != NULL)
+    heap_update (t->wait_queue, t->wait_queue_elem);
+}
+
+/* Orders semaphore waiters by priority, then arrival. */
+static bool
+sema_waiter_less (const struct heap_elem *a_, const struct heap_elem *b_,
+                  void *aux UNUSED)
+{
+  const struct thread *a = heap_entry (a_, struct thread, wait_elem);
+  const struct thread *b = heap_entry (b_, struct thread, wait_elem);
+
+  if (a->priority != b->priority)
+    return a->priority < b->priority;
+  return a->wait_seq > b->wait_seq;
+}
+
+/* One semaphore in a condition variable's waiters. */
 struct semaphore_elem 
   {
-    struct list_elem elem;              /* List element. */
+    struct heap_elem elem;              /* Heap element. */
     struct semaphore semaphore;         /* This semaphore. */
+    struct thread *thread;              /* Waiting thread. */
+    uint64_t seq;                       /* Arrival order. */
   };
 
+/* Orders condition variable waiters by priority, then
+   arrival. */
+static bool
+cond_waiter_less (const struct heap_elem *a_, const struct heap_elem *b_,
+                  void *aux UNUSED)
+{
+  const struct semaphore_elem *a = heap_entry (a_, struct semaphore_elem,
+                                               elem);
+  const struct semaphore_elem *b = heap_entry (b_, struct semaphore_elem,
+                                               elem);
+
+  if (a->thread->priority != b->thread->priority)
+    return a->thread->priority < b->thread->priority;
+  return a->seq > b->seq;
+}
+
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -323,7 +790,7 @@ cond_init (struct condition *cond)
 {
   ASSERT (cond != NULL);
 
-  list_init (&cond->waiters);
+  heap_init (&cond->waiters, cond_waiter_less, NULL);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -350,6 +817,7 @@ void
 cond_wait (struct condition *cond, struct lock *lock) 
 {
   struct semaphore_elem waiter;
+  enum intr_level old_level;
 
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
@@ -357,36 +825,147 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (lock_held_by_current_thread (lock));
   
   sema_init (&waiter.semaphore, 0);
-  list_insert_ordered (&cond->waiters, &waiter.elem, semaphore_priority_compare, NULL);
+  waiter.thread = thread_current ();
+
+  /* Donation may reposition us in COND's waiters at any time. */
+  old_level = intr_disable ();
+  waiter.seq = wait_seq++;
+  heap_push (&cond->waiters, &waiter.elem);
+  waiter.thread->wait_queue = &cond->waiters;
+  waiter.thread->wait_queue_elem = &waiter.elem;
+  intr_set_level (old_level);
+
   lock_release (lock);
   sema_down (&waiter.semaphore);
   lock_acquire (lock);
 }
 
+/* Like cond_wait(), but waits no more than TICKS timer ticks for
+   COND to be signaled.  Returns true if it was signaled, false if
+   the time ran out.  Either way, LOCK is held again on return,
+   which may take longer. */
+bool
+cond_wait_timeout (struct condition *cond, struct lock *lock,
+                   int64_t ticks)
+{
+  struct semaphore_elem waiter;
+  enum intr_level old_level;
+  bool signaled;
+
+  ASSERT (cond != NULL);
+  ASSERT (lock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (lock_held_by_current_thread (lock));
+  
+  sema_init (&waiter.semaphore, 0);
+  waiter.thread = thread_current ();
+
+  old_level = intr_disable ();
+  waiter.seq = wait_seq++;
+  heap_push (&cond->waiters, &waiter.elem);
+  waiter.thread->wait_queue = &cond->waiters;
+  waiter.thread->wait_queue_elem = &waiter.elem;
+  intr_set_level (old_level);
+
+  lock_release (lock);
+  signaled = sema_down_timeout (&waiter.semaphore, ticks);
+  if (!signaled)
+    {
+      /* A signal that came after the time ran out but before we
+         got here still counts; otherwise it would be lost. */
+      old_level = intr_disable ();
+      if (waiter.thread->wait_queue == &cond->waiters)
+        {
+          heap_remove (&cond->waiters, &waiter.elem);
+          waiter.thread->wait_queue = NULL;
+        }
+      else
+        signaled = true;
+      intr_set_level (old_level);
+    }
+  lock_acquire (lock);
+  return signaled;
+}
+
 /* If any threads are waiting on COND (protected by LOCK), then
    this function signals one of them to wake up from its wait.
    LOCK must be held before calling this function.
 
+   The thread signaled could not run anyway until LOCK is
+   released, so rather than waking it now only to have it block
+   again in lock_acquire(), this moves it straight into LOCK's
+   waiters, and lock_release() wakes it in turn.
+
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to signal a condition variable within an
    interrupt handler. */
 void
 cond_signal (struct condition *cond, struct lock *lock UNUSED) 
 {
+  struct semaphore_elem *waiter = NULL;
+  enum intr_level old_level;
+
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
 
-  if (!list_empty (&cond->waiters)) {
-	list_sort (&cond->waiters, semaphore_priority_compare, NULL);
-    sema_up (&list_entry (list_pop_front (&cond->waiters),
-                          struct semaphore_elem, elem)->semaphore);
-  }
+  old_level = intr_disable ();
+  if (!heap_empty (&cond->waiters))
+    {
+      waiter = heap_entry (heap_pop (&cond->waiters),
+                           struct semaphore_elem, elem);
+      waiter->thread->wait_queue = NULL;
+
+      /* A waiter that has not blocked yet just needs its
+         semaphore upped. */
+      if (!heap_empty (&waiter->semaphore.waiters))
+        {
+          wait_morph (waiter, lock);
+          waiter = NULL;
+        }
+    }
+  intr_set_level (old_level);
+
+  if (waiter != NULL)
+    sema_up (&waiter->semaphore);
+}
+
+/* Moves WAITER, blocked in cond_wait() on a condition protected
+   by LOCK, which the running thread holds, from its own
+   semaphore into LOCK's waiters, as if it had called
+   lock_acquire() and found LOCK held.  Its semaphore is upped
+   without waking it, so that when lock_release() does wake it,
+   it goes straight on to take LOCK.  Interrupts must be off. */
+static void
+wait_morph (struct semaphore_elem *waiter, struct lock *lock)
+{
+  struct thread *t = waiter->thread;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (lock->semaphore.value == 0);
+
+  heap_pop (&waiter->semaphore.waiters);
+  waiter->semaphore.value = 1;
+  if (t->timed_sema != NULL)
+    {
+      /* Signaled in time, by cond_wait_timeout()'s reckoning. */
+      list_remove (&t->elem);
+      t->timed_sema = NULL;
+    }
+
+  t->wait_seq = wait_seq++;
+  heap_push (&lock->semaphore.waiters, &t->wait_elem);
+  t->wait_queue = &lock->semaphore.waiters;
+  t->wait_queue_elem = &t->wait_elem;
+  t->lock_waiting = lock;
+  donate_priority (t, lock);
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
-   LOCK).  LOCK must be held before calling this function.
+   LOCK).  LOCK must be held before calling this function.  As with
+   cond_signal(), the threads are woken one at a time as LOCK is
+   released, not all at once.
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to signal a condition variable within an
@@ -397,28 +976,248 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
 
-  while (!list_empty (&cond->waiters))
+  while (!heap_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
 
+/* Initializes RW.  Any number of threads may hold a
+   reader-writer lock for reading at once, or a single thread may
+   hold it for writing.
+
+   Writers are preferred: a writer holds RW's inner lock from the
+   time it starts waiting, and new readers must pass through that
+   lock, so once a writer arrives no new reader gets in until the
+   writer is done.  Threads waiting for the inner lock donate
+   priority to the writer through lock_acquire(), and a writer
+   waiting for readers to leave donates its priority to each of
+   them.
+
+   Like locks, reader-writer locks are not recursive. */
+void
+rwlock_init (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_init (&rw->lock);
+  rw->readers = 0;
+  list_init (&rw->holds);
+  rw->writer_waiting = false;
+  sema_init (&rw->drained, 0);
+}
+
+/* Adds the current thread to RW's readers.  RW's inner lock must
+   be held. */
+static void
+start_read (struct rwlock *rw)
+{
+  struct thread *t = thread_current ();
+  enum intr_level old_level;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&rw->lock));
+
+  old_level = intr_disable ();
+  rw->readers++;
+  for (i = 0; i < RWLOCK_HOLD_CNT; i++)
+    {
+      struct rwlock_hold *h = &t->read_holds[i];
+      if (h->rwlock == NULL)
+        {
+          h->rwlock = rw;
+          lock_init (&h->lock);
+          h->lock.holder = t;
+          h->lock.max_priority = t->priority;
+          thread_add_lock (&h->lock);
+          list_push_back (&rw->holds, &h->elem);
+          break;
+        }
+    }
+  intr_set_level (old_level);
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or
+   waits for it.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rw->lock);
+  start_read (rw);
+  lock_release (&rw->lock);
+}
+
+/* Tries to acquire RW for reading without sleeping.  Returns true
+   if successful, false if a writer holds it or waits for it. */
 bool
-semaphore_priority_compare (const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
+rwlock_try_acquire_read (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  if (!lock_try_acquire (&rw->lock))
+    return false;
+  start_read (rw);
+  lock_release (&rw->lock);
+  return true;
+}
+
+/* Tries for up to TICKS timer ticks to acquire RW for reading.
+   Returns true if successful, false if the time ran out. */
+bool
+rwlock_acquire_read_timeout (struct rwlock *rw, int64_t ticks)
+{
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+
+  if (!lock_acquire_timeout (&rw->lock, ticks))
+    return false;
+  start_read (rw);
+  lock_release (&rw->lock);
+  return true;
+}
+
+/* Releases RW, which the current thread must hold for reading,
+   and wakes the waiting writer if this was the last reader. */
+void
+rwlock_release_read (struct rwlock *rw)
+{
+  struct thread *t = thread_current ();
+  enum intr_level old_level;
+  size_t i;
+
+  ASSERT (rw != NULL);
+  ASSERT (rw->readers > 0);
+
+  old_level = intr_disable ();
+  for (i = 0; i < RWLOCK_HOLD_CNT; i++)
+    {
+      struct rwlock_hold *h = &t->read_holds[i];
+      if (h->rwlock == rw)
+        {
+          list_remove (&h->elem);
+          h->rwlock = NULL;
+          thread_remove_lock (&h->lock);
+          break;
+        }
+    }
+  if (--rw->readers == 0 && rw->writer_waiting)
+    {
+      rw->writer_waiting = false;
+      sema_up (&rw->drained);
+    }
+  intr_set_level (old_level);
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it.  Priority is donated to the writer holding RW, or to the
+   readers holding it, in the same way as lock_acquire().
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw)
 {
-  struct semaphore_elem *sema_a = list_entry (a, struct semaphore_elem, elem);
-  struct semaphore_elem *sema_b = list_entry (b, struct semaphore_elem, elem);
-  struct list *waiters_a = &sema_a->semaphore.waiters;
-  struct list *waiters_b = &sema_b->semaphore.waiters;
+  struct thread *t = thread_current ();
+  enum intr_level old_level;
 
-  if (list_empty(waiters_a))
-	return false;
-  else if (list_empty(waiters_b))
-    return true;
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
 
-  list_sort(waiters_a, priority_compare, NULL);
-  list_sort(waiters_b, priority_compare, NULL);
+  lock_acquire (&rw->lock);
 
-  struct thread *thread_a = list_entry (list_front (waiters_a), struct thread, elem);
-  struct thread *thread_b = list_entry (list_front (waiters_b), struct thread, elem);
+  old_level = intr_disable ();
+  while (rw->readers > 0)
+    {
+      struct list_elem *e;
+
+      for (e = list_begin (&rw->holds); e != list_end (&rw->holds);
+           e = list_next (e))
+        donate_priority (t, &list_entry (e, struct rwlock_hold, elem)->lock);
+      rw->writer_waiting = true;
+      sema_down (&rw->drained);
+    }
+  intr_set_level (old_level);
+}
+
+/* Tries to acquire RW for writing without sleeping.  Returns true
+   if successful, false if any other thread holds it. */
+bool
+rwlock_try_acquire_write (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  if (!lock_try_acquire (&rw->lock))
+    return false;
+  if (rw->readers > 0)
+    {
+      lock_release (&rw->lock);
+      return false;
+    }
+  return true;
+}
+
+/* Tries for up to TICKS timer ticks to acquire RW for writing.
+   Returns true if successful, false if the time ran out.  While
+   it waits, it donates priority and holds off new readers the
+   same way as rwlock_acquire_write(). */
+bool
+rwlock_acquire_write_timeout (struct rwlock *rw, int64_t ticks)
+{
+  struct thread *t = thread_current ();
+  enum intr_level old_level;
+  int64_t deadline = timer_ticks () + ticks;
+  bool success = true;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+
+  if (!lock_acquire_timeout (&rw->lock, ticks))
+    return false;
+
+  old_level = intr_disable ();
+  while (rw->readers > 0)
+    {
+      struct list_elem *e;
+
+      for (e = list_begin (&rw->holds); e != list_end (&rw->holds);
+           e = list_next (e))
+        donate_priority (t, &list_entry (e, struct rwlock_hold, elem)->lock);
+      rw->writer_waiting = true;
+      if (!sema_down_timeout (&rw->drained, deadline - timer_ticks ()))
+        {
+          rw->writer_waiting = false;
+          success = false;
+          break;
+        }
+    }
+  intr_set_level (old_level);
+
+  if (!success)
+    lock_release (&rw->lock);
+  return success;
+}
+
+/* Releases RW, which the current thread must hold for
+   writing. */
+void
+rwlock_release_write (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (rw->readers == 0);
+
+  lock_release (&rw->lock);
+}
+
+/* Returns true if the current thread holds RW for writing, false
+   otherwise. */
+bool
+rwlock_write_held_by_current_thread (const struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
 
-  return thread_a->priority > thread_b->priority;
+  return lock_held_by_current_thread (&rw->lock);
 }
@@ -1,50 +1,121 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* A counting semaphore. */
 struct semaphore 
   {
     unsigned value;             /* Current value. */
-    struct list waiters;        /* List of waiting threads. */
+    struct heap waiters;        /* Waiting threads, highest priority first. */
+    struct lock *owner;         /* See sema_own(), or null. */
   };
 
 void sema_init (struct semaphore *, unsigned value);
 void sema_down (struct semaphore *);
+bool sema_down_timeout (struct semaphore *, int64_t ticks);
+bool sema_down_intr (struct semaphore *, const volatile bool *stop);
 bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
+void sema_up_io (struct semaphore *);
+void sema_own (struct semaphore *, struct lock *hint);
+void sema_disown (struct semaphore *);
 void sema_self_test (void);
 
+struct thread;
+void sema_timed_out (struct thread *);
+void sema_interrupt (struct thread *);
+
+/* Contention statistics for a named lock. */
+struct lock_stats
+  {
+    unsigned acquire_cnt;       /* Number of acquisitions. */
+    unsigned contend_cnt;       /* Acquisitions that had to wait. */
+    int64_t wait_ticks;         /* Total ticks spent waiting. */
+    int64_t max_hold_ticks;     /* Longest time held. */
+    int64_t acquire_time;       /* When last acquired. */
+  };
+
 /* Lock. */
 struct lock 
   {
     struct thread *holder;      /* Thread holding lock (for debugging). */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
-    struct list_elem elem;
-    int max_priority;
+    struct heap_elem elem;      /* Element in holder's LOCKS. */
+    int max_priority;           /* Highest priority donated through. */
+    unsigned spin_cnt;          /* See lock_set_spin(). */
+
+    /* Statistics, kept only once registered by lock_register(). */
+    const char *name;           /* Name, or null if unregistered. */
+    struct lock_stats stats;    /* Statistics. */
+    struct list_elem stats_elem; /* Element in list of named locks. */
   };
 
+/* Spin count for locks held for a few dozen instructions. */
+#define LOCK_SPIN_SHORT 2
+
 void lock_init (struct lock *);
+void lock_set_spin (struct lock *, unsigned spin_cnt);
+void lock_register (struct lock *, const char *name);
+void lock_print_stats (void);
 void lock_acquire (struct lock *);
+bool lock_acquire_timeout (struct lock *, int64_t ticks);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
-bool lock_priority_compare (const struct list_elem *a, const struct list_elem *b, void *aux);
 
 /* Condition variable. */
 struct condition 
   {
-    struct list waiters;        /* List of waiting threads. */
+    struct heap waiters;        /* Waiting threads, highest priority first. */
   };
 
 void cond_init (struct condition *);
 void cond_wait (struct condition *, struct lock *);
+bool cond_wait_timeout (struct condition *, struct lock *, int64_t ticks);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
-bool semaphore_priority_compare (const struct list_elem *, const struct list_elem *, void *);
+void waiter_requeue (struct thread *);
+
+/* Reader-writer lock. */
+struct rwlock
+  {
+    struct lock lock;           /* Held by the writer, if any. */
+    unsigned readers;           /* Number of threads reading. */
+    struct list holds;          /* Readers' rwlock_holds. */
+    bool writer_waiting;        /* Writer waiting for READERS to reach 0? */
+    struct semaphore drained;   /* Upped when it does. */
+  };
+
+/* A thread's read hold on an rwlock.  LOCK is never acquired; it
+   sits in the reader's list of held locks so that a waiting
+   writer can donate priority to the reader the same way
+   lock_acquire() donates to a lock holder. */
+struct rwlock_hold
+  {
+    struct lock lock;           /* Carries donated priority. */
+    struct list_elem elem;      /* Element in the rwlock's HOLDS. */
+    struct rwlock *rwlock;      /* Rwlock held, or null if unused. */
+  };
+
+/* Number of rwlocks a thread can read at once and still receive
+   donations.  Further read holds work but take no donations. */
+#define RWLOCK_HOLD_CNT 4
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+bool rwlock_try_acquire_read (struct rwlock *);
+bool rwlock_acquire_read_timeout (struct rwlock *, int64_t ticks);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+bool rwlock_try_acquire_write (struct rwlock *);
+bool rwlock_acquire_write_timeout (struct rwlock *, int64_t ticks);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_write_held_by_current_thread (const struct rwlock *);
 
 /* Optimization barrier.
 
@@ -1,15 +1,20 @@
 #include "threads/thread.h"
 #include <debug.h>
+#include <inttypes.h>
+#include <proc-stats.h>
 #include <stddef.h>
 #include <random.h>
+#include <round.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
+#include "threads/smp.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
+#include "threads/trace.h"
 #include "threads/vaddr.h"
 #include "devices/timer.h"
 #include "filesys/directory.h"
@@ -22,12 +27,82 @@
    of thread.h for details */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running */
-static struct list ready_list;
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running, in one FIFO queue per
+   priority.  Bit P of MASK is set when QUEUES[P] is not empty.
+   A ready thread is always queued at its current priority, so
+   its priority may only change while it is dequeued; see
+   priority_donate(). */
+struct run_queue
+  {
+    struct list queues[PRI_MAX + 1];
+    uint64_t mask;
+    struct list edf;            /* EDF threads with budget, by deadline. */
+    struct list edf_throttled;  /* EDF threads waiting for budget. */
+    int cnt;                    /* Number of threads queued. */
+  };
+
+/* One run queue per CPU.  A ready thread waits in the queue of
+   the CPU it last ran on, given by its `cpu' member, so that it
+   finds its cache still warm, unless its `cpu_mask' rules that
+   CPU out.
+
+   With SMP_SCAFFOLD, which is off by default (see Make.config),
+   a CPU whose queue runs dry steals a thread from the busiest
+   other CPU instead of going idle, and every BALANCE_INTERVAL
+   ticks a CPU that is at least two threads behind the busiest
+   one pulls one over.  Either way it takes the highest-priority
+   thread that may run on it, passing over threads that became
+   ready less than MIGRATE_HOT_NS ago and so probably still have
+   their cache lines where they were, unless it would otherwise
+   go idle.
+
+   No application processor is ever started, though, so only
+   CPU 0's queue is used and stealing never finds anything: this
+   is scaffolding for SMP, not a working balancer.  Other CPUs'
+   queues are protected only by turning interrupts off, which
+   suffices only while one CPU runs the kernel; see smp.c. */
+static struct run_queue run_queues[CPU_MAX];
+static int ready_cnt;           /* Threads queued on all CPUs. */
+
+/* Earliest-deadline-first scheduling.
+
+   A thread that calls thread_set_edf() is promised RUNTIME ticks
+   of CPU time in every PERIOD ticks, by DEADLINE ticks after the
+   start of the period.  Ready EDF threads run ahead of every
+   priority queue, earliest deadline first, and keep running once
+   started until they block, use up their runtime, or a thread
+   with an earlier deadline becomes ready.  A thread that uses up
+   its runtime waits on its CPU's EDF_THROTTLED list until its next
+   period, so it cannot take more than its share however it
+   behaves.  Admission control keeps the sum of RUNTIME / DEADLINE
+   over all EDF threads within EDF_MAX_LOAD, which is sufficient
+   for every deadline to be met on one CPU and leaves time over
+   for everyone else.  EDF threads are never moved to other CPUs
+   by balancing. */
+static struct list edf_list;    /* All EDF threads. */
+static int edf_load;            /* Their summed load, in thousandths. */
+
+/* Most CPU time EDF threads may reserve, in thousandths. */
+#define EDF_MAX_LOAD 900
+
+#ifdef SMP_SCAFFOLD
+/* Ticks between periodic load balancing passes. */
+#define BALANCE_INTERVAL 4
+
+/* Threads ready for less than this long count as cache-hot. */
+#define MIGRATE_HOT_NS 500000
+#endif
+
+/* Sleeping threads, hashed by wake-up tick into SLEEP_WHEEL_SIZE
+   buckets, each sorted by wake-up tick.  Each timer tick only
+   looks at the front of one bucket, so it costs O(1) plus the
+   number of threads woken. */
+#define SLEEP_WHEEL_SIZE 64
+static struct list sleep_wheel[SLEEP_WHEEL_SIZE];
 
-/* List of processes in THREAD_WAIT state */
-static struct list wait_list;
+/* Last tick whose sleepers have been woken. */
+static int64_t sleep_wheel_time;
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
@@ -50,20 +125,47 @@ struct kernel_thread_frame
     void *aux;                  /* Auxiliary data for function. */
   };
 
+/* Pages of dead threads kept for reuse by thread_create(), so
+   that creating a thread usually takes neither palloc's pool
+   lock nor zeroing a whole page: init_thread() clears only the
+   struct thread.  Accessed with interrupts off. */
+#define THREAD_CACHE_MAX 16
+static struct list thread_cache;
+static size_t thread_cache_cnt;
+
 /* Statistics. */
 static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
 static long long user_ticks;    /* # of timer ticks in user programs. */
 
 /* Scheduling. */
-#define TIME_SLICE 4            /* # of timer ticks to give each thread. */
+#define TIME_SLICE 4            /* Default # of timer ticks per thread. */
 static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 
+/* Time slice for threads in each priority band. */
+unsigned thread_time_slice[THREAD_BAND_CNT] =
+  { TIME_SLICE, TIME_SLICE, TIME_SLICE, TIME_SLICE };
+
+/* Ticks between aging rounds, or 0 if off.  See age_ready(). */
+unsigned thread_age_ticks;
+
+/* Levels of priority given to a thread woken by I/O, or 0 for
+   none.  See thread_unblock_io(). */
+unsigned thread_io_boost;
+
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* System load average, for the MLFQS scheduler: an estimate of
+   the number of threads ready to run over the past minute. */
+static fixed_t load_avg;
+
+/* Ticks between recomputations of the running thread's MLFQS
+   priority. */
+#define MLFQS_PRIORITY_INTERVAL 4
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
@@ -72,9 +174,29 @@ static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
 static bool is_thread (struct thread *) UNUSED;
 static void *alloc_frame (struct thread *, size_t size);
+static struct thread *alloc_thread_page (void);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static void ready_insert (struct thread *);
+static void ready_remove (struct thread *);
+static void record_latency (struct thread *, uint64_t latency);
+static heap_less_func lock_priority_less;
+static thread_action_func print_thread_stats;
+static int ready_max_priority (void);
+#ifdef SMP_SCAFFOLD
+static struct thread *steal_thread (bool idle);
+static void balance (void);
+#endif
+static void age_ready (void);
+static void mlfqs_update_priority (struct thread *, void *aux);
+static void mlfqs_decay (struct thread *, void *aux);
+static void mlfqs_update_load_avg (int ready);
+static bool edf_active (const struct thread *);
+static int edf_thread_load (const struct thread *);
+static void edf_leave (struct thread *);
+static void edf_release (int64_t now);
+static list_less_func edf_deadline_less;
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -92,12 +214,32 @@ static tid_t allocate_tid (void);
 void
 thread_init (void) 
 {
+  int i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
-  list_init (&ready_list);
-  list_init (&wait_list);
+  for (i = 0; i < CPU_MAX; i++)
+    {
+      struct run_queue *rq = &run_queues[i];
+      int pri;
+
+      for (pri = 0; pri <= PRI_MAX; pri++)
+        list_init (&rq->queues[pri]);
+      rq->mask = 0;
+      list_init (&rq->edf);
+      list_init (&rq->edf_throttled);
+      rq->cnt = 0;
+    }
+  ready_cnt = 0;
+  load_avg = 0;
+  for (i = 0; i < SLEEP_WHEEL_SIZE; i++)
+    list_init (&sleep_wheel[i]);
+  sleep_wheel_time = 0;
+  list_init (&edf_list);
+  edf_load = 0;
   list_init (&all_list);
+  list_init (&thread_cache);
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
@@ -140,8 +282,12 @@ void
 thread_tick (void) 
 {
   struct thread *t = thread_current ();
+  struct list *edf = &run_queues[cpu_current ()->id].edf;
 
   /* Update statistics. */
+  t->stats.run_ticks++;
+  if (t->acct != NULL)
+    t->acct->run_ticks++;
   if (t == idle_thread)
     idle_ticks++;
 #ifdef USERPROG
@@ -151,18 +297,131 @@ thread_tick (void)
   else
     kernel_ticks++;
 
-  /* Enforce preemption. */
-  /* Since we use priority scheduling instead of Round Robin, we don't need the below statements. */
-  // if (++thread_ticks >= TIME_SLICE)
-  //   intr_yield_on_return ();
+  if (thread_mlfqs)
+    {
+      int64_t now = timer_ticks ();
+
+      /* Only the running thread's recent_cpu changes from tick to
+         tick, so only its priority needs recomputing, except once
+         a second when every thread's recent_cpu decays. */
+      if (t != idle_thread)
+        t->recent_cpu = fp_add_int (t->recent_cpu, 1);
+      if (now % TIMER_FREQ == 0)
+        mlfqs_update_load_avg (ready_cnt + (t != idle_thread));
+      else if (now % MLFQS_PRIORITY_INTERVAL == 0 && t != idle_thread)
+        mlfqs_update_priority (t, NULL);
+      if (ready_max_priority () > t->priority)
+        intr_yield_on_return ();
+    }
+
+#ifdef SMP_SCAFFOLD
+  if (timer_ticks () % BALANCE_INTERVAL == 0)
+    balance ();
+#endif
+
+  /* Age the threads left waiting, and let the priority the
+     running thread gained by waiting, or by waking from I/O, wear
+     off as it runs. */
+  if (!thread_mlfqs)
+    {
+      if (thread_age_ticks != 0 && timer_ticks () % thread_age_ticks == 0)
+        age_ready ();
+      if (t->boost > 0)
+        {
+          t->boost--;
+          priority_update (t);
+          if (ready_max_priority () > t->priority)
+            intr_yield_on_return ();
+        }
+    }
+
+  /* Charge an EDF thread for the tick, start new periods, and
+     preempt for a thread with an earlier deadline. */
+  if (edf_active (t) && --t->edf_budget == 0)
+    intr_yield_on_return ();
+  edf_release (timer_ticks ());
+  if (!list_empty (edf)
+      && thread_preempts (list_entry (list_front (edf), struct thread, elem)))
+    intr_yield_on_return ();
+  if (edf_active (t))
+    return;
+
+  /* Enforce preemption.  A thread that has used up its band's
+     time slice goes to the back of its queue, but only if another
+     thread of at least its priority is waiting to run. */
+  if (++thread_ticks
+      >= thread_time_slice[t->priority * THREAD_BAND_CNT / (PRI_MAX + 1)]
+      && t != idle_thread && ready_max_priority () >= t->priority)
+    intr_yield_on_return ();
+}
+
+/* Accounts for CNT timer ticks, ending at tick NOW, that went by
+   while the idle thread ran with the timer stopped, the same way
+   thread_tick() would have.  Never preempts. */
+void
+thread_skip_ticks (int64_t now, int cnt)
+{
+  int64_t tick;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  idle_ticks += cnt;
+  idle_thread->stats.run_ticks += cnt;
+  edf_release (now);
+  if (thread_mlfqs)
+    for (tick = now - cnt + 1; tick <= now; tick++)
+      if (tick % TIMER_FREQ == 0)
+        mlfqs_update_load_avg (ready_cnt);
 }
 
 /* Prints thread statistics. */
 void
 thread_print_stats (void) 
 {
+  enum intr_level old_level;
+
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+
+  old_level = intr_disable ();
+  thread_foreach (print_thread_stats, NULL);
+  intr_set_level (old_level);
+}
+
+/* Names of the thread states, for print_thread_stats(). */
+static const char *const status_names[] =
+  {"running", "ready", "blocked", "dying"};
+
+/* Prints T's scheduling statistics on three lines.  The last
+   gives its priority with any donation, and its own. */
+static void
+print_thread_stats (struct thread *t, void *aux UNUSED)
+{
+  const struct thread_stats *s = &t->stats;
+  int i;
+
+  printf ("Thread %s (tid %d): %"PRId64" ticks run, "
+          "%u voluntary and %u involuntary switches, "
+          "%"PRIu64" cycles ready\n",
+          t->name, t->tid, s->run_ticks, s->vol_switches,
+          s->invol_switches, s->ready_cycles);
+  printf ("Thread %s (tid %d) latency:", t->name, t->tid);
+  for (i = 0; i < THREAD_LATENCY_BUCKETS; i++)
+    printf (" %u", s->latency[i]);
+  printf ("\n");
+  printf ("Thread %s (tid %d) state: %s, priority %d, own %d\n",
+          t->name, t->tid, status_names[t->status], t->priority,
+          t->prev_priority + t->boost);
+}
+
+/* Copies the running thread's scheduling statistics into
+   STATS. */
+void
+thread_get_stats (struct thread_stats *stats)
+{
+  enum intr_level old_level = intr_disable ();
+  *stats = thread_current ()->stats;
+  intr_set_level (old_level);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -193,13 +452,22 @@ thread_create (const char *name, int priority,
   ASSERT (function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  t = alloc_thread_page ();
   if (t == NULL)
     return TID_ERROR;
 
   /* Initialize thread. */
   init_thread (t, name, priority);
   tid = t->tid = allocate_tid ();
+  t->nice = thread_current ()->nice;
+  t->recent_cpu = thread_current ()->recent_cpu;
+  t->cpu_mask = thread_current ()->cpu_mask;
+  if (thread_mlfqs)
+    {
+      enum intr_level old_level = intr_disable ();
+      mlfqs_update_priority (t, NULL);
+      intr_set_level (old_level);
+    }
 
   enum intr_level old_level = intr_disable ();
 
@@ -218,10 +486,6 @@ thread_create (const char *name, int priority,
   sf->eip = switch_entry;
   sf->ebp = 0;
 
-//  t->executable = NULL;
-  t->parent = thread_current ();
-  list_push_back(&thread_current ()->children, &t->child_elem);
-
   if(thread_current()->cwd)
     t->cwd = dir_reopen(thread_current()->cwd);
   else 
@@ -273,13 +537,51 @@ thread_unblock (struct thread *t)
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
 
-  // Implement priority scheduling 
-  list_insert_ordered (&ready_list, &t->elem, priority_compare, NULL);
+  ready_insert (t);
   t->status = THREAD_READY;
+  t->ready_since = timer_cycles ();
+
+  intr_set_level (old_level);
+}
 
+/* Unblocks T, like thread_unblock(), on behalf of a device whose
+   input T was waiting for or whose transfer for T has completed.
+   Such a thread tends to run briefly and block again, so it is
+   given thread_io_boost levels of priority over its own, which
+   wear off a level per tick that it runs, the same way as a
+   boost from aging.  Does not preempt. */
+void
+thread_unblock_io (struct thread *t)
+{
+  enum intr_level old_level;
+
+  ASSERT (is_thread (t));
+
+  old_level = intr_disable ();
+  if (!thread_mlfqs && t->boost < (int) thread_io_boost)
+    {
+      t->boost = thread_io_boost;
+      priority_update (t);
+    }
+  thread_unblock (t);
   intr_set_level (old_level);
 }
 
+/* Returns true if T, which is ready, should run before the
+   running thread: if it is an EDF thread with time left and a
+   deadline earlier than the running thread's, if there is one,
+   or if neither is such an EDF thread and T has the higher
+   priority. */
+bool
+thread_preempts (const struct thread *t)
+{
+  struct thread *cur = thread_current ();
+
+  if (edf_active (t))
+    return !edf_active (cur) || t->edf_deadline < cur->edf_deadline;
+  return !edf_active (cur) && t->priority > cur->priority;
+}
+
 /* Returns the name of the running thread. */
 const char *
 thread_name (void) 
@@ -306,6 +608,15 @@ thread_current (void)
   return t;
 }
 
+/* Returns the thread that holds the state of the running
+   thread's process, which is the running thread itself unless
+   it is one of a user process's extra threads. */
+struct thread *
+thread_process (void)
+{
+  return thread_current ()->process;
+}
+
 /* Returns the running thread's tid. */
 tid_t
 thread_tid (void) 
@@ -334,13 +645,11 @@ thread_exit (void)
   old_level =  intr_disable ();
 
   list_remove (&thread_current()->allelem);
-  sema_up (&thread_current ()->wait_sema);
-  sema_up (&thread_current ()->parent->load_sema);
-
-  /* Stop denying and allow write */
-  if(cur->executable != NULL)
-	file_close(cur->executable);
+  if (cur->edf_runtime != 0)
+    edf_leave (cur);
 
+  scratch_thread_exit ();
+  malloc_thread_exit ();
   cur->status = THREAD_DYING;
   
   schedule ();
@@ -359,12 +668,11 @@ thread_yield (void)
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
-  if (cur != idle_thread) {
-	///* Implement priority scheduling *///
-	list_insert_ordered (&ready_list, &cur->elem, priority_compare, NULL);
-  }
+  if (cur != idle_thread)
+    ready_insert (cur);
 
   cur->status = THREAD_READY;
+  cur->ready_since = timer_cycles ();
   schedule ();
   intr_set_level (old_level);
 }
@@ -392,12 +700,17 @@ void
 thread_set_priority (int new_priority) 
 {
   enum intr_level old_level;
+
+  /* The MLFQS scheduler sets priorities itself. */
+  if (thread_mlfqs)
+    return;
+
   old_level = intr_disable ();
   
   int prev_priority = thread_current ()->priority;
   thread_current ()->prev_priority = new_priority;
 
-  if (new_priority < prev_priority && list_empty (&thread_current()->locks))
+  if (new_priority < prev_priority && heap_empty (&thread_current()->locks))
     thread_current ()->priority = new_priority;
   
   if (thread_current () != idle_thread)
@@ -406,6 +719,153 @@ thread_set_priority (int new_priority)
   intr_set_level (old_level);
 }
 
+/* Restricts the current thread to the CPUs in CPU_MASK, one bit
+   per CPU, and moves it to one of them if need be.  Returns
+   false, changing nothing, if none of them is online. */
+bool
+thread_set_affinity (uint32_t cpu_mask)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  if ((cpu_mask & cpu_online_mask) == 0)
+    return false;
+
+  old_level = intr_disable ();
+  cur->cpu_mask = cpu_mask & CPU_MASK_ALL;
+  if (!(cur->cpu_mask & (1u << cur->cpu)))
+    thread_yield ();
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Returns the current thread's CPU affinity mask. */
+uint32_t
+thread_get_affinity (void)
+{
+  return thread_current ()->cpu_mask;
+}
+
+/* Puts the current thread in the earliest-deadline-first class,
+   to run for RUNTIME ticks out of every PERIOD ticks, within
+   DEADLINE ticks of the start of each period, or with a DEADLINE
+   of 0, by the end of the period.  Its first period starts now.
+   A RUNTIME of 0 takes it out of the class, back to its
+   priority.  Returns false, changing nothing, if the parameters
+   do not satisfy 0 < RUNTIME <= DEADLINE <= PERIOD or if
+   admitting the thread would reserve more than EDF_MAX_LOAD of
+   the CPU. */
+bool
+thread_set_edf (int64_t runtime, int64_t period, int64_t deadline)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  int64_t rel_deadline = deadline != 0 ? deadline : period;
+  int load;
+
+  if (runtime == 0)
+    {
+      old_level = intr_disable ();
+      if (cur->edf_runtime != 0)
+        edf_leave (cur);
+      intr_set_level (old_level);
+      thread_yield ();
+      return true;
+    }
+  if (runtime < 0 || rel_deadline < runtime || period < rel_deadline)
+    return false;
+
+  old_level = intr_disable ();
+  load = DIV_ROUND_UP (runtime * 1000, rel_deadline);
+  if (edf_load - edf_thread_load (cur) + load > EDF_MAX_LOAD)
+    {
+      intr_set_level (old_level);
+      return false;
+    }
+  if (cur->edf_runtime != 0)
+    edf_leave (cur);
+  cur->edf_runtime = runtime;
+  cur->edf_period = period;
+  cur->edf_rel_deadline = rel_deadline;
+  cur->edf_release = timer_ticks ();
+  cur->edf_deadline = cur->edf_release + rel_deadline;
+  cur->edf_budget = runtime;
+  list_push_back (&edf_list, &cur->edf_elem);
+  edf_load += load;
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Returns true if T is in the EDF class and has time left in its
+   current period. */
+static bool
+edf_active (const struct thread *t)
+{
+  return t->edf_runtime != 0 && t->edf_budget > 0;
+}
+
+/* Returns the share of the CPU that T reserves, in thousandths,
+   or 0 if T is not in the EDF class. */
+static int
+edf_thread_load (const struct thread *t)
+{
+  if (t->edf_runtime == 0)
+    return 0;
+  return DIV_ROUND_UP (t->edf_runtime * 1000, t->edf_rel_deadline);
+}
+
+/* Takes T, which is running, out of the EDF class.  Interrupts
+   must be off. */
+static void
+edf_leave (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_RUNNING);
+
+  edf_load -= edf_thread_load (t);
+  list_remove (&t->edf_elem);
+  t->edf_runtime = 0;
+}
+
+/* Starts a new period, as of timer tick NOW, for each EDF thread
+   whose current one is over, renewing its budget and moving its
+   deadline.  Periods that went by while a thread was blocked are
+   skipped.  Interrupts must be off. */
+static void
+edf_release (int64_t now)
+{
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (e = list_begin (&edf_list); e != list_end (&edf_list);
+       e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, edf_elem);
+      bool ready = t->status == THREAD_READY;
+
+      if (now < t->edf_release + t->edf_period)
+        continue;
+      if (ready)
+        ready_remove (t);
+      t->edf_release += (now - t->edf_release) / t->edf_period
+                        * t->edf_period;
+      t->edf_deadline = t->edf_release + t->edf_rel_deadline;
+      t->edf_budget = t->edf_runtime;
+      if (ready)
+        ready_insert (t);
+    }
+}
+
+/* Orders threads by EDF deadline, earliest first. */
+static bool
+edf_deadline_less (const struct list_elem *a, const struct list_elem *b,
+                   void *aux UNUSED)
+{
+  return (list_entry (a, struct thread, elem)->edf_deadline
+          < list_entry (b, struct thread, elem)->edf_deadline);
+}
+
 /* Returns the current thread's priority. */
 int
 thread_get_priority (void) 
@@ -420,7 +880,7 @@ thread_add_lock (struct lock *lock)
   enum intr_level old_level;
   old_level = intr_disable ();
   
-  list_insert_ordered (&thread_current ()->locks, &lock->elem, lock_priority_compare, NULL);
+  heap_push (&thread_current ()->locks, &lock->elem);
   
   if (lock->max_priority > thread_current ()->priority)
 	thread_current ()->priority = lock->max_priority;
@@ -428,6 +888,16 @@ thread_add_lock (struct lock *lock)
   intr_set_level (old_level);
 }
 
+/* Orders a thread's held locks by the priority donated through
+   them. */
+static bool
+lock_priority_less (const struct heap_elem *a, const struct heap_elem *b,
+                    void *aux UNUSED)
+{
+  return (heap_entry (a, struct lock, elem)->max_priority
+          < heap_entry (b, struct lock, elem)->max_priority);
+}
+
 /* Remove a held lock from current thread. */
 void
 thread_remove_lock (struct lock *lock)
@@ -435,26 +905,33 @@ thread_remove_lock (struct lock *lock)
   enum intr_level old_level;
   old_level = intr_disable ();
   
-  list_remove (&lock->elem);
+  heap_remove (&thread_current ()->locks, &lock->elem);
   priority_update (thread_current ());
   
   intr_set_level (old_level);
 }
 
-/* Donate current thread's priority to another thread. */
+/* Recomputes the priority of T after the max_priority of LOCK,
+   which T holds, has been raised by a donation. */
 void
-priority_donate (struct thread *t)
+priority_donate (struct thread *t, struct lock *lock)
 {
   enum intr_level old_level;
   old_level = intr_disable ();
   
-  priority_update (t);
-  
+  heap_raise (&t->locks, &lock->elem);
   if (t->status == THREAD_READY)
-  {
-	list_remove (&t->elem);
-	list_insert_ordered (&ready_list, &t->elem, priority_compare, NULL);
-  }
+    {
+      /* Requeue T at its new priority. */
+      ready_remove (t);
+      priority_update (t);
+      ready_insert (t);
+    }
+  else
+    {
+      priority_update (t);
+      waiter_requeue (t);
+    }
   
   intr_set_level (old_level);
 }
@@ -465,16 +942,23 @@ void
 priority_update (struct thread *t)
 {
   enum intr_level old_level;
+
+  /* The MLFQS scheduler does not donate priority. */
+  if (thread_mlfqs)
+    return;
+
   old_level = intr_disable ();
   
-  int max_priority = t->prev_priority;
+  int max_priority = t->prev_priority + t->boost;
   int lock_priority;
 
-  if (!list_empty (&t->locks))
+  if (max_priority > PRI_MAX)
+    max_priority = PRI_MAX;
+
+  if (!heap_empty (&t->locks))
   {
-    list_sort (&t->locks, lock_priority_compare, NULL);
-    lock_priority = list_entry (list_front (&t->locks),
-                                  struct lock, elem)->max_priority;
+    lock_priority = heap_entry (heap_top (&t->locks),
+                                struct lock, elem)->max_priority;
     
 	if (lock_priority > max_priority)
       max_priority = lock_priority;
@@ -484,37 +968,116 @@ priority_update (struct thread *t)
   intr_set_level (old_level);
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Sets the current thread's nice value to NICE and recomputes
+   its priority, yielding if it no longer has the highest. */
 void
-thread_set_nice (int nice UNUSED) 
+thread_set_nice (int nice) 
 {
-  /* Not yet implemented. */
+  struct thread *t = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (nice >= -20 && nice <= 20);
+
+  old_level = intr_disable ();
+  t->nice = nice;
+  if (thread_mlfqs)
+    {
+      mlfqs_update_priority (t, NULL);
+      if (t != idle_thread && ready_max_priority () > t->priority)
+        thread_yield ();
+    }
+  intr_set_level (old_level);
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int load = fp_round (load_avg * 100);
+  intr_set_level (old_level);
+  return load;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int recent = fp_round (thread_current ()->recent_cpu * 100);
+  intr_set_level (old_level);
+  return recent;
 }
-
+
+/* Sets T's priority from its recent_cpu and nice values, as the
+   MLFQS scheduler does, requeuing T if it is ready.  Interrupts
+   must be off. */
+static void
+mlfqs_update_priority (struct thread *t, void *aux UNUSED)
+{
+  int priority;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t == idle_thread)
+    return;
+
+  priority = PRI_MAX - fp_round (t->recent_cpu / 4) - t->nice * 2;
+  if (priority < PRI_MIN)
+    priority = PRI_MIN;
+  else if (priority > PRI_MAX)
+    priority = PRI_MAX;
+  if (priority == t->priority)
+    return;
+
+  if (t->status == THREAD_READY)
+    {
+      ready_remove (t);
+      t->priority = t->prev_priority = priority;
+      ready_insert (t);
+    }
+  else
+    {
+      t->priority = t->prev_priority = priority;
+      waiter_requeue (t);
+    }
+}
+
+/* Decays T's recent_cpu, as the MLFQS scheduler does once a
+   second, and recomputes its priority.  Interrupts must be
+   off. */
+static void
+mlfqs_decay (struct thread *t, void *aux UNUSED)
+{
+  fixed_t twice_load = load_avg * 2;
+
+  if (t == idle_thread)
+    return;
+  t->recent_cpu = fp_add_int (fp_mul (fp_div (twice_load,
+                                               fp_add_int (twice_load, 1)),
+                                      t->recent_cpu),
+                              t->nice);
+  mlfqs_update_priority (t, NULL);
+}
+
+/* Updates load_avg given READY threads running or ready to run,
+   then decays every thread's recent_cpu, as the MLFQS scheduler
+   does once a second.  Interrupts must be off. */
+static void
+mlfqs_update_load_avg (int ready)
+{
+  load_avg = (fp_mul (fp_div (fp_from_int (59), fp_from_int (60)), load_avg)
+              + fp_div (fp_from_int (1), fp_from_int (60)) * ready);
+  thread_foreach (mlfqs_decay, NULL);
+}
+
 /* Idle thread.  Executes when no other thread is ready to run.
 
    The idle thread is initially put on the ready list by
@@ -533,6 +1096,11 @@ idle (void *idle_started_ UNUSED)
 
   for (;;) 
     {
+      /* Zero free pages for later PAL_ZERO allocations.  Anyone
+         who becomes ready meanwhile preempts us. */
+      while (palloc_prezero ())
+        continue;
+
       /* Let someone else run. */
       intr_disable ();
       thread_block ();
@@ -549,6 +1117,7 @@ idle (void *idle_started_ UNUSED)
 
          See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
          7.11.1 "HLT Instruction". */
+      timer_idle_begin ();
       asm volatile ("sti; hlt" : : : "memory");
     }
 }
@@ -578,26 +1147,102 @@ running_thread (void)
   return pg_round_down (esp);
 }
 
-/*
-bool
-thread_wait_cmp (const struct list_elem *a,
-                 const struct list_elem *b,
-                 void *aux UNUSED)
+/* Returns true if thread A wakes up before thread B. */
+static bool
+wake_time_less (const struct list_elem *a, const struct list_elem *b,
+                void *aux UNUSED)
 {
-  return list_entry(a, struct thread, wait_elem)->wait_length <
-         list_entry(b, struct thread, wait_elem)->wait_length;
-}*/
-
-// ticks = start = timer_ticks() + ticks from timer_sleep()
+  return (list_entry (a, struct thread, elem)->wait_time
+          < list_entry (b, struct thread, elem)->wait_time);
+}
 
-void thread_sleep(int64_t sleep_ticks)
+/* Blocks the current thread until the timer reaches tick
+   WAKE_TIME.  Returns at once if that tick has already passed.
+   Interrupts must be off. */
+void
+thread_sleep (int64_t wake_time)
 { 
-  struct thread *t = thread_current();
-  t -> wait_time = sleep_ticks; //sleep_ticks = timer_ticks() + ticks from sleep_timer
-  
-  // insert in sorted order to remove threads with higher prio
-  list_insert_ordered (&wait_list, &t -> elem, priority_compare, NULL);
-  thread_block();
+  struct thread *t = thread_current ();
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (wake_time <= sleep_wheel_time)
+    return;
+  t->wait_time = wake_time;
+  list_insert_ordered (&sleep_wheel[wake_time % SLEEP_WHEEL_SIZE], &t->elem,
+                       wake_time_less, NULL);
+  thread_block ();
+}
+
+/* Wakes every thread whose wake-up tick is NOW or earlier.
+   Called from the timer interrupt handler at each tick, and by
+   the timer when the idle thread stops waiting early, in which
+   case the caller is about to reschedule anyway. */
+void
+thread_wakeup (int64_t now)
+{
+  bool preempt = false;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (sleep_wheel_time < now)
+    {
+      struct list *bucket;
+
+      sleep_wheel_time++;
+      bucket = &sleep_wheel[sleep_wheel_time % SLEEP_WHEEL_SIZE];
+      while (!list_empty (bucket))
+        {
+          struct thread *t = list_entry (list_front (bucket),
+                                         struct thread, elem);
+          if (t->wait_time > sleep_wheel_time)
+            break;
+          list_pop_front (bucket);
+          if (t->timed_sema != NULL)
+            sema_timed_out (t);
+          thread_unblock (t);
+          if (thread_preempts (t))
+            preempt = true;
+        }
+    }
+
+  if (preempt && intr_context ())
+    intr_yield_on_return ();
+}
+
+/* Returns the number of ticks, at least 1 and at most LIMIT,
+   until the next tick at which thread_wakeup() has a thread to
+   wake or a throttled EDF thread may run again, or LIMIT if there
+   is none that soon. */
+int
+thread_next_wakeup (int limit)
+{
+  struct list_elem *e;
+  int cnt;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (limit >= 1 && limit <= SLEEP_WHEEL_SIZE);
+
+  /* A throttled EDF thread is ready again at its next period. */
+  for (e = list_begin (&edf_list); e != list_end (&edf_list);
+       e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, edf_elem);
+      int64_t release = t->edf_release + t->edf_period;
+      if (t->edf_budget == 0 && release - sleep_wheel_time < limit)
+        limit = release > sleep_wheel_time ? release - sleep_wheel_time : 1;
+    }
+
+  for (cnt = 1; cnt < limit; cnt++)
+    {
+      int64_t tick = sleep_wheel_time + cnt;
+      struct list *bucket = &sleep_wheel[tick % SLEEP_WHEEL_SIZE];
+      if (!list_empty (bucket)
+          && list_entry (list_front (bucket),
+                         struct thread, elem)->wait_time <= tick)
+        break;
+    }
+  return cnt;
 }
 
 /* Returns true if T appears to point to a valid thread. */
@@ -624,20 +1269,70 @@ init_thread (struct thread *t, const char *name, int priority)
   t->stack = (uint8_t *) t + PGSIZE;
   t->priority = priority;
   t->prev_priority = priority;
-  sema_init(&t->wait_sema, 0);
-  list_init (&t->locks);
-  list_init (&t->files);
-  list_init (&t->children);
-  sema_init(&t->wait_sema, 0);
+  t->cpu = cpu_current ()->id;
+  t->cpu_mask = CPU_MASK_ALL;
+  t->process = t;
+  heap_init (&t->locks, lock_priority_less, NULL);
+#ifdef VM
+  lock_init (&t->pages_lock);
+  list_init (&t->mappings);
+  lock_init (&t->mappings_lock);
+#endif
   t->lock_waiting = NULL;
+  t->wait_queue = NULL;
   t->magic = THREAD_MAGIC;
 
-  t->process_status = TASK_READY;
   old_level = intr_disable ();
   list_push_back (&all_list, &t->allelem);
   intr_set_level (old_level);
 }
 
+/* Returns a page for a new thread, reusing a dead thread's page
+   if one is cached, or a null pointer if memory is exhausted.
+   The page's contents are garbage. */
+static struct thread *
+alloc_thread_page (void)
+{
+  struct thread *t = NULL;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (!list_empty (&thread_cache))
+    {
+      t = list_entry (list_pop_front (&thread_cache), struct thread, elem);
+      thread_cache_cnt--;
+    }
+  intr_set_level (old_level);
+
+  if (t == NULL)
+    t = palloc_get_page (0);
+  return t;
+}
+
+/* Frees the page of T, a thread that has exited and whose struct
+   thread is no longer needed, keeping it for reuse if the cache
+   has room. */
+void
+thread_free (struct thread *t)
+{
+  enum intr_level old_level;
+
+  ASSERT (is_thread (t));
+
+  old_level = intr_disable ();
+  if (thread_cache_cnt < THREAD_CACHE_MAX)
+    {
+      t->magic = 0;
+      list_push_front (&thread_cache, &t->elem);
+      thread_cache_cnt++;
+      t = NULL;
+    }
+  intr_set_level (old_level);
+
+  if (t != NULL)
+    palloc_free_page (t);
+}
+
 /* Allocates a SIZE-byte frame at the top of thread T's stack and
    returns a pointer to the frame's base. */
 static void *
@@ -659,10 +1354,217 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (list_empty (&ready_list))
-    return idle_thread;
+  struct run_queue *rq = &run_queues[cpu_current ()->id];
+  struct thread *t;
+
+  if (!list_empty (&rq->edf))
+    {
+      t = list_entry (list_front (&rq->edf), struct thread, elem);
+      ready_remove (t);
+      return t;
+    }
+  if (rq->mask == 0)
+    {
+#ifdef SMP_SCAFFOLD
+      t = steal_thread (true);
+      return t != NULL ? t : idle_thread;
+#else
+      return idle_thread;
+#endif
+    }
+
+  t = list_entry (list_front (&rq->queues[ready_max_priority ()]),
+                  struct thread, elem);
+  ready_remove (t);
+  return t;
+}
+
+#ifdef SMP_SCAFFOLD
+/* Takes a thread that may run on this CPU off the run queue of
+   the busiest other CPU and returns it, or returns a null
+   pointer if there is none.  Passes over cache-hot threads,
+   unless IDLE is true and there is nothing else to take.
+   Interrupts must be off. */
+static struct thread *
+steal_thread (bool idle)
+{
+  int self = cpu_current ()->id;
+  struct run_queue *busiest = NULL;
+  struct thread *hot = NULL;
+  uint64_t now;
+  int pri, i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; i < cpu_cnt; i++)
+    if (i != self && (cpu_online_mask & (1u << i))
+        && run_queues[i].cnt > 0
+        && (busiest == NULL || run_queues[i].cnt > busiest->cnt))
+      busiest = &run_queues[i];
+  if (busiest == NULL)
+    return NULL;
+
+  now = timer_cycles ();
+  for (pri = PRI_MAX; pri >= PRI_MIN; pri--)
+    {
+      struct list_elem *e;
+
+      if (!(busiest->mask & ((uint64_t) 1 << pri)))
+        continue;
+      for (e = list_begin (&busiest->queues[pri]);
+           e != list_end (&busiest->queues[pri]); e = list_next (e))
+        {
+          struct thread *t = list_entry (e, struct thread, elem);
+          if (!(t->cpu_mask & (1u << self)))
+            continue;
+          if (timer_cycles_to_ns (now - t->ready_since) >= MIGRATE_HOT_NS)
+            {
+              ready_remove (t);
+              t->cpu = self;
+              return t;
+            }
+          if (hot == NULL)
+            hot = t;
+        }
+    }
+  if (idle && hot != NULL)
+    {
+      ready_remove (hot);
+      hot->cpu = self;
+      return hot;
+    }
+  return NULL;
+}
+
+/* If another CPU has at least two more ready threads than this
+   one, moves one of them over.  Called from the timer interrupt
+   every BALANCE_INTERVAL ticks. */
+static void
+balance (void)
+{
+  int self = cpu_current ()->id;
+  int most = 0;
+  int i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    if (i != self && (cpu_online_mask & (1u << i))
+        && run_queues[i].cnt > most)
+      most = run_queues[i].cnt;
+  if (most >= run_queues[self].cnt + 2)
+    {
+      struct thread *t = steal_thread (false);
+      if (t != NULL)
+        {
+          ready_insert (t);
+          if (t->priority > thread_current ()->priority)
+            intr_yield_on_return ();
+        }
+    }
+}
+#endif /* SMP_SCAFFOLD */
+
+/* Raises the priority of every thread in this CPU's ready queues
+   by one level, up to PRI_MAX, so that threads passed over by a
+   steady stream of higher-priority work eventually run.  The
+   boost adds to the thread's own priority, under any donation,
+   and wears off a level per tick once the thread runs; see
+   thread_tick().  Called from the timer interrupt every
+   thread_age_ticks ticks. */
+static void
+age_ready (void)
+{
+  struct run_queue *rq = &run_queues[cpu_current ()->id];
+  int pri;
+
+  /* Going down, threads moved up a queue are not seen again. */
+  for (pri = PRI_MAX - 1; pri >= PRI_MIN; pri--)
+    {
+      struct list_elem *e, *next;
+
+      if (!(rq->mask & ((uint64_t) 1 << pri)))
+        continue;
+      for (e = list_begin (&rq->queues[pri]);
+           e != list_end (&rq->queues[pri]); e = next)
+        {
+          struct thread *t = list_entry (e, struct thread, elem);
+
+          next = list_next (e);
+          if (t->prev_priority + t->boost >= PRI_MAX)
+            continue;
+          t->boost++;
+          if (t->prev_priority + t->boost > t->priority)
+            {
+              /* Not just under a bigger donation. */
+              ready_remove (t);
+              priority_update (t);
+              ready_insert (t);
+            }
+        }
+    }
+}
+
+/* Returns the highest priority of any thread ready on this CPU,
+   or -1 if no thread is. */
+static int
+ready_max_priority (void)
+{
+  uint64_t mask = run_queues[cpu_current ()->id].mask;
+  uint32_t high = mask >> 32, low = mask;
+
+  if (high != 0)
+    return 63 - __builtin_clz (high);
+  else if (low != 0)
+    return 31 - __builtin_clz (low);
+  else
+    return -1;
+}
+
+/* Adds ready thread T to the back of the queue for its priority
+   on its CPU, first moving it to the lowest-numbered online CPU
+   that it may run on if its CPU is not one.  Interrupts must be
+   off. */
+static void
+ready_insert (struct thread *t)
+{
+  struct run_queue *rq;
+  uint32_t allowed = t->cpu_mask & cpu_online_mask;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->priority >= PRI_MIN && t->priority <= PRI_MAX);
+  ASSERT (allowed != 0);
+
+  if (!(allowed & (1u << t->cpu)))
+    t->cpu = __builtin_ctz (allowed);
+  rq = &run_queues[t->cpu];
+
+  if (edf_active (t))
+    list_insert_ordered (&rq->edf, &t->elem, edf_deadline_less, NULL);
+  else if (t->edf_runtime != 0)
+    list_push_back (&rq->edf_throttled, &t->elem);
   else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+    {
+      list_push_back (&rq->queues[t->priority], &t->elem);
+      rq->mask |= (uint64_t) 1 << t->priority;
+    }
+  rq->cnt++;
+  ready_cnt++;
+}
+
+/* Removes T, which must be queued at its current priority, or
+   on an EDF list, from the ready queues.  Interrupts must be
+   off. */
+static void
+ready_remove (struct thread *t)
+{
+  struct run_queue *rq = &run_queues[t->cpu];
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_remove (&t->elem);
+  if (t->edf_runtime == 0 && list_empty (&rq->queues[t->priority]))
+    rq->mask &= ~((uint64_t) 1 << t->priority);
+  rq->cnt--;
+  ready_cnt--;
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -688,8 +1590,14 @@ thread_schedule_tail (struct thread *prev)
   
   ASSERT (intr_get_level () == INTR_OFF);
 
+  /* Account for the time we spent ready.  The idle thread runs
+     without ever being made ready. */
+  if (cur->status == THREAD_READY)
+    record_latency (cur, timer_cycles () - cur->ready_since);
+
   /* Mark us as running. */
   cur->status = THREAD_RUNNING;
+  cur->cpu = cpu_current ()->id;
 
   /* Start new time slice. */
   thread_ticks = 0;
@@ -704,33 +1612,13 @@ thread_schedule_tail (struct thread *prev)
      pull out the rug under itself.  (We don't free
      initial_thread because its memory was not obtained via
      palloc().) */
-  if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread && prev->parent == NULL) 
+  if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) 
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+      thread_free (prev);
     }
 }
 
-void
-thread_wakeup(void)
-{
-  struct list_elem *e;
-  int64_t current_time = timer_ticks();
-  
-  for(e=list_begin(&wait_list); e != list_end(&wait_list);) {
-    struct thread *t = list_entry(e, struct thread, elem);
-    
-    if (t -> wait_time <= current_time) {
-      e=list_remove(e);
-      thread_unblock(t);
-    }
-    else {
-      e = list_next(e);
-    }
-  }
-}
-
-
 /* Schedules a new process.  At entry, interrupts must be off and
    the running process's state must have been changed from
    running to some other state.  This function finds another
@@ -741,21 +1629,46 @@ thread_wakeup(void)
 static void
 schedule (void) 
 {
-  thread_wakeup();
-
   struct thread *cur = running_thread ();
-  struct thread *next = next_thread_to_run ();
+  struct thread *next;
   struct thread *prev = NULL;
 
   ASSERT (intr_get_level () == INTR_OFF);
+
+  /* The timer may be stopped while idle; restart it before
+     anything else runs. */
+  if (cur == idle_thread)
+    timer_idle_end ();
+  next = next_thread_to_run ();
   ASSERT (cur->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
   if (cur != next)
-    prev = switch_threads (cur, next);
+    {
+      if (cur->status == THREAD_BLOCKED)
+        cur->stats.vol_switches++;
+      else if (cur->status == THREAD_READY)
+        cur->stats.invol_switches++;
+      TRACE_EVENT (SCHEDULE, cur->tid, next->tid);
+      prev = switch_threads (cur, next);
+    }
   thread_schedule_tail (prev);
 }
 
+/* Adds LATENCY, in CPU cycles from being made ready to running,
+   to T's statistics. */
+static void
+record_latency (struct thread *t, uint64_t latency)
+{
+  int bucket = 0;
+
+  while (bucket < THREAD_LATENCY_BUCKETS - 1
+         && latency >= (uint64_t) 1 << (bucket + 10))
+    bucket++;
+  t->stats.latency[bucket]++;
+  t->stats.ready_cycles += latency;
+}
+
 /* Returns a tid to use for a new thread. */
 static tid_t
 allocate_tid (void) 
@@ -2,9 +2,14 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <hash.h>
 #include <list.h>
 #include <stdint.h>
+#include <thread-stats.h>
 #include "synch.h"
+#include "threads/malloc.h"
+#include "threads/scratch.h"
+#include "threads/fixed-point.h"
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -15,14 +20,6 @@ enum thread_status
     THREAD_DYING        /* About to be destroyed. */
   };
 
-enum process_status
-  {
-    TASK_STOPPED, 	/* Stopped and waiting for child process. */
-    TASK_RUNNING,	/* Running process. */
-    TASK_READY,		/* Not running but ready to run. */
-    TASK_ZOMBIE		/* Process about to exit */
-  };
-
 /* Thread identifier type.
    You can redefine this to whatever type you like. */
 typedef int tid_t;
@@ -94,55 +91,107 @@ typedef int tid_t;
    blocked state is on a semaphore wait list. */
 struct thread
   {
-    /* Owned by thread.c. */
-    tid_t tid;                          /* Thread identifier. */
+    /* What the scheduler and priority donation look at on every
+       run-queue and lock walk, kept together in the first cache
+       line of the page.  Owned by thread.c, except that ELEM is
+       shared with synch.c. */
     enum thread_status status;          /* Thread state. */
-    char name[16];                      /* Name (for debugging purposes). */
-    uint8_t *stack;                     /* Saved stack pointer. */
     int priority;                       /* Priority. */
-    struct list_elem allelem;           /* List element for all threads list. */
-
-    /* Shared between thread.c and synch.c. */
+    uint8_t *stack;                     /* Saved stack pointer. */
     struct list_elem elem;              /* List element. */
+    int64_t wait_time;                  /* When a sleep ends. */
+    int prev_priority;                  /* Priority before donation. */
+    int boost;                  /* Added to PREV_PRIORITY; see age_ready(). */
+    struct lock *lock_waiting;          /* Lock being waited for. */
+    int cpu;                    /* CPU it last ran on, or is ready on. */
+    uint32_t cpu_mask;          /* CPUs it may run on, one bit each. */
+    tid_t tid;                          /* Thread identifier. */
+    uint64_t ready_since;       /* CPU cycle count when last made ready. */
 
-#ifdef USERPROG
-    /* Owned by userprog/process.c. */
-    uint32_t *pagedir;                  /* Page directory. */
-#endif
+    /* For priority donation */
+    struct heap locks;		/* Locks held, highest max_priority first. */
+    struct rwlock_hold read_holds[RWLOCK_HOLD_CNT]; /* Owned by synch.c. */
+
+    /* Owned by synch.c. */
+    struct heap_elem wait_elem;         /* Element in semaphore waiters. */
+    uint64_t wait_seq;                  /* Arrival order in waiters. */
+    struct heap *wait_queue;            /* Waiters this thread is in. */
+    struct heap_elem *wait_queue_elem;  /* Its element in wait_queue. */
+    struct semaphore *timed_sema;       /* Semaphore of a timed wait. */
+    bool timed_out;                     /* Did that wait time out? */
+    struct semaphore *intr_sema;        /* Semaphore of a sema_down_intr(). */
+
+    /* Earliest-deadline-first class; see thread_set_edf().  Owned
+       by thread.c. */
+    int64_t edf_runtime;        /* Ticks of CPU per period, 0 if none. */
+    int64_t edf_period;         /* Ticks from one release to the next. */
+    int64_t edf_rel_deadline;   /* Ticks from release to deadline. */
+    int64_t edf_release;        /* Start of the current period. */
+    int64_t edf_deadline;       /* Deadline in the current period. */
+    int64_t edf_budget;         /* Ticks left in the current period. */
+    struct list_elem edf_elem;  /* Element in edf_list. */
+
+    /* For the multi-level feedback queue scheduler. */
+    int nice;                   /* Niceness, -20 to 20. */
+    fixed_t recent_cpu;         /* Decaying average of ticks run. */
 
     /* Owned by thread.c. */
-    unsigned magic;                     /* Detects stack overflow. */
+    char name[16];                      /* Name (for debugging purposes). */
+    struct list_elem allelem;           /* List element for all threads list. */
+    struct thread_stats stats;  /* Scheduling statistics. */
 
-    /* added variables for alarm clock */
-    int64_t wait_time;     // time when thread stops waiting 
+    /* Owned by malloc.c. */
+    struct malloc_mag mag;      /* Cached free blocks. */
 
+    /* Owned by scratch.c. */
+    struct scratch_mark scratch; /* Top of scratch memory. */
 
-    /* For priority donation */
-    int prev_priority;
-
-    struct list locks;		/* Locks held by this thread */
-    struct lock *lock_waiting;	/* The lock this thread is waiting */
+#ifdef USERPROG
+    /* Owned by userprog/process.c. */
+    uint32_t *pagedir;                  /* Page directory. */
 
-    /* For process system calls */
+    /* Owned by userprog/fpu.c. */
+    struct fpu_state *fpu;              /* Saved FPU state, or null. */
+#endif
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct hash pages;                  /* Supplemental page table. */
+    struct lock pages_lock;             /* Guards PAGES between threads. */
+    void *user_esp;                     /* User esp at last kernel entry. */
+    void *fault_next;                   /* Where a sequential fault is next. */
+    size_t fault_window;                /* Pages to map around a fault. */
+
+    /* Owned by vm/frame.c. */
+    size_t resident_cnt;                /* Its pages now in frames. */
+
+    /* Owned by vm/mmap.c. */
+    struct list mappings;               /* Memory-mapped files. */
+    int next_mapid;                     /* Identifier for next mapping. */
+    struct lock mappings_lock;          /* Guards the two above. */
+#endif
 
-    enum process_status process_status;          /* Process states. */
-    
-    /* Needed for parent process */
-    struct list children;	/* List of children */	
-    struct list_elem child_elem;
-    struct semaphore load_sema; /* Semaphore in parent */
+    /* User threads.  PROCESS is the thread that holds the state
+       of the process this thread is part of, such as its files,
+       children, and address space: itself, unless this thread
+       was started by process_thread_create().  Owned by
+       userprog/process.c. */
+    struct thread *process;
+    struct process *proc;       /* In PROCESS: the rest of its state. */
+    struct proc_stats *acct;    /* Where its work is counted, or null. */
+    struct proc_limits *limits; /* What its process may use, or null. */
+    struct process_threads *threads; /* In PROCESS: extra threads. */
+    struct uthread *uthread;    /* In an extra thread: its record. */
+    bool exiting;               /* In PROCESS: are its threads to exit? */
 
-    /* Needed for child process */
-    struct thread *parent;	/* Parent of this process */
-    int exit_status;		/* Exit status returned when it exits */
-    struct semaphore wait_sema;	/* Semaphore in child */
-    
-    struct file* executable;	/* To deny other process to executables */
+    struct dir *cwd; /* current working directory of the thread */
+    int journal_depth; /* nested journal handles, filesys/journal.c */
 
-    /* For file system calls */
-    struct list files;  /* Files list */
+    char *console_buf;       /* console output not yet written */
+    size_t console_len;      /* bytes in console_buf */
+    struct file_elem *held_files[2]; /* fds the running system call uses */
 
-    struct dir *cwd; /* current working directory of the thread */
+    /* Owned by thread.c. */
+    unsigned magic;                     /* Detects stack overflow. */
   };
 
 /* If false (default), use round-robin scheduler.
@@ -150,6 +199,22 @@ struct thread
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* Round-robin time slices, in timer ticks, for each of
+   THREAD_BAND_CNT equal bands of priorities, lowest band first.
+   Controlled by kernel command-line option "-ts". */
+#define THREAD_BAND_CNT 4
+extern unsigned thread_time_slice[THREAD_BAND_CNT];
+
+/* Ticks between rounds of aging, each of which raises the
+   priority of every thread waiting in the ready queues by one,
+   or 0 for no aging.  Controlled by kernel command-line option
+   "-age". */
+extern unsigned thread_age_ticks;
+
+/* Priority levels given to a thread woken by I/O.  Controlled by
+   kernel command-line option "-ioboost". */
+extern unsigned thread_io_boost;
+
 void thread_init (void);
 void thread_start (void);
 
@@ -157,18 +222,22 @@ bool priority_compare(const struct list_elem *a, const struct list_elem *b, void
 
 void thread_tick (void);
 void thread_print_stats (void);
+void thread_get_stats (struct thread_stats *);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
 
 void thread_block (void);
 void thread_unblock (struct thread *);
+void thread_unblock_io (struct thread *);
 
 struct thread *thread_current (void);
+struct thread *thread_process (void);
 tid_t thread_tid (void);
 const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
+void thread_free (struct thread *);
 void thread_yield (void);
 
 /* Performs some operation on thread t, given auxiliary data AUX. */
@@ -177,17 +246,25 @@ void thread_foreach (thread_action_func *, void *);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
-void thread_donate_priority (struct thread *);
-void thread_update_priority (struct thread *);
+void priority_donate (struct thread *, struct lock *);
+void priority_update (struct thread *);
 
 void thread_add_lock (struct lock *);
 void thread_remove_lock (struct lock *);
 
+bool thread_set_affinity (uint32_t cpu_mask);
+bool thread_set_edf (int64_t runtime, int64_t period, int64_t deadline);
+bool thread_preempts (const struct thread *);
+uint32_t thread_get_affinity (void);
+
 int thread_get_nice (void);
 void thread_set_nice (int);
 int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 
-void thread_sleep(int64_t);
+void thread_sleep (int64_t wake_time);
+void thread_wakeup (int64_t now);
+int thread_next_wakeup (int limit);
+void thread_skip_ticks (int64_t now, int cnt);
 
 #endif /* threads/thread.h */
@@ -0,0 +1,175 @@
+#include "threads/trace.h"
+#ifdef TRACE
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/smp.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Number of pages in the ring. */
+#define TRACE_PAGES 64
+
+/* The ring.  Event number I goes into RECORDS[I % RECORD_MAX].
+   RECORD_CNT only ever goes up, by an atomic increment, so an
+   interrupt that traces an event while another is being written
+   gets a slot of its own. */
+static struct trace_record *records;
+static uint32_t record_max;
+static uint32_t record_cnt;
+
+/* False once the ring is being dumped, so that the dump does not
+   trace itself. */
+static bool tracing;
+
+/* When tracing began, for converting cycles to time. */
+static uint64_t start_cycles;
+static int64_t start_ticks;
+
+/* Set by the "-tracedev" kernel option: name of the block device
+   to dump the ring to, instead of the console. */
+const char *trace_dev_name;
+
+/* Header in the first sector of a binary dump, followed by the
+   records, oldest first, in the sectors after it. */
+struct trace_header
+  {
+    char magic[8];              /* "PTRACE1", null-terminated. */
+    uint32_t record_size;       /* sizeof (struct trace_record). */
+    uint32_t record_cnt;        /* Number of records that follow. */
+    uint64_t cycles_per_sec;    /* Rate of the record timestamps. */
+    uint64_t event_cnt;         /* Events traced, including lost ones. */
+  };
+
+static void dump_to_block (struct block *, uint32_t first,
+                           uint64_t cycles_per_sec);
+
+/* Allocates the ring and starts tracing.  Must be called after
+   the page allocator is initialized. */
+void
+trace_init (void)
+{
+  records = palloc_get_multiple (0, TRACE_PAGES);
+  if (records == NULL)
+    {
+      printf ("trace: no memory for %d-page trace buffer\n", TRACE_PAGES);
+      return;
+    }
+  record_max = TRACE_PAGES * PGSIZE / sizeof *records;
+  start_cycles = timer_cycles ();
+  start_ticks = timer_ticks ();
+  tracing = true;
+}
+
+/* Records EVENT, with arguments A and B, for the running thread.
+   May be called in any context. */
+void
+trace_event (enum trace_event_id event, uint32_t a, uint32_t b)
+{
+  struct trace_record *r;
+
+  if (!tracing)
+    return;
+
+  r = &records[__sync_fetch_and_add (&record_cnt, 1) % record_max];
+  r->time = timer_cycles ();
+  r->event = event;
+  r->cpu = cpu_current ()->id;
+  r->tid = ((struct thread *) pg_round_down (&r))->tid;
+  r->a = a;
+  r->b = b;
+}
+
+/* Stops tracing and dumps the ring, oldest record first, to the
+   block device named by -tracedev or else to the console. */
+void
+trace_dump (void)
+{
+  uint64_t cycles_per_sec;
+  int64_t ticks;
+  uint32_t first, i;
+
+  if (!tracing)
+    return;
+  tracing = false;
+
+  ticks = timer_ticks () - start_ticks;
+  cycles_per_sec = (ticks > 0
+                    ? (timer_cycles () - start_cycles) * TIMER_FREQ / ticks
+                    : 0);
+  first = record_cnt > record_max ? record_cnt - record_max : 0;
+
+  if (trace_dev_name != NULL)
+    {
+      struct block *block = block_get_by_name (trace_dev_name);
+      if (block == NULL)
+        printf ("trace: %s: no such block device\n", trace_dev_name);
+      else if (intr_get_level () == INTR_OFF || intr_context ())
+        printf ("trace: cannot write to %s with interrupts off\n",
+                trace_dev_name);
+      else
+        {
+          dump_to_block (block, first, cycles_per_sec);
+          return;
+        }
+    }
+
+  printf ("Trace: %"PRIu32" records, %"PRIu64" cycles per second\n",
+          record_cnt - first, cycles_per_sec);
+  for (i = first; i != record_cnt; i++)
+    {
+      const struct trace_record *r = &records[i % record_max];
+      printf ("Trace record: %016"PRIx64" %"PRIu8" %"PRIu8" %"PRIu16
+              " %08"PRIx32" %08"PRIx32"\n",
+              r->time, r->event, r->cpu, r->tid, r->a, r->b);
+    }
+}
+
+/* Writes the header and then the records from number FIRST on
+   to BLOCK, as many as fit. */
+static void
+dump_to_block (struct block *block, uint32_t first, uint64_t cycles_per_sec)
+{
+  enum { PER_SECTOR = BLOCK_SECTOR_SIZE / sizeof (struct trace_record) };
+  static uint8_t sector[BLOCK_SECTOR_SIZE];
+  struct trace_header *h = (struct trace_header *) sector;
+  block_sector_t sector_cnt = block_size (block);
+  uint32_t cnt = record_cnt - first;
+  uint32_t left, i;
+  block_sector_t s;
+
+  if (sector_cnt == 0)
+    return;
+  if (cnt > (sector_cnt - 1) * PER_SECTOR)
+    {
+      first += cnt - (sector_cnt - 1) * PER_SECTOR;
+      cnt = (sector_cnt - 1) * PER_SECTOR;
+    }
+
+  memset (sector, 0, sizeof sector);
+  strlcpy (h->magic, "PTRACE1", sizeof h->magic);
+  h->record_size = sizeof (struct trace_record);
+  h->record_cnt = cnt;
+  h->cycles_per_sec = cycles_per_sec;
+  h->event_cnt = record_cnt;
+  block_write (block, 0, sector);
+
+  /* Pack whole records into each sector, wrapping around the end
+     of the ring. */
+  for (s = 1, left = cnt; left > 0; s++)
+    {
+      memset (sector, 0, sizeof sector);
+      for (i = 0; i < PER_SECTOR && left > 0; i++, left--)
+        memcpy (sector + i * sizeof (struct trace_record),
+                &records[first++ % record_max],
+                sizeof (struct trace_record));
+      block_write (block, s, sector);
+    }
+  printf ("Trace: wrote %"PRIu32" records to %s\n", cnt, trace_dev_name);
+}
+#endif /* TRACE */
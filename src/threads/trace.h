@@ -0,0 +1,69 @@
+#ifndef THREADS_TRACE_H
+#define THREADS_TRACE_H
+
+#include <stdint.h>
+
+/* Kernel event tracing.
+
+   A kernel built with "make TRACE=1" records events at static
+   tracepoints in the scheduler, locks, block layer, page fault
+   handler, and system call handler.  Each event is a compact
+   binary record, written into an in-memory ring without taking
+   any lock or turning off interrupts, so that tracing disturbs
+   the timing it is meant to show as little as possible.  When
+   the ring is full, the oldest records are overwritten.
+
+   At shutdown the ring is dumped to the console, one "Trace
+   record:" line per event, or with "-tracedev=BDEV" in binary
+   to block device BDEV.  The "utils/trace2json" program turns
+   either form into Chrome trace JSON, for viewing in
+   chrome://tracing or Perfetto.
+
+   A kernel built without TRACE has no tracepoints at all. */
+
+/* Events.  The "utils/trace2json" program knows them by number,
+   so add new ones only at the end. */
+enum trace_event_id
+  {
+    TRACE_SCHEDULE,             /* Switch: old tid, new tid. */
+    TRACE_LOCK_ACQUIRE,         /* Lock wanted: lock, holder's tid. */
+    TRACE_LOCK_ACQUIRED,        /* Lock obtained: lock. */
+    TRACE_LOCK_RELEASE,         /* Lock released: lock. */
+    TRACE_BLOCK_SUBMIT,         /* I/O queued: sector, count. */
+    TRACE_BLOCK_DONE,           /* I/O completed: sector, count. */
+    TRACE_PAGE_FAULT,           /* Page fault: address, eip. */
+    TRACE_SYSCALL,              /* System call: number, first arg. */
+    TRACE_SYSCALL_DONE          /* Return: number, result. */
+  };
+
+/* Set in the count argument of block events for a write. */
+#define TRACE_BLOCK_WRITE 0x80000000u
+
+/* A trace record, as kept in memory and dumped in binary. */
+struct trace_record
+  {
+    uint64_t time;              /* timer_cycles() when it happened. */
+    uint8_t event;              /* A trace_event_id. */
+    uint8_t cpu;                /* CPU number, from cpu_current(). */
+    uint16_t tid;               /* Running thread's tid. */
+    uint32_t a, b;              /* Event-specific arguments. */
+  }
+__attribute__ ((packed));
+
+#ifdef TRACE
+extern const char *trace_dev_name;
+
+void trace_init (void);
+void trace_event (enum trace_event_id, uint32_t a, uint32_t b);
+void trace_dump (void);
+
+/* Records event TRACE_<ID> with arguments A and B. */
+#define TRACE_EVENT(ID, A, B) \
+        trace_event (TRACE_##ID, (uint32_t) (A), (uint32_t) (B))
+#else
+static inline void trace_init (void) { }
+static inline void trace_dump (void) { }
+#define TRACE_EVENT(ID, A, B) ((void) 0)
+#endif
+
+#endif /* threads/trace.h */
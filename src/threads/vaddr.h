@@ -86,4 +86,29 @@ vtop (const void *vaddr)
   return (uintptr_t) vaddr - (uintptr_t) PHYS_BASE;
 }
 
+/* Fills the page at KPAGE, which must be page-aligned, with
+   zeros, a word at a time. */
+static inline void
+pg_zero (void *kpage)
+{
+  uint32_t cnt = PGSIZE / sizeof (uint32_t);
+
+  ASSERT (pg_ofs (kpage) == 0);
+  asm volatile ("rep stosl"
+                : "+D" (kpage), "+c" (cnt) : "a" (0) : "memory");
+}
+
+/* Copies the page at SRC to the page at DST, which must both be
+   page-aligned and must not be the same page, a word at a
+   time. */
+static inline void
+pg_copy (void *dst, const void *src)
+{
+  uint32_t cnt = PGSIZE / sizeof (uint32_t);
+
+  ASSERT (pg_ofs (dst) == 0 && pg_ofs (src) == 0);
+  asm volatile ("rep movsl"
+                : "+D" (dst), "+S" (src), "+c" (cnt) : : "memory");
+}
+
 #endif /* threads/vaddr.h */
@@ -0,0 +1,237 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+
+/* Workqueues.
+
+   Each workqueue has a fixed pool of kernel threads, all at the
+   priority given to workqueue_init(), that take items off its
+   pending list in FIFO order.  Queuing an item only turns
+   interrupts off briefly and ups a semaphore, so it may be done
+   from an interrupt handler.
+
+   Delayed items wait in one list for all queues, soonest first.
+   At each tick the timer calls workqueue_tick(), which moves the
+   items that have come due onto their queues' pending lists, and
+   in tickless mode the idle thread asks workqueue_next_due() how
+   long it may leave the timer stopped. */
+
+/* Number of threads in system_wq. */
+#define SYSTEM_WQ_THREADS 2
+
+struct workqueue system_wq;
+
+/* Delayed work items of every queue, by due tick. */
+static struct list delayed_work = LIST_INITIALIZER (delayed_work);
+
+static thread_func worker NO_RETURN;
+static bool due_less (const struct list_elem *, const struct list_elem *,
+                      void *aux);
+static void make_pending (struct workqueue *, struct work *);
+
+/* Initializes WQ and starts THREAD_CNT threads at PRIORITY to
+   run its work, named after NAME, which must stay valid as long
+   as WQ does.  Returns false if not even one thread could be
+   started, in which case work queued on WQ never runs. */
+bool
+workqueue_init (struct workqueue *wq, const char *name, int thread_cnt,
+                int priority)
+{
+  int started = 0;
+  int i;
+
+  ASSERT (thread_cnt > 0);
+  ASSERT (priority >= PRI_MIN && priority <= PRI_MAX);
+
+  wq->name = name;
+  wq->priority = priority;
+  list_init (&wq->pending);
+  sema_init (&wq->ready, 0);
+
+  for (i = 0; i < thread_cnt; i++)
+    {
+      char thread_name[16];
+
+      snprintf (thread_name, sizeof thread_name, "%s/%d", name, i);
+      if (thread_create (thread_name, priority, worker, wq) != TID_ERROR)
+        started++;
+    }
+  return started > 0;
+}
+
+/* Starts system_wq. */
+void
+workqueue_start (void)
+{
+  if (!workqueue_init (&system_wq, "kworker", SYSTEM_WQ_THREADS,
+                       PRI_DEFAULT))
+    PANIC ("could not start system workqueue");
+}
+
+/* Initializes W to call FUNC with AUX. */
+void
+work_init (struct work *w, work_func *func, void *aux)
+{
+  ASSERT (func != NULL);
+
+  w->func = func;
+  w->aux = aux;
+  w->wq = NULL;
+  w->due = 0;
+  w->state = WORK_IDLE;
+}
+
+/* Queues W on WQ to run as soon as a thread is free.  Returns
+   false, doing nothing, if W is already queued or delayed.  May
+   be called from an interrupt handler. */
+bool
+work_queue (struct workqueue *wq, struct work *w)
+{
+  enum intr_level old_level = intr_disable ();
+  bool queued = w->state == WORK_IDLE;
+
+  if (queued)
+    make_pending (wq, w);
+  intr_set_level (old_level);
+  if (queued)
+    sema_up (&wq->ready);
+  return queued;
+}
+
+/* Queues W on WQ once TICKS timer ticks have passed, or at once
+   if TICKS is not positive.  Returns false, doing nothing, if W
+   is already queued or delayed.  May be called from an interrupt
+   handler. */
+bool
+work_queue_delayed (struct workqueue *wq, struct work *w, int64_t ticks)
+{
+  enum intr_level old_level;
+  bool queued;
+
+  if (ticks <= 0)
+    return work_queue (wq, w);
+
+  old_level = intr_disable ();
+  queued = w->state == WORK_IDLE;
+  if (queued)
+    {
+      w->wq = wq;
+      w->due = timer_ticks () + ticks;
+      w->state = WORK_DELAYED;
+      list_insert_ordered (&delayed_work, &w->elem, due_less, NULL);
+    }
+  intr_set_level (old_level);
+  return queued;
+}
+
+/* Takes W off its queue, or out of the delayed list, so that it
+   does not run.  Returns true if it was queued or delayed.
+   Returns false if it was not, in which case it may be running,
+   and this does not wait for it to finish. */
+bool
+work_cancel (struct work *w)
+{
+  enum intr_level old_level = intr_disable ();
+  bool cancelled = w->state != WORK_IDLE;
+
+  if (cancelled)
+    {
+      list_remove (&w->elem);
+      w->state = WORK_IDLE;
+    }
+  intr_set_level (old_level);
+  return cancelled;
+}
+
+/* Queues the delayed work that is due at tick NOW or earlier.
+   Called by the timer, at each tick, in interrupt context. */
+void
+workqueue_tick (int64_t now)
+{
+  enum intr_level old_level = intr_disable ();
+
+  while (!list_empty (&delayed_work))
+    {
+      struct work *w = list_entry (list_front (&delayed_work),
+                                   struct work, elem);
+      if (w->due > now)
+        break;
+      list_pop_front (&delayed_work);
+      make_pending (w->wq, w);
+      sema_up (&w->wq->ready);
+    }
+  intr_set_level (old_level);
+}
+
+/* Returns the number of ticks, at least 1 and at most LIMIT,
+   from NOW until the next delayed work item is due, or LIMIT if
+   none is due that soon.  Interrupts must be off. */
+int
+workqueue_next_due (int64_t now, int limit)
+{
+  struct work *w;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (limit >= 1);
+
+  if (list_empty (&delayed_work))
+    return limit;
+  w = list_entry (list_front (&delayed_work), struct work, elem);
+  if (w->due - now >= limit)
+    return limit;
+  return w->due - now > 1 ? w->due - now : 1;
+}
+
+/* Puts W at the end of WQ's pending list.  The caller must then
+   up WQ's semaphore to wake a worker.  Interrupts must be off. */
+static void
+make_pending (struct workqueue *wq, struct work *w)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  w->wq = wq;
+  w->state = WORK_PENDING;
+  list_push_back (&wq->pending, &w->elem);
+}
+
+/* Thread function for workqueue WQ_'s threads. */
+static void
+worker (void *wq_)
+{
+  struct workqueue *wq = wq_;
+
+  for (;;)
+    {
+      enum intr_level old_level;
+      struct work *w;
+
+      /* An item cancelled before any worker reached it leaves
+         the semaphore one too high, so the list may be empty. */
+      sema_down (&wq->ready);
+      old_level = intr_disable ();
+      if (list_empty (&wq->pending))
+        {
+          intr_set_level (old_level);
+          continue;
+        }
+      w = list_entry (list_pop_front (&wq->pending), struct work, elem);
+      w->state = WORK_IDLE;
+      intr_set_level (old_level);
+
+      /* W may be freed or queued again by FUNC, so don't touch it
+         afterward. */
+      w->func (w->aux);
+    }
+}
+
+/* Orders work items by due tick. */
+static bool
+due_less (const struct list_elem *a, const struct list_elem *b,
+          void *aux UNUSED)
+{
+  return (list_entry (a, struct work, elem)->due
+          < list_entry (b, struct work, elem)->due);
+}
@@ -0,0 +1,61 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/synch.h"
+
+/* Function run by a work item. */
+typedef void work_func (void *aux);
+
+/* States of a work item. */
+enum work_state
+  {
+    WORK_IDLE,                  /* Not queued, though maybe running. */
+    WORK_DELAYED,               /* Waiting for its tick to come. */
+    WORK_PENDING                /* Waiting for a worker thread. */
+  };
+
+/* A work item: a function to call, later, in one of a
+   workqueue's threads.  The owner embeds it in its own data and
+   may queue it again once it is idle, even from inside FUNC. */
+struct work
+  {
+    struct list_elem elem;      /* In a pending list or delayed_work. */
+    work_func *func;            /* Function to call. */
+    void *aux;                  /* Its argument. */
+    struct workqueue *wq;       /* Queue it was last queued on. */
+    int64_t due;                /* While delayed, tick to queue it at. */
+    enum work_state state;      /* Where it is now. */
+  };
+
+/* A pool of kernel threads that run queued work items in the
+   order they were queued.  Its lists are shared with the timer
+   interrupt, so they are protected by turning interrupts off. */
+struct workqueue
+  {
+    const char *name;           /* Name, for the threads. */
+    int priority;               /* Priority of the threads. */
+    struct list pending;        /* Work ready to run, oldest first. */
+    struct semaphore ready;     /* Up once for each item queued. */
+  };
+
+/* General-purpose queue, with a few threads at PRI_DEFAULT, for
+   work that needs no queue of its own. */
+extern struct workqueue system_wq;
+
+bool workqueue_init (struct workqueue *, const char *name,
+                     int thread_cnt, int priority);
+void workqueue_start (void);
+
+void work_init (struct work *, work_func *, void *aux);
+bool work_queue (struct workqueue *, struct work *);
+bool work_queue_delayed (struct workqueue *, struct work *, int64_t ticks);
+bool work_cancel (struct work *);
+
+/* For the timer. */
+void workqueue_tick (int64_t now);
+int workqueue_next_due (int64_t now, int limit);
+
+#endif /* threads/workqueue.h */
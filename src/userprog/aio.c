@@ -0,0 +1,214 @@
+#include "userprog/aio.h"
+#include <aio.h>
+#include <debug.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/process.h"
+
+/* Asynchronous file I/O.
+
+   Each request is a work item on aio_wq, whose threads do the
+   file system calls that a process would otherwise block on.  A
+   finished request goes on its process's done list until the
+   process reaps it.  The workers run in no process's address
+   space, so the data moves through a kernel page: a write's is
+   copied in before the request is queued, and a read's is copied
+   out when it is reaped. */
+
+/* Number of threads in aio_wq, and so the most transfers that
+   can be waiting on the disk at once. */
+#define AIO_THREADS 4
+
+/* A process's asynchronous requests. */
+struct aio_context
+  {
+    struct lock lock;           /* Guards everything below. */
+    struct condition done_cond; /* Signalled when one finishes. */
+    struct list done;           /* Finished, not yet reaped. */
+    int in_flight;              /* Queued or in progress. */
+    int cnt;                    /* Requests in flight or done. */
+  };
+
+static struct workqueue aio_wq;
+
+/* Serializes the making of contexts, which a process's user
+   threads could otherwise race to do. */
+static struct lock aio_lock;
+
+static work_func aio_work;
+static struct aio_context *aio_context (void);
+
+/* Starts the threads that carry out requests. */
+void
+aio_init (void)
+{
+  ASSERT (AIO_MAX_LENGTH <= PGSIZE);
+
+  lock_init (&aio_lock);
+  if (!workqueue_init (&aio_wq, "aio", AIO_THREADS, PRI_DEFAULT))
+    PANIC ("could not start aio workqueue");
+}
+
+/* Returns a new request with a data page, for the caller to fill
+   in, or a null pointer if memory is not available. */
+struct aio_request *
+aio_request_create (void)
+{
+  struct aio_request *r = malloc (sizeof *r);
+
+  if (r == NULL)
+    return NULL;
+  r->data = palloc_get_page (0);
+  if (r->data == NULL)
+    {
+      free (r);
+      return NULL;
+    }
+  r->file = NULL;
+  work_init (&r->work, aio_work, r);
+  return r;
+}
+
+/* Frees R, which must not be queued, and closes its file. */
+void
+aio_request_free (struct aio_request *r)
+{
+  if (r != NULL)
+    {
+      file_close (r->file);
+      palloc_free_page (r->data);
+      free (r);
+    }
+}
+
+/* Queues R, made by aio_request_create() and filled in, for the
+   running process.  Returns false, leaving R to the caller, if
+   the process already has AIO_MAX_REQUESTS outstanding or memory
+   is not available. */
+bool
+aio_submit (struct aio_request *r)
+{
+  struct aio_context *ctx = aio_context ();
+  bool ok;
+
+  ASSERT (r->length >= 0 && r->length <= AIO_MAX_LENGTH);
+
+  if (ctx == NULL)
+    return false;
+  lock_acquire (&ctx->lock);
+  ok = ctx->cnt < AIO_MAX_REQUESTS;
+  if (ok)
+    {
+      ctx->cnt++;
+      ctx->in_flight++;
+    }
+  lock_release (&ctx->lock);
+
+  if (ok)
+    {
+      r->ctx = ctx;
+      work_queue (&aio_wq, &r->work);
+    }
+  return ok;
+}
+
+/* Takes a finished request off the running process's done list
+   and returns it, for the caller to free with aio_request_free().
+   If none has finished, waits for one if WAIT is true and any is
+   in flight; otherwise returns a null pointer. */
+struct aio_request *
+aio_next_done (bool wait)
+{
+  struct aio_context *ctx = thread_process ()->proc->aio;
+  struct aio_request *r = NULL;
+
+  if (ctx == NULL)
+    return NULL;
+  lock_acquire (&ctx->lock);
+  while (wait && list_empty (&ctx->done) && ctx->in_flight > 0)
+    cond_wait (&ctx->done_cond, &ctx->lock);
+  if (!list_empty (&ctx->done))
+    {
+      r = list_entry (list_pop_front (&ctx->done), struct aio_request, elem);
+      ctx->cnt--;
+    }
+  lock_release (&ctx->lock);
+  return r;
+}
+
+/* Waits for the running process's requests to finish and frees
+   them, unreaped, along with their context.  Called as the
+   process exits. */
+void
+aio_exit (void)
+{
+  struct process *p = thread_process ()->proc;
+  struct aio_context *ctx = p->aio;
+
+  if (ctx == NULL)
+    return;
+  lock_acquire (&ctx->lock);
+  while (ctx->in_flight > 0)
+    cond_wait (&ctx->done_cond, &ctx->lock);
+  lock_release (&ctx->lock);
+
+  while (!list_empty (&ctx->done))
+    aio_request_free (list_entry (list_pop_front (&ctx->done),
+                                  struct aio_request, elem));
+  free (ctx);
+  p->aio = NULL;
+}
+
+/* Returns the running process's request context, creating it if
+   it does not exist yet, or a null pointer if memory is
+   exhausted. */
+static struct aio_context *
+aio_context (void)
+{
+  struct process *p = thread_process ()->proc;
+  struct aio_context *ctx;
+
+  lock_acquire (&aio_lock);
+  ctx = p->aio;
+  if (ctx == NULL)
+    {
+      ctx = malloc (sizeof *ctx);
+      if (ctx != NULL)
+        {
+          lock_init (&ctx->lock);
+          cond_init (&ctx->done_cond);
+          list_init (&ctx->done);
+          ctx->in_flight = 0;
+          ctx->cnt = 0;
+          p->aio = ctx;
+        }
+    }
+  lock_release (&aio_lock);
+  return ctx;
+}
+
+/* Work function that carries out request R_ and posts it to its
+   process's done list. */
+static void
+aio_work (void *r_)
+{
+  struct aio_request *r = r_;
+  struct aio_context *ctx = r->ctx;
+
+  if (r->write)
+    r->result = file_write_at (r->file, r->data, r->length, r->offset);
+  else
+    r->result = file_read_at (r->file, r->data, r->length, r->offset);
+
+  /* The process may reap and free R, and exit and free CTX, as
+     soon as the lock is released. */
+  lock_acquire (&ctx->lock);
+  list_push_back (&ctx->done, &r->elem);
+  ctx->in_flight--;
+  cond_broadcast (&ctx->done_cond, &ctx->lock);
+  lock_release (&ctx->lock);
+}
@@ -0,0 +1,35 @@
+#ifndef USERPROG_AIO_H
+#define USERPROG_AIO_H
+
+#include <list.h>
+#include <stdbool.h>
+#include "filesys/off_t.h"
+#include "threads/workqueue.h"
+
+struct aio_context;
+
+/* An asynchronous read or write of a file, carried out by one of
+   the aio workqueue's threads with its data in a kernel page. */
+struct aio_request
+  {
+    struct list_elem elem;      /* In its process's done list. */
+    struct work work;           /* Does the transfer. */
+    struct aio_context *ctx;    /* Owning process's requests. */
+    struct file *file;          /* Private to the request. */
+    bool write;                 /* Write rather than read? */
+    void *data;                 /* AIO_MAX_LENGTH bytes of data. */
+    void *buffer;               /* User buffer for a read's data. */
+    off_t length;               /* Bytes to move. */
+    off_t offset;               /* Where in FILE. */
+    unsigned tag;               /* Returned with the result. */
+    int result;                 /* Bytes moved or -1, once done. */
+  };
+
+void aio_init (void);
+struct aio_request *aio_request_create (void);
+void aio_request_free (struct aio_request *);
+bool aio_submit (struct aio_request *);
+struct aio_request *aio_next_done (bool wait);
+void aio_exit (void);
+
+#endif /* userprog/aio.h */
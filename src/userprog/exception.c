@@ -1,15 +1,30 @@
 #include "userprog/exception.h"
 #include <inttypes.h>
+#include <proc-stats.h>
 #include <stdio.h>
+#include <vm-stats.h>
 #include "userprog/gdt.h"
+#include "userprog/process.h"
+#include "userprog/syscall.h"
+#include "userprog/uaccess.h"
+#include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 #include "threads/vaddr.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
 
+/* Number of page faults that did not bring in a page. */
+static long long invalid_fault_cnt;
+
 static void kill (struct intr_frame *);
+static void debug_exception (struct intr_frame *);
+static void nmi (struct intr_frame *);
 static void page_fault (struct intr_frame *);
 
 /* Registers handlers for interrupts that can be caused by user
@@ -44,10 +59,9 @@ exception_init (void)
      caused indirectly, e.g. #DE can be caused by dividing by
      0.  */
   intr_register_int (0, 0, INTR_ON, kill, "#DE Divide Error");
-  intr_register_int (1, 0, INTR_ON, kill, "#DB Debug Exception");
+  intr_register_int (1, 0, INTR_ON, debug_exception, "#DB Debug Exception");
   intr_register_int (6, 0, INTR_ON, kill, "#UD Invalid Opcode Exception");
-  intr_register_int (7, 0, INTR_ON, kill,
-                     "#NM Device Not Available Exception");
+  /* #NM is handled by userprog/fpu.c. */
   intr_register_int (11, 0, INTR_ON, kill, "#NP Segment Not Present");
   intr_register_int (12, 0, INTR_ON, kill, "#SS Stack Fault Exception");
   intr_register_int (13, 0, INTR_ON, kill, "#GP General Protection Exception");
@@ -55,6 +69,9 @@ exception_init (void)
   intr_register_int (19, 0, INTR_ON, kill,
                      "#XF SIMD Floating-Point Exception");
 
+  /* An NMI may arrive on the SYSENTER stack; see nmi(). */
+  intr_register_int (2, 0, INTR_OFF, nmi, "NMI Interrupt");
+
   /* Most exceptions can be handled with interrupts turned on.
      We need to disable interrupts for page faults because the
      fault address is stored in CR2 and needs to be preserved. */
@@ -65,7 +82,16 @@ exception_init (void)
 void
 exception_print_stats (void) 
 {
-  printf ("Exception: %lld page faults\n", page_fault_cnt);
+  printf ("Exception: %lld page faults (%lld invalid)\n",
+          page_fault_cnt, invalid_fault_cnt);
+}
+
+/* Fills in the page fault counts in STATS. */
+void
+exception_get_stats (struct vm_stats *stats) 
+{
+  stats->fault_cnt = page_fault_cnt;
+  stats->invalid_cnt = invalid_fault_cnt;
 }
 
 /* Handler for an exception (probably) caused by a user process. */
@@ -109,6 +135,35 @@ kill (struct intr_frame *f)
     }
 }
 
+/* Handler for a debug exception.  A user program that
+   single-steps into SYSENTER traps on the first instruction of
+   sysenter_entry, in ring 0 and on its small stack, where
+   neither the running thread nor anything that sleeps may be
+   touched.  Stop single-stepping the kernel and let
+   sysenter_entry give the program its TF back.  Any other debug
+   exception is handled like the rest. */
+static void
+debug_exception (struct intr_frame *f) 
+{
+  if (f->cs == SEL_KCSEG && f->eip == sysenter_entry)
+    {
+      f->eflags &= ~FLAG_TF;
+      sysenter_tf = true;
+      return;
+    }
+  kill (f);
+}
+
+/* Handler for a non-maskable interrupt.  Nothing in the kernel
+   sends them, and there is nothing to be done here about the
+   hardware errors they report, so ignore them.  Printing, as for
+   an unexpected interrupt, would take the console lock, which
+   cannot be done from the SYSENTER stack. */
+static void
+nmi (struct intr_frame *f UNUSED) 
+{
+}
+
 /* Page fault handler.  This is a skeleton that must be filled in
    to implement virtual memory.  Some solutions to project 2 may
    also require modifying this code.
@@ -136,6 +191,7 @@ page_fault (struct intr_frame *f)
      [IA32-v3a] 5.15 "Interrupt 14--Page Fault Exception
      (#PF)". */
   asm ("movl %%cr2, %0" : "=r" (fault_addr));
+  TRACE_EVENT (PAGE_FAULT, fault_addr, f->eip);
 
   /* Turn interrupts back on (they were only off so that we could
      be assured of reading CR2 before it changed). */
@@ -143,12 +199,39 @@ page_fault (struct intr_frame *f)
 
   /* Count page faults. */
   page_fault_cnt++;
+  if(thread_current ()->acct) thread_current ()->acct->fault_cnt++;
 
   /* Determine cause. */
   not_present = (f->error_code & PF_P) == 0;
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
   
+#ifdef VM
+  // a fault in the kernel uses the esp saved by syscall_handler()
+  if(user) thread_current ()->user_esp = f->esp;
+
+  // bring in a page that is in the supplemental page table,
+  // or grow the stack
+  if(not_present && is_user_vaddr (fault_addr) && page_in (fault_addr, write))
+  {
+    // a user fault goes straight back: pay for its disk use now
+    if(user) process_io_throttle ();
+    return;
+  }
+
+  // give a copy-on-write page its own frame on the first write
+  if(!not_present && write && is_user_vaddr (fault_addr)
+     && page_unshare (fault_addr))
+    return;
+#endif
+
+  invalid_fault_cnt++;
+
+  // a user pointer touched by copy_from_user() and friends
+  // turned out to be bad: make the access fail
+  if(!user && is_user_vaddr (fault_addr) && uaccess_fixup (f))
+    return;
+
   // address is not mapped
   if(not_present) exit(-1);
 
@@ -0,0 +1,206 @@
+#include "userprog/fpu.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include "userprog/gdt.h"
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/kmem.h"
+
+/* Bytes of FPU state: what FXSAVE stores, which is more than
+   FNSAVE's 108 bytes. */
+#define FPU_STATE_SIZE 512
+
+/* Alignment that FXSAVE and FXRSTOR require. */
+#define FPU_STATE_ALIGN 16
+
+/* Saved FPU state.  Objects from the cache are only 8-byte
+   aligned, so the state starts at the first suitably aligned
+   byte of AREA. */
+struct fpu_state
+  {
+    uint8_t area[FPU_STATE_SIZE + FPU_STATE_ALIGN - 8];
+  };
+
+/* Cache of save areas. */
+static struct kmem_cache fpu_cache;
+
+/* True if the CPU has FXSAVE and FXRSTOR, which save SSE state
+   along with the x87 FPU's. */
+static bool use_fxsr;
+
+/* Thread whose state is in the FPU, or a null pointer if none.
+   Accessed only with interrupts off. */
+static struct thread *fpu_owner;
+
+static intr_handler_func fpu_trap;
+
+/* Returns the aligned save area in S. */
+static void *
+state_area (struct fpu_state *s) 
+{
+  return (void *) ROUND_UP ((uintptr_t) s->area, FPU_STATE_ALIGN);
+}
+
+/* Saves the FPU's state into S. */
+static void
+state_save (struct fpu_state *s) 
+{
+  if (use_fxsr)
+    asm volatile ("fxsave (%0)" : : "r" (state_area (s)) : "memory");
+  else
+    {
+      /* FNSAVE also resets the FPU, so reload what it saved. */
+      asm volatile ("fnsave (%0); frstor (%0)"
+                    : : "r" (state_area (s)) : "memory");
+    }
+}
+
+/* Loads the FPU's state from S. */
+static void
+state_load (struct fpu_state *s) 
+{
+  if (use_fxsr)
+    asm volatile ("fxrstor (%0)" : : "r" (state_area (s)) : "memory");
+  else
+    asm volatile ("frstor (%0)" : : "r" (state_area (s)) : "memory");
+}
+
+/* Sets up the FPU and the #NM handler.  The kernel itself never
+   uses the FPU: it is compiled with -msoft-float. */
+void
+fpu_init (void) 
+{
+  uint32_t cr0;
+
+  kmem_cache_init (&fpu_cache, "fpu", sizeof (struct fpu_state), NULL);
+  intr_register_int (7, 0, INTR_ON, fpu_trap,
+                     "#NM Device Not Available Exception");
+  if (!cpu_has (CPUID_FPU))
+    return;
+
+  /* Report FPU errors as #MF, stop emulating the FPU, and trap
+     the first FPU instruction, including WAIT. */
+  cr0 = cr0_read ();
+  cr0 = (cr0 & ~CR0_EM) | CR0_MP | CR0_NE | CR0_TS;
+  cr0_write (cr0);
+
+  use_fxsr = cpu_has (CPUID_FXSR);
+  if (use_fxsr)
+    cr4_write (cr4_read () | CR4_OSFXSR
+               | (cpu_has (CPUID_SSE) ? CR4_OSXMMEXCPT : 0));
+}
+
+/* Called on every switch to thread T.  Lets T use the FPU
+   without a trap if it owns it, and otherwise makes its first
+   FPU instruction trap. */
+void
+fpu_activate (struct thread *t) 
+{
+  enum intr_level old_level = intr_disable ();
+  uint32_t cr0 = cr0_read ();
+  uint32_t new_cr0;
+
+  new_cr0 = fpu_owner == t ? cr0 & ~CR0_TS : cr0 | CR0_TS;
+  if (new_cr0 != cr0)
+    cr0_write (new_cr0);
+  intr_set_level (old_level);
+}
+
+/* #NM handler: makes the running process the owner of the FPU,
+   giving it a fresh FPU state if it has none yet.  Kills the
+   process if there is no memory for its state or no FPU. */
+static void
+fpu_trap (struct intr_frame *f) 
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  bool fresh = false;
+
+  if (f->cs != SEL_UCSEG)
+    PANIC ("kernel used the FPU at %p", f->eip);
+  if (!cpu_has (CPUID_FPU))
+    thread_exit ();
+
+  /* Allocation may sleep, so do it before turning interrupts
+     off. */
+  if (cur->fpu == NULL)
+    {
+      cur->fpu = kmem_cache_alloc (&fpu_cache);
+      if (cur->fpu == NULL)
+        thread_exit ();
+      fresh = true;
+    }
+
+  /* A thread switch in the middle would set CR0.TS again. */
+  old_level = intr_disable ();
+  asm volatile ("clts");
+  if (fpu_owner != cur)
+    {
+      if (fpu_owner != NULL)
+        state_save (fpu_owner->fpu);
+      if (fresh)
+        {
+          asm volatile ("fninit");
+          if (use_fxsr && cpu_has (CPUID_SSE))
+            {
+              /* Mask all SSE exceptions, as FNINIT does x87 ones. */
+              uint32_t mxcsr = 0x1f80;
+              asm volatile ("ldmxcsr %0" : : "m" (mxcsr));
+            }
+        }
+      else
+        state_load (cur->fpu);
+      fpu_owner = cur;
+    }
+  intr_set_level (old_level);
+}
+
+/* Gives the running thread, a new process being forked from
+   PARENT, a copy of PARENT's FPU state.  Returns false if memory
+   is short. */
+bool
+fpu_fork (struct thread *parent) 
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  if (parent->fpu == NULL)
+    return true;
+  cur->fpu = kmem_cache_alloc (&fpu_cache);
+  if (cur->fpu == NULL)
+    return false;
+
+  /* Bring PARENT's saved state up to date if the FPU holds it.
+     The FPU stays PARENT's afterward. */
+  old_level = intr_disable ();
+  if (fpu_owner == parent)
+    {
+      asm volatile ("clts");
+      state_save (parent->fpu);
+      fpu_activate (cur);
+    }
+  memcpy (state_area (cur->fpu), state_area (parent->fpu), FPU_STATE_SIZE);
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Releases the running thread's FPU state. */
+void
+fpu_exit (void) 
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (fpu_owner == cur)
+    fpu_owner = NULL;
+  intr_set_level (old_level);
+
+  if (cur->fpu != NULL)
+    {
+      kmem_cache_free (&fpu_cache, cur->fpu);
+      cur->fpu = NULL;
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef USERPROG_FPU_H
+#define USERPROG_FPU_H
+
+#include <stdbool.h>
+#include "threads/thread.h"
+
+/* Lazy x87 FPU and SSE context switching for user processes.
+
+   A process gets a save area for the FPU's state the first time
+   it uses the FPU, so that a process that never does pays
+   nothing.  The FPU keeps the state of the last process that
+   used it, its "owner", across context switches.  Switching to
+   any other thread sets CR0.TS, so that the next FPU
+   instruction raises #NM, whose handler saves the owner's state,
+   loads the running process's, and makes it the owner. */
+
+void fpu_init (void);
+void fpu_activate (struct thread *);
+bool fpu_fork (struct thread *parent);
+void fpu_exit (void);
+
+#endif /* userprog/fpu.h */
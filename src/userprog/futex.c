@@ -0,0 +1,184 @@
+#include "userprog/futex.h"
+#include <debug.h>
+#include <hash.h>
+#include <stdint.h>
+#include "userprog/uaccess.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* The threads waiting on one futex.
+
+   A futex is named by the page directory and user virtual
+   address of its word, not by the word's physical address.  No
+   writable page is shared between address spaces here, and a
+   frame is not a stable name anyway: under VM the page may be
+   evicted, and after fork() a copy-on-write frame is briefly
+   shared by two processes whose futexes must stay apart. */
+struct futex
+  {
+    struct hash_elem elem;      /* Element in futexes. */
+    uint32_t *pd;               /* Page directory. */
+    const int *uaddr;           /* User address of the word. */
+    struct condition cond;      /* Where the waiters sleep. */
+    int sleeping;               /* Waiters not yet woken. */
+    int refs;                   /* Waiters still in futex_wait(). */
+  };
+
+/* Futexes with at least one waiter, and the lock that protects
+   them and every struct futex in them. */
+static struct hash futexes;
+static struct lock futex_lock;
+
+static hash_hash_func futex_hash;
+static hash_less_func futex_less;
+
+/* Initializes the futex table. */
+void
+futex_init (void)
+{
+  hash_init (&futexes, futex_hash, futex_less, NULL);
+  lock_init (&futex_lock);
+}
+
+/* Returns the futex at UADDR in the running process, or a null
+   pointer if nobody waits on it.  futex_lock must be held. */
+static struct futex *
+futex_lookup (const int *uaddr)
+{
+  struct futex key;
+  struct hash_elem *e;
+
+  key.pd = thread_current ()->pagedir;
+  key.uaddr = uaddr;
+  e = hash_find (&futexes, &key.elem);
+  return e != NULL ? hash_entry (e, struct futex, elem) : NULL;
+}
+
+/* If the int at UADDR in user memory equals VAL, sleeps until
+   futex_wake() is called for UADDR and returns 0.  Otherwise
+   returns -1 at once, as it does if UADDR is misaligned, the
+   kernel is out of memory, or the process is exiting.  Returns
+   -2 if UADDR is not a valid user address. */
+int
+futex_wait (const int *uaddr, int val)
+{
+  struct futex *f;
+  int cur;
+
+  if ((uintptr_t) uaddr % sizeof *uaddr != 0)
+    return -1;
+
+  lock_acquire (&futex_lock);
+  if (thread_process ()->exiting)
+    {
+      /* futex_wake_all() has been called, or is about to be. */
+      lock_release (&futex_lock);
+      return -1;
+    }
+  if (!copy_from_user (&cur, uaddr, sizeof cur))
+    {
+      lock_release (&futex_lock);
+      return -2;
+    }
+  if (cur != val)
+    {
+      lock_release (&futex_lock);
+      return -1;
+    }
+
+  f = futex_lookup (uaddr);
+  if (f == NULL)
+    {
+      f = malloc (sizeof *f);
+      if (f == NULL)
+        {
+          lock_release (&futex_lock);
+          return -1;
+        }
+      f->pd = thread_current ()->pagedir;
+      f->uaddr = uaddr;
+      cond_init (&f->cond);
+      f->sleeping = f->refs = 0;
+      hash_insert (&futexes, &f->elem);
+    }
+
+  f->sleeping++;
+  f->refs++;
+  cond_wait (&f->cond, &futex_lock);
+  if (--f->refs == 0)
+    {
+      hash_delete (&futexes, &f->elem);
+      free (f);
+    }
+  lock_release (&futex_lock);
+  return 0;
+}
+
+/* Wakes up to CNT threads waiting on the futex at UADDR, highest
+   priority first, and returns the number woken. */
+int
+futex_wake (const int *uaddr, int cnt)
+{
+  struct futex *f;
+  int woken = 0;
+
+  lock_acquire (&futex_lock);
+  f = futex_lookup (uaddr);
+  if (f != NULL)
+    for (; woken < cnt && f->sleeping > 0; woken++)
+      {
+        f->sleeping--;
+        cond_signal (&f->cond, &futex_lock);
+      }
+  lock_release (&futex_lock);
+  return woken;
+}
+
+/* Wakes every thread waiting on a futex in the address space
+   with page directory PD, because its process is exiting.  The
+   caller must have set the process's EXITING first, so that no
+   thread starts waiting afterward. */
+void
+futex_wake_all (uint32_t *pd)
+{
+  struct hash_iterator i;
+
+  /* The threads woken need futex_lock to leave futex_wait(), so
+     none of them changes the table while we walk it. */
+  lock_acquire (&futex_lock);
+  hash_first (&i, &futexes);
+  while (hash_next (&i))
+    {
+      struct futex *f = hash_entry (hash_cur (&i), struct futex, elem);
+      if (f->pd == pd && f->sleeping > 0)
+        {
+          f->sleeping = 0;
+          cond_broadcast (&f->cond, &futex_lock);
+        }
+    }
+  lock_release (&futex_lock);
+}
+
+/* Hashes a futex by its page directory and address. */
+static unsigned
+futex_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct futex *f = hash_entry (e, struct futex, elem);
+  uintptr_t key[2] = { (uintptr_t) f->pd, (uintptr_t) f->uaddr };
+
+  return hash_bytes (key, sizeof key);
+}
+
+/* Orders futexes by page directory, then by address. */
+static bool
+futex_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct futex *a = hash_entry (a_, struct futex, elem);
+  const struct futex *b = hash_entry (b_, struct futex, elem);
+
+  if (a->pd != b->pd)
+    return a->pd < b->pd;
+  return a->uaddr < b->uaddr;
+}
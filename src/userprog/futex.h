@@ -0,0 +1,22 @@
+#ifndef USERPROG_FUTEX_H
+#define USERPROG_FUTEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Futexes: kernel wait queues named by user addresses, for
+   building user-space locks that enter the kernel only when they
+   must block or wake someone.
+
+   futex_wait() blocks only if the word still holds the value
+   the caller saw, checked under the same lock that futex_wake()
+   takes, so a wakeup sent after the caller looked but before it
+   slept is not lost.  Waiters are woken highest priority first,
+   in the same order as a condition variable's. */
+
+void futex_init (void);
+int futex_wait (const int *uaddr, int val);
+int futex_wake (const int *uaddr, int cnt);
+void futex_wake_all (uint32_t *pd);
+
+#endif /* userprog/futex.h */
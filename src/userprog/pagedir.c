@@ -1,29 +1,113 @@
 #include "userprog/pagedir.h"
+#include <inttypes.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
+#include <vdata.h>
+#include "devices/timer.h"
+#include "threads/cpu.h"
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
 
+/* Large pages.
+
+   pagedir_promote() replaces a page table whose entries all map
+   one physically contiguous, PTSPAN-aligned run of frames, with
+   the same permissions, by a single PDE that maps the run as a 4
+   MB page, so that the region takes one TLB entry instead of
+   1024.  The page table is kept on SPARE_PTS instead of being
+   freed, so that splitting the large page again never has to
+   allocate memory.
+
+   A change to the mapping of any one page of a large page, such
+   as unmapping it to evict it, splits the large page first (see
+   lookup_page()).  Only setting a page's accessed or dirty bit,
+   and reading the bits, leaves it whole: those are the bits of
+   the PDE, which the CPU sets for the whole region, so every
+   page in it looks dirty once any of them is written.
+
+   Threads other than a page directory's owner change its
+   mappings too, for example to evict a frame, so the functions
+   below find and change entries with interrupts off, so that no
+   promotion or split happens in between. */
+
+/* A page table on SPARE_PTS. */
+struct spare_pt
+  {
+    struct spare_pt *next;              /* Next spare page table. */
+  };
+
+/* Page tables set aside by pagedir_promote(), one for each large
+   page in any page directory.  Protected by disabling
+   interrupts. */
+static struct spare_pt *spare_pts;
+
+/* Large pages made and split, for statistics. */
+static uint64_t promote_cnt, split_cnt;
+
+/* Entries in a page table. */
+#define PT_CNT (PGSIZE / sizeof (uint32_t))
+
+static uint32_t *lookup_entry (uint32_t *pd, const void *vaddr);
+static uint32_t *lookup_page (uint32_t *pd, const void *vaddr);
+static void split (uint32_t *pd, uint32_t *pde);
 static uint32_t *active_pd (void);
 static void invalidate_pagedir (uint32_t *);
+static void invalidate_page (uint32_t *, const void *);
+static void load_cr3 (uint32_t *);
+
+/* Most pages that pagedir_clear_pages() invalidates one at a
+   time.  Beyond this, reloading CR3 to flush the whole TLB is
+   cheaper. */
+#define INVLPG_MAX 32
+
+/* Number of PDEs at the start of the kernel half of
+   init_page_dir that may be present.  The rest are unused. */
+static size_t kernel_pde_cnt;
 
 /* Creates a new page directory that has mappings for kernel
-   virtual addresses, but none for user virtual addresses.
-   Returns the new page directory, or a null pointer if memory
-   allocation fails. */
+   virtual addresses, and for user virtual addresses only the
+   read-only vdata page at VDATA_ADDR.  Returns the new page
+   directory, or a null pointer if memory allocation fails. */
 uint32_t *
 pagedir_create (void) 
 {
-  uint32_t *pd = palloc_get_page (0);
-  if (pd != NULL)
-    memcpy (pd, init_page_dir, PGSIZE);
+  uint32_t *kernel_pdes = init_page_dir + pd_no (PHYS_BASE);
+  uint32_t *pd;
+
+  /* The base page directory never changes once built, so
+     measure it just once. */
+  if (kernel_pde_cnt == 0)
+    {
+      size_t i;
+
+      for (i = 0; i < PGSIZE / sizeof *pd - pd_no (PHYS_BASE); i++)
+        if (kernel_pdes[i] != 0)
+          kernel_pde_cnt = i + 1;
+    }
+
+  /* Copy only the kernel PDEs in use into a zeroed page, which
+     the page allocator can often supply without clearing it. */
+  pd = palloc_get_page (PAL_ZERO);
+  if (pd == NULL)
+    return NULL;
+  memcpy (pd + pd_no (PHYS_BASE), kernel_pdes, kernel_pde_cnt * sizeof *pd);
+
+  /* Every process shares the one vdata page, so destroying PD
+     leaves it alone. */
+  if (!pagedir_set_page (pd, (void *) VDATA_ADDR, timer_vdata (), false))
+    {
+      palloc_free_page (pd);
+      return NULL;
+    }
   return pd;
 }
 
 /* Destroys page directory PD, freeing all the pages it
-   references. */
+   references.  Only the page tables that PD has are visited. */
 void
 pagedir_destroy (uint32_t *pd) 
 {
@@ -36,53 +120,97 @@ pagedir_destroy (uint32_t *pd)
   for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
     if (*pde & PTE_P) 
       {
-        uint32_t *pt = pde_get_pt (*pde);
-        uint32_t *pte;
-        
-        for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
-          if (*pte & PTE_P) 
-            palloc_free_page (pte_get_page (*pte));
+        uint32_t *pt;
+        enum intr_level old_level;
+
+        /* Give a large page its page table back, to free. */
+        old_level = intr_disable ();
+        if (*pde & PTE_PS)
+          split (pd, pde);
+        intr_set_level (old_level);
+
+        pt = pde_get_pt (*pde);
+#ifndef VM
+          {
+            uint32_t *pte;
+
+            for (pte = pt; pte < pt + PT_CNT; pte++)
+              if ((*pte & PTE_P) && pte_get_page (*pte) != timer_vdata ())
+                palloc_free_page (pte_get_page (*pte));
+          }
+#else
+        /* With virtual memory the frame table owns the pages,
+           and page_table_destroy() has taken them all back and
+           unmapped them already, so there is nothing in PT to
+           free. */
+#endif
         palloc_free_page (pt);
       }
   palloc_free_page (pd);
 }
 
-/* Returns the address of the page table entry for virtual
-   address VADDR in page directory PD.
-   If PD does not have a page table for VADDR, behavior depends
-   on CREATE.  If CREATE is true, then a new page table is
-   created and a pointer into it is returned.  Otherwise, a null
-   pointer is returned. */
+/* Returns the address of the entry that maps virtual address
+   VADDR in page directory PD: the page table entry, or the PDE
+   if VADDR is in a large page.  Returns a null pointer if PD has
+   no page table for VADDR.  Interrupts must be off. */
 static uint32_t *
-lookup_page (uint32_t *pd, const void *vaddr, bool create)
+lookup_entry (uint32_t *pd, const void *vaddr)
 {
-  uint32_t *pt, *pde;
+  uint32_t *pde;
 
   ASSERT (pd != NULL);
+  ASSERT (intr_get_level () == INTR_OFF);
 
-  /* Shouldn't create new kernel virtual mappings. */
-  ASSERT (!create || is_user_vaddr (vaddr));
-
-  /* Check for a page table for VADDR.
-     If one is missing, create one if requested. */
   pde = pd + pd_no (vaddr);
-  if (*pde == 0) 
-    {
-      if (create)
-        {
-          pt = palloc_get_page (PAL_ZERO);
-          if (pt == NULL) 
-            return NULL; 
-      
-          *pde = pde_create (pt);
-        }
-      else
-        return NULL;
-    }
+  if (*pde == 0)
+    return NULL;
+  else if (*pde & PTE_PS)
+    return pde;
+  else
+    return &pde_get_pt (*pde)[pt_no (vaddr)];
+}
+
+/* Returns the address of the page table entry for virtual
+   address VADDR in page directory PD, or a null pointer if PD
+   does not have a page table for VADDR.  If VADDR is in a large
+   page, splits it first, so that the caller may change the
+   entry for VADDR alone.  Interrupts must be off. */
+static uint32_t *
+lookup_page (uint32_t *pd, const void *vaddr)
+{
+  uint32_t *pde = pd + pd_no (vaddr);
+
+  if (*pde & PTE_PS)
+    split (pd, pde);
+  return lookup_entry (pd, vaddr);
+}
+
+/* Maps the large page that *PDE, in page directory PD, maps
+   through a page table again, one taken from SPARE_PTS, giving
+   each page the large page's permissions and its accessed and
+   dirty bits.  Interrupts must be off. */
+static void
+split (uint32_t *pd, uint32_t *pde)
+{
+  struct spare_pt *spare = spare_pts;
+  uint32_t *pt = (uint32_t *) spare;
+  uint32_t base = *pde & PTE_ADDR;
+  uint32_t flags = *pde & (PTE_P | PTE_W | PTE_U | PTE_A | PTE_D);
+  size_t i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT ((*pde & (PTE_P | PTE_U | PTE_PS)) == (PTE_P | PTE_U | PTE_PS));
+  ASSERT (spare != NULL);
+
+  spare_pts = spare->next;
+  for (i = 0; i < PT_CNT; i++)
+    pt[i] = (base + i * PGSIZE) | flags;
+  *pde = pde_create (pt);
 
-  /* Return the page table entry. */
-  pt = pde_get_pt (*pde);
-  return &pt[pt_no (vaddr)];
+  /* One INVLPG anywhere in the region drops the large page's TLB
+     entry. */
+  invalidate_page (pd, (void *) ((uintptr_t) (pde - pd) << PDSHIFT));
+  split_cnt++;
 }
 
 /* Adds a mapping in page directory PD from user virtual page
@@ -98,7 +226,10 @@ lookup_page (uint32_t *pd, const void *vaddr, bool create)
 bool
 pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool writable)
 {
+  uint32_t *pde = pd + pd_no (upage);
+  uint32_t *pt = NULL;
   uint32_t *pte;
+  enum intr_level old_level;
 
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (pg_ofs (kpage) == 0);
@@ -106,16 +237,30 @@ pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool writable)
   ASSERT (vtop (kpage) >> PTSHIFT < init_ram_pages);
   ASSERT (pd != init_page_dir);
 
-  pte = lookup_page (pd, upage, true);
+  /* Allocate a page table, if one is missing, before turning
+     interrupts off. */
+  if (*pde == 0)
+    {
+      pt = palloc_get_page (PAL_ZERO);
+      if (pt == NULL) 
+        return false;
+    }
 
-  if (pte != NULL) 
+  old_level = intr_disable ();
+  if (*pde == 0)
     {
-      ASSERT ((*pte & PTE_P) == 0);
-      *pte = pte_create_user (kpage, writable);
-      return true;
+      *pde = pde_create (pt);
+      pt = NULL;
     }
-  else
-    return false;
+  pte = lookup_page (pd, upage);
+  ASSERT ((*pte & PTE_P) == 0);
+  *pte = pte_create_user (kpage, writable);
+  intr_set_level (old_level);
+
+  /* Another thread added a page table first. */
+  if (pt != NULL)
+    palloc_free_page (pt);
+  return true;
 }
 
 /* Looks up the physical address that corresponds to user virtual
@@ -125,15 +270,24 @@ pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool writable)
 void *
 pagedir_get_page (uint32_t *pd, const void *uaddr) 
 {
-  uint32_t *pte;
+  uint8_t *kaddr = NULL;
+  uint32_t *e;
+  enum intr_level old_level;
 
   ASSERT (is_user_vaddr (uaddr));
   
-  pte = lookup_page (pd, uaddr, false);
-  if (pte != NULL && (*pte & PTE_P) != 0)
-    return pte_get_page (*pte) + pg_ofs (uaddr);
-  else
-    return NULL;
+  old_level = intr_disable ();
+  e = lookup_entry (pd, uaddr);
+  if (e != NULL && (*e & PTE_P) != 0)
+    {
+      if (e == pd + pd_no (uaddr))
+        kaddr = ((uint8_t *) ptov (*e & PTE_ADDR)
+                 + ((uintptr_t) uaddr & (PTSPAN - 1)));
+      else
+        kaddr = (uint8_t *) pte_get_page (*e) + pg_ofs (uaddr);
+    }
+  intr_set_level (old_level);
+  return kaddr;
 }
 
 /* Marks user virtual page UPAGE "not present" in page
@@ -144,16 +298,48 @@ void
 pagedir_clear_page (uint32_t *pd, void *upage) 
 {
   uint32_t *pte;
+  enum intr_level old_level;
 
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (is_user_vaddr (upage));
 
-  pte = lookup_page (pd, upage, false);
+  old_level = intr_disable ();
+  pte = lookup_page (pd, upage);
   if (pte != NULL && (*pte & PTE_P) != 0)
     {
       *pte &= ~PTE_P;
-      invalidate_pagedir (pd);
+      invalidate_page (pd, upage);
+    }
+  intr_set_level (old_level);
+}
+
+/* Marks the CNT user virtual pages starting at UPAGE "not
+   present" in page directory PD, as pagedir_clear_page() would
+   each of them, but invalidates the TLB for all of them at
+   once. */
+void
+pagedir_clear_pages (uint32_t *pd, void *upage, size_t cnt) 
+{
+  uint8_t *page = upage;
+  size_t i;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (cnt == 0 || is_user_vaddr (page + (cnt - 1) * PGSIZE));
+
+  for (i = 0; i < cnt; i++)
+    {
+      enum intr_level old_level = intr_disable ();
+      uint32_t *pte = lookup_page (pd, page + i * PGSIZE);
+      if (pte != NULL && (*pte & PTE_P) != 0)
+        {
+          *pte &= ~PTE_P;
+          if (cnt <= INVLPG_MAX)
+            invalidate_page (pd, page + i * PGSIZE);
+        }
+      intr_set_level (old_level);
     }
+  if (cnt > INVLPG_MAX)
+    invalidate_pagedir (pd);
 }
 
 /* Returns true if the PTE for virtual page VPAGE in PD is dirty,
@@ -163,8 +349,11 @@ pagedir_clear_page (uint32_t *pd, void *upage)
 bool
 pagedir_is_dirty (uint32_t *pd, const void *vpage) 
 {
-  uint32_t *pte = lookup_page (pd, vpage, false);
-  return pte != NULL && (*pte & PTE_D) != 0;
+  enum intr_level old_level = intr_disable ();
+  uint32_t *e = lookup_entry (pd, vpage);
+  bool dirty = e != NULL && (*e & PTE_D) != 0;
+  intr_set_level (old_level);
+  return dirty;
 }
 
 /* Set the dirty bit to DIRTY in the PTE for virtual page VPAGE
@@ -172,17 +361,42 @@ pagedir_is_dirty (uint32_t *pd, const void *vpage)
 void
 pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty) 
 {
-  uint32_t *pte = lookup_page (pd, vpage, false);
-  if (pte != NULL) 
+  enum intr_level old_level = intr_disable ();
+  if (dirty)
+    {
+      uint32_t *e = lookup_entry (pd, vpage);
+      if (e != NULL)
+        *e |= PTE_D;
+    }
+  else 
     {
-      if (dirty)
-        *pte |= PTE_D;
-      else 
+      uint32_t *pte = lookup_page (pd, vpage);
+      if (pte != NULL)
         {
           *pte &= ~(uint32_t) PTE_D;
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
         }
     }
+  intr_set_level (old_level);
+}
+
+/* Makes the mapping for virtual page VPAGE in PD writable, if
+   WRITABLE is true, or read-only, if it is false.  Does nothing
+   if VPAGE is not mapped. */
+void
+pagedir_set_writable (uint32_t *pd, const void *vpage, bool writable) 
+{
+  enum intr_level old_level = intr_disable ();
+  uint32_t *pte = lookup_page (pd, vpage);
+  if (pte != NULL && (*pte & PTE_P) != 0) 
+    {
+      if (writable)
+        *pte |= PTE_W;
+      else
+        *pte &= ~(uint32_t) PTE_W;
+      invalidate_page (pd, vpage);
+    }
+  intr_set_level (old_level);
 }
 
 /* Returns true if the PTE for virtual page VPAGE in PD has been
@@ -192,36 +406,188 @@ pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
 bool
 pagedir_is_accessed (uint32_t *pd, const void *vpage) 
 {
-  uint32_t *pte = lookup_page (pd, vpage, false);
-  return pte != NULL && (*pte & PTE_A) != 0;
+  enum intr_level old_level = intr_disable ();
+  uint32_t *e = lookup_entry (pd, vpage);
+  bool accessed = e != NULL && (*e & PTE_A) != 0;
+  intr_set_level (old_level);
+  return accessed;
 }
 
 /* Sets the accessed bit to ACCESSED in the PTE for virtual page
-   VPAGE in PD. */
+   VPAGE in PD.  Clearing it splits a large page, so that the
+   eviction policy judges each of its pages on its own. */
 void
 pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed) 
 {
-  uint32_t *pte = lookup_page (pd, vpage, false);
-  if (pte != NULL) 
+  enum intr_level old_level = intr_disable ();
+  if (accessed)
     {
-      if (accessed)
-        *pte |= PTE_A;
-      else 
+      uint32_t *e = lookup_entry (pd, vpage);
+      if (e != NULL)
+        *e |= PTE_A;
+    }
+  else 
+    {
+      uint32_t *pte = lookup_page (pd, vpage);
+      if (pte != NULL)
         {
           *pte &= ~(uint32_t) PTE_A; 
+          invalidate_page (pd, vpage);
+        }
+    }
+  intr_set_level (old_level);
+}
+
+/* Returns true if PTE, the page table entry at index IDX, maps
+   the page at that index of the run of frames that starts at
+   physical address BASE, with permissions PERMS. */
+static bool
+in_run (uint32_t pte, size_t idx, uint32_t base, uint32_t perms)
+{
+  return ((pte & (PTE_ADDR | PTE_P | PTE_W | PTE_U))
+          == ((base + idx * PGSIZE) | perms));
+}
+
+/* Maps the PTSPAN-aligned region of user virtual memory that
+   contains UPAGE in page directory PD as one large page, if
+   every page of it is mapped, with the same permissions, to
+   frames that are physically contiguous and start on a PTSPAN
+   boundary, and the CPU has large pages.  Returns true if
+   successful. */
+bool
+pagedir_promote (uint32_t *pd, const void *upage)
+{
+  uint32_t *pde = pd + pd_no (upage);
+  enum intr_level old_level;
+  bool success = false;
+
+  ASSERT (is_user_vaddr (upage));
+  ASSERT (pd != init_page_dir);
+
+  if (!cpu_has (CPUID_PSE))
+    return false;
+
+  old_level = intr_disable ();
+  if ((*pde & (PTE_P | PTE_PS)) == PTE_P)
+    {
+      uint32_t *pt = pde_get_pt (*pde);
+      uint32_t base = pt[0] & PTE_ADDR;
+      uint32_t perms = pt[0] & (PTE_P | PTE_W | PTE_U);
+      uint32_t ad = 0;
+      size_t i;
+
+      /* The last page is the one most likely to be missing while
+         a region fills in order, so check it first. */
+      if ((base & (PTSPAN - 1)) == 0 && (perms & PTE_P) && (perms & PTE_U)
+          && in_run (pt[PT_CNT - 1], PT_CNT - 1, base, perms))
+        {
+          for (i = 0; i < PT_CNT && in_run (pt[i], i, base, perms); i++)
+            ad |= pt[i] & (PTE_A | PTE_D);
+          success = i == PT_CNT;
+        }
+      if (success)
+        {
+          struct spare_pt *spare = (struct spare_pt *) pt;
+
+          spare->next = spare_pts;
+          spare_pts = spare;
+          *pde = base | perms | ad | PTE_PS;
           invalidate_pagedir (pd);
+          promote_cnt++;
+        }
+    }
+  intr_set_level (old_level);
+  return success;
+}
+
+/* Finds where the frames of the PTSPAN-aligned region of user
+   virtual memory that contains UPAGE must start, as a kernel
+   virtual address, for pagedir_promote() to succeed once every
+   page of it is mapped, judging by the writable page of it
+   nearest UPAGE that PD maps.  Stores that address into *BASE,
+   or a null pointer if PD maps no writable page of the region,
+   and returns true.  Returns false if the region cannot become a
+   large page: it is one already, that page's frame is out of
+   line, or the CPU has no large pages. */
+bool
+pagedir_large_base (uint32_t *pd, const void *upage, void **base)
+{
+  uint32_t *pde = pd + pd_no (upage);
+  size_t idx = pt_no (upage);
+  enum intr_level old_level;
+  bool ok = true;
+
+  ASSERT (is_user_vaddr (upage));
+
+  *base = NULL;
+  if (!cpu_has (CPUID_PSE))
+    return false;
+
+  old_level = intr_disable ();
+  if (*pde & PTE_PS)
+    ok = false;
+  else if (*pde != 0)
+    {
+      uint32_t *pt = pde_get_pt (*pde);
+      size_t d;
+
+      /* Look outward from UPAGE, since a region usually fills in
+         order, up or down. */
+      for (d = 1; d < PT_CNT && ok && *base == NULL; d++)
+        {
+          size_t sides[2] = {idx - d, idx + d};
+          int s;
+
+          for (s = 0; s < 2 && *base == NULL; s++)
+            {
+              size_t i = sides[s];
+              uint32_t pte, start;
+
+              /* Past either end of the page table. */
+              if (i >= PT_CNT)
+                continue;
+              pte = pt[i];
+              if ((pte & (PTE_P | PTE_W)) != (PTE_P | PTE_W))
+                continue;
+              start = (pte & PTE_ADDR) - i * PGSIZE;
+              if ((pte & PTE_ADDR) < i * PGSIZE || (start & (PTSPAN - 1)))
+                ok = false;
+              else
+                *base = ptov (start);
+              break;
+            }
         }
     }
+  intr_set_level (old_level);
+  return ok;
+}
+
+/* Prints statistics on large pages. */
+void
+pagedir_print_stats (void)
+{
+  printf ("Large pages: %"PRIu64" made, %"PRIu64" split\n",
+          promote_cnt, split_cnt);
 }
 
 /* Loads page directory PD into the CPU's page directory base
-   register. */
+   register, unless it is there already. */
 void
 pagedir_activate (uint32_t *pd) 
 {
   if (pd == NULL)
     pd = init_page_dir;
 
+  /* Reloading CR3 flushes the TLB, so don't do it needlessly. */
+  if (active_pd () != pd)
+    load_cr3 (pd);
+}
+
+/* Loads page directory PD into the CPU's page directory base
+   register, flushing every TLB entry not marked global. */
+static void
+load_cr3 (uint32_t *pd) 
+{
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
      new page tables immediately.  See [IA32-v2a] "MOV--Move
@@ -256,8 +622,19 @@ invalidate_pagedir (uint32_t *pd)
 {
   if (active_pd () == pd) 
     {
-      /* Re-activating PD clears the TLB.  See [IA32-v3a] 3.12
-         "Translation Lookaside Buffers (TLBs)". */
-      pagedir_activate (pd);
+      /* Re-activating PD clears the TLB, except for the global
+         kernel mappings, which never change.  See [IA32-v3a]
+         3.12 "Translation Lookaside Buffers (TLBs)". */
+      load_cr3 (pd);
     } 
 }
+
+/* Invalidates the TLB entry for user virtual address VADDR if PD
+   is the active page directory, leaving the rest of the TLB
+   alone.  See [IA32-v2a] "INVLPG--Invalidate TLB Entry". */
+static void
+invalidate_page (uint32_t *pd, const void *vaddr) 
+{
+  if (active_pd () == pd)
+    asm volatile ("invlpg (%0)" : : "r" (vaddr) : "memory");
+}
@@ -0,0 +1,198 @@
+#include "userprog/pipe.h"
+#include <debug.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Bytes a pipe holds. */
+#define PIPE_SIZE PGSIZE
+
+/* Free bytes a blocked writer waits for. */
+#define PIPE_WAKE (PIPE_SIZE / 2)
+
+/* A pipe.  HEAD and TAIL count bytes read and written since the
+   pipe was made, so that HEAD == TAIL means empty whether or not
+   the buffer is full. */
+struct pipe
+  {
+    struct lock lock;           /* Guards everything below. */
+    struct condition readable;  /* Signalled when bytes arrive. */
+    struct condition writable;  /* Signalled when room is made. */
+    uint8_t *buf;               /* PIPE_SIZE bytes. */
+    size_t head;                /* Bytes read. */
+    size_t tail;                /* Bytes written. */
+    int readers;                /* Open read ends. */
+    int writers;                /* Open write ends. */
+  };
+
+static void pipe_free (struct pipe *);
+
+/* Creates a new, empty pipe, open once for reading and once for
+   writing.  Returns a null pointer if memory is not available. */
+struct pipe *
+pipe_create (void)
+{
+  struct pipe *p = malloc (sizeof *p);
+
+  if (p == NULL)
+    return NULL;
+  p->buf = palloc_get_page (0);
+  if (p->buf == NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  lock_init (&p->lock);
+  cond_init (&p->readable);
+  cond_init (&p->writable);
+  p->head = p->tail = 0;
+  p->readers = p->writers = 1;
+  return p;
+}
+
+/* Opens P again, for writing if WRITER is true, otherwise for
+   reading, as when a descriptor is copied by fork(). */
+void
+pipe_reopen (struct pipe *p, bool writer)
+{
+  lock_acquire (&p->lock);
+  if (writer)
+    p->writers++;
+  else
+    p->readers++;
+  lock_release (&p->lock);
+}
+
+/* Closes one of P's write ends if WRITER is true, otherwise one
+   of its read ends, and frees P once both ends are fully
+   closed.  Waking everyone when the last of one end goes lets
+   readers see the end of the stream and writers give up. */
+void
+pipe_close (struct pipe *p, bool writer)
+{
+  bool dead;
+
+  lock_acquire (&p->lock);
+  if (writer)
+    {
+      ASSERT (p->writers > 0);
+      p->writers--;
+    }
+  else
+    {
+      ASSERT (p->readers > 0);
+      p->readers--;
+    }
+  cond_broadcast (&p->readable, &p->lock);
+  cond_broadcast (&p->writable, &p->lock);
+  dead = p->readers == 0 && p->writers == 0;
+  lock_release (&p->lock);
+
+  if (dead)
+    pipe_free (p);
+}
+
+/* Reads up to SIZE bytes from P into BUFFER, waiting until there
+   is at least one unless every write end is closed.  Returns the
+   number of bytes read, which is 0 at the end of the stream, or
+   -1 if *STOP became true while there was nothing to read.
+   Whoever sets *STOP must then call pipe_interrupt(). */
+int
+pipe_read (struct pipe *p, void *buffer, size_t size,
+           const volatile bool *stop)
+{
+  uint8_t *dst = buffer;
+  size_t n, ofs, chunk;
+
+  if (size == 0)
+    return 0;
+
+  lock_acquire (&p->lock);
+  while (p->head == p->tail && p->writers > 0 && !*stop)
+    cond_wait (&p->readable, &p->lock);
+  if (p->head == p->tail && p->writers > 0)
+    {
+      lock_release (&p->lock);
+      return -1;
+    }
+
+  n = p->tail - p->head;
+  if (n > size)
+    n = size;
+  ofs = p->head % PIPE_SIZE;
+  chunk = n < PIPE_SIZE - ofs ? n : PIPE_SIZE - ofs;
+  memcpy (dst, p->buf + ofs, chunk);
+  memcpy (dst + chunk, p->buf, n - chunk);
+  p->head += n;
+
+  /* Wake writers once, when this read makes enough room. */
+  if (n > 0 && PIPE_SIZE - (p->tail - p->head) >= PIPE_WAKE
+      && PIPE_SIZE - (p->tail - p->head) - n < PIPE_WAKE)
+    cond_broadcast (&p->writable, &p->lock);
+  lock_release (&p->lock);
+  return n;
+}
+
+/* Writes the SIZE bytes in BUFFER to P, waiting for room as
+   needed.  Returns SIZE, or fewer if every read end is closed or
+   *STOP becomes true partway, or -1 if that happened before
+   anything was written.  Whoever sets *STOP must then call
+   pipe_interrupt(). */
+int
+pipe_write (struct pipe *p, const void *buffer, size_t size,
+            const volatile bool *stop)
+{
+  const uint8_t *src = buffer;
+  size_t done = 0;
+
+  lock_acquire (&p->lock);
+  while (done < size && p->readers > 0 && !*stop)
+    {
+      size_t room = PIPE_SIZE - (p->tail - p->head);
+      size_t n, ofs, chunk;
+
+      if (room == 0)
+        {
+          /* Let the readers have what is there, then sleep until
+             they have made room for a batch. */
+          cond_broadcast (&p->readable, &p->lock);
+          while (PIPE_SIZE - (p->tail - p->head) < PIPE_WAKE
+                 && p->readers > 0 && !*stop)
+            cond_wait (&p->writable, &p->lock);
+          continue;
+        }
+
+      n = size - done < room ? size - done : room;
+      ofs = p->tail % PIPE_SIZE;
+      chunk = n < PIPE_SIZE - ofs ? n : PIPE_SIZE - ofs;
+      memcpy (p->buf + ofs, src + done, chunk);
+      memcpy (p->buf, src + done + chunk, n - chunk);
+      p->tail += n;
+      done += n;
+    }
+  if (done > 0)
+    cond_broadcast (&p->readable, &p->lock);
+  lock_release (&p->lock);
+  return done > 0 || size == 0 ? (int) done : -1;
+}
+
+/* Wakes every thread waiting in pipe_read() or pipe_write() on
+   P, so that they look at their STOP flags again. */
+void
+pipe_interrupt (struct pipe *p)
+{
+  lock_acquire (&p->lock);
+  cond_broadcast (&p->readable, &p->lock);
+  cond_broadcast (&p->writable, &p->lock);
+  lock_release (&p->lock);
+}
+
+/* Frees P, which no one has open. */
+static void
+pipe_free (struct pipe *p)
+{
+  palloc_free_page (p->buf);
+  free (p);
+}
@@ -0,0 +1,28 @@
+#ifndef USERPROG_PIPE_H
+#define USERPROG_PIPE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Pipes: one-way byte streams between processes, held in a
+   page of kernel memory.
+
+   A reader blocks until some bytes are there and a writer until
+   all of its bytes have gone into the buffer, unless the other
+   end has been closed by everyone who had it open.  Sleepers are
+   woken in batches rather than once for each byte that comes or
+   goes: readers once a write has put in all it can, and writers
+   only once at least half of the buffer is free. */
+
+struct pipe;
+
+struct pipe *pipe_create (void);
+void pipe_reopen (struct pipe *, bool writer);
+void pipe_close (struct pipe *, bool writer);
+int pipe_read (struct pipe *, void *buffer, size_t size,
+               const volatile bool *stop);
+int pipe_write (struct pipe *, const void *buffer, size_t size,
+                const volatile bool *stop);
+void pipe_interrupt (struct pipe *);
+
+#endif /* userprog/pipe.h */
@@ -1,28 +1,170 @@
 #include "userprog/process.h"
 #include "userprog/syscall.h"
 #include <debug.h>
+#include <hash.h>
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "userprog/fpu.h"
+#include "userprog/aio.h"
+#include "userprog/futex.h"
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
 #include "userprog/tss.h"
+#include "userprog/uaccess.h"
+#include "devices/timer.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/kmem.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/scratch.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 static thread_func start_process NO_RETURN;
-static bool load (const char *file_name, void (**eip) (void), void **esp);
-void set_args_onto_stack(void **esp, const char *file_name, char *save_ptr);
-struct thread *get_child_by_tid(tid_t tid);
+#ifdef VM
+static thread_func fork_process NO_RETURN;
+#endif
+
+/* What a parent keeps about a child process, in its CHILDREN
+   table, so that it can wait for the child once it has exited
+   and its struct thread is gone.  Shared by the parent and the
+   child; whichever lets go of it last frees it. */
+struct child_status
+  {
+    struct hash_elem elem;      /* Element in the parent's CHILDREN. */
+    tid_t tid;                  /* The child's thread id. */
+    int exit_status;            /* Set when the child exits. */
+    struct proc_stats stats;    /* Its usage, set when it exits. */
+    struct semaphore exited;    /* Upped when the child exits. */
+    struct lock exited_hint;    /* Owns EXITED for the child. */
+    struct semaphore *notify;   /* The parent's CHILD_EXITED. */
+    int ref_cnt;                /* Parent and child: 0 to 2. */
+  };
+
+static struct kmem_cache child_status_cache;
+
+static struct process *process_create (void);
+static void inherit_limits (struct process *);
+static struct hash *children_table (void);
+static struct child_status *child_status_create (void);
+static void child_status_release (struct child_status *);
+static bool process_sema_down (struct semaphore *);
+static hash_hash_func child_status_hash;
+static hash_less_func child_status_less;
+static hash_action_func child_status_orphan;
+
+/* A command line, split into words once by process_execute()
+   and copied as is onto the new process's stack by
+   setup_stack(), along with how process_spawn() set the child
+   up. */
+struct exec_args
+  {
+    struct process *proc;       /* The child's process state. */
+    struct child_status *status; /* The child's status record. */
+    struct thread *parent;      /* Process whose files a spawn copies. */
+    bool spawn;                 /* Made by process_spawn()? */
+    const struct spawn_action *actions; /* File actions to apply. */
+    int action_cnt;             /* Number of ACTIONS. */
+    const char *cwd;            /* Directory to start in, or null. */
+    struct semaphore loaded;    /* Upped once the load is over. */
+    struct lock loaded_hint;    /* Owns LOADED for the child. */
+    bool success;               /* Did the load succeed? */
+    int argc;                   /* Number of words. */
+    size_t size;                /* Bytes in WORDS. */
+    char words[];               /* Each word, null-terminated. */
+  };
+
+static tid_t execute (const char *cmd_line, bool spawn,
+                      const struct spawn_action *, int action_cnt,
+                      const char *cwd);
+static bool load (const struct exec_args *, void (**eip) (void),
+                  void **esp);
+
+/* User threads.
+
+   A process starts with one thread, its leader, which holds the
+   state of the whole process.  process_thread_create() adds
+   threads that share the leader's page directory and reach the
+   rest through their PROCESS member.  Each one runs on a stack
+   of its own, in one of UTHREAD_MAX slots just below the region
+   reserved for the leader's stack, each slot a guard page and
+   UTHREAD_STACK_PAGES pages.  A slot's pages stay in the
+   address space once added, to be reused by the next thread
+   that gets the slot.
+
+   When any thread calls exit(), or one is killed, the process is
+   marked as exiting, and each of its threads exits the next time
+   it would return to user mode (see intr_handler()).  The
+   leader's process_exit() waits for the others to be gone
+   before it tears down the process. */
+
+#define UTHREAD_MAX 32          /* Most threads besides the leader,
+                                   at most 32. */
+#define UTHREAD_STACK_PAGES 8   /* Size of each one's stack. */
+
+/* A process's threads other than its leader.  Owned by the
+   leader, which creates it along with the first of them. */
+struct process_threads
+  {
+    struct lock lock;           /* Guards all of this. */
+    struct list threads;        /* struct uthreads not yet joined. */
+    int live;                   /* Threads that have not exited. */
+    struct condition all_exited; /* Signalled when LIVE drops to 0. */
+    uint32_t slots_used;        /* Stack slots in use, one bit each. */
+  };
+
+/* What the process keeps about one of its threads, so that it
+   can be joined after the thread has exited. */
+struct uthread
+  {
+    struct list_elem elem;      /* Element in process_threads. */
+    tid_t tid;                  /* Thread identifier. */
+    int slot;                   /* Stack slot. */
+    int exit_status;            /* Passed to process_thread_exit(). */
+    struct semaphore exited;    /* Upped when the thread exits. */
+    bool joined;                /* Is a thread joining it already? */
+    bool clean;                 /* Did it call process_thread_exit()? */
+  };
+
+/* Passed from process_thread_create() to start_uthread(). */
+struct uthread_info
+  {
+    struct thread *process;     /* Process the thread is part of. */
+    struct uthread *uthread;    /* Its record. */
+    struct intr_frame if_;      /* Registers to start it with. */
+    struct semaphore started;   /* Upped once INFO is not needed. */
+  };
+
+static thread_func start_uthread NO_RETURN;
+static uint8_t *uthread_stack_top (int slot);
+static bool uthread_stack_add (int slot);
+static void uthread_finish (void);
+static void uthreads_destroy (void);
+#ifndef VM
+static bool install_page (void *upage, void *kpage, bool writable);
+#endif
+
+/* Serializes sbrk(), which is rare enough to need no lock of
+   each process's own. */
+static struct lock brk_lock;
+
+static bool brk_add (uint8_t *start, uint8_t *end);
+static void brk_remove (uint8_t *start, uint8_t *end);
 
 /* Starts a new thread running a user program loaded from
    FILENAME.  The new thread may be scheduled (and may even exit)
@@ -31,153 +173,155 @@ struct thread *get_child_by_tid(tid_t tid);
 tid_t
 process_execute (const char *file_name) 
 {
-  char *fn_copy;
-  char *fn_m;
+  return execute (file_name, false, NULL, 0, NULL);
+}
+
+/* Starts a new thread running a user program like
+   process_execute(), but the new process first gets a copy of
+   each of the running process's file descriptors, with the
+   ACTION_CNT ACTIONS applied to them in order (see <spawn.h>),
+   and then changes to directory CWD, unless it is null, before
+   CMD_LINE is loaded.  Returns TID_ERROR if any of that fails.
+   ACTIONS and CWD need only last until this returns. */
+tid_t
+process_spawn (const char *cmd_line, const struct spawn_action *actions,
+               int action_cnt, const char *cwd)
+{
+  return execute (cmd_line, true, actions, action_cnt, cwd);
+}
+
+/* Does the work of process_execute() and, if SPAWN is true, of
+   process_spawn(). */
+static tid_t
+execute (const char *file_name, bool spawn,
+         const struct spawn_action *actions, int action_cnt,
+         const char *cwd)
+{
+  struct scratch_mark mark;
+  struct exec_args *args;
+  const char *src;
+  char *dst;
   tid_t tid;
 
-  // file_name stores "args-single arg"
-  
-  /* Make a copy of FILE_NAME.
-     Otherwise there's a race between the caller and load(). */
-  fn_copy = palloc_get_page (0);
-  if (fn_copy == NULL)
-    return TID_ERROR;
-  strlcpy (fn_copy, file_name, PGSIZE);
-  
-  fn_m = palloc_get_page (0);
-  if (fn_m == NULL)
-	return TID_ERROR;
-  strlcpy (fn_m, file_name, PGSIZE);
+  /* Split FILE_NAME into words, once.  The words live in our
+     scratch memory, which stays put until load() is done with
+     them. */
+  mark = scratch_begin ();
+  args = scratch_alloc (sizeof *args + strlen (file_name) + 1);
+  if (args == NULL)
+    {
+      scratch_end (mark);
+      return TID_ERROR;
+    }
+  args->argc = 0;
+  dst = args->words;
+  for (src = file_name; *src != '\0'; )
+    if (*src == ' ')
+      src++;
+    else
+      {
+        while (*src != '\0' && *src != ' ')
+          *dst++ = *src++;
+        *dst++ = '\0';
+        args->argc++;
+      }
+  args->size = dst - args->words;
+
+  /* The words, argv[], and the words below it must fit in the
+     stack page. */
+  if (args->argc == 0
+      || (ROUND_UP (args->size, sizeof (char *))
+          + (args->argc + 4) * sizeof (char *) > PGSIZE))
+    {
+      scratch_end (mark);
+      return TID_ERROR;
+    }
 
-  char *save_ptr;
-  file_name = strtok_r (fn_m, " ", &save_ptr);  
+  args->status = children_table () ? child_status_create () : NULL;
+  args->proc = args->status != NULL ? process_create () : NULL;
+  if (args->proc == NULL)
+    {
+      if (args->status != NULL)
+        kmem_cache_free (&child_status_cache, args->status);
+      scratch_end (mark);
+      return TID_ERROR;
+    }
+  inherit_limits (args->proc);
+  args->parent = thread_process ();
+  args->spawn = spawn;
+  args->actions = actions;
+  args->action_cnt = action_cnt;
+  args->cwd = cwd;
+  sema_init (&args->loaded, 0);
+  args->success = false;
+
+  /* Create a new thread to execute the first word. */
+  tid = thread_create (args->words, PRI_DEFAULT, start_process, args);
+  if (tid == TID_ERROR)
+    {
+      free (args->proc);
+      kmem_cache_free (&child_status_cache, args->status);
+      scratch_end (mark);
+      return tid;
+    }
 
-  struct thread *cur = thread_current ();
-  sema_init (&cur->load_sema, 0);
-  /* Create a new thread to execute FILE_NAME. */
-  tid = thread_create (file_name, PRI_DEFAULT, start_process, fn_copy);
-
-  if(tid == TID_ERROR)
-    {
-	  /* free both copies of file_name */
-	  palloc_free_page (fn_m);
-	  palloc_free_page (fn_copy);
-	  return tid;
-     }
-  cur->process_status = TASK_STOPPED;
-  sema_down (&cur->load_sema);
-  struct thread *child = get_child_by_tid (TID_ERROR);
-  palloc_free_page (fn_m);
-  palloc_free_page (fn_copy);
-  
-  /* Destroy child thread that did not load */ 
-  if (child != NULL)
-  {
-    list_remove (&child->child_elem);
-	palloc_free_page (child);
-	return TID_ERROR;
-  }
-  
-  return tid;
-}
+  /* Wait for the child to load.  One that did not is already
+     on its way out and needs nothing more from us. */
+  sema_down (&args->loaded);
+  if (!args->success)
+    {
+      child_status_release (args->status);
+      scratch_end (mark);
+      return TID_ERROR;
+    }
 
-void
-set_args_onto_stack(void **esp, const char *file_name, char *save_ptr)
-{
-  int max_args_count = 30;
-  char *token;
- 
-  char **argv = (char **) malloc (max_args_count * sizeof (char *));
-  char *addrs[max_args_count];
-
-  /* push argv values onto stack. */
-  int cnt = 0;
-  //printf("file_name : %s\n", file_name);
-  argv[cnt] = file_name;
-  cnt++;
-  token = strtok_r (NULL, " ", &save_ptr);
-  while (token != NULL) {
-	//*esp -= (strlen (token) + 1); // last chararcter is null character.
-	//memcpy (*esp, token, strlen (token) + 1);
-	//argv[cnt] = *esp;
-    argv[cnt] = token;
-	cnt++;
-	//printf("token : %s, *esp : %x\n", token, *esp);
-	token = strtok_r (NULL, " ", &save_ptr);
-  }
-  int argc = cnt;
-  //printf("argc : %d\n", argc);
- 
-  addrs[argc] = 0;
-  for (cnt = argc - 1; cnt >= 0; cnt--) {
-	 *esp -= (strlen (argv[cnt]) + 1);
-	 addrs[cnt] = *esp;
-	 memcpy (*esp, argv[cnt], strlen (argv[cnt]) + 1);
-	 //printf("token : %s, addr : %x, %x\n", *esp, addrs[cnt], *esp);
-  }
-  
-  /* push word_align onto stack. */
-  int word_align = 4 - (PHYS_BASE - *esp) % 4;
-  if (word_align != 0) {
-    *esp -= word_align;
-    memcpy (*esp, &addrs[argc], word_align);
-	//printf("word_align : %d, %x\n", word_align, *esp);
-  }
-
-  /* push the address of elements of argv array onto stack. */
-  for (cnt = argc; cnt >= 0; cnt--) {
-  	*esp -= (sizeof (char *));
-	memcpy (*esp, &addrs[cnt], sizeof (char *));
-	//printf("args(%d) : %p, %x\n", cnt, addrs[cnt], *esp);
-  }
-
-  /* push the address of argv array onto stack. */
-  char **argv_array_address = *esp;
-  *esp -= (sizeof (char **));
-  memcpy(*esp, &argv_array_address, sizeof (char **));
-  //printf("argv : %x, %x\n", argv_array_address, *esp);
-
-  /* push argc value onto stack. */
-  *esp -= (sizeof (int));
-  memcpy(*esp, &argc, sizeof (int));
-  //printf("argc : %d, %x\n", argc, *esp);
-
-  /* push return address onto stack. */
-  *esp -= (sizeof (void *));
-  memcpy(*esp, &addrs[argc], sizeof (void *));
-  //printf("return address : %d, %x\n", addrs[argc], *esp);
-
-  free(argv);
+  args->status->tid = tid;
+  hash_insert (thread_process ()->proc->children, &args->status->elem);
+  scratch_end (mark);
+  return tid;
 }
 
 /* A thread function that loads a user process and starts it
    running. */
 static void
-start_process (void *file_name_)
+start_process (void *args_)
 {
-  char *file_name = file_name_;
+  struct exec_args *args = args_;
+  struct thread *cur = thread_current ();
   struct intr_frame if_;
   bool success;
-	
+
+  /* Killed unless it calls exit().  A parent waiting for the
+     load, or later for the exit, lends us its priority. */
+  cur->proc = args->proc;
+  cur->acct = &cur->proc->stats;
+  cur->limits = &cur->proc->limits;
+  cur->proc->status_rec = args->status;
+  sema_own (&args->loaded, &args->loaded_hint);
+  sema_own (&args->status->exited, &args->status->exited_hint);
+
   /* Initialize interrupt frame and load executable. */
   memset (&if_, 0, sizeof if_);
   if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
   if_.cs = SEL_UCSEG;
   if_.eflags = FLAG_IF | FLAG_MBS;
-  success = load (file_name, &if_.eip, &if_.esp);
+  success = (!args->spawn
+             || (syscall_spawn_files (args->parent, args->actions,
+                                      args->action_cnt)
+                 && (args->cwd == NULL || filesys_chdir (args->cwd))));
+  success = success && load (args, &if_.eip, &if_.esp);
 
-  struct thread *cur = thread_current();
+  /* Tell the parent how it went.  ARGS is gone after this. */
+  args->success = success;
+  sema_disown (&args->loaded);
+  sema_up (&args->loaded);
 
   /* If load failed, quit. */
-  // palloc_free_page (file_name);
-  if (!success) {
-	thread_current ()->tid = TID_ERROR;
-	thread_exit ();
-  }
+  if (!success)
+    thread_exit ();
 
-  if(!thread_current()->cwd) thread_current()->cwd = dir_open_root();
+  if(!cur->cwd) cur->cwd = dir_open_root();
 
-  sema_up(&cur->parent->load_sema);
   /* Start the user process by simulating a return from an
      interrupt, implemented by intr_exit (in
      threads/intr-stubs.S).  Because intr_exit takes all of its
@@ -188,6 +332,314 @@ start_process (void *file_name_)
   NOT_REACHED ();
 }
 
+#ifdef VM
+/* Snapshots.
+
+   process_snapshot() saves the running process as it is at the
+   system call by forking a copy of it that never runs.  The
+   copy's thread, the snapshot's HOLDER, only keeps the copy's
+   address space, sharing its frames copy-on-write, along with
+   its file descriptors and FPU state, until the snapshot is
+   dropped.  process_exec_snapshot() starts a new process by
+   forking the holder instead of the running process, so that it
+   takes up at the snapshot() call where the process that made
+   the snapshot left off, but sees 1 returned, with everything
+   that process did before the call already done.  SNAPSHOT_LOCK
+   is held throughout a fork from a holder, so that the snapshot
+   is not dropped in the middle. */
+struct snapshot
+  {
+    struct list_elem elem;      /* Element in SNAPSHOTS. */
+    char name[SNAPSHOT_NAME_MAX + 1]; /* Name, null-terminated. */
+    struct thread *holder;      /* Thread that keeps the copy. */
+    struct intr_frame if_;      /* Registers to start copies with. */
+    struct semaphore drop;      /* Upped to let HOLDER exit. */
+  };
+
+static struct list snapshots;   /* All snapshots. */
+static struct lock snapshot_lock; /* Protects SNAPSHOTS. */
+
+/* Passed from fork_from() to fork_process(). */
+struct fork_info
+  {
+    struct thread *parent;      /* Process being copied. */
+    struct process *proc;       /* The child's process state. */
+    struct intr_frame if_;      /* Its registers at the system call. */
+    struct child_status *status; /* The child's status record. */
+    struct snapshot *snapshot;  /* Snapshot the child holds, or null. */
+    struct semaphore copied;    /* Upped once the copy is over. */
+    struct lock copied_hint;    /* Owns COPIED for the child. */
+    bool success;               /* Was the copy made? */
+  };
+
+static tid_t fork_from (struct thread *parent, const struct intr_frame *,
+                        struct snapshot *);
+static struct snapshot *snapshot_lookup (const char *name);
+static void snapshot_drop (struct snapshot *);
+
+/* Starts a new thread running a copy of the running process,
+   which resumes from the system call with the registers in F,
+   except that it sees 0 returned.  Writable memory is shared
+   copy-on-write (see page_table_copy()).  Returns the new
+   process's thread id, or TID_ERROR if the copy cannot be
+   made. */
+tid_t
+process_fork (struct intr_frame *f)
+{
+  struct thread *cur = thread_current ();
+  struct intr_frame if_ = *f;
+
+  /* Only the calling thread would be copied, so refuse to copy
+     the others' address space out from under them. */
+  if (cur->process != cur
+      || (cur->threads != NULL && cur->threads->live > 0))
+    return TID_ERROR;
+
+  if_.eax = 0;
+  return fork_from (cur, &if_, NULL);
+}
+
+/* Saves the running process, as it is at the system call with
+   registers F, as the snapshot NAME, replacing any snapshot of
+   that name.  Returns 0 if successful, or -1 if NAME is empty or
+   longer than SNAPSHOT_NAME_MAX, the process has other threads,
+   or memory is not available. */
+int
+process_snapshot (const char *name, struct intr_frame *f)
+{
+  struct thread *cur = thread_current ();
+  struct snapshot *s;
+  tid_t tid;
+
+  if (*name == '\0' || strlen (name) > SNAPSHOT_NAME_MAX
+      || cur->process != cur
+      || (cur->threads != NULL && cur->threads->live > 0))
+    return -1;
+
+  s = malloc (sizeof *s);
+  if (s == NULL)
+    return -1;
+  strlcpy (s->name, name, sizeof s->name);
+  s->if_ = *f;
+  s->if_.eax = 1;
+  sema_init (&s->drop, 0);
+
+  lock_acquire (&snapshot_lock);
+  tid = fork_from (cur, f, s);
+  if (tid != TID_ERROR)
+    {
+      struct snapshot *old = snapshot_lookup (name);
+      if (old != NULL)
+        snapshot_drop (old);
+      list_push_back (&snapshots, &s->elem);
+    }
+  lock_release (&snapshot_lock);
+
+  if (tid == TID_ERROR)
+    {
+      free (s);
+      return -1;
+    }
+  return 0;
+}
+
+/* Starts a new child of the running process from the snapshot
+   NAME.  Returns the new process's thread id, or TID_ERROR if
+   there is no such snapshot or memory is not available. */
+tid_t
+process_exec_snapshot (const char *name)
+{
+  struct snapshot *s;
+  tid_t tid = TID_ERROR;
+
+  lock_acquire (&snapshot_lock);
+  s = snapshot_lookup (name);
+  if (s != NULL)
+    tid = fork_from (s->holder, &s->if_, NULL);
+  lock_release (&snapshot_lock);
+  return tid;
+}
+
+/* Drops the snapshot NAME, freeing what it keeps once no
+   process is being started from it.  Returns false if there is
+   no such snapshot. */
+bool
+process_drop_snapshot (const char *name)
+{
+  struct snapshot *s;
+
+  lock_acquire (&snapshot_lock);
+  s = snapshot_lookup (name);
+  if (s != NULL)
+    snapshot_drop (s);
+  lock_release (&snapshot_lock);
+  return s != NULL;
+}
+
+/* Returns the snapshot named NAME, or a null pointer if there is
+   none.  SNAPSHOT_LOCK must be held. */
+static struct snapshot *
+snapshot_lookup (const char *name)
+{
+  struct list_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&snapshot_lock));
+  for (e = list_begin (&snapshots); e != list_end (&snapshots);
+       e = list_next (e))
+    {
+      struct snapshot *s = list_entry (e, struct snapshot, elem);
+      if (!strcmp (s->name, name))
+        return s;
+    }
+  return NULL;
+}
+
+/* Removes S from SNAPSHOTS and lets its holder exit, which frees
+   S.  SNAPSHOT_LOCK must be held. */
+static void
+snapshot_drop (struct snapshot *s)
+{
+  ASSERT (lock_held_by_current_thread (&snapshot_lock));
+  list_remove (&s->elem);
+  sema_up (&s->drop);
+}
+
+/* Starts a new thread running a copy of PARENT, which must be the
+   running process or a snapshot's holder, which resumes in user
+   mode with registers F.  If S is null, the copy is a child of
+   the running process; otherwise it becomes S's holder and never
+   runs.  Returns the new thread's id, or TID_ERROR if the copy
+   cannot be made. */
+static tid_t
+fork_from (struct thread *parent, const struct intr_frame *f,
+           struct snapshot *s)
+{
+  struct thread *cur = thread_current ();
+  struct fork_info info;
+  tid_t tid;
+
+  /* INFO stays put until the child is done with it, because we
+     wait for that below. */
+  info.parent = parent;
+  info.if_ = *f;
+  info.snapshot = s;
+  info.status = NULL;
+  if (s == NULL)
+    {
+      info.status = children_table () ? child_status_create () : NULL;
+      if (info.status == NULL)
+        return TID_ERROR;
+    }
+  info.proc = process_create ();
+  if (info.proc == NULL)
+    {
+      if (info.status != NULL)
+        kmem_cache_free (&child_status_cache, info.status);
+      return TID_ERROR;
+    }
+  inherit_limits (info.proc);
+  sema_init (&info.copied, 0);
+  info.success = false;
+
+  tid = thread_create (parent->name, PRI_DEFAULT, fork_process, &info);
+  if (tid == TID_ERROR)
+    {
+      free (info.proc);
+      if (info.status != NULL)
+        kmem_cache_free (&child_status_cache, info.status);
+      return tid;
+    }
+
+  sema_down (&info.copied);
+  if (!info.success)
+    {
+      if (info.status != NULL)
+        child_status_release (info.status);
+      return TID_ERROR;
+    }
+
+  if (info.status != NULL)
+    {
+      info.status->tid = tid;
+      hash_insert (cur->proc->children, &info.status->elem);
+    }
+  return tid;
+}
+
+/* A thread function that copies the address space and file
+   descriptors of the process that fork_from() was given and
+   starts the copy running, or keeps it for a snapshot. */
+static void
+fork_process (void *info_)
+{
+  struct fork_info *info = info_;
+  struct thread *parent = info->parent;
+  struct thread *cur = thread_current ();
+  struct process *proc = info->proc;
+  struct intr_frame if_ = info->if_;
+  struct snapshot *s = info->snapshot;
+  bool success = false;
+
+  cur->proc = proc;
+  cur->acct = &proc->stats;
+  cur->limits = &proc->limits;
+  proc->status_rec = info->status;
+  sema_own (&info->copied, &info->copied_hint);
+  if (info->status != NULL)
+    sema_own (&info->status->exited, &info->status->exited_hint);
+
+  cur->pagedir = pagedir_create ();
+  if (cur->pagedir != NULL && !page_table_init ())
+    {
+      pagedir_destroy (cur->pagedir);
+      cur->pagedir = NULL;
+    }
+  if (cur->pagedir != NULL)
+    {
+      process_activate ();
+      if (parent->proc->executable != NULL)
+        {
+          proc->executable = file_reopen (parent->proc->executable);
+          if (proc->executable != NULL)
+            file_deny_write (proc->executable);
+        }
+      cur->user_esp = parent->user_esp;
+      proc->heap_base = parent->proc->heap_base;
+      proc->brk = parent->proc->brk;
+      success = ((parent->proc->executable == NULL
+                  || proc->executable != NULL)
+                 && page_table_copy (parent)
+                 && mmap_copy_shared (parent)
+                 && syscall_copy_files (parent)
+                 && fpu_fork (parent));
+    }
+
+  /* Tell the parent how it went.  INFO is gone after this. */
+  if (success && s != NULL)
+    s->holder = cur;
+  info->success = success;
+  sema_disown (&info->copied);
+  sema_up (&info->copied);
+
+  /* If the copy failed, quit. */
+  if (!success)
+    thread_exit ();
+
+  /* A snapshot's holder keeps the copy until it is dropped. */
+  if (s != NULL)
+    {
+      sema_down (&s->drop);
+      free (s);
+      thread_exit ();
+    }
+
+  if(!cur->cwd) cur->cwd = dir_open_root();
+
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+#endif
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
@@ -200,38 +652,87 @@ start_process (void *file_name_)
 int
 process_wait (tid_t child_tid) 
 {
-  int status = -1;
-  struct thread *child = get_child_by_tid (child_tid);
-  struct thread *cur = thread_current ();  
+  return process_wait_stats (child_tid, NULL);
+}
 
-  if (child != NULL)
-  {
-	/* Wait for child process to complete */
-	cur->process_status = TASK_STOPPED;
-  	sema_down (&child->wait_sema);
-	status = child->exit_status;
-	list_remove (&child->child_elem);
-	
-	/* Destroy thread */
-	palloc_free_page (child);
-  }
-  
+/* Like process_wait(), but also stores the resources the child
+   used into *STATS, if STATS is nonnull, or zeros if there is no
+   such child to wait for. */
+int
+process_wait_stats (tid_t child_tid, struct proc_stats *stats)
+{
+  struct process *proc = thread_process ()->proc;
+  struct child_status key, *child;
+  struct hash_elem *e;
+  int status;
+
+  if (stats != NULL)
+    memset (stats, 0, sizeof *stats);
+  if (proc == NULL || proc->children == NULL)
+    return -1;
+  key.tid = child_tid;
+  e = hash_find (proc->children, &key.elem);
+  if (e == NULL)
+    return -1;
+  child = hash_entry (e, struct child_status, elem);
+
+  /* Wait for child process to complete */
+  if (!process_sema_down (&child->exited))
+    return -1;
+  status = child->exit_status;
+  if (stats != NULL)
+    *stats = child->stats;
+  hash_delete (proc->children, &child->elem);
+  child_status_release (child);
   return status;
 }
 
-struct thread *
-get_child_by_tid (tid_t tid)
+/* Waits for any child of the running process to die, stores its
+   exit status into *STATUS, and returns its thread id.  A child
+   that has died already is taken without waiting.  Returns
+   TID_ERROR at once if there are no children left to wait for.
+   CHILD_EXITED is upped for every child's death, including those
+   that process_wait() waits for, so a wakeup may find nothing,
+   and we look again. */
+tid_t
+process_wait_any (int *status)
 {
-  struct list_elem *e;
-  struct thread *t = thread_current ();
+  struct process *proc = thread_process ()->proc;
 
-  for (e = list_begin (&t->children); e != list_end (&t->children); e = list_next (e))
-  {
-    struct thread *child = list_entry (e, struct thread, child_elem);
-    if (child->tid == tid)
-	  return child;
-  }
-  return NULL;
+  if (proc == NULL || proc->children == NULL)
+    return TID_ERROR;
+  for (;;)
+    {
+      struct child_status *child = NULL;
+      struct hash_iterator i;
+      tid_t tid;
+
+      if (hash_empty (proc->children))
+        return TID_ERROR;
+      hash_first (&i, proc->children);
+      while (hash_next (&i))
+        {
+          struct child_status *cs = hash_entry (hash_cur (&i),
+                                                struct child_status, elem);
+          if (sema_try_down (&cs->exited))
+            {
+              child = cs;
+              break;
+            }
+        }
+      if (child == NULL)
+        {
+          if (!process_sema_down (&proc->child_exited))
+            return TID_ERROR;
+          continue;
+        }
+
+      tid = child->tid;
+      *status = child->exit_status;
+      hash_delete (proc->children, &child->elem);
+      child_status_release (child);
+      return tid;
+    }
 }
 
 /* Free the current process's resources. */
@@ -240,27 +741,36 @@ process_exit (void)
 {
 //  printf("%s\n", "process_exit");
   struct thread *cur = thread_current ();
+  struct process *proc = cur->proc;
   uint32_t *pd;
 
-  /* Release child process's resource */  
-  if (!list_empty (&cur->children))
-  {
-    struct list_elem *e;
-    for (e = list_begin (&cur->children);
-	e != list_end (&cur->children);
-	e = list_next (e))
+  if (cur->process != cur)
     {
-      struct thread *child = list_entry (e, struct thread, child_elem);
-      child->parent = NULL;
-      if (child->process_status == TASK_ZOMBIE)
-	palloc_free_page (child);
+      uthread_finish ();
+      return;
     }
-  }
+  if (cur->threads != NULL)
+    uthreads_destroy ();
 
-  if(cur->cwd) dir_close(cur->cwd);
+  fpu_exit ();
+
+  syscall_console_done ();
+  syscall_release_files ();
+  if (proc != NULL)
+    {
+      /* Let go of the children we never waited for. */
+      if (proc->children != NULL)
+        {
+          hash_destroy (proc->children, child_status_orphan);
+          free (proc->children);
+          proc->children = NULL;
+        }
 
-  cur->parent->process_status = TASK_RUNNING;
-  cur->process_status = TASK_ZOMBIE;
+      syscall_trace_exit ();
+      aio_exit ();
+      syscall_close_files ();
+    }
+  if(cur->cwd) dir_close(cur->cwd);
 
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
@@ -276,10 +786,681 @@ process_exit (void)
          directory before destroying the process's page
          directory, or our active page directory will be one
          that's been freed (and cleared). */
+#ifdef VM
+      /* Tear down the pages with the base page directory active,
+         so that unmapping each one needs no TLB invalidation.
+         PD is still valid if a thread switch activates it
+         again. */
+      pagedir_activate (NULL);
+      mmap_unmap_all ();
+      page_table_destroy ();
+#endif
       cur->pagedir = NULL;
       pagedir_activate (NULL);
       pagedir_destroy (pd);
     }
+
+  if (proc == NULL)
+    return;
+
+  /* Stop denying writes to the executable. */
+  if (proc->executable != NULL)
+    file_close (proc->executable);
+
+  /* Hand the exit status to the parent, and wake it if it is in
+     process_wait_any().  NOTIFY is gone once the parent lets go
+     of the record, which it cannot do while interrupts are off
+     here. */
+  if (proc->status_rec != NULL)
+    {
+      struct child_status *cs = proc->status_rec;
+      enum intr_level old_level;
+
+      cs->exit_status = proc->exit_status;
+      cs->stats = proc->stats;
+      sema_disown (&cs->exited);
+      sema_up (&cs->exited);
+      old_level = intr_disable ();
+      if (cs->ref_cnt == 2)
+        sema_up (cs->notify);
+      intr_set_level (old_level);
+      child_status_release (cs);
+    }
+  cur->proc = NULL;
+  cur->acct = NULL;
+  cur->limits = NULL;
+  free (proc);
+}
+
+/* Returns a new, empty process state, or a null pointer if
+   memory is exhausted. */
+static struct process *
+process_create (void)
+{
+  struct process *proc = calloc (1, sizeof *proc);
+
+  if (proc != NULL)
+    {
+      proc->exit_status = -1;
+      sema_init (&proc->child_exited, 0);
+      lock_init (&proc->fd_lock);
+      lock_init (&proc->exit_lock);
+      list_init (&proc->exit_waits);
+    }
+  return proc;
+}
+
+/* Gives PROC, a new process started by the running one, the
+   running process's limits. */
+static void
+inherit_limits (struct process *proc)
+{
+  memcpy (proc->limits.max, thread_process ()->proc->limits.max,
+          sizeof proc->limits.max);
+}
+
+/* Returns the running process's table of children, creating it
+   if it does not exist yet, or a null pointer if memory is
+   exhausted. */
+static struct hash *
+children_table (void)
+{
+  struct thread *cur = thread_process ();
+  struct process *proc;
+
+  /* A kernel thread gets its process state here. */
+  if (cur->proc == NULL)
+    cur->proc = process_create ();
+  proc = cur->proc;
+  if (proc == NULL)
+    return NULL;
+
+  if (proc->children == NULL)
+    {
+      proc->children = malloc (sizeof *proc->children);
+      if (proc->children != NULL
+          && !hash_init (proc->children, child_status_hash,
+                         child_status_less, NULL))
+        {
+          free (proc->children);
+          proc->children = NULL;
+        }
+    }
+  return proc->children;
+}
+
+/* Returns a new status record, held by both parent and child,
+   or a null pointer if memory is exhausted.  The running process
+   must have a children table already. */
+static struct child_status *
+child_status_create (void)
+{
+  struct child_status *cs = kmem_cache_alloc (&child_status_cache);
+
+  if (cs != NULL)
+    {
+      cs->tid = TID_ERROR;
+      cs->exit_status = -1;
+      sema_init (&cs->exited, 0);
+      cs->notify = &thread_process ()->proc->child_exited;
+      cs->ref_cnt = 2;
+    }
+  return cs;
+}
+
+/* Lets go of CS, for either the parent or the child, freeing it
+   if the other has already done so. */
+static void
+child_status_release (struct child_status *cs)
+{
+  enum intr_level old_level;
+  bool last;
+
+  old_level = intr_disable ();
+  last = --cs->ref_cnt == 0;
+  intr_set_level (old_level);
+
+  if (last)
+    kmem_cache_free (&child_status_cache, cs);
+}
+
+/* Returns a hash value for the child_status in E. */
+static unsigned
+child_status_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct child_status *cs = hash_entry (e, struct child_status, elem);
+  return hash_int (cs->tid);
+}
+
+/* Returns true if child_status A has a lower tid than B. */
+static bool
+child_status_less (const struct hash_elem *a_, const struct hash_elem *b_,
+                   void *aux UNUSED)
+{
+  const struct child_status *a = hash_entry (a_, struct child_status, elem);
+  const struct child_status *b = hash_entry (b_, struct child_status, elem);
+  return a->tid < b->tid;
+}
+
+/* Lets go of the child_status in E for an exiting parent. */
+static void
+child_status_orphan (struct hash_elem *e, void *aux UNUSED)
+{
+  child_status_release (hash_entry (e, struct child_status, elem));
+}
+
+/* Marks the running process as exiting, with exit status STATUS,
+   so that all of its threads exit, and wakes those sleeping on
+   futexes or in any wait added by process_watch_exit().  Returns
+   false, doing nothing, if the process was already exiting. */
+bool
+process_begin_exit (int status)
+{
+  struct thread *p = thread_process ();
+  enum intr_level old_level;
+  bool first;
+
+  old_level = intr_disable ();
+  first = !p->exiting;
+  if (first)
+    {
+      p->exiting = true;
+      p->proc->exit_status = status;
+    }
+  intr_set_level (old_level);
+
+  /* Only another thread can be asleep while this one runs. */
+  if (first && p->threads != NULL)
+    {
+      struct process *proc = p->proc;
+      struct list_elem *e;
+
+      futex_wake_all (p->pagedir);
+      lock_acquire (&proc->exit_lock);
+      for (e = list_begin (&proc->exit_waits);
+           e != list_end (&proc->exit_waits); e = list_next (e))
+        {
+          struct exit_wait *w = list_entry (e, struct exit_wait, elem);
+          w->wake (w->aux);
+        }
+      lock_release (&proc->exit_lock);
+    }
+  return first;
+}
+
+/* Adds W to the running process's waits that process_begin_exit()
+   cuts short by calling WAKE (AUX), until process_unwatch_exit().
+   Returns false, adding nothing, if the process is exiting
+   already, in which case the caller must not wait at all. */
+bool
+process_watch_exit (struct exit_wait *w, void (*wake) (void *), void *aux)
+{
+  struct thread *p = thread_process ();
+  bool watching;
+
+  w->wake = wake;
+  w->aux = aux;
+  lock_acquire (&p->proc->exit_lock);
+  watching = !p->exiting;
+  if (watching)
+    list_push_back (&p->proc->exit_waits, &w->elem);
+  lock_release (&p->proc->exit_lock);
+  return watching;
+}
+
+/* Takes W, added by process_watch_exit(), back out. */
+void
+process_unwatch_exit (struct exit_wait *w)
+{
+  struct process *proc = thread_process ()->proc;
+
+  lock_acquire (&proc->exit_lock);
+  list_remove (&w->elem);
+  lock_release (&proc->exit_lock);
+}
+
+/* Wakes thread T_ from sema_down_intr(), for process_sema_down(). */
+static void
+wake_thread (void *t_)
+{
+  sema_interrupt (t_);
+}
+
+/* Downs SEMA, unless the running process begins to exit first.
+   Returns true if SEMA was downed, false if the process is
+   exiting, which its thread will do on the way back to user
+   mode. */
+static bool
+process_sema_down (struct semaphore *sema)
+{
+  struct exit_wait w;
+  bool downed = false;
+
+  if (process_watch_exit (&w, wake_thread, thread_current ()))
+    {
+      downed = sema_down_intr (sema, &thread_process ()->exiting);
+      process_unwatch_exit (&w);
+    }
+  return downed;
+}
+
+/* Starts a new thread in the running process that calls ENTRY,
+   in user mode, as ENTRY (FUNC, AUX), on a stack of its own.
+   ENTRY must not return.  Returns the new thread's id, or
+   TID_ERROR if the process already has UTHREAD_MAX threads
+   besides its leader, is exiting, or memory is not available. */
+tid_t
+process_thread_create (void *entry, void *func, void *aux)
+{
+  struct thread *p = thread_process ();
+  struct process_threads *pt = p->threads;
+  struct uthread_info info;
+  struct uthread *u;
+  uint32_t *esp;
+  uint32_t frame[3];
+  tid_t tid;
+  int slot;
+
+  if (p->exiting)
+    return TID_ERROR;
+  if (pt == NULL)
+    {
+      /* Only threads of P change P->THREADS, and before the first
+         one is made there are none but P. */
+      pt = malloc (sizeof *pt);
+      if (pt == NULL)
+        return TID_ERROR;
+      lock_init (&pt->lock);
+      list_init (&pt->threads);
+      pt->live = 0;
+      cond_init (&pt->all_exited);
+      pt->slots_used = 0;
+      p->threads = pt;
+    }
+  u = malloc (sizeof *u);
+  if (u == NULL)
+    return TID_ERROR;
+
+  /* Claim a slot and count the thread as live before it can
+     run, so that the leader waits for it. */
+  lock_acquire (&pt->lock);
+  slot = ~pt->slots_used != 0 ? __builtin_ctz (~pt->slots_used) : 32;
+  if (slot >= UTHREAD_MAX)
+    {
+      lock_release (&pt->lock);
+      free (u);
+      return TID_ERROR;
+    }
+  pt->slots_used |= 1u << slot;
+  pt->live++;
+  lock_release (&pt->lock);
+
+  u->tid = TID_ERROR;
+  u->slot = slot;
+  u->exit_status = -1;
+  sema_init (&u->exited, 0);
+  u->joined = false;
+  u->clean = false;
+
+  /* ENTRY (FUNC, AUX), called from a null return address. */
+  esp = (uint32_t *) uthread_stack_top (slot) - 3;
+  frame[0] = 0;
+  frame[1] = (uint32_t) func;
+  frame[2] = (uint32_t) aux;
+  tid = TID_ERROR;
+  if (uthread_stack_add (slot) && copy_to_user (esp, frame, sizeof frame))
+    {
+      info.process = p;
+      info.uthread = u;
+      memset (&info.if_, 0, sizeof info.if_);
+      info.if_.gs = info.if_.fs = info.if_.es = info.if_.ds = SEL_UDSEG;
+      info.if_.ss = SEL_UDSEG;
+      info.if_.cs = SEL_UCSEG;
+      info.if_.eflags = FLAG_IF | FLAG_MBS;
+      info.if_.eip = entry;
+      info.if_.esp = esp;
+      sema_init (&info.started, 0);
+      tid = thread_create (p->name, thread_get_priority (), start_uthread,
+                           &info);
+    }
+
+  lock_acquire (&pt->lock);
+  if (tid == TID_ERROR)
+    {
+      pt->slots_used &= ~(1u << slot);
+      if (--pt->live == 0)
+        cond_signal (&pt->all_exited, &pt->lock);
+      free (u);
+    }
+  else
+    {
+      u->tid = tid;
+      list_push_back (&pt->threads, &u->elem);
+    }
+  lock_release (&pt->lock);
+
+  /* INFO must stay put until the new thread has copied it. */
+  if (tid != TID_ERROR)
+    sema_down (&info.started);
+  return tid;
+}
+
+/* Waits for thread TID of the running process, other than its
+   leader, to exit, and returns the status it passed to
+   process_thread_exit().  Returns -1 at once if there is no
+   such thread, if it is the running thread, or if it has been
+   joined already or is being joined by another thread.  Returns
+   -1 after waiting if the thread was killed. */
+int
+process_thread_join (tid_t tid)
+{
+  struct process_threads *pt = thread_process ()->threads;
+  struct uthread *u = NULL;
+  struct list_elem *e;
+  int status;
+
+  if (pt == NULL || tid == thread_tid ())
+    return -1;
+  lock_acquire (&pt->lock);
+  for (e = list_begin (&pt->threads); e != list_end (&pt->threads);
+       e = list_next (e))
+    {
+      struct uthread *v = list_entry (e, struct uthread, elem);
+      if (v->tid == tid && !v->joined)
+        {
+          u = v;
+          u->joined = true;
+          break;
+        }
+    }
+  lock_release (&pt->lock);
+  if (u == NULL)
+    return -1;
+
+  /* If we give up, uthreads_destroy() frees U. */
+  if (!process_sema_down (&u->exited))
+    return -1;
+  status = u->exit_status;
+  lock_acquire (&pt->lock);
+  list_remove (&u->elem);
+  lock_release (&pt->lock);
+  free (u);
+  return status;
+}
+
+/* Ends the running thread, which must not be its process's
+   leader, with exit status STATUS for process_thread_join(). */
+void
+process_thread_exit (int status)
+{
+  struct thread *cur = thread_current ();
+
+  ASSERT (cur->process != cur);
+
+  cur->uthread->exit_status = status;
+  cur->uthread->clean = true;
+  thread_exit ();
+}
+
+/* Moves the end of the running process's heap by INCREMENT
+   bytes and returns where it was, or (void *) -1 if it would go
+   below the start of the heap or into the stacks, or memory is
+   not available.  New heap pages are zeroed; under VM they are
+   left to be brought in when touched.  Pages wholly above the
+   new end are taken away. */
+void *
+process_sbrk (intptr_t increment)
+{
+  struct process *p = thread_process ()->proc;
+  uint8_t *limit = uthread_stack_top (UTHREAD_MAX - 1)
+                   - (UTHREAD_STACK_PAGES + 1) * PGSIZE;
+  uint8_t *old_brk, *new_brk;
+  void *result = (void *) -1;
+
+  lock_acquire (&brk_lock);
+  old_brk = p->brk;
+  new_brk = old_brk + increment;
+  if (p->heap_base == NULL)
+    ;
+  else if (increment >= 0)
+    {
+      if (new_brk >= old_brk && new_brk <= limit
+          && brk_add (pg_round_up (old_brk), pg_round_up (new_brk)))
+        result = old_brk;
+    }
+  else if (new_brk < old_brk && new_brk >= p->heap_base)
+    {
+      brk_remove (pg_round_up (new_brk), pg_round_up (old_brk));
+      result = old_brk;
+    }
+  if (result != (void *) -1)
+    p->brk = new_brk;
+  lock_release (&brk_lock);
+  return result;
+}
+
+/* Sets the running process's limit on RESOURCE, an enum
+   proc_limit, to LIMIT.  A limit may only be tightened: returns
+   false, changing nothing, if LIMIT is 0 or above the limit
+   already in force, or if RESOURCE is unknown. */
+bool
+process_set_limit (int resource, unsigned limit)
+{
+  struct proc_limits *l = thread_current ()->limits;
+
+  if (l == NULL || resource < 0 || resource >= LIMIT_CNT || limit == 0
+      || (l->max[resource] != 0 && limit > l->max[resource]))
+    return false;
+  l->max[resource] = limit;
+  return true;
+}
+
+/* Returns the running process's limit on RESOURCE, an enum
+   proc_limit, or 0 if there is none or RESOURCE is unknown. */
+unsigned
+process_get_limit (int resource)
+{
+  struct proc_limits *l = thread_current ()->limits;
+
+  if (l == NULL || resource < 0 || resource >= LIMIT_CNT)
+    return 0;
+  return l->max[resource];
+}
+
+/* Sleeps until the disk sectors the running process has used
+   beyond its LIMIT_IO_RATE are paid for.  The block layer only
+   charges requests to the budget, because they are often
+   submitted with the buffer cache's lock held, where holding
+   them back would stall every process; this is called on the way
+   back to user mode instead, with no locks held. */
+void
+process_io_throttle (void)
+{
+  struct proc_limits *l = thread_current ()->limits;
+  uint64_t now;
+
+  if (l == NULL || l->max[LIMIT_IO_RATE] == 0)
+    return;
+  now = clock_ns ();
+  if (l->io_ready > now)
+    timer_nsleep (l->io_ready - now);
+}
+
+/* Adds zeroed pages from START up to END, both page-aligned, to
+   the running process's address space.  If one can't be added,
+   takes back those that were and returns false. */
+static bool
+brk_add (uint8_t *start, uint8_t *end)
+{
+  uint8_t *upage;
+
+  for (upage = start; upage < end; upage += PGSIZE)
+    {
+#ifdef VM
+      if (!page_add_zero (upage, true))
+        break;
+#else
+      uint8_t *kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+      if (kpage == NULL)
+        break;
+      if (!install_page (upage, kpage, true))
+        {
+          palloc_free_page (kpage);
+          break;
+        }
+#endif
+    }
+  if (upage < end)
+    {
+      brk_remove (start, upage);
+      return false;
+    }
+  return true;
+}
+
+/* Takes the pages from START up to END, both page-aligned, out of
+   the running process's address space. */
+static void
+brk_remove (uint8_t *start, uint8_t *end)
+{
+  uint8_t *upage;
+
+  for (upage = start; upage < end; upage += PGSIZE)
+    {
+#ifdef VM
+      page_remove (upage);
+#else
+      uint32_t *pd = thread_current ()->pagedir;
+      void *kpage = pagedir_get_page (pd, upage);
+      if (kpage != NULL)
+        {
+          pagedir_clear_page (pd, upage);
+          palloc_free_page (kpage);
+        }
+#endif
+    }
+}
+
+/* A thread function that starts a thread made by
+   process_thread_create() running in user mode. */
+static void
+start_uthread (void *info_)
+{
+  struct uthread_info *info = info_;
+  struct thread *cur = thread_current ();
+  struct intr_frame if_ = info->if_;
+
+  cur->process = info->process;
+  cur->acct = info->process->acct;
+  cur->limits = info->process->limits;
+  cur->uthread = info->uthread;
+  cur->pagedir = info->process->pagedir;
+  sema_up (&info->started);
+
+  process_activate ();
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
+/* Returns the address just past the top of the stack in SLOT. */
+static uint8_t *
+uthread_stack_top (int slot)
+{
+#ifdef VM
+  uint8_t *top = (uint8_t *) PHYS_BASE - ROUND_UP (page_stack_limit, PGSIZE);
+#else
+  uint8_t *top = (uint8_t *) PHYS_BASE - PGSIZE;
+#endif
+
+  return top - (slot * (UTHREAD_STACK_PAGES + 1) + 1) * PGSIZE;
+}
+
+/* Adds the stack pages of SLOT to the running process's address
+   space, if they are not there from an earlier thread.  Returns
+   false if memory is not available. */
+static bool
+uthread_stack_add (int slot)
+{
+  uint8_t *upage = uthread_stack_top (slot);
+  int i;
+
+  for (i = 0; i < UTHREAD_STACK_PAGES; i++)
+    {
+      upage -= PGSIZE;
+#ifdef VM
+      if (page_lookup (upage) == NULL && !page_add_zero (upage, true))
+        return false;
+#else
+      if (pagedir_get_page (thread_current ()->pagedir, upage) == NULL)
+        {
+          uint8_t *kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+          if (kpage == NULL)
+            return false;
+          if (!install_page (upage, kpage, true))
+            {
+              palloc_free_page (kpage);
+              return false;
+            }
+        }
+#endif
+    }
+  return true;
+}
+
+/* Lets go of the running thread, which is not its process's
+   leader, as it exits.  A thread that did not call
+   process_thread_exit() was killed, and takes the process with
+   it. */
+static void
+uthread_finish (void)
+{
+  struct thread *cur = thread_current ();
+  struct process_threads *pt = cur->process->threads;
+  struct uthread *u = cur->uthread;
+
+  if (!u->clean)
+    process_begin_exit (-1);
+  syscall_console_done ();
+  syscall_release_files ();
+  fpu_exit ();
+
+  /* The page directory belongs to the leader, which destroys it
+     only once we are gone, but stop using it now. */
+  cur->pagedir = NULL;
+  cur->acct = NULL;
+  cur->limits = NULL;
+  pagedir_activate (NULL);
+
+  /* U may be freed by a joiner, and PT by the leader, as soon as
+     they can get PT's lock again. */
+  lock_acquire (&pt->lock);
+  pt->slots_used &= ~(1u << u->slot);
+  sema_up (&u->exited);
+  if (--pt->live == 0)
+    cond_signal (&pt->all_exited, &pt->lock);
+  lock_release (&pt->lock);
+  cur->uthread = NULL;
+}
+
+/* Makes the running thread's other threads exit, waits until
+   they have, and frees its records of them.  The running thread
+   must be the leader of its process. */
+static void
+uthreads_destroy (void)
+{
+  struct thread *cur = thread_current ();
+  struct process_threads *pt = cur->threads;
+
+  process_begin_exit (cur->proc->exit_status);
+  lock_acquire (&pt->lock);
+  while (pt->live > 0)
+    cond_wait (&pt->all_exited, &pt->lock);
+  lock_release (&pt->lock);
+
+  while (!list_empty (&pt->threads))
+    free (list_entry (list_pop_front (&pt->threads), struct uthread, elem));
+  free (pt);
+  cur->threads = NULL;
 }
 
 /* Sets up the CPU for running user code in the current
@@ -289,9 +1470,18 @@ void
 process_activate (void)
 {
   struct thread *t = thread_current ();
+
+  /* Let the thread use the FPU if its state is loaded. */
+  fpu_activate (t);
    
-  /* Activate thread's page tables. */
-  pagedir_activate (t->pagedir);
+  /* Activate thread's page tables.  A kernel thread never
+     touches user memory, so it keeps whichever page directory
+     is active, saving a TLB flush on the way in and, if the
+     same process runs next, on the way out.  This is safe
+     because a process switches to the base page directory
+     before destroying its own. */
+  if (t->pagedir != NULL)
+    pagedir_activate (t->pagedir);
 
   /* Set thread's kernel stack for use in processing
      interrupts. */
@@ -361,24 +1551,99 @@ struct Elf32_Phdr
 #define PF_W 2          /* Writable. */
 #define PF_R 4          /* Readable. */
 
-static bool setup_stack (void **esp, const char *file_name, char *save_ptr);
+struct exec_image;
+static bool setup_stack (void **esp, const struct exec_args *);
+static bool read_image (struct file *, const char *file_name,
+                        struct exec_image *);
+static bool exec_cache_lookup (struct file *, struct exec_image *);
+static void exec_cache_insert (struct file *, const struct exec_image *);
 static bool validate_segment (const struct Elf32_Phdr *, struct file *);
 static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
                           uint32_t read_bytes, uint32_t zero_bytes,
                           bool writable);
 
-/* Loads an ELF executable from FILE_NAME into the current thread.
+/* Most loadable segments an executable may have. */
+#define EXEC_SEGMENTS_MAX 16
+
+/* A loadable segment of an executable, already validated, in the
+   form load_segment() takes. */
+struct exec_segment
+  {
+    uint32_t file_page;         /* Offset in file, page-aligned. */
+    uint32_t mem_page;          /* User virtual page. */
+    uint32_t read_bytes;        /* Bytes to read from the file. */
+    uint32_t zero_bytes;        /* Bytes to zero after them. */
+    bool writable;              /* Writable by the process? */
+  };
+
+/* What load() needs from an executable besides its contents. */
+struct exec_image
+  {
+    void (*entry) (void);       /* Entry point. */
+    int seg_cnt;                /* Number of loadable segments. */
+    struct exec_segment segs[EXEC_SEGMENTS_MAX];
+  };
+
+/* Executable image cache.  Keeps the parsed images of recently
+   loaded executables, so that executing the same program again
+   skips reading and checking its headers.  An entry belongs to
+   one version of one inode, so any write to the executable makes
+   it stale. */
+#define EXEC_CACHE_SIZE 8
+
+/* A cached image. */
+struct exec_cache_entry
+  {
+    bool in_use;                /* Does this entry hold an image? */
+    block_sector_t inumber;     /* Executable's inode. */
+    unsigned version;           /* Its version when parsed. */
+    int64_t last_used;          /* Load count when last used, for LRU. */
+    struct exec_image image;
+  };
+
+static struct exec_cache_entry exec_cache[EXEC_CACHE_SIZE];
+static struct lock exec_cache_lock;   /* Protects the cache. */
+static int64_t exec_load_cnt;         /* Loads, also the LRU clock. */
+static int64_t exec_hit_cnt;          /* Loads that hit the cache. */
+
+/* Initializes the executable image cache and the allocator for
+   child status records. */
+void
+process_init (void)
+{
+  lock_init (&exec_cache_lock);
+  lock_register (&exec_cache_lock, "exec-cache");
+  lock_init (&brk_lock);
+#ifdef VM
+  list_init (&snapshots);
+  lock_init (&snapshot_lock);
+  lock_register (&snapshot_lock, "snapshot");
+#endif
+  kmem_cache_init (&child_status_cache, "child-status",
+                   sizeof (struct child_status), NULL);
+}
+
+/* Prints executable image cache statistics. */
+void
+process_print_stats (void)
+{
+  printf ("Exec: %"PRId64" loads, %"PRId64" from image cache\n",
+          exec_load_cnt, exec_hit_cnt);
+}
+
+/* Loads an ELF executable named by the first of ARGS into the
+   current thread, with all of ARGS on its stack.
    Stores the executable's entry point into *EIP
    and its initial stack pointer into *ESP.
    Returns true if successful, false otherwise. */
 bool
-load (const char *file_name, void (**eip) (void), void **esp) 
+load (const struct exec_args *args, void (**eip) (void), void **esp) 
 {
-  
+  const char *file_name = args->words;
   struct thread *t = thread_current ();
-  struct Elf32_Ehdr ehdr;
+  struct exec_image image;
+  struct inode *inode;
   struct file *file = NULL;
-  off_t file_ofs;
   bool success = false; 
   int i = 0;
 
@@ -386,14 +1651,26 @@ load (const char *file_name, void (**eip) (void), void **esp)
   t->pagedir = pagedir_create ();
   if (t->pagedir == NULL) 
     goto done;
+#ifdef VM
+  if (!page_table_init ())
+    {
+      pagedir_destroy (t->pagedir);
+      t->pagedir = NULL;
+      goto done;
+    }
+#endif
   process_activate ();
 
-  char *save_ptr;
-  file_name = strtok_r (file_name, " ", &save_ptr);
-
-
-  /* Open executable file. */
-  file = filesys_open (file_name);
+  /* Open executable file, after checking from its inode that it
+     is not a directory. */
+  inode = filesys_lookup (file_name);
+  if (inode != NULL && inode_is_dir (inode))
+    {
+      inode_close (inode);
+      printf ("load: %s: is a directory\n", file_name);
+      goto done;
+    }
+  file = inode != NULL ? file_open (inode) : NULL;
   if (file == NULL) 
     {
       printf ("load: %s: open failed\n", file_name);
@@ -403,10 +1680,63 @@ load (const char *file_name, void (**eip) (void), void **esp)
   /* To prevent write operations of file's underlying inode
      until file_allow_write() is called or file is closed. */
   file_deny_write(file);
-  t->executable = file;
+  t->proc->executable = file;
+
+
+  /* Find the loadable segments, from the cache if this version
+     of the file has been loaded before. */
+  if (!exec_cache_lookup (file, &image))
+    {
+      if (!read_image (file, file_name, &image))
+        goto done;
+      exec_cache_insert (file, &image);
+    }
+
+  for (i = 0; i < image.seg_cnt; i++)
+    {
+      struct exec_segment *seg = &image.segs[i];
+      uint8_t *end = ((uint8_t *) seg->mem_page + seg->read_bytes
+                      + seg->zero_bytes);
+
+      if (!load_segment (file, seg->file_page, (void *) seg->mem_page,
+                         seg->read_bytes, seg->zero_bytes, seg->writable))
+        goto done;
+      if (end > t->proc->heap_base)
+        t->proc->heap_base = end;
+    }
+  t->proc->brk = t->proc->heap_base;
+
+  /* Set up stack. */
+  if (!setup_stack (esp, args))
+    goto done;
+
+  /* Start address. */
+  *eip = image.entry;
+
+  success = true;
+
+ done:
+  /* We arrive here whether the load is successful or not. */
+  //file_close (file);
+  return success;
+}
+
+/* load() helpers. */
 
+/* Reads FILE's ELF header and program headers into IMAGE,
+   checking them as it goes.  Returns true if FILE is a valid
+   executable, false otherwise.  FILE_NAME is for error
+   messages. */
+static bool
+read_image (struct file *file, const char *file_name,
+            struct exec_image *image)
+{
+  struct Elf32_Ehdr ehdr;
+  off_t file_ofs;
+  int i;
 
   /* Read and verify executable header. */
+  file_seek (file, 0);
   if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
       || memcmp (ehdr.e_ident, "\177ELF\1\1\1", 7)
       || ehdr.e_type != 2
@@ -416,21 +1746,25 @@ load (const char *file_name, void (**eip) (void), void **esp)
       || ehdr.e_phnum > 1024) 
     {
       printf ("load: %s: error loading executable\n", file_name);
-      goto done; 
+      return false;
     }
+  image->entry = (void (*) (void)) ehdr.e_entry;
+  image->seg_cnt = 0;
 
   /* Read program headers. */
   file_ofs = ehdr.e_phoff;
   for (i = 0; i < ehdr.e_phnum; i++) 
     {
       struct Elf32_Phdr phdr;
+      struct exec_segment *seg;
+      uint32_t page_offset;
 
       if (file_ofs < 0 || file_ofs > file_length (file))
-        goto done;
+        return false;
       file_seek (file, file_ofs);
 
       if (file_read (file, &phdr, sizeof phdr) != sizeof phdr)
-        goto done;
+        return false;
       file_ofs += sizeof phdr;
       switch (phdr.p_type) 
         {
@@ -444,58 +1778,141 @@ load (const char *file_name, void (**eip) (void), void **esp)
         case PT_DYNAMIC:
         case PT_INTERP:
         case PT_SHLIB:
-          goto done;
+          return false;
         case PT_LOAD:
-          if (validate_segment (&phdr, file)) 
+          if (!validate_segment (&phdr, file)
+              || image->seg_cnt >= EXEC_SEGMENTS_MAX)
+            return false;
+          seg = &image->segs[image->seg_cnt++];
+          seg->writable = (phdr.p_flags & PF_W) != 0;
+          seg->file_page = phdr.p_offset & ~PGMASK;
+          seg->mem_page = phdr.p_vaddr & ~PGMASK;
+          page_offset = phdr.p_vaddr & PGMASK;
+          if (phdr.p_filesz > 0)
+            {
+              /* Normal segment.
+                 Read initial part from disk and zero the rest. */
+              seg->read_bytes = page_offset + phdr.p_filesz;
+              seg->zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz,
+                                           PGSIZE)
+                                 - seg->read_bytes);
+            }
+          else 
             {
-              bool writable = (phdr.p_flags & PF_W) != 0;
-              uint32_t file_page = phdr.p_offset & ~PGMASK;
-              uint32_t mem_page = phdr.p_vaddr & ~PGMASK;
-              uint32_t page_offset = phdr.p_vaddr & PGMASK;
-              uint32_t read_bytes, zero_bytes;
-              if (phdr.p_filesz > 0)
-                {
-                  /* Normal segment.
-                     Read initial part from disk and zero the rest. */
-                  read_bytes = page_offset + phdr.p_filesz;
-                  zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz, PGSIZE)
-                                - read_bytes);
-                }
-              else 
-                {
-                  /* Entirely zero.
-                     Don't read anything from disk. */
-                  read_bytes = 0;
-                  zero_bytes = ROUND_UP (page_offset + phdr.p_memsz, PGSIZE);
-                }
-              if (!load_segment (file, file_page, (void *) mem_page,
-                                 read_bytes, zero_bytes, writable))
-                goto done;
+              /* Entirely zero.
+                 Don't read anything from disk. */
+              seg->read_bytes = 0;
+              seg->zero_bytes = ROUND_UP (page_offset + phdr.p_memsz,
+                                          PGSIZE);
             }
-          else
-            goto done;
           break;
         }
     }
+  return true;
+}
 
-  /* Set up stack. */
-  if (!setup_stack (esp, file_name, save_ptr))
-    goto done;
-
-  /* Start address. */
-  *eip = (void (*) (void)) ehdr.e_entry;
+/* Looks for the current version of FILE in the executable image
+   cache.  If it is there, copies its image into IMAGE and
+   returns true; otherwise returns false. */
+static bool
+exec_cache_lookup (struct file *file, struct exec_image *image)
+{
+  struct inode *inode = file_get_inode (file);
+  block_sector_t inumber = inode_get_inumber (inode);
+  unsigned version = inode_get_version (inode);
+  bool found = false;
+  size_t i;
+
+  lock_acquire (&exec_cache_lock);
+  exec_load_cnt++;
+  for (i = 0; i < EXEC_CACHE_SIZE; i++)
+    {
+      struct exec_cache_entry *e = &exec_cache[i];
+      if (e->in_use && e->inumber == inumber && e->version == version)
+        {
+          *image = e->image;
+          e->last_used = exec_load_cnt;
+          exec_hit_cnt++;
+          found = true;
+          break;
+        }
+    }
+  lock_release (&exec_cache_lock);
+  return found;
+}
 
-  success = true;
+/* Adds IMAGE, just read from FILE, to the executable image
+   cache, replacing any stale image of the same inode or else the
+   least recently used entry. */
+static void
+exec_cache_insert (struct file *file, const struct exec_image *image)
+{
+  struct inode *inode = file_get_inode (file);
+  block_sector_t inumber = inode_get_inumber (inode);
+  struct exec_cache_entry *victim = NULL;
+  size_t i;
 
- done:
-  /* We arrive here whether the load is successful or not. */
-  //file_close (file);
-  return success;
+  lock_acquire (&exec_cache_lock);
+  for (i = 0; i < EXEC_CACHE_SIZE; i++)
+    {
+      struct exec_cache_entry *e = &exec_cache[i];
+      if (!e->in_use || e->inumber == inumber)
+        {
+          victim = e;
+          break;
+        }
+      if (victim == NULL || e->last_used < victim->last_used)
+        victim = e;
+    }
+  victim->in_use = true;
+  victim->inumber = inumber;
+  victim->version = inode_get_version (inode);
+  victim->last_used = exec_load_cnt;
+  victim->image = *image;
+  lock_release (&exec_cache_lock);
 }
-
-/* load() helpers. */
 
-static bool install_page (void *upage, void *kpage, bool writable);
+/* Puts the headers of FILE, named FILE_NAME, in the executable
+   image cache and, with VM, reads its read-only pages into the
+   shared frames that running it would map, so that the first
+   exec of it waits for neither.  Stops at the first page for
+   which no frame is free.  Does nothing if FILE is not an
+   executable.  For the "-preload" option. */
+void
+process_preload (struct file *file, const char *file_name)
+{
+  struct exec_image image;
+  char magic[4];
+#ifdef VM
+  struct inode *inode = file_get_inode (file);
+  int i;
+#endif
+
+  if (file_read_at (file, magic, sizeof magic, 0) != sizeof magic
+      || memcmp (magic, "\177ELF", sizeof magic)
+      || !read_image (file, file_name, &image))
+    return;
+  exec_cache_insert (file, &image);
+
+#ifdef VM
+  for (i = 0; i < image.seg_cnt; i++)
+    {
+      const struct exec_segment *seg = &image.segs[i];
+      uint32_t ofs;
+
+      if (seg->writable)
+        continue;
+      for (ofs = 0; ofs < seg->read_bytes; ofs += PGSIZE)
+        {
+          size_t bytes = seg->read_bytes - ofs;
+          if (bytes > PGSIZE)
+            bytes = PGSIZE;
+          if (!frame_share_preload (inode, seg->file_page + ofs, bytes))
+            return;
+        }
+    }
+#endif
+}
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -554,6 +1971,9 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
 
+   With VM, the pages are only recorded in the supplemental page
+   table, and read in by page_fault() when first touched.
+
    Return true if successful, false if a memory allocation error
    or disk read error occurs. */
 static bool
@@ -573,6 +1993,14 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
+#ifdef VM
+      if (page_read_bytes > 0
+          ? !page_add_file (upage, file, ofs, page_read_bytes, writable,
+                           false)
+          : !page_add_zero (upage, writable))
+        return false;
+      ofs += page_read_bytes;
+#else
       /* Get a page of memory. */
       uint8_t *kpage = palloc_get_page (PAL_USER);
       if (kpage == NULL)
@@ -592,6 +2020,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
           palloc_free_page (kpage);
           return false; 
         }
+#endif
 
       /* Advance. */
       read_bytes -= page_read_bytes;
@@ -602,31 +2031,56 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 }
 
 /* Create a minimal stack by mapping a zeroed page at the top of
-   user virtual memory. */
+   user virtual memory, with the words of ARGS copied to its top
+   in one piece and argv[] and argc below them. */
 static bool
-setup_stack (void **esp, const char *file_name, char *save_ptr){
-  
+setup_stack (void **esp, const struct exec_args *args)
+{
+  uint8_t *words = (uint8_t *) PHYS_BASE - args->size;
+  char **argv;
+  char *word;
+  int i;
+
+#ifdef VM
+  uint8_t *upage = ((uint8_t *) PHYS_BASE) - PGSIZE;
+  if (!page_add_zero (upage, true) || !page_in (upage, true))
+    return false;
+#else
   uint8_t *kpage;
-  bool success = false;
 
   kpage = palloc_get_page (PAL_USER | PAL_ZERO);
-  if (kpage != NULL) 
+  if (kpage == NULL)
+    return false;
+  if (!install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true))
     {
-      success = install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true);
-      if (success) {
-        *esp = PHYS_BASE;
-	  }
-	  else {
-        palloc_free_page (kpage);
-	    return success;
-	  }
+      palloc_free_page (kpage);
+      return false;
     }
+#endif
 
-  set_args_onto_stack(esp, file_name, save_ptr);
-
-  return success;
+  /* The words as they are, then argv[] pointing into them. */
+  memcpy (words, args->words, args->size);
+  argv = (char **) ROUND_DOWN ((uintptr_t) words, sizeof (char *));
+  argv -= args->argc + 1;
+  for (i = 0, word = (char *) words; i < args->argc; i++)
+    {
+      argv[i] = word;
+      word += strlen (word) + 1;
+    }
+  argv[args->argc] = NULL;
+
+  /* main (argc, argv), called from a null return address. */
+  *esp = argv;
+  *esp -= sizeof (char **);
+  *(char ***) *esp = argv;
+  *esp -= sizeof (int);
+  *(int *) *esp = args->argc;
+  *esp -= sizeof (void *);
+  *(void **) *esp = NULL;
+  return true;
 }
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -646,3 +2100,4 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
+#endif
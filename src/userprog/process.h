@@ -1,6 +1,9 @@
 #ifndef USERPROG_PROCESS_H
 #define USERPROG_PROCESS_H
 
+#include <proc-limits.h>
+#include <proc-stats.h>
+#include <stdint.h>
 #include "threads/thread.h"
 
 struct file_elem
@@ -9,11 +12,94 @@ struct file_elem
   bool isdir;				// is directory
   struct file *file;			// pointer to file
   struct dir *dir; 			// pointer to dir
-  struct list_elem thread_elem;		// list element for thread's 'files' list
+  struct pipe *pipe;			// pipe, if this is one of its ends
+  bool writer;				// is the write end of the pipe
+  bool direct;				// bypass the buffer cache when aligned
+  int ref_cnt;				// fd table's reference, plus callers'
 };
 
+/* A wait by one of the running process's threads that
+   process_begin_exit() must cut short, by calling WAKE (AUX).
+   The waiter must check the leader's EXITING each time it wakes,
+   and must not hold any lock that WAKE acquires while it adds or
+   removes the entry. */
+struct exit_wait
+  {
+    struct list_elem elem;      /* Element in process's exit_waits. */
+    void (*wake) (void *aux);   /* Wakes the waiter. */
+    void *aux;                  /* Passed to WAKE. */
+  };
+
+/* What a user process keeps that its threads share and that the
+   scheduler never needs, allocated apart from the leader's
+   struct thread and reached through its PROC member.  A kernel
+   thread has one only once it starts a child.  Owned by
+   userprog/process.c, except as noted. */
+struct process
+  {
+    /* Needed for parent process */
+    struct hash *children;	/* Children's status records, by tid */
+    struct semaphore child_exited; /* Upped as each child exits */
+
+    /* Needed for child process */
+    struct child_status *status_rec; /* Our record in the parent */
+    int exit_status;		/* Exit status returned when it exits */
+
+    struct file *executable;	/* To deny other process to executables */
+    uint8_t *heap_base;		/* Start of the heap, just past the data */
+    uint8_t *brk;		/* End of the heap, moved by sbrk() */
+
+    /* For file system calls, owned by userprog/syscall.c */
+    struct lock fd_lock;     /* guards the three below and ref_cnts */
+    struct file_elem **fds;  /* open files, indexed by fd */
+    int fd_cnt;              /* number of slots in fds */
+    int fd_free;             /* no free slot below this fd */
+
+    struct syscall_stats *syscall_stats; /* per-call counts, -sctrace */
+    struct io_ring *io_ring; /* registered by ring_setup(), user address */
+    struct aio_context *aio; /* asynchronous file I/O, or NULL */
+    struct proc_stats stats; /* resources used, see thread's ACCT */
+    struct proc_limits limits; /* caps on them, see thread's LIMITS */
+
+    /* Waits that exiting must cut short */
+    struct lock exit_lock;	/* Guards exit_waits */
+    struct list exit_waits;	/* struct exit_waits in progress */
+  };
+
+struct file;
+struct intr_frame;
+struct spawn_action;
+
+void process_init (void);
+void process_print_stats (void);
+void process_preload (struct file *, const char *file_name);
 tid_t process_execute (const char *file_name);
+tid_t process_spawn (const char *cmd_line, const struct spawn_action *,
+                     int action_cnt, const char *cwd);
+#ifdef VM
+/* Longest name of a snapshot, in characters. */
+#define SNAPSHOT_NAME_MAX 14
+
+tid_t process_fork (struct intr_frame *);
+int process_snapshot (const char *name, struct intr_frame *);
+tid_t process_exec_snapshot (const char *name);
+bool process_drop_snapshot (const char *name);
+#endif
 int process_wait (tid_t);
+int process_wait_stats (tid_t, struct proc_stats *);
+tid_t process_wait_any (int *status);
 void process_exit (void);
 void process_activate (void);
+
+bool process_begin_exit (int status);
+bool process_watch_exit (struct exit_wait *, void (*wake) (void *),
+                         void *aux);
+void process_unwatch_exit (struct exit_wait *);
+tid_t process_thread_create (void *entry, void *func, void *aux);
+int process_thread_join (tid_t);
+void process_thread_exit (int status) NO_RETURN;
+void *process_sbrk (intptr_t increment);
+bool process_set_limit (int resource, unsigned limit);
+unsigned process_get_limit (int resource);
+void process_io_throttle (void);
 #endif /* userprog/process.h */
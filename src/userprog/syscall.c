@@ -1,11 +1,28 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
+#include <aio.h>
+#include <inttypes.h>
+#include <io-ring.h>
+#include <intr-stats.h>
+#include <io-stats.h>
+#include <stat.h>
+#include <iovec.h>
+#include <limits.h>
+#include <proc-stats.h>
+#include <spawn.h>
+#include <string.h>
 #include <syscall-nr.h>
+#include <syscall-stats.h>
+#include <vdata.h>
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 
 #include "threads/vaddr.h"
+#include "threads/kmem.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/directory.h"
@@ -13,17 +30,39 @@
 #include "threads/synch.h"
 #include "devices/input.h"
 #include "devices/block.h"
+#include "devices/timer.h"
+#include "userprog/aio.h"
+#include "userprog/exception.h"
+#include "userprog/futex.h"
+#include "userprog/pipe.h"
+#include "userprog/pagedir.h"
 #include "userprog/process.h"
+#include "userprog/tss.h"
+#include "userprog/uaccess.h"
+#ifdef VM
+#include <vm-stats.h>
+#include "vm/frame.h"
+#include "vm/mmap.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#endif
 
 static void syscall_handler (struct intr_frame *);
 
+/* Cache of struct file_elem objects. */
+static struct kmem_cache file_elem_cache;
+
 typedef int pid_t;
 
 // Process System Calls 
 void halt (void) NO_RETURN;
 void exit (int status) NO_RETURN;
 pid_t exec (const char *file);
+pid_t spawn (const char *cmd_line, const struct spawn_action *actions,
+             int action_cnt, const char *cwd);
 int wait (pid_t);
+int wait_stats (pid_t, struct proc_stats *);
+pid_t wait_any (int *status);
 
 // File System Calls
 bool create (const char *file, unsigned initial_size);
@@ -35,441 +74,2225 @@ int write (int fd, const void *buffer, unsigned length);
 void seek (int fd, unsigned position);
 unsigned tell (int fd);
 void close (int fd);
-
-void check_valid_address(void *address);  
+int pread (int fd, void *buffer, unsigned length, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+bool fsync (int fd);
+void sync (void);
+void threadstats (struct thread_stats *);
+void memstats (struct mem_stats *);
+#ifdef VM
+mapid_t mmap (int fd, void *addr);
+void munmap (mapid_t mapping);
+void vmstats (struct vm_stats *);
+mapid_t shm_map (const char *name, unsigned size, void *addr);
+#endif
+bool scstats (int nr, bool global, struct syscall_stats *);
+bool ring_setup (struct io_ring *);
+static int ring_enter (struct intr_frame *);
+int copy_file_range (int fd_in, int fd_out, unsigned length);
+bool pipe (int *fds);
+bool aio_read (const struct aiocb *);
+bool aio_write (const struct aiocb *);
+int aio_reap (struct io_cqe *, int cnt, bool wait);
+static bool aio_start (const struct aiocb *, bool write);
+bool set_direct (int fd, bool on);
+bool fallocate (int fd, unsigned offset, unsigned length);
+static int direct_io (struct file_elem *, void *buffer, unsigned length,
+                      off_t offset, bool write);
+bool intrstats (int idx, bool off, struct intr_stats *);
+void iostats (struct io_stats *);
+static bool copy_in_iov (struct iovec *, const struct iovec *, int iovcnt);
+static bool pin_iov (const struct iovec *, int iovcnt, bool write);
+static void unpin_iov (const struct iovec *, int iovcnt);
+
+void check_valid_buffer(const void *buffer, unsigned length, bool write);
+void release_buffer(const void *buffer, unsigned length);
+static char *copy_in_string(const char *ustr);
+#ifndef VM
+static void touch_user_byte(const uint8_t *p, bool write);
+#endif
 struct file_elem * find_file_elem(int fd);
-int alloc_fd(void);
+void put_file_elem(struct file_elem *fe);
+static void unref_file_elem(struct file_elem *fe);
+static bool fd_open(int fd);
+static int pipe_io(struct file_elem *fe, void *buffer, size_t length);
+static size_t stdin_read(uint8_t *buf, size_t n);
+int alloc_fd(struct file_elem *fe);
+static bool grow_fds(struct process *p, int cnt);
+static struct file_elem *dup_file_elem(const struct file_elem *pfe);
+static void close_file_elem(struct file_elem *fe);
+static void console_write(const char *buffer, unsigned length);
+static void console_flush(void);
 
 bool chdir(const char *);
 bool mkdir(const char *);
 bool readdir(int, const char *);
+int getdents(int, struct dirent *, int);
+bool stat(const char *, struct stat *);
 bool isdir(int);
-bool inumber(int);
+int inumber(int);
+
+/* a system call handler: gets the call's arguments, copied from
+   the user stack, and the interrupt frame; returns the value for
+   the user's eax */
+typedef int syscall_func (const int *args, struct intr_frame *f);
+
+static syscall_func sys_halt, sys_exit, sys_exec, sys_wait;
+static syscall_func sys_create, sys_remove, sys_open, sys_filesize;
+static syscall_func sys_read, sys_write, sys_seek, sys_tell, sys_close;
+static syscall_func sys_chdir, sys_mkdir, sys_readdir, sys_isdir;
+static syscall_func sys_inumber, sys_pread, sys_pwrite, sys_readv;
+static syscall_func sys_writev, sys_fsync, sys_sync, sys_threadstats;
+static syscall_func sys_memstats, sys_scstats, sys_ring_setup;
+static syscall_func sys_ring_enter, sys_copy_file_range, sys_intrstats;
+static syscall_func sys_clock_ns, sys_set_canonical, sys_iostats;
+static syscall_func sys_set_affinity, sys_get_affinity;
+static syscall_func sys_futex_wait, sys_futex_wake;
+static syscall_func sys_uthread_create, sys_uthread_join, sys_uthread_exit;
+static syscall_func sys_pipe, sys_sbrk, sys_getdents, sys_stat;
+static syscall_func sys_aio_read, sys_aio_write, sys_aio_reap;
+static syscall_func sys_set_direct, sys_fallocate, sys_set_edf;
+static syscall_func sys_wait_stats, sys_msleep;
+static syscall_func sys_set_limit, sys_get_limit, sys_spawn, sys_wait_any;
+#ifdef VM
+static syscall_func sys_mmap, sys_munmap, sys_fork, sys_vmstats;
+static syscall_func sys_shm_map;
+static syscall_func sys_snapshot, sys_exec_snapshot, sys_snapshot_drop;
+#endif
+
+/* most arguments any system call takes */
+#define SYSCALL_MAX_ARGS 4
+
+/* a registered system call */
+struct syscall
+{
+  syscall_func *func;		// handler
+  int argc;			// number of arguments it takes
+  const char *name;		// name for statistics
+  bool ring;			// may be queued on an io_ring
+  struct syscall_stats stats;	// calls since boot, by all processes
+};
+
+/* registers sys_NAME() as system call NR, taking ARGC arguments */
+#define SYSCALL(NR, NAME, ARGC) \
+  [NR] = {.func = sys_##NAME, .argc = ARGC, .name = #NAME}
+
+/* the same, for a call that may also be queued on an io_ring */
+#define RING_SYSCALL(NR, NAME, ARGC) \
+  [NR] = {.func = sys_##NAME, .argc = ARGC, .name = #NAME, .ring = true}
+
+/* system calls, by number.  a new system call needs one line here */
+static struct syscall syscalls[] =
+{
+  SYSCALL (SYS_HALT, halt, 0),
+  SYSCALL (SYS_EXIT, exit, 1),
+  SYSCALL (SYS_EXEC, exec, 1),
+  SYSCALL (SYS_WAIT, wait, 1),
+  SYSCALL (SYS_CREATE, create, 2),
+  SYSCALL (SYS_REMOVE, remove, 1),
+  SYSCALL (SYS_OPEN, open, 1),
+  RING_SYSCALL (SYS_FILESIZE, filesize, 1),
+  RING_SYSCALL (SYS_READ, read, 3),
+  RING_SYSCALL (SYS_WRITE, write, 3),
+  RING_SYSCALL (SYS_SEEK, seek, 2),
+  RING_SYSCALL (SYS_TELL, tell, 1),
+  SYSCALL (SYS_CLOSE, close, 1),
+#ifdef VM
+  SYSCALL (SYS_MMAP, mmap, 2),
+  SYSCALL (SYS_MUNMAP, munmap, 1),
+#endif
+  SYSCALL (SYS_CHDIR, chdir, 1),
+  SYSCALL (SYS_MKDIR, mkdir, 1),
+  SYSCALL (SYS_READDIR, readdir, 2),
+  SYSCALL (SYS_ISDIR, isdir, 1),
+  SYSCALL (SYS_INUMBER, inumber, 1),
+  RING_SYSCALL (SYS_PREAD, pread, 4),
+  RING_SYSCALL (SYS_PWRITE, pwrite, 4),
+  SYSCALL (SYS_READV, readv, 3),
+  SYSCALL (SYS_WRITEV, writev, 3),
+  RING_SYSCALL (SYS_FSYNC, fsync, 1),
+  SYSCALL (SYS_SYNC, sync, 0),
+  SYSCALL (SYS_THREADSTATS, threadstats, 1),
+  SYSCALL (SYS_MEMSTATS, memstats, 1),
+#ifdef VM
+  SYSCALL (SYS_FORK, fork, 0),
+  SYSCALL (SYS_VMSTATS, vmstats, 1),
+#endif
+  SYSCALL (SYS_SCSTATS, scstats, 3),
+  SYSCALL (SYS_RING_SETUP, ring_setup, 1),
+  SYSCALL (SYS_RING_ENTER, ring_enter, 0),
+  RING_SYSCALL (SYS_COPY_FILE_RANGE, copy_file_range, 3),
+  SYSCALL (SYS_INTRSTATS, intrstats, 3),
+  SYSCALL (SYS_CLOCK_NS, clock_ns, 1),
+  SYSCALL (SYS_SET_CANONICAL, set_canonical, 1),
+  SYSCALL (SYS_IOSTATS, iostats, 1),
+  SYSCALL (SYS_SET_AFFINITY, set_affinity, 1),
+  SYSCALL (SYS_GET_AFFINITY, get_affinity, 0),
+  SYSCALL (SYS_FUTEX_WAIT, futex_wait, 2),
+  SYSCALL (SYS_FUTEX_WAKE, futex_wake, 2),
+  SYSCALL (SYS_UTHREAD_CREATE, uthread_create, 3),
+  SYSCALL (SYS_UTHREAD_JOIN, uthread_join, 1),
+  SYSCALL (SYS_UTHREAD_EXIT, uthread_exit, 1),
+  SYSCALL (SYS_PIPE, pipe, 1),
+  SYSCALL (SYS_SBRK, sbrk, 1),
+  SYSCALL (SYS_GETDENTS, getdents, 3),
+  SYSCALL (SYS_STAT, stat, 2),
+  SYSCALL (SYS_AIO_READ, aio_read, 1),
+  SYSCALL (SYS_AIO_WRITE, aio_write, 1),
+  SYSCALL (SYS_AIO_REAP, aio_reap, 3),
+  SYSCALL (SYS_SET_DIRECT, set_direct, 2),
+  SYSCALL (SYS_FALLOCATE, fallocate, 3),
+  SYSCALL (SYS_SET_EDF, set_edf, 3),
+  SYSCALL (SYS_WAIT_STATS, wait_stats, 2),
+  SYSCALL (SYS_MSLEEP, msleep, 1),
+  SYSCALL (SYS_SET_LIMIT, set_limit, 2),
+  SYSCALL (SYS_GET_LIMIT, get_limit, 1),
+  SYSCALL (SYS_SPAWN, spawn, 4),
+  SYSCALL (SYS_WAIT_ANY, wait_any, 1),
+#ifdef VM
+  SYSCALL (SYS_SHM_MAP, shm_map, 3),
+  SYSCALL (SYS_SNAPSHOT, snapshot, 1),
+  SYSCALL (SYS_EXEC_SNAPSHOT, exec_snapshot, 1),
+  SYSCALL (SYS_SNAPSHOT_DROP, snapshot_drop, 1),
+#endif
+};
+
+#define SYSCALL_CNT (sizeof syscalls / sizeof *syscalls)
+
+bool syscall_trace;
+bool syscall_sysenter = true;
+bool sysenter_tf;
+
+static struct syscall_stats *process_stats (unsigned nsyscall);
+static void record_call (struct syscall_stats *, uint64_t cycles);
+static int dispatch (unsigned nsyscall, const int *args,
+                     struct intr_frame *);
+static void print_call (const char *prefix, const char *name,
+                        const struct syscall_stats *);
+static int count_io (int bytes, bool write);
 
 void
 syscall_init (void) 
 {
-  intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
-  lock_init(&filesys_lock);
+  intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
+  if (syscall_sysenter && cpu_has (CPUID_SEP))
+    {
+      struct vdata *v = timer_vdata ();
+
+      ASSERT ((uintptr_t) &((struct vdata *) VDATA_ADDR)->sysenter
+              == VDATA_SYSENTER_ADDR);
+      tss_sysenter_init (sysenter_entry);
+      v->sysenter = 1;
+    }
+  kmem_cache_init (&file_elem_cache, "file_elem", sizeof (struct file_elem),
+                   NULL);
+}
+
+
+/* copy the user string USTR into a new page, which the caller
+   must free with palloc_free_page(); call exit(-1) if USTR is not
+   valid user memory.  returns NULL if no page is available */
+static char *copy_in_string(const char *ustr)
+{
+  char *kstr = palloc_get_page(0);
+  if(!kstr) return NULL;
+  if(strncpy_from_user(kstr, ustr, PGSIZE) < 0)
+  {
+    palloc_free_page(kstr);
+    exit(-1);
+  }
+  return kstr;
+}
+
+/* under VM, bring in and pin every page of the LENGTH bytes at
+   BUFFER (writable ones if WRITE) so that no page fault happens
+   while the file system holds its locks; if that fails, call
+   exit(-1).  release_buffer() must be called afterwards */
+void check_valid_buffer(const void *buffer, unsigned length, bool write)
+{
+#ifdef VM
+  if(!page_pin(buffer, length, write)) exit(-1);
+#else
+  // touch one byte of every page, not just the first byte
+  const uint8_t *p = buffer;
+  if(length == 0) return;
+  touch_user_byte(p + length - 1, write);
+  for(; p < (const uint8_t *)buffer + length; p = pg_round_down(p) + PGSIZE)
+    touch_user_byte(p, write);
+#endif
+}
+
+#ifndef VM
+// call exit(-1) unless the user byte at P can be read, and written
+// too if WRITE.  writing the byte back unchanged shows up a read-only
+// page here, instead of as a kernel fault in the file system later
+static void touch_user_byte(const uint8_t *p, bool write)
+{
+  uint8_t byte;
+
+  if(!copy_from_user(&byte, p, 1)
+     || (write && !copy_to_user((uint8_t *)p, &byte, 1))) exit(-1);
+}
+#endif
+
+/* undo check_valid_buffer() */
+void release_buffer(const void *buffer, unsigned length)
+{
+#ifdef VM
+  page_unpin(buffer, length);
+#else
+  (void) buffer;
+  (void) length;
+#endif
+}
+
+
+/* the system call handler stub: copies the system call number
+   and then the whole argument block off the user stack at once,
+   and calls the handler registered for the number in SYSCALLS */
+static void
+syscall_handler (struct intr_frame *f) 
+{
+  unsigned nsyscall;
+  int args[SYSCALL_MAX_ARGS];
+  struct syscall *sc;
+
+#ifdef VM
+  // page faults in the kernel need the user esp to grow the stack
+  thread_current ()->user_esp = f->esp;
+#endif
+
+  if(!copy_from_user(&nsyscall, f->esp, sizeof nsyscall)) exit(-1);
+  if(nsyscall >= SYSCALL_CNT || !syscalls[nsyscall].func) exit(-1);
+  sc = &syscalls[nsyscall];
+  if(!copy_from_user(args, (int *)f->esp + 1, sc->argc * sizeof *args))
+    exit(-1);
+
+  // buffered console output must come out before anything else
+  // the process does can be seen
+  if(nsyscall != SYS_WRITE && nsyscall != SYS_WRITEV) console_flush();
+  TRACE_EVENT(SYSCALL, nsyscall, sc->argc ? args[0] : 0);
+  f->eax = dispatch(nsyscall, args, f);
+  TRACE_EVENT(SYSCALL_DONE, nsyscall, f->eax);
+
+  // pay for disk use past the I/O rate limit, holding no locks
+  process_io_throttle();
+}
+
+/* make system call NSYSCALL with ARGS, keeping its statistics,
+   and return its result */
+static int
+dispatch (unsigned nsyscall, const int *args, struct intr_frame *f)
+{
+  struct syscall *sc = &syscalls[nsyscall];
+  struct syscall_stats *ps;
+  uint64_t start = timer_cycles(), cycles;
+  int ret;
+
+  // halt and exit never come back, so count the call first
+  sc->stats.cnt++;
+  if(thread_current ()->acct) thread_current ()->acct->syscall_cnt++;
+  ps = process_stats(nsyscall);
+  if(ps) ps->cnt++;
+  ret = sc->func(args, f);
+
+  cycles = timer_cycles() - start;
+  record_call(&sc->stats, cycles);
+  if(ps) record_call(ps, cycles);
+  return ret;
+}
+
+/* the running process's statistics for system call NSYSCALL, or
+   NULL if tracing is off or they could not be allocated */
+static struct syscall_stats *
+process_stats (unsigned nsyscall)
+{
+  struct process *p = thread_process()->proc;
+
+  if(!syscall_trace) return NULL;
+  if(!p->syscall_stats)
+    p->syscall_stats = calloc(SYSCALL_CNT, sizeof *p->syscall_stats);
+  return p->syscall_stats ? &p->syscall_stats[nsyscall] : NULL;
+}
+
+/* add a call that took CYCLES to STATS, whose count the handler
+   bumped before making it */
+static void
+record_call (struct syscall_stats *stats, uint64_t cycles)
+{
+  int bucket = 0;
+
+  while(bucket < SYSCALL_LATENCY_BUCKETS - 1
+        && cycles >= (uint64_t)1 << (bucket + 10))
+    bucket++;
+  stats->cycles += cycles;
+  stats->latency[bucket]++;
+}
+
+/* print one line of STATS for system call NAME */
+static void
+print_call (const char *prefix, const char *name,
+            const struct syscall_stats *stats)
+{
+  int i, last;
+
+  for(last = SYSCALL_LATENCY_BUCKETS - 1; last > 0; last--)
+    if(stats->latency[last]) break;
+  printf ("%s %s: %"PRIu64" calls, %"PRIu64" cycles each, latency",
+          prefix, name, stats->cnt, stats->cycles / stats->cnt);
+  for(i = 0; i <= last; i++)
+    printf (" %u", stats->latency[i]);
+  printf ("\n");
+}
+
+/* with -sctrace, print the exiting process's resource use and
+   system calls; frees its statistics either way */
+void
+syscall_trace_exit (void)
+{
+  struct thread *t = thread_process();
+  struct process *p = t->proc;
+  size_t i;
+
+  if(syscall_trace)
+    printf ("%s: %"PRIu64" calls, %"PRIu64" faults, "
+            "read %"PRIu64" bytes, wrote %"PRIu64" bytes, "
+            "%"PRIu64" sectors in, %"PRIu64" out, "
+            "%"PRIu32" pages resident at most, %"PRId64" ticks\n",
+            t->name, p->stats.syscall_cnt, p->stats.fault_cnt,
+            p->stats.read_bytes, p->stats.write_bytes,
+            p->stats.read_sectors, p->stats.write_sectors,
+            p->stats.max_resident, p->stats.run_ticks);
+  if(!p->syscall_stats) return;
+  for(i = 0; i < SYSCALL_CNT; i++)
+    if(p->syscall_stats[i].cnt)
+      print_call(t->name, syscalls[i].name, &p->syscall_stats[i]);
+  free(p->syscall_stats);
+  p->syscall_stats = NULL;
+}
+
+/* add BYTES, the result of a read or write system call, to the
+   running process's usage unless it is an error; returns BYTES */
+static int
+count_io (int bytes, bool write)
+{
+  struct proc_stats *acct = thread_current ()->acct;
+
+  if(acct && bytes > 0)
+  {
+    if(write) acct->write_bytes += bytes;
+    else acct->read_bytes += bytes;
+  }
+  return bytes;
+}
+
+/* print how often each system call was made and how long it took */
+void
+syscall_print_stats (void)
+{
+  size_t i;
+
+  for(i = 0; i < SYSCALL_CNT; i++)
+  {
+    struct syscall *sc = &syscalls[i];
+    if(sc->stats.cnt) print_call("Syscall", sc->name, &sc->stats);
+  }
+}
+
+/**** System call handlers, registered in SYSCALLS ****/
+
+static int sys_halt (const int *args UNUSED, struct intr_frame *f UNUSED)
+{
+  halt();
+}
+
+static int sys_exit (const int *args, struct intr_frame *f UNUSED)
+{
+  exit(args[0]);
+}
+
+static int sys_exec (const int *args, struct intr_frame *f UNUSED)
+{
+  return exec((const char *)args[0]);
+}
+
+static int sys_spawn (const int *args, struct intr_frame *f UNUSED)
+{
+  return spawn((const char *)args[0], (const struct spawn_action *)args[1],
+               args[2], (const char *)args[3]);
+}
+
+static int sys_wait (const int *args, struct intr_frame *f UNUSED)
+{
+  return wait(args[0]);
+}
+
+static int sys_wait_any (const int *args, struct intr_frame *f UNUSED)
+{
+  return wait_any((int *)args[0]);
+}
+
+static int sys_create (const int *args, struct intr_frame *f UNUSED)
+{
+  return create((const char *)args[0], args[1]);
+}
+
+static int sys_remove (const int *args, struct intr_frame *f UNUSED)
+{
+  return remove((const char *)args[0]);
+}
+
+static int sys_open (const int *args, struct intr_frame *f UNUSED)
+{
+  return open((const char *)args[0]);
+}
+
+static int sys_filesize (const int *args, struct intr_frame *f UNUSED)
+{
+  return filesize(args[0]);
+}
+
+static int sys_read (const int *args, struct intr_frame *f UNUSED)
+{
+  int ret;
+  check_valid_buffer((void *)args[1], args[2], true);
+  ret = read(args[0], (void *)args[1], args[2]);
+  release_buffer((void *)args[1], args[2]);
+  return count_io(ret, false);
+}
+
+static int sys_write (const int *args, struct intr_frame *f UNUSED)
+{
+  int ret;
+  check_valid_buffer((void *)args[1], args[2], false);
+  ret = write(args[0], (const void *)args[1], args[2]);
+  release_buffer((void *)args[1], args[2]);
+  return count_io(ret, true);
+}
+
+static int sys_seek (const int *args, struct intr_frame *f UNUSED)
+{
+  seek(args[0], args[1]);
+  return 0;
+}
+
+static int sys_tell (const int *args, struct intr_frame *f UNUSED)
+{
+  return tell(args[0]);
+}
+
+static int sys_close (const int *args, struct intr_frame *f UNUSED)
+{
+  close(args[0]);
+  return 0;
+}
+
+static int sys_chdir (const int *args, struct intr_frame *f UNUSED)
+{
+  return chdir((const char *)args[0]);
+}
+
+static int sys_mkdir (const int *args, struct intr_frame *f UNUSED)
+{
+  return mkdir((const char *)args[0]);
+}
+
+static int sys_readdir (const int *args, struct intr_frame *f UNUSED)
+{
+  return readdir(args[0], (const char *)args[1]);
+}
+
+static int sys_isdir (const int *args, struct intr_frame *f UNUSED)
+{
+  return isdir(args[0]);
+}
+
+static int sys_inumber (const int *args, struct intr_frame *f UNUSED)
+{
+  return inumber(args[0]);
+}
+
+static int sys_pread (const int *args, struct intr_frame *f UNUSED)
+{
+  int ret;
+  check_valid_buffer((void *)args[1], args[2], true);
+  ret = pread(args[0], (void *)args[1], args[2], args[3]);
+  release_buffer((void *)args[1], args[2]);
+  return count_io(ret, false);
+}
+
+static int sys_pwrite (const int *args, struct intr_frame *f UNUSED)
+{
+  int ret;
+  check_valid_buffer((void *)args[1], args[2], false);
+  ret = pwrite(args[0], (const void *)args[1], args[2], args[3]);
+  release_buffer((void *)args[1], args[2]);
+  return count_io(ret, true);
+}
+
+static int sys_readv (const int *args, struct intr_frame *f UNUSED)
+{
+  return count_io(readv(args[0], (const struct iovec *)args[1], args[2]),
+                  false);
+}
+
+static int sys_writev (const int *args, struct intr_frame *f UNUSED)
+{
+  return count_io(writev(args[0], (const struct iovec *)args[1], args[2]),
+                  true);
+}
+
+static int sys_fsync (const int *args, struct intr_frame *f UNUSED)
+{
+  return fsync(args[0]);
+}
+
+static int sys_sync (const int *args UNUSED, struct intr_frame *f UNUSED)
+{
+  sync();
+  return 0;
+}
+
+static int sys_threadstats (const int *args, struct intr_frame *f UNUSED)
+{
+  threadstats((struct thread_stats *)args[0]);
+  return 0;
+}
+
+static int sys_memstats (const int *args, struct intr_frame *f UNUSED)
+{
+  memstats((struct mem_stats *)args[0]);
+  return 0;
+}
+
+static int sys_scstats (const int *args, struct intr_frame *f UNUSED)
+{
+  return scstats(args[0], args[1], (struct syscall_stats *)args[2]);
+}
+
+static int sys_ring_setup (const int *args, struct intr_frame *f UNUSED)
+{
+  return ring_setup((struct io_ring *)args[0]);
+}
+
+static int sys_ring_enter (const int *args UNUSED, struct intr_frame *f)
+{
+  return ring_enter(f);
+}
+
+static int sys_copy_file_range (const int *args, struct intr_frame *f UNUSED)
+{
+  int ret = copy_file_range(args[0], args[1], args[2]);
+  count_io(ret, false);
+  return count_io(ret, true);
+}
+
+static int sys_pipe (const int *args, struct intr_frame *f UNUSED)
+{
+  return pipe((int *)args[0]);
+}
+
+static int sys_sbrk (const int *args, struct intr_frame *f UNUSED)
+{
+  return (int)process_sbrk(args[0]);
+}
+
+static int sys_getdents (const int *args, struct intr_frame *f UNUSED)
+{
+  return getdents(args[0], (struct dirent *)args[1], args[2]);
+}
+
+static int sys_stat (const int *args, struct intr_frame *f UNUSED)
+{
+  return stat((const char *)args[0], (struct stat *)args[1]);
+}
+
+static int sys_aio_read (const int *args, struct intr_frame *f UNUSED)
+{
+  return aio_read((const struct aiocb *)args[0]);
+}
+
+static int sys_aio_write (const int *args, struct intr_frame *f UNUSED)
+{
+  return aio_write((const struct aiocb *)args[0]);
+}
+
+static int sys_aio_reap (const int *args, struct intr_frame *f UNUSED)
+{
+  return aio_reap((struct io_cqe *)args[0], args[1], args[2]);
+}
+
+static int sys_set_direct (const int *args, struct intr_frame *f UNUSED)
+{
+  return set_direct(args[0], args[1]);
+}
+
+static int sys_fallocate (const int *args, struct intr_frame *f UNUSED)
+{
+  return fallocate(args[0], args[1], args[2]);
+}
+
+static int sys_intrstats (const int *args, struct intr_frame *f UNUSED)
+{
+  return intrstats(args[0], args[1], (struct intr_stats *)args[2]);
+}
+
+static int sys_clock_ns (const int *args, struct intr_frame *f UNUSED)
+{
+  uint64_t ns = clock_ns();
+
+  if(!copy_to_user((uint64_t *)args[0], &ns, sizeof ns)) exit(-1);
+  return 0;
+}
+
+static int sys_set_canonical (const int *args, struct intr_frame *f UNUSED)
+{
+  return input_set_canonical(args[0] != 0);
+}
+
+static int sys_iostats (const int *args, struct intr_frame *f UNUSED)
+{
+  iostats((struct io_stats *)args[0]);
+  return 0;
+}
+
+// bit N of the mask allows CPU N; children inherit it
+static int sys_set_affinity (const int *args, struct intr_frame *f UNUSED)
+{
+  return thread_set_affinity((uint32_t)args[0]);
+}
+
+static int sys_get_affinity (const int *args UNUSED,
+                             struct intr_frame *f UNUSED)
+{
+  return thread_get_affinity();
+}
+
+// runtime, period and deadline are in timer ticks; runtime 0 leaves
+// the EDF class
+static int sys_set_edf (const int *args, struct intr_frame *f UNUSED)
+{
+  return thread_set_edf((unsigned)args[0], (unsigned)args[1],
+                        (unsigned)args[2]);
+}
+
+static int sys_wait_stats (const int *args, struct intr_frame *f UNUSED)
+{
+  return wait_stats(args[0], (struct proc_stats *)args[1]);
+}
+
+// sleeps at least that long, to the next timer tick
+static int sys_msleep (const int *args, struct intr_frame *f UNUSED)
+{
+  timer_msleep((unsigned)args[0]);
+  return 0;
+}
+
+// resource is an enum proc_limit; a limit can only be tightened
+static int sys_set_limit (const int *args, struct intr_frame *f UNUSED)
+{
+  return process_set_limit(args[0], (unsigned)args[1]);
+}
+
+static int sys_get_limit (const int *args, struct intr_frame *f UNUSED)
+{
+  return process_get_limit(args[0]);
+}
+
+// 0 once woken, -1 if the word no longer held the value
+static int sys_futex_wait (const int *args, struct intr_frame *f UNUSED)
+{
+  int result = futex_wait((const int *)args[0], args[1]);
+
+  if(result == -2) exit(-1);
+  return result;
+}
+
+static int sys_futex_wake (const int *args, struct intr_frame *f UNUSED)
+{
+  return futex_wake((const int *)args[0], args[1]);
+}
+
+static int sys_uthread_create (const int *args, struct intr_frame *f UNUSED)
+{
+  return process_thread_create((void *)args[0], (void *)args[1],
+                               (void *)args[2]);
+}
+
+static int sys_uthread_join (const int *args, struct intr_frame *f UNUSED)
+{
+  return process_thread_join(args[0]);
+}
+
+static int sys_uthread_exit (const int *args, struct intr_frame *f UNUSED)
+{
+  // the main thread can't end without ending the process
+  if(thread_process() == thread_current()) exit(args[0]);
+  process_thread_exit(args[0]);
+}
+
+#ifdef VM
+static int sys_mmap (const int *args, struct intr_frame *f UNUSED)
+{
+  return mmap(args[0], (void *)args[1]);
+}
+
+static int sys_munmap (const int *args, struct intr_frame *f UNUSED)
+{
+  munmap(args[0]);
+  return 0;
+}
+
+static int sys_shm_map (const int *args, struct intr_frame *f UNUSED)
+{
+  return shm_map((const char *)args[0], args[1], (void *)args[2]);
+}
+
+static int sys_fork (const int *args UNUSED, struct intr_frame *f)
+{
+  return process_fork(f);
+}
+
+// returns 0 to the caller and 1 to each process started from the
+// snapshot, which resumes here
+static int sys_snapshot (const int *args, struct intr_frame *f)
+{
+  char *kname = copy_in_string((const char *)args[0]);
+  int result;
+
+  if(!kname) return -1;
+  result = process_snapshot(kname, f);
+  palloc_free_page(kname);
+  return result;
+}
+
+static int sys_exec_snapshot (const int *args, struct intr_frame *f UNUSED)
+{
+  char *kname = copy_in_string((const char *)args[0]);
+  tid_t tid;
+
+  if(!kname) return TID_ERROR;
+  tid = process_exec_snapshot(kname);
+  palloc_free_page(kname);
+  return tid;
+}
+
+static int sys_snapshot_drop (const int *args, struct intr_frame *f UNUSED)
+{
+  char *kname = copy_in_string((const char *)args[0]);
+  bool dropped;
+
+  if(!kname) return false;
+  dropped = process_drop_snapshot(kname);
+  palloc_free_page(kname);
+  return dropped;
+}
+
+static int sys_vmstats (const int *args, struct intr_frame *f UNUSED)
+{
+  vmstats((struct vm_stats *)args[0]);
+  return 0;
+}
+#endif
+
+/**** Process System Calls ****/
+
+void halt (void)
+{
+  //printf("userprog/syscall.c	halt\n");  
+  shutdown_power_off();
+}
+
+void exit (int status)
+{
+  //printf("userprog/syscall.c	exit\n");  
+  struct thread *t = thread_process();
+  console_flush();
+  // the first thread to exit speaks for the whole process
+  if(process_begin_exit(status))
+    printf ("%s: exit(%d)\n",t->name,status);
+  thread_exit ();
+}
+
+pid_t exec (const char *file)
+{
+  //printf("userprog/syscall.c	exec\n");  
+  pid_t pid;
+  char *kfile = copy_in_string(file);
+  if(!kfile) return -1;
+  pid = process_execute (kfile);
+  palloc_free_page(kfile);
+  return pid;
+}
+
+/* spawn system call.  starts CMD_LINE like exec(), but the child
+   first gets the caller's file descriptors with the ACTION_CNT
+   ACTIONS applied to them (see <spawn.h>), then changes to
+   directory CWD unless it is null, all before its program is
+   loaded.  returns the child's pid, or -1 if any of it fails */
+pid_t spawn (const char *cmd_line, const struct spawn_action *actions,
+             int action_cnt, const char *cwd)
+{
+  struct spawn_action kactions[SPAWN_ACTIONS_MAX];
+  char *kcmd, *kcwd = NULL;
+  pid_t pid;
+
+  if(action_cnt < 0 || action_cnt > SPAWN_ACTIONS_MAX) return -1;
+  if(action_cnt > 0
+     && !copy_from_user(kactions, actions, action_cnt * sizeof *kactions))
+    exit(-1);
+
+  kcmd = copy_in_string(cmd_line);
+  if(!kcmd) return -1;
+  if(cwd)
+  {
+    kcwd = copy_in_string(cwd);
+    if(!kcwd) { palloc_free_page(kcmd); return -1; }
+  }
+  pid = process_spawn(kcmd, kactions, action_cnt, kcwd);
+  if(kcwd) palloc_free_page(kcwd);
+  palloc_free_page(kcmd);
+  return pid;
+}
+
+int wait (pid_t pid)
+{
+  //printf("userprog/syscall.c	wait\n");  
+  return process_wait (pid);
+}
+
+/* wait for child PID like wait(), and copy the resources it used
+   to STATS, all zeros if PID is not a child to wait for */
+int wait_stats (pid_t pid, struct proc_stats *stats)
+{
+  struct proc_stats s;
+  int status = process_wait_stats (pid, &s);
+
+  if(!copy_to_user(stats, &s, sizeof s)) exit(-1);
+  return status;
+}
+
+/* wait for whichever child exits first, or take one that has
+   already, and store its exit status to STATUS unless it is
+   null.  returns the child's pid, or -1 if there are no children
+   left to wait for */
+pid_t wait_any (int *status)
+{
+  int s;
+  pid_t pid = process_wait_any (&s);
+
+  if(pid != -1 && status && !copy_to_user(status, &s, sizeof s)) exit(-1);
+  return pid;
+}
+
+
+
+/**** File System Calls ****/
+
+/* write system call,
+   returns the number of bytes which are actually written */
+int write (int fd, const void *buffer, unsigned length)
+{
+  int written = 0;
+  // 0 and 1 are the console unless spawn() put a file there
+  if(fd == 0 && !fd_open(0)) exit(-1);// write to input (error)
+  else if(fd == 1 && !fd_open(1))  // write to console
+  {
+    console_write(buffer, length);
+    written = length;
+  } else  // write to a file
+  {
+    struct file_elem *fe = find_file_elem(fd);
+    if(fe==NULL) exit(-1);
+    else if(fe->pipe)
+      written = fe->writer ? pipe_io(fe, (void *)buffer, length) : -1;
+    else
+    {
+      struct file *f = fe->file;
+      written = direct_io(fe, (void *)buffer, length, -1, true);
+      if(written < 0) written = file_write(f, buffer, length);
+    }
+    put_file_elem(fe);
+  }
+
+  return written;
+}
+
+
+/* find a file_elem by fd, and take a reference to it, so that
+   another thread's close() cannot free it while this one uses it.
+   the caller must give it back with put_file_elem().  a thread
+   that exits first gives it back in syscall_release_files() */
+struct file_elem * find_file_elem(int fd)
+{
+  struct thread *t = thread_current();
+  struct process *p = thread_process()->proc;
+  struct file_elem *fe = NULL;
+
+  lock_acquire(&p->fd_lock);
+  if(fd >= 0 && fd < p->fd_cnt && p->fds[fd])
+  {
+    fe = p->fds[fd];
+    fe->ref_cnt++;
+  }
+  lock_release(&p->fd_lock);
+
+  if(fe)
+  {
+    // copy_file_range() holds two at once; no call holds more
+    int i = t->held_files[0] != NULL;
+    ASSERT(t->held_files[i] == NULL);
+    t->held_files[i] = fe;
+  }
+  return fe;
+}
+
+/* give back the reference to FE that find_file_elem() took */
+void put_file_elem(struct file_elem *fe)
+{
+  struct thread *t = thread_current();
+
+  if(t->held_files[0] == fe) t->held_files[0] = t->held_files[1];
+  else ASSERT(t->held_files[1] == fe);
+  t->held_files[1] = NULL;
+  unref_file_elem(fe);
+}
+
+/* drop a reference to FE, closing it if that was the last */
+static void unref_file_elem(struct file_elem *fe)
+{
+  struct process *p = thread_process()->proc;
+  bool last;
+
+  lock_acquire(&p->fd_lock);
+  last = --fe->ref_cnt == 0;
+  lock_release(&p->fd_lock);
+  if(last) close_file_elem(fe);
+}
+
+/* true if FD is open, for telling a file that spawn() put at 0
+   or 1 from the console */
+static bool fd_open(int fd)
+{
+  struct file_elem *fe = find_file_elem(fd);
+
+  if(fe) put_file_elem(fe);
+  return fe != NULL;
+}
+
+/* give back the references to file_elems the running thread took
+   in a system call it never returned from.  called as it exits */
+void syscall_release_files (void)
+{
+  struct thread *t = thread_current();
+
+  while(t->held_files[0]) put_file_elem(t->held_files[0]);
+}
+
+/* for process_watch_exit(): wake the thread blocked on pipe P_ */
+static void wake_pipe(void *p_)
+{
+  pipe_interrupt(p_);
+}
+
+/* for process_watch_exit(): wake the thread blocked on stdin */
+static void wake_stdin(void *aux UNUSED)
+{
+  input_interrupt();
+}
+
+/* pipe_write() or pipe_read() on FE's pipe, as FE is its write or
+   read end, giving up with -1 once another thread calls exit() */
+static int pipe_io(struct file_elem *fe, void *buffer, size_t length)
+{
+  const volatile bool *stop = &thread_process()->exiting;
+  struct exit_wait w;
+  int ret;
+
+  if(!process_watch_exit(&w, wake_pipe, fe->pipe)) return -1;
+  if(fe->writer) ret = pipe_write(fe->pipe, buffer, length, stop);
+  else ret = pipe_read(fe->pipe, buffer, length, stop);
+  process_unwatch_exit(&w);
+  return ret;
+}
+
+/* input_read() from the console, giving up with 0 once another
+   thread calls exit() */
+static size_t stdin_read(uint8_t *buf, size_t n)
+{
+  struct exit_wait w;
+  size_t got;
+
+  if(!process_watch_exit(&w, wake_stdin, NULL)) return 0;
+  got = input_read(buf, n, &thread_process()->exiting);
+  process_unwatch_exit(&w);
+  return got;
+}
+
+
+/* create system call, if succeeds, returns true */
+bool create (const char *file, unsigned initial_size)
+{
+  bool ret;
+  char *kfile;
+  if(!file) exit(-1);
+  kfile = copy_in_string(file);
+  if(!kfile) return false;
+  ret = filesys_create(kfile, initial_size, false);
+  palloc_free_page(kfile);
+  return ret;
+}
+
+
+/* remove system call, if succeeds, returns true */
+bool remove (const char *file)
+{
+  bool ret;
+  char *kfile;
+  if(!file) exit(-1);
+  kfile = copy_in_string(file);
+  if(!kfile) return false;
+  ret = filesys_remove(kfile);
+  palloc_free_page(kfile);
+  return ret;
+}
+
+
+/* open system call
+  if succeeds returns its file descriptor. if not, returns -1 */
+int open (const char *file)
+{
+  //printf("hi!\n");
+  struct inode *inode;
+  struct file_elem *fe;
+  char *kfile;
+
+  if(!file) return -1; // input name is null
+  kfile = copy_in_string(file);
+  if(!kfile) return -1;
+  if(strlen(kfile) == 0) inode = NULL; // input name is empty
+  else inode = filesys_lookup(kfile);
+  palloc_free_page(kfile);
+
+  if(!inode) return -1;
+
+  fe = (struct file_elem *)kmem_cache_alloc(&file_elem_cache);
+
+  if(!fe) // fail to allocate memory
+  {
+    inode_close(inode);
+    return -1; 
+  }
+
+  fe->pipe = NULL;
+  fe->direct = false;
+  // decide from the inode, before opening, whether it is a directory
+  fe->isdir = inode_is_dir(inode);
+  if(fe->isdir) fe->dir = dir_open(inode);
+  else fe->file = file_open(inode);
+  if(fe->isdir ? fe->dir == NULL : fe->file == NULL) // open closed inode
+  {
+    kmem_cache_free(&file_elem_cache, fe);
+    return -1;
+  }
+
+  if(alloc_fd(fe) < 0) // no room in the fd table, or over the limit
+  {
+    close_file_elem(fe);
+    return -1;
+  }
+  return fe->fd;
+}
+
+
+/* put FE in the lowest free slot of the running thread's fd
+   table, growing the table if it is full, and set FE->fd.
+   returns the fd, or -1 if memory is not available or the
+   process has as many files open as LIMIT_FILES allows */
+int alloc_fd(struct file_elem *fe)
+{
+  struct process *p = thread_process()->proc;
+  unsigned limit = p->limits.max[LIMIT_FILES];
+  int fd;
+
+  lock_acquire(&p->fd_lock);
+  // 0 and 1 are the console
+  if(p->fd_free < 2) p->fd_free = 2;
+  for(fd = p->fd_free; fd < p->fd_cnt; fd++)
+    if(!p->fds[fd]) break;
+
+  // slots are filled lowest first, so this many are all in use
+  if((limit && (unsigned)fd >= 2 + limit) || !grow_fds(p, fd + 1))
+    fd = -1;
+  else
+  {
+    p->fds[fd] = fe;
+    p->fd_free = fd + 1;
+    fe->fd = fd;
+    fe->ref_cnt = 1;
+  }
+  lock_release(&p->fd_lock);
+  return fd;
+}
+
+/* make P's fd table at least CNT slots long, doubling it as
+   often as needed.  returns false if memory is not available.
+   P's fd_lock must be held */
+static bool grow_fds(struct process *p, int cnt)
+{
+  int new_cnt = p->fd_cnt ? p->fd_cnt : 16;
+  struct file_elem **fds;
+
+  if(cnt <= p->fd_cnt) return true;
+  while(new_cnt < cnt) new_cnt *= 2;
+  fds = realloc(p->fds, new_cnt * sizeof *fds);
+  if(!fds) return false;
+  memset(fds + p->fd_cnt, 0, (new_cnt - p->fd_cnt) * sizeof *fds);
+  p->fds = fds;
+  p->fd_cnt = new_cnt;
+  return true;
+}
+
+/* close the file, directory or pipe end in FE and free FE */
+static void close_file_elem(struct file_elem *fe)
+{
+  if(fe->pipe) pipe_close(fe->pipe, fe->writer);
+  else if(fe->isdir) dir_close(fe->dir);
+  else file_close(fe->file);
+  kmem_cache_free(&file_elem_cache, fe);
+}
+
+/* returns file size */
+int filesize (int fd)
+{
+  struct file_elem *fe = find_file_elem(fd);
+  int ret;
+
+  if(!fe) exit(-1);
+  ret = fe->pipe ? -1 : file_length(fe->file);
+  put_file_elem(fe);
+  return ret;
+}
+
+
+/* returns the number of bytes actually read 
+   returns -1 if it could not be read */
+int read (int fd, void *buffer, unsigned length)
+{
+  int ret = 0;
+  struct file_elem *fe;
+
+  if(!is_user_vaddr(buffer)||(!is_user_vaddr(buffer+length))) return -1; // buffer is not in user virtual address
+  
+  if(fd == 0 && !fd_open(0))  //stdin
+  {
+    ret = stdin_read((uint8_t *)buffer, length);
+  } else if(fd == 1 && !fd_open(1)) return -1; // stdout
+  else
+  {
+    fe = find_file_elem(fd);
+    if(!fe) return -1;
+    if(fe->pipe)
+      ret = fe->writer ? -1 : pipe_io(fe, buffer, length);
+    else
+    {
+      ret = direct_io(fe, buffer, length, -1, false);
+      if(ret < 0) ret = file_read(fe->file, buffer, length);
+    }
+    put_file_elem(fe);
+  }
+
+  return ret;
+}
+
+/* seek system call */
+void seek (int fd, unsigned position)
+{
+  struct file_elem *fe = find_file_elem(fd);
+  if(!fe) exit(-1); // if the file could not be found, call exit(-1)
+  if(!fe->pipe) file_seek(fe->file, position); // a pipe has no position
+  put_file_elem(fe);
+}
+
+
+/* tell system call */
+unsigned tell (int fd)
+{ 
+  unsigned ret;
+  struct file_elem *fe = find_file_elem(fd);
+  if(!fe) exit(-1); // if the file could not be found, call exit(-1)
+  ret = fe->pipe ? 0 : file_tell(fe->file); // a pipe has no position
+  put_file_elem(fe);
+
+  return ret;
+}
+
+
+/* close system call.  the file is closed once no other thread's
+   system call is still using it */
+void close (int fd)
+{
+  struct process *p = thread_process()->proc;
+  struct file_elem *fe = NULL;
+
+  lock_acquire(&p->fd_lock);
+  if(fd >= 0 && fd < p->fd_cnt && p->fds[fd])
+  {
+    fe = p->fds[fd];
+    // free the slot for the next open()
+    p->fds[fd] = NULL;
+    if(fd < p->fd_free) p->fd_free = fd;
+  }
+  lock_release(&p->fd_lock);
+  if(!fe) exit(-1); // if the file could not be found, call exit(-1)
+
+  unref_file_elem(fe);
+}
+
+/* pread system call.  Reads like read(), but starting at byte
+   OFFSET of the file, and leaves the file position alone.
+   Returns the number of bytes read, or -1 if FD is not an open
+   file or the bytes would run past the largest file offset. */
+int pread (int fd, void *buffer, unsigned length, unsigned offset)
+{
+  struct file_elem *fe;
+  int ret;
+
+  if(!is_user_vaddr(buffer)||(!is_user_vaddr(buffer+length))) return -1; // buffer is not in user virtual address
+  if(offset > INT_MAX || length > INT_MAX - offset) return -1; // past off_t
+
+  fe = find_file_elem(fd);
+  if(!fe) return -1;
+  if(fe->isdir || fe->pipe) ret = -1;
+  else
+  {
+    ret = direct_io(fe, buffer, length, offset, false);
+    if(ret < 0) ret = file_read_at(fe->file, buffer, length, offset);
+  }
+  put_file_elem(fe);
+  return ret;
+}
+
+/* set_direct system call.  Turns direct I/O on or off for FD.
+   While it is on, reads and writes whose buffer, length and file
+   offset are all multiples of the sector size move straight
+   between the user's buffer and the disk, without passing through
+   or filling the buffer cache.  Others go through the cache as
+   usual.  Returns false if FD is not an open file */
+bool set_direct (int fd, bool on)
+{
+  struct file_elem *fe = find_file_elem(fd);
+  bool ok;
+
+  if(!fe) return false;
+  ok = !fe->isdir && !fe->pipe;
+  if(ok) fe->direct = on;
+  put_file_elem(fe);
+  return ok;
+}
+
+/* fallocate system call.  Reserves disk space for the LENGTH bytes
+   of FD starting at OFFSET, extending the file if they go past its
+   end, so that writes there later need no allocation.  The space
+   comes in runs of consecutive sectors as long as the disk allows,
+   and is not written until data goes into it; it reads as zeros.
+   Returns false if FD is not an open file, writing it is denied,
+   or the disk fills up */
+bool fallocate (int fd, unsigned offset, unsigned length)
+{
+  struct file_elem *fe;
+  bool ok;
+
+  if(offset > INT_MAX || length > INT_MAX - offset) return false;
+  fe = find_file_elem(fd);
+  if(!fe) return false;
+  ok = !fe->isdir && !fe->pipe && file_allocate(fe->file, offset, length);
+  put_file_elem(fe);
+  return ok;
+}
+
+/* most user pages direct_io() hands the file system at once */
+#define DIRECT_PAGES 16
+
+// for a descriptor in direct mode, moves LENGTH bytes between the user's
+// BUFFER, which the caller has pinned, and FE's file at OFFSET, or at
+// and past its position if OFFSET is -1, straight to or from the disk.
+// the file system is given the kernel's mapping of each user page, so
+// nothing is copied on the way.  returns the number of bytes moved, or
+// -1 if FE is not in direct mode or the request is not sector-aligned,
+// for the caller to go through the buffer cache instead
+static int direct_io (struct file_elem *fe, void *buffer, unsigned length,
+                      off_t offset, bool write)
+{
+  struct iovec iov[DIRECT_PAGES];
+  uint32_t *pd = thread_current()->pagedir;
+  off_t pos = offset >= 0 ? offset : file_tell(fe->file);
+  uint8_t *p = buffer, *end = p + length;
+  int done = 0;
+
+  if(!fe->direct || fe->isdir || fe->pipe) return -1;
+  if((uintptr_t)buffer % BLOCK_SECTOR_SIZE || length % BLOCK_SECTOR_SIZE
+     || pos % BLOCK_SECTOR_SIZE) return -1;
+
+  while(p < end)
+  {
+    off_t size = 0, n;
+    int cnt;
+
+    for(cnt = 0; cnt < DIRECT_PAGES && p < end; cnt++)
+    {
+      uint8_t *next = pg_round_down(p) + PGSIZE;
+      uint8_t *kpage = pagedir_get_page(pd, pg_round_down(p));
+
+      if(next > end) next = end;
+      if(!kpage) exit(-1);
+      iov[cnt].iov_base = kpage + pg_ofs(p);
+      iov[cnt].iov_len = next - p;
+      size += next - p;
+      p = next;
+    }
+    n = file_direct_at(fe->file, iov, cnt, pos, write);
+    pos += n;
+    done += n;
+    if(n < size) break;
+  }
+  if(offset < 0) file_seek(fe->file, pos);
+  return done;
 }
 
+/* aio_read system call.  Queues a read of the file and range in
+   the control block CB and returns at once; the data is copied
+   into CB's buffer when aio_reap() collects the result.  Returns
+   false if CB's descriptor is not an open file, its length is
+   over AIO_MAX_LENGTH, or the process has too many outstanding */
+bool aio_read (const struct aiocb *cb)
+{
+  return aio_start(cb, false);
+}
 
-/* check if address is null pointer or not in user address space
-   if so, call exit(-1) */
-void check_valid_address(void *address)  
+/* aio_write system call.  Like aio_read(), but copies the data
+   out of CB's buffer now and writes it to the file later */
+bool aio_write (const struct aiocb *cb)
 {
-  struct thread *t = thread_current();
-  if(!address || !is_user_vaddr(address) || pagedir_get_page (t->pagedir, address) == NULL) exit(-1);
-  return;
+  return aio_start(cb, true);
 }
 
+/* aio_reap system call.  Stores up to CNT results of finished
+   transfers in CQES, copying read data to where it belongs.  If
+   WAIT is true and none has finished but some are in flight,
+   waits for one.  Returns the number of results stored */
+int aio_reap (struct io_cqe *cqes, int cnt, bool wait)
+{
+  int i;
 
-static void
-syscall_handler (struct intr_frame *f UNUSED) 
-{
-  int nsyscall, ret;
-  int *esp = (int *)f->esp;
-
-  //check esp is valid>
-  check_valid_address(esp);
-  nsyscall = *esp;
-
-  switch(nsyscall)
-  {
-    case SYS_HALT:
-      halt();
-      break;
-    case SYS_EXIT:
-      check_valid_address((int *)(esp+1));
-      exit(*(int *)(esp+1));
-      break;
-    case SYS_EXEC:
-      check_valid_address((char *)*(esp+1));
-      ret = exec((char *)*(esp+1));
-      break;
-    case SYS_WAIT:
-      check_valid_address((pid_t *)(esp+1));
-      ret = wait(*(esp+1));
-      break;	
-
-    case SYS_CREATE:
-      check_valid_address((char *)*(esp+1));
-      check_valid_address((unsigned *)(esp+2));
-      ret = create((char *)*(esp+1), *(esp+2));
-      break;
-    case SYS_REMOVE:
-      check_valid_address((char *)*(esp+1));
-      ret = remove((char *)*(esp+1));
-      break;
-    case SYS_OPEN:
-      check_valid_address((char *)*(esp+1));
-      ret = open((char *)*(esp+1));
-      break;
-    case SYS_FILESIZE:
-      check_valid_address((int *)(esp+1));
-      ret = filesize(*(esp+1));
-      break;
-    case SYS_READ:
-      check_valid_address((int *)(esp+1));
-      check_valid_address((char *)*(esp+2));
-      check_valid_address((unsigned *)(esp+3));
-      ret = read(*(esp+1), (char *)*(esp+2), *(esp+3));
-      break;
-    case SYS_WRITE:
-      check_valid_address((int *)(esp+1));
-      check_valid_address((char *)*(esp+2));
-      check_valid_address((unsigned *)(esp+3));
-      ret = write(*(esp+1), (char *)*(esp+2), *(esp+3));
-      break;
-    case SYS_SEEK:
-      check_valid_address((int *)(esp+1));
-      check_valid_address((unsigned *)(esp+2));
-      seek(*(esp+1), *(esp+2));
-      break;
-    case SYS_TELL:
-      check_valid_address((int *)(esp+1));
-      ret = tell(*(esp+1));
-      break;
-    case SYS_CLOSE:
-      check_valid_address((int *)(esp+1));
-      close(*(esp+1));
-      break;
-    case SYS_CHDIR:
-      check_valid_address((char *)*(esp+1));
-      ret = chdir((char *)*(esp+1));
-      break;
-    case SYS_MKDIR:
-      check_valid_address((char *)*(esp+1));
-      ret = mkdir((char *)*(esp+1));
-      break;
-    case SYS_READDIR:
-      check_valid_address((int *)(esp+1));
-      check_valid_address((char *)*(esp+2));
-      ret = readdir((int *)(esp+1), (char *)*(esp+2));
-      break;
-    case SYS_ISDIR:
-      check_valid_address((int *)(esp+1));
-      ret = isdir((int *)(esp+1));
-      break;
-    case SYS_INUMBER:
-      check_valid_address((int *)(esp+1));
-      ret = inumber((int *)(esp+1));
-      break;
-    default:
-      exit(-1);
-      break;
-  }  
-  f->eax = ret;
+  for(i = 0; i < cnt; i++)
+  {
+    struct aio_request *r = aio_next_done(wait && i == 0);
+    struct io_cqe cqe;
+    bool ok;
+
+    if(!r) break;
+    cqe.tag = r->tag;
+    cqe.result = r->result;
+    ok = (r->write || r->result <= 0
+          || copy_to_user(r->buffer, r->data, r->result));
+    aio_request_free(r);
+    if(!ok || !copy_to_user(&cqes[i], &cqe, sizeof cqe)) exit(-1);
+  }
+  return i;
 }
 
-/**** Process System Calls ****/
+// the common part of aio_read() and aio_write()
+static bool aio_start (const struct aiocb *ucb, bool write)
+{
+  struct aiocb cb;
+  struct file_elem *fe;
+  struct aio_request *r;
+  bool ok;
 
-void halt (void)
+  if(!copy_from_user(&cb, ucb, sizeof cb)) exit(-1);
+  fe = find_file_elem(cb.fd);
+  if(!fe) return false;
+  ok = !fe->isdir && !fe->pipe;
+  put_file_elem(fe);
+  if(!ok) return false;
+  if(cb.length > AIO_MAX_LENGTH || cb.offset > INT_MAX) return false;
+  if(!is_user_vaddr(cb.buffer)
+     || !is_user_vaddr((uint8_t *)cb.buffer + cb.length)) return false;
+
+  r = aio_request_create();
+  if(!r) return false;
+  if(write && !copy_from_user(r->data, cb.buffer, cb.length))
+  {
+    aio_request_free(r);
+    exit(-1);
+  }
+  // a file of its own, so that closing FD doesn't pull it away.  FD
+  // is looked up again, since another thread may have closed it
+  fe = find_file_elem(cb.fd);
+  r->file = fe && !fe->isdir && !fe->pipe ? file_reopen(fe->file) : NULL;
+  if(fe) put_file_elem(fe);
+  r->write = write;
+  r->buffer = cb.buffer;
+  r->length = cb.length;
+  r->offset = cb.offset;
+  r->tag = cb.tag;
+  if(!r->file || !aio_submit(r))
+  {
+    aio_request_free(r);
+    return false;
+  }
+  return true;
+}
+
+/* pwrite system call.  Writes like write(), but starting at byte
+   OFFSET of the file, and leaves the file position alone.
+   Returns the number of bytes written, or -1 if FD is not an
+   open file or the bytes would run past the largest file
+   offset. */
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset)
 {
-  //printf("userprog/syscall.c	halt\n");  
-  shutdown_power_off();
+  struct file_elem *fe;
+  int ret;
+
+  if(!is_user_vaddr(buffer)||(!is_user_vaddr(buffer+length))) return -1; // buffer is not in user virtual address
+  if(offset > INT_MAX || length > INT_MAX - offset) return -1; // past off_t
+
+  fe = find_file_elem(fd);
+  if(!fe) return -1;
+  if(fe->isdir || fe->pipe) ret = -1;
+  else
+  {
+    ret = direct_io(fe, (void *)buffer, length, offset, true);
+    if(ret < 0) ret = file_write_at(fe->file, buffer, length, offset);
+  }
+  put_file_elem(fe);
+  return ret;
 }
 
-void exit (int status)
+/* Copies the IOVCNT buffer descriptors at user address UIOV into
+   IOV, which must have room for IOV_MAX of them.  Returns false
+   if IOVCNT is out of range, a descriptor or buffer is not in user
+   memory, or the buffers total more than fits in an int. */
+static bool
+copy_in_iov (struct iovec *iov, const struct iovec *uiov, int iovcnt)
 {
-  //printf("userprog/syscall.c	exit\n");  
-  struct thread *t = thread_current();
-  t->exit_status = status;
-  printf ("%s: exit(%d)\n",t->name,status);
-  thread_exit ();
+  size_t total = 0;
+  int i;
+
+  if(iovcnt < 0 || iovcnt > IOV_MAX) return false;
+  if(!copy_from_user(iov, uiov, iovcnt * sizeof *iov)) return false;
+
+  for(i=0; i<iovcnt; i++)
+  {
+    if(!is_user_vaddr(iov[i].iov_base)
+       ||(!is_user_vaddr(iov[i].iov_base+iov[i].iov_len))) return false;
+    if(iov[i].iov_len > INT_MAX - total) return false;
+    total += iov[i].iov_len;
+  }
+  return true;
 }
 
-pid_t exec (const char *file)
+/* under VM, pin the pages of the IOVCNT buffers at IOV (writable
+   ones if WRITE) like check_valid_buffer(); returns false, with
+   nothing pinned, if one is not mapped */
+static bool
+pin_iov (const struct iovec *iov, int iovcnt, bool write)
 {
-  //printf("userprog/syscall.c	exec\n");  
-  pid_t pid;
-  check_valid_address(file);
-  lock_acquire (&filesys_lock);  /* Do not allow file IO until process is loaded */
-  pid = process_execute (file);
-  lock_release (&filesys_lock);
-  return pid;
+#ifdef VM
+  int i;
+  for(i=0; i<iovcnt; i++)
+    if(!page_pin(iov[i].iov_base, iov[i].iov_len, write))
+    {
+      unpin_iov(iov, i);
+      return false;
+    }
+#else
+  (void) iov;
+  (void) iovcnt;
+  (void) write;
+#endif
+  return true;
 }
 
-int wait (pid_t pid)
+/* undo pin_iov(), or check_valid_buffer() on each of the buffers */
+static void
+unpin_iov (const struct iovec *iov, int iovcnt)
 {
-  //printf("userprog/syscall.c	wait\n");  
-  return process_wait (pid);
+#ifdef VM
+  int i;
+  for(i=0; i<iovcnt; i++)
+    page_unpin(iov[i].iov_base, iov[i].iov_len);
+#else
+  (void) iov;
+  (void) iovcnt;
+#endif
 }
 
+/* readv system call.  Reads like read(), but into the IOVCNT
+   buffers at IOV, filling each in turn.  Returns the number of
+   bytes read, or -1 on error. */
+int readv (int fd, const struct iovec *uiov, int iovcnt)
+{
+  struct iovec iov[IOV_MAX];
+  struct file_elem *fe;
+  int ret = 0;
+  int i;
 
+  if(!copy_in_iov(iov, uiov, iovcnt)) return -1;
 
-/**** File System Calls ****/
+  // every buffer must be writable before a lock is taken, as in read()
+  for(i=0; i<iovcnt; i++)
+    check_valid_buffer(iov[i].iov_base, iov[i].iov_len, true);
 
-/* write system call,
-   returns the number of bytes which are actually written */
-int write (int fd, const void *buffer, unsigned length)
-{
-  int written = 0;
-  if(fd == 0) exit(-1);// write to input (error)
-  else if(fd == 1)  // write to console
+  if(fd == 0 && !fd_open(0))  //stdin
   {
-    lock_acquire(&filesys_lock);
-    if(length < 512)
+    // stop where read() would: short of what was asked, or at the
+    // end of a line
+    for(i=0; i<iovcnt; i++)
     {
-      putbuf((char *)buffer, length);
-      written = length;
-    } else
-    {
-      while(length>512)
-      {
-        putbuf((char *)(buffer+written), 512);
-	length -= 512;
-	written += 512;
-      }
-      putbuf((char *)(buffer+written), length);
-      written += length;
+      uint8_t *buf = iov[i].iov_base;
+      size_t got = stdin_read(buf, iov[i].iov_len);
+      ret += got;
+      if(got < iov[i].iov_len || (got > 0 && buf[got - 1] == '\n')) break;
     }
-    lock_release(&filesys_lock);
-  } else  // write to a file
+  }
+  else if(fd == 1 && !fd_open(1)) ret = -1; // stdout
+  else
   {
-    struct file_elem *fe = find_file_elem(fd);
-    if(fe==NULL) exit(-1);
-    else
-    {
-      struct file *f = fe->file;
-      lock_acquire(&filesys_lock);
-      written = file_write(f, buffer, length);
-      lock_release(&filesys_lock);
-    }
+    fe = find_file_elem(fd);
+    if(!fe || fe->isdir || fe->pipe) ret = -1;
+    else ret = file_readv(fe->file, iov, iovcnt);
+    if(fe) put_file_elem(fe);
   }
 
-  return written;
+  unpin_iov(iov, iovcnt);
+  return ret;
 }
 
-
-/* find a file_elem by fd */
-struct file_elem * find_file_elem(int fd)
+/* writev system call.  Writes like write(), but from the IOVCNT
+   buffers at IOV, one after another.  Returns the number of bytes
+   written, or -1 on error. */
+int writev (int fd, const struct iovec *uiov, int iovcnt)
 {
-  struct list_elem *e;
-  struct thread *t = thread_current();
+  struct iovec iov[IOV_MAX];
+  struct file_elem *fe;
+  int ret = 0;
+  int i;
 
-  for(e = list_begin (&t->files); e != list_end (&t->files); e = list_next (e))
+  if(!copy_in_iov(iov, uiov, iovcnt)) return -1;
+
+  if(fd == 0 && !fd_open(0)) exit(-1);// write to input (error)
+  else if(fd == 1 && !fd_open(1))  // write to console
   {
-    struct file_elem *fe = list_entry (e, struct file_elem, thread_elem);
-    if (fe->fd == fd) return fe;
+    for(i=0; i<iovcnt; i++)
+      ret += write(fd, iov[i].iov_base, iov[i].iov_len);
+    return ret;
   }
-  return NULL;
-}
 
+  if(!pin_iov(iov, iovcnt, false)) return -1;
+  fe = find_file_elem(fd);
+  if(!fe || fe->isdir || fe->pipe) ret = -1;
+  else ret = file_writev(fe->file, iov, iovcnt);
+  if(fe) put_file_elem(fe);
+  unpin_iov(iov, iovcnt);
+  return ret;
+}
 
-/* create system call, if succeeds, returns true */
-bool create (const char *file, unsigned initial_size)
+/* fsync system call.  Writes the changes to the file or
+   directory open as FD to disk before returning.  Returns false
+   if FD is not open, or if FD's buffered writes could not all be
+   written. */
+bool fsync (int fd)
 {
-  bool ret;
-  if(!file) exit(-1);
+  struct file_elem *fe = find_file_elem(fd);
+  bool ok = true;
+
+  if(!fe) return false;
+  if(fe->pipe) ; // nothing on disk
+  else if(fe->isdir) filesys_fsync(dir_get_inode(fe->dir));
   else
   {
-    lock_acquire(&filesys_lock);
-    ret = filesys_create(file, initial_size, false);
-    lock_release(&filesys_lock);
+    ok = file_flush(fe->file);
+    if(ok) filesys_fsync(file_get_inode(fe->file));
   }
-  return ret;
+  put_file_elem(fe);
+  return ok;
 }
 
+/* sync system call.  Writes every change to the file system to
+   disk before returning. */
+void sync (void)
+{
+  filesys_sync();
+}
 
-/* remove system call, if succeeds, returns true */
-bool remove (const char *file)
+/* threadstats system call.  Copies the calling process's
+   scheduling statistics into STATS. */
+void threadstats (struct thread_stats *stats)
 {
-  bool ret;
-  if(!file) exit(-1);
-  else
+  struct thread_stats s;
+
+  thread_get_stats(&s);
+  if(!copy_to_user(stats, &s, sizeof s)) exit(-1);
+}
+
+/* memstats system call.  Copies the kernel's memory allocator
+   statistics into STATS. */
+void memstats (struct mem_stats *stats)
+{
+  struct mem_stats s;
+
+  malloc_get_stats(&s);
+  palloc_get_stats(&s);
+  if(!copy_to_user(stats, &s, sizeof s)) exit(-1);
+}
+
+#ifdef VM
+/* mmap system call.  Maps the file open as FD into memory at
+   ADDR, to be read in as it is touched.  Returns the mapping's
+   identifier, or -1 on error. */
+mapid_t mmap (int fd, void *addr)
+{
+  struct file_elem *fe;
+  mapid_t id;
+
+  if(fd == 0 || fd == 1) return MAP_FAILED;
+  fe = find_file_elem(fd);
+  if(!fe) return MAP_FAILED;
+  id = fe->isdir || fe->pipe ? MAP_FAILED : mmap_map(fe->file, addr);
+  put_file_elem(fe);
+  return id;
+}
+
+/* munmap system call.  Unmaps MAPPING, writing the pages that
+   were changed back to the file. */
+void munmap (mapid_t mapping)
+{
+  mmap_unmap(mapping);
+}
+
+/* shm_map system call.  Maps the shared memory segment NAME,
+   or a new anonymous one if NAME is null, at ADDR, creating it
+   with SIZE bytes if needed.  Unmapped by munmap() */
+mapid_t shm_map (const char *name, unsigned size, void *addr)
+{
+  char *kname = NULL;
+  mapid_t id;
+
+  if(name)
   {
-    lock_acquire(&filesys_lock);
-    ret = filesys_remove(file);
-    lock_release(&filesys_lock);
+    kname = copy_in_string(name);
+    if(!kname) return MAP_FAILED;
   }
-  return ret;
+  id = mmap_shm(kname, size, addr);
+  if(kname) palloc_free_page(kname);
+  return id;
 }
 
+/* vmstats system call.  Copies the virtual memory statistics,
+   including the calling process's resident set, into STATS. */
+void vmstats (struct vm_stats *stats)
+{
+  struct vm_stats s;
 
-/* open system call
-  if succeeds returns its file descriptor. if not, returns -1 */
-int open (const char *file)
+  exception_get_stats(&s);
+  page_get_stats(&s);
+  frame_get_stats(&s);
+  swap_get_stats(&s);
+  if(!copy_to_user(stats, &s, sizeof s)) exit(-1);
+}
+#endif
+
+/* copy the statistics for system call NR into STATS: those of
+   the whole system if GLOBAL, else the calling process's.
+   returns false if NR is not a system call, or for a process's
+   own statistics if the kernel was not started with -sctrace */
+bool scstats (int nr, bool global, struct syscall_stats *stats)
 {
-  //printf("hi!\n");
-  struct file *f;
-  struct file_elem *fe;
+  struct syscall_stats s;
+  struct process *p = thread_process()->proc;
+
+  if(nr < 0 || (unsigned)nr >= SYSCALL_CNT || !syscalls[nr].func)
+    return false;
+  if(global) s = syscalls[nr].stats;
+  else if(p->syscall_stats) s = p->syscall_stats[nr];
+  else return false;
+  if(!copy_to_user(stats, &s, sizeof s)) exit(-1);
+  return true;
+}
 
-  if(!file || strlen(file) == 0 ) return -1; // input name is null or empty
+/* copy the statistics for interrupt vector IDX into STATS, or if
+   OFF, those in slot IDX of the kernel's table of sites that
+   turned interrupts off.  returns false if IDX is out of range */
+bool intrstats (int idx, bool off, struct intr_stats *stats)
+{
+  struct intr_stats s;
 
-  lock_acquire(&filesys_lock);
-  f = filesys_open(file);
-  lock_release(&filesys_lock);
+  if(!intr_get_stats(idx, off, &s)) return false;
+  if(!copy_to_user(stats, &s, sizeof s)) exit(-1);
+  return true;
+}
 
-  if(!f) return -1;
+/* copy the sector counts of the file system device into STATS */
+void iostats (struct io_stats *stats)
+{
+  struct io_stats s;
 
-  fe = (struct file_elem *)malloc(sizeof(struct file_elem));
+  block_get_stats(fs_device, &s);
+  if(!copy_to_user(stats, &s, sizeof s)) exit(-1);
+}
 
-  if(!fe) // fail to allocate memory
-  {
-    file_close(f);
-    return -1; 
-  }
+/* bytes of console output kept for each thread */
+#define CONSOLE_BUF_SIZE 128
 
-  lock_acquire(&filesys_lock);
+/* add LENGTH bytes of BUFFER to the running thread's console
+   output, which goes out a line at a time, or when the buffer is
+   full.  writes too big for the buffer, or made when it can't be
+   allocated, go straight out */
+static void console_write(const char *buffer, unsigned length)
+{
+  struct thread *t = thread_current();
 
-  if(inode_is_dir(file_get_inode(f)))
+  if(!t->console_buf) t->console_buf = malloc(CONSOLE_BUF_SIZE);
+  if(!t->console_buf || length >= CONSOLE_BUF_SIZE)
   {
-    fe->dir = (struct dir *)f;
-    fe->isdir = true;
-    fe->fd = alloc_fd();
-    list_push_back(&thread_current()->files, &fe->thread_elem);
+    console_flush();
+    putbuf(buffer, length);
+    return;
   }
-  else
+
+  while(length > 0)
   {
-    fe->file = f;
-    fe->isdir = false;
-    fe->fd = alloc_fd();
-    list_push_back(&thread_current()->files, &fe->thread_elem);
+    unsigned n = CONSOLE_BUF_SIZE - t->console_len;
+    if(n > length) n = length;
+    memcpy(t->console_buf + t->console_len, buffer, n);
+    t->console_len += n;
+    if(t->console_len == CONSOLE_BUF_SIZE || memchr(buffer, '\n', n))
+      console_flush();
+    buffer += n;
+    length -= n;
   }
-  lock_release(&filesys_lock);
-
-  return fe->fd;
 }
 
-
-/* returns allocated fd value */
-int alloc_fd(void)
+/* write out the running thread's buffered console output */
+static void console_flush(void)
 {
-  static int fd = 2;
-  return fd++;
+  struct thread *t = thread_current();
+
+  if(t->console_len == 0) return;
+  putbuf(t->console_buf, t->console_len);
+  t->console_len = 0;
 }
 
-/* returns file size */
-int filesize (int fd)
+/* write out and free the exiting thread's console buffer */
+void syscall_console_done (void)
 {
-  struct file_elem *fe = find_file_elem(fd);
-  if(!fe) exit(-1);
-  return file_length(fe->file);
+  struct thread *t = thread_current();
+
+  console_flush();
+  free(t->console_buf);
+  t->console_buf = NULL;
 }
 
+/* copy_file_range system call.  Copies LENGTH bytes from FD_IN,
+   at its position, to FD_OUT, at its position, inside the kernel,
+   and advances both positions.  Returns the number of bytes
+   copied, which is short only at the end of FD_IN, or -1 if
+   either fd is not an open file or the two are the same file and
+   the ranges overlap */
+int copy_file_range (int fd_in, int fd_out, unsigned length)
+{
+  struct file_elem *in = find_file_elem(fd_in);
+  struct file_elem *out = find_file_elem(fd_out);
+  off_t in_pos, out_pos;
+  int ret = -1;
 
-/* returns the number of bytes actually read 
-   returns -1 if it could not be read */
-int read (int fd, void *buffer, unsigned length)
+  if(in && out && !in->isdir && !out->isdir && !in->pipe && !out->pipe
+     && (off_t)length >= 0)
+  {
+    in_pos = file_tell(in->file);
+    out_pos = file_tell(out->file);
+    if(file_get_inode(in->file) != file_get_inode(out->file)
+       || in_pos >= (off_t)(out_pos + length)
+       || out_pos >= (off_t)(in_pos + length))
+      ret = file_copy(out->file, in->file, length);
+  }
+  if(in) put_file_elem(in);
+  if(out) put_file_elem(out);
+  return ret;
+}
+
+/* pipe system call.  Makes a pipe and puts the fd of its read
+   end in FDS[0] and that of its write end in FDS[1].  Returns
+   false if memory is not available */
+bool pipe (int *fds)
 {
-  int ret = 0;
-  struct file_elem *fe;
-  unsigned i;
+  struct file_elem *ends[2];
+  struct pipe *p;
+  int kfds[2];
+  int i;
 
-  if(!is_user_vaddr(buffer)||(!is_user_vaddr(buffer+length))) return -1; // buffer is not in user virtual address
-  
-  if(fd == 0)  //stdin
+  if(!is_user_vaddr(fds) || !is_user_vaddr(fds + 2)) exit(-1);
+
+  p = pipe_create();
+  if(!p) return false;
+  for(i = 0; i < 2; i++)
   {
-    for(i=0; i<length; i++)
+    ends[i] = (struct file_elem *)kmem_cache_alloc(&file_elem_cache);
+    if(!ends[i])
     {
-      *(uint8_t *)(buffer + i) = input_getc();
+      // close the ends that have no file_elem to close them
+      pipe_close(p, true);
+      pipe_close(p, false);
+      if(i == 1) kmem_cache_free(&file_elem_cache, ends[0]);
+      return false;
     }
-    ret = length;
-  } else if(fd == 1) return -1; // stdout
-  else
+    ends[i]->isdir = false;
+    ends[i]->file = NULL;
+    ends[i]->dir = NULL;
+    ends[i]->pipe = p;
+    ends[i]->writer = i == 1;
+    ends[i]->direct = false;
+  }
+
+  kfds[0] = alloc_fd(ends[0]);
+  kfds[1] = kfds[0] < 0 ? -1 : alloc_fd(ends[1]);
+  if(kfds[1] < 0)
   {
-    lock_acquire(&filesys_lock);
-    fe = find_file_elem(fd);
-    if(!fe)
-    { 
-      lock_release(&filesys_lock);
-      return -1;
-    }
-    ret = file_read(fe->file, buffer, length);
-    lock_release(&filesys_lock);
+    if(kfds[0] < 0) close_file_elem(ends[0]);
+    else close(kfds[0]);
+    close_file_elem(ends[1]);
+    return false;
   }
 
-  return ret;
+  if(!copy_to_user(fds, kfds, sizeof kfds))
+  {
+    close(kfds[0]);
+    close(kfds[1]);
+    exit(-1);
+  }
+  return true;
 }
 
-/* seek system call */
-void seek (int fd, unsigned position)
+/* ring_setup system call.  Registers RING, which the process
+   has zeroed, as its system call ring, replacing any earlier
+   one.  Returns false if RING is not a user address */
+bool ring_setup (struct io_ring *ring)
 {
-  struct file_elem *fe = find_file_elem(fd);
-  if(!fe) exit(-1); // if the file could not be found, call exit(-1)
-  struct file *f = fe->file;
-  lock_acquire(&filesys_lock);
-  file_seek(f, position);
-  lock_release(&filesys_lock);
+  unsigned head;
+
+  if(!is_user_vaddr(ring) || !is_user_vaddr(ring + 1)) return false;
+  if(!copy_from_user(&head, &ring->sq_head, sizeof head)) exit(-1);
+  thread_process()->proc->io_ring = ring;
+  return true;
 }
 
+/* ring_enter system call.  Makes the calls queued on the
+   process's ring, in order, until the submission queue is empty
+   or the completion queue is full.  The ring's head and tail
+   are read once and written back once, and each entry is copied
+   in or out as a whole.  Returns the number of calls made, or
+   -1 if no ring is registered */
+static int ring_enter (struct intr_frame *f)
+{
+  struct io_ring *ring = thread_process()->proc->io_ring;
+  unsigned idx[4];	// sq_head, sq_tail, cq_head, cq_tail
+  int done = 0;
 
-/* tell system call */
-unsigned tell (int fd)
-{ 
-  unsigned ret;
-  struct file_elem *fe = find_file_elem(fd);
-  if(!fe) exit(-1); // if the file could not be found, call exit(-1)
-  struct file *f = fe->file;
-  lock_acquire(&filesys_lock);
-  ret = file_tell(f);
-  lock_release(&filesys_lock);
+  if(!ring) return -1;
+  if(!copy_from_user(idx, &ring->sq_head, sizeof idx)) exit(-1);
 
-  return ret;
+  while(idx[0] != idx[1] && idx[3] - idx[2] < IO_RING_SIZE)
+  {
+    struct io_sqe sqe;
+    struct io_cqe cqe;
+
+    if(!copy_from_user(&sqe, &ring->sq[idx[0] % IO_RING_SIZE], sizeof sqe))
+      exit(-1);
+    idx[0]++;
+
+    cqe.tag = sqe.tag;
+    if(sqe.nr >= 0 && (unsigned)sqe.nr < SYSCALL_CNT && syscalls[sqe.nr].ring)
+      cqe.result = dispatch(sqe.nr, sqe.args, f);
+    else
+      cqe.result = -1;
+
+    if(!copy_to_user(&ring->cq[idx[3] % IO_RING_SIZE], &cqe, sizeof cqe))
+      exit(-1);
+    idx[3]++;
+    done++;
+  }
+
+  if(!copy_to_user(&ring->sq_head, &idx[0], sizeof idx[0])
+     || !copy_to_user(&ring->cq_tail, &idx[3], sizeof idx[3]))
+    exit(-1);
+  return done;
 }
 
+/* give the running thread a copy of each file descriptor of
+   PARENT, with the same number and position.  returns false if
+   a file could not be reopened */
+bool syscall_copy_files (struct thread *parent)
+{
+  struct process *p = thread_current()->proc;
+  struct process *pp = parent->proc;
+  int fd;
 
-/* close system call */
-void close (int fd)
+  bool ok = true;
+
+  // the child's copy of the address space has the ring at the same place
+  p->io_ring = pp->io_ring;
+
+  // the parent's other threads may be opening and closing files
+  lock_acquire(&pp->fd_lock);
+  p->fds = calloc(pp->fd_cnt, sizeof *p->fds);
+  if(pp->fd_cnt > 0 && !p->fds) ok = false;
+  else
+  {
+    p->fd_cnt = pp->fd_cnt;
+    p->fd_free = pp->fd_free;
+  }
+
+  for(fd = 0; ok && fd < p->fd_cnt; fd++)
+  {
+    if(!pp->fds[fd]) continue;
+    p->fds[fd] = dup_file_elem(pp->fds[fd]);
+    if(!p->fds[fd]) ok = false;
+  }
+  lock_release(&pp->fd_lock);
+  return ok;
+}
+
+/* returns a new file_elem, with the same fd, for another opening
+   of the file, directory or pipe end in PFE, at the same
+   position, or NULL if memory is not available */
+static struct file_elem *dup_file_elem(const struct file_elem *pfe)
 {
-  struct file_elem *fe = find_file_elem(fd);
-  if(!fe) exit(-1); // if the file could not be found, call exit(-1)
+  struct file_elem *fe;
 
-  lock_acquire(&filesys_lock);
-  if(fe->isdir)
+  fe = (struct file_elem *)kmem_cache_alloc(&file_elem_cache);
+  if(!fe) return NULL;
+
+  fe->fd = pfe->fd;
+  fe->ref_cnt = 1;
+  fe->isdir = pfe->isdir;
+  fe->pipe = pfe->pipe;
+  fe->writer = pfe->writer;
+  fe->direct = pfe->direct;
+  if(pfe->pipe) pipe_reopen(pfe->pipe, pfe->writer);
+  else if(pfe->isdir)
   {
-    dir_close(fe->dir);
+    fe->dir = dir_reopen(pfe->dir);
+    if(!fe->dir) { kmem_cache_free(&file_elem_cache, fe); return NULL; }
   }
   else
   {
-    file_close(fe->file);
+    fe->file = file_reopen(pfe->file);
+    if(!fe->file) { kmem_cache_free(&file_elem_cache, fe); return NULL; }
+    file_seek(fe->file, file_tell(pfe->file));
   }
+  return fe;
+}
+
+/* give the running thread, a process that PARENT is spawning, a
+   copy of each of PARENT's file descriptors, then apply the CNT
+   ACTIONS to them in order.  returns false if memory is not
+   available or an action names a descriptor that is not open or
+   out of range.  whatever was set up is closed on exit as usual */
+bool syscall_spawn_files (struct thread *parent,
+                          const struct spawn_action *actions, int cnt)
+{
+  struct process *p = thread_current()->proc;
+  int i;
+
+  if(!syscall_copy_files(parent)) return false;
+  // the ring is in the parent's address space, not the new one
+  p->io_ring = NULL;
+
+  for(i = 0; i < cnt; i++)
+  {
+    const struct spawn_action *a = &actions[i];
+    struct file_elem *fe = find_file_elem(a->fd);
+    struct file_elem *dup, *old = NULL;
+    bool ok;
+
+    if(!fe) return false;
+    if(a->op == SPAWN_CLOSE)
+    {
+      lock_acquire(&p->fd_lock);
+      p->fds[a->fd] = NULL;
+      if(a->fd < p->fd_free) p->fd_free = a->fd;
+      lock_release(&p->fd_lock);
+      put_file_elem(fe);
+      unref_file_elem(fe); // the table's reference
+      continue;
+    }
+    if(a->op != SPAWN_DUP || a->to < 0 || a->to >= SPAWN_FD_MAX
+       || a->to == a->fd)
+    {
+      put_file_elem(fe);
+      if(a->op == SPAWN_DUP && a->to == a->fd) continue;
+      return false;
+    }
 
-  list_remove(&fe->thread_elem);
-  lock_release(&filesys_lock);
+    dup = dup_file_elem(fe);
+    put_file_elem(fe);
+    if(!dup) return false;
+    dup->fd = a->to;
+    lock_acquire(&p->fd_lock);
+    ok = grow_fds(p, a->to + 1);
+    if(ok)
+    {
+      old = p->fds[a->to];
+      p->fds[a->to] = dup;
+    }
+    lock_release(&p->fd_lock);
+    if(!ok) { close_file_elem(dup); return false; }
+    if(old) unref_file_elem(old);
+  }
+  return true;
+}
 
-  free(fe);
+/* close every file the running thread still has open and free
+   its fd table.  called when the process exits */
+void syscall_close_files (void)
+{
+  struct process *p = thread_process()->proc;
+  struct file_elem **fds;
+  int fd, cnt;
+
+  lock_acquire(&p->fd_lock);
+  fds = p->fds;
+  cnt = p->fd_cnt;
+  p->fds = NULL;
+  p->fd_cnt = 0;
+  lock_release(&p->fd_lock);
+
+  for(fd = 0; fd < cnt; fd++)
+    if(fds[fd]) unref_file_elem(fds[fd]);
+  free(fds);
 }
 
 bool chdir(const char *dir)
 {
-  return filesys_chdir(dir);
+  bool ret;
+  char *kdir = copy_in_string(dir);
+  if(!kdir) return false;
+  ret = filesys_chdir(kdir);
+  palloc_free_page(kdir);
+  return ret;
 }
 
 bool mkdir(const char *dir)
 {
-  if(strcmp(dir, "") == 0) return false;
-  return filesys_create(dir, 0, true);
+  bool ret;
+  char *kdir = copy_in_string(dir);
+  if(!kdir) return false;
+  if(strcmp(kdir, "") == 0) ret = false;
+  else ret = filesys_create(kdir, 0, true);
+  palloc_free_page(kdir);
+  return ret;
 }
 
 bool readdir(int fd, const char *name)
 {
   struct file_elem *fe = find_file_elem(fd);
+  char kname[NAME_MAX + 1];
+  bool ok;
 
   if(!fe) return false;
-  if(!fe->isdir) return false;
-  if(!dir_readdir(fe->dir, name)) return false;
+  ok = fe->isdir && dir_readdir(fe->dir, kname);
+  put_file_elem(fe);
+  if(ok && !copy_to_user((char *)name, kname, strlen(kname) + 1)) exit(-1);
+
+  return ok;
+}
 
+// reads up to CNT entries of directory FD, with their inode numbers,
+// lengths and types, into ENTS.  returns the number read, 0 at the end
+// of the directory, or -1 if FD is not a directory.  reads at most a
+// page's worth per call
+int getdents(int fd, struct dirent *ents, int cnt)
+{
+  struct file_elem *fe;
+  struct dirent *kents;
+  size_t n;
+
+  if(cnt < 0) return -1;
+  if(cnt > (int)(PGSIZE / sizeof *kents)) cnt = PGSIZE / sizeof *kents;
+
+  fe = find_file_elem(fd);
+  if(!fe) return -1;
+  if(!fe->isdir || cnt == 0)
+  {
+    int ret = fe->isdir ? 0 : -1;
+    put_file_elem(fe);
+    return ret;
+  }
+  kents = palloc_get_page(0);
+  if(!kents)
+  {
+    put_file_elem(fe);
+    return -1;
+  }
+  n = dir_readdir_batch(fe->dir, kents, cnt);
+  put_file_elem(fe);
+  if(!copy_to_user(ents, kents, n * sizeof *kents))
+  {
+    palloc_free_page(kents);
+    exit(-1);
+  }
+  palloc_free_page(kents);
+  return n;
+}
+
+// stores the details of FILE in ST without opening it.  returns false
+// if there is no such file
+bool stat(const char *file, struct stat *st)
+{
+  struct inode *inode;
+  struct stat s;
+  char *kfile;
+
+  if(!file) return false;
+  kfile = copy_in_string(file);
+  if(!kfile) return false;
+  inode = strlen(kfile) != 0 ? filesys_lookup(kfile) : NULL;
+  palloc_free_page(kfile);
+  if(!inode) return false;
+
+  s.inumber = inode_get_inumber(inode);
+  s.length = inode_length(inode);
+  s.is_dir = inode_is_dir(inode);
+  inode_close(inode);
+  if(!copy_to_user(st, &s, sizeof s)) exit(-1);
   return true;
 }
 
 bool isdir(int fd)
 {
   struct file_elem *fe = find_file_elem(fd);
+  bool ret;
 
   if(!fe) return false;
-  return fe->isdir;
+  ret = fe->isdir;
+  put_file_elem(fe);
+  return ret;
 }
 
-bool inumber(int fd)
+int inumber(int fd)
 {
-  block_sector_t inumber;
+  int inumber;
   struct file_elem *fe = find_file_elem(fd);
 
-  if(!fe) return false;
-  if(fe->isdir) inumber = inode_get_inumber(dir_get_inode(fe->dir));
+  if(!fe) return -1;
+  if(fe->pipe) inumber = -1;
+  else if(fe->isdir) inumber = inode_get_inumber(dir_get_inode(fe->dir));
   else inumber = inode_get_inumber(file_get_inode(fe->file));
+  put_file_elem(fe);
 
   return inumber;
 }
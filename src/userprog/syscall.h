@@ -1,7 +1,34 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
-static struct lock filesys_lock; // lock for file system.
+#include <stdbool.h>
+
+struct spawn_action;
+struct thread;
+
 void syscall_init (void);
+void syscall_print_stats (void);
+bool syscall_copy_files (struct thread *parent);
+bool syscall_spawn_files (struct thread *parent,
+                          const struct spawn_action *, int cnt);
+void syscall_close_files (void);
+void syscall_trace_exit (void);
+void syscall_console_done (void);
+void syscall_release_files (void);
+
+/* If true, keep system call statistics for each process and
+   print them when it exits.  Set by the "-sctrace" option. */
+extern bool syscall_trace;
+
+/* If true, let user programs enter the kernel with SYSENTER
+   where the CPU has it.  On unless the "-nosysenter" option is
+   given. */
+extern bool syscall_sysenter;
+
+/* Entry point for system calls made with SYSENTER, in
+   sysenter.S, and a flag set when a program single-stepped into
+   it; see there. */
+void sysenter_entry (void);
+extern bool sysenter_tf;
 
 #endif /* userprog/syscall.h */
@@ -2,6 +2,7 @@
 #include <debug.h>
 #include <stddef.h>
 #include "userprog/gdt.h"
+#include "threads/cpu.h"
 #include "threads/thread.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
@@ -75,6 +76,15 @@ struct tss
 /* Kernel TSS. */
 static struct tss *tss;
 
+/* Stack that SYSENTER switches to.  The entry stub's first
+   instruction loads the thread's kernel stack pointer from the
+   word at its top, which tss_update() keeps equal to esp0, but a
+   debug trap or NMI can arrive before that instruction, and then
+   runs here.  Their handlers must not sleep or look at the
+   running thread, which cannot be found from this stack. */
+#define SYSENTER_STACK_WORDS 1024
+static uint32_t sysenter_stack[SYSENTER_STACK_WORDS];
+
 /* Initializes the kernel TSS. */
 void
 tss_init (void) 
@@ -103,4 +113,23 @@ tss_update (void)
 {
   ASSERT (tss != NULL);
   tss->esp0 = (uint8_t *) thread_current () + PGSIZE;
+  sysenter_stack[SYSENTER_STACK_WORDS - 1] = (uint32_t) tss->esp0;
+}
+
+/* Sets up SYSENTER to enter the kernel at ENTRY.  Rather than
+   change the SYSENTER stack pointer at every thread switch, we
+   point it at the top word of sysenter_stack, a copy of esp0,
+   which ENTRY loads into ESP as its first instruction.  Anything
+   pushed before then goes below that word, on a real stack.
+   The CPU takes the kernel stack segment from the selector after
+   SEL_KCSEG, and SYSEXIT takes the user selectors from the two
+   after that, which is how gdt_init() lays them out. */
+void
+tss_sysenter_init (void (*entry) (void)) 
+{
+  ASSERT (tss != NULL);
+  msr_write (MSR_SYSENTER_CS, SEL_KCSEG);
+  msr_write (MSR_SYSENTER_ESP,
+             (uint32_t) &sysenter_stack[SYSENTER_STACK_WORDS - 1]);
+  msr_write (MSR_SYSENTER_EIP, (uint32_t) entry);
 }
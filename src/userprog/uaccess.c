@@ -0,0 +1,132 @@
+#include "userprog/uaccess.h"
+#include <debug.h>
+#include <stdint.h>
+#include "threads/interrupt.h"
+#include "threads/vaddr.h"
+
+/* Kernel access to user memory.
+
+   Instead of looking each user pointer up in the page directory
+   before using it, these functions simply touch user memory.  If
+   an access faults and page_fault() cannot bring the page in, it
+   calls uaccess_fixup(), which resumes execution at a recovery
+   address that the faulting code left in %eax, with %eax set to
+   -1, so that the access fails instead of killing the kernel.
+
+   Only the two instructions labeled below are recovered this
+   way.  A fault on a user address anywhere else in the kernel is
+   handled as before.  Each function is kept out of line so that
+   its label appears exactly once. */
+
+/* The instructions that may fault. */
+extern const char uaccess_copy_insn[], uaccess_get_insn[];
+
+static bool user_range_ok (const void *uaddr, size_t size);
+static bool copy_bytes (void *dst, const void *src, size_t size);
+static int get_byte (const uint8_t *uaddr);
+
+/* Copies SIZE bytes from user address USRC to DST.  Returns true
+   if successful, false if part of USRC is not valid user
+   memory. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size)
+{
+  return user_range_ok (usrc, size) && copy_bytes (dst, usrc, size);
+}
+
+/* Copies SIZE bytes from SRC to user address UDST.  Returns true
+   if successful, false if part of UDST is not valid, writable
+   user memory.  Bytes before the invalid part may have been
+   written. */
+bool
+copy_to_user (void *udst, const void *src, size_t size)
+{
+  return user_range_ok (udst, size) && copy_bytes (udst, src, size);
+}
+
+/* Copies the null-terminated string at user address USRC into
+   DST, which has room for SIZE bytes.  Returns the length of the
+   string, or -1 if it runs into memory that is not valid user
+   memory.  A string of SIZE bytes or more is truncated to
+   SIZE - 1 bytes, and SIZE is returned. */
+int
+strncpy_from_user (char *dst, const char *usrc, size_t size)
+{
+  size_t i;
+
+  ASSERT (size > 0);
+
+  for (i = 0; i < size - 1; i++)
+    {
+      int c;
+
+      if (!is_user_vaddr (usrc + i))
+        return -1;
+      c = get_byte ((const uint8_t *) usrc + i);
+      if (c < 0)
+        return -1;
+      dst[i] = c;
+      if (c == '\0')
+        return i;
+    }
+  dst[i] = '\0';
+  return size;
+}
+
+/* Called by page_fault() for a fault in the kernel on a user
+   address that could not be resolved, with the interrupt frame
+   F.  If one of the functions above faulted, arranges for the
+   access to fail and returns true.  Otherwise, returns false. */
+bool
+uaccess_fixup (struct intr_frame *f)
+{
+  const char *eip = (const char *) f->eip;
+
+  if (eip != uaccess_copy_insn && eip != uaccess_get_insn)
+    return false;
+  f->eip = (void (*) (void)) f->eax;
+  f->eax = -1;
+  return true;
+}
+
+/* Returns true if the SIZE bytes at UADDR are all below
+   PHYS_BASE. */
+static bool
+user_range_ok (const void *uaddr, size_t size)
+{
+  const uint8_t *p = uaddr;
+
+  return size == 0 || (p + size - 1 >= p && is_user_vaddr (p + size - 1));
+}
+
+/* Copies SIZE bytes from SRC to DST.  Returns false if the copy
+   faulted on a user address. */
+static bool NO_INLINE
+copy_bytes (void *dst, const void *src, size_t size)
+{
+  int error;
+
+  asm volatile ("movl $1f, %%eax\n"
+                "uaccess_copy_insn:\n\t"
+                "rep movsb\n\t"
+                "xorl %%eax, %%eax\n"
+                "1:"
+                : "=&a" (error), "+D" (dst), "+S" (src), "+c" (size)
+                : : "memory");
+  return error == 0;
+}
+
+/* Reads the byte at user address UADDR.  Returns the byte, or -1
+   if the read faulted. */
+static int NO_INLINE
+get_byte (const uint8_t *uaddr)
+{
+  int result;
+
+  asm volatile ("movl $1f, %0\n"
+                "uaccess_get_insn:\n\t"
+                "movzbl %1, %0\n"
+                "1:"
+                : "=&a" (result) : "m" (*uaddr));
+  return result;
+}
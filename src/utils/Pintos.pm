@@ -92,6 +92,209 @@ sub do_set_part {
     }
 }
 
+# File system images.
+#
+# make_filesys() lays out a file system partition on the host in
+# the kernel's own on-disk format, so that the kernel can boot
+# without -f and "extract".  The constants below must follow
+# filesys/filesys.h, inode.c, directory.c, free-map.c and
+# journal.c.  Files always get indirect blocks, the kernel's
+# default layout, or are kept inline if small enough.
+my ($FREE_MAP_SECTOR, $ROOT_DIR_SECTOR, $JOURNAL_SECTOR) = (0, 1, 2);
+my ($INODE_MAGIC) = 0x494e4f44;
+my ($INODE_LAYOUT_INDIRECT, $INODE_LAYOUT_INLINE) = (0, 2);
+my ($INODE_INLINE_SIZE) = 464;
+my ($INODE_INLINE_OFS) = 24;		# Offset of inline data in inode.
+my ($MAXIMUM_SIZE) = 8 * 1024 * 1024;
+my ($NAME_MAX) = 14;
+my ($DIR_ENTRY_SIZE) = 20;
+my ($ROOT_DIR_ENTRIES) = 16;		# Entries do_format() makes room for.
+my ($JOURNAL_MAGIC) = 0x4a524e4c;
+my ($JOURNAL_LOG_SECTORS) = 128;
+
+# make_filesys($sectors, @files)
+#
+# Returns the contents of a $sectors-sector file system partition,
+# formatted the way do_format() formats one, whose root directory
+# holds a copy of each file in @files, a list of [$host_fn,
+# $guest_fn] pairs, as "extract" would have put it there.
+sub make_filesys {
+    my ($sectors, @files) = @_;
+    my (%fs) = (IMAGE => "\0" x ($sectors * 512),
+		SECTORS => $sectors,
+		USED => '',
+		NEXT => 0);
+
+    vec ($fs{USED}, $_, 1) = 1
+      foreach $FREE_MAP_SECTOR, $ROOT_DIR_SECTOR, $JOURNAL_SECTOR;
+
+    # The free map file, allocated first but written last, once it
+    # can record every other allocation.  The kernel's bitmap is an
+    # array of 32-bit words, and vec() numbers bits the same way.
+    my ($map_bytes) = div_round_up ($sectors, 32) * 4;
+    my (@map_sectors) = fs_make_inode (\%fs, $FREE_MAP_SECTOR, 0, $map_bytes);
+
+    # The journal's header and its log, which can stay zeros.
+    my ($log_start) = fs_allocate (\%fs, $JOURNAL_LOG_SECTORS);
+    fs_write_sector (\%fs, $JOURNAL_SECTOR,
+		     pack ("V5", $JOURNAL_MAGIC, $log_start,
+			   $JOURNAL_LOG_SECTORS, 0, 1));
+
+    # The files, then the root directory listing them.
+    my ($entries) = '';
+    my (%seen);
+    for my $file (@files) {
+	my ($host_fn, $guest_fn) = @$file;
+	die "$guest_fn: invalid file name for the root directory\n"
+	  if $guest_fn eq '' || $guest_fn =~ m%/% || $guest_fn eq '.'
+	     || $guest_fn eq '..' || length ($guest_fn) > $NAME_MAX;
+	die "$guest_fn: file name used twice\n" if $seen{$guest_fn}++;
+
+	my ($handle);
+	open ($handle, '<', $host_fn) or die "$host_fn: open: $!\n";
+	my ($data) = read_fully ($handle, $host_fn, -s $handle);
+	close ($handle);
+
+	my ($sector) = fs_allocate (\%fs, 1);
+	fs_write_data (\%fs, $sector, $data,
+		       fs_make_inode (\%fs, $sector, 0, length $data));
+	$entries .= pack ("V a15 C", $sector, $guest_fn, 1);
+    }
+    $entries = pack ("a" . ($ROOT_DIR_ENTRIES * $DIR_ENTRY_SIZE), $entries)
+      if length ($entries) < $ROOT_DIR_ENTRIES * $DIR_ENTRY_SIZE;
+    fs_write_data (\%fs, $ROOT_DIR_SECTOR, $entries,
+		   fs_make_inode (\%fs, $ROOT_DIR_SECTOR, 1,
+				  length $entries));
+
+    fs_write_data (\%fs, $FREE_MAP_SECTOR,
+		   pack ("a$map_bytes", $fs{USED}), @map_sectors);
+    return $fs{IMAGE};
+}
+
+# fs_allocate(\%fs, $cnt)
+#
+# Allocates $cnt consecutive sectors in %fs and returns the first.
+sub fs_allocate {
+    my ($fs, $cnt) = @_;
+    my ($start) = $fs->{NEXT};
+  SCAN: for (;;) {
+	die "file system image full\n" if $start + $cnt > $fs->{SECTORS};
+	for my $i (0...$cnt - 1) {
+	    if (vec ($fs->{USED}, $start + $i, 1)) {
+		$start += $i + 1;
+		next SCAN;
+	    }
+	}
+	last;
+    }
+    vec ($fs->{USED}, $_, 1) = 1 foreach $start...$start + $cnt - 1;
+    $fs->{NEXT} = $start + $cnt;
+    return $start;
+}
+
+# fs_make_inode(\%fs, $sector, $isdir, $length)
+#
+# Writes an inode for $length bytes of data to $sector in %fs,
+# allocating its data sectors and the indirect blocks that list
+# them, and returns the data sectors in order, none if the data
+# is kept inline.  Each indirect block goes just before the data
+# it lists.  The indirect block covering offset $length hangs off
+# the inode itself and the ones before it off the double indirect
+# block, which is where inode.c looks for them.
+sub fs_make_inode {
+    my ($fs, $sector, $isdir, $length) = @_;
+    my ($layout) = $INODE_LAYOUT_INLINE;
+    my ($indirect, $double) = (0, 0);
+    my (@data, @groups);
+
+    die "file too large for the file system ($length bytes)\n"
+      if $length > $MAXIMUM_SIZE;
+    if ($length > $INODE_INLINE_SIZE) {
+	my ($sector_cnt) = div_round_up ($length, 512);
+	my ($last_group) = int ($length / 512 / 128);
+
+	$layout = $INODE_LAYOUT_INDIRECT;
+	for (my $group = 0; $group * 128 < $sector_cnt; $group++) {
+	    my ($cnt) = $sector_cnt - $group * 128;
+	    $cnt = 128 if $cnt > 128;
+
+	    my ($block) = fs_allocate ($fs, 1);
+	    my ($first) = fs_allocate ($fs, $cnt);
+	    my (@run) = $first...$first + $cnt - 1;
+	    fs_write_sector ($fs, $block, pack ("V*", @run));
+	    push (@data, @run);
+
+	    if ($group == $last_group) {
+		$indirect = $block;
+	    } else {
+		push (@groups, $block);
+	    }
+	}
+	if (@groups) {
+	    $double = fs_allocate ($fs, 1);
+	    fs_write_sector ($fs, $double, pack ("V*", @groups));
+	}
+    }
+
+    fs_write_sector ($fs, $sector,
+		     pack ("V l V V V V a$INODE_INLINE_SIZE V C x3 V V V V",
+			   0, $length, $INODE_MAGIC, $layout, 0, 0, '', 0,
+			   $isdir, $ROOT_DIR_SECTOR, $sector,
+			   $indirect, $double));
+    return @data;
+}
+
+# fs_write_data(\%fs, $sector, $data, @data_sectors)
+#
+# Writes $data into the inode at $sector in %fs, whose data
+# sectors are @data_sectors, or into the inode itself if there
+# are none.
+sub fs_write_data {
+    my ($fs, $sector, $data, @data_sectors) = @_;
+    if (!@data_sectors) {
+	substr ($fs->{IMAGE}, $sector * 512 + $INODE_INLINE_OFS,
+		length $data) = $data;
+	return;
+    }
+    for my $i (0...$#data_sectors) {
+	fs_write_sector ($fs, $data_sectors[$i], substr ($data, $i * 512, 512));
+    }
+}
+
+# fs_write_sector(\%fs, $sector, $data)
+#
+# Writes $data, padded with zeros to 512 bytes, to $sector in %fs.
+sub fs_write_sector {
+    my ($fs, $sector, $data) = @_;
+    die if length ($data) > 512 || $sector >= $fs->{SECTORS};
+    substr ($fs->{IMAGE}, $sector * 512, 512) = pack ("a512", $data);
+}
+
+# set_filesys_files($align, @files)
+#
+# Replaces the empty file system partition set up by
+# --filesys-size with a freshly formatted one holding @files, as
+# for make_filesys().  $align is the partition alignment, which
+# must not round the partition up: the free map has to cover
+# exactly the sectors the kernel will find.
+sub set_filesys_files {
+    my ($align, @files) = @_;
+    my ($p) = $parts{FILESYS};
+
+    die "--mkfs requires --filesys-size\n"
+      if !defined ($p) || $p->{FILE} ne '/dev/zero';
+    die "--mkfs cannot be used with --align=full\n"
+      if defined ($align) && $align eq 'full';
+
+    my ($sectors) = div_round_up ($p->{BYTES}, 512);
+    my ($handle, $fn) = File::Temp::tempfile (UNLINK => 1, SUFFIX => '.part');
+    write_fully ($handle, $fn, make_filesys ($sectors, @files));
+    close ($handle) or die "$fn: close: $!\n";
+
+    $p->{FILE} = $fn;
+    $p->{BYTES} = $sectors * 512;
+}
+
 # set_geometry('HEADS,SPT')
 # set_geometry('zip')
 #
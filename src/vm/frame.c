@@ -0,0 +1,1023 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <proc-limits.h>
+#include <proc-stats.h>
+#include <stdio.h>
+#include <string.h>
+#include <vm-stats.h>
+#include "devices/timer.h"
+#include "filesys/inode.h"
+#include "threads/kmem.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+
+/* Frame table.
+
+   Every frame in the user pool that holds user pages is in the
+   FRAMES list.  When the user pool runs dry, frame_alloc() takes
+   frames away from their pages: HAND sweeps around the list and
+   stops at the frames that the eviction policy chooses.
+
+   The default policy is the clock algorithm, which clears the
+   accessed bits of the pages in each frame the hand passes, and
+   chooses frames none of whose pages have been accessed since
+   the previous sweep.  The aging policy ("-evict=aging") keeps an
+   8-bit history of accesses per frame instead, which a kernel
+   thread shifts every AGE_INTERVAL ticks, whether or not memory
+   is short.  It chooses frames that have not been accessed for
+   the longest, lowering its standards with each sweep, so that
+   pages used in phases keep their frames through a phase in
+   which they are idle for a moment.
+
+   Rather than one frame at a time, the hand collects victims
+   holding up to PAGE_OUT_MAX pages, and page_out() saves them
+   together, so that dirty ones go to swap in a single transfer.
+   One frame is handed to the new page and the rest go back to
+   the user pool, where the next few allocations find them.
+
+   A process that has as many pages in frames as its
+   LIMIT_FRAMES allows gets a frame for another by evicting one of
+   its own, whether or not the pool has free frames, so that it
+   cannot crowd out other processes.  Only if all of its frames
+   are pinned or shared does it take one from the pool.
+
+   A pinned frame is never chosen.  Frames are pinned while they
+   are being filled, and while the kernel is using them on a
+   process's behalf (see page_pin()).
+
+   Read-only pages of executables are shared: the first process
+   to touch one reads it into a frame that is entered in the
+   SHARED table under its inode and offset, and other processes
+   that touch the same page map the same frame.  So are pages of
+   memory-mapped files that are read before they are written,
+   copy-on-write, so that a file mapped by several processes, or
+   mapped again later, is in memory only once.  A shared frame
+   whose last page goes away stays in the table, so that running
+   the same program again finds its text already in memory, and
+   is the first kind of frame to be evicted.  A write to the
+   inode changes its version, which makes its shared frames
+   stale.
+
+   fork() shares the resident pages of the parent with the child
+   in the same way, mapping writable ones read-only in both
+   processes.  The first process to write such a copy-on-write
+   page gets a frame of its own from frame_unshare().
+
+   With "-merge", a low-priority thread also looks for private
+   frames with the same contents, for example the data of several
+   processes running the same program, and makes them share one
+   frame, copy-on-write, just as fork() would have left them.  It
+   walks the frame table with its own hand, a few frames at a time,
+   and looks only at frames holding a single writable page that
+   is not mapped from a file or shared memory.  A frame whose
+   contents hash the same as when the thread last came by is
+   write-protected and looked up, by its contents, in the MERGED
+   table.  If an identical frame is there, the page moves to it
+   and its own frame is freed; otherwise the frame itself goes in
+   the table, for later ones to merge with.  Every page of a
+   frame in MERGED is copy-on-write, so its contents cannot change
+   until the last one is written, which takes it out again. */
+
+static struct list frames;          /* All frames in use. */
+static struct list_elem *hand;      /* Clock hand. */
+static struct hash shared;          /* Shared frames, by inode and offset. */
+static struct list_elem *merge_hand; /* Merging thread's hand. */
+static struct hash merged;          /* Merged frames, by contents. */
+
+/* Protects the above, and the PAGES, PIN_CNT and shared frame
+   members of every frame. */
+static struct lock frame_lock;
+
+/* Cache of struct frame objects. */
+static struct kmem_cache frame_cache;
+
+/* An eviction policy. */
+struct evict_policy
+  {
+    const char *name;           /* Name for "-evict". */
+
+    /* Returns true if the hand should take F, which is not
+       pinned, on sweep SWEEP of an eviction, counting from 0. */
+    bool (*choose) (struct frame *f, unsigned sweep);
+    unsigned sweeps;            /* Sweeps before giving up. */
+  };
+
+static bool clock_choose (struct frame *, unsigned sweep);
+static bool aging_choose (struct frame *, unsigned sweep);
+static thread_func aging_daemon NO_RETURN;
+
+static const struct evict_policy policies[] =
+  {
+    {"clock", clock_choose, 2},
+    {"aging", aging_choose, 5},
+  };
+
+/* Name of the eviction policy to use, set by the "-evict" kernel
+   command-line option, or null for the default. */
+const char *frame_evict_policy;
+
+/* Eviction policy in use. */
+static const struct evict_policy *policy;
+
+/* Timer ticks between passes of the aging thread. */
+#define AGE_INTERVAL (TIMER_FREQ / 10)
+
+/* Merge identical pages?  Set by the "-merge" kernel command-line
+   option. */
+bool frame_merge;
+
+/* The merging thread looks at MERGE_BATCH frames every
+   MERGE_INTERVAL timer ticks. */
+#define MERGE_BATCH 32
+#define MERGE_INTERVAL (TIMER_FREQ / 10)
+
+/* Statistics, protected by FRAME_LOCK. */
+static size_t frame_cnt;        /* Frames in FRAMES. */
+static uint64_t evict_cnt;      /* Frames evicted. */
+static uint64_t sweep_cnt;      /* Frames the clock hand passed. */
+static uint64_t merge_cnt;      /* Pages merged into another's frame. */
+
+static struct frame *evict_frame (struct thread *owner);
+static bool over_limit (struct thread *);
+static bool owned_by (struct frame *, struct thread *);
+static bool frame_accessed (struct frame *);
+static bool lock_pages (struct frame *);
+static struct frame *frame_insert (struct frame *, void *kpage,
+                                   struct page *);
+static void frame_release (struct frame *);
+static void frame_detach (struct frame *);
+static void frame_discard (struct frame *);
+static void charge (struct page *, int delta);
+static hash_hash_func share_hash;
+static hash_less_func share_less;
+static thread_func merge_daemon NO_RETURN;
+static void merge_next (void);
+static void merge_frame (struct frame *, struct page *);
+static hash_hash_func merge_hash;
+static hash_less_func merge_less;
+
+/* Initializes the frame table. */
+void
+frame_init (void)
+{
+  list_init (&frames);
+  hand = list_end (&frames);
+  merge_hand = list_end (&frames);
+  hash_init (&shared, share_hash, share_less, NULL);
+  hash_init (&merged, merge_hash, merge_less, NULL);
+  lock_init (&frame_lock);
+  lock_register (&frame_lock, "frame");
+  kmem_cache_init (&frame_cache, "frame", sizeof (struct frame), NULL);
+
+  policy = &policies[0];
+  if (frame_evict_policy != NULL)
+    {
+      size_t i;
+      for (i = 0; i < sizeof policies / sizeof *policies; i++)
+        if (!strcmp (frame_evict_policy, policies[i].name))
+          break;
+      if (i >= sizeof policies / sizeof *policies)
+        PANIC ("unknown eviction policy `%s' (use -h for help)",
+               frame_evict_policy);
+      policy = &policies[i];
+    }
+  if (policy->choose == aging_choose)
+    thread_create ("frame-aging", PRI_DEFAULT, aging_daemon, NULL);
+  if (frame_merge)
+    thread_create ("frame-merge", PRI_MIN, merge_daemon, NULL);
+}
+
+/* Obtains a private frame from the user pool for PAGE, evicting
+   other pages if there is none free, and returns it pinned, with
+   PAGE's FRAME pointing to it, or with no pages if PAGE is null.
+   If FLAGS includes PAL_ZERO, the frame is zeroed.  Returns a
+   null pointer if every frame is pinned or cannot be evicted. */
+struct frame *
+frame_alloc (struct page *page, enum palloc_flags flags)
+{
+  return frame_alloc_at (page, flags, NULL);
+}
+
+/* Like frame_alloc(), but takes the frame at kernel virtual
+   address WANT if WANT is non-null and that frame is free,
+   unless PAGE's process must give up a frame of its own for it
+   to stay within its frame limit. */
+struct frame *
+frame_alloc_at (struct page *page, enum palloc_flags flags, void *want)
+{
+  struct frame *f;
+  void *kpage;
+
+  f = kmem_cache_alloc (&frame_cache);
+  if (f == NULL)
+    return NULL;
+
+  lock_acquire (&frame_lock);
+  kpage = NULL;
+  if (page != NULL && over_limit (page->owner))
+    {
+      struct frame *victim = evict_frame (page->owner);
+      if (victim != NULL)
+        {
+          kpage = victim->kpage;
+          kmem_cache_free (&frame_cache, victim);
+          if (flags & PAL_ZERO)
+            pg_zero (kpage);
+        }
+    }
+  if (kpage == NULL && want != NULL)
+    kpage = palloc_get_page_at (PAL_USER | flags, want);
+  if (kpage == NULL)
+    kpage = palloc_get_page (PAL_USER | flags);
+  if (kpage == NULL)
+    {
+      struct frame *victim = evict_frame (NULL);
+      if (victim == NULL)
+        {
+          lock_release (&frame_lock);
+          kmem_cache_free (&frame_cache, f);
+          return NULL;
+        }
+      kpage = victim->kpage;
+      kmem_cache_free (&frame_cache, victim);
+      if (flags & PAL_ZERO)
+        pg_zero (kpage);
+    }
+
+  frame_insert (f, kpage, page);
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Like frame_alloc(), but only takes a frame that is free
+   without evicting anything, and does not zero it.  For reading
+   ahead, which is not worth evicting a page for, nor going over
+   a frame limit for. */
+struct frame *
+frame_try_alloc (struct page *page)
+{
+  struct frame *f;
+  void *kpage;
+
+  f = kmem_cache_alloc (&frame_cache);
+  if (f == NULL)
+    return NULL;
+
+  lock_acquire (&frame_lock);
+  kpage = over_limit (page->owner) ? NULL : palloc_get_page (PAL_USER);
+  if (kpage != NULL)
+    frame_insert (f, kpage, page);
+  lock_release (&frame_lock);
+  if (kpage == NULL)
+    {
+      kmem_cache_free (&frame_cache, f);
+      return NULL;
+    }
+  return f;
+}
+
+/* Looks for a shared frame holding BYTES bytes read from INODE
+   at OFS, as they are now.  If there is one, adds PAGE to it and
+   returns it pinned, with PAGE's FRAME pointing to it.
+   Otherwise, returns a null pointer. */
+struct frame *
+frame_share_get (struct page *page, struct inode *inode, off_t ofs,
+                 size_t bytes)
+{
+  struct frame key;
+  struct frame *f = NULL;
+  struct hash_elem *e;
+
+  key.inode = inode;
+  key.ofs = ofs;
+  key.bytes = bytes;
+
+  lock_acquire (&frame_lock);
+  e = hash_find (&shared, &key.share_elem);
+  if (e != NULL)
+    {
+      f = hash_entry (e, struct frame, share_elem);
+      if (f->version != inode_get_version (inode))
+        {
+          /* Stale.  Let it go once its pages do. */
+          hash_delete (&shared, &f->share_elem);
+          f->cached = false;
+          frame_release (f);
+          f = NULL;
+        }
+      else
+        {
+          list_push_back (&f->pages, &page->frame_elem);
+          page->frame = f;
+          charge (page, 1);
+          f->pin_cnt++;
+        }
+    }
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Enters F, a private frame holding a single read-only page that
+   was read from BYTES bytes of INODE at OFS while INODE was at
+   VERSION, in the table of shared frames.  Does nothing if
+   another frame for the same data got there first. */
+void
+frame_share_add (struct frame *f, struct inode *inode, off_t ofs,
+                 size_t bytes, unsigned version)
+{
+  lock_acquire (&frame_lock);
+  ASSERT (f->inode == NULL);
+  ASSERT (list_size (&f->pages) == 1);
+
+  f->inode = inode;
+  f->ofs = ofs;
+  f->bytes = bytes;
+  f->version = version;
+  if (hash_insert (&shared, &f->share_elem) == NULL)
+    {
+      inode_reopen (inode);
+      f->cached = true;
+    }
+  else
+    f->inode = NULL;
+  lock_release (&frame_lock);
+}
+
+/* Reads BYTES bytes of INODE at OFS, followed by zeros, into a
+   free frame and enters it in the table of shared frames with
+   no pages, as if a process that had it mapped read-only had
+   since exited, for the "-preload" option.  Does nothing if the
+   table already has the page.  Returns false if no frame is free
+   without evicting one, or the read falls short. */
+bool
+frame_share_preload (struct inode *inode, off_t ofs, size_t bytes)
+{
+  unsigned version = inode_get_version (inode);
+  struct frame key;
+  struct frame *f;
+  void *kpage = NULL;
+  bool found;
+
+  f = kmem_cache_alloc (&frame_cache);
+  if (f == NULL)
+    return false;
+  key.inode = inode;
+  key.ofs = ofs;
+  key.bytes = bytes;
+
+  lock_acquire (&frame_lock);
+  found = hash_find (&shared, &key.share_elem) != NULL;
+  if (!found)
+    kpage = palloc_get_page (PAL_USER);
+  if (kpage != NULL)
+    frame_insert (f, kpage, NULL);
+  lock_release (&frame_lock);
+  if (kpage == NULL)
+    {
+      kmem_cache_free (&frame_cache, f);
+      return found;
+    }
+
+  if (inode_read_at (inode, kpage, bytes, ofs) != (off_t) bytes)
+    {
+      lock_acquire (&frame_lock);
+      f->pin_cnt--;
+      frame_release (f);
+      lock_release (&frame_lock);
+      return false;
+    }
+  memset ((uint8_t *) kpage + bytes, 0, PGSIZE - bytes);
+
+  lock_acquire (&frame_lock);
+  f->inode = inode;
+  f->ofs = ofs;
+  f->bytes = bytes;
+  f->version = version;
+  if (hash_insert (&shared, &f->share_elem) == NULL)
+    {
+      inode_reopen (inode);
+      f->cached = true;
+    }
+  else
+    f->inode = NULL;
+  f->pin_cnt--;
+  frame_release (f);
+  lock_release (&frame_lock);
+  return true;
+}
+
+/* Adds PAGE, of another process, to F, which is resident for a
+   page being copied by fork(), and sets PAGE's FRAME to F.  The
+   caller must hold the lock of a page already in F. */
+void
+frame_add_page (struct frame *f, struct page *page)
+{
+  lock_acquire (&frame_lock);
+  list_push_back (&f->pages, &page->frame_elem);
+  page->frame = f;
+  charge (page, 1);
+  lock_release (&frame_lock);
+}
+
+/* Makes sure that PAGE, whose lock the caller must hold, is the
+   only page in its frame, by moving it to a new frame holding a
+   copy of the old one's contents if other pages share it.
+   Returns false if no frame is available, leaving PAGE where it
+   was. */
+bool
+frame_unshare (struct page *page)
+{
+  struct frame *old = page->frame;
+  struct frame *f;
+
+  ASSERT (old != NULL);
+
+  /* Keep the old frame from being evicted or freed while it is
+     copied. */
+  lock_acquire (&frame_lock);
+  if (list_size (&old->pages) == 1)
+    {
+      /* A shared frame that only PAGE maps is no longer what its
+         file holds once PAGE is written, so it leaves the
+         table. */
+      if (old->cached)
+        {
+          hash_delete (&shared, &old->share_elem);
+          old->cached = false;
+          inode_close (old->inode);
+          old->inode = NULL;
+        }
+
+      /* Nor is a merged frame what others may merge with. */
+      if (old->merged)
+        {
+          hash_delete (&merged, &old->merge_elem);
+          old->merged = false;
+        }
+      lock_release (&frame_lock);
+      return true;
+    }
+  old->pin_cnt++;
+  lock_release (&frame_lock);
+
+  f = frame_alloc (NULL, 0);
+  if (f == NULL)
+    {
+      frame_unpin (old);
+      return false;
+    }
+  pg_copy (f->kpage, old->kpage);
+
+  lock_acquire (&frame_lock);
+  list_remove (&page->frame_elem);
+  list_push_back (&f->pages, &page->frame_elem);
+  page->frame = f;
+  f->pin_cnt--;
+  old->pin_cnt--;
+  frame_release (old);
+  lock_release (&frame_lock);
+  return true;
+}
+
+/* Removes PAGE, which must have been unmapped and unpinned, from
+   its frame, and sets its FRAME to null.  Frees the frame if no
+   other page is using it, unless it is a shared frame that is
+   kept cached. */
+void
+frame_remove (struct page *page)
+{
+  struct frame *f = page->frame;
+
+  ASSERT (f != NULL);
+
+  lock_acquire (&frame_lock);
+  list_remove (&page->frame_elem);
+  page->frame = NULL;
+  charge (page, -1);
+  frame_release (f);
+  lock_release (&frame_lock);
+}
+
+/* Keeps F from being evicted until a matching frame_unpin(). */
+void
+frame_pin (struct frame *f)
+{
+  lock_acquire (&frame_lock);
+  f->pin_cnt++;
+  lock_release (&frame_lock);
+}
+
+/* Undoes one frame_pin(), or the pin that frame_alloc(),
+   frame_try_alloc() or frame_share_get() returned F with.  Frees
+   F if it has no pages left. */
+void
+frame_unpin (struct frame *f)
+{
+  lock_acquire (&frame_lock);
+  ASSERT (f->pin_cnt > 0);
+  f->pin_cnt--;
+  frame_release (f);
+  lock_release (&frame_lock);
+}
+
+/* Fills in the frame table statistics in STATS. */
+void
+frame_get_stats (struct vm_stats *stats)
+{
+  lock_acquire (&frame_lock);
+  stats->frame_cnt = frame_cnt;
+  stats->evict_cnt = evict_cnt;
+  lock_release (&frame_lock);
+}
+
+/* Prints frame table statistics. */
+void
+frame_print_stats (void)
+{
+  printf ("Frames: %zu in use, %"PRIu64" evicted, "
+          "%"PRIu64" examined by the %s policy\n",
+          frame_cnt, evict_cnt, sweep_cnt, policy->name);
+  if (frame_merge)
+    printf ("Frames: %"PRIu64" pages merged, %zu frames open to merging\n",
+            merge_cnt, hash_size (&merged));
+}
+
+/* Sets up F to hold PAGE, of the running thread, in KPAGE, and
+   adds it to the frame table, pinned.  If PAGE is null, F starts
+   out with no pages.  Returns F. */
+static struct frame *
+frame_insert (struct frame *f, void *kpage, struct page *page)
+{
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  f->kpage = kpage;
+  list_init (&f->pages);
+  if (page != NULL)
+    {
+      list_push_back (&f->pages, &page->frame_elem);
+      page->frame = f;
+      charge (page, 1);
+    }
+  f->pin_cnt = 1;
+  f->age = 0;
+  f->inode = NULL;
+  f->cached = false;
+  f->merge_sum = 0;
+  f->merged = false;
+
+  /* Insert just behind the hand, so that the new frame is the
+     last one the hand comes to. */
+  list_insert (hand, &f->elem);
+  frame_cnt++;
+  return f;
+}
+
+/* Frees F if no page is using it or has it pinned, unless it
+   is a shared frame that is kept cached. */
+static void
+frame_release (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  if (list_empty (&f->pages) && f->pin_cnt == 0 && !f->cached)
+    frame_discard (f);
+}
+
+/* Removes F from the frame table and the table of shared
+   frames, but leaves its page allocated. */
+static void
+frame_detach (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+  ASSERT (list_empty (&f->pages));
+
+  if (hand == &f->elem)
+    hand = list_next (hand);
+  if (merge_hand == &f->elem)
+    merge_hand = list_next (merge_hand);
+  list_remove (&f->elem);
+  frame_cnt--;
+  if (f->cached)
+    {
+      hash_delete (&shared, &f->share_elem);
+      f->cached = false;
+    }
+  if (f->merged)
+    {
+      hash_delete (&merged, &f->merge_elem);
+      f->merged = false;
+    }
+  if (f->inode != NULL)
+    {
+      inode_close (f->inode);
+      f->inode = NULL;
+    }
+}
+
+/* Detaches F and frees it along with its page. */
+static void
+frame_discard (struct frame *f)
+{
+  frame_detach (f);
+  palloc_free_page (f->kpage);
+  kmem_cache_free (&frame_cache, f);
+}
+
+/* Chooses frames with the eviction policy, pages their contents
+   out, and gives all but one of them back to the user pool.  If
+   OWNER is nonnull, only chooses frames whose pages are all
+   OWNER's.  Returns the remaining frame, detached, or a null
+   pointer if no frame can be evicted. */
+static struct frame *
+evict_frame (struct thread *owner)
+{
+  struct frame *victims[PAGE_OUT_MAX];
+  struct page *pages[PAGE_OUT_MAX];
+  struct frame *result = NULL;
+  size_t victim_cnt = 0, page_cnt = 0, freed_cnt = 0;
+  size_t n = list_size (&frames);
+  size_t i, max = policy->sweeps * n;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  /* The policy's last sweep takes any frame that was not just
+     accessed, unless every frame is pinned or busy. */
+  for (i = 0; i < max && victim_cnt + freed_cnt < PAGE_OUT_MAX; i++)
+    {
+      struct list_elem *e;
+      struct frame *f;
+
+      if (hand == list_end (&frames))
+        hand = list_begin (&frames);
+      f = list_entry (hand, struct frame, elem);
+      hand = list_next (hand);
+      sweep_cnt++;
+
+      if (f->pin_cnt > 0 || (owner != NULL && !owned_by (f, owner))
+          || !policy->choose (f, i / n))
+        continue;
+
+      /* A cached frame that nothing maps can go right away. */
+      if (list_empty (&f->pages))
+        {
+          if (result == NULL)
+            {
+              frame_detach (f);
+              result = f;
+            }
+          else
+            frame_discard (f);
+          freed_cnt++;
+          evict_cnt++;
+          continue;
+        }
+
+      /* A page whose lock is held is being paged in, pinned or
+         freed by its owner.  Pin the victims so that the second
+         sweep doesn't pick them again. */
+      if (page_cnt + list_size (&f->pages) > PAGE_OUT_MAX || !lock_pages (f))
+        continue;
+      f->pin_cnt++;
+      victims[victim_cnt++] = f;
+      for (e = list_begin (&f->pages); e != list_end (&f->pages);
+           e = list_next (e))
+        pages[page_cnt++] = list_entry (e, struct page, frame_elem);
+    }
+
+  page_out (victims, victim_cnt);
+  for (i = 0; i < page_cnt; i++)
+    {
+      if (pages[i]->frame == NULL)
+        {
+          list_remove (&pages[i]->frame_elem);
+          charge (pages[i], -1);
+        }
+      lock_release (&pages[i]->lock);
+    }
+
+  /* A frame is free once all of its pages are out. */
+  for (i = 0; i < victim_cnt; i++)
+    {
+      struct frame *f = victims[i];
+
+      f->pin_cnt--;
+      if (list_empty (&f->pages))
+        {
+          evict_cnt++;
+          if (result == NULL)
+            {
+              frame_detach (f);
+              result = f;
+            }
+          else
+            frame_discard (f);
+        }
+    }
+  return result;
+}
+
+/* Clock policy: chooses F if none of its pages have been
+   accessed since the hand last passed it. */
+static bool
+clock_choose (struct frame *f, unsigned sweep UNUSED)
+{
+  return !frame_accessed (f);
+}
+
+/* Aging policy: chooses F if it has not been accessed for long
+   enough.  The first sweep requires 8 idle aging intervals, and
+   each later one 2 fewer, down to none on the last sweep.  An
+   access since the last aging pass counts as the most recent. */
+static bool
+aging_choose (struct frame *f, unsigned sweep)
+{
+  if (frame_accessed (f))
+    {
+      f->age |= 0x80;
+      return false;
+    }
+  return f->age < (1u << (2 * sweep));
+}
+
+/* Aging thread.  Every AGE_INTERVAL ticks, shifts each frame's
+   access history right and records in its top bit whether any
+   of its pages were accessed since the previous pass. */
+static void
+aging_daemon (void *aux UNUSED)
+{
+  for (;;)
+    {
+      struct list_elem *e;
+
+      timer_sleep (AGE_INTERVAL);
+      lock_acquire (&frame_lock);
+      for (e = list_begin (&frames); e != list_end (&frames);
+           e = list_next (e))
+        {
+          struct frame *f = list_entry (e, struct frame, elem);
+          f->age = (f->age >> 1) | (frame_accessed (f) ? 0x80 : 0);
+        }
+      lock_release (&frame_lock);
+    }
+}
+
+/* Merging thread.  Every MERGE_INTERVAL ticks, looks at the next
+   MERGE_BATCH frames under MERGE_HAND. */
+static void
+merge_daemon (void *aux UNUSED)
+{
+  for (;;)
+    {
+      int i;
+
+      timer_sleep (MERGE_INTERVAL);
+      for (i = 0; i < MERGE_BATCH; i++)
+        merge_next ();
+    }
+}
+
+/* Advances MERGE_HAND past the next frame, and if the frame
+   holds a single private, writable page whose owner is not using
+   it just now, and it has the same contents as when the hand last
+   came by, merges it with an identical frame or enters it in
+   MERGED. */
+static void
+merge_next (void)
+{
+  struct frame *f;
+  struct page *p;
+  uint32_t *pd;
+  unsigned sum;
+
+  lock_acquire (&frame_lock);
+  if (list_empty (&frames))
+    {
+      lock_release (&frame_lock);
+      return;
+    }
+  if (merge_hand == list_end (&frames))
+    merge_hand = list_begin (&frames);
+  f = list_entry (merge_hand, struct frame, elem);
+  merge_hand = list_next (merge_hand);
+
+  if (f->pin_cnt > 0 || f->merged || f->inode != NULL
+      || list_size (&f->pages) != 1)
+    {
+      lock_release (&frame_lock);
+      return;
+    }
+  p = list_entry (list_front (&f->pages), struct page, frame_elem);
+  if (p->cow || !p->writable || p->shared || p->write_back
+      || !lock_try_acquire (&p->lock))
+    {
+      lock_release (&frame_lock);
+      return;
+    }
+  f->pin_cnt++;
+  lock_release (&frame_lock);
+
+  /* Write-protect a page that looks stable, and hash it again in
+     case it changed in between. */
+  pd = p->owner->pagedir;
+  sum = hash_bytes (f->kpage, PGSIZE);
+  if (sum == f->merge_sum)
+    {
+      pagedir_set_writable (pd, p->upage, false);
+      sum = hash_bytes (f->kpage, PGSIZE);
+      if (sum == f->merge_sum)
+        merge_frame (f, p);
+      else
+        pagedir_set_writable (pd, p->upage, true);
+    }
+  f->merge_sum = sum;
+
+  lock_acquire (&frame_lock);
+  f->pin_cnt--;
+  frame_release (f);
+  lock_release (&frame_lock);
+  lock_release (&p->lock);
+}
+
+/* Moves P, the only page in F, which the caller has pinned and
+   mapped read-only, into a frame in MERGED with the same
+   contents, or if there is none, enters F there.  Either way P
+   becomes copy-on-write.  If the identical frame is pinned, just
+   makes P writable again.  The caller must hold P's lock. */
+static void
+merge_frame (struct frame *f, struct page *p)
+{
+  uint32_t *pd = p->owner->pagedir;
+  struct hash_elem *e;
+
+  lock_acquire (&frame_lock);
+  e = hash_find (&merged, &f->merge_elem);
+  if (e == NULL)
+    {
+      hash_insert (&merged, &f->merge_elem);
+      f->merged = true;
+      p->cow = true;
+    }
+  else
+    {
+      struct frame *s = hash_entry (e, struct frame, merge_elem);
+
+      if (s->pin_cnt == 0)
+        {
+          /* F's contents are saved nowhere else if P is dirty,
+             and now neither are S's. */
+          bool dirty = pagedir_is_dirty (pd, p->upage);
+
+          pagedir_clear_page (pd, p->upage);
+          list_remove (&p->frame_elem);
+          list_push_back (&s->pages, &p->frame_elem);
+          p->frame = s;
+          p->cow = true;
+          pagedir_set_page (pd, p->upage, s->kpage, false);
+          if (dirty)
+            pagedir_set_dirty (pd, p->upage, true);
+          merge_cnt++;
+        }
+      else
+        pagedir_set_writable (pd, p->upage, true);
+    }
+  lock_release (&frame_lock);
+}
+
+/* Returns true if any page in F has been accessed since the last
+   call, clearing the accessed bits of all of them. */
+static bool
+frame_accessed (struct frame *f)
+{
+  struct list_elem *e;
+  bool accessed = false;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      uint32_t *pd = p->owner->pagedir;
+
+      if (pagedir_is_accessed (pd, p->upage))
+        {
+          pagedir_set_accessed (pd, p->upage, false);
+          accessed = true;
+        }
+    }
+  return accessed;
+}
+
+/* Tries to acquire the locks of all the pages in F.  Returns
+   true if successful.  Otherwise, returns false without holding
+   any of them. */
+static bool
+lock_pages (struct frame *f)
+{
+  struct list_elem *e, *e2;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      if (!lock_try_acquire (&p->lock))
+        {
+          for (e2 = list_begin (&f->pages); e2 != e; e2 = list_next (e2))
+            lock_release (&list_entry (e2, struct page, frame_elem)->lock);
+          return false;
+        }
+    }
+  return true;
+}
+
+/* Returns true if OWNER has as many pages in frames as its
+   process's LIMIT_FRAMES allows.  The frame lock must be
+   held. */
+static bool
+over_limit (struct thread *owner)
+{
+  unsigned limit;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  if (owner->limits == NULL)
+    return false;
+  limit = owner->limits->max[LIMIT_FRAMES];
+  return limit != 0 && owner->resident_cnt >= limit;
+}
+
+/* Returns true if F holds pages and all of them are OWNER's.
+   The frame lock must be held. */
+static bool
+owned_by (struct frame *f, struct thread *owner)
+{
+  struct list_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  if (list_empty (&f->pages))
+    return false;
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    if (list_entry (e, struct page, frame_elem)->owner != owner)
+      return false;
+  return true;
+}
+
+/* Adds DELTA to the number of pages of PAGE's owner in frames,
+   and records a new peak in the owner's accounting. */
+static void
+charge (struct page *page, int delta)
+{
+  struct thread *t = page->owner;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  t->resident_cnt += delta;
+  if (t->acct != NULL && t->resident_cnt > t->acct->max_resident)
+    t->acct->max_resident = t->resident_cnt;
+}
+
+/* Returns a hash value for the shared frame that E is in. */
+static unsigned
+share_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct frame *f = hash_entry (e, struct frame, share_elem);
+  return hash_int ((uintptr_t) f->inode ^ f->ofs);
+}
+
+/* Returns true if the shared frame that A is in precedes the one
+   that B is in. */
+static bool
+share_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct frame *a = hash_entry (a_, struct frame, share_elem);
+  const struct frame *b = hash_entry (b_, struct frame, share_elem);
+
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  if (a->ofs != b->ofs)
+    return a->ofs < b->ofs;
+  return a->bytes < b->bytes;
+}
+
+/* Returns the hash of merged frame E's contents. */
+static unsigned
+merge_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_entry (e, struct frame, merge_elem)->merge_sum;
+}
+
+/* Orders merged frames by their contents. */
+static bool
+merge_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct frame *a = hash_entry (a_, struct frame, merge_elem);
+  const struct frame *b = hash_entry (b_, struct frame, merge_elem);
+
+  return memcmp (a->kpage, b->kpage, PGSIZE) < 0;
+}
@@ -0,0 +1,72 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+#include "threads/palloc.h"
+
+struct inode;
+struct page;
+struct vm_stats;
+
+/* A frame of physical memory holding user pages.
+
+   A private frame holds a single page, or the copy-on-write
+   pages that fork() left in it for a parent and its children.
+   A shared frame holds a page read from INODE, either of an
+   executable's text or of a memory-mapped file that nobody has
+   written since, and may be mapped by any number of pages of
+   different processes; it stays cached after its last page goes
+   away, for the next process that runs the same executable,
+   until it is evicted.  A frame of a shared memory segment holds
+   a writable page of each process that maps the segment, and
+   the segment keeps it pinned. */
+struct frame
+  {
+    void *kpage;                /* Kernel virtual address of frame. */
+    struct list pages;          /* Pages mapped to it. */
+    unsigned pin_cnt;           /* Not to be evicted while nonzero. */
+    uint8_t age;                /* Access history, for aging policy. */
+    struct list_elem elem;      /* Element in frame table. */
+
+    /* Shared frames only. */
+    struct inode *inode;        /* Inode read from, or null if private. */
+    off_t ofs;                  /* Offset in INODE. */
+    size_t bytes;               /* Bytes read; the rest are zeros. */
+    unsigned version;           /* INODE's version when read. */
+    bool cached;                /* In the table of shared frames? */
+    struct hash_elem share_elem; /* Element in table of shared frames. */
+
+    /* Same-page merging. */
+    unsigned merge_sum;         /* Hash of contents at the last look. */
+    bool merged;                /* In the table of merged frames? */
+    struct hash_elem merge_elem; /* Element in table of merged frames. */
+  };
+
+/* Eviction policy name, from the "-evict" option. */
+extern const char *frame_evict_policy;
+
+/* Merge identical pages?  Set by the "-merge" option. */
+extern bool frame_merge;
+
+void frame_init (void);
+struct frame *frame_alloc (struct page *, enum palloc_flags);
+struct frame *frame_alloc_at (struct page *, enum palloc_flags, void *want);
+struct frame *frame_try_alloc (struct page *);
+struct frame *frame_share_get (struct page *, struct inode *, off_t ofs,
+                               size_t bytes);
+void frame_share_add (struct frame *, struct inode *, off_t ofs,
+                      size_t bytes, unsigned version);
+bool frame_share_preload (struct inode *, off_t ofs, size_t bytes);
+void frame_add_page (struct frame *, struct page *);
+bool frame_unshare (struct page *);
+void frame_remove (struct page *);
+void frame_pin (struct frame *);
+void frame_unpin (struct frame *);
+void frame_get_stats (struct vm_stats *);
+void frame_print_stats (void);
+
+#endif /* vm/frame.h */
@@ -0,0 +1,291 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <round.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+#include "vm/shm.h"
+
+/* Memory-mapped files.
+
+   A mapping adds one page to the supplemental page table for
+   each page of the file.  Nothing is read until a page is
+   touched, and a page that was written to is written back to
+   the file, not to swap, when it is evicted or unmapped.
+
+   The buffer cache holds single sectors, not page-aligned
+   pages, so a mapped page is filled by copying from the cache
+   into a frame.  A page that is read before it is written maps
+   a frame from the frame table's table of shared frames, by
+   inode and offset, copy-on-write, so that every mapping of the
+   same part of a file, and the executable that the file may
+   be, uses the same frame until one of them writes to it.
+
+   A mapping of a shared memory segment maps the segment's own
+   frames as soon as it is made, and keeps them mapped until it
+   is unmapped.  fork() gives the child the parent's mappings of
+   segments, with the same identifiers, though not its mappings
+   of files. */
+
+static struct mapping *mapping_lookup (mapid_t);
+static bool mapping_check (void *addr, size_t page_cnt);
+static bool mapping_add_shared (struct mapping *);
+static void mapping_destroy (struct mapping *);
+
+/* Maps FILE into the running thread's address space starting at
+   ADDR, which must be page-aligned and nonnull.  The mapping
+   uses its own reopened copy of FILE, so FILE may be closed
+   afterward.  Returns the new mapping's identifier, or
+   MAP_FAILED if FILE is empty, the mapping would overlap pages
+   already in the address space or the region reserved for the
+   stack, or leave user memory, or memory is not available. */
+mapid_t
+mmap_map (struct file *file, void *addr)
+{
+  struct thread *t = thread_process ();
+  struct mapping *m;
+  off_t length = file_length (file);
+  size_t i;
+
+  if (addr == NULL || pg_ofs (addr) != 0 || length == 0)
+    return MAP_FAILED;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return MAP_FAILED;
+  m->base = addr;
+  m->page_cnt = DIV_ROUND_UP (length, PGSIZE);
+  m->shm = NULL;
+
+  /* Check the whole range before adding any page, so that a
+     failure doesn't leave a partial mapping behind.  Hold the
+     lock throughout, so that another thread of the process
+     can't map the same range in between. */
+  lock_acquire (&t->mappings_lock);
+  if (!mapping_check (addr, m->page_cnt))
+    goto fail;
+
+  m->file = file_reopen (file);
+  if (m->file == NULL)
+    goto fail;
+  for (i = 0; i < m->page_cnt; i++)
+    {
+      off_t ofs = i * PGSIZE;
+      size_t bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+
+      if (!page_add_file ((uint8_t *) addr + i * PGSIZE, m->file, ofs,
+                          bytes, true, true))
+        {
+          m->page_cnt = i;
+          mapping_destroy (m);
+          lock_release (&t->mappings_lock);
+          return MAP_FAILED;
+        }
+    }
+
+  m->id = t->next_mapid++;
+  list_push_back (&t->mappings, &m->elem);
+  lock_release (&t->mappings_lock);
+  return m->id;
+
+ fail:
+  lock_release (&t->mappings_lock);
+  free (m);
+  return MAP_FAILED;
+}
+
+/* Maps the shared memory segment named NAME into the running
+   thread's address space starting at ADDR, which must be
+   page-aligned and nonnull, creating the segment with SIZE bytes
+   of zeros if it does not exist.  If NAME is null, the segment
+   is a new one that only this process and its children by
+   fork() can map.  Maps the whole segment, or as much of it as
+   SIZE covers if the segment already exists.  Returns the new
+   mapping's identifier, or MAP_FAILED if SIZE is 0 or larger
+   than the existing segment, or on the same errors as
+   mmap_map(). */
+mapid_t
+mmap_shm (const char *name, size_t size, void *addr)
+{
+  struct thread *t = thread_process ();
+  struct mapping *m;
+
+  if (addr == NULL || pg_ofs (addr) != 0 || size == 0
+      || size > SHM_PAGES_MAX * PGSIZE)
+    return MAP_FAILED;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return MAP_FAILED;
+  m->file = NULL;
+  m->base = addr;
+  m->page_cnt = DIV_ROUND_UP (size, PGSIZE);
+
+  lock_acquire (&t->mappings_lock);
+  if (!mapping_check (addr, m->page_cnt))
+    {
+      lock_release (&t->mappings_lock);
+      free (m);
+      return MAP_FAILED;
+    }
+  m->shm = shm_open (name, m->page_cnt);
+  if (m->shm == NULL)
+    {
+      lock_release (&t->mappings_lock);
+      free (m);
+      return MAP_FAILED;
+    }
+  if (!mapping_add_shared (m))
+    {
+      lock_release (&t->mappings_lock);
+      return MAP_FAILED;
+    }
+
+  m->id = t->next_mapid++;
+  list_push_back (&t->mappings, &m->elem);
+  lock_release (&t->mappings_lock);
+  return m->id;
+}
+
+/* Gives the running thread, a new child of PARENT by fork(), a
+   copy of each of PARENT's mappings of shared memory, at the
+   same address and with the same identifier.  Returns false if
+   memory is not available. */
+bool
+mmap_copy_shared (struct thread *parent)
+{
+  struct thread *t = thread_current ();
+  struct list_elem *e;
+
+  t->next_mapid = parent->next_mapid;
+  for (e = list_begin (&parent->mappings); e != list_end (&parent->mappings);
+       e = list_next (e))
+    {
+      struct mapping *pm = list_entry (e, struct mapping, elem);
+      struct mapping *m;
+
+      if (pm->shm == NULL)
+        continue;
+      m = malloc (sizeof *m);
+      if (m == NULL)
+        return false;
+      *m = *pm;
+      shm_reopen (m->shm);
+      if (!mapping_add_shared (m))
+        return false;
+      list_push_back (&t->mappings, &m->elem);
+    }
+  return true;
+}
+
+/* Unmaps mapping ID of the running thread, writing its modified
+   pages back to the file.  Returns false if there is no such
+   mapping. */
+bool
+mmap_unmap (mapid_t id)
+{
+  struct lock *lock = &thread_process ()->mappings_lock;
+  struct mapping *m;
+
+  lock_acquire (lock);
+  m = mapping_lookup (id);
+  if (m != NULL)
+    {
+      list_remove (&m->elem);
+      mapping_destroy (m);
+    }
+  lock_release (lock);
+  return m != NULL;
+}
+
+/* Unmaps all of the running thread's mappings, as at process
+   exit. */
+void
+mmap_unmap_all (void)
+{
+  struct list *mappings = &thread_process ()->mappings;
+
+  while (!list_empty (mappings))
+    {
+      struct list_elem *e = list_pop_front (mappings);
+      mapping_destroy (list_entry (e, struct mapping, elem));
+    }
+}
+
+/* Returns the running thread's mapping ID, or a null pointer if
+   there is none. */
+static struct mapping *
+mapping_lookup (mapid_t id)
+{
+  struct list *mappings = &thread_process ()->mappings;
+  struct list_elem *e;
+
+  for (e = list_begin (mappings); e != list_end (mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->id == id)
+        return m;
+    }
+  return NULL;
+}
+
+/* Returns true if the PAGE_CNT pages starting at ADDR are all
+   in user memory, outside the region reserved for the stack, and
+   not in the running thread's address space yet. */
+static bool
+mapping_check (void *addr, size_t page_cnt)
+{
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++)
+    {
+      uint8_t *upage = (uint8_t *) addr + i * PGSIZE;
+      if (!is_user_vaddr (upage) || upage < (uint8_t *) addr
+          || page_is_stack (upage) || page_lookup (upage) != NULL)
+        return false;
+    }
+  return true;
+}
+
+/* Maps the first M->PAGE_CNT frames of M's segment at M->BASE
+   in the running thread's address space.  If this fails,
+   destroys M and returns false. */
+static bool
+mapping_add_shared (struct mapping *m)
+{
+  size_t i;
+
+  for (i = 0; i < m->page_cnt; i++)
+    if (!page_add_shared ((uint8_t *) m->base + i * PGSIZE,
+                          m->shm->frames[i]))
+      {
+        m->page_cnt = i;
+        mapping_destroy (m);
+        return false;
+      }
+  return true;
+}
+
+/* Removes M's pages from the address space, writing modified
+   ones back, then closes its file or segment and frees M.  M
+   must not be in a list. */
+static void
+mapping_destroy (struct mapping *m)
+{
+  size_t i;
+
+  /* Unmap the whole range first, so that the TLB is invalidated
+     once rather than page by page. */
+  pagedir_clear_pages (thread_current ()->pagedir, m->base, m->page_cnt);
+  for (i = 0; i < m->page_cnt; i++)
+    page_remove ((uint8_t *) m->base + i * PGSIZE);
+  if (m->shm != NULL)
+    shm_close (m->shm);
+  else
+    file_close (m->file);
+  free (m);
+}
@@ -0,0 +1,33 @@
+#ifndef VM_MMAP_H
+#define VM_MMAP_H
+
+#include <list.h>
+#include <stddef.h>
+
+struct file;
+struct shm;
+struct thread;
+
+/* Map region identifier. */
+typedef int mapid_t;
+#define MAP_FAILED ((mapid_t) -1)
+
+/* A file or shared memory segment mapped into a process's
+   address space. */
+struct mapping
+  {
+    struct list_elem elem;      /* Element in thread's MAPPINGS. */
+    mapid_t id;                 /* Mapping identifier. */
+    struct file *file;          /* File, reopened just for this mapping. */
+    struct shm *shm;            /* Or the segment, if FILE is null. */
+    void *base;                 /* First mapped page. */
+    size_t page_cnt;            /* Number of mapped pages. */
+  };
+
+mapid_t mmap_map (struct file *, void *addr);
+mapid_t mmap_shm (const char *name, size_t size, void *addr);
+bool mmap_copy_shared (struct thread *parent);
+bool mmap_unmap (mapid_t);
+void mmap_unmap_all (void);
+
+#endif /* vm/mmap.h */
@@ -0,0 +1,1048 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <vdata.h>
+#include <vm-stats.h>
+#include "devices/block.h"
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/kmem.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "vm/frame.h"
+#include "vm/shm.h"
+#include "vm/swap.h"
+
+/* Supplemental page table.
+
+   Each process has a hash table of the pages in its address
+   space, keyed by user virtual address.  load() records each
+   page of the executable here instead of reading it in, and
+   page_fault() calls page_in() to bring a page into a frame the
+   first time it is touched.
+
+   When frames run short, the frame table calls page_out() to
+   take frames away from a batch of pages.  Pages that were
+   written to go to swap, in a run of consecutive slots ordered
+   by user address; clean pages are simply dropped, to be read
+   from their file or zeroed again the next time they are
+   touched.  Swapping a page back in also reads in the pages of
+   the same process in the slots that follow, as long as free
+   frames are at hand, since they were likely evicted along with
+   it and will likely be needed along with it.
+
+   Faults on pages of a file work the same way once a process
+   shows that it runs or reads through the file in order: each
+   fault also maps the following pages of the same file, as long
+   as each is already in a shared frame or free frames are at
+   hand to read it into (see fault_around()).
+
+   fork() copies a page table by sharing the parent's frames and
+   swap slots with the child.  A writable page in a shared frame
+   is copy-on-write: both processes map it read-only, and the
+   first write to it faults and calls page_unshare() to give the
+   writer a copy.  Swapping a shared page back in gives each
+   process its own frame, so sharing ends there as well.
+
+   An anonymous page that is first touched by a read, rather than
+   a write, is mapped read-only to a single page of zeros shared
+   by every process, which is in no frame and is never evicted.
+   The first write to it faults and takes a zeroed frame of its
+   own, in the same way as a copy-on-write page, so memory that is
+   only read costs nothing until it is written.
+
+   An anonymous page is given the frame, if it is free, that
+   lines it up with the frames of the pages around it in a
+   PTSPAN-aligned region of physically contiguous frames, or
+   failing those, with a free run of such frames.  Once every
+   page of a region is mapped in line, pagedir_promote() maps the
+   region as a single large page; unmapping or evicting any page
+   of it splits it again. */
+
+/* Most pages read from swap at once, including the one that
+   faulted. */
+#define SWAP_READAHEAD 4
+
+/* Most pages of a file mapped after the one that faulted.  A
+   process starts out mapping none, and doubles its window each
+   time it faults on the page just past the last window, up to
+   this many. */
+#define FAULT_AROUND_MAX 8
+
+/* Largest size of a user stack, in bytes.  Pages within this
+   distance of PHYS_BASE are added to the address space when
+   first touched near the stack pointer. */
+size_t page_stack_limit = 8 * 1024 * 1024;
+
+/* How far below the stack pointer an access may be and still
+   grow the stack.  PUSHA checks its 32 bytes before moving the
+   stack pointer. */
+#define STACK_SLOP 32
+
+/* Cache of struct page objects. */
+static struct kmem_cache page_cache;
+
+/* The page of zeros that anonymous pages are mapped to until
+   they are first written. */
+static void *zero_kpage;
+
+/* Statistics.  Like the page fault count in exception.c, these
+   are updated without locking, so they may miss a few events. */
+static uint64_t file_cnt;       /* Pages read in from a file. */
+static uint64_t zero_cnt;       /* Pages zero-filled. */
+static uint64_t swap_cnt;       /* Pages read in from swap. */
+static uint64_t stack_cnt;      /* Pages added by stack growth. */
+static uint64_t cow_cnt;        /* Copy-on-write pages written. */
+static uint64_t around_cnt;     /* Pages mapped around a fault. */
+static uint64_t zero_map_cnt;   /* Pages mapped to the zero frame. */
+static size_t max_resident_cnt; /* Largest resident set at exit... */
+static char max_resident_name[16]; /* ...and the process it was in. */
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static void page_ctor (void *);
+static void page_destroy (struct hash_elem *, void *aux);
+static void page_write_back (struct page *, uint32_t *pd);
+static struct page *page_add (void *upage, bool writable);
+static bool page_load (struct page *, bool pin, bool ahead, bool write);
+static bool page_map_zero (struct page *);
+static void *large_frame (struct page *);
+static void fault_around (struct page *);
+static bool page_unshare_locked (struct page *);
+static void page_drop_frame (struct frame *);
+static struct page *stack_grow (const void *addr);
+static void swap_in_run (struct page *, struct frame *);
+static void count_pages (struct thread *, size_t *page_cnt,
+                         size_t *resident_cnt);
+
+/* Initializes the supplemental page table module. */
+void
+page_init (void)
+{
+  kmem_cache_init (&page_cache, "page", sizeof (struct page), page_ctor);
+  zero_kpage = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  frame_init ();
+  shm_init ();
+}
+
+/* Initializes the running thread's supplemental page table.
+   Returns false if memory is not available. */
+bool
+page_table_init (void)
+{
+  return hash_init (&thread_current ()->pages, page_hash, page_less, NULL);
+}
+
+/* Copies the address space of PARENT, which must be waiting for
+   the copy to finish, into the running thread's, which must be
+   empty, for fork().  Resident pages share their frames with
+   PARENT, writable ones copy-on-write, and pages in swap share
+   their slots.  Pages of the executable are read from the
+   running thread's own EXECUTABLE.  Memory-mapped files and
+   shared memory are not copied here.  Returns false if memory is not available, in which
+   case the running thread's table holds whatever was copied. */
+bool
+page_table_copy (struct thread *parent)
+{
+  struct thread *t = thread_current ();
+  struct hash_iterator i;
+
+  hash_first (&i, &parent->pages);
+  while (hash_next (&i))
+    {
+      struct page *p = hash_entry (hash_cur (&i), struct page, elem);
+      struct page *q;
+      bool success = true;
+
+      if (p->write_back || p->shared)
+        continue;
+      q = page_add (p->upage, p->writable);
+      if (q == NULL)
+        return false;
+      q->file = p->file != NULL ? t->proc->executable : NULL;
+      q->file_ofs = p->file_ofs;
+      q->file_bytes = p->file_bytes;
+
+      lock_acquire (&p->lock);
+      if (p->frame != NULL)
+        {
+          /* The frame is dirty as long as either mapping says so,
+             since the parent may take a copy and leave the frame
+             to the child. */
+          success = pagedir_set_page (t->pagedir, q->upage,
+                                      p->frame->kpage, false);
+          if (success)
+            {
+              if (pagedir_is_dirty (parent->pagedir, p->upage))
+                pagedir_set_dirty (t->pagedir, q->upage, true);
+              frame_add_page (p->frame, q);
+              if (p->writable)
+                {
+                  pagedir_set_writable (parent->pagedir, p->upage, false);
+                  p->cow = q->cow = true;
+                }
+            }
+        }
+      else if (p->swap_slot != SWAP_NONE)
+        {
+          swap_share (p->swap_slot);
+          q->swap_slot = p->swap_slot;
+        }
+      lock_release (&p->lock);
+      if (!success)
+        return false;
+    }
+  return true;
+}
+
+/* Destroys the running thread's supplemental page table,
+   freeing the frames and swap slots of its pages and removing
+   them from the page directory. */
+void
+page_table_destroy (void)
+{
+  struct thread *t = thread_current ();
+  size_t page_cnt, resident_cnt;
+
+  count_pages (t, &page_cnt, &resident_cnt);
+  if (resident_cnt > max_resident_cnt)
+    {
+      max_resident_cnt = resident_cnt;
+      strlcpy (max_resident_name, t->name, sizeof max_resident_name);
+    }
+  hash_destroy (&t->pages, page_destroy);
+}
+
+/* Fills in the counts of pages brought in on demand in STATS,
+   along with the size of the running thread's address space and
+   resident set. */
+void
+page_get_stats (struct vm_stats *stats)
+{
+  size_t page_cnt = 0, resident_cnt = 0;
+
+  stats->file_cnt = file_cnt;
+  stats->zero_cnt = zero_cnt;
+  stats->swap_cnt = swap_cnt;
+  stats->stack_cnt = stack_cnt;
+  stats->cow_cnt = cow_cnt;
+  stats->around_cnt = around_cnt;
+  if (thread_current ()->pagedir != NULL)
+    count_pages (thread_process (), &page_cnt, &resident_cnt);
+  stats->page_cnt = page_cnt;
+  stats->resident_cnt = resident_cnt;
+}
+
+/* Prints statistics on pages brought in on demand. */
+void
+page_print_stats (void)
+{
+  printf ("Paging: %"PRIu64" from files, %"PRIu64" zero-filled, "
+          "%"PRIu64" from swap, %"PRIu64" stack growth, "
+          "%"PRIu64" copy-on-write, %"PRIu64" mapped around faults, "
+          "%"PRIu64" mapped to the zero page\n",
+          file_cnt, zero_cnt, swap_cnt, stack_cnt, cow_cnt, around_cnt,
+          zero_map_cnt);
+  if (max_resident_cnt > 0)
+    printf ("Paging: largest resident set at exit %zu pages (%s)\n",
+            max_resident_cnt, max_resident_name);
+}
+
+/* Adds UPAGE to the running thread's address space, to be read
+   from FILE_BYTES bytes of FILE at OFS and padded with zeros
+   when first touched.  If WRITE_BACK is true, modifications to
+   those bytes are written back to FILE.  Returns false if UPAGE
+   is already in the address space or memory is not
+   available. */
+bool
+page_add_file (void *upage, struct file *file, off_t ofs,
+               size_t file_bytes, bool writable, bool write_back)
+{
+  struct page *p;
+
+  ASSERT (file_bytes <= PGSIZE);
+
+  p = page_add (upage, writable);
+  if (p == NULL)
+    return false;
+  p->file = file;
+  p->file_ofs = ofs;
+  p->file_bytes = file_bytes;
+  p->write_back = write_back;
+  return true;
+}
+
+/* Adds UPAGE to the running thread's address space, to be
+   filled with zeros when first touched.  Returns false if UPAGE
+   is already in the address space or memory is not
+   available. */
+bool
+page_add_zero (void *upage, bool writable)
+{
+  return page_add (upage, writable) != NULL;
+}
+
+/* Adds UPAGE to the running thread's address space, writable
+   and mapped at once to F, a frame of a shared memory segment,
+   which keeps F pinned for as long as UPAGE can be in it.
+   Returns false if UPAGE is already in the address space or
+   memory is not available. */
+bool
+page_add_shared (void *upage, struct frame *f)
+{
+  struct page *p = page_add (upage, true);
+  bool success;
+
+  if (p == NULL)
+    return false;
+  p->shared = true;
+
+  /* F can't be evicted, so there is no lock of another page of
+     F to hold for frame_add_page(). */
+  lock_acquire (&p->lock);
+  frame_add_page (f, p);
+  success = pagedir_set_page (thread_current ()->pagedir, upage, f->kpage,
+                              true);
+  lock_release (&p->lock);
+  if (!success)
+    page_remove (upage);
+  return success;
+}
+
+/* Returns the page containing ADDR in the running thread's
+   address space, or a null pointer if there is none. */
+struct page *
+page_lookup (const void *addr)
+{
+  struct thread *t = thread_process ();
+  struct page key;
+  struct hash_elem *e;
+
+  if (t->pagedir == NULL || !is_user_vaddr (addr))
+    return NULL;
+  key.upage = pg_round_down (addr);
+  lock_acquire (&t->pages_lock);
+  e = hash_find (&t->pages, &key.elem);
+  lock_release (&t->pages_lock);
+  return e != NULL ? hash_entry (e, struct page, elem) : NULL;
+}
+
+/* Removes UPAGE from the running thread's address space,
+   writing it back to its file first if it is a modified page of
+   a memory-mapped file.  Does nothing if UPAGE is not in the
+   address space. */
+void
+page_remove (void *upage)
+{
+  struct thread *t = thread_process ();
+  struct page *p = page_lookup (upage);
+
+  if (p != NULL)
+    {
+      lock_acquire (&t->pages_lock);
+      hash_delete (&t->pages, &p->elem);
+      lock_release (&t->pages_lock);
+      page_destroy (&p->elem, NULL);
+    }
+}
+
+/* Brings the page containing ADDR into a frame and maps it, if
+   it isn't resident already, for a read or, if WRITE is true, a
+   write.  A read of a page that would be zero-filled maps the
+   zero frame instead.  Returns true if successful, false if ADDR
+   isn't in the running thread's address space or memory or a
+   disk read fails. */
+bool
+page_in (const void *addr, bool write)
+{
+  struct page *p = page_lookup (addr);
+  if (p == NULL)
+    p = stack_grow (addr);
+  if (p == NULL)
+    return false;
+  if (!write && page_map_zero (p))
+    return true;
+  if (!page_load (p, false, false, write))
+    return false;
+  if (p->file != NULL)
+    fault_around (p);
+  return true;
+}
+
+/* Takes the CNT frames in FRAMES away from their pages, saving
+   the contents of each frame that was modified to swap, or to
+   its file for a memory-mapped page, and unmaps the pages from
+   their owners' page directories.  The caller must hold the
+   lock of each page in each frame.
+   A frame that needs to go to swap when no swap slot is free is
+   left as it was, with its pages; the pages of the others have a
+   null FRAME on return, but are still in the frames' PAGES
+   lists. */
+void
+page_out (struct frame *frames[], size_t cnt)
+{
+  struct frame *dirty[PAGE_OUT_MAX];
+  struct block_request reqs[PAGE_OUT_MAX];
+  bool submitted[PAGE_OUT_MAX];
+  size_t dirty_cnt = 0;
+  size_t run, i;
+  struct list_elem *e;
+
+  ASSERT (cnt <= PAGE_OUT_MAX);
+
+  /* Unmap each page first, so that its owner can't modify it
+     between checking the dirty bit and saving it.  A frame
+     shared since fork() is dirty if any of its pages is. */
+  for (i = 0; i < cnt; i++)
+    {
+      struct frame *f = frames[i];
+      struct page *p = list_entry (list_front (&f->pages),
+                                   struct page, frame_elem);
+      bool is_dirty = false;
+
+      for (e = list_begin (&f->pages); e != list_end (&f->pages);
+           e = list_next (e))
+        {
+          struct page *q = list_entry (e, struct page, frame_elem);
+          uint32_t *pd = q->owner->pagedir;
+
+          ASSERT (lock_held_by_current_thread (&q->lock));
+          ASSERT (!q->pinned);
+          pagedir_clear_page (pd, q->upage);
+          if (pagedir_is_dirty (pd, q->upage))
+            is_dirty = true;
+        }
+
+      if (p->write_back)
+        {
+          page_write_back (p, p->owner->pagedir);
+          page_drop_frame (f);
+        }
+      else if (is_dirty)
+        {
+          /* Insertion sort by owner, then user address, so that
+             neighboring pages land in neighboring slots. */
+          size_t j;
+          for (j = dirty_cnt++; j > 0; j--)
+            {
+              struct page *q = list_entry (list_front (&dirty[j - 1]->pages),
+                                           struct page, frame_elem);
+              if (q->owner < p->owner
+                  || (q->owner == p->owner && q->upage < p->upage))
+                break;
+              dirty[j] = dirty[j - 1];
+            }
+          dirty[j] = f;
+        }
+      else
+        page_drop_frame (f);
+    }
+  if (dirty_cnt == 0)
+    return;
+
+  /* Write the dirty frames to a run of slots if there is one, or
+     else to whatever single slots are free.  Every page in a
+     frame refers to its slot. */
+  run = swap_alloc (dirty_cnt);
+  for (i = 0; i < dirty_cnt; i++)
+    {
+      struct frame *f = dirty[i];
+      size_t slot = run != SWAP_NONE ? run + i : swap_alloc (1);
+
+      submitted[i] = slot != SWAP_NONE;
+      for (e = list_begin (&f->pages); e != list_end (&f->pages);
+           e = list_next (e))
+        {
+          struct page *p = list_entry (e, struct page, frame_elem);
+          uint32_t *pd = p->owner->pagedir;
+
+          if (!submitted[i])
+            {
+              pagedir_set_page (pd, p->upage, f->kpage,
+                                p->writable && !p->cow);
+              pagedir_set_dirty (pd, p->upage, true);
+            }
+          else if (e == list_begin (&f->pages))
+            {
+              p->swap_slot = slot;
+              swap_set_page (slot, p->owner, p);
+            }
+          else
+            {
+              p->swap_slot = slot;
+              swap_share (slot);
+            }
+        }
+      if (submitted[i])
+        swap_submit (slot, f->kpage, true, &reqs[i]);
+    }
+  for (i = 0; i < dirty_cnt; i++)
+    if (submitted[i])
+      {
+        swap_wait (&reqs[i]);
+        page_drop_frame (dirty[i]);
+      }
+}
+
+/* Brings in and pins every page of the SIZE bytes at ADDR, so
+   that the kernel can access them without faulting, for example
+   while holding a file system lock.  If WRITE is true, the pages
+   must also be writable.  Returns false, with none of the pages
+   pinned, if any page isn't in the running thread's address
+   space or can't be brought in. */
+bool
+page_pin (const void *addr, size_t size, bool write)
+{
+  const uint8_t *upage;
+  const uint8_t *end = (const uint8_t *) addr + size;
+
+  if (size == 0)
+    return true;
+  if (end < (const uint8_t *) addr || !is_user_vaddr (end - 1))
+    return false;
+
+  for (upage = pg_round_down (addr); upage < end; )
+    {
+      struct page *p = page_lookup (upage);
+      if (p == NULL)
+        p = stack_grow (upage < (const uint8_t *) addr ? addr : upage);
+      if (p == NULL || (write && !p->writable)
+          || (write && !page_unshare_locked (p))
+          || !page_load (p, true, false, write))
+        {
+          if (upage > (const uint8_t *) addr)
+            page_unpin (addr, upage - (const uint8_t *) addr);
+          return false;
+        }
+
+      /* The frame merging thread may have made P copy-on-write
+         again between unsharing and pinning it.  Once it is
+         pinned, that cannot happen, so try once more. */
+      if (write && p->cow)
+        {
+          page_unpin (upage, 1);
+          continue;
+        }
+      upage += PGSIZE;
+    }
+  return true;
+}
+
+/* Unpins the pages of the SIZE bytes at ADDR that page_pin()
+   pinned. */
+void
+page_unpin (const void *addr, size_t size)
+{
+  const uint8_t *upage;
+  const uint8_t *end = (const uint8_t *) addr + size;
+
+  if (size == 0 || end < (const uint8_t *) addr || !is_user_vaddr (end - 1))
+    return;
+
+  for (upage = pg_round_down (addr); upage < end; upage += PGSIZE)
+    {
+      struct page *p = page_lookup (upage);
+      if (p != NULL)
+        {
+          lock_acquire (&p->lock);
+          if (p->pinned)
+            {
+              p->pinned = false;
+              frame_unpin (p->frame);
+            }
+          lock_release (&p->lock);
+        }
+    }
+}
+
+/* Gives the copy-on-write page containing ADDR, which the
+   running thread tried to write, a frame of its own and maps it
+   writable.  Returns true if the write can be retried, false if
+   ADDR is not in a writable page or no frame is available. */
+bool
+page_unshare (const void *addr)
+{
+  struct page *p = page_lookup (addr);
+  return p != NULL && p->writable && page_unshare_locked (p);
+}
+
+/* Does the work of page_unshare() for P, if it is a
+   copy-on-write page, taking its lock.  Returns false if no frame
+   is available. */
+static bool
+page_unshare_locked (struct page *p)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  bool success = true;
+
+  lock_acquire (&p->lock);
+  if (p->zero_mapped)
+    {
+      /* page_load() replaces the zero frame with one of its own. */
+      lock_release (&p->lock);
+      return page_load (p, false, false, true);
+    }
+  if (p->cow)
+    {
+      ASSERT (!p->pinned);
+      success = frame_unshare (p);
+      if (success)
+        {
+          /* The frame's contents are saved nowhere else. */
+          cow_cnt++;
+          p->cow = false;
+          pagedir_clear_page (pd, p->upage);
+          pagedir_set_page (pd, p->upage, p->frame->kpage, true);
+          pagedir_set_dirty (pd, p->upage, true);
+        }
+    }
+  lock_release (&p->lock);
+  return success;
+}
+
+/* Brings P into a frame and maps it, if it isn't resident
+   already, and pins the frame if PIN is true.  A read-only page
+   of a file maps a frame shared with other processes, if there
+   is one, and so does a page of a memory-mapped file that is
+   being brought in for reading, WRITE false, copy-on-write.  If
+   AHEAD is true, P is only being brought in because
+   it is likely to be used soon, so P's lock is not waited for
+   and only a free frame is used.  Returns true if successful,
+   false if memory or a disk read fails. */
+static bool
+page_load (struct page *p, bool pin, bool ahead, bool write)
+{
+  struct thread *t = thread_current ();
+  struct inode *inode = NULL;
+  unsigned version = 0;
+  struct frame *f;
+  bool dirty = false;
+  bool share = false;
+
+  if (!ahead)
+    lock_acquire (&p->lock);
+  else if (!lock_try_acquire (&p->lock))
+    return false;
+  if (p->frame != NULL)
+    {
+      if (pin && !p->pinned)
+        {
+          p->pinned = true;
+          frame_pin (p->frame);
+        }
+      lock_release (&p->lock);
+      return true;
+    }
+
+  /* A page that can't be written never goes to swap, so it
+     always matches its file.  Neither does a page of a mapped
+     file that has not been written since it was read. */
+  if (p->file != NULL && (!p->writable || (p->write_back && !write)))
+    {
+      share = true;
+      inode = file_get_inode (p->file);
+      version = inode_get_version (inode);
+      f = frame_share_get (p, inode, p->file_ofs, p->file_bytes);
+      if (f != NULL)
+        {
+          inode = NULL;
+          goto map;
+        }
+    }
+
+  if (ahead)
+    f = frame_try_alloc (p);
+  else
+    f = frame_alloc_at (p, (p->file == NULL && p->swap_slot == SWAP_NONE
+                            ? PAL_ZERO : 0),
+                        p->file == NULL ? large_frame (p) : NULL);
+  if (f == NULL)
+    goto fail;
+
+  if (p->swap_slot != SWAP_NONE)
+    {
+      /* The slot is freed, so the page must go back to swap the
+         next time it is evicted. */
+      swap_in_run (p, f);
+      dirty = true;
+    }
+  else if (p->file != NULL)
+    {
+      if (file_read_at (p->file, f->kpage, p->file_bytes, p->file_ofs)
+          != (off_t) p->file_bytes)
+        goto fail_free;
+      memset ((uint8_t *) f->kpage + p->file_bytes, 0,
+              PGSIZE - p->file_bytes);
+    }
+
+ map:
+  if (p->zero_mapped)
+    {
+      pagedir_clear_page (t->pagedir, p->upage);
+      p->zero_mapped = false;
+    }
+  p->cow = share && p->writable;
+  if (!pagedir_set_page (t->pagedir, p->upage, f->kpage,
+                         p->writable && !p->cow))
+    goto fail_free;
+  if (ahead)
+    around_cnt++;
+  else if (dirty)
+    swap_cnt++;
+  else if (p->file != NULL)
+    file_cnt++;
+  else
+    zero_cnt++;
+  if (dirty)
+    pagedir_set_dirty (t->pagedir, p->upage, true);
+  if (p->file == NULL)
+    pagedir_promote (t->pagedir, p->upage);
+  if (inode != NULL)
+    frame_share_add (f, inode, p->file_ofs, p->file_bytes, version);
+  if (pin)
+    p->pinned = true;
+  else
+    frame_unpin (f);
+  lock_release (&p->lock);
+  return true;
+
+ fail_free:
+  p->cow = false;
+  frame_unpin (f);
+  frame_remove (p);
+ fail:
+  lock_release (&p->lock);
+  return false;
+}
+
+/* Returns the frame that P, an anonymous page, should have for
+   the PTSPAN-aligned region of the address space that contains
+   it to become a large page: the one in line with the frames of
+   the region's pages mapped already, or if there are none, the
+   one at P's place in a free run of aligned frames.  Returns a
+   null pointer if the region cannot become a large page, because
+   the address space does not span it or its pages are mapped out
+   of line. */
+static void *
+large_frame (struct page *p)
+{
+  uint8_t *region = (uint8_t *) ((uintptr_t) p->upage & ~(PTSPAN - 1));
+  uint8_t *base;
+
+  if (page_lookup (region) == NULL
+      || page_lookup (region + PTSPAN - PGSIZE) == NULL
+      || !pagedir_large_base (thread_current ()->pagedir, p->upage,
+                              (void **) &base))
+    return NULL;
+  if (base == NULL)
+    base = palloc_find_aligned (PAL_USER, PTSPAN / PGSIZE);
+  return base != NULL ? base + ((uint8_t *) p->upage - region) : NULL;
+}
+
+/* Maps P read-only to the zero frame, if P is an anonymous page
+   that is in neither a frame nor swap, so that it would be
+   zero-filled.  Returns true if successful, false if P is some
+   other kind of page or memory is not available. */
+static bool
+page_map_zero (struct page *p)
+{
+  bool success = false;
+
+  lock_acquire (&p->lock);
+  if (p->frame == NULL && p->swap_slot == SWAP_NONE && p->file == NULL
+      && !p->shared && !p->zero_mapped)
+    {
+      success = pagedir_set_page (thread_current ()->pagedir, p->upage,
+                                  zero_kpage, false);
+      p->zero_mapped = success;
+      if (success)
+        zero_map_cnt++;
+    }
+  lock_release (&p->lock);
+  return success;
+}
+
+/* Maps the pages of P's file that follow P, which just faulted
+   in, as far as the running thread's fault window reaches, and
+   adapts the window to whether the faults are sequential.
+   Stops at the first page that is not the next part of the same
+   file or cannot be brought in cheaply.  The pages are mapped
+   without setting their accessed bits, so that the clock takes
+   them back first if they are not used. */
+static void
+fault_around (struct page *p)
+{
+  struct thread *t = thread_current ();
+  uint8_t *upage = p->upage;
+  size_t i;
+
+  if (upage == t->fault_next)
+    t->fault_window = (t->fault_window == 0 ? 1
+                       : t->fault_window * 2 < FAULT_AROUND_MAX
+                       ? t->fault_window * 2 : FAULT_AROUND_MAX);
+  else
+    t->fault_window = 0;
+
+  for (i = 0; i < t->fault_window; i++)
+    {
+      struct page *q = page_lookup (upage + PGSIZE);
+
+      if (q == NULL || q->frame != NULL || q->swap_slot != SWAP_NONE
+          || q->file != p->file || q->write_back != p->write_back
+          || q->file_ofs != p->file_ofs + (off_t) ((i + 1) * PGSIZE)
+          || !page_load (q, false, true, false))
+        break;
+      upage += PGSIZE;
+    }
+  t->fault_next = upage + PGSIZE;
+}
+
+/* Reads P, which must be in swap, into frame F and frees its
+   slot.  Reads the pages that follow P in swap and belong to the
+   running thread along with it, as many as SWAP_READAHEAD allows
+   and free frames can hold, and maps them.  The caller must hold
+   P's lock. */
+static void
+swap_in_run (struct page *p, struct frame *f)
+{
+  struct thread *t = thread_process ();
+  struct page *ra[SWAP_READAHEAD];
+  struct frame *ra_frame[SWAP_READAHEAD];
+  struct block_request reqs[SWAP_READAHEAD];
+  size_t slot = p->swap_slot;
+  size_t ra_cnt, i;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+
+  swap_submit (slot, f->kpage, false, &reqs[0]);
+  for (ra_cnt = 1; ra_cnt < SWAP_READAHEAD; ra_cnt++)
+    {
+      struct page *q = swap_get_page (slot + ra_cnt, t);
+      struct frame *qf;
+
+      if (q == NULL || !lock_try_acquire (&q->lock))
+        break;
+      if (q->frame != NULL || q->swap_slot != slot + ra_cnt
+          || (qf = frame_try_alloc (q)) == NULL)
+        {
+          lock_release (&q->lock);
+          break;
+        }
+      ra[ra_cnt] = q;
+      ra_frame[ra_cnt] = qf;
+      swap_submit (slot + ra_cnt, qf->kpage, false, &reqs[ra_cnt]);
+    }
+
+  swap_wait (&reqs[0]);
+  swap_free (slot);
+  p->swap_slot = SWAP_NONE;
+
+  /* Map the pages read ahead without setting their accessed
+     bits, so that the clock takes them back first if they are
+     not used after all. */
+  for (i = 1; i < ra_cnt; i++)
+    {
+      struct page *q = ra[i];
+
+      swap_wait (&reqs[i]);
+      frame_unpin (ra_frame[i]);
+      if (pagedir_set_page (t->pagedir, q->upage, ra_frame[i]->kpage,
+                            q->writable))
+        {
+          pagedir_set_dirty (t->pagedir, q->upage, true);
+          swap_free (q->swap_slot);
+          q->swap_slot = SWAP_NONE;
+        }
+      else
+        frame_remove (q);
+      lock_release (&q->lock);
+    }
+}
+
+/* Returns true if ADDR is in the part of user memory reserved
+   for the stack. */
+bool
+page_is_stack (const void *addr)
+{
+  return (is_user_vaddr (addr)
+          && ((const uint8_t *) addr
+              >= (uint8_t *) PHYS_BASE - page_stack_limit));
+}
+
+/* Grows the running thread's stack to cover ADDR, which is not
+   in its address space, if ADDR looks like a stack access: it
+   must be within the stack limit and no more than STACK_SLOP
+   bytes below the user stack pointer.  Returns the new page, or
+   a null pointer if ADDR is not a stack access or memory is not
+   available.  The page is zeroed when first brought in. */
+static struct page *
+stack_grow (const void *addr)
+{
+  const uint8_t *esp = thread_current ()->user_esp;
+  struct page *p;
+
+  if (esp == NULL || !page_is_stack (addr)
+      || (const uint8_t *) addr + STACK_SLOP < esp)
+    return NULL;
+  p = page_add (pg_round_down (addr), true);
+  if (p != NULL)
+    stack_cnt++;
+  return p;
+}
+
+/* Counts the pages in T's address space into *PAGE_CNT and those
+   of them that are resident into *RESIDENT_CNT.  T must be the
+   running thread's process. */
+static void
+count_pages (struct thread *t, size_t *page_cnt, size_t *resident_cnt)
+{
+  struct hash_iterator i;
+
+  lock_acquire (&t->pages_lock);
+  *page_cnt = hash_size (&t->pages);
+  *resident_cnt = 0;
+  hash_first (&i, &t->pages);
+  while (hash_next (&i))
+    if (hash_entry (hash_cur (&i), struct page, elem)->frame != NULL)
+      ++*resident_cnt;
+  lock_release (&t->pages_lock);
+}
+
+/* Creates a page for UPAGE in the running thread's address
+   space, with no contents yet.  Returns the page, or a null
+   pointer if UPAGE is already in the address space, is the
+   vdata page, or memory is not available. */
+static struct page *
+page_add (void *upage, bool writable)
+{
+  struct thread *t = thread_process ();
+  struct page *p;
+  bool dup;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  if (upage == (void *) VDATA_ADDR)
+    return NULL;
+  p = kmem_cache_alloc (&page_cache);
+  if (p == NULL)
+    return NULL;
+  p->upage = upage;
+  p->writable = writable;
+  p->owner = t;
+  p->frame = NULL;
+  p->pinned = false;
+  p->cow = false;
+  p->shared = false;
+  p->zero_mapped = false;
+  p->swap_slot = SWAP_NONE;
+  p->file = NULL;
+  p->file_ofs = 0;
+  p->file_bytes = 0;
+  p->write_back = false;
+  lock_acquire (&t->pages_lock);
+  dup = hash_insert (&t->pages, &p->elem) != NULL;
+  lock_release (&t->pages_lock);
+  if (dup)
+    {
+      kmem_cache_free (&page_cache, p);
+      return NULL;
+    }
+  return p;
+}
+
+/* Records that the pages in F, which page_out() has saved, are
+   no longer resident. */
+static void
+page_drop_frame (struct frame *f)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      p->frame = NULL;
+      p->cow = false;
+    }
+}
+
+/* Initializes the lock in a struct page when its slab is
+   created. */
+static void
+page_ctor (void *p_)
+{
+  struct page *p = p_;
+  lock_init (&p->lock);
+}
+
+/* Writes P, which must be resident and unmapped from PD, its
+   owner's page directory, back to its file if it was modified.
+   The caller must hold P's lock. */
+static void
+page_write_back (struct page *p, uint32_t *pd)
+{
+  ASSERT (p->write_back);
+
+  if (pagedir_is_dirty (pd, p->upage))
+    {
+      file_write_at (p->file, p->frame->kpage, p->file_bytes, p->file_ofs);
+      pagedir_set_dirty (pd, p->upage, false);
+    }
+}
+
+/* Frees the page that E is in, along with its frame or swap
+   slot, writing it back to its file first if it is a modified
+   page of a memory-mapped file. */
+static void
+page_destroy (struct hash_elem *e, void *aux UNUSED)
+{
+  struct page *p = hash_entry (e, struct page, elem);
+  uint32_t *pd = thread_current ()->pagedir;
+
+  /* Wait for any eviction in progress to finish. */
+  lock_acquire (&p->lock);
+  if (p->frame != NULL)
+    {
+      pagedir_clear_page (pd, p->upage);
+      if (p->write_back)
+        page_write_back (p, pd);
+      if (p->pinned)
+        {
+          p->pinned = false;
+          frame_unpin (p->frame);
+        }
+      frame_remove (p);
+    }
+  else if (p->swap_slot != SWAP_NONE)
+    swap_free (p->swap_slot);
+  else if (p->zero_mapped)
+    pagedir_clear_page (pd, p->upage);
+  lock_release (&p->lock);
+  kmem_cache_free (&page_cache, p);
+}
+
+/* Returns a hash value for the page that E is in. */
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (e, struct page, elem);
+  return hash_int ((uintptr_t) p->upage);
+}
+
+/* Returns true if the page that A is in precedes the page that
+   B is in. */
+static bool
+page_less (const struct hash_elem *a, const struct hash_elem *b,
+           void *aux UNUSED)
+{
+  const struct page *pa = hash_entry (a, struct page, elem);
+  const struct page *pb = hash_entry (b, struct page, elem);
+  return pa->upage < pb->upage;
+}
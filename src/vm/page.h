@@ -0,0 +1,75 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+
+struct file;
+struct frame;
+struct thread;
+struct vm_stats;
+
+/* A page of a process's virtual address space, as recorded in
+   the process's supplemental page table.  Describes where the
+   page's contents come from when it is not resident. */
+struct page
+  {
+    struct hash_elem elem;      /* Element in thread's page table. */
+    void *upage;                /* User virtual address. */
+    bool writable;              /* Mapped writable? */
+    struct thread *owner;       /* Thread whose address space it is in. */
+    struct lock lock;           /* Held while paging in or out. */
+    struct frame *frame;        /* Frame holding the page, or null. */
+    struct list_elem frame_elem; /* Element in frame's PAGES. */
+    bool pinned;                /* Pinned by page_pin()? */
+    bool cow;                   /* Sharing its frame since fork()? */
+    bool shared;                /* In a shared memory segment? */
+    bool zero_mapped;           /* Mapped read-only to the zero frame? */
+    size_t swap_slot;           /* Swap slot holding it, or SWAP_NONE. */
+
+    /* Where the page's contents come from if it is in neither a
+       frame nor swap.  FILE_BYTES bytes are read from FILE at
+       FILE_OFS, and the rest of the page is zeroed.  FILE is
+       null for an all-zero page.  If WRITE_BACK is true, the
+       page belongs to a memory-mapped file, and modifications are
+       written back to FILE instead of going to swap. */
+    struct file *file;
+    off_t file_ofs;
+    size_t file_bytes;
+    bool write_back;
+  };
+
+/* Most pages page_out() takes at once, in all its frames.  Eight
+   pages of swap are as many sectors as the block layer merges
+   into one transfer. */
+#define PAGE_OUT_MAX 8
+
+/* Largest size of a user stack, in bytes. */
+extern size_t page_stack_limit;
+
+void page_init (void);
+bool page_table_init (void);
+bool page_table_copy (struct thread *parent);
+void page_table_destroy (void);
+
+bool page_add_file (void *upage, struct file *, off_t ofs,
+                    size_t file_bytes, bool writable, bool write_back);
+bool page_add_zero (void *upage, bool writable);
+bool page_add_shared (void *upage, struct frame *);
+struct page *page_lookup (const void *addr);
+void page_remove (void *upage);
+bool page_is_stack (const void *addr);
+
+bool page_in (const void *addr, bool write);
+bool page_unshare (const void *addr);
+void page_out (struct frame *[], size_t cnt);
+bool page_pin (const void *addr, size_t size, bool write);
+void page_unpin (const void *addr, size_t size);
+
+void page_get_stats (struct vm_stats *);
+void page_print_stats (void);
+
+#endif /* vm/page.h */
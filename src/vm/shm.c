@@ -0,0 +1,141 @@
+#include "vm/shm.h"
+#include <debug.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "vm/frame.h"
+
+/* Named segments, and the lock that guards them along with
+   every segment's REF_CNT. */
+static struct list segments;
+static struct lock shm_lock;
+
+static struct shm *shm_lookup (const char *name);
+static struct shm *shm_create (const char *name, size_t page_cnt);
+static void shm_destroy (struct shm *);
+
+/* Initializes the list of segments. */
+void
+shm_init (void)
+{
+  list_init (&segments);
+  lock_init (&shm_lock);
+}
+
+/* Returns a new reference to the segment named NAME, creating it
+   with PAGE_CNT zeroed pages if there is none.  If NAME is null,
+   always creates a new, anonymous segment.  Returns a null
+   pointer if NAME is too long or PAGE_CNT out of range or larger
+   than an existing segment, or memory is not available. */
+struct shm *
+shm_open (const char *name, size_t page_cnt)
+{
+  struct shm *shm;
+
+  if (name != NULL && (*name == '\0' || strlen (name) > SHM_NAME_MAX))
+    return NULL;
+
+  lock_acquire (&shm_lock);
+  shm = name != NULL ? shm_lookup (name) : NULL;
+  if (shm != NULL)
+    {
+      if (page_cnt <= shm->page_cnt)
+        shm->ref_cnt++;
+      else
+        shm = NULL;
+    }
+  else if (page_cnt > 0 && page_cnt <= SHM_PAGES_MAX)
+    shm = shm_create (name, page_cnt);
+  lock_release (&shm_lock);
+  return shm;
+}
+
+/* Adds a reference to SHM, as for a copy of a mapping. */
+void
+shm_reopen (struct shm *shm)
+{
+  lock_acquire (&shm_lock);
+  ASSERT (shm->ref_cnt > 0);
+  shm->ref_cnt++;
+  lock_release (&shm_lock);
+}
+
+/* Drops a reference to SHM, destroying it once there are none.
+   Its frames are freed once no page maps them either. */
+void
+shm_close (struct shm *shm)
+{
+  bool dead;
+
+  lock_acquire (&shm_lock);
+  ASSERT (shm->ref_cnt > 0);
+  dead = --shm->ref_cnt == 0;
+  if (dead && shm->name[0] != '\0')
+    list_remove (&shm->elem);
+  lock_release (&shm_lock);
+
+  if (dead)
+    shm_destroy (shm);
+}
+
+/* Returns the segment named NAME, or a null pointer if there is
+   none.  shm_lock must be held. */
+static struct shm *
+shm_lookup (const char *name)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&segments); e != list_end (&segments);
+       e = list_next (e))
+    {
+      struct shm *shm = list_entry (e, struct shm, elem);
+      if (!strcmp (shm->name, name))
+        return shm;
+    }
+  return NULL;
+}
+
+/* Creates a segment of PAGE_CNT zeroed pages, with one
+   reference, named NAME, or anonymous if NAME is null.
+   shm_lock must be held. */
+static struct shm *
+shm_create (const char *name, size_t page_cnt)
+{
+  struct shm *shm;
+  size_t i;
+
+  shm = malloc (sizeof *shm + page_cnt * sizeof *shm->frames);
+  if (shm == NULL)
+    return NULL;
+  strlcpy (shm->name, name != NULL ? name : "", sizeof shm->name);
+  shm->page_cnt = page_cnt;
+  shm->ref_cnt = 1;
+
+  /* frame_alloc() returns each frame pinned, and that pin is the
+     segment's. */
+  for (i = 0; i < page_cnt; i++)
+    {
+      shm->frames[i] = frame_alloc (NULL, PAL_ZERO);
+      if (shm->frames[i] == NULL)
+        {
+          shm->page_cnt = i;
+          shm_destroy (shm);
+          return NULL;
+        }
+    }
+  if (name != NULL)
+    list_push_back (&segments, &shm->elem);
+  return shm;
+}
+
+/* Unpins SHM's frames, so that each is freed when its last page
+   goes, and frees SHM. */
+static void
+shm_destroy (struct shm *shm)
+{
+  size_t i;
+
+  for (i = 0; i < shm->page_cnt; i++)
+    frame_unpin (shm->frames[i]);
+  free (shm);
+}
@@ -0,0 +1,37 @@
+#ifndef VM_SHM_H
+#define VM_SHM_H
+
+#include <list.h>
+#include <stddef.h>
+
+struct frame;
+
+/* Longest name of a shared memory segment. */
+#define SHM_NAME_MAX 14
+
+/* Most pages in a shared memory segment. */
+#define SHM_PAGES_MAX 64
+
+/* A shared memory segment: frames that every process mapping
+   the segment maps into its own page directory.
+
+   The segment keeps each of its frames pinned, so that they are
+   never evicted and each process's mapping of a frame stays
+   valid; the frame table counts the pages mapping each frame as
+   it does for any other.  A segment lasts as long as some
+   process has it mapped. */
+struct shm
+  {
+    struct list_elem elem;      /* Element in the list of segments. */
+    char name[SHM_NAME_MAX + 1]; /* Name, or "" if anonymous. */
+    size_t page_cnt;            /* Number of pages. */
+    int ref_cnt;                /* Mappings of the segment. */
+    struct frame *frames[];     /* PAGE_CNT frames, pinned. */
+  };
+
+void shm_init (void);
+struct shm *shm_open (const char *name, size_t page_cnt);
+void shm_reopen (struct shm *);
+void shm_close (struct shm *);
+
+#endif /* vm/shm.h */
@@ -0,0 +1,336 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <inttypes.h>
+#include <lz.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vm-stats.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Swap space.
+
+   The BLOCK_SWAP device is divided into page-sized slots, and a
+   bitmap records which of them hold a page.  Without a swap
+   device there are no slots, and swap_alloc() always fails.
+
+   Slots can be allocated in contiguous runs, so that pages
+   evicted together are written with requests that the block
+   layer merges into a single transfer.  Each used slot also
+   remembers the page it holds and that page's owner, so that
+   swapping in one page can read its neighbors in the same
+   transfer (see page_load() in vm/page.c).
+
+   After fork(), a page in swap belongs to both processes, so a
+   slot counts its references and is freed when the last one
+   goes.
+
+   With -zswap, pages written to slots need not reach the device
+   at all.  A page of zeros is only marked as such, and any other
+   page that compresses to at most RAM_MAX_LEN bytes is kept in
+   kernel memory in compressed form, until the copies held this
+   way add up to swap_ram_limit bytes.  Reading such a slot back
+   then costs a decompression instead of a disk read.  Pages that
+   do not compress well, and pages written once the limit is
+   reached, go to the device as before. */
+
+/* Number of sectors in a slot. */
+#define SLOT_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Most bytes a page may compress to and still be kept in
+   memory. */
+#define RAM_MAX_LEN (PGSIZE * 3 / 4)
+
+/* What a used slot holds. */
+struct slot
+  {
+    struct thread *owner;       /* Owner of PAGE. */
+    struct page *page;          /* Page stored in the slot. */
+    unsigned ref_cnt;           /* Number of pages stored in it. */
+    bool zero;                  /* Holds a page of zeros, not on disk? */
+    uint8_t *ram;               /* Compressed page, not on disk, or null. */
+    uint16_t ram_len;           /* Length of RAM. */
+  };
+
+/* -zswap: Most bytes of compressed pages to keep in memory, or 0
+   to keep none and not look for zero pages either. */
+size_t swap_ram_limit;
+
+static struct block *swap_device;
+static struct bitmap *used_slots;
+static struct slot *slots;
+static struct lock swap_lock;   /* Protects USED_SLOTS, SLOTS, stats,
+                                   RAM_USED, and the buffers below. */
+static size_t ram_used;         /* Bytes of compressed pages in memory. */
+
+/* Buffers for compressing pages. */
+static uint8_t ram_buf[RAM_MAX_LEN];
+static uint8_t lz_work[LZ_WORK_SIZE];
+
+/* Statistics. */
+static uint64_t write_cnt;      /* Pages written. */
+static uint64_t read_cnt;       /* Pages read. */
+static uint64_t run_cnt;        /* Runs of more than one slot allocated. */
+static uint64_t zero_cnt;       /* Pages written that were all zeros. */
+static uint64_t ram_cnt;        /* Other pages kept in memory. */
+static uint64_t ram_read_cnt;   /* Pages read back from memory. */
+
+static bool store_in_ram (struct slot *, const void *kpage);
+static void load_from_ram (struct slot *, void *kpage);
+static bool is_zero_page (const void *kpage);
+
+/* Initializes the swap space. */
+void
+swap_init (void)
+{
+  size_t slot_cnt = 0;
+
+  lock_init (&swap_lock);
+  lock_register (&swap_lock, "swap");
+  swap_device = block_get_role (BLOCK_SWAP);
+  if (swap_device != NULL)
+    slot_cnt = block_size (swap_device) / SLOT_SECTORS;
+  used_slots = bitmap_create (slot_cnt);
+  slots = calloc (slot_cnt, sizeof *slots);
+  if (used_slots == NULL || (slot_cnt > 0 && slots == NULL))
+    PANIC ("swap table creation failed");
+}
+
+/* Allocates CNT contiguous swap slots and returns the first, or
+   SWAP_NONE if there is no free run that long. */
+size_t
+swap_alloc (size_t cnt)
+{
+  size_t slot;
+
+  ASSERT (cnt > 0);
+
+  lock_acquire (&swap_lock);
+  slot = bitmap_scan_and_flip (used_slots, 0, cnt, false);
+  if (slot != BITMAP_ERROR)
+    {
+      size_t i;
+      for (i = 0; i < cnt; i++)
+        slots[slot + i].ref_cnt = 1;
+      if (cnt > 1)
+        run_cnt++;
+    }
+  lock_release (&swap_lock);
+  return slot != BITMAP_ERROR ? slot : SWAP_NONE;
+}
+
+/* Records that SLOT holds PAGE, which belongs to OWNER. */
+void
+swap_set_page (size_t slot, struct thread *owner, struct page *page)
+{
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (used_slots, slot));
+  slots[slot].owner = owner;
+  slots[slot].page = page;
+  lock_release (&swap_lock);
+}
+
+/* Returns the page stored in SLOT, if SLOT is a used slot and
+   the page belongs to OWNER, or a null pointer otherwise. */
+struct page *
+swap_get_page (size_t slot, struct thread *owner)
+{
+  struct page *page = NULL;
+
+  lock_acquire (&swap_lock);
+  if (slot < bitmap_size (used_slots) && bitmap_test (used_slots, slot)
+      && slots[slot].owner == owner)
+    page = slots[slot].page;
+  lock_release (&swap_lock);
+  return page;
+}
+
+/* Starts writing the page at KPAGE to SLOT, if WRITE is true,
+   or reading SLOT into KPAGE, if WRITE is false, using R.
+   swap_wait() must be called on R before KPAGE or R is reused.
+   Requests for consecutive slots submitted together are carried
+   out as one transfer. */
+void
+swap_submit (size_t slot, void *kpage, bool write, struct block_request *r)
+{
+  struct slot *s = &slots[slot];
+  bool in_ram;
+
+  ASSERT (slot < bitmap_size (used_slots));
+
+  lock_acquire (&swap_lock);
+  if (write)
+    {
+      write_cnt++;
+      in_ram = store_in_ram (s, kpage);
+    }
+  else
+    {
+      read_cnt++;
+      in_ram = s->zero || s->ram != NULL;
+      if (in_ram)
+        load_from_ram (s, kpage);
+    }
+  lock_release (&swap_lock);
+
+  /* A request that the device never sees is complete already. */
+  if (in_ram)
+    {
+      sema_init (&r->done, 1);
+      return;
+    }
+
+  r->sector = slot * SLOT_SECTORS;
+  r->cnt = SLOT_SECTORS;
+  r->buffer = kpage;
+  r->write = write;
+  r->prepaid = false;
+  block_submit (swap_device, r);
+}
+
+/* Waits for request R, passed to swap_submit(), to finish. */
+void
+swap_wait (struct block_request *r)
+{
+  block_wait (r);
+}
+
+/* Adds a reference to SLOT, for another page that holds the
+   same contents. */
+void
+swap_share (size_t slot)
+{
+  ASSERT (slot != SWAP_NONE);
+
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (used_slots, slot));
+  slots[slot].ref_cnt++;
+  lock_release (&swap_lock);
+}
+
+/* Drops a reference to SLOT, and frees it if that was the
+   last.  Either way, SLOT no longer records a page, since the
+   one it recorded may be the one going away. */
+void
+swap_free (size_t slot)
+{
+  ASSERT (slot != SWAP_NONE);
+
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (used_slots, slot));
+  ASSERT (slots[slot].ref_cnt > 0);
+  if (--slots[slot].ref_cnt == 0)
+    {
+      struct slot *s = &slots[slot];
+
+      bitmap_reset (used_slots, slot);
+      s->zero = false;
+      if (s->ram != NULL)
+        {
+          ram_used -= s->ram_len;
+          free (s->ram);
+          s->ram = NULL;
+        }
+    }
+  slots[slot].owner = NULL;
+  slots[slot].page = NULL;
+  lock_release (&swap_lock);
+}
+
+/* Fills in the swap statistics in STATS. */
+void
+swap_get_stats (struct vm_stats *stats)
+{
+  lock_acquire (&swap_lock);
+  stats->swap_write_cnt = write_cnt;
+  stats->swap_read_cnt = read_cnt;
+  stats->swap_slot_cnt = bitmap_size (used_slots);
+  stats->swap_used_cnt = bitmap_count (used_slots, 0,
+                                       bitmap_size (used_slots), true);
+  lock_release (&swap_lock);
+}
+
+/* Prints swap statistics. */
+void
+swap_print_stats (void)
+{
+  if (swap_device == NULL)
+    return;
+  printf ("Swap: %zu of %zu slots used, %"PRIu64" pages written "
+          "(%"PRIu64" multi-slot runs), %"PRIu64" pages read\n",
+          bitmap_count (used_slots, 0, bitmap_size (used_slots), true),
+          bitmap_size (used_slots), write_cnt, run_cnt, read_cnt);
+  if (swap_ram_limit > 0)
+    printf ("Swap: %"PRIu64" zero pages, %"PRIu64" pages compressed "
+            "into %zu bytes in memory, %"PRIu64" pages read from memory\n",
+            zero_cnt, ram_cnt, ram_used, ram_read_cnt);
+}
+
+/* Tries to keep the page at KPAGE, being written to slot S, in
+   memory instead of on the swap device.  Returns true if
+   successful, false if the page must be written to the device
+   after all.  The caller must hold SWAP_LOCK. */
+static bool
+store_in_ram (struct slot *s, const void *kpage)
+{
+  size_t len;
+
+  ASSERT (lock_held_by_current_thread (&swap_lock));
+  ASSERT (!s->zero && s->ram == NULL);
+
+  if (swap_ram_limit == 0)
+    return false;
+  if (is_zero_page (kpage))
+    {
+      s->zero = true;
+      zero_cnt++;
+      return true;
+    }
+
+  if (ram_used >= swap_ram_limit)
+    return false;
+  len = lz_compress (kpage, PGSIZE, ram_buf, sizeof ram_buf, lz_work);
+  if (len == 0 || ram_used + len > swap_ram_limit)
+    return false;
+  s->ram = malloc (len);
+  if (s->ram == NULL)
+    return false;
+  memcpy (s->ram, ram_buf, len);
+  s->ram_len = len;
+  ram_used += len;
+  ram_cnt++;
+  return true;
+}
+
+/* Reads slot S, which is held in memory, into KPAGE.  The slot
+   keeps its copy, for any other page that shares it, until
+   swap_free() drops its last reference.  The caller must hold
+   SWAP_LOCK. */
+static void
+load_from_ram (struct slot *s, void *kpage)
+{
+  ASSERT (lock_held_by_current_thread (&swap_lock));
+
+  ram_read_cnt++;
+  if (s->zero)
+    memset (kpage, 0, PGSIZE);
+  else if (!lz_decompress (s->ram, s->ram_len, kpage, PGSIZE))
+    PANIC ("swap: compressed page corrupted");
+}
+
+/* Returns true if the page at KPAGE is all zeros. */
+static bool
+is_zero_page (const void *kpage)
+{
+  const uint32_t *p = kpage;
+  size_t i;
+
+  for (i = 0; i < PGSIZE / sizeof *p; i++)
+    if (p[i] != 0)
+      return false;
+  return true;
+}
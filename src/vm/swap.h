@@ -0,0 +1,31 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct block_request;
+struct page;
+struct thread;
+struct vm_stats;
+
+/* Returned by swap_alloc() when the swap device is full or
+   missing, and used by pages that have no swap slot. */
+#define SWAP_NONE ((size_t) -1)
+
+/* -zswap: Bytes of memory for compressed pages. */
+extern size_t swap_ram_limit;
+
+void swap_init (void);
+size_t swap_alloc (size_t cnt);
+void swap_set_page (size_t slot, struct thread *owner, struct page *);
+struct page *swap_get_page (size_t slot, struct thread *owner);
+void swap_submit (size_t slot, void *kpage, bool write,
+                  struct block_request *);
+void swap_wait (struct block_request *);
+void swap_share (size_t slot);
+void swap_free (size_t slot);
+void swap_get_stats (struct vm_stats *);
+void swap_print_stats (void);
+
+#endif /* vm/swap.h */